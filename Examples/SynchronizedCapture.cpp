@@ -39,13 +39,16 @@
  */
 
 #include "platform.h"
-#include <array>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
 
-#define kDeviceCount 2
+#define kMinimumDeviceCount 2
 
 // Video mode parameters
 const BMDDisplayMode      kDisplayMode = bmdModeHD1080p25;
@@ -136,6 +139,365 @@ private:
 	INT32_SIGNED m_refCount;
 };
 
+// A captured frame waiting to be aligned with the frames of the other devices
+struct AlignerFrame
+{
+	IDeckLinkVideoInputFrame*	videoFrame;
+	BMDTimeValue				streamTime;
+	BMDTimeValue				hardwareTime;	// Microseconds
+};
+
+// Bounded single-producer single-consumer queue between a device's capture thread and the aligner thread
+class AlignerFrameQueue
+{
+public:
+	explicit AlignerFrameQueue(INT32_UNSIGNED capacity) :
+		m_frames(capacity),
+		m_head(0),
+		m_tail(0)
+	{
+	}
+
+	// Called by the capture thread, returns false if the aligner has fallen behind and the queue is full
+	bool push(const AlignerFrame& frame)
+	{
+		INT64_UNSIGNED tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) == m_frames.size())
+			return false;
+
+		m_frames[tail % m_frames.size()] = frame;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Called by the aligner thread
+	bool full() const
+	{
+		return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_relaxed) == m_frames.size();
+	}
+
+	const AlignerFrame* front() const
+	{
+		INT64_UNSIGNED head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+			return nullptr;
+
+		return &m_frames[head % m_frames.size()];
+	}
+
+	void pop()
+	{
+		m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+private:
+	std::vector<AlignerFrame>		m_frames;
+	std::atomic<INT64_UNSIGNED>		m_head;
+	std::atomic<INT64_UNSIGNED>		m_tail;
+};
+
+// The frames of every device with the same stream time.  The frame of a device that missed the
+// stream time is nullptr.  The frames are only valid for the duration of bundleReady(), a consumer
+// that keeps them must add a reference.
+struct FrameBundle
+{
+	BMDTimeValue							streamTime;
+	std::vector<IDeckLinkVideoInputFrame*>	frames;
+	std::vector<BMDTimeValue>				hardwareTimes;
+	unsigned								frameCount;
+	BMDTimeValue							skew;			// Between the earliest and latest hardware reference timestamps, in microseconds
+};
+
+class FrameBundleConsumer
+{
+public:
+	virtual ~FrameBundleConsumer() {}
+	virtual void bundleReady(const FrameBundle& bundle) = 0;
+};
+
+// Aligns the frames captured by the devices of a capture group on their stream time and passes
+// each set to the consumer as a bundle from the aligner thread.  Each device's capture thread only
+// writes its own queue, so devices do not contend with each other however many there are.  A
+// bundle is complete when every device has a frame with its stream time.  If a device has moved
+// past the stream time, or has delivered nothing within kAlignmentTimeoutFrames or before another
+// device's queue fills, the bundle is passed on without it and the frame is counted as missing.  Frames that arrive after their bundle
+// was passed on are counted as late and released.
+class FrameAligner
+{
+public:
+	FrameAligner(unsigned deviceCount, FrameBundleConsumer& consumer) :
+		m_consumer(consumer),
+		m_lastStreamTime(-1),
+		m_running(false),
+		m_arrivalCount(0),
+		m_waiting(false)
+	{
+		for (unsigned i = 0; i < deviceCount; i++)
+			m_devices.emplace_back(new DeviceState());
+
+		m_bundle.frames.resize(deviceCount);
+		m_bundle.hardwareTimes.resize(deviceCount);
+	}
+
+	~FrameAligner()
+	{
+		stop();
+	}
+
+	void start()
+	{
+		m_running = true;
+		m_thread = std::thread(&FrameAligner::run, this);
+	}
+
+	void stop()
+	{
+		if (!m_thread.joinable())
+			return;
+
+		{
+			std::lock_guard<std::mutex> guard(m_waitMutex);
+			m_running = false;
+		}
+		m_waitCondition.notify_one();
+		m_thread.join();
+
+		// Release the frames that were never aligned
+		for (auto& device : m_devices)
+		{
+			while (const AlignerFrame* frame = device->queue.front())
+			{
+				frame->videoFrame->Release();
+				device->queue.pop();
+			}
+		}
+	}
+
+	// Called from the capture thread of each device
+	void frameArrived(unsigned deviceIndex, IDeckLinkVideoInputFrame* videoFrame, BMDTimeValue streamTime, BMDTimeValue hardwareTime)
+	{
+		DeviceState& device = *m_devices[deviceIndex];
+
+		videoFrame->AddRef();
+		if (!device.queue.push({ videoFrame, streamTime, hardwareTime }))
+		{
+			videoFrame->Release();
+			device.overflowCount++;
+			return;
+		}
+
+		// Only wake the aligner thread when it is waiting, so that capture threads do not share a lock
+		m_arrivalCount.fetch_add(1);
+		if (m_waiting.load())
+		{
+			std::lock_guard<std::mutex> guard(m_waitMutex);
+			m_waitCondition.notify_one();
+		}
+	}
+
+	void printStatistics()
+	{
+		for (unsigned i = 0; i < m_devices.size(); i++)
+		{
+			const DeviceState& device = *m_devices[i];
+			printf("Device #%u: %llu frames aligned, %llu missing, %llu late, %llu dropped; skew mean = %lld us, max = %lld us\n", i,
+				device.frameCount, device.missingCount, device.lateCount, device.overflowCount.load(),
+				(long long)(device.frameCount ? device.skewTotal / (BMDTimeValue)device.frameCount : 0), (long long)device.skewMax);
+		}
+	}
+
+private:
+	static const INT32_UNSIGNED kQueueCapacity = 16;
+	static const INT32_UNSIGNED kAlignmentTimeoutFrames = 2;
+
+	struct DeviceState
+	{
+		DeviceState() :
+			queue(kQueueCapacity),
+			frameCount(0),
+			missingCount(0),
+			lateCount(0),
+			overflowCount(0),
+			skewTotal(0),
+			skewMax(0)
+		{
+		}
+
+		AlignerFrameQueue					queue;
+
+		// Statistics, updated by the aligner thread except for overflowCount
+		unsigned long long					frameCount;
+		unsigned long long					missingCount;
+		unsigned long long					lateCount;
+		std::atomic<unsigned long long>		overflowCount;
+		BMDTimeValue						skewTotal;		// Relative to the earliest frame of each bundle, in microseconds
+		BMDTimeValue						skewMax;
+	};
+
+	FrameBundleConsumer&						m_consumer;
+	std::vector<std::unique_ptr<DeviceState>>	m_devices;
+	FrameBundle									m_bundle;
+	BMDTimeValue								m_lastStreamTime;
+
+	std::thread									m_thread;
+	bool										m_running;
+	std::atomic<INT64_UNSIGNED>					m_arrivalCount;
+	std::atomic<bool>							m_waiting;
+	std::mutex									m_waitMutex;
+	std::condition_variable						m_waitCondition;
+
+	void run()
+	{
+		const std::chrono::microseconds alignmentTimeout(kAlignmentTimeoutFrames * kFrameDuration * kMicroSecondsTimeScale / kTimeScale);
+		std::chrono::steady_clock::time_point pendingSince;
+		BMDTimeValue pendingStreamTime = -1;
+
+		while (true)
+		{
+			INT64_UNSIGNED arrivalCount = m_arrivalCount.load();
+
+			// Find the earliest stream time at the front of the queues, releasing late frames
+			BMDTimeValue	streamTime		= -1;
+			bool			allQueued		= true;
+			bool			anyFull			= false;
+
+			for (auto& device : m_devices)
+			{
+				const AlignerFrame* frame;
+				while ((frame = device->queue.front()) != nullptr && frame->streamTime <= m_lastStreamTime)
+				{
+					frame->videoFrame->Release();
+					device->queue.pop();
+					device->lateCount++;
+				}
+
+				if (device->queue.full())
+					anyFull = true;
+
+				if (frame == nullptr)
+					allQueued = false;
+				else if (streamTime < 0 || frame->streamTime < streamTime)
+					streamTime = frame->streamTime;
+			}
+
+			if (streamTime >= 0)
+			{
+				if (streamTime != pendingStreamTime)
+				{
+					pendingStreamTime	= streamTime;
+					pendingSince		= std::chrono::steady_clock::now();
+				}
+
+				// Every device has either a frame with this stream time or has moved past it, or the
+				// devices that have delivered nothing are too late.  A stalled device is also not
+				// waited for once another device's queue is full, so that it cannot cause drops.
+				if (allQueued || anyFull || std::chrono::steady_clock::now() - pendingSince >= alignmentTimeout)
+				{
+					emitBundle(streamTime);
+					continue;
+				}
+			}
+
+			std::unique_lock<std::mutex> guard(m_waitMutex);
+			if (!m_running)
+				break;
+
+			m_waiting = true;
+			if (m_arrivalCount.load() == arrivalCount)
+			{
+				if (streamTime >= 0)
+					m_waitCondition.wait_until(guard, pendingSince + alignmentTimeout);
+				else
+					m_waitCondition.wait(guard);
+			}
+			m_waiting = false;
+		}
+	}
+
+	void emitBundle(BMDTimeValue streamTime)
+	{
+		BMDTimeValue earliestTime = 0;
+		BMDTimeValue latestTime = 0;
+
+		m_bundle.streamTime	= streamTime;
+		m_bundle.frameCount	= 0;
+
+		for (unsigned i = 0; i < m_devices.size(); i++)
+		{
+			const AlignerFrame* frame = m_devices[i]->queue.front();
+			if (frame == nullptr || frame->streamTime != streamTime)
+			{
+				m_bundle.frames[i]			= nullptr;
+				m_bundle.hardwareTimes[i]	= 0;
+				m_devices[i]->missingCount++;
+				continue;
+			}
+
+			// Read the frame before popping it, which hands its slot back to the capture thread
+			BMDTimeValue hardwareTime = frame->hardwareTime;
+
+			m_bundle.frames[i]			= frame->videoFrame;
+			m_bundle.hardwareTimes[i]	= hardwareTime;
+			m_devices[i]->queue.pop();
+
+			if (m_bundle.frameCount == 0 || hardwareTime < earliestTime)
+				earliestTime = hardwareTime;
+			if (m_bundle.frameCount == 0 || hardwareTime > latestTime)
+				latestTime = hardwareTime;
+			m_bundle.frameCount++;
+		}
+
+		m_bundle.skew = latestTime - earliestTime;
+
+		for (unsigned i = 0; i < m_devices.size(); i++)
+		{
+			if (m_bundle.frames[i] == nullptr)
+				continue;
+
+			DeviceState& device = *m_devices[i];
+			BMDTimeValue skew = m_bundle.hardwareTimes[i] - earliestTime;
+
+			device.frameCount++;
+			device.skewTotal += skew;
+			device.skewMax = std::max(device.skewMax, skew);
+		}
+
+		m_lastStreamTime = streamTime;
+
+		m_consumer.bundleReady(m_bundle);
+
+		for (auto frame : m_bundle.frames)
+		{
+			if (frame != nullptr)
+				frame->Release();
+		}
+	}
+};
+
+// Prints each bundle, a multi-camera recorder would write the frames of the bundle together
+class BundlePrinter : public FrameBundleConsumer
+{
+public:
+	void bundleReady(const FrameBundle& bundle) override
+	{
+		BMDTimeValue time = bundle.streamTime;
+
+		unsigned frames = (unsigned)((time % kTimeScale) / kFrameDuration);
+		unsigned seconds = (unsigned)((time / kTimeScale) % 60);
+		unsigned minutes = (unsigned)((time / kTimeScale / 60) % 60);
+		unsigned hours = (unsigned)(time / kTimeScale / 60 / 60);
+
+		printf("Frame %02u:%02u:%02u:%03u: %u/%u devices, skew %lld us", hours, minutes, seconds, frames, bundle.frameCount, (unsigned)bundle.frames.size(), (long long)bundle.skew);
+
+		for (unsigned i = 0; i < bundle.frames.size(); i++)
+		{
+			if (bundle.frames[i] == nullptr)
+				printf(", device #%u missing", i);
+		}
+		printf("\n");
+	}
+};
+
 class DeckLinkDevice
 {
 public:
@@ -147,14 +509,16 @@ public:
 		m_deckLinkNotification(nullptr),
 		m_notificationCallback(nullptr),
 		m_deckLinkInput(nullptr),
-		m_inputCallback(nullptr)
+		m_inputCallback(nullptr),
+		m_frameAligner(nullptr)
 	{
 	}
 
-	HRESULT setup(IDeckLink* deckLink, unsigned index)
+	HRESULT setup(IDeckLink* deckLink, unsigned index, FrameAligner* frameAligner)
 	{
 		m_deckLink = deckLink;
 		m_index = index;
+		m_frameAligner = frameAligner;
 
 		// Obtain the configuration interface for the DeckLink device
 		HRESULT result = m_deckLink->QueryInterface(IID_IDeckLinkConfiguration, (void**)&m_deckLinkConfig);
@@ -323,11 +687,6 @@ public:
 			return S_OK;
 		}
 
-		unsigned frames = (unsigned)((time % kTimeScale) / kFrameDuration);
-		unsigned seconds = (unsigned)((time / kTimeScale) % 60);
-		unsigned minutes = (unsigned)((time / kTimeScale / 60) % 60);
-		unsigned hours = (unsigned)(time / kTimeScale / 60 / 60);
-
 		BMDTimeValue hwTime;
 		result = videoFrame->GetHardwareReferenceTimestamp(kMicroSecondsTimeScale, &hwTime, NULL);
 		if (result != S_OK)
@@ -336,8 +695,7 @@ public:
 			return S_OK;
 		}
 
-
-		printf("[%llu.%06llu] Device #%u: Frame %02u:%02u:%02u:%03u arrived\n", hwTime / kMicroSecondsTimeScale, hwTime % kMicroSecondsTimeScale, m_index, hours, minutes, seconds, frames);
+		m_frameAligner->frameArrived(m_index, videoFrame, time, hwTime);
 
 		return S_OK;
 	}
@@ -381,6 +739,7 @@ private:
 	NotificationCallback*							m_notificationCallback;
 	IDeckLinkInput*									m_deckLinkInput;
 	InputCallback*									m_inputCallback;
+	FrameAligner*									m_frameAligner;
 	std::mutex										m_mutex;
 	std::condition_variable							m_signalCondition;
 };
@@ -437,9 +796,23 @@ int main(int argc, const char * argv[])
 
 	IDeckLinkIterator*      deckLinkIterator = nullptr;
 	IDeckLink*				deckLink = nullptr;
-	std::array<DeckLinkDevice, kDeviceCount> deckLinkDevices;
-	HRESULT                 result;
-	unsigned				index = 0;
+	std::vector<IDeckLink*>	deckLinks;
+	BundlePrinter			bundlePrinter;
+	std::unique_ptr<FrameAligner>					frameAligner;
+	std::vector<std::unique_ptr<DeckLinkDevice>>	deckLinkDevices;
+	unsigned				maxDeviceCount = 0;
+	HRESULT                 result = E_FAIL;
+
+	// An optional argument limits the number of devices, otherwise every device that supports synchronized capture is used
+	if (argc > 1)
+	{
+		maxDeviceCount = (unsigned)strtoul(argv[1], nullptr, 10);
+		if (maxDeviceCount < kMinimumDeviceCount)
+		{
+			fprintf(stderr, "Usage: %s [device count]\n    The device count must be at least %u\n", argv[0], kMinimumDeviceCount);
+			return 1;
+		}
+	}
 
 	Initialize();
 
@@ -451,34 +824,40 @@ int main(int argc, const char * argv[])
 		goto bail;
 	}
 
-	for (auto& device : deckLinkDevices)
+	// Obtain the DeckLink devices that support synchronized capture
+	while ((maxDeviceCount == 0 || deckLinks.size() < maxDeviceCount) && deckLinkIterator->Next(&deckLink) == S_OK)
 	{
-		// Obtain the next DeckLink device
-		while (true)
-		{
-			result = deckLinkIterator->Next(&deckLink);
-			if (result != S_OK)
-			{
-				fprintf(stderr, "Could not find DeckLink device - result = %08x\n", result);
-				goto bail;
-			}
+		if (supportsSynchronizedCapture(deckLink))
+			deckLinks.push_back(deckLink);
+		else
+			deckLink->Release();
+	}
+	deckLink = nullptr;
 
-			if (supportsSynchronizedCapture(deckLink))
-				break;
+	if (deckLinks.size() < (maxDeviceCount ? maxDeviceCount : kMinimumDeviceCount))
+	{
+		fprintf(stderr, "Could not find %u DeckLink devices that support synchronized capture\n", maxDeviceCount ? maxDeviceCount : kMinimumDeviceCount);
+		result = E_FAIL;
+		goto bail;
+	}
 
-			deckLink->Release();
-		}
+	// The aligner bundles the frames of all devices with the same stream time
+	frameAligner.reset(new FrameAligner((unsigned)deckLinks.size(), bundlePrinter));
+
+	for (unsigned index = 0; index < deckLinks.size(); index++)
+	{
+		deckLinkDevices.emplace_back(new DeckLinkDevice());
 
-		result = device.setup(deckLink, index++);
+		// The device takes ownership of the IDeckLink object
+		result = deckLinkDevices.back()->setup(deckLinks[index], index, frameAligner.get());
+		deckLinks[index] = nullptr;
 		if (result != S_OK)
 			goto bail;
-
-		deckLink = nullptr;
 	}
 
 	for (auto& device : deckLinkDevices)
 	{
-		result = device.prepareForCapture();
+		result = device->prepareForCapture();
 		if (result != S_OK)
 			goto bail;
 	}
@@ -488,36 +867,48 @@ int main(int argc, const char * argv[])
 
 	for (auto& device : deckLinkDevices)
 	{
-		result = device.waitForSignalLock();
+		result = device->waitForSignalLock();
 		if (result != S_OK)
 			goto bail;
 	}
 
+	frameAligner->start();
+
 	// Start capture - This only needs to be performed on one device in the group
-	result = deckLinkDevices[0].startCapture();
+	result = deckLinkDevices[0]->startCapture();
 	if (result != S_OK)
 		goto bail;
 
 	// Wait until user presses Enter
-	printf("Capturing... Press <RETURN> to exit\n");
+	printf("Capturing from %u devices... Press <RETURN> to exit\n", (unsigned)deckLinkDevices.size());
 
 	getchar();
 
 	printf("Exiting.\n");
 
 	// Stop capture - This only needs to be performed on one device in the group
-	result = deckLinkDevices[0].stopCapture();
+	result = deckLinkDevices[0]->stopCapture();
+
+	frameAligner->stop();
+	frameAligner->printStatistics();
 
 	// Disable the video input interface
 	for (auto& device : deckLinkDevices)
-		result = device.cleanUpFromCapture();
+		result = device->cleanUpFromCapture();
 
 	// Release resources
 bail:
 
-	// Release the Decklink object
-	if (deckLink != nullptr)
-		deckLink->Release();
+	// Release the Decklink objects not passed to a device
+	for (auto unusedDeckLink : deckLinks)
+	{
+		if (unusedDeckLink != nullptr)
+			unusedDeckLink->Release();
+	}
+
+	// The devices stop their callbacks before the aligner is destroyed
+	deckLinkDevices.clear();
+	frameAligner.reset();
 
 	// Release the DeckLink iterator
 	if (deckLinkIterator != nullptr)
@@ -525,4 +916,3 @@ bail:
 
 	return (result == S_OK) ? 0 : 1;
 }
-
@@ -39,13 +39,17 @@
  */
 
 #include "platform.h"
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <memory>
+#include <vector>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
 
-#define kDeviceCount 4
+#define kMinimumDeviceCount 2
 
 // Video mode parameters
 const BMDDisplayMode      kDisplayMode = bmdModeHD1080p25;
@@ -60,6 +64,10 @@ const INT32_UNSIGNED kFrameHeight = 1080;
 const INT32_UNSIGNED kRowBytes = 5120;
 const INT32_UNSIGNED kSynchronizedPlaybackGroup = 2;
 
+// Scheduling parameters, the scheduler keeps every output kScheduleAheadFrames ahead of the playback position
+const INT32_UNSIGNED kScheduleAheadFrames = 3;
+const INT32_UNSIGNED kFramePoolSize = 8;
+
 // 10-bit YUV pixels
 static const size_t kFrameCount = 4;
 
@@ -70,12 +78,10 @@ const std::array<INT32_UNSIGNED[4], kFrameCount> kFrameData{{
 	{ 0x069acca7, 0x2b329eb3, 0x0a7acc69, 0x2b31a6b3 }  // Green
 }};
 
-static void FillFrame(IDeckLinkMutableVideoFrame* theFrame, const INT32_UNSIGNED frameData[4])
+static void FillFrame(INT32_UNSIGNED* nextWord, const INT32_UNSIGNED frameData[4])
 {
-	INT32_UNSIGNED* nextWord;
 	INT32_UNSIGNED  wordsRemaining;
 
-	theFrame->GetBytes((void**)&nextWord);
 	wordsRemaining = (kRowBytes * kFrameHeight) / 4;
 
 	while (wordsRemaining > 0)
@@ -88,52 +94,67 @@ static void FillFrame(IDeckLinkMutableVideoFrame* theFrame, const INT32_UNSIGNED
 	}
 }
 
-static IDeckLinkMutableVideoFrame* CreateFrame(IDeckLinkOutput* deckLinkOutput, const INT32_UNSIGNED frameData[4])
+// A video frame in application memory, which can be scheduled on any device's output
+class PlayoutVideoFrame : public IDeckLinkVideoFrame
 {
-	HRESULT									result;
-	IDeckLinkMutableVideoFrame*				frame = nullptr;
-
-	result = deckLinkOutput->CreateVideoFrame(kFrameWidth, kFrameHeight, kRowBytes, kPixelFormat, bmdFrameFlagDefault, &frame);
-	if (result != S_OK)
+public:
+	PlayoutVideoFrame() :
+		m_buffer(kRowBytes * kFrameHeight / sizeof(INT32_UNSIGNED)),
+		m_content(-1),
+		m_refCount(1)
 	{
-		fprintf(stderr, "Could not create a video frame - result = %08x\n", result);
-		goto bail;
 	}
-	FillFrame(frame, frameData);
-
-bail:
-	return frame;
-}
 
+	// IDeckLinkVideoFrame interface
+	long			STDMETHODCALLTYPE GetWidth() override			{ return kFrameWidth; }
+	long			STDMETHODCALLTYPE GetHeight() override			{ return kFrameHeight; }
+	long			STDMETHODCALLTYPE GetRowBytes() override		{ return kRowBytes; }
+	BMDPixelFormat	STDMETHODCALLTYPE GetPixelFormat() override		{ return kPixelFormat; }
+	BMDFrameFlags	STDMETHODCALLTYPE GetFlags() override			{ return bmdFrameFlagDefault; }
 
-class DeckLinkDevice;
+	HRESULT			STDMETHODCALLTYPE GetBytes(void** buffer) override
+	{
+		*buffer = m_buffer.data();
+		return S_OK;
+	}
 
-class OutputCallback: public IDeckLinkVideoOutputCallback
-{
-public:
-	OutputCallback(DeckLinkDevice* deckLinkDevice) :
-		m_deckLinkDevice(deckLinkDevice),
-		m_refCount(1)
+	HRESULT			STDMETHODCALLTYPE GetTimecode(BMDTimecodeFormat format, IDeckLinkTimecode** timecode) override
 	{
+		*timecode = nullptr;
+		return S_FALSE;
 	}
 
-	HRESULT	STDMETHODCALLTYPE ScheduledFrameCompleted(IDeckLinkVideoFrame* completedFrame, BMDOutputFrameCompletionResult result) override;
-	HRESULT	STDMETHODCALLTYPE ScheduledPlaybackHasStopped(void) override;
+	HRESULT			STDMETHODCALLTYPE GetAncillaryData(IDeckLinkVideoFrameAncillary** ancillary) override
+	{
+		*ancillary = nullptr;
+		return S_FALSE;
+	}
 
-	// IUnknown needs only a dummy implementation
-	HRESULT	STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override
+	// IUnknown interface
+	HRESULT			STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override
 	{
+		if (ppv == nullptr)
+			return E_INVALIDARG;
+
+		if (iid == IID_IUnknown || iid == IID_IDeckLinkVideoFrame)
+		{
+			*ppv = static_cast<IDeckLinkVideoFrame*>(this);
+			AddRef();
+			return S_OK;
+		}
+
+		*ppv = nullptr;
 		return E_NOINTERFACE;
 	}
 
-	ULONG STDMETHODCALLTYPE AddRef() override
+	ULONG			STDMETHODCALLTYPE AddRef() override
 	{
 		return ++m_refCount;
 	}
 
-	ULONG STDMETHODCALLTYPE Release() override
+	ULONG			STDMETHODCALLTYPE Release() override
 	{
-		INT32_UNSIGNED newRefValue = --m_refCount;
+		ULONG newRefValue = --m_refCount;
 
 		if (newRefValue == 0)
 			delete this;
@@ -141,11 +162,228 @@ public:
 		return newRefValue;
 	}
 
+	// True when only the pool references the frame, so no output is displaying it
+	bool			isFree() const			{ return m_refCount == 1; }
+
+	int				getContent() const		{ return m_content; }
+
+	void			setContent(int content)
+	{
+		FillFrame(m_buffer.data(), kFrameData[content]);
+		m_content = content;
+	}
+
 private:
-	DeckLinkDevice*  m_deckLinkDevice;
-	std::atomic<INT32_SIGNED> m_refCount;
+	std::vector<INT32_UNSIGNED>		m_buffer;
+	int								m_content;
+	std::atomic<ULONG>				m_refCount;
+};
+
+// Frames shared by all outputs.  Each output holds a reference to a scheduled frame until it has
+// been displayed, so a frame is free for new content once the pool holds the only reference.
+class SharedFramePool
+{
+public:
+	SharedFramePool()
+	{
+		for (auto& frame : m_frames)
+			frame = new PlayoutVideoFrame();
+	}
+
+	~SharedFramePool()
+	{
+		for (auto frame : m_frames)
+			frame->Release();
+	}
+
+	// Return a free frame with the given content, filling a free frame only if no free frame already
+	// has the content.  Returns nullptr if every frame is still being displayed.
+	PlayoutVideoFrame* acquire(int content)
+	{
+		PlayoutVideoFrame* freeFrame = nullptr;
+
+		for (auto frame : m_frames)
+		{
+			if (!frame->isFree())
+				continue;
+
+			if (frame->getContent() == content)
+				return frame;
+
+			if (freeFrame == nullptr)
+				freeFrame = frame;
+		}
+
+		if (freeFrame != nullptr)
+			freeFrame->setContent(content);
+
+		return freeFrame;
+	}
+
+private:
+	std::array<PlayoutVideoFrame*, kFramePoolSize>	m_frames;
+};
+
+// Schedules every output from a single thread.  The thread wakes once per frame period of the
+// playback group, reads the playback position from the first output and schedules the next frames
+// on all outputs in one pass, so the outputs need no completion callbacks.  Every output is given
+// the same frame for the same stream time, keeping the playback group aligned.
+class PlayoutScheduler
+{
+public:
+	PlayoutScheduler(const std::vector<IDeckLinkOutput*>& outputs, SharedFramePool& framePool) :
+		m_outputs(outputs),
+		m_framePool(framePool),
+		m_outputStatistics(outputs.size()),
+		m_totalFramesScheduled(0),
+		m_poolExhaustedCount(0),
+		m_running(false)
+	{
+	}
+
+	~PlayoutScheduler()
+	{
+		stop();
+	}
+
+	// Schedule the first frames before playback is started
+	HRESULT preroll()
+	{
+		for (INT32_UNSIGNED i = 0; i < kScheduleAheadFrames; i++)
+		{
+			if (!scheduleNextFrame())
+				return E_FAIL;
+		}
+
+		return S_OK;
+	}
+
+	void start()
+	{
+		m_running = true;
+		m_thread = std::thread(&PlayoutScheduler::run, this);
+	}
+
+	void stop()
+	{
+		if (!m_thread.joinable())
+			return;
+
+		{
+			std::lock_guard<std::mutex> guard(m_mutex);
+			m_running = false;
+		}
+		m_condition.notify_one();
+		m_thread.join();
+	}
+
+	void printStatistics()
+	{
+		printf("Scheduled %llu frames on each of %u outputs, frame pool exhausted %llu times\n",
+			(unsigned long long)m_totalFramesScheduled, (unsigned)m_outputs.size(), (unsigned long long)m_poolExhaustedCount);
+
+		for (unsigned i = 0; i < m_outputStatistics.size(); i++)
+		{
+			const OutputStatistics& statistics = m_outputStatistics[i];
+			printf("Output #%u: %llu schedule failures, %llu underruns, minimum buffered frames = %u\n", i,
+				(unsigned long long)statistics.scheduleFailures, (unsigned long long)statistics.underruns, statistics.minimumBufferedFrames);
+		}
+	}
+
+private:
+	struct OutputStatistics
+	{
+		OutputStatistics() :
+			scheduleFailures(0),
+			underruns(0),
+			minimumBufferedFrames(kScheduleAheadFrames)
+		{
+		}
+
+		INT64_UNSIGNED	scheduleFailures;
+		INT64_UNSIGNED	underruns;
+		INT32_UNSIGNED	minimumBufferedFrames;
+	};
+
+	std::vector<IDeckLinkOutput*>	m_outputs;
+	SharedFramePool&				m_framePool;
+	std::vector<OutputStatistics>	m_outputStatistics;
+	INT64_UNSIGNED					m_totalFramesScheduled;
+	INT64_UNSIGNED					m_poolExhaustedCount;
+
+	std::thread						m_thread;
+	std::mutex						m_mutex;
+	std::condition_variable			m_condition;
+	bool							m_running;
+
+	// Schedule the next frame on every output, returns false if no frame was free
+	bool scheduleNextFrame()
+	{
+		PlayoutVideoFrame* frame = m_framePool.acquire((int)(m_totalFramesScheduled % kFrameCount));
+		if (frame == nullptr)
+		{
+			m_poolExhaustedCount++;
+			return false;
+		}
+
+		for (unsigned i = 0; i < m_outputs.size(); i++)
+		{
+			HRESULT result = m_outputs[i]->ScheduleVideoFrame(frame, m_totalFramesScheduled * kFrameDuration, kFrameDuration, kTimeScale);
+			if (result != S_OK)
+				m_outputStatistics[i].scheduleFailures++;
+		}
+
+		m_totalFramesScheduled++;
+		return true;
+	}
+
+	void run()
+	{
+		std::unique_lock<std::mutex> guard(m_mutex);
+
+		while (m_running)
+		{
+			BMDTimeValue	streamTime;
+			double			playbackSpeed;
+
+			guard.unlock();
+
+			if (m_outputs[0]->GetScheduledStreamTime(kTimeScale, &streamTime, &playbackSpeed) != S_OK)
+				streamTime = 0;
+
+			// Check how far ahead each output is before topping them all up
+			for (unsigned i = 0; i < m_outputs.size(); i++)
+			{
+				INT32_UNSIGNED bufferedFrames;
+				if (m_outputs[i]->GetBufferedVideoFrameCount(&bufferedFrames) != S_OK)
+					continue;
+
+				OutputStatistics& statistics = m_outputStatistics[i];
+				statistics.minimumBufferedFrames = std::min(statistics.minimumBufferedFrames, bufferedFrames);
+				if (bufferedFrames == 0)
+					statistics.underruns++;
+			}
+
+			INT64_UNSIGNED targetFramesScheduled = (INT64_UNSIGNED)(streamTime / kFrameDuration) + kScheduleAheadFrames;
+			while (m_totalFramesScheduled < targetFramesScheduled)
+			{
+				if (!scheduleNextFrame())
+					break;
+			}
+
+			// Wake again just after the start of the next frame period
+			BMDTimeValue untilNextFrame = kFrameDuration - (streamTime % kFrameDuration);
+			std::chrono::microseconds timeout(untilNextFrame * 1000000 / kTimeScale + 1000);
+
+			guard.lock();
+			if (m_running)
+				m_condition.wait_for(guard, timeout);
+		}
+	}
 };
 
+class DeckLinkDevice;
+
 class NotificationCallback : public IDeckLinkNotificationCallback
 {
 public:
@@ -191,11 +429,7 @@ public:
 		m_deckLinkStatus(nullptr),
 		m_deckLinkNotification(nullptr),
 		m_notificationCallback(nullptr),
-		m_deckLinkOutput(nullptr),
-		m_outputCallback(nullptr),
-		m_totalFramesScheduled(0),
-		m_nextFrameToSchedule(0),
-		m_stopped(false)
+		m_deckLinkOutput(nullptr)
 	{
 	}
 
@@ -259,37 +493,15 @@ public:
 			goto bail;
 		}
 
-		// Create an instance of output callback
-		m_outputCallback = new OutputCallback(this);
-		if (m_outputCallback == nullptr)
-		{
-			fprintf(stderr, "Could not create output callback object\n");
-			goto bail;
-		}
-
-		// Set the callback object to the DeckLink device's output interface
-		result = m_deckLinkOutput->SetScheduledFrameCompletionCallback(m_outputCallback);
-		if (result != S_OK)
-		{
-			fprintf(stderr, "Could not set output callback - result = %08x\n", result);
-			goto bail;
-		}
-
-		for (size_t i = 0; i < kFrameCount; ++i)
-		{
-			m_frames[i] = CreateFrame(m_deckLinkOutput, kFrameData[i]);
-			if (!m_frames[i])
-			{
-				fprintf(stderr, "Could not create frame\n");
-				result = E_FAIL;
-				goto bail;
-			}
-		}
-
 	bail:
 		return result;
 	}
 
+	IDeckLinkOutput* getOutput() const
+	{
+		return m_deckLinkOutput;
+	}
+
 	HRESULT waitForReferenceLock()
 	{
 		/*
@@ -323,7 +535,7 @@ public:
 
 	HRESULT prepareForPlayback()
 	{
-		// Enable video output
+		// Enable video output, the frames are scheduled by the PlayoutScheduler
 		HRESULT result = m_deckLinkOutput->EnableVideoOutput(kDisplayMode, kOutputFlag);
 		if (result != S_OK)
 		{
@@ -331,21 +543,12 @@ public:
 			goto bail;
 		}
 
-		// Schedule 3 frames
-		for (int i = 0; i < 3; i++)
-			scheduleNextFrame();
-
 	bail:
 		return result;
 	}
 
 	HRESULT startPlayback()
 	{
-		{
-			std::unique_lock<std::mutex> guard(m_mutex);
-			m_stopped = false;
-		}
-
 		HRESULT result = m_deckLinkOutput->StartScheduledPlayback(0, kTimeScale, 1.0);
 		if (result != S_OK)
 		{
@@ -372,22 +575,22 @@ public:
 
 	HRESULT waitForPlaybackStop()
 	{
-		std::unique_lock<std::mutex> guard(m_mutex);
-		if (!stopped())
-			m_stopCondition.wait(guard);
-		return S_OK;
-	}
+		// Without a completion callback, poll until the output reports that playback has stopped
+		while (true)
+		{
+			BOOL running;
+			HRESULT result = m_deckLinkOutput->IsScheduledPlaybackRunning(&running);
+			if (result != S_OK)
+			{
+				fprintf(stderr, "Could not query playback state - result = %08x\n", result);
+				return result;
+			}
 
-	void notifyDeviceStopped()
-	{
-		std::unique_lock<std::mutex> guard(m_mutex);
-		m_stopped = true;
-		m_stopCondition.notify_all();
-	}
+			if (!running)
+				return S_OK;
 
-	bool stopped() const
-	{
-		return m_stopped;
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
 	}
 
 	HRESULT cleanUpFromPlayback()
@@ -403,32 +606,8 @@ public:
 		return result;
 	}
 
-	HRESULT scheduleNextFrame()
-	{
-		IDeckLinkVideoFrame* frameToSchedule = m_frames[m_nextFrameToSchedule];
-		m_nextFrameToSchedule = ++m_nextFrameToSchedule % kFrameCount;
-
-		HRESULT result = m_deckLinkOutput->ScheduleVideoFrame(frameToSchedule, m_totalFramesScheduled*kFrameDuration, kFrameDuration, kTimeScale);
-		if (result != S_OK)
-		{
-			fprintf(stderr, "Could not schedule video frame - result = %08x\n", result);
-			goto bail;
-		}
-
-		++m_totalFramesScheduled;
-
-	bail:
-		return result;
-	}
-
 	~DeckLinkDevice()
 	{
-		if (m_outputCallback)
-		{
-			m_deckLinkOutput->SetScheduledFrameCompletionCallback(nullptr);
-			m_outputCallback->Release();
-		}
-
 		if (m_notificationCallback)
 		{
 			m_deckLinkNotification->Unsubscribe(bmdStatusChanged, m_notificationCallback);
@@ -449,12 +628,6 @@ public:
 
 		if (m_deckLinkNotification)
 			m_deckLinkNotification->Release();
-
-		for (auto frame : m_frames)
-		{
-			if (frame)
-				frame->Release();
-		}
 	}
 
 private:
@@ -464,30 +637,10 @@ private:
 	IDeckLinkNotification*							m_deckLinkNotification;
 	NotificationCallback*							m_notificationCallback;
 	IDeckLinkOutput*								m_deckLinkOutput;
-	OutputCallback*									m_outputCallback;
-	std::array<IDeckLinkVideoFrame*, kFrameCount>	m_frames;
-	INT32_UNSIGNED									m_totalFramesScheduled;
-	INT32_UNSIGNED									m_nextFrameToSchedule;
 	std::mutex										m_mutex;
-	bool											m_stopped;
-	std::condition_variable							m_stopCondition;
 	std::condition_variable							m_referenceCondition;
 };
 
-HRESULT	OutputCallback::ScheduledFrameCompleted(IDeckLinkVideoFrame* completedFrame, BMDOutputFrameCompletionResult result)
-{
-	// When a video frame completes, reschedule another frame
-	if (!m_deckLinkDevice->stopped())
-		m_deckLinkDevice->scheduleNextFrame();
-	return S_OK;
-}
-
-HRESULT	OutputCallback::ScheduledPlaybackHasStopped(void)
-{
-	m_deckLinkDevice->notifyDeviceStopped();
-	return S_OK;
-}
-
 HRESULT NotificationCallback::Notify(BMDNotifications topic, uint64_t param1, uint64_t param2)
 {
 	if (topic != bmdStatusChanged)
@@ -524,8 +677,24 @@ int main(int argc, const char * argv[])
 
 	IDeckLinkIterator*      deckLinkIterator = nullptr;
 	IDeckLink*				deckLink = nullptr;
-	std::array<DeckLinkDevice, kDeviceCount> deckLinkDevices;
-	HRESULT                 result;
+	std::vector<IDeckLink*>	deckLinks;
+	SharedFramePool			framePool;
+	std::vector<IDeckLinkOutput*>					deckLinkOutputs;
+	std::unique_ptr<PlayoutScheduler>				scheduler;
+	std::vector<std::unique_ptr<DeckLinkDevice>>	deckLinkDevices;
+	unsigned				maxDeviceCount = 0;
+	HRESULT                 result = E_FAIL;
+
+	// An optional argument limits the number of devices, otherwise every device that supports synchronized playback is used
+	if (argc > 1)
+	{
+		maxDeviceCount = (unsigned)strtoul(argv[1], nullptr, 10);
+		if (maxDeviceCount < kMinimumDeviceCount)
+		{
+			fprintf(stderr, "Usage: %s [device count]\n    The device count must be at least %u\n", argv[0], kMinimumDeviceCount);
+			return 1;
+		}
+	}
 
 	Initialize();
 
@@ -537,81 +706,109 @@ int main(int argc, const char * argv[])
 		goto bail;
 	}
 
-	for (auto& device : deckLinkDevices)
+	// Obtain the DeckLink devices that support synchronized playback
+	while ((maxDeviceCount == 0 || deckLinks.size() < maxDeviceCount) && deckLinkIterator->Next(&deckLink) == S_OK)
 	{
-		// Obtain the next DeckLink device
-		while (true)
-		{
-			result = deckLinkIterator->Next(&deckLink);
-			if (result != S_OK)
-			{
-				fprintf(stderr, "Could not find DeckLink device - result = %08x\n", result);
-				goto bail;
-			}
+		if (supportsSynchronizedPlayback(deckLink))
+			deckLinks.push_back(deckLink);
+		else
+			deckLink->Release();
+	}
+	deckLink = nullptr;
 
-			if (supportsSynchronizedPlayback(deckLink))
-				break;
+	if (deckLinks.size() < (maxDeviceCount ? maxDeviceCount : kMinimumDeviceCount))
+	{
+		fprintf(stderr, "Could not find %u DeckLink devices that support synchronized playback\n", maxDeviceCount ? maxDeviceCount : kMinimumDeviceCount);
+		result = E_FAIL;
+		goto bail;
+	}
 
-			deckLink->Release();
-		}
+	for (unsigned index = 0; index < deckLinks.size(); index++)
+	{
+		deckLinkDevices.emplace_back(new DeckLinkDevice());
 
-		result = device.setup(deckLink);
+		// The device takes ownership of the IDeckLink object
+		result = deckLinkDevices.back()->setup(deckLinks[index]);
+		deckLinks[index] = nullptr;
 		if (result != S_OK)
 			goto bail;
 
-		deckLink = nullptr;
+		deckLinkOutputs.push_back(deckLinkDevices.back()->getOutput());
 	}
 
 	for (auto& device : deckLinkDevices)
 	{
-		result = device.prepareForPlayback();
+		result = device->prepareForPlayback();
 		if (result != S_OK)
 			goto bail;
 	}
 
+	// One scheduler services all outputs, scheduling the same pooled frames on each
+	scheduler.reset(new PlayoutScheduler(deckLinkOutputs, framePool));
+
+	result = scheduler->preroll();
+	if (result != S_OK)
+	{
+		fprintf(stderr, "Could not preroll frames - result = %08x\n", result);
+		goto bail;
+	}
+
 	// Wait for devices to lock to the reference signal
 	printf("Waiting for reference lock...\n");
 
 	for (auto& device : deckLinkDevices)
 	{
-		result = device.waitForReferenceLock();
+		result = device->waitForReferenceLock();
 		if (result != S_OK)
 			goto bail;
 	}
 
 	// Start playback - This only needs to be performed on one device in the group
-	result = deckLinkDevices[0].startPlayback();
+	result = deckLinkDevices[0]->startPlayback();
 	if (result != S_OK)
 		goto bail;
 
+	scheduler->start();
+
 	// Wait until user presses Enter
-	printf("Monitoring... Press <RETURN> to exit\n");
+	printf("Playing to %u devices... Press <RETURN> to exit\n", (unsigned)deckLinkDevices.size());
 
 	getchar();
 
 	printf("Exiting.\n");
 
-	// Stop capture - This only needs to be performed on one device in the group
-	result = deckLinkDevices[0].stopPlayback();
+	scheduler->stop();
+
+	// Stop playback - This only needs to be performed on one device in the group
+	result = deckLinkDevices[0]->stopPlayback();
 
 	// If we're stopping in the future, we need to wait until the devices have stopped before we can clean up
 	for (auto& device : deckLinkDevices)
 	{
-		result = device.waitForPlaybackStop();
+		result = device->waitForPlaybackStop();
 		if (result != S_OK)
 			goto bail;
 	}
 
-	// Disable the video input interface
+	scheduler->printStatistics();
+
+	// Disable the video output interface
 	for (auto& device : deckLinkDevices)
-		result = device.cleanUpFromPlayback();
+		result = device->cleanUpFromPlayback();
 
 	// Release resources
 bail:
 
-	// Release the Decklink object
-	if (deckLink != nullptr)
-		deckLink->Release();
+	// Release the Decklink objects not passed to a device
+	for (auto unusedDeckLink : deckLinks)
+	{
+		if (unusedDeckLink != nullptr)
+			unusedDeckLink->Release();
+	}
+
+	// The scheduler uses the device outputs
+	scheduler.reset();
+	deckLinkDevices.clear();
 
 	// Release the DeckLink iterator
 	if (deckLinkIterator != nullptr)
@@ -619,4 +816,3 @@ bail:
 
 	return (result == S_OK) ? 0 : 1;
 }
-
@@ -38,8 +38,10 @@
  ** -LICENSE-END-
  */
 
+#include <algorithm>
 #include <atomic>
-#include <map>
+#include <bitset>
+#include <cstdlib>
 #include <vector>
 #include "platform.h"
 
@@ -48,29 +50,199 @@ const BMDDisplayMode			kDisplayMode = bmdModeHD1080i50;
 const BMDPixelFormat			kPixelFormat = bmdFormat10BitYUV;
 const BMDAncillaryPacketFormat	kAncillaryFormat = bmdAncillaryPacketFormatUInt8;
 
-struct AncillaryPacket
+// Capacity of the per-frame packet store, further packets in a frame are counted as dropped
+const INT32_UNSIGNED			kMaxAncillaryPacketsPerFrame = 512;
+
+// Compiled set of DID/SDID pairs to monitor, a flat table indexed by (DID << 8) | SDID
+class AncillaryPacketFilter
 {
-	INT8_UNSIGNED				m_DID;
-	INT8_UNSIGNED				m_SDID;
-	std::vector<INT8_UNSIGNED>	m_data;
+public:
+	AncillaryPacketFilter() :
+		m_selectAll(true)
+	{
+		m_selected.set();
+	}
+
+	// Add "DID" (any SDID) or "DID:SDID" in hexadecimal to the set, the first added replaces the default of all packets
+	bool add(const char* filterString)
+	{
+		char*			end;
+		unsigned long	did		= strtoul(filterString, &end, 16);
+		unsigned long	sdid	= 0;
+		bool			anySDID	= true;
+
+		if (end == filterString || did > 0xFF)
+			return false;
+
+		if (*end == ':')
+		{
+			const char* sdidString = end + 1;
+			sdid = strtoul(sdidString, &end, 16);
+			if (end == sdidString || sdid > 0xFF)
+				return false;
+			anySDID = false;
+		}
+
+		if (*end != '\0')
+			return false;
+
+		if (m_selectAll)
+		{
+			m_selected.reset();
+			m_selectAll = false;
+		}
+
+		if (anySDID)
+		{
+			for (INT32_UNSIGNED i = 0; i < 0x100; i++)
+				m_selected.set((did << 8) | i);
+		}
+		else
+			m_selected.set((did << 8) | sdid);
+
+		return true;
+	}
+
+	bool contains(INT8_UNSIGNED did, INT8_UNSIGNED sdid) const
+	{
+		return m_selected.test((did << 8) | sdid);
+	}
+
+private:
+	std::bitset<0x10000>	m_selected;
+	bool					m_selectAll;
 };
 
-bool operator==(const AncillaryPacket& lhs, const AncillaryPacket& rhs)
+// An ancillary packet of a frame.  The data is not copied, it refers to the buffer of the
+// packet, which is only referenced until the frame's changes have been reported.
+struct AncillaryPacketRecord
 {
-	return lhs.m_DID == rhs.m_DID && lhs.m_SDID == rhs.m_SDID && lhs.m_data == rhs.m_data;
-}
+	INT64_UNSIGNED				m_key;		// Line number, DID, SDID and occurrence on the line, in sort order
+	INT64_UNSIGNED				m_hash;		// FNV-1a hash of the data
+	IDeckLinkAncillaryPacket*	m_packet;
+	const INT8_UNSIGNED*		m_data;
+	INT32_UNSIGNED				m_size;
 
-bool operator!=(const AncillaryPacket& lhs, const AncillaryPacket& rhs)
+	INT32_UNSIGNED	lineNumber() const	{ return (INT32_UNSIGNED)(m_key >> 32); }
+	INT8_UNSIGNED	did() const			{ return (INT8_UNSIGNED)(m_key >> 24); }
+	INT8_UNSIGNED	sdid() const		{ return (INT8_UNSIGNED)(m_key >> 16); }
+
+	bool operator<(const AncillaryPacketRecord& other) const
+	{
+		return m_key < other.m_key;
+	}
+};
+
+// The packets of one frame.  Records are bump allocated from a fixed capacity array that is
+// reset rather than freed for each frame, so capture does no heap allocation once running.
+class AncillaryPacketStore
 {
-	return !(lhs == rhs);
-}
+public:
+	explicit AncillaryPacketStore(INT32_UNSIGNED capacity) :
+		m_records(capacity),
+		m_count(0)
+	{
+	}
+
+	~AncillaryPacketStore()
+	{
+		releasePackets();
+	}
+
+	// Add a packet, the store takes the reference.  Returns false if the store is full.
+	bool add(IDeckLinkAncillaryPacket* packet, const INT8_UNSIGNED* data, INT32_UNSIGNED size)
+	{
+		if (m_count == m_records.size())
+			return false;
+
+		AncillaryPacketRecord& record = m_records[m_count];
+
+		// Until the store is sorted the low bits of the key hold the arrival order
+		record.m_key	= ((INT64_UNSIGNED)packet->GetLineNumber() << 32) | ((INT64_UNSIGNED)packet->GetDID() << 24) | ((INT64_UNSIGNED)packet->GetSDID() << 16) | m_count;
+		record.m_hash	= hash(data, size);
+		record.m_packet	= packet;
+		record.m_data	= data;
+		record.m_size	= size;
+
+		m_count++;
+		return true;
+	}
+
+	// Sort the records by line, DID and SDID, numbering repeated packets in arrival order
+	void sort()
+	{
+		AncillaryPacketRecord* records = m_records.data();
+
+		if (!std::is_sorted(records, records + m_count))
+			std::sort(records, records + m_count);
+
+		INT32_UNSIGNED occurrence = 0;
+		for (INT32_UNSIGNED i = 0; i < m_count; i++)
+		{
+			if (i > 0 && (m_records[i].m_key >> 16) == (m_records[i - 1].m_key >> 16))
+				occurrence++;
+			else
+				occurrence = 0;
+
+			m_records[i].m_key = (m_records[i].m_key & ~(INT64_UNSIGNED)0xFFFF) | occurrence;
+		}
+	}
+
+	// Release the packets once the data is no longer needed, keeping the keys and hashes for comparison
+	void releasePackets()
+	{
+		for (INT32_UNSIGNED i = 0; i < m_count; i++)
+		{
+			if (m_records[i].m_packet != nullptr)
+				m_records[i].m_packet->Release();
+			m_records[i].m_packet	= nullptr;
+			m_records[i].m_data		= nullptr;
+		}
+	}
+
+	void reset()
+	{
+		releasePackets();
+		m_count = 0;
+	}
+
+	void swap(AncillaryPacketStore& other)
+	{
+		m_records.swap(other.m_records);
+		std::swap(m_count, other.m_count);
+	}
+
+	const AncillaryPacketRecord*	begin() const	{ return m_records.data(); }
+	const AncillaryPacketRecord*	end() const		{ return m_records.data() + m_count; }
+	INT32_UNSIGNED					size() const	{ return m_count; }
+
+private:
+	std::vector<AncillaryPacketRecord>	m_records;
+	INT32_UNSIGNED						m_count;
+
+	static INT64_UNSIGNED hash(const INT8_UNSIGNED* data, INT32_UNSIGNED size)
+	{
+		INT64_UNSIGNED value = 0xcbf29ce484222325ULL;
+		for (INT32_UNSIGNED i = 0; i < size; i++)
+			value = (value ^ data[i]) * 0x100000001b3ULL;
+		return value;
+	}
+};
 
 // The input callback class
 class InputCallback : public IDeckLinkInputCallback
 {
 public:
-	InputCallback(IDeckLinkInput *deckLinkInput) :
+	InputCallback(IDeckLinkInput *deckLinkInput, unsigned inputIndex, const AncillaryPacketFilter& filter) :
 		m_deckLinkInput(deckLinkInput),
+		m_inputIndex(inputIndex),
+		m_filter(filter),
+		m_packets(kMaxAncillaryPacketsPerFrame),
+		m_prevPackets(kMaxAncillaryPacketsPerFrame),
+		m_frameCount(0),
+		m_packetCount(0),
+		m_changeCount(0),
+		m_droppedPacketCount(0),
 		m_refCount(1)
 	{
 	}
@@ -122,10 +294,25 @@ public:
 		return newRefValue;
 	}
 
+	void		PrintStatistics()
+	{
+		printf("Input %u: %llu frames, %llu packets, %llu changes logged, %llu packets dropped\n", m_inputIndex,
+			(unsigned long long)m_frameCount, (unsigned long long)m_packetCount, (unsigned long long)m_changeCount, (unsigned long long)m_droppedPacketCount);
+	}
+
 private:
-	IDeckLinkInput*											m_deckLinkInput;
-	std::map<INT32_UNSIGNED, std::vector<AncillaryPacket>>	m_prevAncillaryPackets;
-	std::atomic<ULONG>										m_refCount;
+	IDeckLinkInput*					m_deckLinkInput;
+	unsigned						m_inputIndex;
+	const AncillaryPacketFilter&	m_filter;
+	AncillaryPacketStore			m_packets;
+	AncillaryPacketStore			m_prevPackets;
+	INT64_UNSIGNED					m_frameCount;
+	INT64_UNSIGNED					m_packetCount;
+	INT64_UNSIGNED					m_changeCount;
+	INT64_UNSIGNED					m_droppedPacketCount;
+	std::atomic<ULONG>				m_refCount;
+
+	void		LogChange(char change, const AncillaryPacketRecord& record);
 };
 
 HRESULT InputCallback::VideoInputFormatChanged(BMDVideoInputFormatChangedEvents notificationEvents, IDeckLinkDisplayMode *newDisplayMode, BMDDetectedVideoInputFormatFlags detectedSignalFlags)
@@ -135,11 +322,12 @@ HRESULT InputCallback::VideoInputFormatChanged(BMDVideoInputFormatChangedEvents
 
 HRESULT InputCallback::VideoInputFrameArrived(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkAudioInputPacket* audioPacket)
 {
-	std::map<INT32_UNSIGNED, std::vector<AncillaryPacket>>	capturedAncillaryPackets;
-	IDeckLinkVideoFrameAncillaryPackets*					videoFrameAncillaryPackets	= nullptr;
-	IDeckLinkAncillaryPacketIterator*						ancillaryPacketIterator		= nullptr;
-	IDeckLinkAncillaryPacket*								ancillaryPacket				= nullptr;
-	HRESULT													result;
+	IDeckLinkVideoFrameAncillaryPackets*	videoFrameAncillaryPackets	= nullptr;
+	IDeckLinkAncillaryPacketIterator*		ancillaryPacketIterator		= nullptr;
+	IDeckLinkAncillaryPacket*				ancillaryPacket				= nullptr;
+	const AncillaryPacketRecord*			prevRecord;
+	const AncillaryPacketRecord*			record;
+	HRESULT									result;
 
 	if (!videoFrame || (videoFrame->GetFlags() & bmdFrameHasNoInputSource))
 		return S_OK;
@@ -157,59 +345,58 @@ HRESULT InputCallback::VideoInputFrameArrived(IDeckLinkVideoInputFrame* videoFra
 		goto bail;
 	}
 
+	m_frameCount++;
+
+	// Reference the packets of this frame without copying their data
 	while (ancillaryPacketIterator->Next(&ancillaryPacket) == S_OK)
 	{
-		INT32_UNSIGNED	ancillaryBufferSize;
-		INT8_UNSIGNED*	ancillaryBufferPtr;
+		INT32_UNSIGNED			ancillaryBufferSize;
+		const INT8_UNSIGNED*	ancillaryBufferPtr;
 
-		if (ancillaryPacket->GetBytes(kAncillaryFormat, (const void**)&ancillaryBufferPtr, &ancillaryBufferSize) == S_OK)
+		m_packetCount++;
+
+		if (m_filter.contains(ancillaryPacket->GetDID(), ancillaryPacket->GetSDID()) &&
+			ancillaryPacket->GetBytes(kAncillaryFormat, (const void**)&ancillaryBufferPtr, &ancillaryBufferSize) == S_OK)
 		{
-			std::vector<INT8_UNSIGNED> ancillaryBuffer(ancillaryBufferPtr, ancillaryBufferPtr + ancillaryBufferSize);
-			capturedAncillaryPackets[ancillaryPacket->GetLineNumber()].push_back({ ancillaryPacket->GetDID(), ancillaryPacket->GetSDID(), std::move(ancillaryBuffer) });
+			if (m_packets.add(ancillaryPacket, ancillaryBufferPtr, ancillaryBufferSize))
+				continue;
+
+			m_droppedPacketCount++;
 		}
 
 		ancillaryPacket->Release();
 	}
 
-	// Check any VANC lines that no longer have data
-	for (auto& ancillaryPacketLineIter : m_prevAncillaryPackets)
+	m_packets.sort();
+
+	// Both stores are sorted by line, DID, SDID and occurrence, so a single merge finds the packets
+	// that were removed, added or changed since the previous frame
+	prevRecord	= m_prevPackets.begin();
+	record		= m_packets.begin();
+
+	while (prevRecord != m_prevPackets.end() || record != m_packets.end())
 	{
-		auto vancLineSearch = capturedAncillaryPackets.find(ancillaryPacketLineIter.first);
-		if (vancLineSearch == capturedAncillaryPackets.end())
+		if (record == m_packets.end() || (prevRecord != m_prevPackets.end() && prevRecord->m_key < record->m_key))
 		{
-			std::string lineNumberStr = std::to_string(ancillaryPacketLineIter.first);
-			printf("Line %s:%*c<empty>\n", lineNumberStr.c_str(), 5-(int)lineNumberStr.length(), ' ');
+			LogChange('-', *prevRecord++);
 		}
-	}
-
-	// Check VANC lines that have new or modified data 
-	for (auto& ancillaryPacketLineIter : capturedAncillaryPackets)
-	{
-		auto vancLineSearch = m_prevAncillaryPackets.find(ancillaryPacketLineIter.first);
-		if ((vancLineSearch == m_prevAncillaryPackets.end()) || (vancLineSearch->second != ancillaryPacketLineIter.second))
+		else if (prevRecord == m_prevPackets.end() || record->m_key < prevRecord->m_key)
+		{
+			LogChange('+', *record++);
+		}
+		else
 		{
-			bool lineNumberPrinted = false;
-			for (auto& ancillaryPacketIter : ancillaryPacketLineIter.second)
-			{
-				if (!lineNumberPrinted)
-				{
-					std::string lineNumberStr = std::to_string(ancillaryPacketLineIter.first);
-					printf("Line %s:%*c", lineNumberStr.c_str(), 5-(int)lineNumberStr.length(), ' ');
-					lineNumberPrinted = true;
-				}
-				else
-					printf("%*c", 11, ' ');
-				printf("DID: %02x; ", ancillaryPacketIter.m_DID);
-				printf("SDID: %02x; ", ancillaryPacketIter.m_SDID);
-				printf("Data:");
-				for (int i = 0; i < (int)ancillaryPacketIter.m_data.size(); i++)
-					printf(" %02x", ancillaryPacketIter.m_data[i]);
-				printf("\n");
-			}
+			if (record->m_hash != prevRecord->m_hash || record->m_size != prevRecord->m_size)
+				LogChange('~', *record);
+			prevRecord++;
+			record++;
 		}
 	}
 
-	m_prevAncillaryPackets = std::move(capturedAncillaryPackets);
+	// Keep the keys and hashes of this frame for the next, the packets themselves are no longer needed
+	m_packets.releasePackets();
+	m_prevPackets.swap(m_packets);
+	m_packets.reset();
 
 bail:
 	if (ancillaryPacketIterator != nullptr)
@@ -221,15 +408,57 @@ bail:
 	return S_OK;
 }
 
+void InputCallback::LogChange(char change, const AncillaryPacketRecord& record)
+{
+	// Format the whole entry before writing it, so entries of different inputs do not interleave
+	char	entry[64 + 3 * 256];
+	int		length;
+
+	length = snprintf(entry, sizeof(entry), "Input %u Line %-5u %c DID: %02x; SDID: %02x", m_inputIndex, record.lineNumber(), change, record.did(), record.sdid());
+
+	if (record.m_data != nullptr)
+	{
+		length += snprintf(entry + length, sizeof(entry) - length, "; Data:");
+		for (INT32_UNSIGNED i = 0; i < record.m_size && length + 4 < (int)sizeof(entry); i++)
+			length += snprintf(entry + length, sizeof(entry) - length, " %02x", record.m_data[i]);
+	}
+
+	entry[length++] = '\n';
+	fwrite(entry, 1, length, stdout);
+
+	m_changeCount++;
+}
+
+struct CaptureInput
+{
+	IDeckLink*		deckLink;
+	IDeckLinkInput*	deckLinkInput;
+	InputCallback*	deckLinkInputCallback;
+	bool			started;
+};
+
 int		main (int argc, char** argv)
 {
-	IDeckLinkIterator*	deckLinkIterator		= nullptr;
-	IDeckLink*			deckLink				= nullptr;
-	IDeckLinkInput*		deckLinkInput			= nullptr;
-	InputCallback*		deckLinkInputCallback	= nullptr;
+	IDeckLinkIterator*			deckLinkIterator		= nullptr;
+	IDeckLink*					deckLink				= nullptr;
+	IDeckLinkInput*				deckLinkInput			= nullptr;
+	AncillaryPacketFilter		filter;
+	std::vector<CaptureInput>	inputs;
+	bool						inputStarted			= false;
 
 	HRESULT				result;
 	INT8_UNSIGNED		returnCode = 1;
+
+	// Optional arguments select the packets to monitor, as DID or DID:SDID in hexadecimal
+	for (int i = 1; i < argc; i++)
+	{
+		if (!filter.add(argv[i]))
+		{
+			fprintf(stderr, "Usage: %s [DID[:SDID] ...]\n", argv[0]);
+			fprintf(stderr, "    Log the changes to the VANC packets of every input, optionally only those with the given hexadecimal DID and SDID\n");
+			return 1;
+		}
+	}
 	
 	Initialize();
 
@@ -240,86 +469,102 @@ int		main (int argc, char** argv)
 		goto bail;
 	}
 
-	// Obtain the first DeckLink device
-	result = deckLinkIterator->Next(&deckLink);
-	if (result != S_OK)
+	// Obtain every DeckLink device with an input interface
+	while (deckLinkIterator->Next(&deckLink) == S_OK)
 	{
-		fprintf(stderr, "Could not find DeckLink device - result = %08x\n", result);
-		goto bail;
+		if (deckLink->QueryInterface(IID_IDeckLinkInput, (void**)&deckLinkInput) == S_OK)
+			inputs.push_back({ deckLink, deckLinkInput, nullptr, false });
+		else
+			deckLink->Release();
 	}
 
-	// Obtain the input interface for the DeckLink device
-	result = deckLink->QueryInterface(IID_IDeckLinkInput, (void**)&deckLinkInput);
-	if (result != S_OK)
+	if (inputs.empty())
 	{
-		fprintf(stderr, "Could not obtain the IDeckLinkInput interface - result = %08x\n", result);
+		fprintf(stderr, "Could not find a DeckLink device with an input\n");
 		goto bail;
 	}
 
-	// Create an instance of DeckLink Input callback
-	deckLinkInputCallback = new InputCallback(deckLinkInput);
-	if (deckLinkInputCallback == nullptr)
+	for (unsigned index = 0; index < inputs.size(); index++)
 	{
-		fprintf(stderr, "Could not create DeckLink input callback object\n");
-		goto bail;
-	}
+		CaptureInput& input = inputs[index];
 
-	// Set the callback object to the DeckLink device's input interface
-	result = deckLinkInput->SetCallback(deckLinkInputCallback);
-	if (result != S_OK)
-	{
-		fprintf(stderr, "Could not set callback - result = %08x\n", result);
-		goto bail;
-	}
+		// Create an instance of DeckLink Input callback
+		input.deckLinkInputCallback = new InputCallback(input.deckLinkInput, index, filter);
 
-	// Enable video input with a default video mode and the automatic format detection feature enabled
-	result = deckLinkInput->EnableVideoInput(kDisplayMode, kPixelFormat, bmdVideoInputFlagDefault);
-	if (result != S_OK)
-	{
-		fprintf(stderr, "Could not enable video input - result = %08x\n", result);
-		goto bail;
+		// Set the callback object to the DeckLink device's input interface
+		result = input.deckLinkInput->SetCallback(input.deckLinkInputCallback);
+		if (result != S_OK)
+		{
+			fprintf(stderr, "Input %u: Could not set callback - result = %08x\n", index, result);
+			continue;
+		}
+
+		// Enable video input with a default video mode
+		result = input.deckLinkInput->EnableVideoInput(kDisplayMode, kPixelFormat, bmdVideoInputFlagDefault);
+		if (result != S_OK)
+		{
+			fprintf(stderr, "Input %u: Could not enable video input - result = %08x\n", index, result);
+			continue;
+		}
+
+		// Start capture
+		result = input.deckLinkInput->StartStreams();
+		if (result != S_OK)
+		{
+			fprintf(stderr, "Input %u: Could not start capture - result = %08x\n", index, result);
+			input.deckLinkInput->DisableVideoInput();
+			continue;
+		}
+
+		input.started	= true;
+		inputStarted	= true;
 	}
 
-	// Start capture
-	result = deckLinkInput->StartStreams();
-	if (result != S_OK)
-	{
-		fprintf(stderr, "Could not start capture - result = %08x\n", result);
+	if (!inputStarted)
 		goto bail;
-	}
 
-	printf("Capturing... Press <RETURN> to exit\n");
+	printf("Capturing from %u inputs... Press <RETURN> to exit\n", (unsigned)inputs.size());
 
 	getchar();
 
 	printf("Exiting.\n");
 
-	// Stop capture
-	result = deckLinkInput->StopStreams();
+	for (auto& input : inputs)
+	{
+		if (!input.started)
+			continue;
+
+		// Stop capture
+		result = input.deckLinkInput->StopStreams();
 
-	// Disable the video input interface
-	result = deckLinkInput->DisableVideoInput();
+		// Disable the video input interface
+		result = input.deckLinkInput->DisableVideoInput();
+
+		input.deckLinkInputCallback->PrintStatistics();
+	}
 
 	// return success
 	returnCode = 0;
 
 	// Release resources
 bail:
-	// Release the video input interface
-	if (deckLinkInput != nullptr)
-		deckLinkInput->Release();
+	for (auto& input : inputs)
+	{
+		// Release the video input interface
+		input.deckLinkInput->SetCallback(nullptr);
+		input.deckLinkInput->Release();
+
+		// Release the Decklink object
+		input.deckLink->Release();
 
-	// Release the Decklink object
-	if (deckLink != nullptr)
-		deckLink->Release();
+		// Release the DeckLink Input callback object
+		if (input.deckLinkInputCallback != nullptr)
+			input.deckLinkInputCallback->Release();
+	}
 
 	// Release the DeckLink iterator
 	if (deckLinkIterator != nullptr)
 		deckLinkIterator->Release();
-
-	// Release the DeckLink Input callback object
-	if (deckLinkInputCallback != nullptr)
-		deckLinkInputCallback->Release();
  
 	return returnCode;
 }
@@ -0,0 +1,359 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include "AudioIdent.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const float		kToneGain			= 0.75f;		// -2.5 dBFS
+	const float		kIdentGain			= 0.5f;			// -6 dBFS
+	const float		kPinkNoiseGain		= 0.0575f;		// About -20 dBFS RMS
+	const double	kToneFrequency		= 1000.0;
+
+	const uint32_t	kBeepPeriodBlocks	= 100;			// 100 ms
+	const uint32_t	kBeepOnBlocks		= 50;
+	const uint32_t	kBeepPauseBeeps		= 5;			// Pause between beep sequences, in beep periods
+
+	const double	kSweepStartFrequency	= 20.0;
+	const double	kSweepEndFrequency		= 20000.0;
+	const uint32_t	kSweepBlocks			= 10000;	// 10 seconds
+
+	const struct { AudioIdent ident; const char* name; } kAudioIdentNames[] =
+	{
+		{ kAudioIdentTone,			"tone" },
+		{ kAudioIdentChannelTones,	"channels" },
+		{ kAudioIdentChannelBeeps,	"beeps" },
+		{ kAudioIdentPinkNoise,		"pink" },
+		{ kAudioIdentSweep,			"sweep" },
+	};
+}
+
+AudioIdentGenerator::AudioIdentGenerator(AudioIdent ident, uint32_t channelCount, uint32_t sampleBits) :
+	m_ident(ident),
+	m_channelCount(std::min(std::max(channelCount, 1u), kAudioIdentMaxChannels)),
+	m_sampleBits(sampleBits)
+{
+	Reset();
+}
+
+void AudioIdentGenerator::Reset(void)
+{
+	m_blockCount	= 0;
+	m_blockOffset	= kBlockFrames;
+
+	for (uint32_t channel = 0; channel < kAudioIdentMaxChannels; channel++)
+	{
+		m_phase[channel]		= 0.0;
+		m_real[channel]			= 1.0f;
+		m_imaginary[channel]	= 0.0f;
+		m_cosine[channel]		= 1.0f;
+		m_sine[channel]			= 0.0f;
+		m_gain[channel]			= 0.0f;
+
+		// Xorshift state must not be zero, each channel has its own sequence
+		m_noiseState[channel]	= 0x9E3779B9u * (channel + 1) | 1;
+		m_pinkState[0][channel]	= 0.0f;
+		m_pinkState[1][channel]	= 0.0f;
+		m_pinkState[2][channel]	= 0.0f;
+	}
+}
+
+double AudioIdentGenerator::GetChannelFrequency(uint32_t channel)
+{
+	return 500.0 + 250.0 * channel;
+}
+
+bool AudioIdentGenerator::GetIdentFromName(const char* name, AudioIdent& ident)
+{
+	for (auto& identName : kAudioIdentNames)
+	{
+		if (strcmp(name, identName.name) == 0)
+		{
+			ident = identName.ident;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* AudioIdentGenerator::GetIdentName(AudioIdent ident)
+{
+	for (auto& identName : kAudioIdentNames)
+	{
+		if (identName.ident == ident)
+			return identName.name;
+	}
+	return "unknown";
+}
+
+void AudioIdentGenerator::Generate(void* buffer, uint32_t sampleFrameCount)
+{
+	uint8_t*	output		= (uint8_t*)buffer;
+	uint32_t	frameBytes	= m_channelCount * GetSampleBytes();
+
+	while (sampleFrameCount > 0)
+	{
+		if (m_blockOffset == kBlockFrames)
+		{
+			if (m_ident == kAudioIdentPinkNoise)
+			{
+				GeneratePinkNoise(m_block);
+			}
+			else
+			{
+				StartBlock();
+				GenerateTones(m_block);
+			}
+			m_blockCount++;
+			m_blockOffset = 0;
+		}
+
+		uint32_t frameCount = std::min(sampleFrameCount, kBlockFrames - m_blockOffset);
+
+		ConvertSamples(&m_block[m_blockOffset * m_channelCount], output, frameCount * m_channelCount);
+
+		output				+= frameCount * frameBytes;
+		m_blockOffset		+= frameCount;
+		sampleFrameCount	-= frameCount;
+	}
+}
+
+void AudioIdentGenerator::StartBlock(void)
+{
+	for (uint32_t channel = 0; channel < m_channelCount; channel++)
+	{
+		double	frequency	= kToneFrequency;
+		float	gain		= kIdentGain;
+
+		switch (m_ident)
+		{
+			case kAudioIdentTone:
+				gain = kToneGain;
+				break;
+
+			case kAudioIdentChannelTones:
+				frequency = GetChannelFrequency(channel);
+				break;
+
+			case kAudioIdentChannelBeeps:
+			{
+				// Each beep is a whole number of 1 kHz cycles, so it starts and ends at zero
+				uint64_t	cycleBlocks	= (uint64_t)(m_channelCount + kBeepPauseBeeps) * kBeepPeriodBlocks;
+				uint64_t	position	= m_blockCount % cycleBlocks;
+				bool		beepOn		= (position / kBeepPeriodBlocks < channel + 1) && (position % kBeepPeriodBlocks < kBeepOnBlocks);
+
+				gain = beepOn ? kIdentGain : 0.0f;
+				break;
+			}
+
+			case kAudioIdentSweep:
+			{
+				uint64_t	offset		= (uint64_t)channel * kSweepBlocks / m_channelCount;
+				double		position	= (double)((m_blockCount + offset) % kSweepBlocks) / kSweepBlocks;
+
+				frequency = kSweepStartFrequency * pow(kSweepEndFrequency / kSweepStartFrequency, position);
+				break;
+			}
+
+			default:
+				break;
+		}
+
+		double step = 2.0 * M_PI * frequency / kAudioIdentSampleRate;
+
+		m_real[channel]			= (float)cos(m_phase[channel]);
+		m_imaginary[channel]	= (float)sin(m_phase[channel]);
+		m_cosine[channel]		= (float)cos(step);
+		m_sine[channel]			= (float)sin(step);
+		m_gain[channel]			= gain;
+		m_phase[channel]		= fmod(m_phase[channel] + step * kBlockFrames, 2.0 * M_PI);
+	}
+}
+
+void AudioIdentGenerator::GenerateTones(float* samples)
+{
+	uint32_t vectorChannels = 0;
+
+#if defined(__SSE2__)
+	// Four channels at a time, the phasors stay in the state arrays between samples
+	vectorChannels = m_channelCount & ~3u;
+
+	for (uint32_t frame = 0; frame < kBlockFrames; frame++)
+	{
+		float* frameSamples = samples + frame * m_channelCount;
+
+		for (uint32_t channel = 0; channel < vectorChannels; channel += 4)
+		{
+			__m128 real			= _mm_load_ps(&m_real[channel]);
+			__m128 imaginary	= _mm_load_ps(&m_imaginary[channel]);
+			__m128 cosine		= _mm_load_ps(&m_cosine[channel]);
+			__m128 sine			= _mm_load_ps(&m_sine[channel]);
+
+			_mm_storeu_ps(&frameSamples[channel], _mm_mul_ps(imaginary, _mm_load_ps(&m_gain[channel])));
+			_mm_store_ps(&m_real[channel], _mm_sub_ps(_mm_mul_ps(real, cosine), _mm_mul_ps(imaginary, sine)));
+			_mm_store_ps(&m_imaginary[channel], _mm_add_ps(_mm_mul_ps(real, sine), _mm_mul_ps(imaginary, cosine)));
+		}
+	}
+#endif
+
+	for (uint32_t channel = vectorChannels; channel < m_channelCount; channel++)
+	{
+		float real		= m_real[channel];
+		float imaginary	= m_imaginary[channel];
+
+		for (uint32_t frame = 0; frame < kBlockFrames; frame++)
+		{
+			float nextReal = real * m_cosine[channel] - imaginary * m_sine[channel];
+
+			samples[frame * m_channelCount + channel] = imaginary * m_gain[channel];
+			imaginary	= real * m_sine[channel] + imaginary * m_cosine[channel];
+			real		= nextReal;
+		}
+	}
+}
+
+void AudioIdentGenerator::GeneratePinkNoise(float* samples)
+{
+	// Paul Kellet's economy pink noise filter of xorshift white noise, each channel independent
+	uint32_t vectorChannels = 0;
+
+#if defined(__SSE2__)
+	vectorChannels = m_channelCount & ~3u;
+
+	const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+
+	for (uint32_t frame = 0; frame < kBlockFrames; frame++)
+	{
+		float* frameSamples = samples + frame * m_channelCount;
+
+		for (uint32_t channel = 0; channel < vectorChannels; channel += 4)
+		{
+			__m128i state = _mm_load_si128((const __m128i*)&m_noiseState[channel]);
+			state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+			state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+			state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+			_mm_store_si128((__m128i*)&m_noiseState[channel], state);
+
+			__m128 white	= _mm_mul_ps(_mm_cvtepi32_ps(state), scale);
+			__m128 b0		= _mm_add_ps(_mm_mul_ps(_mm_load_ps(&m_pinkState[0][channel]), _mm_set1_ps(0.99765f)), _mm_mul_ps(white, _mm_set1_ps(0.0990460f)));
+			__m128 b1		= _mm_add_ps(_mm_mul_ps(_mm_load_ps(&m_pinkState[1][channel]), _mm_set1_ps(0.96300f)), _mm_mul_ps(white, _mm_set1_ps(0.2965164f)));
+			__m128 b2		= _mm_add_ps(_mm_mul_ps(_mm_load_ps(&m_pinkState[2][channel]), _mm_set1_ps(0.57000f)), _mm_mul_ps(white, _mm_set1_ps(1.0526913f)));
+			_mm_store_ps(&m_pinkState[0][channel], b0);
+			_mm_store_ps(&m_pinkState[1][channel], b1);
+			_mm_store_ps(&m_pinkState[2][channel], b2);
+
+			__m128 pink = _mm_add_ps(_mm_add_ps(b0, b1), _mm_add_ps(b2, _mm_mul_ps(white, _mm_set1_ps(0.1848f))));
+			_mm_storeu_ps(&frameSamples[channel], _mm_mul_ps(pink, _mm_set1_ps(kPinkNoiseGain)));
+		}
+	}
+#endif
+
+	for (uint32_t channel = vectorChannels; channel < m_channelCount; channel++)
+	{
+		for (uint32_t frame = 0; frame < kBlockFrames; frame++)
+		{
+			uint32_t state = m_noiseState[channel];
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			m_noiseState[channel] = state;
+
+			float white	= (int32_t)state / 2147483648.0f;
+			float b0	= m_pinkState[0][channel] = m_pinkState[0][channel] * 0.99765f + white * 0.0990460f;
+			float b1	= m_pinkState[1][channel] = m_pinkState[1][channel] * 0.96300f + white * 0.2965164f;
+			float b2	= m_pinkState[2][channel] = m_pinkState[2][channel] * 0.57000f + white * 1.0526913f;
+
+			samples[frame * m_channelCount + channel] = (b0 + b1 + b2 + white * 0.1848f) * kPinkNoiseGain;
+		}
+	}
+}
+
+void AudioIdentGenerator::ConvertSamples(const float* samples, void* buffer, uint32_t sampleCount)
+{
+	// Scale to the sample size, the largest 32-bit scale is the largest float below 2^31
+	float		scale	= (m_sampleBits == 16) ? 32767.0f : (m_sampleBits == 24) ? 8388607.0f : 2147483520.0f;
+	int			shift	= (m_sampleBits == 24) ? 8 : 0;
+	uint32_t	i		= 0;
+
+#if defined(__SSE2__)
+	const __m128 minimum	= _mm_set1_ps(-1.0f);
+	const __m128 maximum	= _mm_set1_ps(1.0f);
+	const __m128 scaleVector	= _mm_set1_ps(scale);
+
+	if (m_sampleBits == 16)
+	{
+		int16_t* output = (int16_t*)buffer;
+
+		for (; i + 8 <= sampleCount; i += 8)
+		{
+			__m128i low		= _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&samples[i]), minimum), maximum), scaleVector));
+			__m128i high	= _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&samples[i + 4]), minimum), maximum), scaleVector));
+			_mm_storeu_si128((__m128i*)&output[i], _mm_packs_epi32(low, high));
+		}
+	}
+	else
+	{
+		int32_t* output = (int32_t*)buffer;
+
+		for (; i + 4 <= sampleCount; i += 4)
+		{
+			__m128i value = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&samples[i]), minimum), maximum), scaleVector));
+			_mm_storeu_si128((__m128i*)&output[i], _mm_slli_epi32(value, shift));
+		}
+	}
+#endif
+
+	for (; i < sampleCount; i++)
+	{
+		int32_t value = (int32_t)lrintf(std::min(std::max(samples[i], -1.0f), 1.0f) * scale);
+
+		if (m_sampleBits == 16)
+			((int16_t*)buffer)[i] = (int16_t)value;
+		else
+			((int32_t*)buffer)[i] = (int32_t)((uint32_t)value << shift);
+	}
+}
@@ -0,0 +1,120 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// Multichannel audio ident generator.  Generates interleaved 16-bit, 24-bit (MSB-aligned in 32-bit
+// samples) or 32-bit integer audio for 1 to kAudioIdentMaxChannels channels, with a different
+// signal on each channel so routing errors can be identified on capture:
+//
+//  tone		1 kHz at -2.5 dBFS on every channel, the tone of the original samples
+//  channels	A different frequency on each channel, 500 Hz + 250 Hz per channel at -6 dBFS.
+//				Every frequency is a multiple of 250 Hz, so a 48 kHz video frame of audio holds a
+//				whole number of cycles at the common frame rates
+//  beeps		1 kHz beeps at -6 dBFS, channel n beeps n times (50 ms on, 50 ms off), then pauses
+//  pink		Uncorrelated pink noise on every channel, about -20 dBFS RMS
+//  sweep		Logarithmic sweep from 20 Hz to 20 kHz over 10 seconds at -6 dBFS, each channel
+//				starting a fraction of the sweep later than the previous one
+//
+// Oscillators are a phasor per channel, rotated once per sample, with the phase held in double
+// precision and the phasor recalculated from it every block, so there is no amplitude or phase
+// drift.  Each sample of a block is calculated for all channels at once, with SSE2 on x86, and
+// written directly in the interleaved layout of the output buffer.
+
+static const uint32_t	kAudioIdentMaxChannels	= 64;
+static const uint32_t	kAudioIdentSampleRate	= 48000;
+
+enum AudioIdent
+{
+	kAudioIdentTone = 0,
+	kAudioIdentChannelTones,
+	kAudioIdentChannelBeeps,
+	kAudioIdentPinkNoise,
+	kAudioIdentSweep
+};
+
+class AudioIdentGenerator
+{
+public:
+	// sampleBits is 16, 24 or 32, with 24-bit samples in 32-bit containers
+	AudioIdentGenerator(AudioIdent ident, uint32_t channelCount, uint32_t sampleBits);
+
+	// Generate the next sampleFrameCount sample frames, continuing from the previous call
+	void				Generate(void* buffer, uint32_t sampleFrameCount);
+	void				Reset(void);
+
+	uint32_t			GetSampleBytes(void) const { return m_sampleBits == 16 ? 2 : 4; }
+
+	static bool			GetIdentFromName(const char* name, AudioIdent& ident);
+	static const char*	GetIdentName(AudioIdent ident);
+
+	// Frequency of each channel for kAudioIdentChannelTones
+	static double		GetChannelFrequency(uint32_t channel);
+
+private:
+	static const uint32_t	kBlockFrames = 48;		// 1 ms, beeps start and end on block boundaries
+
+	void				StartBlock(void);
+	void				GenerateTones(float* samples);
+	void				GeneratePinkNoise(float* samples);
+	void				ConvertSamples(const float* samples, void* buffer, uint32_t sampleCount);
+
+	AudioIdent			m_ident;
+	uint32_t			m_channelCount;
+	uint32_t			m_sampleBits;
+	uint64_t			m_blockCount;
+
+	// Per channel oscillator and noise state, padded to whole vectors
+	double				m_phase[kAudioIdentMaxChannels];
+	double				m_sweepPosition[kAudioIdentMaxChannels];
+	alignas(16) float	m_real[kAudioIdentMaxChannels];
+	alignas(16) float	m_imaginary[kAudioIdentMaxChannels];
+	alignas(16) float	m_cosine[kAudioIdentMaxChannels];
+	alignas(16) float	m_sine[kAudioIdentMaxChannels];
+	alignas(16) float	m_gain[kAudioIdentMaxChannels];
+	alignas(16) uint32_t	m_noiseState[kAudioIdentMaxChannels];
+	alignas(16) float	m_pinkState[3][kAudioIdentMaxChannels];
+
+	// A block generated but not yet written, for calls that are not a multiple of the block size
+	alignas(16) float	m_block[kBlockFrames * kAudioIdentMaxChannels];
+	uint32_t			m_blockOffset;
+};
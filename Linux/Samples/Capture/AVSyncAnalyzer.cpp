@@ -0,0 +1,419 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#include "AVSyncAnalyzer.h"
+#include "PixelPacking.h"
+
+// Video flash detection
+static const uint32_t	kFlashLevelRows			= 16;		// Rows averaged for the level of a frame
+static const uint32_t	kMinimumFlashContrast	= 0x2000;	// Between the darkest and brightest frames, 16-bit scale
+
+// Tone burst detection, levels are relative to full scale
+static const uint32_t	kAudioSampleRate		= 48000;
+static const float		kSilenceLevel			= 0.01f;	// -40 dBFS
+static const float		kOnsetLevel				= 0.05f;	// -26 dBFS
+static const uint32_t	kMinimumSilenceSamples	= 480;		// 10 ms of silence before a burst
+static const uint32_t	kMeasureSamples			= 240;		// 5 ms of burst to measure peak and frequency
+
+// A burst is paired with a flash up to half a pip period away
+static const double		kPairingWindow			= 0.5;
+
+AVSyncAnalyzer::AVSyncAnalyzer()
+{
+	Reset(2, 16, 40.0);
+}
+
+void AVSyncAnalyzer::Reset(uint32_t audioChannelCount, uint32_t audioSampleDepth, double alarmThreshold)
+{
+	m_audioChannelCount		= std::min(audioChannelCount, kAVSyncMaxChannels);
+	m_audioSampleDepth		= audioSampleDepth;
+	m_alarmThreshold		= alarmThreshold;
+
+	m_hasVideoLevels		= false;
+	m_lowLevel				= 0;
+	m_highLevel				= 0;
+	m_previousFlash			= true;		// A flash in the first frame has no known start
+
+	for (uint32_t channel = 0; channel < kAVSyncMaxChannels; channel++)
+	{
+		ChannelDetector& detector = m_channels[channel];
+
+		detector.state				= kOnsetStateActive;
+		detector.silentSamples		= 0;
+		detector.previousSample		= 0.0f;
+		detector.crossingTime		= 0.0;
+		detector.measuredSamples	= 0;
+		detector.peakLevel			= 0.0f;
+		detector.zeroCrossings		= 0;
+		detector.firstZeroCrossing	= 0.0;
+		detector.lastZeroCrossing	= 0.0;
+		detector.onsets.clear();
+	}
+
+	m_pendingFlashes.clear();
+	m_completedMeasurements.clear();
+	m_latestVideoTime		= 0.0;
+	m_latestAudioTime		= 0.0;
+
+	memset(&m_statistics, 0, sizeof(m_statistics));
+	m_offsetTotal			= 0.0;
+	memset(m_driftSums, 0, sizeof(m_driftSums));
+}
+
+bool AVSyncAnalyzer::GetFrameLevel(IDeckLinkVideoInputFrame* videoFrame, uint32_t& level)
+{
+	BMDPixelFormat	pixelFormat	= videoFrame->GetPixelFormat();
+	uint32_t		width		= (uint32_t)videoFrame->GetWidth();
+	uint32_t		height		= (uint32_t)videoFrame->GetHeight();
+	bool			yuv			= IsPixelFormatYUV(pixelFormat);
+	uint64_t		total		= 0;
+	void*			bytes;
+
+	if (!IsPixelPackingSupported(pixelFormat) || height < kFlashLevelRows || videoFrame->GetBytes(&bytes) != S_OK)
+		return false;
+
+	m_rowSamples.resize(width * 3);
+	uint16_t* planes[kPixelPlaneCount] = { &m_rowSamples[0], &m_rowSamples[width], &m_rowSamples[width * 2], NULL };
+
+	// Rows spread over the middle three quarters of the picture, clear of any code at the top
+	for (uint32_t i = 0; i < kFlashLevelRows; i++)
+	{
+		uint32_t y = height / 8 + (i * height * 3) / (4 * kFlashLevelRows);
+
+		if (!UnpackPixelRow(pixelFormat, (uint8_t*)bytes + y * videoFrame->GetRowBytes(), planes, width))
+			return false;
+
+		for (uint32_t x = 0; x < width; x++)
+		{
+			if (yuv)
+				total += planes[kPixelPlaneY][x];
+			else
+				total += ((uint32_t)planes[kPixelPlaneR][x] + 2 * (uint32_t)planes[kPixelPlaneG][x] + planes[kPixelPlaneB][x]) / 4;
+		}
+	}
+
+	level = (uint32_t)(total / ((uint64_t)width * kFlashLevelRows));
+	return true;
+}
+
+void AVSyncAnalyzer::AddVideoFrame(IDeckLinkVideoInputFrame* videoFrame, BMDTimeScale timeScale)
+{
+	BMDTimeValue	frameTime;
+	BMDTimeValue	frameDuration;
+	uint32_t		level;
+
+	if ((videoFrame->GetFlags() & bmdFrameHasNoInputSource) || timeScale == 0)
+	{
+		m_previousFlash = true;
+		return;
+	}
+
+	if (videoFrame->GetStreamTime(&frameTime, &frameDuration, timeScale) != S_OK || !GetFrameLevel(videoFrame, level))
+		return;
+
+	m_latestVideoTime = (double)frameTime / timeScale;
+
+	if (!m_hasVideoLevels)
+	{
+		m_lowLevel			= level;
+		m_highLevel			= level;
+		m_hasVideoLevels	= true;
+	}
+	m_lowLevel	= std::min(m_lowLevel, level);
+	m_highLevel	= std::max(m_highLevel, level);
+
+	// The flash starts on the first frame above the threshold
+	bool flash = (m_highLevel - m_lowLevel >= kMinimumFlashContrast) && (level > (m_lowLevel + m_highLevel) / 2);
+
+	if (flash && !m_previousFlash)
+	{
+		AVSyncMeasurement measurement;
+
+		memset(&measurement, 0, sizeof(measurement));
+		measurement.flashCount		= ++m_statistics.flashCount;
+		measurement.flashTime		= m_latestVideoTime;
+		measurement.channelCount	= m_audioChannelCount;
+
+		m_pendingFlashes.push_back(measurement);
+		PairBursts();
+	}
+
+	m_previousFlash = flash;
+}
+
+void AVSyncAnalyzer::AddAudioPacket(IDeckLinkAudioInputPacket* audioPacket)
+{
+	BMDTimeValue	packetTime;
+	void*			bytes;
+	uint32_t		sampleFrameCount = (uint32_t)audioPacket->GetSampleFrameCount();
+
+	if (audioPacket->GetPacketTime(&packetTime, kAudioSampleRate) != S_OK || audioPacket->GetBytes(&bytes) != S_OK)
+		return;
+
+	for (uint32_t i = 0; i < sampleFrameCount; i++)
+	{
+		for (uint32_t channel = 0; channel < m_audioChannelCount; channel++)
+		{
+			float sample;
+
+			if (m_audioSampleDepth == 16)
+				sample = ((int16_t*)bytes)[i * m_audioChannelCount + channel] / 32768.0f;
+			else
+				sample = ((int32_t*)bytes)[i * m_audioChannelCount + channel] / 2147483648.0f;
+
+			AddSample(channel, sample, (uint64_t)packetTime + i);
+		}
+	}
+
+	m_latestAudioTime = (double)(packetTime + sampleFrameCount) / kAudioSampleRate;
+	PairBursts();
+}
+
+void AVSyncAnalyzer::AddSample(uint32_t channel, float sample, uint64_t sampleTime)
+{
+	ChannelDetector&	detector	= m_channels[channel];
+	float				level		= fabsf(sample);
+	float				previous	= detector.previousSample;
+
+	switch (detector.state)
+	{
+		case kOnsetStateActive:
+			break;
+
+		case kOnsetStateArmed:
+			if (level >= kOnsetLevel)
+			{
+				// Interpolate the time the signal rose through the onset level
+				float previousLevel = fabsf(previous);
+
+				detector.crossingTime		= (double)sampleTime - 1.0 + (kOnsetLevel - previousLevel) / (level - previousLevel);
+				detector.measuredSamples	= 0;
+				detector.peakLevel			= level;
+				detector.zeroCrossings		= 0;
+				detector.state				= kOnsetStateMeasuring;
+			}
+			break;
+
+		case kOnsetStateMeasuring:
+			detector.peakLevel = std::max(detector.peakLevel, level);
+
+			if ((previous < 0.0f && sample >= 0.0f) || (previous > 0.0f && sample <= 0.0f))
+			{
+				double zeroCrossing = (double)sampleTime - 1.0 + previous / (previous - sample);
+
+				if (detector.zeroCrossings == 0)
+					detector.firstZeroCrossing = zeroCrossing;
+				detector.lastZeroCrossing = zeroCrossing;
+				detector.zeroCrossings++;
+			}
+
+			if (++detector.measuredSamples >= kMeasureSamples)
+			{
+				double onsetTime = detector.crossingTime;
+
+				// A sine starting from zero reaches the onset level after asin(onset / peak) radians
+				if (detector.zeroCrossings >= 3 && detector.lastZeroCrossing > detector.firstZeroCrossing)
+				{
+					double frequency	= (detector.zeroCrossings - 1) / (2.0 * (detector.lastZeroCrossing - detector.firstZeroCrossing));
+					double phase		= asin(std::min(1.0, (double)kOnsetLevel / detector.peakLevel));
+
+					onsetTime -= phase / (2.0 * M_PI * frequency);
+				}
+
+				AddOnset(channel, onsetTime / kAudioSampleRate);
+				detector.state = kOnsetStateActive;
+			}
+			break;
+	}
+
+	// A burst can only start after a period of silence
+	if (level < kSilenceLevel)
+	{
+		if (++detector.silentSamples >= kMinimumSilenceSamples && detector.state == kOnsetStateActive)
+			detector.state = kOnsetStateArmed;
+	}
+	else
+	{
+		detector.silentSamples = 0;
+	}
+
+	detector.previousSample = sample;
+}
+
+void AVSyncAnalyzer::AddOnset(uint32_t channel, double onsetTime)
+{
+	m_channels[channel].onsets.push_back(onsetTime);
+}
+
+void AVSyncAnalyzer::PairBursts(void)
+{
+	// Pair bursts with the nearest pending flash
+	for (uint32_t channel = 0; channel < m_audioChannelCount; channel++)
+	{
+		std::deque<double>& onsets = m_channels[channel].onsets;
+
+		while (!onsets.empty())
+		{
+			double				onsetTime	= onsets.front();
+			AVSyncMeasurement*	nearest		= NULL;
+
+			for (AVSyncMeasurement& measurement : m_pendingFlashes)
+			{
+				if (!measurement.channelFound[channel] && fabs(onsetTime - measurement.flashTime) <= kPairingWindow &&
+					(nearest == NULL || fabs(onsetTime - measurement.flashTime) < fabs(onsetTime - nearest->flashTime)))
+					nearest = &measurement;
+			}
+
+			if (nearest != NULL)
+			{
+				nearest->channelFound[channel]	= true;
+				nearest->channelOffset[channel]	= (onsetTime - nearest->flashTime) * 1000.0;
+			}
+			else if (onsetTime + kPairingWindow >= m_latestVideoTime)
+			{
+				// The flash for this burst may not have arrived yet
+				break;
+			}
+			else
+			{
+				m_statistics.unpairedBurstCount++;
+			}
+
+			onsets.pop_front();
+		}
+	}
+
+	// Complete flashes in order, once every channel is paired or no more bursts can be paired
+	while (!m_pendingFlashes.empty())
+	{
+		AVSyncMeasurement&	measurement	= m_pendingFlashes.front();
+		bool				allFound	= true;
+
+		for (uint32_t channel = 0; channel < m_audioChannelCount; channel++)
+			allFound = allFound && measurement.channelFound[channel];
+
+		if (!allFound && m_latestAudioTime <= measurement.flashTime + kPairingWindow)
+			break;
+
+		CompleteFlash(measurement);
+		m_completedMeasurements.push_back(measurement);
+		m_pendingFlashes.pop_front();
+	}
+}
+
+void AVSyncAnalyzer::CompleteFlash(AVSyncMeasurement& measurement)
+{
+	uint32_t	foundCount		= 0;
+	double		offsetTotal		= 0.0;
+	double		minOffset		= 0.0;
+	double		maxOffset		= 0.0;
+
+	for (uint32_t channel = 0; channel < measurement.channelCount; channel++)
+	{
+		if (!measurement.channelFound[channel])
+			continue;
+
+		double offset = measurement.channelOffset[channel];
+
+		minOffset		= (foundCount == 0) ? offset : std::min(minOffset, offset);
+		maxOffset		= (foundCount == 0) ? offset : std::max(maxOffset, offset);
+		offsetTotal		+= offset;
+		foundCount++;
+	}
+
+	measurement.offset		= (foundCount > 0) ? offsetTotal / foundCount : 0.0;
+	measurement.channelSkew	= maxOffset - minOffset;
+	measurement.alarm		= (foundCount < measurement.channelCount) || (fabs(measurement.offset) > m_alarmThreshold);
+
+	if (foundCount < measurement.channelCount)
+		m_statistics.missingBurstCount++;
+
+	if (measurement.alarm)
+		m_statistics.alarmCount++;
+
+	if (foundCount == 0)
+		return;
+
+	// Accumulate the least squares fit of offset over stream time
+	double t = measurement.flashTime;
+	double o = measurement.offset;
+
+	m_driftSums[0] += 1.0;
+	m_driftSums[1] += t;
+	m_driftSums[2] += o;
+	m_driftSums[3] += t * t;
+	m_driftSums[4] += t * o;
+
+	m_statistics.minOffset			= (m_statistics.measurementCount == 0) ? o : std::min(m_statistics.minOffset, o);
+	m_statistics.maxOffset			= (m_statistics.measurementCount == 0) ? o : std::max(m_statistics.maxOffset, o);
+	m_statistics.lastOffset			= o;
+	m_statistics.maxChannelSkew		= std::max(m_statistics.maxChannelSkew, measurement.channelSkew);
+	m_statistics.measurementCount++;
+	m_offsetTotal					+= o;
+}
+
+bool AVSyncAnalyzer::GetMeasurement(AVSyncMeasurement& measurement)
+{
+	if (m_completedMeasurements.empty())
+		return false;
+
+	measurement = m_completedMeasurements.front();
+	m_completedMeasurements.pop_front();
+	return true;
+}
+
+void AVSyncAnalyzer::GetStatistics(AVSyncStatistics& statistics)
+{
+	double n			= m_driftSums[0];
+	double denominator	= n * m_driftSums[3] - m_driftSums[1] * m_driftSums[1];
+
+	statistics				= m_statistics;
+	statistics.meanOffset	= (m_statistics.measurementCount > 0) ? m_offsetTotal / m_statistics.measurementCount : 0.0;
+
+	// Milliseconds per second of stream time, to milliseconds per hour
+	if (n >= 2.0 && denominator > 0.0)
+		statistics.driftPerHour = (n * m_driftSums[4] - m_driftSums[1] * m_driftSums[2]) / denominator * 3600.0;
+	else
+		statistics.driftPerHour = 0.0;
+}
@@ -0,0 +1,159 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __AV_SYNC_ANALYZER_H__
+#define __AV_SYNC_ANALYZER_H__
+
+#include <deque>
+#include <stdint.h>
+#include <vector>
+
+#include "DeckLinkAPI.h"
+
+// Measures the A/V sync (lip sync) offset of a pip signal, as output by TestPattern and
+// SignalGenerator in pip mode: a flash of colour bars on one frame each second, with a burst of
+// tone on every audio channel starting at the same time.
+//
+// The flash is found from the mean luma of a few rows of each frame, rising above a threshold
+// halfway between the darkest and brightest frames seen.  Its time is the stream time of the
+// frame, so it is only frame accurate.  The start of each tone burst is found per channel with
+// sub-sample precision: the time at which the signal first rises out of silence above the onset
+// level is interpolated between samples, then moved back to the start of the sine by the phase
+// at which a sine of the measured peak and frequency reaches the onset level.
+//
+// Each flash is paired with the nearest burst on each channel within half a second.  A positive
+// offset means the audio is late.  The drift of the offset is the least squares slope of the
+// offset over the stream time of the flashes.  Video frames and audio packets are added from the
+// capture callback, completed measurements are then read with GetMeasurement().
+
+static const uint32_t	kAVSyncMaxChannels		= 16;
+
+struct AVSyncMeasurement
+{
+	uint64_t	flashCount;
+	double		flashTime;							// Seconds of stream time
+	uint32_t	channelCount;
+	bool		channelFound[kAVSyncMaxChannels];	// False if no burst was found on the channel
+	double		channelOffset[kAVSyncMaxChannels];	// Milliseconds, positive if the audio is late
+	double		offset;								// Mean offset of the channels found
+	double		channelSkew;						// Largest difference between channel offsets
+	bool		alarm;								// The offset is beyond the alarm threshold, or no burst was found
+};
+
+struct AVSyncStatistics
+{
+	uint64_t	flashCount;
+	uint64_t	measurementCount;					// Flashes paired with a burst on at least one channel
+	uint64_t	missingBurstCount;					// Flashes without a burst on one or more channels
+	uint64_t	unpairedBurstCount;					// Bursts without a flash
+	uint64_t	alarmCount;
+	double		minOffset;
+	double		maxOffset;
+	double		meanOffset;
+	double		lastOffset;
+	double		driftPerHour;						// Milliseconds of offset change per hour
+	double		maxChannelSkew;
+};
+
+class AVSyncAnalyzer
+{
+public:
+	AVSyncAnalyzer();
+	virtual ~AVSyncAnalyzer() {}
+
+	void	Reset(uint32_t audioChannelCount, uint32_t audioSampleDepth, double alarmThreshold);
+
+	void	AddVideoFrame(IDeckLinkVideoInputFrame* videoFrame, BMDTimeScale timeScale);
+	void	AddAudioPacket(IDeckLinkAudioInputPacket* audioPacket);
+
+	// Returns false when there are no more completed measurements
+	bool	GetMeasurement(AVSyncMeasurement& measurement);
+	void	GetStatistics(AVSyncStatistics& statistics);
+
+private:
+	enum OnsetState
+	{
+		kOnsetStateActive,				// In a burst, or not yet seen enough silence
+		kOnsetStateArmed,				// Silence, waiting for the start of a burst
+		kOnsetStateMeasuring			// At the start of a burst, measuring its peak and frequency
+	};
+
+	struct ChannelDetector
+	{
+		OnsetState			state;
+		uint32_t			silentSamples;
+		float				previousSample;
+		double				crossingTime;			// Samples, when the signal rose above the onset level
+		uint32_t			measuredSamples;
+		float				peakLevel;
+		uint32_t			zeroCrossings;
+		double				firstZeroCrossing;
+		double				lastZeroCrossing;
+		std::deque<double>	onsets;					// Seconds, bursts not yet paired with a flash
+	};
+
+	bool	GetFrameLevel(IDeckLinkVideoInputFrame* videoFrame, uint32_t& level);
+	void	AddSample(uint32_t channel, float sample, uint64_t sampleTime);
+	void	AddOnset(uint32_t channel, double onsetTime);
+	void	PairBursts(void);
+	void	CompleteFlash(AVSyncMeasurement& measurement);
+
+	uint32_t						m_audioChannelCount;
+	uint32_t						m_audioSampleDepth;
+	double							m_alarmThreshold;
+	//
+	bool							m_hasVideoLevels;
+	uint32_t						m_lowLevel;
+	uint32_t						m_highLevel;
+	bool							m_previousFlash;
+	std::vector<uint16_t>			m_rowSamples;
+	//
+	ChannelDetector					m_channels[kAVSyncMaxChannels];
+	std::deque<AVSyncMeasurement>	m_pendingFlashes;
+	std::deque<AVSyncMeasurement>	m_completedMeasurements;
+	double							m_latestVideoTime;
+	double							m_latestAudioTime;
+	//
+	AVSyncStatistics				m_statistics;
+	double							m_offsetTotal;
+	double							m_driftSums[5];			// n, sum t, sum o, sum t*t, sum t*o
+};
+
+#endif
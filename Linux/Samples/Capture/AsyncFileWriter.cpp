@@ -0,0 +1,362 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "AsyncFileWriter.h"
+
+// O_DIRECT requires buffer address, length and file offset to be multiples of the logical block
+// size, 4096 covers both 512 byte and 4K sector devices
+static const size_t		kDirectIOAlignment	= 4096;
+// Extend the file allocation in large steps so that the filesystem keeps the capture contiguous
+static const off_t		kPreallocateStep	= 1024LL * 1024 * 1024;
+
+static double GetMonotonicSeconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+AsyncFileWriter::AsyncFileWriter() :
+	m_fd(-1),
+	m_directIO(false),
+	m_fileOffset(0),
+	m_preallocatedOffset(0),
+	m_stagingBuffer(NULL),
+	m_stagingBufferSize(0),
+	m_stagedLength(0),
+	m_writerThreadRunning(false),
+	m_queue(NULL),
+	m_queueDepth(0),
+	m_queueHead(0),
+	m_queuedBuffers(0),
+	m_closing(false)
+{
+	pthread_mutex_init(&m_mutex, NULL);
+	pthread_cond_init(&m_queueCondition, NULL);
+	memset(&m_statistics, 0, sizeof(m_statistics));
+}
+
+AsyncFileWriter::~AsyncFileWriter()
+{
+	Close();
+
+	pthread_cond_destroy(&m_queueCondition);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+bool AsyncFileWriter::Open(const char* filename, uint32_t queueDepth, bool directIO)
+{
+	if (m_fd != -1 || queueDepth == 0)
+		return false;
+
+	m_fd = open(filename, O_WRONLY|O_CREAT|O_TRUNC|(directIO ? O_DIRECT : 0), 0664);
+	if (m_fd < 0 && directIO && errno == EINVAL)
+	{
+		// Filesystem does not support O_DIRECT (eg tmpfs)
+		fprintf(stderr, "Direct I/O is not supported for \"%s\", using buffered writes\n", filename);
+		directIO = false;
+		m_fd = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	}
+
+	if (m_fd < 0)
+	{
+		m_fd = -1;
+		return false;
+	}
+
+	m_directIO				= directIO;
+	m_fileOffset			= 0;
+	m_preallocatedOffset	= 0;
+	m_stagedLength			= 0;
+	m_queue					= new QueuedBuffer[queueDepth];
+	m_queueDepth			= queueDepth;
+	m_queueHead				= 0;
+	m_queuedBuffers			= 0;
+	m_closing				= false;
+
+	memset(&m_statistics, 0, sizeof(m_statistics));
+	m_statistics.queueDepth	= queueDepth;
+	m_statistics.directIO	= directIO;
+
+	if (pthread_create(&m_writerThread, NULL, WriterThreadFunc, this) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_writerThreadRunning = true;
+	return true;
+}
+
+void AsyncFileWriter::Close()
+{
+	if (m_writerThreadRunning)
+	{
+		// Let the writer thread drain the queue before it exits
+		pthread_mutex_lock(&m_mutex);
+		m_closing = true;
+		pthread_cond_signal(&m_queueCondition);
+		pthread_mutex_unlock(&m_mutex);
+
+		pthread_join(m_writerThread, NULL);
+		m_writerThreadRunning = false;
+	}
+
+	if (m_fd != -1)
+	{
+		if (m_stagedLength > 0 && m_statistics.writeError == 0)
+			WriteStagedTail();
+
+		close(m_fd);
+		m_fd = -1;
+	}
+
+	delete[] m_queue;
+	m_queue = NULL;
+	m_queueDepth = 0;
+
+	free(m_stagingBuffer);
+	m_stagingBuffer = NULL;
+	m_stagingBufferSize = 0;
+}
+
+bool AsyncFileWriter::Write(IUnknown* owner, const void* bytes, uint32_t length)
+{
+	bool queued = false;
+
+	pthread_mutex_lock(&m_mutex);
+
+	if (m_queuedBuffers < m_queueDepth && !m_closing)
+	{
+		QueuedBuffer& entry = m_queue[(m_queueHead + m_queuedBuffers) % m_queueDepth];
+
+		owner->AddRef();
+		entry.owner		= owner;
+		entry.bytes		= bytes;
+		entry.length	= length;
+
+		if (++m_queuedBuffers > m_statistics.peakQueuedBuffers)
+			m_statistics.peakQueuedBuffers = m_queuedBuffers;
+
+		pthread_cond_signal(&m_queueCondition);
+		queued = true;
+	}
+	else
+	{
+		m_statistics.buffersDropped++;
+	}
+
+	pthread_mutex_unlock(&m_mutex);
+	return queued;
+}
+
+void AsyncFileWriter::GetStatistics(AsyncFileWriterStatistics& statistics)
+{
+	pthread_mutex_lock(&m_mutex);
+	statistics = m_statistics;
+	pthread_mutex_unlock(&m_mutex);
+}
+
+void* AsyncFileWriter::WriterThreadFunc(void* arg)
+{
+	static_cast<AsyncFileWriter*>(arg)->WriterThread();
+	return NULL;
+}
+
+void AsyncFileWriter::WriterThread()
+{
+	pthread_mutex_lock(&m_mutex);
+
+	while (true)
+	{
+		while (m_queuedBuffers == 0 && !m_closing)
+			pthread_cond_wait(&m_queueCondition, &m_mutex);
+
+		if (m_queuedBuffers == 0)
+			break;
+
+		// Leave the entry in the queue while it is written, so that the queue depth includes it
+		QueuedBuffer	entry = m_queue[m_queueHead];
+		bool			failed = (m_statistics.writeError != 0);
+		bool			zeroCopy = false;
+		double			writeStart;
+
+		pthread_mutex_unlock(&m_mutex);
+
+		writeStart = GetMonotonicSeconds();
+		if (!failed && !WriteBuffer(entry.bytes, entry.length, zeroCopy))
+		{
+			int writeError = errno;
+			fprintf(stderr, "Write to output file failed: %s\n", strerror(writeError));
+
+			pthread_mutex_lock(&m_mutex);
+			m_statistics.writeError = writeError;
+			pthread_mutex_unlock(&m_mutex);
+			failed = true;
+		}
+		double writeSeconds = GetMonotonicSeconds() - writeStart;
+
+		entry.owner->Release();
+
+		pthread_mutex_lock(&m_mutex);
+		m_queueHead = (m_queueHead + 1) % m_queueDepth;
+		m_queuedBuffers--;
+
+		if (failed)
+		{
+			m_statistics.buffersDropped++;
+		}
+		else
+		{
+			m_statistics.buffersWritten++;
+			m_statistics.bytesWritten += entry.length;
+			m_statistics.writeSeconds += writeSeconds;
+			if (zeroCopy)
+				m_statistics.zeroCopyWrites++;
+		}
+	}
+
+	pthread_mutex_unlock(&m_mutex);
+}
+
+bool AsyncFileWriter::WriteBuffer(const void* bytes, size_t length, bool& zeroCopy)
+{
+	if (!m_directIO)
+		return WriteFully(bytes, length);
+
+	Preallocate(length);
+
+	if (m_stagedLength == 0 && ((uintptr_t)bytes % kDirectIOAlignment) == 0 && (length % kDirectIOAlignment) == 0)
+	{
+		zeroCopy = true;
+		return WriteFully(bytes, length);
+	}
+
+	// Stage through the aligned bounce buffer, writing whole blocks and carrying the remainder
+	// over to the next buffer
+	size_t requiredSize = ((m_stagedLength + length + kDirectIOAlignment - 1) / kDirectIOAlignment) * kDirectIOAlignment;
+	if (requiredSize > m_stagingBufferSize)
+	{
+		void* stagingBuffer;
+		if (posix_memalign(&stagingBuffer, kDirectIOAlignment, requiredSize) != 0)
+		{
+			errno = ENOMEM;
+			return false;
+		}
+
+		memcpy(stagingBuffer, m_stagingBuffer, m_stagedLength);
+		free(m_stagingBuffer);
+		m_stagingBuffer = (uint8_t*)stagingBuffer;
+		m_stagingBufferSize = requiredSize;
+	}
+
+	memcpy(m_stagingBuffer + m_stagedLength, bytes, length);
+	m_stagedLength += length;
+
+	size_t blockLength = m_stagedLength - (m_stagedLength % kDirectIOAlignment);
+	if (blockLength > 0)
+	{
+		if (!WriteFully(m_stagingBuffer, blockLength))
+			return false;
+
+		m_stagedLength -= blockLength;
+		memmove(m_stagingBuffer, m_stagingBuffer + blockLength, m_stagedLength);
+	}
+
+	return true;
+}
+
+bool AsyncFileWriter::WriteFully(const void* bytes, size_t length)
+{
+	const uint8_t* data = (const uint8_t*)bytes;
+
+	while (length > 0)
+	{
+		ssize_t written = pwrite(m_fd, data, length, m_fileOffset);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+
+		data			+= written;
+		length			-= written;
+		m_fileOffset	+= written;
+	}
+
+	return true;
+}
+
+bool AsyncFileWriter::WriteStagedTail()
+{
+	// The final partial block cannot be written with O_DIRECT, so write it buffered
+	int flags = fcntl(m_fd, F_GETFL);
+	if (flags == -1 || fcntl(m_fd, F_SETFL, flags & ~O_DIRECT) == -1)
+		return false;
+
+	bool result = WriteFully(m_stagingBuffer, m_stagedLength);
+	m_stagedLength = 0;
+
+	return result;
+}
+
+void AsyncFileWriter::Preallocate(size_t length)
+{
+	if (m_fileOffset + (off_t)length <= m_preallocatedOffset)
+		return;
+
+	off_t preallocateLength = (kPreallocateStep > (off_t)length) ? kPreallocateStep : (off_t)length;
+
+	// Keep the file size at the written length, so that no truncation is needed on close.
+	// Filesystems without fallocate support are written without preallocation
+	if (fallocate(m_fd, FALLOC_FL_KEEP_SIZE, m_preallocatedOffset, preallocateLength) != 0)
+		preallocateLength = (m_fileOffset + (off_t)length) - m_preallocatedOffset;
+
+	m_preallocatedOffset += preallocateLength;
+}
@@ -0,0 +1,126 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __ASYNC_FILE_WRITER_H__
+#define __ASYNC_FILE_WRITER_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "DeckLinkAPI.h"
+
+// Writes buffers to a file from a dedicated thread, so that a slow disk never blocks the
+// DeckLink callback thread.  Write() holds a reference on the buffer owner (the video frame or
+// audio packet) until its bytes are on disk, so frames are not copied before they are queued.
+//
+// When the queue is full the buffer is rejected and counted as dropped, this is the point at
+// which the disk is not keeping up with the input.
+//
+// With direct I/O the file is opened with O_DIRECT and preallocated ahead of the write offset.
+// Block aligned buffers are written straight from the frame, otherwise they are staged through an
+// aligned bounce buffer.
+
+struct AsyncFileWriterStatistics
+{
+	uint64_t	buffersWritten;
+	uint64_t	buffersDropped;
+	uint64_t	zeroCopyWrites;		// Buffers written directly from the owner's memory with O_DIRECT
+	uint64_t	bytesWritten;
+	double		writeSeconds;		// Time spent in write calls, for disk throughput
+	uint32_t	queueDepth;
+	uint32_t	peakQueuedBuffers;
+	bool		directIO;
+	int			writeError;			// errno of the first failed write, 0 if none
+};
+
+class AsyncFileWriter
+{
+public:
+	AsyncFileWriter();
+	virtual ~AsyncFileWriter();
+
+	bool	Open(const char* filename, uint32_t queueDepth, bool directIO);
+	void	Close(void);
+	bool	IsOpen(void) const { return m_fd != -1; }
+
+	// Queue bytes owned by owner for writing.  Returns false if the queue is full and the buffer was dropped
+	bool	Write(IUnknown* owner, const void* bytes, uint32_t length);
+
+	void	GetStatistics(AsyncFileWriterStatistics& statistics);
+
+private:
+	struct QueuedBuffer
+	{
+		IUnknown*		owner;
+		const void*		bytes;
+		uint32_t		length;
+	};
+
+	static void*	WriterThreadFunc(void* arg);
+	void			WriterThread(void);
+	bool			WriteBuffer(const void* bytes, size_t length, bool& zeroCopy);
+	bool			WriteFully(const void* bytes, size_t length);
+	bool			WriteStagedTail(void);
+	void			Preallocate(size_t length);
+
+	int					m_fd;
+	bool				m_directIO;
+	off_t				m_fileOffset;
+	off_t				m_preallocatedOffset;
+	//
+	uint8_t*			m_stagingBuffer;
+	size_t				m_stagingBufferSize;
+	size_t				m_stagedLength;
+	//
+	pthread_t			m_writerThread;
+	bool				m_writerThreadRunning;
+	pthread_mutex_t		m_mutex;
+	pthread_cond_t		m_queueCondition;
+	QueuedBuffer*		m_queue;
+	uint32_t			m_queueDepth;
+	uint32_t			m_queueHead;
+	uint32_t			m_queuedBuffers;
+	bool				m_closing;
+	//
+	AsyncFileWriterStatistics	m_statistics;
+};
+
+#endif
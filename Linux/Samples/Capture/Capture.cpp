@@ -45,15 +45,44 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <csignal>
+#include <algorithm>
 
 #include "DeckLinkAPI.h"
+#include "AsyncFileWriter.h"
+#include "AVSyncAnalyzer.h"
+#include "CaptureContainerWriter.h"
 #include "Capture.h"
 #include "Config.h"
+#include "FrameBusPublisher.h"
+#include "FrameID.h"
+#include "PixelPacking.h"
+#include "ST2110Sender.h"
+
+// Number of buffers that may be waiting to be written before frames are dropped.  Queued video
+// frames are held from the driver, so the video queue should stay well below the number of
+// capture buffers
+static const uint32_t	kVideoWriterQueueDepth = 8;
+static const uint32_t	kAudioWriterQueueDepth = 64;
+static const uint32_t	kContainerWriterQueueDepth = 8;
+
+// Frame bus slots, shared between the driver's capture buffers and the frames readers may still
+// be using.  Readers that fall more than this many frames behind lose frames
+static const uint32_t	kFrameBusSlotCount = 16;
+
+// Frames that may wait while the previous one is paced out to the network
+static const uint32_t	kST2110SenderQueueDepth = 2;
 
 static pthread_mutex_t	g_sleepMutex;
 static pthread_cond_t	g_sleepCond;
-static int				g_videoOutputFile = -1;
-static int				g_audioOutputFile = -1;
+static AsyncFileWriter	g_videoWriter;
+static AsyncFileWriter	g_audioWriter;
+static CaptureContainerWriter	g_containerWriter;
+static FrameIDTracker	g_frameIDTracker;
+static AVSyncAnalyzer	g_avSyncAnalyzer;
+static FrameBusPublisher*	g_frameBus = NULL;
+static ST2110Sender		g_st2110Sender;
+static BMDFieldDominance	g_fieldDominance = bmdProgressiveFrame;
+static BMDTimeScale		g_frameTimeScale = 0;
 static bool				g_do_exit = false;
 
 static BMDConfig		g_config;
@@ -62,6 +91,69 @@ static IDeckLinkInput*	g_deckLinkInput = NULL;
 
 static unsigned long	g_frameCount = 0;
 
+static void PrintAVSyncMeasurements(void)
+{
+	AVSyncMeasurement measurement;
+
+	while (g_avSyncAnalyzer.GetMeasurement(measurement))
+	{
+		printf("A/V sync (#%llu) at %.3f s - Offset: %+.3f ms",
+			(unsigned long long)measurement.flashCount,
+			measurement.flashTime,
+			measurement.offset);
+
+		for (uint32_t channel = 0; channel < measurement.channelCount; channel++)
+		{
+			if (measurement.channelFound[channel])
+				printf("%s%+.3f", channel == 0 ? " [" : " ", measurement.channelOffset[channel]);
+			else
+				printf("%s-", channel == 0 ? " [" : " ");
+		}
+
+		printf("]%s\n", measurement.alarm ? " - ALARM" : "");
+	}
+}
+
+static void SendST2110Frame(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkAudioInputPacket* audioFrame)
+{
+	ST2110SenderFrame	frame;
+	BMDTimeValue		frameTime;
+	BMDTimeValue		frameDuration;
+	BMDTimeValue		packetTime;
+	void*				bytes;
+
+	// Format detection may switch to RGB, which is not sent
+	if (videoFrame->GetPixelFormat() != bmdFormat10BitYUV)
+		return;
+
+	if (videoFrame->GetBytes(&bytes) != S_OK || videoFrame->GetStreamTime(&frameTime, &frameDuration, g_frameTimeScale) != S_OK)
+		return;
+
+	memset(&frame, 0, sizeof(frame));
+	frame.videoOwner		= videoFrame;
+	frame.videoBytes		= bytes;
+	frame.width				= (uint32_t)videoFrame->GetWidth();
+	frame.height			= (uint32_t)videoFrame->GetHeight();
+	frame.rowBytes			= (uint32_t)videoFrame->GetRowBytes();
+	frame.interlaced		= (g_fieldDominance == bmdLowerFieldFirst || g_fieldDominance == bmdUpperFieldFirst);
+	frame.lowerFieldFirst	= (g_fieldDominance == bmdLowerFieldFirst);
+
+	// RTP timestamps follow the capture stream time, there is no PTP reference to align them to
+	frame.videoTimestamp	= (uint32_t)(frameTime * kST2110VideoClockRate / g_frameTimeScale);
+	frame.frameNanoseconds	= (uint64_t)(frameDuration * 1000000000LL / g_frameTimeScale);
+
+	if (audioFrame != NULL && audioFrame->GetBytes(&bytes) == S_OK && audioFrame->GetPacketTime(&packetTime, kST2110AudioClockRate) == S_OK)
+	{
+		frame.audioOwner			= audioFrame;
+		frame.audioBytes			= bytes;
+		frame.audioSampleFrameCount	= (uint32_t)audioFrame->GetSampleFrameCount();
+		frame.audioTimestamp		= (uint32_t)packetTime;
+	}
+
+	if (!g_st2110Sender.SendFrame(frame))
+		printf("ST 2110 sender is not keeping up, frame #%lu dropped\n", g_frameCount);
+}
+
 DeckLinkCaptureDelegate::DeckLinkCaptureDelegate() : 
 	m_refCount(1),
 	m_pixelFormat(g_config.m_pixelFormat)
@@ -94,6 +186,9 @@ HRESULT DeckLinkCaptureDelegate::VideoInputFrameArrived(IDeckLinkVideoInputFrame
 	// Handle Video Frame
 	if (videoFrame)
 	{
+		// Taken first, so frame ID latency doesn't include the time to handle the frame
+		uint64_t arrivalTime = GetFrameIDTimestamp();
+
 		// If 3D mode is enabled we retreive the 3D extensions interface which gives.
 		// us access to the right eye frame by calling GetFrameForRightEye() .
 		if ( (videoFrame->QueryInterface(IID_IDeckLinkVideoFrame3DExtensions, (void **) &threeDExtensions) != S_OK) ||
@@ -127,22 +222,69 @@ HRESULT DeckLinkCaptureDelegate::VideoInputFrameArrived(IDeckLinkVideoInputFrame
 				rightEyeFrame != NULL ? "Valid Frame (3D left/right)" : "Valid Frame",
 				videoFrame->GetRowBytes() * videoFrame->GetHeight());
 
+			if (g_config.m_frameID)
+			{
+				FrameID		frameID;
+				bool		decoded = ReadFrameID(videoFrame, frameID);
+				int64_t		latency = g_frameIDTracker.AddFrame(decoded ? &frameID : NULL, arrivalTime);
+
+				if (!decoded)
+					printf("    Frame ID: not found\n");
+				else if (latency < 0)
+					printf("    Frame ID: %u\n", frameID.frameNumber);
+				else
+					printf("    Frame ID: %u - Latency: %.3f ms\n", frameID.frameNumber, latency / 1000.0);
+			}
+
 			if (timecodeString)
 				free((void*)timecodeString);
 
-			if (g_videoOutputFile != -1)
+			if (g_videoWriter.IsOpen())
 			{
+				// The writer holds a reference to the frame until it has been written, the frame is not copied
 				videoFrame->GetBytes(&frameBytes);
-				write(g_videoOutputFile, frameBytes, videoFrame->GetRowBytes() * videoFrame->GetHeight());
+				if (!g_videoWriter.Write(videoFrame, frameBytes, videoFrame->GetRowBytes() * videoFrame->GetHeight()))
+					printf("Video file writer is not keeping up, frame #%lu dropped\n", g_frameCount);
 
 				if (rightEyeFrame)
 				{
 					rightEyeFrame->GetBytes(&frameBytes);
-					write(g_videoOutputFile, frameBytes, videoFrame->GetRowBytes() * videoFrame->GetHeight());
+					if (!g_videoWriter.Write(rightEyeFrame, frameBytes, videoFrame->GetRowBytes() * videoFrame->GetHeight()))
+						printf("Video file writer is not keeping up, frame #%lu (right eye) dropped\n", g_frameCount);
 				}
 			}
 		}
 
+		if (g_containerWriter.IsOpen())
+		{
+			if (!g_containerWriter.WriteFrame(videoFrame, rightEyeFrame, audioFrame, g_frameCount, g_frameTimeScale, g_config.m_timecodeFormat))
+				printf("Capture container writer is not keeping up, frame #%lu dropped\n", g_frameCount);
+		}
+
+		if (g_frameBus != NULL && g_frameBus->IsOpen())
+		{
+			// Only the left eye is published, readers receive the audio with its frame
+			switch (g_frameBus->Publish(videoFrame, audioFrame, g_frameTimeScale, g_config.m_timecodeFormat))
+			{
+				case kFrameBusNoFreeSlot:
+					printf("Frame bus has no free slot, frame #%lu not published\n", g_frameCount);
+					break;
+
+				case kFrameBusFrameTooLarge:
+					printf("Frame #%lu is larger than a frame bus slot, not published\n", g_frameCount);
+					break;
+
+				default:
+					break;
+			}
+		}
+
+		if (g_st2110Sender.IsOpen())
+			SendST2110Frame(videoFrame, audioFrame);
+
+		if (g_config.m_avSync)
+			g_avSyncAnalyzer.AddVideoFrame(videoFrame, g_frameTimeScale);
+
 		if (rightEyeFrame)
 			rightEyeFrame->Release();
 
@@ -152,14 +294,25 @@ HRESULT DeckLinkCaptureDelegate::VideoInputFrameArrived(IDeckLinkVideoInputFrame
 	// Handle Audio Frame
 	if (audioFrame)
 	{
-		if (g_audioOutputFile != -1)
+		// Audio arriving with video is recorded with its frame in the capture container
+		if (!videoFrame && g_containerWriter.IsOpen())
+			g_containerWriter.WriteFrame(NULL, NULL, audioFrame, g_frameCount, g_frameTimeScale, g_config.m_timecodeFormat);
+
+		if (g_config.m_avSync)
+			g_avSyncAnalyzer.AddAudioPacket(audioFrame);
+
+		if (g_audioWriter.IsOpen())
 		{
 			audioFrame->GetBytes(&audioFrameBytes);
-			write(g_audioOutputFile, audioFrameBytes, audioFrame->GetSampleFrameCount() * g_config.m_audioChannels * (g_config.m_audioSampleDepth / 8));
+			if (!g_audioWriter.Write(audioFrame, audioFrameBytes, audioFrame->GetSampleFrameCount() * g_config.m_audioChannels * (g_config.m_audioSampleDepth / 8)))
+				printf("Audio file writer is not keeping up, audio packet dropped\n");
 		}
 	}
 
-	if (g_config.m_maxFrames > 0 && videoFrame && g_frameCount >= g_config.m_maxFrames)
+	if (g_config.m_avSync)
+		PrintAVSyncMeasurements();
+
+	if (g_config.m_maxFrames > 0 && videoFrame && g_frameCount >= (unsigned long)g_config.m_maxFrames)
 	{
 		g_do_exit = true;
 		pthread_cond_signal(&g_sleepCond);
@@ -190,6 +343,10 @@ HRESULT DeckLinkCaptureDelegate::VideoInputFormatChanged(BMDVideoInputFormatChan
 	// Restart streams if either display mode or pixel format have changed
 	if ((events & bmdVideoInputDisplayModeChanged) || (m_pixelFormat != pixelFormat))
 	{
+		BMDTimeValue frameDuration;
+		mode->GetFrameRate(&frameDuration, &g_frameTimeScale);
+		g_fieldDominance = mode->GetFieldDominance();
+
 		mode->GetName((const char**)&displayModeName);
 		printf("Video format changed to %s %s\n", displayModeName, formatFlags & bmdDetectedVideoInputRGB444 ? "RGB" : "YUV");
 
@@ -217,6 +374,146 @@ bail:
 	return S_OK;
 }
 
+static void PrintWriterStatistics(const char* name, AsyncFileWriter& writer)
+{
+	AsyncFileWriterStatistics statistics;
+
+	writer.GetStatistics(statistics);
+
+	fprintf(stderr, "%s file: %llu buffers written (%llu zero-copy), %llu dropped, peak queue %u/%u, %.1f MB/s%s\n",
+		name,
+		(unsigned long long)statistics.buffersWritten,
+		(unsigned long long)statistics.zeroCopyWrites,
+		(unsigned long long)statistics.buffersDropped,
+		statistics.peakQueuedBuffers,
+		statistics.queueDepth,
+		statistics.writeSeconds > 0 ? statistics.bytesWritten / statistics.writeSeconds / 1e6 : 0.0,
+		statistics.directIO ? " (direct I/O)" : "");
+}
+
+static void PrintFrameIDStatistics(void)
+{
+	FrameIDStatistics statistics = g_frameIDTracker.GetStatistics();
+
+	fprintf(stderr, "Frame ID: %llu frames decoded, %llu without frame ID, %llu dropped, %llu repeated, %llu out of order\n",
+		(unsigned long long)statistics.framesDecoded,
+		(unsigned long long)statistics.framesUndecodable,
+		(unsigned long long)statistics.framesDropped,
+		(unsigned long long)statistics.framesRepeated,
+		(unsigned long long)statistics.framesOutOfOrder);
+
+	if (statistics.latencyCount > 0)
+	{
+		fprintf(stderr, "Frame ID latency: min %.3f ms, mean %.3f ms, max %.3f ms over %llu frames\n",
+			statistics.minLatency / 1000.0,
+			statistics.totalLatency / 1000.0 / statistics.latencyCount,
+			statistics.maxLatency / 1000.0,
+			(unsigned long long)statistics.latencyCount);
+	}
+}
+
+static void PrintAVSyncStatistics(void)
+{
+	AVSyncStatistics statistics;
+
+	g_avSyncAnalyzer.GetStatistics(statistics);
+
+	fprintf(stderr, "A/V sync: %llu flashes, %llu measured, %llu missing audio, %llu bursts without a flash, %llu alarms (threshold %.1f ms)\n",
+		(unsigned long long)statistics.flashCount,
+		(unsigned long long)statistics.measurementCount,
+		(unsigned long long)statistics.missingBurstCount,
+		(unsigned long long)statistics.unpairedBurstCount,
+		(unsigned long long)statistics.alarmCount,
+		g_config.m_avSyncThreshold);
+
+	if (statistics.measurementCount > 0)
+	{
+		fprintf(stderr, "A/V sync offset: min %+.3f ms, mean %+.3f ms, max %+.3f ms, last %+.3f ms, drift %+.3f ms/hour, channel skew up to %.3f ms\n",
+			statistics.minOffset,
+			statistics.meanOffset,
+			statistics.maxOffset,
+			statistics.lastOffset,
+			statistics.driftPerHour,
+			statistics.maxChannelSkew);
+	}
+}
+
+static uint32_t GetFrameBusVideoBufferSize(IDeckLinkDisplayMode* selectedMode)
+{
+	IDeckLinkDisplayModeIterator*	displayModeIterator = NULL;
+	IDeckLinkDisplayMode*			displayMode = NULL;
+	BMDPixelFormat					detectedPixelFormats[2];
+	uint32_t						bufferSize;
+
+	bufferSize = GetPixelFormatRowBytes(g_config.m_pixelFormat, (uint32_t)selectedMode->GetWidth()) * (uint32_t)selectedMode->GetHeight();
+
+	if (!(g_config.m_inputFlags & bmdVideoInputEnableFormatDetection))
+		return bufferSize;
+
+	// Format detection may switch to any mode the input supports, in the pixel formats that
+	// VideoInputFormatChanged selects
+	detectedPixelFormats[0] = (g_config.m_pixelFormat == bmdFormat8BitYUV) ? bmdFormat8BitYUV : bmdFormat10BitYUV;
+	detectedPixelFormats[1] = bmdFormat10BitRGB;
+
+	if (g_deckLinkInput->GetDisplayModeIterator(&displayModeIterator) != S_OK)
+		return bufferSize;
+
+	while (displayModeIterator->Next(&displayMode) == S_OK)
+	{
+		for (int i = 0; i < 2; i++)
+		{
+			bool		supported = false;
+			uint32_t	modeBufferSize;
+
+			if (g_deckLinkInput->DoesSupportVideoMode(bmdVideoConnectionUnspecified, displayMode->GetDisplayMode(), detectedPixelFormats[i], bmdNoVideoInputConversion, bmdSupportedVideoModeDefault, NULL, &supported) != S_OK || !supported)
+				continue;
+
+			modeBufferSize = GetPixelFormatRowBytes(detectedPixelFormats[i], (uint32_t)displayMode->GetWidth()) * (uint32_t)displayMode->GetHeight();
+			bufferSize = std::max(bufferSize, modeBufferSize);
+		}
+
+		displayMode->Release();
+	}
+
+	displayModeIterator->Release();
+
+	return bufferSize;
+}
+
+static void PrintFrameBusStatistics(void)
+{
+	FrameBusPublisherStatistics statistics;
+
+	g_frameBus->GetStatistics(statistics);
+
+	fprintf(stderr, "Frame bus: %llu frames published (%llu zero-copy, %llu copied), %llu dropped, %llu too large, %llu heap buffers, peak slots %u/%u\n",
+		(unsigned long long)statistics.framesPublished,
+		(unsigned long long)statistics.zeroCopyFrames,
+		(unsigned long long)statistics.copiedFrames,
+		(unsigned long long)statistics.framesDropped,
+		(unsigned long long)statistics.framesTooLarge,
+		(unsigned long long)statistics.heapAllocations,
+		statistics.peakSlotsInUse,
+		kFrameBusSlotCount);
+}
+
+static void PrintST2110Statistics(void)
+{
+	ST2110SenderStatistics statistics;
+
+	g_st2110Sender.GetStatistics(statistics);
+
+	fprintf(stderr, "ST 2110: %llu frames sent, %llu dropped, %llu unsupported, %llu video and %llu audio packets, %llu late batches, %llu send errors, segmentation offload %s\n",
+		(unsigned long long)statistics.framesSent,
+		(unsigned long long)statistics.framesDropped,
+		(unsigned long long)statistics.framesUnsupported,
+		(unsigned long long)statistics.videoPackets,
+		(unsigned long long)statistics.audioPackets,
+		(unsigned long long)statistics.lateBatches,
+		(unsigned long long)statistics.sendErrors,
+		statistics.segmentationOffload ? "on" : "off");
+}
+
 static void sigfunc(int signum)
 {
 	if (signum == SIGINT || signum == SIGTERM)
@@ -338,9 +635,18 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	{
+		BMDTimeValue frameDuration;
+		displayMode->GetFrameRate(&frameDuration, &g_frameTimeScale);
+		g_fieldDominance = displayMode->GetFieldDominance();
+	}
+
 	// Print the selected configuration
 	g_config.DisplayConfiguration();
 
+	if (g_config.m_avSync)
+		g_avSyncAnalyzer.Reset(g_config.m_audioChannels, g_config.m_audioSampleDepth, g_config.m_avSyncThreshold);
+
 	// Configure the capture callback
 	delegate = new DeckLinkCaptureDelegate();
 	g_deckLinkInput->SetCallback(delegate);
@@ -348,8 +654,7 @@ int main(int argc, char *argv[])
 	// Open output files
 	if (g_config.m_videoOutputFile != NULL)
 	{
-		g_videoOutputFile = open(g_config.m_videoOutputFile, O_WRONLY|O_CREAT|O_TRUNC, 0664);
-		if (g_videoOutputFile < 0)
+		if (!g_videoWriter.Open(g_config.m_videoOutputFile, kVideoWriterQueueDepth, g_config.m_directIO))
 		{
 			fprintf(stderr, "Could not open video output file \"%s\"\n", g_config.m_videoOutputFile);
 			goto bail;
@@ -358,14 +663,55 @@ int main(int argc, char *argv[])
 
 	if (g_config.m_audioOutputFile != NULL)
 	{
-		g_audioOutputFile = open(g_config.m_audioOutputFile, O_WRONLY|O_CREAT|O_TRUNC, 0664);
-		if (g_audioOutputFile < 0)
+		if (!g_audioWriter.Open(g_config.m_audioOutputFile, kAudioWriterQueueDepth, false))
 		{
 			fprintf(stderr, "Could not open audio output file \"%s\"\n", g_config.m_audioOutputFile);
 			goto bail;
 		}
 	}
 
+	if (g_config.m_containerName != NULL)
+	{
+		if (!g_containerWriter.Open(g_config.m_containerName, g_config.m_containerSegmentSize, kContainerWriterQueueDepth, g_config.m_audioChannels, g_config.m_audioSampleDepth))
+		{
+			fprintf(stderr, "Could not open capture container \"%s\"\n", g_config.m_containerName);
+			goto bail;
+		}
+	}
+
+	if (g_config.m_frameBusName != NULL)
+	{
+		// Slots are sized for the largest frame the input can switch to, so that frames never
+		// have to be captured into the heap because of their size
+		uint32_t	videoBufferSize = GetFrameBusVideoBufferSize(displayMode);
+
+		g_frameBus = new FrameBusPublisher();
+		if (!g_frameBus->Open(g_config.m_frameBusName, kFrameBusSlotCount, videoBufferSize, g_config.m_audioChannels, g_config.m_audioSampleDepth))
+		{
+			fprintf(stderr, "Could not open frame bus \"%s\"\n", g_config.m_frameBusName);
+			goto bail;
+		}
+
+		// Capture directly into the bus's slots, otherwise every frame is copied
+		if (g_deckLinkInput->SetVideoInputFrameMemoryAllocator(g_frameBus) != S_OK)
+			fprintf(stderr, "Could not set the frame bus as the capture allocator, frames will be copied\n");
+	}
+
+	if (g_config.m_st2110Address != NULL)
+	{
+		if (g_config.m_pixelFormat != bmdFormat10BitYUV)
+		{
+			fprintf(stderr, "ST 2110 output requires the 10 bit YUV pixel format\n");
+			goto bail;
+		}
+
+		if (!g_st2110Sender.Open(g_config.m_st2110Address, g_config.m_st2110Port, g_config.m_st2110Port + 2, g_config.m_audioChannels, g_config.m_audioSampleDepth, kST2110SenderQueueDepth, true))
+		{
+			fprintf(stderr, "Could not send ST 2110 to %s port %u\n", g_config.m_st2110Address, g_config.m_st2110Port);
+			goto bail;
+		}
+	}
+
 	// Block main thread until signal occurs
 	while (!g_do_exit)
 	{
@@ -399,11 +745,51 @@ int main(int argc, char *argv[])
 	}
 
 bail:
-	if (g_videoOutputFile != 0)
-		close(g_videoOutputFile);
+	if (g_config.m_frameID)
+		PrintFrameIDStatistics();
+
+	if (g_config.m_avSync)
+		PrintAVSyncStatistics();
+
+	// Finish writing any queued frames
+	if (g_videoWriter.IsOpen())
+	{
+		g_videoWriter.Close();
+		PrintWriterStatistics("Video", g_videoWriter);
+	}
 
-	if (g_audioOutputFile != 0)
-		close(g_audioOutputFile);
+	if (g_audioWriter.IsOpen())
+	{
+		g_audioWriter.Close();
+		PrintWriterStatistics("Audio", g_audioWriter);
+	}
+
+	if (g_containerWriter.IsOpen())
+	{
+		CaptureContainerWriterStatistics statistics;
+
+		g_containerWriter.Close();
+		g_containerWriter.GetStatistics(statistics);
+
+		fprintf(stderr, "Capture container: %llu frames written in %u segments, %llu dropped, peak queue %u/%u\n",
+			(unsigned long long)statistics.framesWritten,
+			statistics.segmentCount,
+			(unsigned long long)statistics.framesDropped,
+			statistics.peakQueuedFrames,
+			kContainerWriterQueueDepth);
+	}
+
+	if (g_st2110Sender.IsOpen())
+	{
+		g_st2110Sender.Close();
+		PrintST2110Statistics();
+	}
+
+	if (g_frameBus != NULL && g_frameBus->IsOpen())
+	{
+		g_frameBus->Close();
+		PrintFrameBusStatistics();
+	}
 
 	if (displayModeName != NULL)
 		free(displayModeName);
@@ -420,6 +806,13 @@ bail:
 		g_deckLinkInput = NULL;
 	}
 
+	// Released after the input, which holds a reference to its allocator
+	if (g_frameBus != NULL)
+	{
+		g_frameBus->Release();
+		g_frameBus = NULL;
+	}
+
 	if (deckLinkAttributes != NULL)
 		deckLinkAttributes->Release();
 
@@ -0,0 +1,125 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __CAPTURE_CONTAINER_FORMAT_H__
+#define __CAPTURE_CONTAINER_FORMAT_H__
+
+#include <stdint.h>
+
+// Segmented capture container.
+//
+// A capture named <name> is stored as an index file, <name>.dlidx, and a sequence of segment
+// files, <name>.00000.dlseg, <name>.00001.dlseg, ...  Segments hold the raw video bytes of each
+// frame (left eye then right eye), followed by the raw audio samples captured with it.  A frame
+// never spans two segments, and a new segment is started when the next frame would take the
+// current segment past the segment size.
+//
+// The index is a fixed-size header followed by one fixed-size record per frame, so the record of
+// frame n is at headerSize + n * recordSize.  Both files can be memory mapped.  Records are
+// appended only once the frame data is in its segment, and header.frameCount is updated after the
+// record, so a reader may follow a capture that is still in progress.
+//
+// All fields are little-endian.
+
+static const char		kCaptureContainerMagic[8]		= { 'D', 'L', 'C', 'A', 'P', 'I', 'D', 'X' };
+static const uint32_t	kCaptureContainerVersion		= 1;
+
+static const char* const	kCaptureContainerIndexExtension		= ".dlidx";
+static const char* const	kCaptureContainerSegmentFormat		= "%s.%05u.dlseg";
+
+enum
+{
+	kCaptureContainerFrameHasVideo				= 1 << 0,	// Record has video bytes
+	kCaptureContainerFrameHasAudio				= 1 << 1,	// Record has audio bytes
+	kCaptureContainerFrameIs3D					= 1 << 2,	// Video bytes are left eye followed by right eye
+	kCaptureContainerFrameHasTimecode			= 1 << 3,
+	kCaptureContainerFrameHasHardwareTime		= 1 << 4,
+	kCaptureContainerFrameNoInputSource			= 1 << 5,	// Frame was captured without a valid input signal
+};
+
+enum
+{
+	kCaptureContainerTimecodeDropFrame			= 1 << 0,	// Matches bmdTimecodeIsDropFrame
+};
+
+struct CaptureContainerHeader
+{
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	headerSize;				// Offset of the first record
+	uint32_t	recordSize;
+	uint32_t	audioSampleRate;
+	uint32_t	audioChannelCount;
+	uint32_t	audioSampleDepth;		// Bits per sample
+	uint64_t	segmentSize;			// Maximum size of a segment file
+	uint64_t	frameCount;				// Number of complete records
+	uint8_t		reserved[16];
+};
+
+struct CaptureContainerRecord
+{
+	uint64_t	frameNumber;			// Position of this record in the index
+	uint64_t	captureFrameNumber;		// Frames since capture started, gaps are frames that were not written
+	int64_t		streamTime;				// Video stream time, in timeScale units
+	int64_t		frameDuration;			// In timeScale units
+	int64_t		timeScale;
+	int64_t		hardwareReferenceTime;	// Hardware reference timestamp of frame arrival, in timeScale units
+	uint64_t	videoOffset;			// Offset of video bytes in the segment
+	uint64_t	audioOffset;			// Offset of audio bytes in the segment
+	int64_t		audioPacketTime;		// Time of the first audio sample, in audio sample frames
+	uint32_t	segmentIndex;
+	uint32_t	flags;					// kCaptureContainerFrame flags
+	uint32_t	videoLength;
+	uint32_t	audioLength;
+	uint32_t	audioSampleFrameCount;
+	uint32_t	width;
+	uint32_t	height;
+	uint32_t	rowBytes;
+	uint32_t	pixelFormat;			// BMDPixelFormat
+	uint32_t	timecodeFormat;			// BMDTimecodeFormat
+	uint32_t	timecodeBCD;			// 0xHHMMSSFF
+	uint32_t	timecodeFlags;			// kCaptureContainerTimecode flags
+	uint8_t		reserved[8];
+};
+
+static_assert(sizeof(CaptureContainerHeader) == 64, "CaptureContainerHeader size is part of the file format");
+static_assert(sizeof(CaptureContainerRecord) == 128, "CaptureContainerRecord size is part of the file format");
+
+#endif
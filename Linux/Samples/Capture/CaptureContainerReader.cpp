@@ -0,0 +1,238 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "CaptureContainerReader.h"
+
+CaptureContainerReader::CaptureContainerReader() :
+	m_indexFile(-1),
+	m_index(NULL),
+	m_indexLength(0),
+	m_frameCount(0)
+{
+}
+
+CaptureContainerReader::~CaptureContainerReader()
+{
+	Close();
+}
+
+bool CaptureContainerReader::Open(const char* name)
+{
+	std::string indexFilename = std::string(name) + kCaptureContainerIndexExtension;
+
+	if (m_indexFile != -1)
+		return false;
+
+	m_indexFile = open(indexFilename.c_str(), O_RDONLY);
+	if (m_indexFile < 0)
+	{
+		m_indexFile = -1;
+		return false;
+	}
+
+	m_name = name;
+
+	if (!MapIndex())
+	{
+		Close();
+		return false;
+	}
+
+	const CaptureContainerHeader* header = GetHeader();
+	if (memcmp(header->magic, kCaptureContainerMagic, sizeof(header->magic)) != 0 ||
+		header->version != kCaptureContainerVersion ||
+		header->headerSize < sizeof(CaptureContainerHeader) ||
+		header->recordSize < sizeof(CaptureContainerRecord))
+	{
+		fprintf(stderr, "\"%s\" is not a supported capture container index\n", indexFilename.c_str());
+		Close();
+		return false;
+	}
+
+	Refresh();
+	return true;
+}
+
+void CaptureContainerReader::Close()
+{
+	for (size_t i = 0; i < m_segments.size(); i++)
+	{
+		if (m_segments[i].base != NULL)
+			munmap(m_segments[i].base, m_segments[i].length);
+	}
+	m_segments.clear();
+
+	if (m_index != NULL)
+	{
+		munmap(m_index, m_indexLength);
+		m_index = NULL;
+		m_indexLength = 0;
+	}
+
+	if (m_indexFile != -1)
+	{
+		close(m_indexFile);
+		m_indexFile = -1;
+	}
+
+	m_frameCount = 0;
+}
+
+uint64_t CaptureContainerReader::Refresh()
+{
+	if (m_index == NULL || !MapIndex())
+		return m_frameCount;
+
+	const CaptureContainerHeader*	header = GetHeader();
+	uint64_t						mappedRecords = (m_indexLength - header->headerSize) / header->recordSize;
+	uint64_t						frameCount = header->frameCount;
+
+	// The writer updates frameCount after the record, but be defensive against a truncated index
+	if (frameCount > mappedRecords)
+		frameCount = mappedRecords;
+
+	m_frameCount = frameCount;
+	return m_frameCount;
+}
+
+const CaptureContainerRecord* CaptureContainerReader::GetRecord(uint64_t frameNumber) const
+{
+	if (frameNumber >= m_frameCount)
+		return NULL;
+
+	const CaptureContainerHeader* header = GetHeader();
+	return (const CaptureContainerRecord*)(m_index + header->headerSize + frameNumber * header->recordSize);
+}
+
+const uint8_t* CaptureContainerReader::GetVideoBytes(uint64_t frameNumber)
+{
+	const CaptureContainerRecord* record = GetRecord(frameNumber);
+
+	if (record == NULL || !(record->flags & kCaptureContainerFrameHasVideo))
+		return NULL;
+
+	return MapSegmentRange(record->segmentIndex, record->videoOffset, record->videoLength);
+}
+
+const uint8_t* CaptureContainerReader::GetAudioBytes(uint64_t frameNumber)
+{
+	const CaptureContainerRecord* record = GetRecord(frameNumber);
+
+	if (record == NULL || !(record->flags & kCaptureContainerFrameHasAudio))
+		return NULL;
+
+	return MapSegmentRange(record->segmentIndex, record->audioOffset, record->audioLength);
+}
+
+bool CaptureContainerReader::MapIndex()
+{
+	struct stat	status;
+
+	if (fstat(m_indexFile, &status) != 0 || (size_t)status.st_size < sizeof(CaptureContainerHeader))
+		return false;
+
+	if ((size_t)status.st_size == m_indexLength)
+		return true;
+
+	void* index = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, m_indexFile, 0);
+	if (index == MAP_FAILED)
+		return false;
+
+	if (m_index != NULL)
+		munmap(m_index, m_indexLength);
+
+	m_index			= (uint8_t*)index;
+	m_indexLength	= status.st_size;
+	return true;
+}
+
+const uint8_t* CaptureContainerReader::MapSegmentRange(uint32_t segmentIndex, uint64_t offset, uint64_t length)
+{
+	if (segmentIndex >= m_segments.size())
+	{
+		SegmentMapping unmapped = { NULL, 0 };
+		m_segments.resize(segmentIndex + 1, unmapped);
+	}
+
+	SegmentMapping& segment = m_segments[segmentIndex];
+
+	if (offset + length > segment.length)
+	{
+		// Segment not mapped yet, or has grown since it was mapped
+		char		filename[PATH_MAX];
+		struct stat	status;
+		int			segmentFile;
+		void*		base;
+
+		snprintf(filename, sizeof(filename), kCaptureContainerSegmentFormat, m_name.c_str(), segmentIndex);
+
+		segmentFile = open(filename, O_RDONLY);
+		if (segmentFile < 0)
+			return NULL;
+
+		if (fstat(segmentFile, &status) != 0 || (uint64_t)status.st_size < offset + length)
+		{
+			close(segmentFile);
+			return NULL;
+		}
+
+		base = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, segmentFile, 0);
+		close(segmentFile);
+
+		if (base == MAP_FAILED)
+			return NULL;
+
+		if (segment.base != NULL)
+			munmap(segment.base, segment.length);
+
+		segment.base	= (uint8_t*)base;
+		segment.length	= status.st_size;
+	}
+
+	return segment.base + offset;
+}
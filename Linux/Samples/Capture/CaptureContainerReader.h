@@ -0,0 +1,93 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __CAPTURE_CONTAINER_READER_H__
+#define __CAPTURE_CONTAINER_READER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "CaptureContainerFormat.h"
+
+// Memory maps a capture container (see CaptureContainerFormat.h) for random access to any frame.
+// The container may still be being written, call Refresh() to pick up frames appended since Open.
+// Record pointers are valid until the next call to Refresh() or Close(), byte pointers until the
+// next call to GetVideoBytes(), GetAudioBytes() or Close().
+
+class CaptureContainerReader
+{
+public:
+	CaptureContainerReader();
+	virtual ~CaptureContainerReader();
+
+	bool	Open(const char* name);
+	void	Close(void);
+
+	// Remap the index if it has grown, returns the number of complete frames
+	uint64_t						Refresh(void);
+	uint64_t						GetFrameCount(void) const { return m_frameCount; }
+	const CaptureContainerHeader*	GetHeader(void) const { return (const CaptureContainerHeader*)m_index; }
+	const CaptureContainerRecord*	GetRecord(uint64_t frameNumber) const;
+
+	// Video and audio bytes of a frame, mapped from its segment.  NULL if the frame has none
+	const uint8_t*	GetVideoBytes(uint64_t frameNumber);
+	const uint8_t*	GetAudioBytes(uint64_t frameNumber);
+
+private:
+	struct SegmentMapping
+	{
+		uint8_t*	base;
+		size_t		length;
+	};
+
+	bool			MapIndex(void);
+	const uint8_t*	MapSegmentRange(uint32_t segmentIndex, uint64_t offset, uint64_t length);
+
+	std::string						m_name;
+	int								m_indexFile;
+	uint8_t*						m_index;
+	size_t							m_indexLength;
+	uint64_t						m_frameCount;
+	std::vector<SegmentMapping>		m_segments;
+};
+
+#endif
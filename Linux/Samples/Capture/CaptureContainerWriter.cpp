@@ -0,0 +1,447 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "CaptureContainerWriter.h"
+
+static const BMDTimecodeFormat	kDefaultTimecodeFormats[] = { bmdTimecodeRP188Any, bmdTimecodeVITC };
+
+CaptureContainerWriter::CaptureContainerWriter() :
+	m_indexFile(-1),
+	m_segmentFile(-1),
+	m_segmentIndex(0),
+	m_segmentOffset(0),
+	m_segmentSize(0),
+	m_audioBytesPerSampleFrame(0),
+	m_frameCount(0),
+	m_writerThreadRunning(false),
+	m_queue(NULL),
+	m_queueDepth(0),
+	m_queueHead(0),
+	m_queuedFrames(0),
+	m_closing(false)
+{
+	pthread_mutex_init(&m_mutex, NULL);
+	pthread_cond_init(&m_queueCondition, NULL);
+	memset(&m_statistics, 0, sizeof(m_statistics));
+}
+
+CaptureContainerWriter::~CaptureContainerWriter()
+{
+	Close();
+
+	pthread_cond_destroy(&m_queueCondition);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+bool CaptureContainerWriter::Open(const char* name, uint64_t segmentSize, uint32_t queueDepth, uint32_t audioChannelCount, uint32_t audioSampleDepth)
+{
+	CaptureContainerHeader	header;
+	std::string				indexFilename = std::string(name) + kCaptureContainerIndexExtension;
+
+	if (m_indexFile != -1 || queueDepth == 0 || segmentSize == 0)
+		return false;
+
+	m_indexFile = open(indexFilename.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (m_indexFile < 0)
+	{
+		m_indexFile = -1;
+		return false;
+	}
+
+	m_name						= name;
+	m_segmentSize				= segmentSize;
+	m_audioBytesPerSampleFrame	= audioChannelCount * (audioSampleDepth / 8);
+	m_frameCount				= 0;
+	memset(&m_statistics, 0, sizeof(m_statistics));
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, kCaptureContainerMagic, sizeof(header.magic));
+	header.version				= kCaptureContainerVersion;
+	header.headerSize			= sizeof(CaptureContainerHeader);
+	header.recordSize			= sizeof(CaptureContainerRecord);
+	header.audioSampleRate		= 48000;
+	header.audioChannelCount	= audioChannelCount;
+	header.audioSampleDepth		= audioSampleDepth;
+	header.segmentSize			= segmentSize;
+	header.frameCount			= 0;
+
+	if (!WriteAt(m_indexFile, &header, sizeof(header), 0) || !OpenSegment(0))
+	{
+		Close();
+		return false;
+	}
+
+	m_statistics.segmentCount = 1;
+
+	m_queue			= new QueuedFrame[queueDepth];
+	m_queueDepth	= queueDepth;
+	m_queueHead		= 0;
+	m_queuedFrames	= 0;
+	m_closing		= false;
+
+	if (pthread_create(&m_writerThread, NULL, WriterThreadFunc, this) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_writerThreadRunning = true;
+	return true;
+}
+
+void CaptureContainerWriter::Close()
+{
+	if (m_writerThreadRunning)
+	{
+		// Let the writer thread drain the queue before it exits
+		pthread_mutex_lock(&m_mutex);
+		m_closing = true;
+		pthread_cond_signal(&m_queueCondition);
+		pthread_mutex_unlock(&m_mutex);
+
+		pthread_join(m_writerThread, NULL);
+		m_writerThreadRunning = false;
+	}
+
+	if (m_segmentFile != -1)
+	{
+		close(m_segmentFile);
+		m_segmentFile = -1;
+	}
+
+	if (m_indexFile != -1)
+	{
+		close(m_indexFile);
+		m_indexFile = -1;
+	}
+
+	delete[] m_queue;
+	m_queue = NULL;
+	m_queueDepth = 0;
+}
+
+bool CaptureContainerWriter::WriteFrame(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkVideoFrame* rightEyeFrame, IDeckLinkAudioInputPacket* audioPacket,
+										uint64_t captureFrameNumber, BMDTimeScale timeScale, BMDTimecodeFormat timecodeFormat)
+{
+	CaptureContainerRecord	record;
+	bool					queued = false;
+
+	memset(&record, 0, sizeof(record));
+	record.captureFrameNumber	= captureFrameNumber;
+	record.timeScale			= timeScale;
+
+	if (videoFrame)
+	{
+		IDeckLinkTimecode* timecode = NULL;
+
+		record.width		= (uint32_t)videoFrame->GetWidth();
+		record.height		= (uint32_t)videoFrame->GetHeight();
+		record.rowBytes		= (uint32_t)videoFrame->GetRowBytes();
+		record.pixelFormat	= videoFrame->GetPixelFormat();
+
+		videoFrame->GetStreamTime(&record.streamTime, &record.frameDuration, timeScale);
+
+		BMDTimeValue hardwareFrameDuration;
+		if (videoFrame->GetHardwareReferenceTimestamp(timeScale, &record.hardwareReferenceTime, &hardwareFrameDuration) == S_OK)
+			record.flags |= kCaptureContainerFrameHasHardwareTime;
+
+		if (videoFrame->GetFlags() & bmdFrameHasNoInputSource)
+		{
+			// Keep the timing record of frames without signal, but not their (blank) video
+			record.flags |= kCaptureContainerFrameNoInputSource;
+			videoFrame = NULL;
+			rightEyeFrame = NULL;
+		}
+		else
+		{
+			record.flags |= kCaptureContainerFrameHasVideo;
+			record.videoLength = record.rowBytes * record.height;
+
+			if (rightEyeFrame)
+			{
+				record.flags |= kCaptureContainerFrameIs3D;
+				record.videoLength *= 2;
+			}
+
+			if (timecodeFormat != 0)
+			{
+				if (videoFrame->GetTimecode(timecodeFormat, &timecode) != S_OK)
+					timecode = NULL;
+			}
+			else
+			{
+				for (size_t i = 0; i < sizeof(kDefaultTimecodeFormats) / sizeof(kDefaultTimecodeFormats[0]); i++)
+				{
+					if (videoFrame->GetTimecode(kDefaultTimecodeFormats[i], &timecode) == S_OK)
+					{
+						timecodeFormat = kDefaultTimecodeFormats[i];
+						break;
+					}
+					timecode = NULL;
+				}
+			}
+
+			if (timecode)
+			{
+				record.flags			|= kCaptureContainerFrameHasTimecode;
+				record.timecodeFormat	= timecodeFormat;
+				record.timecodeBCD		= timecode->GetBCD();
+				record.timecodeFlags	= (timecode->GetFlags() & bmdTimecodeIsDropFrame) ? kCaptureContainerTimecodeDropFrame : 0;
+				timecode->Release();
+			}
+		}
+	}
+
+	if (audioPacket)
+	{
+		record.flags					|= kCaptureContainerFrameHasAudio;
+		record.audioSampleFrameCount	= (uint32_t)audioPacket->GetSampleFrameCount();
+		record.audioLength				= record.audioSampleFrameCount * m_audioBytesPerSampleFrame;
+		audioPacket->GetPacketTime(&record.audioPacketTime, 48000);
+	}
+
+	pthread_mutex_lock(&m_mutex);
+
+	if (m_queuedFrames < m_queueDepth && !m_closing && m_statistics.writeError == 0)
+	{
+		QueuedFrame& entry = m_queue[(m_queueHead + m_queuedFrames) % m_queueDepth];
+
+		entry.record		= record;
+		entry.videoFrame	= videoFrame;
+		entry.rightEyeFrame	= rightEyeFrame;
+		entry.audioPacket	= audioPacket;
+
+		if (videoFrame)
+			videoFrame->AddRef();
+		if (rightEyeFrame)
+			rightEyeFrame->AddRef();
+		if (audioPacket)
+			audioPacket->AddRef();
+
+		if (++m_queuedFrames > m_statistics.peakQueuedFrames)
+			m_statistics.peakQueuedFrames = m_queuedFrames;
+
+		pthread_cond_signal(&m_queueCondition);
+		queued = true;
+	}
+	else
+	{
+		m_statistics.framesDropped++;
+	}
+
+	pthread_mutex_unlock(&m_mutex);
+	return queued;
+}
+
+void CaptureContainerWriter::GetStatistics(CaptureContainerWriterStatistics& statistics)
+{
+	pthread_mutex_lock(&m_mutex);
+	statistics = m_statistics;
+	pthread_mutex_unlock(&m_mutex);
+}
+
+void* CaptureContainerWriter::WriterThreadFunc(void* arg)
+{
+	static_cast<CaptureContainerWriter*>(arg)->WriterThread();
+	return NULL;
+}
+
+void CaptureContainerWriter::WriterThread()
+{
+	pthread_mutex_lock(&m_mutex);
+
+	while (true)
+	{
+		while (m_queuedFrames == 0 && !m_closing)
+			pthread_cond_wait(&m_queueCondition, &m_mutex);
+
+		if (m_queuedFrames == 0)
+			break;
+
+		QueuedFrame	frame = m_queue[m_queueHead];
+		bool		failed = (m_statistics.writeError != 0);
+
+		pthread_mutex_unlock(&m_mutex);
+
+		if (!failed && !WriteQueuedFrame(frame))
+		{
+			int writeError = errno;
+			fprintf(stderr, "Write to capture container failed: %s\n", strerror(writeError));
+
+			pthread_mutex_lock(&m_mutex);
+			m_statistics.writeError = writeError;
+			pthread_mutex_unlock(&m_mutex);
+			failed = true;
+		}
+
+		ReleaseQueuedFrame(frame);
+
+		pthread_mutex_lock(&m_mutex);
+		m_queueHead = (m_queueHead + 1) % m_queueDepth;
+		m_queuedFrames--;
+
+		if (failed)
+			m_statistics.framesDropped++;
+		else
+			m_statistics.framesWritten++;
+		m_statistics.segmentCount = m_segmentIndex + 1;
+	}
+
+	pthread_mutex_unlock(&m_mutex);
+}
+
+bool CaptureContainerWriter::WriteQueuedFrame(QueuedFrame& frame)
+{
+	CaptureContainerRecord&	record = frame.record;
+	uint64_t				frameLength = (uint64_t)record.videoLength + record.audioLength;
+	void*					bytes;
+
+	// Start a new segment if the frame does not fit, unless the segment is empty
+	if (m_segmentOffset > 0 && m_segmentOffset + frameLength > m_segmentSize)
+	{
+		if (!OpenSegment(m_segmentIndex + 1))
+			return false;
+	}
+
+	record.frameNumber	= m_frameCount;
+	record.segmentIndex	= m_segmentIndex;
+
+	if (frame.videoFrame)
+	{
+		uint32_t eyeLength = record.rowBytes * record.height;
+
+		record.videoOffset = m_segmentOffset;
+
+		frame.videoFrame->GetBytes(&bytes);
+		if (!WriteAt(m_segmentFile, bytes, eyeLength, m_segmentOffset))
+			return false;
+		m_segmentOffset += eyeLength;
+
+		if (frame.rightEyeFrame)
+		{
+			frame.rightEyeFrame->GetBytes(&bytes);
+			if (!WriteAt(m_segmentFile, bytes, eyeLength, m_segmentOffset))
+				return false;
+			m_segmentOffset += eyeLength;
+		}
+	}
+
+	if (frame.audioPacket)
+	{
+		record.audioOffset = m_segmentOffset;
+
+		frame.audioPacket->GetBytes(&bytes);
+		if (!WriteAt(m_segmentFile, bytes, record.audioLength, m_segmentOffset))
+			return false;
+		m_segmentOffset += record.audioLength;
+	}
+
+	// Publish the record only after its data, then the new frame count
+	if (!WriteAt(m_indexFile, &record, sizeof(record), sizeof(CaptureContainerHeader) + m_frameCount * sizeof(CaptureContainerRecord)))
+		return false;
+
+	m_frameCount++;
+	return WriteAt(m_indexFile, &m_frameCount, sizeof(m_frameCount), offsetof(CaptureContainerHeader, frameCount));
+}
+
+bool CaptureContainerWriter::OpenSegment(uint32_t segmentIndex)
+{
+	char filename[PATH_MAX];
+
+	if (m_segmentFile != -1)
+	{
+		close(m_segmentFile);
+		m_segmentFile = -1;
+	}
+
+	snprintf(filename, sizeof(filename), kCaptureContainerSegmentFormat, m_name.c_str(), segmentIndex);
+
+	m_segmentFile = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (m_segmentFile < 0)
+	{
+		m_segmentFile = -1;
+		return false;
+	}
+
+	m_segmentIndex	= segmentIndex;
+	m_segmentOffset	= 0;
+	return true;
+}
+
+bool CaptureContainerWriter::WriteAt(int fd, const void* bytes, size_t length, uint64_t offset)
+{
+	const uint8_t* data = (const uint8_t*)bytes;
+
+	while (length > 0)
+	{
+		ssize_t written = pwrite(fd, data, length, (off_t)offset);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+
+		data	+= written;
+		length	-= written;
+		offset	+= written;
+	}
+
+	return true;
+}
+
+void CaptureContainerWriter::ReleaseQueuedFrame(QueuedFrame& frame)
+{
+	if (frame.videoFrame)
+		frame.videoFrame->Release();
+	if (frame.rightEyeFrame)
+		frame.rightEyeFrame->Release();
+	if (frame.audioPacket)
+		frame.audioPacket->Release();
+}
@@ -0,0 +1,120 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __CAPTURE_CONTAINER_WRITER_H__
+#define __CAPTURE_CONTAINER_WRITER_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+
+#include "DeckLinkAPI.h"
+#include "CaptureContainerFormat.h"
+
+// Writes captured frames to a segmented capture container (see CaptureContainerFormat.h) from a
+// dedicated thread.  Frame metadata is read on the calling thread, while the frame and audio
+// packet are held by reference until their bytes have been written.  When the queue is full the
+// frame is dropped, which shows as a gap in the record captureFrameNumber.
+
+struct CaptureContainerWriterStatistics
+{
+	uint64_t	framesWritten;
+	uint64_t	framesDropped;
+	uint32_t	segmentCount;
+	uint32_t	peakQueuedFrames;
+	int			writeError;				// errno of the first failed write, 0 if none
+};
+
+class CaptureContainerWriter
+{
+public:
+	CaptureContainerWriter();
+	virtual ~CaptureContainerWriter();
+
+	bool	Open(const char* name, uint64_t segmentSize, uint32_t queueDepth, uint32_t audioChannelCount, uint32_t audioSampleDepth);
+	void	Close(void);
+	bool	IsOpen(void) const { return m_indexFile != -1; }
+
+	// Queue a frame for writing, any of the frames or audio packet may be NULL.  If timecodeFormat
+	// is 0, RP188 timecode is recorded, or VITC if there is no RP188.  Returns false if the frame was dropped
+	bool	WriteFrame(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkVideoFrame* rightEyeFrame, IDeckLinkAudioInputPacket* audioPacket,
+					   uint64_t captureFrameNumber, BMDTimeScale timeScale, BMDTimecodeFormat timecodeFormat);
+
+	void	GetStatistics(CaptureContainerWriterStatistics& statistics);
+
+private:
+	struct QueuedFrame
+	{
+		CaptureContainerRecord		record;
+		IDeckLinkVideoInputFrame*	videoFrame;
+		IDeckLinkVideoFrame*		rightEyeFrame;
+		IDeckLinkAudioInputPacket*	audioPacket;
+	};
+
+	static void*	WriterThreadFunc(void* arg);
+	void			WriterThread(void);
+	bool			WriteQueuedFrame(QueuedFrame& frame);
+	bool			OpenSegment(uint32_t segmentIndex);
+	bool			WriteAt(int fd, const void* bytes, size_t length, uint64_t offset);
+	void			ReleaseQueuedFrame(QueuedFrame& frame);
+
+	std::string			m_name;
+	int					m_indexFile;
+	int					m_segmentFile;
+	uint32_t			m_segmentIndex;
+	uint64_t			m_segmentOffset;
+	uint64_t			m_segmentSize;
+	uint32_t			m_audioBytesPerSampleFrame;
+	uint64_t			m_frameCount;
+	//
+	pthread_t			m_writerThread;
+	bool				m_writerThreadRunning;
+	pthread_mutex_t		m_mutex;
+	pthread_cond_t		m_queueCondition;
+	QueuedFrame*		m_queue;
+	uint32_t			m_queueDepth;
+	uint32_t			m_queueHead;
+	uint32_t			m_queuedFrames;
+	bool				m_closing;
+	//
+	CaptureContainerWriterStatistics	m_statistics;
+};
+
+#endif
@@ -0,0 +1,272 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+// CaptureInfo prints the contents of a capture container written with Capture -f, and can
+// extract frames from it.  With -w it follows a capture that is still being written.
+
+#include <csignal>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "CaptureContainerReader.h"
+
+static bool g_do_exit = false;
+
+static void sigfunc(int signum)
+{
+	if (signum == SIGINT || signum == SIGTERM)
+		g_do_exit = true;
+}
+
+static void DisplayUsage(int status)
+{
+	fprintf(stderr,
+		"Usage: CaptureInfo [OPTIONS] <name>\n"
+		"\n"
+		"    <name>               Capture container name, as given to Capture -f\n"
+		"    -l                   List the index record of every frame\n"
+		"    -x <frame>           Extract the video of frame number <frame>\n"
+		"    -o <filename>        File extracted video is written to (default is stdout)\n"
+		"    -w                   Follow a capture in progress, listing frames as they are written\n"
+	);
+
+	exit(status);
+}
+
+static void FormatTimecode(const CaptureContainerRecord* record, char* timecodeString, size_t length)
+{
+	if (!(record->flags & kCaptureContainerFrameHasTimecode))
+	{
+		snprintf(timecodeString, length, "--:--:--:--");
+		return;
+	}
+
+	snprintf(timecodeString, length, "%02x:%02x:%02x%c%02x",
+		(record->timecodeBCD >> 24) & 0xFF,
+		(record->timecodeBCD >> 16) & 0xFF,
+		(record->timecodeBCD >> 8) & 0xFF,
+		(record->timecodeFlags & kCaptureContainerTimecodeDropFrame) ? ';' : ':',
+		record->timecodeBCD & 0xFF);
+}
+
+static void PrintRecord(const CaptureContainerRecord* record)
+{
+	char	timecodeString[16];
+	char	pixelFormat[5];
+
+	FormatTimecode(record, timecodeString, sizeof(timecodeString));
+
+	for (int i = 0; i < 4; i++)
+	{
+		char c = (char)(record->pixelFormat >> (24 - 8 * i));
+		pixelFormat[i] = (c >= ' ' && c <= '~') ? c : '?';
+	}
+	pixelFormat[4] = '\0';
+
+	printf("%8llu %8llu  %5u:%-12llu %4ux%-4u %s%s  %s  %12.6f s  %12.6f s  audio %6lld +%u\n",
+		(unsigned long long)record->frameNumber,
+		(unsigned long long)record->captureFrameNumber,
+		record->segmentIndex,
+		(unsigned long long)record->videoOffset,
+		record->width,
+		record->height,
+		pixelFormat,
+		(record->flags & kCaptureContainerFrameIs3D) ? " 3D" : (record->flags & kCaptureContainerFrameNoInputSource) ? " NS" : "   ",
+		timecodeString,
+		record->timeScale ? (double)record->streamTime / record->timeScale : 0.0,
+		(record->flags & kCaptureContainerFrameHasHardwareTime) && record->timeScale ? (double)record->hardwareReferenceTime / record->timeScale : 0.0,
+		(long long)record->audioPacketTime,
+		record->audioSampleFrameCount);
+}
+
+static void PrintRecordHeading(void)
+{
+	printf("   frame  capture  segment:offset       size/format      timecode      stream time      hardware time  audio time/samples\n");
+}
+
+static void PrintSummary(CaptureContainerReader& reader)
+{
+	const CaptureContainerHeader*	header = reader.GetHeader();
+	uint64_t						frameCount = reader.GetFrameCount();
+	uint64_t						missingFrames = 0;
+	uint64_t						audioSampleFrames = 0;
+	char							timecodeString[16];
+
+	for (uint64_t i = 0; i < frameCount; i++)
+	{
+		const CaptureContainerRecord* record = reader.GetRecord(i);
+
+		audioSampleFrames += record->audioSampleFrameCount;
+		if (i > 0)
+			missingFrames += record->captureFrameNumber - reader.GetRecord(i - 1)->captureFrameNumber - 1;
+	}
+
+	printf("Frames:          %llu (%llu not written)\n", (unsigned long long)frameCount, (unsigned long long)missingFrames);
+	printf("Segments:        %u (maximum %llu bytes)\n",
+		frameCount ? reader.GetRecord(frameCount - 1)->segmentIndex + 1 : 0,
+		(unsigned long long)header->segmentSize);
+	printf("Audio:           %u channels, %u bit, %u Hz, %llu sample frames\n",
+		header->audioChannelCount, header->audioSampleDepth, header->audioSampleRate, (unsigned long long)audioSampleFrames);
+
+	if (frameCount > 0)
+	{
+		const CaptureContainerRecord* first = reader.GetRecord(0);
+		const CaptureContainerRecord* last = reader.GetRecord(frameCount - 1);
+
+		FormatTimecode(first, timecodeString, sizeof(timecodeString));
+		printf("First frame:     %s", timecodeString);
+		FormatTimecode(last, timecodeString, sizeof(timecodeString));
+		printf(", last frame: %s\n", timecodeString);
+
+		if (first->timeScale == last->timeScale && last->timeScale != 0)
+			printf("Duration:        %.3f s\n", (double)(last->streamTime + last->frameDuration - first->streamTime) / last->timeScale);
+	}
+}
+
+static bool ExtractFrame(CaptureContainerReader& reader, uint64_t frameNumber, const char* filename)
+{
+	const CaptureContainerRecord*	record = reader.GetRecord(frameNumber);
+	const uint8_t*					videoBytes = reader.GetVideoBytes(frameNumber);
+	FILE*							file;
+	bool							result;
+
+	if (record == NULL || videoBytes == NULL)
+	{
+		fprintf(stderr, "Frame %llu has no video\n", (unsigned long long)frameNumber);
+		return false;
+	}
+
+	file = filename ? fopen(filename, "wb") : stdout;
+	if (file == NULL)
+	{
+		fprintf(stderr, "Could not open output file \"%s\"\n", filename);
+		return false;
+	}
+
+	result = (fwrite(videoBytes, 1, record->videoLength, file) == record->videoLength);
+
+	if (file != stdout)
+		fclose(file);
+
+	return result;
+}
+
+int main(int argc, char *argv[])
+{
+	CaptureContainerReader	reader;
+	bool					listFrames = false;
+	bool					followCapture = false;
+	long long				extractFrame = -1;
+	const char*				extractFilename = NULL;
+	int						ch;
+
+	while ((ch = getopt(argc, argv, "lx:o:wh?")) != -1)
+	{
+		switch (ch)
+		{
+			case 'l':
+				listFrames = true;
+				break;
+
+			case 'x':
+				extractFrame = atoll(optarg);
+				break;
+
+			case 'o':
+				extractFilename = optarg;
+				break;
+
+			case 'w':
+				followCapture = true;
+				break;
+
+			case '?':
+			case 'h':
+				DisplayUsage(0);
+		}
+	}
+
+	if (optind != argc - 1)
+		DisplayUsage(1);
+
+	if (!reader.Open(argv[optind]))
+	{
+		fprintf(stderr, "Could not open capture container \"%s\"\n", argv[optind]);
+		return 1;
+	}
+
+	if (extractFrame >= 0)
+		return ExtractFrame(reader, (uint64_t)extractFrame, extractFilename) ? 0 : 1;
+
+	if (followCapture)
+	{
+		uint64_t printedFrames = 0;
+
+		signal(SIGINT, sigfunc);
+		signal(SIGTERM, sigfunc);
+
+		PrintRecordHeading();
+		while (!g_do_exit)
+		{
+			uint64_t frameCount = reader.Refresh();
+
+			for (; printedFrames < frameCount; printedFrames++)
+				PrintRecord(reader.GetRecord(printedFrames));
+
+			fflush(stdout);
+			usleep(100000);
+		}
+		return 0;
+	}
+
+	PrintSummary(reader);
+
+	if (listFrames)
+	{
+		printf("\n");
+		PrintRecordHeading();
+		for (uint64_t i = 0; i < reader.GetFrameCount(); i++)
+			PrintRecord(reader.GetRecord(i));
+	}
+
+	return 0;
+}
@@ -56,6 +56,15 @@ BMDConfig::BMDConfig() :
 	m_timecodeFormat(),
 	m_videoOutputFile(),
 	m_audioOutputFile(),
+	m_directIO(false),
+	m_containerName(),
+	m_containerSegmentSize(4096ULL * 1024 * 1024),
+	m_frameBusName(),
+	m_st2110Address(),
+	m_st2110Port(5004),
+	m_frameID(false),
+	m_avSync(false),
+	m_avSyncThreshold(40.0),
 	m_deckLinkName(),
 	m_displayModeName()
 {
@@ -75,7 +84,7 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 	int		ch;
 	bool	displayHelp = false;
 
-	while ((ch = getopt(argc, argv, "d:?h3c:s:v:a:m:n:p:t:")) != -1)
+	while ((ch = getopt(argc, argv, "d:?h3c:s:v:a:m:n:p:t:uf:g:b:r:iyY:")) != -1)
 	{
 		switch (ch)
 		{
@@ -115,10 +124,61 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 				m_audioOutputFile = optarg;
 				break;
 
+			case 'u':
+				m_directIO = true;
+				break;
+
+			case 'f':
+				m_containerName = optarg;
+				break;
+
+			case 'g':
+				m_containerSegmentSize = strtoull(optarg, NULL, 10) * 1024 * 1024;
+				if (m_containerSegmentSize == 0)
+				{
+					fprintf(stderr, "Invalid argument: Segment size must be at least 1 MiB\n");
+					return false;
+				}
+				break;
+
+			case 'b':
+				m_frameBusName = optarg;
+				break;
+
+			case 'r':
+			{
+				char* port = strrchr(optarg, ':');
+				if (port != NULL)
+				{
+					*port = '\0';
+					m_st2110Port = (uint16_t)atoi(port + 1);
+				}
+				m_st2110Address = optarg;
+				break;
+			}
+
 			case 'n':
 				m_maxFrames = atoi(optarg);
 				break;
 
+			case 'i':
+				m_frameID = true;
+				break;
+
+			case 'y':
+				m_avSync = true;
+				break;
+
+			case 'Y':
+				m_avSync = true;
+				m_avSyncThreshold = atof(optarg);
+				if (m_avSyncThreshold <= 0.0)
+				{
+					fprintf(stderr, "Invalid argument: A/V sync alarm threshold must be greater than 0 ms\n");
+					return false;
+				}
+				break;
+
 			case '3':
 				m_inputFlags |= bmdVideoInputDualStream3D;
 				break;
@@ -444,9 +504,22 @@ bail:
 		"         serial: Serial Timecode\n"
 		"    -v <filename>        Filename raw video will be written to\n"
 		"    -a <filename>        Filename raw audio will be written to\n"
+		"    -u                   Write raw video with direct I/O (O_DIRECT), bypassing the page cache\n"
+		"    -f <name>            Write video, audio and timecode to an indexed capture container <name>.dlidx\n"
+		"                         and segments <name>.NNNNN.dlseg, which can be read with CaptureInfo\n"
+		"    -g <MiB>             Capture container segment size (default is 4096)\n"
+		"    -b <name>            Publish frames to the shared memory frame bus /<name>, for any number of\n"
+		"                         FrameBusMonitor or other reader processes\n"
+		"    -r <host>[:<port>]   Send 10 bit YUV video as ST 2110-20 RTP to port (default is 5004) and audio as\n"
+		"                         ST 2110-30 to port + 2, which can be played out with ST2110Playout\n"
 		"    -c <channels>        Audio Channels (2, 8 or 16 - default is 2)\n"
 		"    -s <depth>           Audio Sample Depth (16 or 32 - default is 16)\n"
 		"    -n <frames>          Number of frames to capture (default is unlimited)\n"
+		"    -i                   Decode the frame ID code embedded by TestPattern -i, and report latency\n"
+		"                         and dropped, repeated and out-of-order frames\n"
+		"    -y                   Measure the A/V sync offset of a pip signal (TestPattern or SignalGenerator\n"
+		"                         pip output) from the flash and the tone burst on each audio channel\n"
+		"    -Y <ms>              A/V sync alarm threshold, implies -y (default is 40)\n"
 		"    -3                   Capture Stereoscopic 3D (Requires 3D Hardware support)\n"
 		"\n"
 		"Capture video and/or audio to a file. Raw video and/or audio can be viewed with mplayer eg:\n"
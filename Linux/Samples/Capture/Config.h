@@ -67,6 +67,15 @@ public:
 
 	const char*				m_videoOutputFile;
 	const char*				m_audioOutputFile;
+	bool					m_directIO;
+	const char*				m_containerName;
+	uint64_t				m_containerSegmentSize;
+	const char*				m_frameBusName;
+	const char*				m_st2110Address;
+	uint16_t				m_st2110Port;
+	bool					m_frameID;
+	bool					m_avSync;
+	double					m_avSyncThreshold;
 
 	IDeckLink* GetSelectedDeckLink(void);
 	IDeckLinkDisplayMode* GetSelectedDeckLinkDisplayMode(IDeckLink* deckLink);
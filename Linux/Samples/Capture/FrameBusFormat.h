@@ -0,0 +1,133 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __FRAME_BUS_FORMAT_H__
+#define __FRAME_BUS_FORMAT_H__
+
+#include <atomic>
+#include <stdint.h>
+
+// Shared-memory frame bus.
+//
+// Capture -b <name> publishes every captured frame to the POSIX shared memory object /<name>, so
+// any number of other processes can read the same input without a card of their own.  The
+// object is a header, a sequence index, one descriptor per slot, then the slots' video and audio
+// buffers, each starting on a page boundary.  Capture gives the video buffers to the driver with
+// IDeckLinkMemoryAllocator, so frames are captured straight into the slots and not copied.
+//
+// Frames are numbered from 1.  Publishing frame n fills in its slot's descriptor, stores n in the
+// descriptor's sequence, stores the slot in index[n % slotCount] and then stores n in
+// header.publishedSequence.  A slot's sequence is set to 0 before its buffers are reused, so a
+// reader checks the sequence before and after using a frame to know that it was not overwritten
+// meanwhile.  Readers map the object read-only and nothing they do is seen by Capture, a reader
+// that falls behind loses frames and is never waited for.
+//
+// Slots are reused in the order they were released by the driver, so the most recent frames stay
+// readable for about slotCount less the frames the driver holds for capture.
+
+static const uint32_t	kFrameBusMagic			= 0x42464c44;		// "DLFB"
+static const uint32_t	kFrameBusVersion		= 1;
+static const uint32_t	kFrameBusBufferAlignment	= 4096;
+
+enum
+{
+	kFrameBusFrameHasAudio				= 1 << 0,
+	kFrameBusFrameHasTimecode			= 1 << 1,
+	kFrameBusFrameHasHardwareTime		= 1 << 2,
+	kFrameBusFrameNoInputSource			= 1 << 3,	// Frame was captured without a valid input signal
+	kFrameBusFrameAudioTruncated		= 1 << 4,	// Audio packet was larger than the slot's audio buffer
+};
+
+enum
+{
+	kFrameBusTimecodeDropFrame			= 1 << 0,	// Matches bmdTimecodeIsDropFrame
+};
+
+struct FrameBusHeader
+{
+	uint32_t				magic;
+	uint32_t				version;
+	uint32_t				slotCount;
+	uint32_t				descriptorSize;
+	uint64_t				indexOffset;			// Offset of the uint32_t sequence index, slotCount entries
+	uint64_t				descriptorOffset;		// Offset of the slot descriptors
+	uint64_t				bufferOffset;			// Offset of the first slot's video buffer
+	uint64_t				slotStride;				// Offset between the video buffers of consecutive slots
+	uint32_t				videoBufferSize;
+	uint32_t				audioBufferSize;		// Audio buffer follows the video buffer in each slot
+	uint32_t				audioSampleRate;
+	uint32_t				audioChannelCount;
+	uint32_t				audioSampleDepth;		// Bits per sample
+	int32_t					producerPid;
+	std::atomic<uint32_t>	closed;					// Set when Capture stops publishing
+	uint8_t					reserved1[52];
+
+	// Written on every frame, kept off the cache line of the fields above
+	alignas(64) std::atomic<uint64_t>	publishedSequence;		// Last published frame, 0 if none
+	std::atomic<uint32_t>				publishCount;			// Futex word, incremented on every publish
+	uint8_t								reserved2[52];
+};
+
+struct FrameBusDescriptor
+{
+	std::atomic<uint64_t>	sequence;				// Frame in the slot, 0 while its buffers are being written
+	int64_t					streamTime;				// Video stream time, in timeScale units
+	int64_t					frameDuration;			// In timeScale units
+	int64_t					timeScale;
+	int64_t					hardwareReferenceTime;	// Hardware reference timestamp of frame arrival, in timeScale units
+	int64_t					audioPacketTime;		// Time of the first audio sample, in audio sample frames
+	uint32_t				flags;					// kFrameBusFrame flags
+	uint32_t				width;
+	uint32_t				height;
+	uint32_t				rowBytes;
+	uint32_t				pixelFormat;			// BMDPixelFormat
+	uint32_t				videoLength;
+	uint32_t				audioSampleFrameCount;
+	uint32_t				timecodeFormat;			// BMDTimecodeFormat
+	uint32_t				timecodeBCD;			// 0xHHMMSSFF
+	uint32_t				timecodeFlags;			// kFrameBusTimecode flags
+	uint8_t					reserved[40];
+};
+
+static_assert(sizeof(FrameBusHeader) == 192, "FrameBusHeader size is part of the shared memory layout");
+static_assert(sizeof(FrameBusDescriptor) == 128, "FrameBusDescriptor size is part of the shared memory layout");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "Frame bus atomics must be lock-free to be shared between processes");
+
+#endif
@@ -0,0 +1,257 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+// FrameBusMonitor reads the frames Capture -b publishes to a shared-memory frame bus, printing
+// a summary each second.  Any number of monitors may read the same bus, and -d simulates a slow
+// reader to show how lag and lost frames are reported without holding up Capture.
+
+#include <csignal>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "FrameBusReader.h"
+
+static const int	kReadTimeoutMilliseconds = 100;
+
+static bool g_do_exit = false;
+
+static void sigfunc(int signum)
+{
+	if (signum == SIGINT || signum == SIGTERM)
+		g_do_exit = true;
+}
+
+static void DisplayUsage(int status)
+{
+	fprintf(stderr,
+		"Usage: FrameBusMonitor [OPTIONS] <name>\n"
+		"\n"
+		"    <name>               Frame bus name, as given to Capture -b\n"
+		"    -d <milliseconds>    Time taken to process each frame, to simulate a slow reader\n"
+		"    -o <filename>        Write the video of each frame read to a file\n"
+		"    -v                   Print a line for every frame read\n"
+	);
+
+	exit(status);
+}
+
+static double GetMonotonicSeconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void FormatTimecode(const FrameBusDescriptor& descriptor, char* timecodeString, size_t length)
+{
+	if (!(descriptor.flags & kFrameBusFrameHasTimecode))
+	{
+		snprintf(timecodeString, length, "--:--:--:--");
+		return;
+	}
+
+	snprintf(timecodeString, length, "%02x:%02x:%02x%c%02x",
+		(descriptor.timecodeBCD >> 24) & 0xFF,
+		(descriptor.timecodeBCD >> 16) & 0xFF,
+		(descriptor.timecodeBCD >> 8) & 0xFF,
+		(descriptor.timecodeFlags & kFrameBusTimecodeDropFrame) ? ';' : ':',
+		descriptor.timecodeBCD & 0xFF);
+}
+
+// Touches one word in every cache line of the frame, standing in for a reader's processing
+static uint32_t ChecksumFrame(const FrameBusFrame& frame)
+{
+	const uint32_t*	words = (const uint32_t*)frame.videoBytes;
+	uint32_t		wordCount = frame.descriptor.videoLength / sizeof(uint32_t);
+	uint32_t		checksum = 0;
+
+	for (uint32_t i = 0; i < wordCount; i += 16)
+		checksum = (checksum << 1 | checksum >> 31) ^ words[i];
+
+	return checksum;
+}
+
+static void PrintStatistics(const char* prefix, const FrameBusReaderStatistics& statistics, const FrameBusReaderStatistics& previous, FrameBusReader& reader)
+{
+	fprintf(stderr, "%s%llu frames read, %llu lost, %llu invalidated, lag %llu (max %llu)\n",
+		prefix,
+		(unsigned long long)(statistics.framesRead - previous.framesRead),
+		(unsigned long long)(statistics.framesLost - previous.framesLost),
+		(unsigned long long)(statistics.framesInvalidated - previous.framesInvalidated),
+		(unsigned long long)reader.GetLag(),
+		(unsigned long long)statistics.maxLag);
+}
+
+int main(int argc, char *argv[])
+{
+	FrameBusReader				reader;
+	const FrameBusHeader*		header;
+	FrameBusFrame				frame;
+	FrameBusReaderStatistics	statistics;
+	FrameBusReaderStatistics	lastStatistics;
+	FrameBusReaderStatistics	noStatistics;
+	int							processingMilliseconds = 0;
+	const char*					outputFilename = NULL;
+	FILE*						outputFile = NULL;
+	bool						verbose = false;
+	double						lastPrintTime;
+	char						timecodeString[16];
+	int							exitStatus = 1;
+	int							ch;
+
+	while ((ch = getopt(argc, argv, "d:o:vh?")) != -1)
+	{
+		switch (ch)
+		{
+			case 'd':
+				processingMilliseconds = atoi(optarg);
+				break;
+
+			case 'o':
+				outputFilename = optarg;
+				break;
+
+			case 'v':
+				verbose = true;
+				break;
+
+			case '?':
+			case 'h':
+				DisplayUsage(0);
+		}
+	}
+
+	if (optind != argc - 1)
+		DisplayUsage(1);
+
+	if (!reader.Open(argv[optind]))
+	{
+		fprintf(stderr, "Could not open frame bus \"%s\"\n", argv[optind]);
+		return 1;
+	}
+
+	if (outputFilename != NULL)
+	{
+		outputFile = fopen(outputFilename, "wb");
+		if (outputFile == NULL)
+		{
+			fprintf(stderr, "Could not open output file \"%s\"\n", outputFilename);
+			goto bail;
+		}
+	}
+
+	header = reader.GetHeader();
+	fprintf(stderr, "Frame bus /%s: %u slots, %u byte video buffers, audio %u channels %u bit, published by process %d\n",
+		argv[optind],
+		header->slotCount,
+		header->videoBufferSize,
+		header->audioChannelCount,
+		header->audioSampleDepth,
+		header->producerPid);
+
+	signal(SIGINT, sigfunc);
+	signal(SIGTERM, sigfunc);
+
+	memset(&noStatistics, 0, sizeof(noStatistics));
+	lastStatistics = noStatistics;
+	lastPrintTime = GetMonotonicSeconds();
+	exitStatus = 0;
+
+	while (!g_do_exit)
+	{
+		FrameBusReadResult result = reader.ReadFrame(frame, kReadTimeoutMilliseconds);
+
+		if (result == kFrameBusReadClosed)
+		{
+			fprintf(stderr, "Capture stopped publishing\n");
+			break;
+		}
+
+		if (result == kFrameBusReadFrame)
+		{
+			uint32_t checksum = ChecksumFrame(frame);
+
+			if (processingMilliseconds > 0)
+				usleep(processingMilliseconds * 1000);
+
+			// Anything written from the frame must be checked before it is trusted
+			if (outputFile != NULL)
+				fwrite(frame.videoBytes, 1, frame.descriptor.videoLength, outputFile);
+
+			bool valid = reader.IsFrameValid(frame);
+
+			if (verbose)
+			{
+				FormatTimecode(frame.descriptor, timecodeString, sizeof(timecodeString));
+				printf("Frame %llu [%s] - %ux%u - %u audio sample frames - checksum %08x%s\n",
+					(unsigned long long)frame.sequence,
+					timecodeString,
+					frame.descriptor.width,
+					frame.descriptor.height,
+					frame.descriptor.audioSampleFrameCount,
+					checksum,
+					valid ? "" : " - overwritten while in use");
+			}
+		}
+
+		if (GetMonotonicSeconds() - lastPrintTime >= 1.0)
+		{
+			reader.GetStatistics(statistics);
+			PrintStatistics("", statistics, lastStatistics, reader);
+			lastStatistics = statistics;
+			lastPrintTime += 1.0;
+		}
+	}
+
+	reader.GetStatistics(statistics);
+	PrintStatistics("Total: ", statistics, noStatistics, reader);
+
+bail:
+	if (outputFile != NULL)
+		fclose(outputFile);
+
+	reader.Close();
+
+	return exitStatus;
+}
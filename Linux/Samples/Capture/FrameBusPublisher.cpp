@@ -0,0 +1,491 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <climits>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "FrameBusPublisher.h"
+
+static const BMDTimecodeFormat	kDefaultTimecodeFormats[] = { bmdTimecodeRP188Any, bmdTimecodeVITC };
+
+// Audio per slot, enough for the audio of a frame at the lowest frame rates
+static const uint32_t			kMaxAudioSampleFramesPerSlot = 4800;
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+FrameBusPublisher::FrameBusPublisher() :
+	m_refCount(1),
+	m_name(NULL),
+	m_closed(false),
+	m_mapping(NULL),
+	m_mappingSize(0),
+	m_header(NULL),
+	m_index(NULL),
+	m_descriptors(NULL),
+	m_sequence(0),
+	m_audioBytesPerSampleFrame(0),
+	m_freeSlots(NULL),
+	m_freeHead(0),
+	m_freeCount(0)
+{
+	pthread_mutex_init(&m_mutex, NULL);
+	memset(&m_statistics, 0, sizeof(m_statistics));
+}
+
+FrameBusPublisher::~FrameBusPublisher()
+{
+	Close();
+
+	// The driver has released every buffer, so the slots can be unmapped
+	if (m_mapping)
+		munmap(m_mapping, m_mappingSize);
+
+	free(m_freeSlots);
+	free(m_name);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+bool FrameBusPublisher::Open(const char* name, uint32_t slotCount, uint32_t videoBufferSize, uint32_t audioChannelCount, uint32_t audioSampleDepth)
+{
+	uint64_t	indexOffset;
+	uint64_t	descriptorOffset;
+	uint64_t	bufferOffset;
+	uint64_t	slotStride;
+	uint32_t	audioBufferSize;
+	void*		mapping;
+	int			fd;
+
+	if (m_header != NULL || slotCount == 0)
+		return false;
+
+	// Shared memory object names have a single leading slash
+	while (*name == '/')
+		name++;
+
+	m_name = (char*)malloc(strlen(name) + 2);
+	sprintf(m_name, "/%s", name);
+
+	m_audioBytesPerSampleFrame	= audioChannelCount * (audioSampleDepth / 8);
+	videoBufferSize				= (uint32_t)AlignUp(videoBufferSize, kFrameBusBufferAlignment);
+	audioBufferSize				= (uint32_t)AlignUp(kMaxAudioSampleFramesPerSlot * m_audioBytesPerSampleFrame, kFrameBusBufferAlignment);
+
+	indexOffset					= sizeof(FrameBusHeader);
+	descriptorOffset			= AlignUp(indexOffset + slotCount * sizeof(uint32_t), 64);
+	bufferOffset				= AlignUp(descriptorOffset + slotCount * sizeof(FrameBusDescriptor), kFrameBusBufferAlignment);
+	slotStride					= (uint64_t)videoBufferSize + audioBufferSize;
+	m_mappingSize				= bufferOffset + slotCount * slotStride;
+
+	// Replace the bus of a previous capture, its readers keep their mapping of the old object
+	shm_unlink(m_name);
+
+	fd = shm_open(m_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd < 0)
+	{
+		fprintf(stderr, "Could not create frame bus %s - %s\n", m_name, strerror(errno));
+		return false;
+	}
+
+	if (ftruncate(fd, (off_t)m_mappingSize) != 0)
+	{
+		fprintf(stderr, "Could not size frame bus %s to %llu bytes - %s\n", m_name, (unsigned long long)m_mappingSize, strerror(errno));
+		close(fd);
+		shm_unlink(m_name);
+		return false;
+	}
+
+	mapping = mmap(NULL, m_mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (mapping == MAP_FAILED)
+	{
+		fprintf(stderr, "Could not map frame bus %s - %s\n", m_name, strerror(errno));
+		shm_unlink(m_name);
+		return false;
+	}
+
+	m_freeSlots = (uint32_t*)malloc(slotCount * sizeof(uint32_t));
+	for (uint32_t slot = 0; slot < slotCount; slot++)
+		m_freeSlots[slot] = slot;
+	m_freeHead	= 0;
+	m_freeCount	= slotCount;
+
+	// The object is zero filled, so every slot's sequence is already 0
+	m_mapping		= (uint8_t*)mapping;
+	m_header		= (FrameBusHeader*)m_mapping;
+	m_index			= (std::atomic<uint32_t>*)(m_mapping + indexOffset);
+	m_descriptors	= (FrameBusDescriptor*)(m_mapping + descriptorOffset);
+
+	m_header->version			= kFrameBusVersion;
+	m_header->slotCount			= slotCount;
+	m_header->descriptorSize	= sizeof(FrameBusDescriptor);
+	m_header->indexOffset		= indexOffset;
+	m_header->descriptorOffset	= descriptorOffset;
+	m_header->bufferOffset		= bufferOffset;
+	m_header->slotStride		= slotStride;
+	m_header->videoBufferSize	= videoBufferSize;
+	m_header->audioBufferSize	= audioBufferSize;
+	m_header->audioSampleRate	= 48000;
+	m_header->audioChannelCount	= audioChannelCount;
+	m_header->audioSampleDepth	= audioSampleDepth;
+	m_header->producerPid		= getpid();
+
+	// Readers check the magic number last, so they never see a partly written header
+	std::atomic_thread_fence(std::memory_order_release);
+	m_header->magic				= kFrameBusMagic;
+
+	return true;
+}
+
+void FrameBusPublisher::Close(void)
+{
+	if (m_header == NULL || m_closed)
+		return;
+
+	// Readers see the bus close once they have read the last frame
+	m_header->closed.store(1, std::memory_order_release);
+	m_header->publishCount.fetch_add(1, std::memory_order_release);
+	syscall(SYS_futex, &m_header->publishCount, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+
+	shm_unlink(m_name);
+	m_closed = true;
+}
+
+uint32_t FrameBusPublisher::GetSlot(const void* buffer) const
+{
+	const uint8_t* bytes = (const uint8_t*)buffer;
+
+	if (m_header == NULL || bytes < GetVideoBuffer(0) || bytes >= m_mapping + m_mappingSize)
+		return kNoSlot;
+
+	uint64_t offset = bytes - GetVideoBuffer(0);
+	if (offset % m_header->slotStride != 0)
+		return kNoSlot;
+
+	return (uint32_t)(offset / m_header->slotStride);
+}
+
+uint32_t FrameBusPublisher::PopFreeSlot(void)
+{
+	uint32_t slot = kNoSlot;
+
+	pthread_mutex_lock(&m_mutex);
+
+	if (m_freeCount > 0)
+	{
+		slot = m_freeSlots[m_freeHead];
+		m_freeHead = (m_freeHead + 1) % m_header->slotCount;
+		m_freeCount--;
+
+		uint32_t slotsInUse = m_header->slotCount - m_freeCount;
+		m_statistics.slotsInUse = slotsInUse;
+		if (slotsInUse > m_statistics.peakSlotsInUse)
+			m_statistics.peakSlotsInUse = slotsInUse;
+	}
+
+	pthread_mutex_unlock(&m_mutex);
+
+	if (slot != kNoSlot)
+	{
+		// Readers of the slot's previous frame see it invalidated before its buffers are reused
+		m_descriptors[slot].sequence.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+	}
+
+	return slot;
+}
+
+void FrameBusPublisher::PushFreeSlot(uint32_t slot)
+{
+	pthread_mutex_lock(&m_mutex);
+
+	m_freeSlots[(m_freeHead + m_freeCount) % m_header->slotCount] = slot;
+	m_freeCount++;
+	m_statistics.slotsInUse = m_header->slotCount - m_freeCount;
+
+	pthread_mutex_unlock(&m_mutex);
+}
+
+FrameBusPublishResult FrameBusPublisher::Publish(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkAudioInputPacket* audioPacket, BMDTimeScale timeScale, BMDTimecodeFormat timecodeFormat)
+{
+	IDeckLinkTimecode*	timecode = NULL;
+	void*				videoBytes = NULL;
+	uint32_t			videoLength;
+	uint32_t			slot;
+	bool				copied = false;
+
+	if (!IsOpen() || videoFrame == NULL)
+		return kFrameBusClosed;
+
+	videoLength = (uint32_t)(videoFrame->GetRowBytes() * videoFrame->GetHeight());
+	videoFrame->GetBytes(&videoBytes);
+
+	slot = GetSlot(videoBytes);
+	if (slot == kNoSlot)
+	{
+		// Captured into a heap buffer, copy into a free slot
+		if (videoLength > m_header->videoBufferSize)
+		{
+			pthread_mutex_lock(&m_mutex);
+			m_statistics.framesTooLarge++;
+			pthread_mutex_unlock(&m_mutex);
+			return kFrameBusFrameTooLarge;
+		}
+
+		if ((slot = PopFreeSlot()) == kNoSlot)
+		{
+			pthread_mutex_lock(&m_mutex);
+			m_statistics.framesDropped++;
+			pthread_mutex_unlock(&m_mutex);
+			return kFrameBusNoFreeSlot;
+		}
+
+		memcpy(GetVideoBuffer(slot), videoBytes, videoLength);
+		copied = true;
+	}
+
+	FrameBusDescriptor& descriptor = m_descriptors[slot];
+
+	descriptor.flags					= 0;
+	descriptor.timeScale				= timeScale;
+	descriptor.width					= (uint32_t)videoFrame->GetWidth();
+	descriptor.height					= (uint32_t)videoFrame->GetHeight();
+	descriptor.rowBytes					= (uint32_t)videoFrame->GetRowBytes();
+	descriptor.pixelFormat				= videoFrame->GetPixelFormat();
+	descriptor.videoLength				= videoLength;
+	descriptor.audioSampleFrameCount	= 0;
+	descriptor.audioPacketTime			= 0;
+	descriptor.timecodeFormat			= 0;
+	descriptor.timecodeBCD				= 0;
+	descriptor.timecodeFlags			= 0;
+
+	if (videoFrame->GetStreamTime(&descriptor.streamTime, &descriptor.frameDuration, timeScale) != S_OK)
+	{
+		descriptor.streamTime		= 0;
+		descriptor.frameDuration	= 0;
+	}
+
+	BMDTimeValue hardwareFrameDuration;
+	if (videoFrame->GetHardwareReferenceTimestamp(timeScale, &descriptor.hardwareReferenceTime, &hardwareFrameDuration) == S_OK)
+		descriptor.flags |= kFrameBusFrameHasHardwareTime;
+	else
+		descriptor.hardwareReferenceTime = 0;
+
+	if (videoFrame->GetFlags() & bmdFrameHasNoInputSource)
+		descriptor.flags |= kFrameBusFrameNoInputSource;
+
+	if (timecodeFormat != 0)
+	{
+		if (videoFrame->GetTimecode(timecodeFormat, &timecode) != S_OK)
+			timecode = NULL;
+	}
+	else
+	{
+		for (size_t i = 0; i < sizeof(kDefaultTimecodeFormats) / sizeof(kDefaultTimecodeFormats[0]); i++)
+		{
+			if (videoFrame->GetTimecode(kDefaultTimecodeFormats[i], &timecode) == S_OK)
+			{
+				timecodeFormat = kDefaultTimecodeFormats[i];
+				break;
+			}
+			timecode = NULL;
+		}
+	}
+
+	if (timecode)
+	{
+		descriptor.flags			|= kFrameBusFrameHasTimecode;
+		descriptor.timecodeFormat	= timecodeFormat;
+		descriptor.timecodeBCD		= timecode->GetBCD();
+		descriptor.timecodeFlags	= (timecode->GetFlags() & bmdTimecodeIsDropFrame) ? kFrameBusTimecodeDropFrame : 0;
+		timecode->Release();
+	}
+
+	if (audioPacket && m_audioBytesPerSampleFrame > 0)
+	{
+		void*		audioBytes = NULL;
+		uint32_t	sampleFrameCount = (uint32_t)audioPacket->GetSampleFrameCount();
+
+		if (sampleFrameCount > m_header->audioBufferSize / m_audioBytesPerSampleFrame)
+		{
+			sampleFrameCount = m_header->audioBufferSize / m_audioBytesPerSampleFrame;
+			descriptor.flags |= kFrameBusFrameAudioTruncated;
+		}
+
+		if (audioPacket->GetBytes(&audioBytes) == S_OK)
+		{
+			memcpy(GetAudioBuffer(slot), audioBytes, sampleFrameCount * m_audioBytesPerSampleFrame);
+			audioPacket->GetPacketTime(&descriptor.audioPacketTime, m_header->audioSampleRate);
+			descriptor.audioSampleFrameCount = sampleFrameCount;
+			descriptor.flags |= kFrameBusFrameHasAudio;
+		}
+	}
+
+	// Publish the frame, then wake readers waiting for it
+	uint64_t sequence = ++m_sequence;
+
+	descriptor.sequence.store(sequence, std::memory_order_release);
+	m_index[sequence % m_header->slotCount].store(slot, std::memory_order_release);
+	m_header->publishedSequence.store(sequence, std::memory_order_release);
+	m_header->publishCount.fetch_add(1, std::memory_order_release);
+	syscall(SYS_futex, &m_header->publishCount, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+
+	// A copied frame's slot is free again, its frame stays readable until the slot is reused
+	if (copied)
+		PushFreeSlot(slot);
+
+	pthread_mutex_lock(&m_mutex);
+	m_statistics.framesPublished++;
+	if (copied)
+		m_statistics.copiedFrames++;
+	else
+		m_statistics.zeroCopyFrames++;
+	pthread_mutex_unlock(&m_mutex);
+
+	return kFrameBusPublished;
+}
+
+void FrameBusPublisher::GetStatistics(FrameBusPublisherStatistics& statistics)
+{
+	pthread_mutex_lock(&m_mutex);
+	statistics = m_statistics;
+	pthread_mutex_unlock(&m_mutex);
+}
+
+// IUnknown methods
+
+HRESULT FrameBusPublisher::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	static const REFIID		iunknown	= IID_IUnknown;
+	static const REFIID		iallocator	= IID_IDeckLinkMemoryAllocator;
+
+	if (ppv == NULL)
+		return E_INVALIDARG;
+
+	if (memcmp(&iid, &iunknown, sizeof(REFIID)) == 0 || memcmp(&iid, &iallocator, sizeof(REFIID)) == 0)
+	{
+		*ppv = static_cast<IDeckLinkMemoryAllocator*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = NULL;
+	return E_NOINTERFACE;
+}
+
+ULONG FrameBusPublisher::AddRef()
+{
+	return ++m_refCount;
+}
+
+ULONG FrameBusPublisher::Release()
+{
+	ULONG newRefValue = --m_refCount;
+
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+// IDeckLinkMemoryAllocator methods
+
+HRESULT FrameBusPublisher::AllocateBuffer(uint32_t bufferSize, void** allocatedBuffer)
+{
+	uint32_t slot = kNoSlot;
+
+	if (allocatedBuffer == NULL)
+		return E_POINTER;
+
+	if (m_header != NULL && bufferSize <= m_header->videoBufferSize)
+		slot = PopFreeSlot();
+
+	if (slot != kNoSlot)
+	{
+		*allocatedBuffer = GetVideoBuffer(slot);
+		return S_OK;
+	}
+
+	// Every slot is in use or the frame is larger than a slot, capture into the heap
+	if (posix_memalign(allocatedBuffer, kFrameBusBufferAlignment, bufferSize) != 0)
+	{
+		*allocatedBuffer = NULL;
+		return E_OUTOFMEMORY;
+	}
+
+	pthread_mutex_lock(&m_mutex);
+	m_statistics.heapAllocations++;
+	pthread_mutex_unlock(&m_mutex);
+
+	return S_OK;
+}
+
+HRESULT FrameBusPublisher::ReleaseBuffer(void* buffer)
+{
+	uint32_t slot = GetSlot(buffer);
+
+	if (slot == kNoSlot)
+		free(buffer);
+	else
+		PushFreeSlot(slot);
+
+	return S_OK;
+}
+
+HRESULT FrameBusPublisher::Commit()
+{
+	return S_OK;
+}
+
+HRESULT FrameBusPublisher::Decommit()
+{
+	return S_OK;
+}
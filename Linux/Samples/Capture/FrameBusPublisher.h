@@ -0,0 +1,139 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __FRAME_BUS_PUBLISHER_H__
+#define __FRAME_BUS_PUBLISHER_H__
+
+#include <atomic>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "DeckLinkAPI.h"
+#include "FrameBusFormat.h"
+
+// Publishes captured frames to a shared-memory frame bus, see FrameBusFormat.h.
+//
+// Set the publisher as the input's video frame memory allocator, so the driver captures into the
+// bus's slots, then call Publish from VideoInputFrameArrived.  Frames whose buffer is not a slot,
+// because every slot was in use when the driver allocated it, are copied into a free slot.  Audio
+// is copied into the slot of the video frame it arrived with.
+//
+// Publish never waits for readers.  When no slot is free, or the frame is larger than a slot, the
+// frame is dropped from the bus (but not from the capture) and counted.
+
+enum FrameBusPublishResult
+{
+	kFrameBusPublished = 0,
+	kFrameBusNoFreeSlot,
+	kFrameBusFrameTooLarge,
+	kFrameBusClosed
+};
+
+struct FrameBusPublisherStatistics
+{
+	uint64_t	framesPublished;
+	uint64_t	zeroCopyFrames;			// Frames captured directly into a slot
+	uint64_t	copiedFrames;			// Frames copied into a slot
+	uint64_t	framesDropped;			// No slot was free
+	uint64_t	framesTooLarge;			// The frame was larger than a slot
+	uint64_t	heapAllocations;		// Driver buffers allocated from the heap because no slot was free
+	uint32_t	slotsInUse;
+	uint32_t	peakSlotsInUse;
+};
+
+class FrameBusPublisher : public IDeckLinkMemoryAllocator
+{
+public:
+	FrameBusPublisher();
+
+	bool	Open(const char* name, uint32_t slotCount, uint32_t videoBufferSize, uint32_t audioChannelCount, uint32_t audioSampleDepth);
+	void	Close(void);
+	bool	IsOpen(void) const { return m_header != NULL && !m_closed; }
+
+	// Publish a frame and the audio that arrived with it, audioPacket may be NULL
+	FrameBusPublishResult	Publish(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkAudioInputPacket* audioPacket, BMDTimeScale timeScale, BMDTimecodeFormat timecodeFormat);
+
+	void	GetStatistics(FrameBusPublisherStatistics& statistics);
+
+	// IUnknown interface
+	HRESULT	STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG	STDMETHODCALLTYPE AddRef() override;
+	ULONG	STDMETHODCALLTYPE Release() override;
+
+	// IDeckLinkMemoryAllocator interface
+	HRESULT	STDMETHODCALLTYPE AllocateBuffer(uint32_t bufferSize, void** allocatedBuffer) override;
+	HRESULT	STDMETHODCALLTYPE ReleaseBuffer(void* buffer) override;
+	HRESULT	STDMETHODCALLTYPE Commit() override;
+	HRESULT	STDMETHODCALLTYPE Decommit() override;
+
+private:
+	static const uint32_t	kNoSlot		= 0xFFFFFFFF;
+
+	virtual ~FrameBusPublisher();
+
+	uint8_t*	GetVideoBuffer(uint32_t slot) const { return m_mapping + m_header->bufferOffset + slot * m_header->slotStride; }
+	uint8_t*	GetAudioBuffer(uint32_t slot) const { return GetVideoBuffer(slot) + m_header->videoBufferSize; }
+	uint32_t	GetSlot(const void* buffer) const;
+
+	// The free slots are a FIFO, so the slot reused is the one released longest ago
+	uint32_t	PopFreeSlot(void);
+	void		PushFreeSlot(uint32_t slot);
+
+	std::atomic<ULONG>		m_refCount;
+	char*					m_name;
+	bool					m_closed;
+	//
+	uint8_t*				m_mapping;
+	size_t					m_mappingSize;
+	FrameBusHeader*			m_header;
+	std::atomic<uint32_t>*	m_index;
+	FrameBusDescriptor*		m_descriptors;
+	uint64_t				m_sequence;
+	uint32_t				m_audioBytesPerSampleFrame;
+	//
+	pthread_mutex_t			m_mutex;
+	uint32_t*				m_freeSlots;
+	uint32_t				m_freeHead;
+	uint32_t				m_freeCount;
+	//
+	FrameBusPublisherStatistics	m_statistics;
+};
+
+#endif
@@ -0,0 +1,277 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "FrameBusReader.h"
+
+FrameBusReader::FrameBusReader() :
+	m_mapping(NULL),
+	m_mappingSize(0),
+	m_header(NULL),
+	m_index(NULL),
+	m_descriptors(NULL),
+	m_nextSequence(1)
+{
+	memset(&m_statistics, 0, sizeof(m_statistics));
+}
+
+FrameBusReader::~FrameBusReader()
+{
+	Close();
+}
+
+bool FrameBusReader::Open(const char* name)
+{
+	char				objectName[256];
+	struct stat			objectStat;
+	void*				mapping;
+	int					fd;
+
+	if (m_header != NULL)
+		return false;
+
+	while (*name == '/')
+		name++;
+
+	snprintf(objectName, sizeof(objectName), "/%s", name);
+
+	fd = shm_open(objectName, O_RDONLY, 0);
+	if (fd < 0)
+	{
+		fprintf(stderr, "Could not open frame bus %s - %s\n", objectName, strerror(errno));
+		return false;
+	}
+
+	if (fstat(fd, &objectStat) != 0 || (size_t)objectStat.st_size < sizeof(FrameBusHeader))
+	{
+		fprintf(stderr, "Frame bus %s is not ready\n", objectName);
+		close(fd);
+		return false;
+	}
+
+	mapping = mmap(NULL, (size_t)objectStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (mapping == MAP_FAILED)
+	{
+		fprintf(stderr, "Could not map frame bus %s - %s\n", objectName, strerror(errno));
+		return false;
+	}
+
+	const FrameBusHeader* header = (const FrameBusHeader*)mapping;
+	size_t size = (size_t)objectStat.st_size;
+
+	// The magic number is written last, after the rest of the header
+	bool valid = header->magic == kFrameBusMagic;
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	valid = valid &&
+			header->version == kFrameBusVersion &&
+			header->slotCount > 0 &&
+			header->descriptorSize == sizeof(FrameBusDescriptor) &&
+			header->indexOffset + header->slotCount * sizeof(uint32_t) <= header->descriptorOffset &&
+			header->descriptorOffset + header->slotCount * sizeof(FrameBusDescriptor) <= header->bufferOffset &&
+			header->slotStride >= (uint64_t)header->videoBufferSize + header->audioBufferSize &&
+			header->bufferOffset + header->slotCount * header->slotStride <= size;
+
+	if (!valid)
+	{
+		fprintf(stderr, "%s is not a compatible frame bus\n", objectName);
+		munmap(mapping, size);
+		return false;
+	}
+
+	m_mapping		= (const uint8_t*)mapping;
+	m_mappingSize	= size;
+	m_header		= header;
+	m_index			= (const std::atomic<uint32_t>*)(m_mapping + header->indexOffset);
+	m_descriptors	= (const FrameBusDescriptor*)(m_mapping + header->descriptorOffset);
+
+	uint64_t publishedSequence = m_header->publishedSequence.load(std::memory_order_acquire);
+	m_nextSequence = publishedSequence > 0 ? publishedSequence : 1;
+
+	return true;
+}
+
+void FrameBusReader::Close(void)
+{
+	if (m_mapping)
+		munmap((void*)m_mapping, m_mappingSize);
+
+	m_mapping		= NULL;
+	m_mappingSize	= 0;
+	m_header		= NULL;
+	m_index			= NULL;
+	m_descriptors	= NULL;
+}
+
+bool FrameBusReader::IsProducerRunning(void) const
+{
+	return kill(m_header->producerPid, 0) == 0 || errno != ESRCH;
+}
+
+uint64_t FrameBusReader::GetLag(void) const
+{
+	if (m_header == NULL)
+		return 0;
+
+	uint64_t publishedSequence = m_header->publishedSequence.load(std::memory_order_acquire);
+	return publishedSequence >= m_nextSequence ? publishedSequence - m_nextSequence + 1 : 0;
+}
+
+FrameBusReadResult FrameBusReader::ReadFrame(FrameBusFrame& frame, int timeoutMilliseconds)
+{
+	struct timespec		deadline;
+
+	if (m_header == NULL)
+		return kFrameBusReadClosed;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec		+= timeoutMilliseconds / 1000;
+	deadline.tv_nsec	+= (timeoutMilliseconds % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	while (true)
+	{
+		// Read the futex word first, so a frame published after the check below ends the wait
+		uint32_t publishCount		= m_header->publishCount.load(std::memory_order_acquire);
+		uint64_t publishedSequence	= m_header->publishedSequence.load(std::memory_order_acquire);
+
+		if (publishedSequence >= m_nextSequence)
+		{
+			uint64_t lag = publishedSequence - m_nextSequence + 1;
+			if (lag > m_statistics.maxLag)
+				m_statistics.maxLag = lag;
+
+			// Frames more than slotCount behind have had their index entry reused
+			if (lag > m_header->slotCount)
+			{
+				m_statistics.framesLost += lag - m_header->slotCount;
+				m_nextSequence = publishedSequence - m_header->slotCount + 1;
+			}
+
+			uint64_t					sequence	= m_nextSequence++;
+			uint32_t					slot		= m_index[sequence % m_header->slotCount].load(std::memory_order_acquire);
+			const FrameBusDescriptor&	descriptor	= m_descriptors[slot % m_header->slotCount];
+
+			if (descriptor.sequence.load(std::memory_order_acquire) != sequence)
+			{
+				m_statistics.framesLost++;
+				continue;
+			}
+
+			// Copy the descriptor, then check it was not rewritten while it was being copied
+			memcpy((void*)&frame.descriptor, (const void*)&descriptor, sizeof(FrameBusDescriptor));
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			if (descriptor.sequence.load(std::memory_order_relaxed) != sequence)
+			{
+				m_statistics.framesLost++;
+				continue;
+			}
+
+			const uint8_t* videoBuffer = m_mapping + m_header->bufferOffset + (slot % m_header->slotCount) * m_header->slotStride;
+
+			frame.sequence		= sequence;
+			frame.videoBytes	= videoBuffer;
+			frame.audioBytes	= NULL;
+			frame.audioLength	= 0;
+
+			if (frame.descriptor.flags & kFrameBusFrameHasAudio)
+			{
+				frame.audioBytes	= videoBuffer + m_header->videoBufferSize;
+				frame.audioLength	= frame.descriptor.audioSampleFrameCount * m_header->audioChannelCount * (m_header->audioSampleDepth / 8);
+			}
+
+			m_statistics.framesRead++;
+			return kFrameBusReadFrame;
+		}
+
+		if (m_header->closed.load(std::memory_order_acquire) || !IsProducerRunning())
+			return kFrameBusReadClosed;
+
+		struct timespec now;
+		struct timespec timeout;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		timeout.tv_sec	= deadline.tv_sec - now.tv_sec;
+		timeout.tv_nsec	= deadline.tv_nsec - now.tv_nsec;
+		if (timeout.tv_nsec < 0)
+		{
+			timeout.tv_sec--;
+			timeout.tv_nsec += 1000000000L;
+		}
+
+		if (timeout.tv_sec < 0)
+			return kFrameBusReadTimeout;
+
+		// Waiting only reads the futex word, so the bus can stay mapped read-only
+		syscall(SYS_futex, &m_header->publishCount, FUTEX_WAIT, publishCount, &timeout, NULL, 0);
+	}
+}
+
+bool FrameBusReader::IsFrameValid(const FrameBusFrame& frame)
+{
+	uint32_t slot = (uint32_t)(((const uint8_t*)frame.videoBytes - m_mapping - m_header->bufferOffset) / m_header->slotStride);
+
+	// Order the reads of the frame's buffers before the check of its sequence
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	if (m_descriptors[slot].sequence.load(std::memory_order_relaxed) == frame.sequence)
+		return true;
+
+	m_statistics.framesInvalidated++;
+	return false;
+}
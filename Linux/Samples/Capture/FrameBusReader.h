@@ -0,0 +1,116 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __FRAME_BUS_READER_H__
+#define __FRAME_BUS_READER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FrameBusFormat.h"
+
+// Reads frames from a shared-memory frame bus published by Capture -b, see FrameBusFormat.h.
+//
+// The bus is mapped read-only and frames are used in place.  A frame's buffers are reused by the
+// publisher without waiting for readers, so after using a frame call IsFrameValid to check that
+// it was not overwritten meanwhile.  Frames overwritten before ReadFrame reached them are skipped
+// and counted as lost.
+
+struct FrameBusFrame
+{
+	uint64_t		sequence;
+	FrameBusDescriptor	descriptor;			// Copy of the slot descriptor
+	const void*		videoBytes;
+	const void*		audioBytes;				// NULL if the frame has no audio
+	uint32_t		audioLength;
+};
+
+struct FrameBusReaderStatistics
+{
+	uint64_t	framesRead;
+	uint64_t	framesLost;					// Overwritten before they were read
+	uint64_t	framesInvalidated;			// Overwritten while they were being used
+	uint64_t	maxLag;						// Most frames published but not yet read
+};
+
+enum FrameBusReadResult
+{
+	kFrameBusReadFrame = 0,
+	kFrameBusReadTimeout,
+	kFrameBusReadClosed						// Capture has stopped publishing and every frame was read
+};
+
+class FrameBusReader
+{
+public:
+	FrameBusReader();
+	virtual ~FrameBusReader();
+
+	bool	Open(const char* name);
+	void	Close(void);
+	bool	IsOpen(void) const { return m_header != NULL; }
+
+	// Read the next frame, waiting up to timeoutMilliseconds for it to be published.  Reading
+	// starts from the most recent frame when the bus is opened
+	FrameBusReadResult	ReadFrame(FrameBusFrame& frame, int timeoutMilliseconds);
+
+	// True if the frame's buffers have not been reused since it was read
+	bool	IsFrameValid(const FrameBusFrame& frame);
+
+	// Frames published but not yet read
+	uint64_t	GetLag(void) const;
+
+	const FrameBusHeader*	GetHeader(void) const { return m_header; }
+	void	GetStatistics(FrameBusReaderStatistics& statistics) const { statistics = m_statistics; }
+
+private:
+	bool	IsProducerRunning(void) const;
+
+	const uint8_t*					m_mapping;
+	size_t							m_mappingSize;
+	const FrameBusHeader*			m_header;
+	const std::atomic<uint32_t>*	m_index;
+	const FrameBusDescriptor*		m_descriptors;
+	uint64_t						m_nextSequence;
+	//
+	FrameBusReaderStatistics		m_statistics;
+};
+
+#endif
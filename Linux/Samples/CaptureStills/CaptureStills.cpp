@@ -41,6 +41,7 @@
 //
 
 #include <stdio.h>
+#include <algorithm>
 #include <condition_variable>
 #include <mutex>
 #include <queue>
@@ -49,10 +50,11 @@
 #include <vector>
 
 #include "platform.h"
-#include "Bgra32VideoFrame.h"
 #include "DeckLinkInputDevice.h"
 #include "DeckLinkAPI.h"
 #include "ImageWriter.h"
+#include "FrameConverter.h"
+#include "StillsPipeline.h"
 
 // Pixel format tuple encoding {BMDPixelFormat enum, Pixel format display name}
 const std::vector<std::tuple<BMDPixelFormat, std::string>> kSupportedPixelFormats
@@ -73,7 +75,8 @@ enum {
 };
 
 void CaptureStills(DeckLinkInputDevice* deckLinkInput, const int captureInterval, const int framesToCapture,
-				   const std::string& captureDirectory, const std::string& filenamePrefix)
+				   const std::string& captureDirectory, const std::string& filenamePrefix, const int conversionThreads,
+				   const ImageEncoderOptions& encoderOptions, const int encoderThreads)
 {
 	int							captureFrameCount		= 0;
 	HRESULT						result					= S_OK;
@@ -81,12 +84,23 @@ void CaptureStills(DeckLinkInputDevice* deckLinkInput, const int captureInterval
 	
 	IDeckLinkVideoFrame*		receivedVideoFrame		= NULL;
 	IDeckLinkVideoConversion*	deckLinkFrameConverter	= NULL;
-	IDeckLinkVideoFrame*		bgra32Frame				= NULL;
+	StillsPipeline*				stillsPipeline			= NULL;
+	StillsPipelineStatistics	statistics;
 
-	// Create frame conversion instance
-	result = GetDeckLinkVideoConversion(&deckLinkFrameConverter);
-	if (result != S_OK)
-		return;
+	// Create frame conversion instance, either the CPU converter or the DeckLink API conversion
+	if (conversionThreads >= 0)
+	{
+		deckLinkFrameConverter = new FrameConverter(conversionThreads);
+	}
+	else
+	{
+		result = GetDeckLinkVideoConversion(&deckLinkFrameConverter);
+		if (result != S_OK)
+			return;
+	}
+
+	// Frames are converted, encoded and written by the pipeline threads
+	stillsPipeline = new StillsPipeline(deckLinkFrameConverter, encoderOptions, encoderThreads);
 
 	while (captureRunning)
 	{
@@ -100,10 +114,13 @@ void CaptureStills(DeckLinkInputDevice* deckLinkInput, const int captureInterval
 		else if (captureCancelled)
 			captureRunning = false;
 
+		else if (stillsPipeline->GetStatistics().framesFailed > 0)
+			captureRunning = false;
+
 		else if ((++captureFrameCount % captureInterval) == 0)
 		{
 			std::string outputFileName;
-			result = ImageWriter::GetNextFilenameWithPrefix(captureDirectory, filenamePrefix, outputFileName);
+			result = ImageWriter::GetNextFilenameWithPrefix(captureDirectory, filenamePrefix, ImageWriter::GetImageFormatExtension(encoderOptions.format), outputFileName);
 			if (result != S_OK)
 			{
 				fprintf(stderr, "Unable to get filename\n");
@@ -113,33 +130,9 @@ void CaptureStills(DeckLinkInputDevice* deckLinkInput, const int captureInterval
 			{
 				fprintf(stderr, "Capturing frame #%d to %s\n", captureFrameCount, outputFileName.c_str());
 
-				if (receivedVideoFrame->GetPixelFormat() == bmdFormat8BitBGRA)
-				{
-					// Frame is already 8-bit BGRA - no conversion required
-					bgra32Frame = receivedVideoFrame;
-					bgra32Frame->AddRef();
-				}
-				else
-				{
-					bgra32Frame = new Bgra32VideoFrame(receivedVideoFrame->GetWidth(), receivedVideoFrame->GetHeight(), receivedVideoFrame->GetFlags());
-
-					result = deckLinkFrameConverter->ConvertFrame(receivedVideoFrame, bgra32Frame);
-					if (FAILED(result))
-					{
-						fprintf(stderr, "Frame conversion to BGRA was unsuccessful\n");
-						captureRunning = false;
-					}
-				}
-
-				result = ImageWriter::WriteBgra32VideoFrameToPNG(bgra32Frame, outputFileName);
-				if (FAILED(result))
-				{
-					fprintf(stderr, "Image encoding to file was unsuccessful\n");
-					captureRunning = false;
-				}
+				// Blocks while the pipeline is full, further frames are then dropped by the input device
+				stillsPipeline->Submit(receivedVideoFrame, outputFileName);
 
-				bgra32Frame->Release();
-				
 				if ((captureFrameCount / captureInterval) >= framesToCapture)
 				{
 					fprintf(stderr, "Completed Capture\n");
@@ -155,6 +148,28 @@ void CaptureStills(DeckLinkInputDevice* deckLinkInput, const int captureInterval
 		}
 	}
 
+	// Wait for the submitted frames to be written
+	stillsPipeline->Flush();
+	statistics = stillsPipeline->GetStatistics();
+
+	if (statistics.framesSubmitted > 0)
+	{
+		fprintf(stderr, "Wrote %llu of %llu stills with %u encoder threads, average %.2f ms conversion, %.2f ms encoding, %.2f ms writing, %.1f KB per file\n",
+			(unsigned long long)statistics.framesWritten,
+			(unsigned long long)statistics.framesSubmitted,
+			statistics.encoderThreadCount,
+			statistics.totalConversionMicroseconds / 1000.0 / statistics.framesSubmitted,
+			statistics.totalEncodeMicroseconds / 1000.0 / statistics.framesSubmitted,
+			statistics.totalWriteMicroseconds / 1000.0 / statistics.framesSubmitted,
+			(statistics.framesWritten > 0) ? statistics.totalEncodedBytes / 1024.0 / statistics.framesWritten : 0.0
+			);
+	}
+
+	if (deckLinkInput->GetDroppedFrameCount() > 0)
+		fprintf(stderr, "Dropped %llu input frames while waiting for the pipeline\n", (unsigned long long)deckLinkInput->GetDroppedFrameCount());
+
+	delete stillsPipeline;
+
 	if (deckLinkFrameConverter != NULL)
 	{
 		deckLinkFrameConverter->Release();
@@ -286,6 +301,12 @@ void DisplayUsage(DeckLinkInputDevice* selectedDeckLinkInput, const std::vector<
 		"    -n <frames>          Number of frames to capture (default is 1)\n"
 		"    -i <interval>        Capture frame interval rate (default is 1 - every frame)\n"
 		"    -f <prefix>          Filename prefix (default is \"image_\")\n"
+		"    -t <threads>         Number of threads for frame conversion (default is 0 - one per CPU)\n"
+		"    -c                   Convert frames with the DeckLink API video conversion instead of the CPU converter\n"
+		"    -e <format>          Image file format: png, qoi, tiff or dpx (default is png)\n"
+		"    -z <level>           PNG zlib compression level 0-9 (default is the libpng default)\n"
+		"    -s <filter>          PNG row filter: none, sub, up, avg, paeth or all (default is the libpng default)\n"
+		"    -j <threads>         Number of image encoder threads (default is 0 - one per CPU)\n"
 		"    <capturedirectory>\n"
 		"\n"
 		"Capture image stills to a specified directory. eg:\n"
@@ -304,6 +325,9 @@ int main(int argc, char* argv[])
 	int							framesToCapture			= 1;
 	int							captureInterval			= 1;
 	int							pixelFormatIndex		= 0;
+	int							conversionThreads		= 0;
+	int							encoderThreads			= 0;
+	ImageEncoderOptions			encoderOptions			= { ImageFormat::PNG, -1, kPNGFilterDefault };
 	bool						enableFormatDetection	= false;
 	std::string					filenamePrefix;
 	std::string					captureDirectory;
@@ -349,6 +373,36 @@ int main(int argc, char* argv[])
 		else if (strcmp(argv[i], "-f") == 0)
 			filenamePrefix = argv[++i];
 
+		else if (strcmp(argv[i], "-t") == 0)
+			conversionThreads = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "-c") == 0)
+			conversionThreads = -1;
+
+		else if (strcmp(argv[i], "-e") == 0)
+		{
+			if (!ImageWriter::GetImageFormatFromName(argv[++i], encoderOptions.format))
+			{
+				fprintf(stderr, "Invalid image format %s\n", argv[i]);
+				displayHelp = true;
+			}
+		}
+
+		else if (strcmp(argv[i], "-z") == 0)
+			encoderOptions.pngCompressionLevel = std::min(std::max(atoi(argv[++i]), 0), 9);
+
+		else if (strcmp(argv[i], "-s") == 0)
+		{
+			if (!ImageWriter::GetPNGFiltersFromName(argv[++i], encoderOptions.pngFilters))
+			{
+				fprintf(stderr, "Invalid PNG filter %s\n", argv[i]);
+				displayHelp = true;
+			}
+		}
+
+		else if (strcmp(argv[i], "-j") == 0)
+			encoderThreads = std::max(atoi(argv[++i]), 0);
+
 		else if ((strcmp(argv[i], "?") == 0) || (strcmp(argv[i], "-h") == 0))
 			displayHelp = true;
 
@@ -528,21 +582,25 @@ int main(int argc, char* argv[])
 		" - Frames to capture: %d\n"
 		" - Capture interval: %d\n"
 		" - Filename prefix: %s\n"
-		" - Capture directory: %s\n",
+		" - Capture directory: %s\n"
+		" - Frame conversion: %s\n"
+		" - Image format: %s\n",
 		selectedDeckLinkInput->GetDeviceName().c_str(),
 		selectedDisplayModeName.c_str(),
 		std::get<kPixelFormatString>(kSupportedPixelFormats[pixelFormatIndex]).c_str(),
 		framesToCapture,
 		captureInterval,
 		filenamePrefix.c_str(),
-		captureDirectory.c_str()
+		captureDirectory.c_str(),
+		(conversionThreads < 0) ? "DeckLink API" : "CPU",
+		ImageWriter::GetImageFormatExtension(encoderOptions.format) + 1
 		);
 
 	fprintf(stderr, "Starting capture, press <RETURN> to stop/exit\n");
 
 	// Start thread for capture processing
 	captureStillsThread = std::thread([&]{
-		CaptureStills(selectedDeckLinkInput, captureInterval, framesToCapture, captureDirectory, filenamePrefix);
+		CaptureStills(selectedDeckLinkInput, captureInterval, framesToCapture, captureDirectory, filenamePrefix, conversionThreads, encoderOptions, encoderThreads);
 	});
 
 	keyPressThread = std::thread([&]{
@@ -44,8 +44,12 @@
 
 static const std::chrono::seconds kValidFrameTimeout{5};
 
+// Frames waiting for the capture thread hold DeckLink input buffers, frames arriving while the
+// queue is full are dropped
+static const size_t kMaxVideoFrameQueueDepth = 4;
+
 DeckLinkInputDevice::DeckLinkInputDevice(IDeckLink* device)
-	: m_deckLink(device), m_deckLinkInput(NULL), m_cancelCapture(false), m_refCount(1)
+	: m_deckLink(device), m_deckLinkInput(NULL), m_droppedFrameCount(0), m_cancelCapture(false), m_refCount(1)
 {
 	m_deckLink->AddRef();
 }
@@ -206,6 +210,12 @@ bool DeckLinkInputDevice::WaitForVideoFrameArrived(IDeckLinkVideoFrame** frame,
 	return true;
 }
 
+uint64_t DeckLinkInputDevice::GetDroppedFrameCount()
+{
+	std::lock_guard<std::mutex> lock(m_deckLinkInputMutex);
+	return m_droppedFrameCount;
+}
+
 HRESULT DeckLinkInputDevice::VideoInputFormatChanged(/* in */ BMDVideoInputFormatChangedEvents notificationEvents, /* in */ IDeckLinkDisplayMode *newMode, /* in */ BMDDetectedVideoInputFormatFlags detectedSignalFlags)
 {	
 	HRESULT			result = S_OK;
@@ -291,10 +301,17 @@ HRESULT DeckLinkInputDevice::VideoInputFrameArrived(/* in */ IDeckLinkVideoInput
 		if (inputFrameValid && m_prevInputFrameValid)
 		{
 			// If valid frame, add to queue for processing and notify
-			videoFrame->AddRef();
 			{
 				std::lock_guard<std::mutex> lock(m_deckLinkInputMutex);
-				m_videoFrameQueue.push(videoFrame);
+				if (m_videoFrameQueue.size() < kMaxVideoFrameQueueDepth)
+				{
+					videoFrame->AddRef();
+					m_videoFrameQueue.push(videoFrame);
+				}
+				else
+				{
+					m_droppedFrameCount++;
+				}
 			}
 			m_deckLinkInputCondition.notify_one();
 		}
@@ -57,6 +57,7 @@ private:
 	std::vector<IDeckLinkDisplayMode*>	m_modeList;
 
 	std::queue<IDeckLinkVideoFrame*>	m_videoFrameQueue;
+	uint64_t							m_droppedFrameCount;
 	std::condition_variable				m_deckLinkInputCondition;
 	std::mutex							m_deckLinkInputMutex;
 	bool								m_cancelCapture;
@@ -76,6 +77,7 @@ public:
 	IDeckLinkInput*						GetDeckLinkInput(void) const { return m_deckLinkInput; };
 	std::vector<IDeckLinkDisplayMode*>& GetDisplayModeList(void) { return m_modeList; };
 	bool								WaitForVideoFrameArrived(IDeckLinkVideoFrame** frame, bool& captureCancelled);
+	uint64_t							GetDroppedFrameCount(void);
 
 	// IDeckLinkInputCallback interface
 	virtual HRESULT STDMETHODCALLTYPE	VideoInputFormatChanged (BMDVideoInputFormatChangedEvents notificationEvents, IDeckLinkDisplayMode *newDisplayMode, BMDDetectedVideoInputFormatFlags detectedSignalFlags);
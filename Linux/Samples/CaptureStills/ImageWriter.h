@@ -1,52 +1,82 @@
-/* -LICENSE-START-
-** Copyright (c) 2018 Blackmagic Design
-**  
-** Permission is hereby granted, free of charge, to any person or organization 
-** obtaining a copy of the software and accompanying documentation (the 
-** "Software") to use, reproduce, display, distribute, sub-license, execute, 
-** and transmit the Software, and to prepare derivative works of the Software, 
-** and to permit third-parties to whom the Software is furnished to do so, in 
-** accordance with:
-** 
-** (1) if the Software is obtained from Blackmagic Design, the End User License 
-** Agreement for the Software Development Kit (“EULA”) available at 
-** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
-** 
-** (2) if the Software is obtained from any third party, such licensing terms 
-** as notified by that third party,
-** 
-** and all subject to the following:
-** 
-** (3) the copyright notices in the Software and this entire statement, 
-** including the above license grant, this restriction and the following 
-** disclaimer, must be included in all copies of the Software, in whole or in 
-** part, and all derivative works of the Software, unless such copies or 
-** derivative works are solely in the form of machine-executable object code 
-** generated by a source language processor.
-** 
-** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
-** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
-** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
-** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
-** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
-** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
-** DEALINGS IN THE SOFTWARE.
-** 
-** A copy of the Software is available free of charge at 
-** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
-** 
-** -LICENSE-END-
-*/
-
-#pragma once
-
-#include <string>
-#include <queue>
-#include <stdint.h>
-#include "DeckLinkAPI.h"
-
-namespace ImageWriter
-{
-	HRESULT GetNextFilenameWithPrefix(const std::string& path, const std::string& filenamePrefix, std::string& nextFileName);
-	HRESULT WriteBgra32VideoFrameToPNG(IDeckLinkVideoFrame* bgra32VideoFrame, const std::string& pngFilename);
-};
\ No newline at end of file
+/* -LICENSE-START-
+** Copyright (c) 2018 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "DeckLinkAPI.h"
+
+// Still image file formats.  PNG is compressed with zlib, QOI is a fast lossless format that
+// compresses at a fraction of the cost of PNG, and TIFF and DPX are written uncompressed.  PNG,
+// QOI and TIFF are encoded from 8-bit BGRA frames, DPX from 10-bit RGBX frames.
+enum class ImageFormat { PNG, QOI, TIFF, DPX };
+
+// PNG row filters, matching the PNG_FILTER_* flags of libpng
+enum PNGFilter
+{
+	kPNGFilterNone		= 0x08,
+	kPNGFilterSub		= 0x10,
+	kPNGFilterUp		= 0x20,
+	kPNGFilterAvg		= 0x40,
+	kPNGFilterPaeth		= 0x80,
+	kPNGFilterAll		= 0xF8,
+	kPNGFilterDefault	= -1
+};
+
+struct ImageEncoderOptions
+{
+	ImageFormat		format;
+	int				pngCompressionLevel;	// zlib level 0-9, or -1 for the libpng default
+	int				pngFilters;				// Combination of PNGFilter flags, or kPNGFilterDefault
+};
+
+namespace ImageWriter
+{
+	bool			GetImageFormatFromName(const std::string& name, ImageFormat& format);
+	bool			GetPNGFiltersFromName(const std::string& name, int& filters);
+	const char*		GetImageFormatExtension(ImageFormat format);
+	BMDPixelFormat	GetImageFormatPixelFormat(ImageFormat format);
+
+	HRESULT GetNextFilenameWithPrefix(const std::string& path, const std::string& filenamePrefix, const std::string& extension, std::string& nextFileName);
+	HRESULT EncodeVideoFrame(IDeckLinkVideoFrame* videoFrame, const ImageEncoderOptions& options, std::vector<uint8_t>& encodedImage);
+	HRESULT WriteImageFile(const std::vector<uint8_t>& encodedImage, const std::string& filename);
+};
@@ -40,13 +40,508 @@
 
 #include <png.h>
 #include <sys/stat.h>
+#include <time.h>
+#include <algorithm>
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 #include "ImageWriter.h"
 
-static const uint32_t kPNGSignatureLength = 8;
+// QOI chunk tags, refer to The Quite OK Image Format Specification, version 1.0
+static const uint8_t kQOIOpIndex	= 0x00;
+static const uint8_t kQOIOpDiff		= 0x40;
+static const uint8_t kQOIOpLuma		= 0x80;
+static const uint8_t kQOIOpRun		= 0xC0;
+static const uint8_t kQOIOpRGB		= 0xFE;
+static const uint8_t kQOIOpRGBA		= 0xFF;
+static const uint32_t kQOIHeaderSize	= 14;
+static const uint8_t kQOIEndMarker[]	= { 0, 0, 0, 0, 0, 0, 0, 1 };
 
-HRESULT ImageWriter::GetNextFilenameWithPrefix(const std::string& path, const std::string& filenamePrefix, std::string& nextFileName)
+// TIFF baseline tags and field types, refer to TIFF Revision 6.0
+enum TIFFTag
+{
+	kTIFFTagImageWidth					= 256,
+	kTIFFTagImageLength					= 257,
+	kTIFFTagBitsPerSample				= 258,
+	kTIFFTagCompression					= 259,
+	kTIFFTagPhotometricInterpretation	= 262,
+	kTIFFTagStripOffsets				= 273,
+	kTIFFTagSamplesPerPixel				= 277,
+	kTIFFTagRowsPerStrip				= 278,
+	kTIFFTagStripByteCounts				= 279,
+	kTIFFTagXResolution					= 282,
+	kTIFFTagYResolution					= 283,
+	kTIFFTagPlanarConfiguration			= 284,
+	kTIFFTagResolutionUnit				= 296
+};
+
+enum TIFFType
+{
+	kTIFFTypeShort		= 3,
+	kTIFFTypeLong		= 4,
+	kTIFFTypeRational	= 5
+};
+
+static const uint32_t kTIFFHeaderSize		= 8;
+static const uint32_t kTIFFEntryCount		= 13;
+static const uint32_t kTIFFIFDSize			= 2 + kTIFFEntryCount * 12 + 4;
+
+// DPX header layout, refer to SMPTE ST 268, all fields are big-endian
+static const uint32_t kDPXMagic					= 0x53445058;	// "SDPX"
+static const uint32_t kDPXHeaderSize			= 2048;
+static const uint32_t kDPXGenericHeaderSize		= 1664;
+static const uint32_t kDPXIndustryHeaderSize	= 384;
+static const uint32_t kDPXImageHeaderOffset		= 768;
+static const uint32_t kDPXImageElementOffset	= 780;
+static const uint32_t kDPXOrientationHeaderOffset = 1408;
+static const uint32_t kDPXUndefined				= 0xFFFFFFFF;
+static const uint8_t kDPXDescriptorRGB			= 50;
+static const uint8_t kDPXCharacteristicRec709	= 6;
+static const uint16_t kDPXPackingFilledMethodA	= 1;
+
+// 10-bit RGBX frames have SMPTE video levels
+static const uint32_t kDPXReferenceLowCode		= 64;
+static const uint32_t kDPXReferenceHighCode		= 940;
+
+namespace
+{
+	void PutLE16(std::vector<uint8_t>& buffer, uint32_t offset, uint16_t value)
+	{
+		buffer[offset]		= (uint8_t)value;
+		buffer[offset + 1]	= (uint8_t)(value >> 8);
+	}
+
+	void PutLE32(std::vector<uint8_t>& buffer, uint32_t offset, uint32_t value)
+	{
+		for (int i = 0; i < 4; i++)
+			buffer[offset + i] = (uint8_t)(value >> (8 * i));
+	}
+
+	void PutBE16(std::vector<uint8_t>& buffer, uint32_t offset, uint16_t value)
+	{
+		buffer[offset]		= (uint8_t)(value >> 8);
+		buffer[offset + 1]	= (uint8_t)value;
+	}
+
+	void PutBE32(std::vector<uint8_t>& buffer, uint32_t offset, uint32_t value)
+	{
+		for (int i = 0; i < 4; i++)
+			buffer[offset + i] = (uint8_t)(value >> (24 - 8 * i));
+	}
+
+	void PutBEFloat(std::vector<uint8_t>& buffer, uint32_t offset, float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		PutBE32(buffer, offset, bits);
+	}
+
+	void PutString(std::vector<uint8_t>& buffer, uint32_t offset, uint32_t fieldSize, const std::string& value)
+	{
+		memcpy(&buffer[offset], value.c_str(), std::min<size_t>(value.length(), fieldSize - 1));
+	}
+
+	void WriteTIFFEntry(std::vector<uint8_t>& buffer, uint32_t& offset, uint16_t tag, uint16_t type, uint32_t count, uint32_t value)
+	{
+		PutLE16(buffer, offset, tag);
+		PutLE16(buffer, offset + 2, type);
+		PutLE32(buffer, offset + 4, count);
+
+		// A single short value is left-justified in the value field
+		if ((type == kTIFFTypeShort) && (count == 1))
+			PutLE16(buffer, offset + 8, (uint16_t)value);
+		else
+			PutLE32(buffer, offset + 8, value);
+
+		offset += 12;
+	}
+
+	void PNGWriteData(png_structp pngDataPtr, png_bytep data, png_size_t length)
+	{
+		std::vector<uint8_t>* encodedImage = (std::vector<uint8_t>*)png_get_io_ptr(pngDataPtr);
+		encodedImage->insert(encodedImage->end(), data, data + length);
+	}
+
+	void PNGFlushData(png_structp pngDataPtr)
+	{
+	}
+
+	HRESULT EncodePNG(IDeckLinkVideoFrame* bgra32VideoFrame, const ImageEncoderOptions& options, std::vector<uint8_t>& encodedImage)
+	{
+		HRESULT					result			= E_FAIL;
+		png_structp				pngDataPtr		= nullptr;
+		png_infop				pngInfoPtr		= nullptr;
+		png_bytep				deckLinkBuffer	= nullptr;
+		std::vector<png_bytep>	rowPtrs(bgra32VideoFrame->GetHeight());
+
+		if (bgra32VideoFrame->GetBytes((void**)&deckLinkBuffer) != S_OK)
+		{
+			fprintf(stderr, "Could not get DeckLinkVideoFrame buffer pointer\n");
+			return E_FAIL;
+		}
+
+		// Set row pointers from the buffer
+		for (uint32_t row = 0; row < rowPtrs.size(); ++row)
+			rowPtrs[row] = &deckLinkBuffer[row * bgra32VideoFrame->GetRowBytes()];
+
+		pngDataPtr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+		if (!pngDataPtr)
+		{
+			fprintf(stderr, "Could not create PNG write struct\n");
+			goto bail;
+		}
+
+		pngInfoPtr = png_create_info_struct(pngDataPtr);
+		if (!pngInfoPtr)
+		{
+			fprintf(stderr, "Could not create PNG info struct\n");
+			goto bail;
+		}
+
+		if (setjmp(png_jmpbuf(pngDataPtr)))
+		{
+			fprintf(stderr, "Failed PNG encoding\n");
+			goto bail;
+		}
+
+		png_set_write_fn(pngDataPtr, &encodedImage, PNGWriteData, PNGFlushData);
+
+		if (options.pngCompressionLevel >= 0)
+			png_set_compression_level(pngDataPtr, options.pngCompressionLevel);
+
+		if (options.pngFilters != kPNGFilterDefault)
+			png_set_filter(pngDataPtr, PNG_FILTER_TYPE_BASE, options.pngFilters);
+
+		png_set_IHDR(pngDataPtr, pngInfoPtr, bgra32VideoFrame->GetWidth(), bgra32VideoFrame->GetHeight(),
+						8, PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, 
+						PNG_FILTER_TYPE_BASE);
+		png_write_info(pngDataPtr, pngInfoPtr);
+
+		png_set_bgr(pngDataPtr);
+
+		png_write_image(pngDataPtr, rowPtrs.data());
+		png_write_end(pngDataPtr, NULL);
+
+		result = S_OK;
+
+	bail:
+		png_destroy_write_struct(&pngDataPtr, &pngInfoPtr);
+		return result;
+	}
+
+	HRESULT EncodeQOI(IDeckLinkVideoFrame* bgra32VideoFrame, std::vector<uint8_t>& encodedImage)
+	{
+		uint8_t*	deckLinkBuffer;
+		uint32_t	width		= (uint32_t)bgra32VideoFrame->GetWidth();
+		uint32_t	height		= (uint32_t)bgra32VideoFrame->GetHeight();
+		uint32_t	index[64]	= {};
+		uint32_t	previous	= 0xFF000000;	// Pixels are held as 0xAABBGGRR
+		uint32_t	run			= 0;
+
+		if (bgra32VideoFrame->GetBytes((void**)&deckLinkBuffer) != S_OK)
+		{
+			fprintf(stderr, "Could not get DeckLinkVideoFrame buffer pointer\n");
+			return E_FAIL;
+		}
+
+		// Size for the worst case of every pixel as a QOI_OP_RGBA chunk, the buffer is trimmed once encoded
+		encodedImage.resize(kQOIHeaderSize + (size_t)width * height * 5 + sizeof(kQOIEndMarker));
+
+		uint8_t* out = encodedImage.data();
+		memcpy(out, "qoif", 4);
+		out[4]	= (uint8_t)(width >> 24);
+		out[5]	= (uint8_t)(width >> 16);
+		out[6]	= (uint8_t)(width >> 8);
+		out[7]	= (uint8_t)width;
+		out[8]	= (uint8_t)(height >> 24);
+		out[9]	= (uint8_t)(height >> 16);
+		out[10]	= (uint8_t)(height >> 8);
+		out[11]	= (uint8_t)height;
+		out[12]	= 4;	// RGBA channels
+		out[13]	= 0;	// sRGB with linear alpha
+		out += kQOIHeaderSize;
+
+		for (uint32_t y = 0; y < height; y++)
+		{
+			const uint8_t* bgra = deckLinkBuffer + (size_t)y * bgra32VideoFrame->GetRowBytes();
+
+			for (uint32_t x = 0; x < width; x++, bgra += 4)
+			{
+				uint8_t r = bgra[2];
+				uint8_t g = bgra[1];
+				uint8_t b = bgra[0];
+				uint8_t a = bgra[3];
+				uint32_t pixel = r | (g << 8) | (b << 16) | ((uint32_t)a << 24);
+
+				if (pixel == previous)
+				{
+					if (++run == 62)
+					{
+						*out++ = kQOIOpRun | (run - 1);
+						run = 0;
+					}
+					continue;
+				}
+
+				if (run > 0)
+				{
+					*out++ = kQOIOpRun | (run - 1);
+					run = 0;
+				}
+
+				uint32_t hash = (r * 3 + g * 5 + b * 7 + a * 11) % 64;
+				if (index[hash] == pixel)
+				{
+					*out++ = kQOIOpIndex | hash;
+				}
+				else
+				{
+					index[hash] = pixel;
+
+					if (a == (previous >> 24))
+					{
+						int8_t dr = (int8_t)(r - (uint8_t)previous);
+						int8_t dg = (int8_t)(g - (uint8_t)(previous >> 8));
+						int8_t db = (int8_t)(b - (uint8_t)(previous >> 16));
+						int8_t dgr = dr - dg;
+						int8_t dgb = db - dg;
+
+						if ((dr >= -2) && (dr <= 1) && (dg >= -2) && (dg <= 1) && (db >= -2) && (db <= 1))
+						{
+							*out++ = kQOIOpDiff | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2);
+						}
+						else if ((dgr >= -8) && (dgr <= 7) && (dg >= -32) && (dg <= 31) && (dgb >= -8) && (dgb <= 7))
+						{
+							*out++ = kQOIOpLuma | (dg + 32);
+							*out++ = ((dgr + 8) << 4) | (dgb + 8);
+						}
+						else
+						{
+							*out++ = kQOIOpRGB;
+							*out++ = r;
+							*out++ = g;
+							*out++ = b;
+						}
+					}
+					else
+					{
+						*out++ = kQOIOpRGBA;
+						*out++ = r;
+						*out++ = g;
+						*out++ = b;
+						*out++ = a;
+					}
+				}
+
+				previous = pixel;
+			}
+		}
+
+		if (run > 0)
+			*out++ = kQOIOpRun | (run - 1);
+
+		memcpy(out, kQOIEndMarker, sizeof(kQOIEndMarker));
+		out += sizeof(kQOIEndMarker);
+
+		encodedImage.resize(out - encodedImage.data());
+		return S_OK;
+	}
+
+	HRESULT EncodeTIFF(IDeckLinkVideoFrame* bgra32VideoFrame, std::vector<uint8_t>& encodedImage)
+	{
+		uint8_t*	deckLinkBuffer;
+		uint32_t	width		= (uint32_t)bgra32VideoFrame->GetWidth();
+		uint32_t	height		= (uint32_t)bgra32VideoFrame->GetHeight();
+		uint32_t	imageBytes	= width * height * 3;
+
+		// Header and IFD, followed by the bits per sample and resolution values, then the image as a single strip
+		uint32_t	bitsPerSampleOffset	= kTIFFHeaderSize + kTIFFIFDSize;
+		uint32_t	resolutionOffset	= bitsPerSampleOffset + 3 * 2;
+		uint32_t	imageOffset			= resolutionOffset + 2 * 8;
+		uint32_t	offset				= kTIFFHeaderSize;
+
+		if (bgra32VideoFrame->GetBytes((void**)&deckLinkBuffer) != S_OK)
+		{
+			fprintf(stderr, "Could not get DeckLinkVideoFrame buffer pointer\n");
+			return E_FAIL;
+		}
+
+		encodedImage.assign(imageOffset + imageBytes, 0);
+
+		// Little-endian byte order
+		encodedImage[0] = 'I';
+		encodedImage[1] = 'I';
+		PutLE16(encodedImage, 2, 42);
+		PutLE32(encodedImage, 4, kTIFFHeaderSize);
+
+		PutLE16(encodedImage, offset, kTIFFEntryCount);
+		offset += 2;
+		WriteTIFFEntry(encodedImage, offset, kTIFFTagImageWidth, kTIFFTypeLong, 1, width);
+		WriteTIFFEntry(encodedImage, offset, kTIFFTagImageLength, kTIFFTypeLong, 1, height);
+		WriteTIFFEntry(encodedImage, offset, kTIFFTagBitsPerSample, kTIFFTypeShort, 3, bitsPerSampleOffset);
+		WriteTIFFEntry(encodedImage, offset, kTIFFTagCompression, kTIFFTypeShort, 1, 1);					// Uncompressed
+		WriteTIFFEntry(encodedImage, offset, kTIFFTagPhotometricInterpretation, kTIFFTypeShort, 1, 2);	// RGB
+		WriteTIFFEntry(encodedImage, offset, kTIFFTagStripOffsets, kTIFFTypeLong, 1, imageOffset);
+		WriteTIFFEntry(encodedImage, offset, kTIFFTagSamplesPerPixel, kTIFFTypeShort, 1, 3);
+		WriteTIFFEntry(encodedImage, offset, kTIFFTagRowsPerStrip, kTIFFTypeLong, 1, height);
+		WriteTIFFEntry(encodedImage, offset, kTIFFTagStripByteCounts, kTIFFTypeLong, 1, imageBytes);
+		WriteTIFFEntry(encodedImage, offset, kTIFFTagXResolution, kTIFFTypeRational, 1, resolutionOffset);
+		WriteTIFFEntry(encodedImage, offset, kTIFFTagYResolution, kTIFFTypeRational, 1, resolutionOffset + 8);
+		WriteTIFFEntry(encodedImage, offset, kTIFFTagPlanarConfiguration, kTIFFTypeShort, 1, 1);			// Chunky
+		WriteTIFFEntry(encodedImage, offset, kTIFFTagResolutionUnit, kTIFFTypeShort, 1, 2);				// Inch
+		PutLE32(encodedImage, offset, 0);	// No further IFDs
+
+		for (int i = 0; i < 3; i++)
+			PutLE16(encodedImage, bitsPerSampleOffset + i * 2, 8);
+
+		for (int i = 0; i < 2; i++)
+		{
+			PutLE32(encodedImage, resolutionOffset + i * 8, 72);
+			PutLE32(encodedImage, resolutionOffset + i * 8 + 4, 1);
+		}
+
+		uint8_t* rgb = &encodedImage[imageOffset];
+		for (uint32_t y = 0; y < height; y++)
+		{
+			const uint8_t* bgra = deckLinkBuffer + (size_t)y * bgra32VideoFrame->GetRowBytes();
+
+			for (uint32_t x = 0; x < width; x++, bgra += 4, rgb += 3)
+			{
+				rgb[0] = bgra[2];
+				rgb[1] = bgra[1];
+				rgb[2] = bgra[0];
+			}
+		}
+
+		return S_OK;
+	}
+
+	HRESULT EncodeDPX(IDeckLinkVideoFrame* rgbx10VideoFrame, std::vector<uint8_t>& encodedImage)
+	{
+		uint8_t*	deckLinkBuffer;
+		uint32_t	width		= (uint32_t)rgbx10VideoFrame->GetWidth();
+		uint32_t	height		= (uint32_t)rgbx10VideoFrame->GetHeight();
+		uint32_t	lineBytes	= width * 4;
+		time_t		now			= time(NULL);
+		struct tm	localNow;
+		char		creationTime[32];
+
+		if (rgbx10VideoFrame->GetBytes((void**)&deckLinkBuffer) != S_OK)
+		{
+			fprintf(stderr, "Could not get DeckLinkVideoFrame buffer pointer\n");
+			return E_FAIL;
+		}
+
+		encodedImage.assign(kDPXHeaderSize + lineBytes * height, 0);
+
+		// Numeric fields of the orientation, film and television headers are undefined
+		std::fill(encodedImage.begin() + kDPXOrientationHeaderOffset, encodedImage.begin() + kDPXHeaderSize, 0xFF);
+		std::fill(encodedImage.begin() + 1432, encodedImage.begin() + 1620, 0);		// Orientation header strings
+		std::fill(encodedImage.begin() + 1664, encodedImage.begin() + 1712, 0);		// Film header strings
+		std::fill(encodedImage.begin() + 1732, encodedImage.begin() + 1920, 0);		// Frame identification, slate and reserved
+
+		// File information header
+		localtime_r(&now, &localNow);
+		strftime(creationTime, sizeof(creationTime), "%Y:%m:%d:%H:%M:%S:%Z", &localNow);
+
+		PutBE32(encodedImage, 0, kDPXMagic);
+		PutBE32(encodedImage, 4, kDPXHeaderSize);
+		PutString(encodedImage, 8, 8, "V2.0");
+		PutBE32(encodedImage, 16, (uint32_t)encodedImage.size());
+		PutBE32(encodedImage, 20, 1);	// New image
+		PutBE32(encodedImage, 24, kDPXGenericHeaderSize);
+		PutBE32(encodedImage, 28, kDPXIndustryHeaderSize);
+		PutBE32(encodedImage, 32, 0);
+		PutString(encodedImage, 136, 24, creationTime);
+		PutString(encodedImage, 160, 100, "DeckLink SDK CaptureStills");
+		PutBE32(encodedImage, 660, kDPXUndefined);	// Not encrypted
+
+		// Image information header with one image element
+		PutBE16(encodedImage, kDPXImageHeaderOffset, 0);	// Left to right, top to bottom
+		PutBE16(encodedImage, kDPXImageHeaderOffset + 2, 1);
+		PutBE32(encodedImage, kDPXImageHeaderOffset + 4, width);
+		PutBE32(encodedImage, kDPXImageHeaderOffset + 8, height);
+
+		PutBE32(encodedImage, kDPXImageElementOffset, 0);	// Unsigned
+		PutBE32(encodedImage, kDPXImageElementOffset + 4, kDPXReferenceLowCode);
+		PutBEFloat(encodedImage, kDPXImageElementOffset + 8, 0.0f);
+		PutBE32(encodedImage, kDPXImageElementOffset + 12, kDPXReferenceHighCode);
+		PutBEFloat(encodedImage, kDPXImageElementOffset + 16, 1.0f);
+		encodedImage[kDPXImageElementOffset + 20] = kDPXDescriptorRGB;
+		encodedImage[kDPXImageElementOffset + 21] = kDPXCharacteristicRec709;
+		encodedImage[kDPXImageElementOffset + 22] = kDPXCharacteristicRec709;
+		encodedImage[kDPXImageElementOffset + 23] = 10;
+		PutBE16(encodedImage, kDPXImageElementOffset + 24, kDPXPackingFilledMethodA);
+		PutBE16(encodedImage, kDPXImageElementOffset + 26, 0);	// No run-length encoding
+		PutBE32(encodedImage, kDPXImageElementOffset + 28, kDPXHeaderSize);
+
+		// Unused image elements
+		for (uint32_t element = 1; element < 8; element++)
+			std::fill(encodedImage.begin() + kDPXImageElementOffset + element * 72, encodedImage.begin() + kDPXImageElementOffset + element * 72 + 40, 0xFF);
+
+		// 10-bit RGBX is big-endian with R, G and B in bits 31-22, 21-12 and 11-2, which is the
+		// layout of DPX 10-bit RGB filled method A, so rows are copied as they are
+		for (uint32_t y = 0; y < height; y++)
+			memcpy(&encodedImage[kDPXHeaderSize + y * lineBytes], deckLinkBuffer + (size_t)y * rgbx10VideoFrame->GetRowBytes(), lineBytes);
+
+		return S_OK;
+	}
+}
+
+bool ImageWriter::GetImageFormatFromName(const std::string& name, ImageFormat& format)
+{
+	if (name == "png")
+		format = ImageFormat::PNG;
+	else if (name == "qoi")
+		format = ImageFormat::QOI;
+	else if ((name == "tiff") || (name == "tif"))
+		format = ImageFormat::TIFF;
+	else if (name == "dpx")
+		format = ImageFormat::DPX;
+	else
+		return false;
+
+	return true;
+}
+
+bool ImageWriter::GetPNGFiltersFromName(const std::string& name, int& filters)
+{
+	if (name == "none")
+		filters = kPNGFilterNone;
+	else if (name == "sub")
+		filters = kPNGFilterSub;
+	else if (name == "up")
+		filters = kPNGFilterUp;
+	else if (name == "avg")
+		filters = kPNGFilterAvg;
+	else if (name == "paeth")
+		filters = kPNGFilterPaeth;
+	else if (name == "all")
+		filters = kPNGFilterAll;
+	else
+		return false;
+
+	return true;
+}
+
+const char* ImageWriter::GetImageFormatExtension(ImageFormat format)
+{
+	switch (format)
+	{
+		case ImageFormat::QOI:	return ".qoi";
+		case ImageFormat::TIFF:	return ".tif";
+		case ImageFormat::DPX:	return ".dpx";
+		case ImageFormat::PNG:
+		default:				return ".png";
+	}
+}
+
+BMDPixelFormat ImageWriter::GetImageFormatPixelFormat(ImageFormat format)
+{
+	return (format == ImageFormat::DPX) ? bmdFormat10BitRGBX : bmdFormat8BitBGRA;
+}
+
+HRESULT ImageWriter::GetNextFilenameWithPrefix(const std::string& path, const std::string& filenamePrefix, const std::string& extension, std::string& nextFileName)
 {
 	HRESULT	result = E_FAIL;
 	static int idx = 0;
@@ -54,9 +549,9 @@ HRESULT ImageWriter::GetNextFilenameWithPrefix(const std::string& path, const st
 
 	while (idx < 10000)
 	{
-		std::stringstream pngFilenameStream;
-		pngFilenameStream << path << '/' << filenamePrefix << std::setfill('0') << std::setw(4) << idx++ << ".png";
-		nextFileName = pngFilenameStream.str();
+		std::stringstream filenameStream;
+		filenameStream << path << '/' << filenamePrefix << std::setfill('0') << std::setw(4) << idx++ << extension;
+		nextFileName = filenameStream.str();
 
 		// If file does not exist, return S_OK
 		if (stat(nextFileName.c_str(), &buf) != 0)
@@ -69,78 +564,46 @@ HRESULT ImageWriter::GetNextFilenameWithPrefix(const std::string& path, const st
 	return result;
 }
 
-HRESULT ImageWriter::WriteBgra32VideoFrameToPNG(IDeckLinkVideoFrame* bgra32VideoFrame, const std::string& pngFilename)
+HRESULT ImageWriter::EncodeVideoFrame(IDeckLinkVideoFrame* videoFrame, const ImageEncoderOptions& options, std::vector<uint8_t>& encodedImage)
 {
-	bool        result         = E_FAIL;
-	png_structp pngDataPtr     = nullptr;
-	png_infop   pngInfoPtr     = nullptr;
-	png_bytep   deckLinkBuffer = nullptr;
-	png_bytepp  rowPtrs        = nullptr;
-
 	// Ensure video frame has expected pixel format
-	if (bgra32VideoFrame->GetPixelFormat() != bmdFormat8BitBGRA)
+	if (videoFrame->GetPixelFormat() != GetImageFormatPixelFormat(options.format))
 	{
-		fprintf(stderr, "Video frame is not in 8-Bit BGRA pixel format\n");
+		fprintf(stderr, "Video frame is not in the pixel format of the image file\n");
 		return E_FAIL;
 	}
-	
-	FILE *pngFile = fopen(pngFilename.c_str(), "wb");
-	if (!pngFile)
-	{
-		fprintf(stderr, "Could not open PNG file %s for writing\n", pngFilename.c_str());
-		return false;
-	}
 
-	pngDataPtr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-	if (!pngDataPtr)
-	{
-		fprintf(stderr, "Could not create PNG write struct\n");
-		goto bail;
-	}
+	encodedImage.clear();
 
-	pngInfoPtr = png_create_info_struct(pngDataPtr);
-	if (!pngInfoPtr)
+	switch (options.format)
 	{
-		fprintf(stderr, "Could not create PNG info struct\n");
-		goto bail;
+		case ImageFormat::PNG:	return EncodePNG(videoFrame, options, encodedImage);
+		case ImageFormat::QOI:	return EncodeQOI(videoFrame, encodedImage);
+		case ImageFormat::TIFF:	return EncodeTIFF(videoFrame, encodedImage);
+		case ImageFormat::DPX:	return EncodeDPX(videoFrame, encodedImage);
+		default:				return E_INVALIDARG;
 	}
+}
 
-	if (setjmp(png_jmpbuf(pngDataPtr)))
+HRESULT ImageWriter::WriteImageFile(const std::vector<uint8_t>& encodedImage, const std::string& filename)
+{
+	HRESULT result = S_OK;
+
+	FILE *imageFile = fopen(filename.c_str(), "wb");
+	if (!imageFile)
 	{
-		fprintf(stderr, "Failed PNG write initialization\n");
-		goto bail;
+		fprintf(stderr, "Could not open file %s for writing\n", filename.c_str());
+		return E_FAIL;
 	}
 
-	png_init_io(pngDataPtr, pngFile);
-
-	png_set_IHDR(pngDataPtr, pngInfoPtr, bgra32VideoFrame->GetWidth(), bgra32VideoFrame->GetHeight(),
-					8, PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, 
-					PNG_FILTER_TYPE_BASE);
-	png_write_info(pngDataPtr, pngInfoPtr);
-
-	png_set_bgr(pngDataPtr);
-
-	if (bgra32VideoFrame->GetBytes((void**)&deckLinkBuffer) != S_OK)
+	if (fwrite(encodedImage.data(), 1, encodedImage.size(), imageFile) != encodedImage.size())
 	{
-		fprintf(stderr, "Could not get DeckLinkVideoFrame buffer pointer\n");
-		goto bail;
+		fprintf(stderr, "Could not write file %s\n", filename.c_str());
+		result = E_FAIL;
 	}
 
-	rowPtrs = (png_bytep*)malloc(sizeof(png_bytep) * bgra32VideoFrame->GetHeight());
+	if (fclose(imageFile) != 0)
+		result = E_FAIL;
 
-	// Set row pointers from the buffer
-	for (uint32_t row = 0; row < bgra32VideoFrame->GetHeight(); ++row)
-		rowPtrs[row] = &deckLinkBuffer[row * bgra32VideoFrame->GetRowBytes()];
-
-	png_write_image(pngDataPtr, rowPtrs);
-	png_write_end(pngDataPtr, NULL);
-
-	result = S_OK;
-
-bail:
-	fclose(pngFile);
-	png_destroy_write_struct(&pngDataPtr, &pngInfoPtr);
-	free(rowPtrs);
-	
 	return result;
 }
@@ -39,25 +39,27 @@
 */
 
 #include "platform.h"
-#include "Bgra32VideoFrame.h"
+#include "StillVideoFrame.h"
+#include "PixelPacking.h"
 
-/* Bgra32VideoFrame class */
+/* StillVideoFrame class */
 
 // Constructor generates empty pixel buffer
-Bgra32VideoFrame::Bgra32VideoFrame(long width, long height, BMDFrameFlags flags) : 
-	m_width(width), m_height(height), m_flags(flags), m_refCount(1)
+StillVideoFrame::StillVideoFrame(long width, long height, BMDPixelFormat pixelFormat, BMDFrameFlags flags) : 
+	m_width(width), m_height(height), m_pixelFormat(pixelFormat), m_flags(flags), m_refCount(1)
 {
 	// Allocate pixel buffer
-	m_pixelBuffer.resize(m_width*m_height*4);
+	m_rowBytes = GetPixelFormatRowBytes(m_pixelFormat, (uint32_t)m_width);
+	m_pixelBuffer.resize(m_rowBytes*m_height);
 }
 
-HRESULT Bgra32VideoFrame::GetBytes(void **buffer)
+HRESULT StillVideoFrame::GetBytes(void **buffer)
 {
 	*buffer = (void*)m_pixelBuffer.data();
 	return S_OK;
 }
 
-HRESULT	STDMETHODCALLTYPE Bgra32VideoFrame::QueryInterface(REFIID iid, LPVOID *ppv)
+HRESULT	STDMETHODCALLTYPE StillVideoFrame::QueryInterface(REFIID iid, LPVOID *ppv)
 {
 	CFUUIDBytes		iunknown;
 	HRESULT 		result = E_NOINTERFACE;
@@ -87,12 +89,12 @@ HRESULT	STDMETHODCALLTYPE Bgra32VideoFrame::QueryInterface(REFIID iid, LPVOID *p
 	return result;
 }
 
-ULONG STDMETHODCALLTYPE Bgra32VideoFrame::AddRef(void)
+ULONG STDMETHODCALLTYPE StillVideoFrame::AddRef(void)
 {
 	return ++m_refCount;
 }
 
-ULONG STDMETHODCALLTYPE Bgra32VideoFrame::Release(void)
+ULONG STDMETHODCALLTYPE StillVideoFrame::Release(void)
 {
 
 	ULONG newRefValue = --m_refCount;
@@ -44,27 +44,30 @@
 #include <vector>
 #include "DeckLinkAPI.h"
 
-class Bgra32VideoFrame : public IDeckLinkVideoFrame
+// Frame in system memory used as the destination of frame conversion for still images
+class StillVideoFrame : public IDeckLinkVideoFrame
 {
 private:
 	long					m_width;
 	long					m_height;
+	long					m_rowBytes;
+	BMDPixelFormat			m_pixelFormat;
 	BMDFrameFlags			m_flags;
 	std::vector<uint8_t>	m_pixelBuffer;
 
 	std::atomic<ULONG>	m_refCount;
 
 public:
-	Bgra32VideoFrame(long width, long height, BMDFrameFlags flags);
-	virtual ~Bgra32VideoFrame() {};
+	StillVideoFrame(long width, long height, BMDPixelFormat pixelFormat, BMDFrameFlags flags);
+	virtual ~StillVideoFrame() {};
 
 	// IDeckLinkVideoFrame interface
 	virtual long			STDMETHODCALLTYPE	GetWidth(void)			{ return m_width; };
 	virtual long			STDMETHODCALLTYPE	GetHeight(void)			{ return m_height; };
-	virtual long			STDMETHODCALLTYPE	GetRowBytes(void)		{ return m_width * 4; };
+	virtual long			STDMETHODCALLTYPE	GetRowBytes(void)		{ return m_rowBytes; };
 	virtual HRESULT			STDMETHODCALLTYPE	GetBytes(void** buffer);
 	virtual BMDFrameFlags	STDMETHODCALLTYPE	GetFlags(void)			{ return m_flags; };
-	virtual BMDPixelFormat	STDMETHODCALLTYPE	GetPixelFormat(void)	{ return bmdFormat8BitBGRA; };
+	virtual BMDPixelFormat	STDMETHODCALLTYPE	GetPixelFormat(void)	{ return m_pixelFormat; };
 	
 	// Dummy implementations of remaining methods in IDeckLinkVideoFrame
 	virtual HRESULT			STDMETHODCALLTYPE	GetAncillaryData(IDeckLinkVideoFrameAncillary** ancillary) { return E_NOTIMPL; };
@@ -0,0 +1,268 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <chrono>
+#include "platform.h"
+#include "StillsPipeline.h"
+#include "StillVideoFrame.h"
+
+// Captured frames waiting for conversion hold DeckLink input buffers, so keep this queue short
+static const uint32_t kMaxConversionQueueDepth = 2;
+
+static uint64_t ElapsedMicroseconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+StillsPipeline::Still::Still(uint64_t sequence, const std::string& filename, IDeckLinkVideoFrame* videoFrame) :
+	sequence(sequence), filename(filename), sourceFrame(videoFrame), convertedFrame(NULL), result(S_OK)
+{
+	sourceFrame->AddRef();
+}
+
+StillsPipeline::Still::~Still()
+{
+	if (sourceFrame != NULL)
+		sourceFrame->Release();
+
+	if (convertedFrame != NULL)
+		convertedFrame->Release();
+}
+
+StillsPipeline::StillsPipeline(IDeckLinkVideoConversion* frameConverter, const ImageEncoderOptions& options, uint32_t encoderThreadCount) :
+	m_frameConverter(frameConverter),
+	m_options(options),
+	m_imagePixelFormat(ImageWriter::GetImageFormatPixelFormat(options.format)),
+	m_nextSequence(0),
+	m_nextWriteSequence(0),
+	m_framesInFlight(0),
+	m_terminate(false),
+	m_statistics()
+{
+	m_frameConverter->AddRef();
+
+	if (encoderThreadCount == 0)
+		encoderThreadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	// Enough frames for every encoder to be busy while the next frames are converted and written
+	m_maxFramesInFlight = 2 * encoderThreadCount + 2;
+	m_statistics.encoderThreadCount = encoderThreadCount;
+
+	m_conversionThread = std::thread(&StillsPipeline::ConversionThread, this);
+	for (uint32_t i = 0; i < encoderThreadCount; i++)
+		m_encoderThreads.emplace_back(&StillsPipeline::EncoderThread, this);
+	m_writerThread = std::thread(&StillsPipeline::WriterThread, this);
+}
+
+StillsPipeline::~StillsPipeline()
+{
+	Flush();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_terminate = true;
+	}
+	m_condition.notify_all();
+
+	m_conversionThread.join();
+	for (auto& encoderThread : m_encoderThreads)
+		encoderThread.join();
+	m_writerThread.join();
+
+	m_frameConverter->Release();
+}
+
+HRESULT StillsPipeline::Submit(IDeckLinkVideoFrame* videoFrame, const std::string& filename)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_condition.wait(lock, [&]{ return (m_framesInFlight < m_maxFramesInFlight) && (m_conversionQueue.size() < kMaxConversionQueueDepth); });
+
+	m_conversionQueue.emplace_back(new Still(m_nextSequence++, filename, videoFrame));
+	m_framesInFlight++;
+	m_statistics.framesSubmitted++;
+	m_statistics.maxFramesInFlight = std::max(m_statistics.maxFramesInFlight, m_framesInFlight);
+
+	lock.unlock();
+	m_condition.notify_all();
+
+	return S_OK;
+}
+
+void StillsPipeline::Flush()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_condition.wait(lock, [&]{ return m_framesInFlight == 0; });
+}
+
+StillsPipelineStatistics StillsPipeline::GetStatistics()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_statistics;
+}
+
+void StillsPipeline::ConversionThread()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		m_condition.wait(lock, [&]{ return !m_conversionQueue.empty() || m_terminate; });
+		if (m_conversionQueue.empty())
+			break;
+
+		std::unique_ptr<Still> still = std::move(m_conversionQueue.front());
+		m_conversionQueue.pop_front();
+
+		// Release the lock while converting so the capture thread can submit the next frame
+		lock.unlock();
+		m_condition.notify_all();
+
+		auto conversionStart = std::chrono::steady_clock::now();
+
+		if (still->sourceFrame->GetPixelFormat() == m_imagePixelFormat)
+		{
+			// Frame is already in the pixel format of the image - no conversion required
+			still->convertedFrame = still->sourceFrame;
+			still->convertedFrame->AddRef();
+		}
+		else
+		{
+			still->convertedFrame = new StillVideoFrame(still->sourceFrame->GetWidth(), still->sourceFrame->GetHeight(), m_imagePixelFormat, still->sourceFrame->GetFlags());
+
+			still->result = m_frameConverter->ConvertFrame(still->sourceFrame, still->convertedFrame);
+			if (FAILED(still->result))
+				fprintf(stderr, "Frame conversion for %s was unsuccessful\n", still->filename.c_str());
+		}
+
+		// Return the captured frame to the driver
+		still->sourceFrame->Release();
+		still->sourceFrame = NULL;
+
+		uint64_t conversionMicroseconds = ElapsedMicroseconds(conversionStart);
+
+		lock.lock();
+		m_statistics.totalConversionMicroseconds += conversionMicroseconds;
+		m_encodeQueue.push_back(std::move(still));
+		m_condition.notify_all();
+	}
+}
+
+void StillsPipeline::EncoderThread()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		m_condition.wait(lock, [&]{ return !m_encodeQueue.empty() || (m_terminate && m_conversionQueue.empty()); });
+		if (m_encodeQueue.empty())
+			break;
+
+		std::unique_ptr<Still> still = std::move(m_encodeQueue.front());
+		m_encodeQueue.pop_front();
+		lock.unlock();
+
+		auto encodeStart = std::chrono::steady_clock::now();
+
+		if (SUCCEEDED(still->result))
+		{
+			still->result = ImageWriter::EncodeVideoFrame(still->convertedFrame, m_options, still->encodedImage);
+			if (FAILED(still->result))
+				fprintf(stderr, "Image encoding for %s was unsuccessful\n", still->filename.c_str());
+		}
+
+		still->convertedFrame->Release();
+		still->convertedFrame = NULL;
+
+		uint64_t encodeMicroseconds = ElapsedMicroseconds(encodeStart);
+
+		lock.lock();
+		m_statistics.totalEncodeMicroseconds += encodeMicroseconds;
+		m_writeQueue[still->sequence] = std::move(still);
+		m_condition.notify_all();
+	}
+}
+
+void StillsPipeline::WriterThread()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		// Encoders may finish out of order, wait for the next still in sequence
+		m_condition.wait(lock, [&]{ return (m_writeQueue.count(m_nextWriteSequence) != 0) || (m_terminate && (m_framesInFlight == 0)); });
+
+		auto iter = m_writeQueue.find(m_nextWriteSequence);
+		if (iter == m_writeQueue.end())
+			break;
+
+		std::unique_ptr<Still> still = std::move(iter->second);
+		m_writeQueue.erase(iter);
+		m_nextWriteSequence++;
+		lock.unlock();
+
+		auto writeStart = std::chrono::steady_clock::now();
+
+		if (SUCCEEDED(still->result))
+		{
+			still->result = ImageWriter::WriteImageFile(still->encodedImage, still->filename);
+			if (FAILED(still->result))
+				fprintf(stderr, "Writing %s was unsuccessful\n", still->filename.c_str());
+		}
+
+		uint64_t writeMicroseconds = ElapsedMicroseconds(writeStart);
+
+		lock.lock();
+		m_statistics.totalWriteMicroseconds += writeMicroseconds;
+		if (SUCCEEDED(still->result))
+		{
+			m_statistics.framesWritten++;
+			m_statistics.totalEncodedBytes += still->encodedImage.size();
+		}
+		else
+		{
+			m_statistics.framesFailed++;
+		}
+
+		m_framesInFlight--;
+		m_condition.notify_all();
+	}
+}
@@ -0,0 +1,128 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "DeckLinkAPI.h"
+#include "ImageWriter.h"
+
+// Bounded pipeline for writing stills, so that the capture thread only waits for frames and
+// hands them on.  A conversion thread converts captured frames to the pixel format of the image
+// file and releases them back to the driver, a pool of encoder threads compresses the images,
+// and a writer thread writes the files in the order the frames were submitted.  Submit blocks
+// while the pipeline is full, which bounds the memory used when encoding is slower than capture.
+
+struct StillsPipelineStatistics
+{
+	uint64_t	framesSubmitted;
+	uint64_t	framesWritten;
+	uint64_t	framesFailed;
+	uint64_t	totalConversionMicroseconds;
+	uint64_t	totalEncodeMicroseconds;
+	uint64_t	totalWriteMicroseconds;
+	uint64_t	totalEncodedBytes;
+	uint32_t	encoderThreadCount;
+	uint32_t	maxFramesInFlight;
+};
+
+class StillsPipeline
+{
+public:
+	// An encoder thread count of 0 uses one thread per CPU
+	StillsPipeline(IDeckLinkVideoConversion* frameConverter, const ImageEncoderOptions& options, uint32_t encoderThreadCount = 0);
+	virtual ~StillsPipeline();
+
+	// Queue a captured frame to be written to filename.  The pipeline holds a reference to the
+	// frame until it is converted.  Blocks while the pipeline is full
+	HRESULT						Submit(IDeckLinkVideoFrame* videoFrame, const std::string& filename);
+
+	// Wait until all submitted frames have been written
+	void						Flush(void);
+
+	StillsPipelineStatistics	GetStatistics(void);
+
+private:
+	struct Still
+	{
+		uint64_t				sequence;
+		std::string				filename;
+		IDeckLinkVideoFrame*	sourceFrame;
+		IDeckLinkVideoFrame*	convertedFrame;
+		std::vector<uint8_t>	encodedImage;
+		HRESULT					result;
+
+		Still(uint64_t sequence, const std::string& filename, IDeckLinkVideoFrame* videoFrame);
+		~Still();
+	};
+
+	void	ConversionThread(void);
+	void	EncoderThread(void);
+	void	WriterThread(void);
+
+	IDeckLinkVideoConversion*				m_frameConverter;
+	ImageEncoderOptions						m_options;
+	BMDPixelFormat							m_imagePixelFormat;
+	uint32_t								m_maxFramesInFlight;
+
+	// A single lock covers all stages, stills arrive at no more than the frame rate
+	std::mutex								m_mutex;
+	std::condition_variable					m_condition;
+	std::deque<std::unique_ptr<Still>>		m_conversionQueue;
+	std::deque<std::unique_ptr<Still>>		m_encodeQueue;
+	std::map<uint64_t, std::unique_ptr<Still>>	m_writeQueue;
+	uint64_t								m_nextSequence;
+	uint64_t								m_nextWriteSequence;
+	uint32_t								m_framesInFlight;
+	bool									m_terminate;
+
+	std::thread								m_conversionThread;
+	std::vector<std::thread>				m_encoderThreads;
+	std::thread								m_writerThread;
+
+	StillsPipelineStatistics				m_statistics;
+};
@@ -0,0 +1,382 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2020 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#include "CEA608_Decoder.h"
+#include <cstring>
+
+namespace CEA608
+{
+
+namespace
+{
+	// Annex A Character Set Differences from ASCII, for the standard characters 0x20-0x7F
+	uint16_t StandardCharacter(uint8_t code)
+	{
+		switch (code)
+		{
+			case 0x2A: return 0x00E1;	// á
+			case 0x5C: return 0x00E9;	// é
+			case 0x5E: return 0x00ED;	// í
+			case 0x5F: return 0x00F3;	// ó
+			case 0x60: return 0x00FA;	// ú
+			case 0x7B: return 0x00E7;	// ç
+			case 0x7C: return 0x00F7;	// ÷
+			case 0x7D: return 0x00D1;	// Ñ
+			case 0x7E: return 0x00F1;	// ñ
+			case 0x7F: return 0x2588;	// █
+		}
+		return code;
+	}
+	
+	// Special North American characters, 0x11 0x30-0x3F
+	const uint16_t kSpecialCharacters[16] =
+	{
+		0x00AE, 0x00B0, 0x00BD, 0x00BF, 0x2122, 0x00A2, 0x00A3, 0x266A,
+		0x00E0, 0x0020, 0x00E8, 0x00E2, 0x00EA, 0x00EE, 0x00F4, 0x00FB
+	};
+	
+	// Extended Western European characters, 0x12 and 0x13 0x20-0x3F
+	const uint16_t kExtendedCharacters[2][32] =
+	{
+		{
+			0x00C1, 0x00C9, 0x00D3, 0x00DA, 0x00DC, 0x00FC, 0x2018, 0x00A1,
+			0x002A, 0x2019, 0x2500, 0x00A9, 0x2120, 0x2022, 0x201C, 0x201D,
+			0x00C0, 0x00C2, 0x00C7, 0x00C8, 0x00CA, 0x00CB, 0x00EB, 0x00CE,
+			0x00CF, 0x00EF, 0x00D4, 0x00D9, 0x00F9, 0x00DB, 0x00AB, 0x00BB
+		},
+		{
+			0x00C3, 0x00E3, 0x00CD, 0x00CC, 0x00EC, 0x00D2, 0x00F2, 0x00D5,
+			0x00F5, 0x007B, 0x007D, 0x005C, 0x005E, 0x005F, 0x007C, 0x007E,
+			0x00C4, 0x00E4, 0x00D6, 0x00F6, 0x00DF, 0x00A5, 0x00A4, 0x2502,
+			0x00C5, 0x00E5, 0x00D8, 0x00F8, 0x250C, 0x2510, 0x2514, 0x2518
+		}
+	};
+	
+	// Preamble Address Code rows (1-15) indexed by the low 3 bits of the first byte and bit 5 of the second
+	const uint8_t kPreambleRows[8][2] =
+	{
+		{ 11, 11 }, { 1, 2 }, { 3, 4 }, { 12, 13 }, { 14, 15 }, { 5, 6 }, { 7, 8 }, { 9, 10 }
+	};
+	
+	inline bool HasOddParity(uint8_t byte)
+	{
+		byte ^= byte >> 4;
+		byte ^= byte >> 2;
+		byte ^= byte >> 1;
+		return byte & 1;
+	}
+}
+
+//=====================================================================
+
+ChannelDecoder::ChannelDecoder()
+{
+	reset();
+}
+
+void ChannelDecoder::reset()
+{
+	clearMemory(0);
+	clearMemory(1);
+	m_displayedMemory = 0;
+	m_mode = mode_None;
+	m_rollUpRows = 2;
+	m_row = kRows - 1;
+	m_column = 0;
+	m_changed = true;
+}
+
+uint16_t (*ChannelDecoder::targetMemory())[kColumns]
+{
+	// Pop-on captions are built in non-displayed memory, roll-up and paint-on captions are written directly to the display
+	return m_memory[m_mode == mode_PopOn ? m_displayedMemory ^ 1 : m_displayedMemory];
+}
+
+void ChannelDecoder::clearMemory(int memory)
+{
+	std::memset(m_memory[memory], 0, sizeof(m_memory[memory]));
+	if (memory == m_displayedMemory)
+		m_changed = true;
+}
+
+void ChannelDecoder::moveRollUpWindow(uint8_t newBaseRow)
+{
+	uint16_t (*displayed)[kColumns] = m_memory[m_displayedMemory];
+	uint16_t window[4][kColumns];
+	uint8_t rows = m_rollUpRows;
+	
+	if (rows > m_row + 1)
+		rows = m_row + 1;
+	if (rows > newBaseRow + 1)
+		rows = newBaseRow + 1;
+	
+	std::memcpy(window, displayed[m_row + 1 - rows], rows * sizeof(displayed[0]));
+	std::memset(displayed, 0, sizeof(m_memory[0]));
+	std::memcpy(displayed[newBaseRow + 1 - rows], window, rows * sizeof(displayed[0]));
+	m_changed = true;
+}
+
+void ChannelDecoder::carriageReturn()
+{
+	// 9.4 Roll-Up Mode, the rows of the window move up and the base row is cleared
+	if (m_mode != mode_RollUp)
+		return;
+	
+	uint16_t (*displayed)[kColumns] = m_memory[m_displayedMemory];
+	int top = m_row + 1 - m_rollUpRows;
+	if (top < 0)
+		top = 0;
+	
+	for (int row = 0; row < kRows; row++)
+	{
+		if (row >= top && row < m_row)
+			std::memcpy(displayed[row], displayed[row + 1], sizeof(displayed[row]));
+		else
+			std::memset(displayed[row], 0, sizeof(displayed[row]));
+	}
+	
+	m_column = 0;
+	m_changed = true;
+}
+
+void ChannelDecoder::writeCharacter(uint16_t codePoint)
+{
+	if (m_mode == mode_None || m_mode == mode_Text)
+		return;
+	
+	targetMemory()[m_row][m_column] = codePoint;
+	if (m_mode != mode_PopOn)
+		m_changed = true;
+	
+	// Characters received at the last column overwrite it
+	if (m_column < kColumns - 1)
+		m_column++;
+}
+
+void ChannelDecoder::miscellaneousControl(uint8_t code)
+{
+	switch (code)
+	{
+		case 0x20:	// RCL Resume Caption Loading
+			m_mode = mode_PopOn;
+			break;
+			
+		case 0x21:	// BS Backspace
+			if (m_mode != mode_None && m_mode != mode_Text && m_column > 0)
+			{
+				m_column--;
+				targetMemory()[m_row][m_column] = 0;
+				if (m_mode != mode_PopOn)
+					m_changed = true;
+			}
+			break;
+			
+		case 0x24:	// DER Delete to End of Row
+			if (m_mode != mode_None && m_mode != mode_Text)
+			{
+				std::memset(&targetMemory()[m_row][m_column], 0, (kColumns - m_column) * sizeof(uint16_t));
+				if (m_mode != mode_PopOn)
+					m_changed = true;
+			}
+			break;
+			
+		case 0x25:	// RU2 Roll-Up Captions 2 Rows
+		case 0x26:	// RU3
+		case 0x27:	// RU4
+			if (m_mode != mode_RollUp)
+			{
+				clearMemory(0);
+				clearMemory(1);
+				m_row = kRows - 1;
+				m_column = 0;
+			}
+			m_mode = mode_RollUp;
+			m_rollUpRows = code - 0x25 + 2;
+			break;
+			
+		case 0x29:	// RDC Resume Direct Captioning
+			m_mode = mode_PaintOn;
+			break;
+			
+		case 0x2A:	// TR Text Restart
+		case 0x2B:	// RTD Resume Text Display
+			m_mode = mode_Text;
+			break;
+			
+		case 0x2C:	// EDM Erase Displayed Memory
+			clearMemory(m_displayedMemory);
+			break;
+			
+		case 0x2D:	// CR Carriage Return
+			carriageReturn();
+			break;
+			
+		case 0x2E:	// ENM Erase Non-Displayed Memory
+			clearMemory(m_displayedMemory ^ 1);
+			break;
+			
+		case 0x2F:	// EOC End of Caption
+			m_displayedMemory ^= 1;
+			m_mode = mode_PopOn;
+			m_changed = true;
+			break;
+			
+		default:	// AOF, AON and FON are not used for captions
+			break;
+	}
+}
+
+void ChannelDecoder::preambleAddress(uint8_t code1, uint8_t code2)
+{
+	uint8_t row = kPreambleRows[code1 & 0x07][(code2 & 0x20) ? 1 : 0] - 1;
+	
+	if (m_mode == mode_RollUp && row != m_row)
+		moveRollUpWindow(row);
+	
+	m_row = row;
+	
+	// Indent codes 0x50-0x5F (and 0x70-0x7F) set the column, the others only set attributes
+	m_column = (code2 & 0x10) ? ((code2 & 0x0E) >> 1) * 4 : 0;
+}
+
+void ChannelDecoder::control(uint8_t code1, uint8_t code2)
+{
+	if (code2 >= 0x40)
+		preambleAddress(code1, code2);
+	else if ((code1 == 0x14 || code1 == 0x15) && code2 >= 0x20 && code2 <= 0x2F)
+		miscellaneousControl(code2);
+	else if (code1 == 0x17 && code2 >= 0x21 && code2 <= 0x23)
+	{
+		// Tab Offsets
+		m_column += code2 - 0x20;
+		if (m_column > kColumns - 1)
+			m_column = kColumns - 1;
+	}
+	else if (code1 == 0x11 && code2 >= 0x20 && code2 <= 0x2F)
+	{
+		// Mid-Row Codes are displayed as a space
+		writeCharacter(' ');
+	}
+	else if (code1 == 0x11 && code2 >= 0x30 && code2 <= 0x3F)
+		writeCharacter(kSpecialCharacters[code2 - 0x30]);
+	else if ((code1 == 0x12 || code1 == 0x13) && code2 >= 0x20 && code2 <= 0x3F)
+	{
+		// Extended characters follow a standard character for decoders which do not support them, and replace it
+		if (m_column > 0)
+			m_column--;
+		writeCharacter(kExtendedCharacters[code1 - 0x12][code2 - 0x20]);
+	}
+}
+
+void ChannelDecoder::characters(uint8_t char1, uint8_t char2)
+{
+	writeCharacter(StandardCharacter(char1));
+	if (char2 >= 0x20)
+		writeCharacter(StandardCharacter(char2));
+}
+
+bool ChannelDecoder::updateText(CEA708::CaptionText& scratch)
+{
+	if (!m_changed)
+		return false;
+	
+	m_changed = false;
+	
+	scratch.clear();
+	for (int row = 0; row < kRows; row++)
+		scratch.appendRow(m_memory[m_displayedMemory][row], kColumns);
+	
+	if (scratch == m_text)
+		return false;
+	
+	m_text = scratch;
+	return true;
+}
+
+//=====================================================================
+
+FieldDecoder::FieldDecoder()
+: m_currentChannel(0), m_extendedDataService(false)
+{
+	m_lastControl[0] = 0;
+	m_lastControl[1] = 0;
+}
+
+bool FieldDecoder::decode(uint8_t byte1, uint8_t byte2)
+{
+	if (!HasOddParity(byte1) || !HasOddParity(byte2))
+		return false;
+	
+	byte1 &= 0x7F;
+	byte2 &= 0x7F;
+	
+	if (byte1 >= 0x10 && byte1 <= 0x1F)
+	{
+		// Control codes are sent twice, the repeat is ignored
+		bool repeated = byte1 == m_lastControl[0] && byte2 == m_lastControl[1];
+		m_lastControl[0] = repeated ? 0 : byte1;
+		m_lastControl[1] = repeated ? 0 : byte2;
+		if (repeated)
+			return true;
+		
+		// The data channel bit selects the channel for the following characters
+		m_currentChannel = (byte1 & 0x08) ? 1 : 0;
+		m_extendedDataService = false;
+		m_channels[m_currentChannel].control(byte1 & ~0x08, byte2);
+		return true;
+	}
+	
+	m_lastControl[0] = 0;
+	m_lastControl[1] = 0;
+	
+	if (byte1 >= 0x01 && byte1 <= 0x0F)
+	{
+		// XDS packets in field 2 run from a start code to the 0x0F end code
+		m_extendedDataService = byte1 != 0x0F;
+		return true;
+	}
+	
+	if (byte1 >= 0x20 && !m_extendedDataService)
+		m_channels[m_currentChannel].characters(byte1, byte2);
+	
+	return true;
+}
+
+}
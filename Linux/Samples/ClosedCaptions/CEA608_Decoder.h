@@ -0,0 +1,141 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2020 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#ifndef __CEA608_DECODER_H__
+#define __CEA608_DECODER_H__
+#include <stdint.h>
+#include "CEA708_CodeSet.h"
+
+namespace CEA608
+{
+
+/* CEA-608 (line 21) caption decoding, for the compatibility bytes carried in CEA-708 cc_data.
+ * References below refer to CEA-608-E.
+ *
+ * Each field carries two caption channels, CC1 and CC2 in field 1 and CC3 and CC4 in field 2.
+ * Pop-on, roll-up and paint-on captions are decoded into displayed and non-displayed memory,
+ * text mode and XDS data are skipped, and attributes (colour, italics, underline) are ignored.
+ */
+
+enum
+{
+	kChannelCount = 4,
+	kRows = 15,
+	kColumns = 32
+};
+
+// One caption channel, 7 Caption Mode
+class ChannelDecoder
+{
+private:
+	enum Mode
+	{
+		mode_None = 0,
+		mode_PopOn,
+		mode_RollUp,
+		mode_PaintOn,
+		mode_Text
+	};
+	
+	uint16_t			m_memory[2][kRows][kColumns];
+	int					m_displayedMemory;
+	Mode				m_mode;
+	uint8_t				m_rollUpRows;
+	uint8_t				m_row;
+	uint8_t				m_column;
+	bool				m_changed;
+	CEA708::CaptionText	m_text;
+	
+	uint16_t (*targetMemory())[kColumns];
+	void clearMemory(int memory);
+	void moveRollUpWindow(uint8_t newBaseRow);
+	void carriageReturn();
+	void writeCharacter(uint16_t codePoint);
+	
+	void miscellaneousControl(uint8_t code);
+	void preambleAddress(uint8_t code1, uint8_t code2);
+	
+public:
+	ChannelDecoder();
+	
+	void reset();
+	
+	// Control code pair, code1 normalised to channel 1 (0x10-0x17)
+	void control(uint8_t code1, uint8_t code2);
+	
+	// Pair of standard characters, 0 for a missing second character
+	void characters(uint8_t char1, uint8_t char2);
+	
+	/* Update the displayed text if the displayed memory has changed since the last update,
+	 * using scratch to render.  Returns true if the text is different. */
+	bool updateText(CEA708::CaptionText& scratch);
+	
+	inline const CEA708::CaptionText& text() const
+	{
+		return m_text;
+	}
+};
+
+
+// One field of line 21 data, 8 Data Channel and Field Allocation
+class FieldDecoder
+{
+private:
+	ChannelDecoder	m_channels[2];
+	int				m_currentChannel;
+	uint8_t			m_lastControl[2];
+	bool			m_extendedDataService;
+	
+public:
+	FieldDecoder();
+	
+	/* Decode a byte pair with odd parity.  Returns false, ignoring the pair, if either
+	 * byte fails the parity check. */
+	bool decode(uint8_t byte1, uint8_t byte2);
+	
+	inline ChannelDecoder& channel(int index)
+	{
+		return m_channels[index];
+	}
+};
+
+}
+
+#endif
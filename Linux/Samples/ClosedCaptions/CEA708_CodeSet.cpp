@@ -0,0 +1,209 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2020 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#include "CEA708_CodeSet.h"
+#include <algorithm>
+#include <cstring>
+
+namespace CEA708
+{
+
+namespace
+{
+	struct G2Character
+	{
+		uint16_t	codePoint;
+		uint8_t		code;
+	};
+	
+	// CEA-708 7.1.6 G2 Code Set, sorted by code point
+	const G2Character kG2Characters[] =
+	{
+		{ 0x0152, 0x2C },	// Œ
+		{ 0x0153, 0x3C },	// œ
+		{ 0x0160, 0x2A },	// Š
+		{ 0x0161, 0x3A },	// š
+		{ 0x0178, 0x3F },	// Ÿ
+		{ 0x2018, 0x31 },	// ‘
+		{ 0x2019, 0x32 },	// ’
+		{ 0x201C, 0x33 },	// “
+		{ 0x201D, 0x34 },	// ”
+		{ 0x2022, 0x35 },	// •
+		{ 0x2026, 0x25 },	// …
+		{ 0x2120, 0x3D },	// ℠
+		{ 0x2122, 0x39 },	// ™
+		{ 0x215B, 0x76 },	// ⅛
+		{ 0x215C, 0x77 },	// ⅜
+		{ 0x215D, 0x78 },	// ⅝
+		{ 0x215E, 0x79 },	// ⅞
+		{ 0x2500, 0x7D },	// ─
+		{ 0x2502, 0x7A },	// │
+		{ 0x250C, 0x7F },	// ┌
+		{ 0x2510, 0x7B },	// ┐
+		{ 0x2514, 0x7C },	// └
+		{ 0x2518, 0x7E },	// ┘
+		{ 0x2588, 0x30 },	// █
+	};
+	
+	const G2Character* const kG2CharactersEnd = kG2Characters + sizeof(kG2Characters) / sizeof(kG2Characters[0]);
+	
+	const uint32_t kMusicNote = 0x266A;
+	
+	// Caption characters are all in the Basic Multilingual Plane
+	std::size_t EncodeUTF8(uint16_t codePoint, char* out)
+	{
+		if (codePoint < 0x80)
+		{
+			out[0] = static_cast<char>(codePoint);
+			return 1;
+		}
+		if (codePoint < 0x800)
+		{
+			out[0] = static_cast<char>(0xC0 | (codePoint >> 6));
+			out[1] = static_cast<char>(0x80 | (codePoint & 0x3F));
+			return 2;
+		}
+		out[0] = static_cast<char>(0xE0 | (codePoint >> 12));
+		out[1] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+		out[2] = static_cast<char>(0x80 | (codePoint & 0x3F));
+		return 3;
+	}
+}
+
+uint8_t CodePointToCaptionCode(uint32_t codePoint, uint8_t code[2])
+{
+	if (codePoint >= 0xA0 && codePoint <= 0xFF)
+	{
+		code[0] = static_cast<uint8_t>(codePoint);
+		return 1;
+	}
+	
+	if (codePoint == kMusicNote)
+	{
+		code[0] = 0x7F;
+		return 1;
+	}
+	
+	const G2Character* character = std::lower_bound(kG2Characters, kG2CharactersEnd, codePoint,
+													[](const G2Character& c, uint32_t cp) { return c.codePoint < cp; });
+	if (character != kG2CharactersEnd && character->codePoint == codePoint)
+	{
+		code[0] = kEXT1;
+		code[1] = character->code;
+		return 2;
+	}
+	
+	code[0] = '_';
+	return 1;
+}
+
+uint32_t CaptionCodeToCodePoint(uint8_t code, bool extended)
+{
+	if (!extended)
+	{
+		if (code >= 0x20 && code < 0x7F)
+			return code;
+		if (code == 0x7F)
+			return kMusicNote;
+		if (code >= 0xA0)
+			return code;
+		return 0;
+	}
+	
+	if (code == 0x20 || code == 0x21)
+		return ' ';	// transparent spaces
+	
+	for (const G2Character* character = kG2Characters; character != kG2CharactersEnd; ++character)
+	{
+		if (character->code == code)
+			return character->codePoint;
+	}
+	
+	// Unassigned G2 characters and the G3 [CC] icon are displayed as an underscore
+	return (code >= 0x20 && code <= 0x7F) || code >= 0xA0 ? '_' : 0;
+}
+
+//=====================================================================
+
+CaptionText::CaptionText()
+: m_size(0)
+{
+	m_text[0] = '\0';
+}
+
+void CaptionText::clear()
+{
+	m_size = 0;
+	m_text[0] = '\0';
+}
+
+void CaptionText::appendRow(const uint16_t* cells, std::size_t count)
+{
+	// Blank cells are 0 or a space, only the characters up to the last printable one are kept
+	while (count > 0 && (cells[count - 1] == 0 || cells[count - 1] == ' '))
+		--count;
+	
+	if (count == 0)
+		return;
+	
+	// Room for a newline, up to 3 bytes per cell and the terminator
+	if (m_size + 1 + count * 3 + 1 > kMaxTextSize)
+		return;
+	
+	if (m_size > 0)
+		m_text[m_size++] = '\n';
+	
+	for (std::size_t i = 0; i < count; ++i)
+		m_size += EncodeUTF8(cells[i] ? cells[i] : ' ', m_text + m_size);
+	
+	m_text[m_size] = '\0';
+}
+
+bool CaptionText::operator==(const CaptionText& other) const
+{
+	return m_size == other.m_size && std::memcmp(m_text, other.m_text, m_size) == 0;
+}
+
+bool CaptionText::operator!=(const CaptionText& other) const
+{
+	return !(*this == other);
+}
+
+}
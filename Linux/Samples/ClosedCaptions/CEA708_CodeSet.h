@@ -0,0 +1,108 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2020 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#ifndef __CEA708_CODESET_H__
+#define __CEA708_CODESET_H__
+#include <cstddef>
+#include <stdint.h>
+
+namespace CEA708
+{
+
+/* Conversion between Unicode and the caption code sets of CEA-708 7.1 Code Space Organization.
+ * G0 is ASCII with a music note in place of DEL, G1 is the upper half of ISO 8859-1 and the
+ * G2 and G3 code sets are reached with the EXT1 prefix. */
+
+enum
+{
+	kEXT1 = 0x10
+};
+
+/* Write the caption code for a Unicode code point, prefixed with EXT1 for G2 characters.
+ * Characters outside the code sets are replaced with an underscore.  Returns the number of bytes written. */
+uint8_t CodePointToCaptionCode(uint32_t codePoint, uint8_t code[2]);
+
+/* Unicode code point of a G0/G1 character, or of a G2/G3 character when extended (it followed EXT1).
+ * Returns 0 for codes which are not printable characters. */
+uint32_t CaptionCodeToCodePoint(uint8_t code, bool extended);
+
+
+/* Fixed-capacity UTF-8 caption text, built a row at a time from a grid of code points.
+ * Trailing blanks are trimmed, empty rows skipped and rows separated by newlines. */
+class CaptionText
+{
+public:
+	enum
+	{
+		kMaxTextSize = 4096
+	};
+	
+private:
+	char		m_text[kMaxTextSize];
+	std::size_t	m_size;
+	
+public:
+	CaptionText();
+	
+	void clear();
+	void appendRow(const uint16_t* cells, std::size_t count);
+	
+	inline const char* c_str() const
+	{
+		return m_text;
+	}
+	
+	inline std::size_t size() const
+	{
+		return m_size;
+	}
+	
+	inline bool empty() const
+	{
+		return m_size == 0;
+	}
+	
+	bool operator==(const CaptionText& other) const;
+	bool operator!=(const CaptionText& other) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,587 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2020 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#include "CEA708_Decoder.h"
+#include <cstdio>
+#include <cstring>
+
+namespace CEA708
+{
+
+namespace
+{
+	struct CaptionServiceNames
+	{
+		char names[kCaptionServiceCount][12];
+		
+		CaptionServiceNames()
+		{
+			for (unsigned i = 0; i < kDTVCCServiceCount; ++i)
+				snprintf(names[i], sizeof(names[i]), "Service%u", i + 1);
+			for (unsigned i = 0; i < CEA608::kChannelCount; ++i)
+				snprintf(names[kDTVCCServiceCount + i], sizeof(names[i]), "CC%u", i + 1);
+		}
+	};
+	
+	// Number of parameter bytes following C1 commands 0x80-0x9F, 7.1.3 and 8.10.5
+	const uint8_t kC1ParameterBytes[32] =
+	{
+		0, 0, 0, 0, 0, 0, 0, 0,		// CW0-CW7
+		1, 1, 1, 1, 1, 1, 0, 0,		// CLW, DSW, HDW, TGW, DLW, DLY, DLC, RST
+		2, 3, 2, 0, 0, 0, 0, 4,		// SPA, SPC, SPL, reserved, SWA
+		6, 6, 6, 6, 6, 6, 6, 6		// DF0-DF7
+	};
+}
+
+const char* GetCaptionServiceName(unsigned service)
+{
+	static const CaptionServiceNames serviceNames;
+	return service < kCaptionServiceCount ? serviceNames.names[service] : "";
+}
+
+//=====================================================================
+
+ServiceDecoder::ServiceDecoder()
+{
+	reset();
+}
+
+void ServiceDecoder::reset()
+{
+	std::memset(m_windows, 0, sizeof(m_windows));
+	m_currentWindow = -1;
+	m_changed = true;
+}
+
+ServiceDecoder::Window* ServiceDecoder::currentWindow()
+{
+	if (m_currentWindow < 0 || !m_windows[m_currentWindow].defined)
+		return NULL;
+	return &m_windows[m_currentWindow];
+}
+
+void ServiceDecoder::clearWindow(Window& window)
+{
+	std::memset(window.cells, 0, sizeof(window.cells));
+	window.penRow = 0;
+	window.penColumn = 0;
+	m_changed = true;
+}
+
+void ServiceDecoder::setVisible(uint8_t windowMask, int visibility)
+{
+	for (int i = 0; i < kWindowCount; ++i)
+	{
+		if (windowMask & (1 << i))
+			m_windows[i].visible = visibility < 0 ? !m_windows[i].visible : visibility > 0;
+	}
+	m_changed = true;
+}
+
+void ServiceDecoder::deleteWindows(uint8_t windowMask)
+{
+	for (int i = 0; i < kWindowCount; ++i)
+	{
+		if (windowMask & (1 << i))
+		{
+			m_windows[i].defined = false;
+			m_windows[i].visible = false;
+		}
+	}
+	m_changed = true;
+}
+
+void ServiceDecoder::defineWindow(int windowID, const uint8_t* parameters)
+{
+	Window& window = m_windows[windowID];
+	
+	// A window which is already defined keeps its text, 8.10.5.2
+	if (!window.defined)
+		clearWindow(window);
+	
+	window.defined = true;
+	window.visible = (parameters[0] >> 5) & 0x1;
+	window.priority = parameters[0] & 0x7;
+	window.rowCount = (parameters[3] & 0xF) + 1;
+	window.columnCount = (parameters[4] & 0x3F) + 1;
+	if (window.columnCount > kMaxColumns)
+		window.columnCount = kMaxColumns;
+	
+	m_currentWindow = windowID;
+	m_changed = true;
+}
+
+void ServiceDecoder::carriageReturn(Window& window)
+{
+	window.penColumn = 0;
+	if (window.penRow + 1 < window.rowCount)
+	{
+		window.penRow++;
+		return;
+	}
+	
+	// Scroll the window contents up at the last row
+	std::memmove(window.cells[0], window.cells[1], (window.rowCount - 1) * sizeof(window.cells[0]));
+	std::memset(window.cells[window.rowCount - 1], 0, sizeof(window.cells[0]));
+	window.penRow = window.rowCount - 1;
+	m_changed = true;
+}
+
+void ServiceDecoder::writeCharacter(uint32_t codePoint)
+{
+	Window* window = currentWindow();
+	if (window == NULL || codePoint == 0)
+		return;
+	
+	if (window->penRow < window->rowCount && window->penColumn < window->columnCount)
+	{
+		window->cells[window->penRow][window->penColumn] = static_cast<uint16_t>(codePoint);
+		window->penColumn++;
+		m_changed = true;
+	}
+}
+
+std::size_t ServiceDecoder::decodeC0(const uint8_t* data, std::size_t size)
+{
+	uint8_t code = data[0];
+	Window* window = currentWindow();
+	
+	if (code == kEXT1)
+		return decodeExtended(data, size);
+	
+	// 7.1.2 C0 Code Set, 0x11-0x17 are followed by one byte and 0x18-0x1F by two
+	if (code >= 0x18)
+		return size >= 3 ? 3 : 0;
+	if (code >= 0x11)
+		return size >= 2 ? 2 : 0;
+	
+	switch (code)
+	{
+		case 0x08:	// BS Backspace
+			if (window && window->penColumn > 0)
+			{
+				window->penColumn--;
+				if (window->penRow < window->rowCount && window->penColumn < window->columnCount)
+					window->cells[window->penRow][window->penColumn] = 0;
+				m_changed = true;
+			}
+			break;
+			
+		case 0x0C:	// FF Form Feed
+			if (window)
+				clearWindow(*window);
+			break;
+			
+		case 0x0D:	// CR Carriage Return
+			if (window)
+				carriageReturn(*window);
+			break;
+			
+		case 0x0E:	// HCR Horizontal Carriage Return
+			if (window && window->penRow < window->rowCount)
+			{
+				std::memset(window->cells[window->penRow], 0, sizeof(window->cells[0]));
+				window->penColumn = 0;
+				m_changed = true;
+			}
+			break;
+			
+		default:	// NUL, ETX and unused codes
+			break;
+	}
+	
+	return 1;
+}
+
+std::size_t ServiceDecoder::decodeC1(const uint8_t* data, std::size_t size)
+{
+	uint8_t code = data[0];
+	std::size_t length = 1 + kC1ParameterBytes[code - 0x80];
+	
+	if (length > size)
+		return 0;	// Commands are not split across service blocks, ignore a truncated one
+	
+	if (code <= 0x87)
+	{
+		// CW0-CW7 Set Current Window
+		m_currentWindow = code - 0x80;
+	}
+	else if (code >= 0x98)
+	{
+		// DF0-DF7 Define Window
+		defineWindow(code - 0x98, data + 1);
+	}
+	else
+	{
+		switch (code)
+		{
+			case 0x88:	// CLW Clear Windows
+				for (int i = 0; i < kWindowCount; ++i)
+				{
+					if ((data[1] & (1 << i)) && m_windows[i].defined)
+						clearWindow(m_windows[i]);
+				}
+				break;
+				
+			case 0x89:	// DSW Display Windows
+				setVisible(data[1], 1);
+				break;
+				
+			case 0x8A:	// HDW Hide Windows
+				setVisible(data[1], 0);
+				break;
+				
+			case 0x8B:	// TGW Toggle Windows
+				setVisible(data[1], -1);
+				break;
+				
+			case 0x8C:	// DLW Delete Windows
+				deleteWindows(data[1]);
+				break;
+				
+			case 0x8F:	// RST Reset
+				reset();
+				break;
+				
+			case 0x92:	// SPL Set Pen Location
+				if (Window* window = currentWindow())
+				{
+					window->penRow = data[1] & 0x0F;
+					window->penColumn = data[2] & 0x3F;
+				}
+				break;
+				
+			default:	// DLY, DLC, SPA, SPC and SWA only affect presentation
+				break;
+		}
+	}
+	
+	return length;
+}
+
+std::size_t ServiceDecoder::decodeExtended(const uint8_t* data, std::size_t size)
+{
+	if (size < 2)
+		return 0;
+	
+	uint8_t code = data[1];
+	std::size_t length;
+	
+	// 7.1.8 C2 and 7.1.10 C3 Code Sets, extended commands are skipped
+	if (code < 0x20)
+		length = 2 + (code >> 3);
+	else if (code >= 0x80 && code <= 0x87)
+		length = 2 + 4;
+	else if (code >= 0x88 && code <= 0x8F)
+		length = 2 + 5;
+	else if (code >= 0x90 && code <= 0x9F)
+		length = size >= 3 ? 3 + (data[2] & 0x3F) : size + 1;
+	else
+	{
+		writeCharacter(CaptionCodeToCodePoint(code, true));
+		length = 2;
+	}
+	
+	return length <= size ? length : 0;
+}
+
+void ServiceDecoder::decode(const uint8_t* data, std::size_t size)
+{
+	std::size_t offset = 0;
+	
+	while (offset < size)
+	{
+		uint8_t code = data[offset];
+		std::size_t length;
+		
+		if (code < 0x20)
+			length = decodeC0(data + offset, size - offset);
+		else if (code >= 0x80 && code < 0xA0)
+			length = decodeC1(data + offset, size - offset);
+		else
+		{
+			// G0 and G1 characters
+			writeCharacter(CaptionCodeToCodePoint(code, false));
+			length = 1;
+		}
+		
+		if (length == 0)
+			break;
+		
+		offset += length;
+	}
+}
+
+bool ServiceDecoder::updateText(CaptionText& scratch)
+{
+	if (!m_changed)
+		return false;
+	
+	m_changed = false;
+	
+	// Visible windows from the highest priority down
+	scratch.clear();
+	for (int priority = 0; priority < kWindowCount; ++priority)
+	{
+		for (int i = 0; i < kWindowCount; ++i)
+		{
+			const Window& window = m_windows[i];
+			if (!window.defined || !window.visible || window.priority != priority)
+				continue;
+			
+			for (int row = 0; row < window.rowCount; ++row)
+				scratch.appendRow(window.cells[row], window.columnCount);
+		}
+	}
+	
+	if (scratch == m_text)
+		return false;
+	
+	m_text = scratch;
+	return true;
+}
+
+//=====================================================================
+
+Decoder::Decoder(CaptionListener& listener)
+: m_listener(listener), m_packetSize(0), m_packetLength(0), m_packetSequence(-1), m_cdpSequence(-1)
+{
+	std::memset(&m_statistics, 0, sizeof(m_statistics));
+}
+
+void Decoder::decodePacket()
+{
+	// CEA-708 5 DTVCC Packet Layer
+	int sequence = m_packet[0] >> 6;
+	if (m_packetSequence >= 0 && sequence != ((m_packetSequence + 1) & 0x3))
+		++m_statistics.packetDiscontinuities;
+	m_packetSequence = sequence;
+	++m_statistics.packetCount;
+	
+	// CEA-708 6.2 Service Blocks
+	unsigned offset = 1;
+	while (offset < m_packetLength)
+	{
+		uint8_t header = m_packet[offset++];
+		unsigned serviceNumber = header >> 5;
+		unsigned blockSize = header & 0x1F;
+		
+		if (serviceNumber == 0)
+			break;	// Null service block, the rest of the packet is padding
+		
+		if (serviceNumber == 7)
+		{
+			// Extended service block header
+			if (offset >= m_packetLength)
+			{
+				++m_statistics.packetErrors;
+				break;
+			}
+			serviceNumber = m_packet[offset++] & 0x3F;
+		}
+		
+		if (offset + blockSize > m_packetLength)
+		{
+			++m_statistics.packetErrors;
+			break;
+		}
+		
+		if (serviceNumber > 0)
+		{
+			std::unique_ptr<ServiceDecoder>& service = m_services[serviceNumber - 1];
+			if (!service)
+				service.reset(new ServiceDecoder());
+			service->decode(m_packet + offset, blockSize);
+		}
+		
+		offset += blockSize;
+	}
+}
+
+void Decoder::decodeCCData(const uint8_t* ccData, unsigned ccCount)
+{
+	enum cc_type
+	{
+		cc_type_608_1 = 0,
+		cc_type_608_2,
+		cc_type_708_data,
+		cc_type_708_start
+	};
+	
+	for (unsigned i = 0; i < ccCount; ++i, ccData += 3)
+	{
+		bool ccValid = (ccData[0] & 0x4) != 0;
+		int ccType = ccData[0] & 0x3;
+		
+		if (ccType == cc_type_608_1 || ccType == cc_type_608_2)
+		{
+			if (ccValid && !m_fields[ccType].decode(ccData[1], ccData[2]))
+				++m_statistics.cea608ParityErrors;
+			continue;
+		}
+		
+		if (!ccValid)
+			continue;
+		
+		if (ccType == cc_type_708_start)
+		{
+			if (m_packetSize > 0)
+				++m_statistics.packetErrors;	// The previous packet was incomplete
+			
+			uint8_t sizeCode = ccData[1] & 0x3F;
+			m_packetLength = sizeCode == 0 ? kMaximumPacketSize : sizeCode * 2;
+			m_packetSize = 0;
+		}
+		else if (m_packetSize == 0)
+			continue;	// Data without a packet start
+		
+		m_packet[m_packetSize++] = ccData[1];
+		m_packet[m_packetSize++] = ccData[2];
+		
+		if (m_packetSize >= m_packetLength)
+		{
+			decodePacket();
+			m_packetSize = 0;
+		}
+	}
+}
+
+void Decoder::updateText(int64_t timeMs)
+{
+	for (unsigned i = 0; i < kDTVCCServiceCount; ++i)
+	{
+		if (m_services[i] && m_services[i]->updateText(m_scratchText))
+			m_listener.captionChanged(i, m_services[i]->text(), timeMs);
+	}
+	
+	for (unsigned i = 0; i < CEA608::kChannelCount; ++i)
+	{
+		CEA608::ChannelDecoder& channel = m_fields[i / 2].channel(i % 2);
+		if (channel.updateText(m_scratchText))
+			m_listener.captionChanged(kDTVCCServiceCount + i, channel.text(), timeMs);
+	}
+}
+
+bool Decoder::decode(const uint8_t* cdp, uint32_t size, int64_t timeMs)
+{
+	static const uint16_t	CDP_IDENTIFIER = 0x9669;
+	static const uint8_t	CDP_TIMECODE_ID = 0x71;
+	static const uint8_t	CCDATA_ID = 0x72;
+	
+	enum
+	{
+		kCDPHeaderLength = 7,
+		kCDPFooterLength = 4,
+		kTimecodeSectionLength = 5,
+		kMaxCDPRepeatDistance = 8
+	};
+	
+	enum cdp_flags
+	{
+		time_code_present = 1 << 7,
+		ccdata_present = 1 << 6
+	};
+	
+	if (cdp == NULL)
+	{
+		// A frame without a CDP loses any partial caption channel packet
+		if (m_packetSize > 0)
+			++m_statistics.packetErrors;
+		m_packetSize = 0;
+		return true;
+	}
+	
+	// SMPTE 334-2 5 CDP Detailed Specification, the ancillary packet may be padded beyond cdp_length
+	if (size < kCDPHeaderLength + kCDPFooterLength || ((cdp[0] << 8) | cdp[1]) != CDP_IDENTIFIER || cdp[2] > size || cdp[2] < kCDPHeaderLength + kCDPFooterLength)
+	{
+		++m_statistics.cdpErrors;
+		return false;
+	}
+	
+	size = cdp[2];
+	
+	uint8_t checksum = 0;
+	for (uint32_t i = 0; i < size; ++i)
+		checksum += cdp[i];
+	
+	if (checksum != 0)
+	{
+		++m_statistics.cdpErrors;
+		return false;
+	}
+	
+	int sequence = (cdp[5] << 8) | cdp[6];
+	if (m_cdpSequence >= 0)
+	{
+		// A repeated frame repeats its CDP, decoding it again would repeat the caption data
+		int behind = (m_cdpSequence - sequence) & 0xFFFF;
+		if (behind <= kMaxCDPRepeatDistance)
+		{
+			++m_statistics.cdpRepeats;
+			return true;
+		}
+		
+		if (sequence != ((m_cdpSequence + 1) & 0xFFFF))
+			++m_statistics.cdpDiscontinuities;
+	}
+	m_cdpSequence = sequence;
+	
+	++m_statistics.cdpCount;
+	
+	uint32_t offset = kCDPHeaderLength;
+	uint32_t end = size - kCDPFooterLength;
+	
+	if ((cdp[4] & time_code_present) && offset < end && cdp[offset] == CDP_TIMECODE_ID)
+		offset += kTimecodeSectionLength;
+	
+	if ((cdp[4] & ccdata_present) && offset + 2 <= end && cdp[offset] == CCDATA_ID)
+	{
+		unsigned ccCount = cdp[offset + 1] & 0x1F;
+		if (offset + 2 + ccCount * 3 <= end)
+			decodeCCData(cdp + offset + 2, ccCount);
+		else
+			++m_statistics.cdpErrors;
+	}
+	
+	updateText(timeMs);
+	return true;
+}
+
+}
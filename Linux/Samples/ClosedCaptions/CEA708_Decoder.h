@@ -0,0 +1,197 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2020 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#ifndef __CEA708_DECODER_H__
+#define __CEA708_DECODER_H__
+#include <memory>
+#include <stdint.h>
+#include "CEA708_CodeSet.h"
+#include "CEA608_Decoder.h"
+
+namespace CEA708
+{
+
+/* Decoding reverses the layers of the encoder:
+ * - caption distribution packets are parsed for their cc_data
+ * - CEA-608 byte pairs are passed to the CEA-608 field decoders (CC1-CC4)
+ * - DTVCC byte pairs are assembled into caption channel packets
+ * - caption channel packets are split into service blocks
+ * - service blocks are interpreted against the windows of their service
+ *
+ * After each CDP the displayed text of every service which changed is passed to a CaptionListener.
+ * The state of a DTVCC service is allocated when the service is first seen, after which decoding
+ * does not allocate.
+ */
+
+enum
+{
+	kDTVCCServiceCount = 63,
+	kCaptionServiceCount = kDTVCCServiceCount + CEA608::kChannelCount
+};
+
+// Caption services are indexed 0-62 for DTVCC services 1-63, followed by CEA-608 CC1-CC4
+const char* GetCaptionServiceName(unsigned service);
+
+
+class CaptionListener
+{
+public:
+	virtual ~CaptionListener() {}
+	
+	// The displayed text of a service changed at timeMs, text is empty when the captions are cleared
+	virtual void captionChanged(unsigned service, const CaptionText& text, int64_t timeMs) = 0;
+};
+
+
+struct DecoderStatistics
+{
+	uint64_t	cdpCount;
+	uint64_t	cdpErrors;				// Bad identifier, length or checksum
+	uint64_t	cdpDiscontinuities;		// cdp_hdr_sequence_cntr did not follow the previous CDP
+	uint64_t	cdpRepeats;				// CDPs ignored because they repeated a recent cdp_hdr_sequence_cntr
+	uint64_t	packetCount;			// DTVCC caption channel packets
+	uint64_t	packetErrors;			// Incomplete or malformed caption channel packets
+	uint64_t	packetDiscontinuities;	// Caption channel packet sequence_number did not follow the previous packet
+	uint64_t	cea608ParityErrors;
+};
+
+
+// CEA-708 8 DTVCC Interpretation Layer, the windows of one caption service.
+// Window and pen attributes, print direction and delays are ignored, only the text is decoded.
+class ServiceDecoder
+{
+private:
+	enum
+	{
+		kWindowCount = 8,
+		kMaxRows = 16,		// 4-bit row count
+		kMaxColumns = 42	// 8.4.6 Window Size, 16:9 displays
+	};
+	
+	struct Window
+	{
+		bool		defined;
+		bool		visible;
+		uint8_t		priority;
+		uint8_t		rowCount;
+		uint8_t		columnCount;
+		uint8_t		penRow;
+		uint8_t		penColumn;
+		uint16_t	cells[kMaxRows][kMaxColumns];
+	};
+	
+	Window		m_windows[kWindowCount];
+	int			m_currentWindow;
+	bool		m_changed;
+	CaptionText	m_text;
+	
+	Window* currentWindow();
+	void clearWindow(Window& window);
+	void setVisible(uint8_t windowMask, int visibility);
+	void deleteWindows(uint8_t windowMask);
+	void defineWindow(int windowID, const uint8_t* parameters);
+	void carriageReturn(Window& window);
+	void writeCharacter(uint32_t codePoint);
+	
+	// Interpret one command or character, returns the number of bytes it used
+	std::size_t decodeC0(const uint8_t* data, std::size_t size);
+	std::size_t decodeC1(const uint8_t* data, std::size_t size);
+	std::size_t decodeExtended(const uint8_t* data, std::size_t size);
+	
+public:
+	ServiceDecoder();
+	
+	void reset();
+	
+	// Decode the data of one service block
+	void decode(const uint8_t* data, std::size_t size);
+	
+	/* Update the displayed text from the visible windows if they have changed since the last update,
+	 * using scratch to render.  Returns true if the text is different. */
+	bool updateText(CaptionText& scratch);
+	
+	inline const CaptionText& text() const
+	{
+		return m_text;
+	}
+};
+
+
+class Decoder
+{
+private:
+	enum
+	{
+		kMaximumPacketSize = 128
+	};
+	
+	CaptionListener&				m_listener;
+	std::unique_ptr<ServiceDecoder>	m_services[kDTVCCServiceCount];
+	CEA608::FieldDecoder			m_fields[2];
+	CaptionText						m_scratchText;
+	
+	uint8_t							m_packet[kMaximumPacketSize];
+	uint8_t							m_packetSize;
+	uint8_t							m_packetLength;
+	int								m_packetSequence;
+	int								m_cdpSequence;
+	
+	DecoderStatistics				m_statistics;
+	
+	void decodeCCData(const uint8_t* ccData, unsigned ccCount);
+	void decodePacket();
+	void updateText(int64_t timeMs);
+	
+public:
+	explicit Decoder(CaptionListener& listener);
+	
+	/* Decode the CDP of one frame.  cdp may be NULL for a frame without captions, which
+	 * ends any partially received caption channel packet.  Returns false if the CDP is invalid. */
+	bool decode(const uint8_t* cdp, uint32_t size, int64_t timeMs);
+	
+	inline const DecoderStatistics& statistics() const
+	{
+		return m_statistics;
+	}
+};
+
+}
+
+#endif
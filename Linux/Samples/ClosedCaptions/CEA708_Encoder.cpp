@@ -39,6 +39,8 @@
  */
 
 #include "CEA708_Encoder.h"
+#include "CEA708_CodeSet.h"
+#include <algorithm>
 #include <cstring>
 
 namespace CEA708
@@ -78,6 +80,167 @@ static CDPFrameRate FrameRateToCDPFrameRate(int64_t frameDuration, int64_t timeS
 	return cdpFrameRate_Forbidden;
 }
 
+// Decode one UTF-8 sequence starting at a lead byte >= 0x80, returns false for malformed sequences
+static bool DecodeUTF8(const uint8_t*& text, const uint8_t* end, uint32_t& codePoint)
+{
+	uint8_t lead = *text++;
+	int continuationBytes;
+	uint32_t minimumCodePoint;
+	
+	if ((lead & 0xE0) == 0xC0)
+	{
+		codePoint = lead & 0x1F;
+		continuationBytes = 1;
+		minimumCodePoint = 0x80;
+	}
+	else if ((lead & 0xF0) == 0xE0)
+	{
+		codePoint = lead & 0x0F;
+		continuationBytes = 2;
+		minimumCodePoint = 0x800;
+	}
+	else if ((lead & 0xF8) == 0xF0)
+	{
+		codePoint = lead & 0x07;
+		continuationBytes = 3;
+		minimumCodePoint = 0x10000;
+	}
+	else
+		return false;
+	
+	for (int i = 0; i < continuationBytes; ++i)
+	{
+		if (text == end || (*text & 0xC0) != 0x80)
+			return false;
+		codePoint = (codePoint << 6) | (*text++ & 0x3F);
+	}
+	
+	return codePoint >= minimumCodePoint && codePoint <= 0x10FFFF;
+}
+
+//=====================================================================
+
+CDPView::CDPView()
+: m_ring(NULL), m_slot(0), m_data(NULL), m_size(0)
+{
+}
+
+CDPView::CDPView(CDPView&& other)
+: m_ring(other.m_ring), m_slot(other.m_slot), m_data(other.m_data), m_size(other.m_size)
+{
+	other.m_ring = NULL;
+	other.m_data = NULL;
+	other.m_size = 0;
+}
+
+CDPView::~CDPView()
+{
+	release();
+}
+
+CDPView& CDPView::operator=(CDPView&& other)
+{
+	if (this != &other)
+	{
+		release();
+		
+		m_ring = other.m_ring;
+		m_slot = other.m_slot;
+		m_data = other.m_data;
+		m_size = other.m_size;
+		
+		other.m_ring = NULL;
+		other.m_data = NULL;
+		other.m_size = 0;
+	}
+	return *this;
+}
+
+void CDPView::release()
+{
+	if (m_ring)
+		m_ring->release(m_slot);
+	
+	m_ring = NULL;
+	m_data = NULL;
+	m_size = 0;
+}
+
+//=====================================================================
+
+CDPRing::CDPRing(uint32_t capacity)
+: m_mask(0), m_writeIndex(0), m_readIndex(0), m_reclaimIndex(0), m_overflowCount(0)
+{
+	uint32_t roundedCapacity = 1;
+	while (roundedCapacity < capacity)
+		roundedCapacity <<= 1;
+	
+	m_slots.reset(new Slot[roundedCapacity]);
+	m_mask = roundedCapacity - 1;
+	
+	for (uint32_t i = 0; i < roundedCapacity; ++i)
+	{
+		m_slots[i].size = 0;
+		m_slots[i].held.store(false, std::memory_order_relaxed);
+	}
+}
+
+void CDPRing::reclaim()
+{
+	while (m_reclaimIndex != m_readIndex && !m_slots[m_reclaimIndex & m_mask].held.load(std::memory_order_acquire))
+		++m_reclaimIndex;
+}
+
+uint8_t* CDPRing::reserve()
+{
+	if (m_writeIndex - m_reclaimIndex > m_mask)
+	{
+		reclaim();
+		
+		if (m_writeIndex - m_reclaimIndex > m_mask)
+		{
+			++m_overflowCount;
+			return NULL;
+		}
+	}
+	
+	return m_slots[m_writeIndex & m_mask].data;
+}
+
+void CDPRing::commit(uint8_t size)
+{
+	m_slots[m_writeIndex & m_mask].size = size;
+	++m_writeIndex;
+}
+
+bool CDPRing::empty() const
+{
+	return m_readIndex == m_writeIndex;
+}
+
+bool CDPRing::pop(CDPView* view)
+{
+	if (empty())
+		return false;
+	
+	Slot& slot = m_slots[m_readIndex & m_mask];
+	slot.held.store(true, std::memory_order_relaxed);
+	
+	view->release();
+	view->m_ring = this;
+	view->m_slot = m_readIndex & m_mask;
+	view->m_data = slot.data;
+	view->m_size = slot.size;
+	
+	++m_readIndex;
+	return true;
+}
+
+void CDPRing::release(uint32_t slot)
+{
+	m_slots[slot].held.store(false, std::memory_order_release);
+}
+
 //=====================================================================
 
 ServiceBlockEncoder::ServiceBlockEncoder(CaptionChannelPacketEncoder& packetEncoder, uint8_t serviceNumber)
@@ -116,6 +279,25 @@ void ServiceBlockEncoder::push(const uint8_t* buffer, uint8_t count)
 	m_blockSize += count;
 }
 
+void ServiceBlockEncoder::pushCharacters(const uint8_t* characters, std::size_t count)
+{
+	while (count > 0)
+	{
+		if (m_blockSize == kMaximumData)
+		{
+			updateHeader();
+			m_packetEncoder.push(m_block, kHeaderSize + m_blockSize);
+			reset();
+		}
+		
+		uint8_t runLength = static_cast<uint8_t>(std::min<std::size_t>(count, kMaximumData - m_blockSize));
+		std::memcpy(m_block + kHeaderSize + m_blockSize, characters, runLength);
+		m_blockSize += runLength;
+		characters += runLength;
+		count -= runLength;
+	}
+}
+
 void ServiceBlockEncoder::flush()
 {
 	updateHeader();
@@ -164,8 +346,8 @@ void CaptionChannelPacketEncoder::push(const uint8_t* block, uint8_t blockLength
 {
 	/* As service block data and caption packets cannot be fragmented,
 	   the maximum data which can be packed depends on the cc_count of the 
-	   cdp packet into which this caption packet will be encoded. */
-	std::size_t maxDataLength = std::min(m_CDPEncoder.maxPayloadSize(), static_cast<std::size_t>(kMaximumData));
+	   cdp packet into which this caption packet will be encoded, including its header and padding. */
+	std::size_t maxDataLength = std::min(m_CDPEncoder.maxPayloadSize() - kHeaderSize, static_cast<std::size_t>(kMaximumData));
 	
 	if (blockLength > maxDataLength)
 		return;	// service block cannot be larger than caption channel packet.
@@ -193,8 +375,8 @@ void CaptionChannelPacketEncoder::flush()
 
 //=====================================================================
 
-CaptionDistributionPacketEncoder::CaptionDistributionPacketEncoder(CDPQueue& cdpQueue, int64_t frameDuration, int64_t timeScale)
-: m_cdpQueue(cdpQueue), m_sequence(0), m_CCCount(FrameRateToCDPCCCount(frameDuration, timeScale)), m_frameRate(FrameRateToCDPFrameRate(frameDuration, timeScale))
+CaptionDistributionPacketEncoder::CaptionDistributionPacketEncoder(CDPRing& cdpRing, int64_t frameDuration, int64_t timeScale)
+: m_cdpRing(cdpRing), m_sequence(0), m_CCCount(std::min<uint8_t>(FrameRateToCDPCCCount(frameDuration, timeScale), kMaximumCCCount)), m_frameRate(FrameRateToCDPFrameRate(frameDuration, timeScale)), m_payloadSize(0)
 {
 
 }
@@ -211,7 +393,7 @@ void CaptionDistributionPacketEncoder::encode_ccdata(uint8_t*& buffer)
 		cc_type_708_start
 	};
 	
-	unsigned payloadPackets = static_cast<unsigned>(m_payload.size() / 2);
+	unsigned payloadPackets = m_payloadSize / 2;
 	unsigned padPackets = m_CCCount - payloadPackets;
 	
 	if (payloadPackets > m_CCCount)
@@ -223,7 +405,7 @@ void CaptionDistributionPacketEncoder::encode_ccdata(uint8_t*& buffer)
 	ccdata_header[1] |= m_CCCount & 0x1F;
 	buffer += 2;
 	
-	uint8_t* cc_data_x = m_payload.data();
+	const uint8_t* cc_data_x = m_payload;
 	for (unsigned i = 0; i < payloadPackets; ++i)
 	{
 		uint8_t* ccdata = buffer;
@@ -280,7 +462,7 @@ void CaptionDistributionPacketEncoder::encode_svcinfo(uint8_t*& buffer)
 	buffer += kServiceDataLength;
 }
 
-EncodedCaptionDistributionPacket CaptionDistributionPacketEncoder::encode()
+void CaptionDistributionPacketEncoder::encode()
 {
 	static const uint16_t	CDP_IDENTIFIER = 0x9669;
 	static const uint8_t	CDP_FOOTER_ID = 0x74;
@@ -293,14 +475,17 @@ EncodedCaptionDistributionPacket CaptionDistributionPacketEncoder::encode()
 	};
 	
 	if (m_frameRate == cdpFrameRate_Forbidden)
-		return EncodedCaptionDistributionPacket();
+		return;
 	
 	uint8_t cc_data_length = 2 + 3 * m_CCCount;
 	uint8_t cdp_length = kCDPHeaderLength + cc_data_length + kServiceInfoLength + kCDPFooterLength;
 	
-	EncodedCaptionDistributionPacket encoded;
-	encoded.resize(cdp_length);
-	uint8_t* buffer = encoded.data();
+	uint8_t* encoded = m_cdpRing.reserve();
+	if (encoded == NULL)
+		return;	// Ring is full, the CDP is dropped
+	
+	std::memset(encoded, 0, cdp_length);
+	uint8_t* buffer = encoded;
 	
 	enum cdp_flags
 	{
@@ -334,7 +519,7 @@ EncodedCaptionDistributionPacket CaptionDistributionPacketEncoder::encode()
 	cdp_footer[2] = (m_sequence & 0x00FF);
 	cdp_footer[3] = 0 /* checksum filled below */;
 	
-	for (unsigned i = 0; i < encoded.size()-1; ++i)
+	for (unsigned i = 0; i < cdp_length - 1u; ++i)
 		cdp_footer[3] += encoded[i];
 	cdp_footer[3] = cdp_footer[3] ? 256 - cdp_footer[3] : 0;
 	
@@ -342,37 +527,39 @@ EncodedCaptionDistributionPacket CaptionDistributionPacketEncoder::encode()
 	
 	++m_sequence;
 	
-	return encoded;
+	m_cdpRing.commit(cdp_length);
 }
 
 void CaptionDistributionPacketEncoder::reset()
 {
-	m_payload.clear();
+	m_payloadSize = 0;
 }
 
 void CaptionDistributionPacketEncoder::push(const uint8_t* packet, uint8_t packetLength)
 {
-	if (m_payload.size() + packetLength > maxPayloadSize())
+	if (m_payloadSize + packetLength > maxPayloadSize())
 	{
-		EncodedCaptionDistributionPacket packet = encode();
-		m_cdpQueue.push(packet);
+		encode();
 		reset();
 	}
 	
-	m_payload.insert(m_payload.end(), packet, packet + packetLength);
+	if (m_payloadSize + packetLength > maxPayloadSize())
+		return;	// caption channel packet cannot be larger than the cdp payload
+	
+	std::memcpy(m_payload + m_payloadSize, packet, packetLength);
+	m_payloadSize += packetLength;
 }
 
 void CaptionDistributionPacketEncoder::flush()
 {
-	EncodedCaptionDistributionPacket packet = encode();
-	m_cdpQueue.push(packet);
+	encode();
 	reset();
 }
 
 //=====================================================================
 
-Encoder::Encoder(int64_t frameDuration, int64_t timeScale)
-: m_cdpQueue(), m_cdpEncoder(m_cdpQueue, frameDuration, timeScale), m_packetEncoder(m_cdpEncoder), m_serviceBlockEncoder(m_packetEncoder, serviceNumber_PrimaryCaptionService)
+Encoder::Encoder(int64_t frameDuration, int64_t timeScale, uint32_t cdpCapacity)
+: m_cdpRing(cdpCapacity), m_cdpEncoder(m_cdpRing, frameDuration, timeScale), m_packetEncoder(m_cdpEncoder), m_serviceBlockEncoder(m_packetEncoder, serviceNumber_PrimaryCaptionService)
 {
 }
 
@@ -383,32 +570,60 @@ Encoder& Encoder::operator<<(const SyntacticElement& command)
 }
 Encoder& Encoder::operator<<(const char* captionText)
 {
-	size_t len = strlen(captionText);
-	for (size_t i = 0; i < len; ++i)
+	write(captionText, strlen(captionText));
+	return *this;
+}
+
+void Encoder::write(const char* captionText, std::size_t length)
+{
+	const uint8_t* text = reinterpret_cast<const uint8_t*>(captionText);
+	const uint8_t* end = text + length;
+	
+	while (text < end)
 	{
-		// captionText can only consist of characters in CEA-708's code space (7.1 Code Space Organization), which incorporates
-		// at least ASCII. For other locales an extended encoding scheme may be requried. How to achieve this is beyond the
-		// scope of this sample.
-		const uint8_t ch = captionText[i];
-		m_serviceBlockEncoder.push(&ch, 1);
+		// ASCII maps directly onto the C0 and G0 code sets, so runs of it are copied in bulk
+		const uint8_t* run = text;
+		while (text < end && *text < 0x80)
+			++text;
+		
+		if (text > run)
+			m_serviceBlockEncoder.pushCharacters(run, text - run);
+		
+		if (text == end)
+			break;
+		
+		uint32_t codePoint;
+		uint8_t code[2];
+		uint8_t codeLength;
+		
+		if (DecodeUTF8(text, end, codePoint))
+			codeLength = CodePointToCaptionCode(codePoint, code);
+		else
+		{
+			// Skip the remainder of the malformed sequence
+			while (text < end && (*text & 0xC0) == 0x80)
+				++text;
+			code[0] = '_';
+			codeLength = 1;
+		}
+		
+		m_serviceBlockEncoder.push(code, codeLength);
 	}
-	return *this;
 }
 
 bool Encoder::empty() const
 {
-	return m_cdpQueue.empty();
+	return m_cdpRing.empty();
 }
 
-bool Encoder::pop(EncodedCaptionDistributionPacket* packet)
+bool Encoder::pop(CDPView* packet)
 {
-	if (!m_cdpQueue.empty())
-	{
-		*packet = m_cdpQueue.front();
-		m_cdpQueue.pop();
-		return true;
-	}
-	return false;
+	return m_cdpRing.pop(packet);
+}
+
+uint64_t Encoder::overflowCount() const
+{
+	return m_cdpRing.overflowCount();
 }
 
 void Encoder::flush()
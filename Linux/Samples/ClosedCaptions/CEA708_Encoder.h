@@ -40,8 +40,9 @@
 
 #ifndef __CEA708_ENCODER_H__
 #define __CEA708_ENCODER_H__
-#include <queue>
-#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <memory>
 #include <stdint.h>
 #include "CEA708_Commands.h"
 
@@ -56,6 +57,10 @@ namespace CEA708
  * - channel packets are packed into caption distribution packets
  * - caption distribution packets are packed into ancillary data packets
  * - ancillary data packets are written into the luma channel of a vanc line
+ *
+ * The encoder stack does not allocate once constructed.  Each layer packs into a fixed-size
+ * buffer and completed CDPs are encoded directly into the preallocated slots of a CDPRing,
+ * from which they are handed out as CDPViews that can be attached to a frame without copying.
  */
 
 
@@ -73,13 +78,112 @@ enum CDPFrameRate
 	cdpFrameRate_60				// '0b1000'
 };
 
-typedef std::vector<uint8_t> EncodedCaptionDistributionPacket;
-typedef std::queue<EncodedCaptionDistributionPacket> CDPQueue;
+enum
+{
+	kMaxCDPSize = 255,			// SMPTE 334-2 5.2 cdp_length is an 8-bit field
+	kDefaultCDPCapacity = 16
+};
+
+class CDPRing;
 class ServiceBlockEncoder;
 class CaptionChannelPacketEncoder;
 class CaptionDistributionPacketEncoder;
 
 
+/* A read-only view of an encoded CDP held in a CDPRing slot.
+ * The slot is not reused until the view is released or destroyed, so the view can be attached to a
+ * frame and released when the frame no longer needs it.  A view is the only owner of its slot, so
+ * it can be moved but not copied.  release() may be called from any thread. */
+class CDPView
+{
+private:
+	friend class CDPRing;
+	
+	CDPRing*		m_ring;
+	uint32_t		m_slot;
+	const uint8_t*	m_data;
+	uint8_t			m_size;
+	
+public:
+	CDPView();
+	CDPView(CDPView&& other);
+	~CDPView();
+	
+	CDPView& operator=(CDPView&& other);
+	
+	CDPView(const CDPView&) = delete;
+	CDPView& operator=(const CDPView&) = delete;
+	
+	inline const uint8_t* data() const
+	{
+		return m_data;
+	}
+	
+	inline uint8_t size() const
+	{
+		return m_size;
+	}
+	
+	inline bool empty() const
+	{
+		return m_size == 0;
+	}
+	
+	// Return the slot to the ring, the view is empty afterwards
+	void release();
+};
+
+
+/* Fixed-capacity FIFO of encoded CDPs.
+ * Slots are preallocated when the ring is constructed.  A slot is reused once it has been popped
+ * and its view released; slots are reclaimed in order, so a view which is held for a long time
+ * stalls the ring rather than being overwritten.  When every slot is in use, new CDPs are dropped
+ * and counted in overflowCount().
+ * Writing and popping must happen on one thread, views may be released on any thread. */
+class CDPRing
+{
+private:
+	struct Slot
+	{
+		uint8_t				data[kMaxCDPSize];
+		uint8_t				size;
+		std::atomic<bool>	held;
+	};
+	
+	std::unique_ptr<Slot[]>	m_slots;
+	uint32_t				m_mask;
+	uint32_t				m_writeIndex;
+	uint32_t				m_readIndex;
+	uint32_t				m_reclaimIndex;
+	uint64_t				m_overflowCount;
+	
+	void reclaim();
+	
+public:
+	// Capacity is rounded up to a power of two
+	explicit CDPRing(uint32_t capacity);
+	
+	/* Return the buffer of the next free slot, of kMaxCDPSize bytes, or NULL if the ring is full.
+	 * The CDP is only queued when commit() is called. */
+	uint8_t* reserve();
+	void commit(uint8_t size);
+	
+	bool empty() const;
+	bool pop(CDPView* view);
+	void release(uint32_t slot);
+	
+	inline uint32_t capacity() const
+	{
+		return m_mask + 1;
+	}
+	
+	inline uint64_t overflowCount() const
+	{
+		return m_overflowCount;
+	}
+};
+
+
 // CEA-708 6 DTVCC Service Layer
 // Note: Extended Service Block Header not shown
 class ServiceBlockEncoder
@@ -107,6 +211,10 @@ public:
 	 * When full, updates header and pushes encoded service block to CaptionChannelPacketEncoder. */
 	void push(const uint8_t* buffer, uint8_t count);
 	
+	/* Add a run of single byte characters to the service block, filling each block before
+	 * pushing it to CaptionChannelPacketEncoder. */
+	void pushCharacters(const uint8_t* characters, std::size_t count);
+	
 	/* Updates header and pushes encoded service block to CaptionChannelPacketEncoder.
 	 * Flush cascades down the protocol stack.
 	 * Calling flush() on an empty service block will generate a pad packet containing the service description with no data */
@@ -151,21 +259,28 @@ public:
 class CaptionDistributionPacketEncoder
 {
 private:
-	CDPQueue&				m_cdpQueue;
+	enum
+	{
+		kMaximumCCCount = 0x1F	// cc_count is a 5-bit field
+	};
+	
+	CDPRing&				m_cdpRing;
 	uint16_t				m_sequence;
 	uint8_t					m_CCCount;
 	CDPFrameRate			m_frameRate;
-	std::vector<uint8_t>	m_payload;
+	uint8_t					m_payload[kMaximumCCCount * 2];
+	uint8_t					m_payloadSize;
 	
 	void encode_ccdata(uint8_t*& buffer);
 	void encode_svcinfo(uint8_t*& buffer);
 	
-	EncodedCaptionDistributionPacket encode();
+	// Encode the CDP into the next free slot of the CDPRing
+	void encode();
 	
 	void reset();
 	
 public:
-	CaptionDistributionPacketEncoder(CDPQueue& cdpQueue, int64_t frameDuration, int64_t timeScale);
+	CaptionDistributionPacketEncoder(CDPRing& cdpRing, int64_t frameDuration, int64_t timeScale);
 	
 	inline std::size_t maxPayloadSize() const
 	{
@@ -173,10 +288,10 @@ public:
 	}
 	
 	/* Add an encoded caption channel packet to the caption distribution packet.
-	 * When full, encodes the cdp and pushes the completed CDP onto the CDPQueue. */
+	 * When full, encodes the completed CDP into the CDPRing. */
 	void push(const uint8_t* packet, uint8_t packetLength);
 	
-	/* Encodes CDP and pushes the completed CDP onto the CDPQueue */
+	/* Encodes the CDP into the CDPRing */
 	void flush();
 };
 
@@ -186,23 +301,32 @@ public:
 class Encoder
 {
 private:
-	CDPQueue							m_cdpQueue;
+	CDPRing								m_cdpRing;
 	CaptionDistributionPacketEncoder	m_cdpEncoder;
 	CaptionChannelPacketEncoder			m_packetEncoder;
 	ServiceBlockEncoder					m_serviceBlockEncoder;
 	
 public:
-	Encoder(int64_t frameDuration, int64_t timeScale);
+	Encoder(int64_t frameDuration, int64_t timeScale, uint32_t cdpCapacity = kDefaultCDPCapacity);
 
 	// Push the given command / caption text into the encoder stack
 	Encoder& operator<<(const SyntacticElement& command);
 	Encoder& operator<<(const char* captionText);
 	
+	/* Push a block of UTF-8 caption text into the encoder stack.
+	 * ASCII is passed through unchanged, other characters are mapped to the G1 (Latin-1) and G2
+	 * code sets of CEA-708 7.1 Code Space Organization, characters outside those sets and
+	 * malformed sequences are replaced with an underscore. */
+	void write(const char* captionText, std::size_t length);
+	
 	// True if there are no fully-encoded packets in the queue.
 	bool empty() const;
 	
-	// Pop an encoded CDP from the queue
-	bool pop(EncodedCaptionDistributionPacket* packet);
+	// Pop a view of the next encoded CDP, which must be released when no longer needed
+	bool pop(CDPView* packet);
+	
+	// Number of CDPs dropped because every slot of the ring was in use
+	uint64_t overflowCount() const;
 	
 	// Flush any remaining data through the encoder stack.
 	// If there was no partial data a pad packet is generated.
@@ -0,0 +1,186 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2020 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#include "CaptionFileWriter.h"
+#include <cstring>
+#include <inttypes.h>
+
+namespace
+{
+	void FormatTimestamp(int64_t timeMs, char separator, char* buffer, std::size_t bufferSize)
+	{
+		if (timeMs < 0)
+			timeMs = 0;
+		
+		snprintf(buffer, bufferSize, "%02" PRId64 ":%02" PRId64 ":%02" PRId64 "%c%03" PRId64,
+				 timeMs / 3600000, (timeMs / 60000) % 60, (timeMs / 1000) % 60, separator, timeMs % 1000);
+	}
+}
+
+CaptionFileWriter::CaptionFileWriter(const std::string& filePrefix, const std::string& inputName, Format format)
+: m_filePrefix(filePrefix), m_inputName(inputName), m_format(format), m_lastTimeMs(0)
+{
+}
+
+CaptionFileWriter::~CaptionFileWriter()
+{
+	close(m_lastTimeMs);
+}
+
+void CaptionFileWriter::writeCue(unsigned service, ServiceCues& cues, int64_t endTimeMs)
+{
+	char startTime[16];
+	char endTime[16];
+	
+	if (cues.file == NULL)
+	{
+		std::string fileName = m_filePrefix + "-" + CEA708::GetCaptionServiceName(service) + (m_format == format_SRT ? ".srt" : ".vtt");
+		cues.file = fopen(fileName.c_str(), "w");
+		if (cues.file == NULL)
+		{
+			fprintf(stderr, "Could not open caption file %s\n", fileName.c_str());
+			return;
+		}
+		
+		if (m_format == format_WebVTT)
+			fprintf(cues.file, "WEBVTT\n\n");
+	}
+	
+	FormatTimestamp(cues.startTimeMs, m_format == format_SRT ? ',' : '.', startTime, sizeof(startTime));
+	FormatTimestamp(endTimeMs, m_format == format_SRT ? ',' : '.', endTime, sizeof(endTime));
+	
+	fprintf(cues.file, "%u\n%s --> %s\n", ++cues.cueCount, startTime, endTime);
+	
+	if (m_format == format_SRT)
+		fputs(cues.text.c_str(), cues.file);
+	else
+	{
+		// WebVTT cue text is markup, so escape the characters it reserves
+		for (const char* c = cues.text.c_str(); *c; ++c)
+		{
+			switch (*c)
+			{
+				case '&':	fputs("&amp;", cues.file);	break;
+				case '<':	fputs("&lt;", cues.file);	break;
+				case '>':	fputs("&gt;", cues.file);	break;
+				default:	fputc(*c, cues.file);		break;
+			}
+		}
+	}
+	
+	fputs("\n\n", cues.file);
+	fflush(cues.file);
+}
+
+void CaptionFileWriter::printChange(unsigned service, const CEA708::CaptionText& text, int64_t timeMs)
+{
+	char timestamp[16];
+	char line[CEA708::CaptionText::kMaxTextSize * 2];
+	std::size_t length = 0;
+	
+	FormatTimestamp(timeMs, '.', timestamp, sizeof(timestamp));
+	
+	// Print the caption on one line, with its rows separated by " / "
+	for (const char* c = text.c_str(); *c && length + 4 < sizeof(line); ++c)
+	{
+		if (*c == '\n')
+		{
+			memcpy(line + length, " / ", 3);
+			length += 3;
+		}
+		else
+			line[length++] = *c;
+	}
+	line[length] = '\0';
+	
+	printf("%s %-9s %s  %s\n", m_inputName.c_str(), CEA708::GetCaptionServiceName(service), timestamp, text.empty() ? "<clear>" : line);
+}
+
+void CaptionFileWriter::captionChanged(unsigned service, const CEA708::CaptionText& text, int64_t timeMs)
+{
+	m_lastTimeMs = timeMs;
+	
+	if (m_filePrefix.empty())
+	{
+		printChange(service, text, timeMs);
+		return;
+	}
+	
+	std::unique_ptr<ServiceCues>& cues = m_services[service];
+	if (!cues)
+	{
+		cues.reset(new ServiceCues());
+		cues->file = NULL;
+		cues->cueCount = 0;
+		cues->startTimeMs = 0;
+	}
+	
+	// The previous caption ends when its text is replaced or cleared
+	if (!cues->text.empty())
+		writeCue(service, *cues, timeMs);
+	
+	cues->text = text;
+	cues->startTimeMs = timeMs;
+}
+
+void CaptionFileWriter::close(int64_t timeMs)
+{
+	if (timeMs < m_lastTimeMs)
+		timeMs = m_lastTimeMs;
+	
+	for (unsigned service = 0; service < CEA708::kCaptionServiceCount; ++service)
+	{
+		std::unique_ptr<ServiceCues>& cues = m_services[service];
+		if (!cues)
+			continue;
+		
+		if (!cues->text.empty())
+		{
+			writeCue(service, *cues, timeMs);
+			cues->text.clear();
+		}
+		
+		if (cues->file)
+		{
+			fclose(cues->file);
+			cues->file = NULL;
+		}
+	}
+}
@@ -0,0 +1,90 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2020 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#ifndef __CAPTION_FILE_WRITER_H__
+#define __CAPTION_FILE_WRITER_H__
+#include <cstdio>
+#include <memory>
+#include <string>
+#include "CEA708_Decoder.h"
+
+/* Writes the decoded captions of one input as timed text, one SRT or WebVTT file per caption
+ * service named <prefix>-<service>.srt or .vtt.  A cue is written as soon as the text it shows
+ * is replaced or cleared, and the file is flushed, so files can be followed while capturing.
+ * Without a file prefix, each caption change is printed to stdout instead. */
+class CaptionFileWriter : public CEA708::CaptionListener
+{
+public:
+	enum Format
+	{
+		format_SRT = 0,
+		format_WebVTT
+	};
+	
+private:
+	struct ServiceCues
+	{
+		FILE*					file;
+		unsigned				cueCount;
+		int64_t					startTimeMs;
+		CEA708::CaptionText		text;
+	};
+	
+	std::string						m_filePrefix;
+	std::string						m_inputName;
+	Format							m_format;
+	int64_t							m_lastTimeMs;
+	std::unique_ptr<ServiceCues>	m_services[CEA708::kCaptionServiceCount];
+	
+	void writeCue(unsigned service, ServiceCues& cues, int64_t endTimeMs);
+	void printChange(unsigned service, const CEA708::CaptionText& text, int64_t timeMs);
+	
+public:
+	CaptionFileWriter(const std::string& filePrefix, const std::string& inputName, Format format);
+	virtual ~CaptionFileWriter();
+	
+	// CEA708::CaptionListener
+	void captionChanged(unsigned service, const CEA708::CaptionText& text, int64_t timeMs) override;
+	
+	// Write the cues still on screen, ending at the last caption change or timeMs if later, and close the files
+	void close(int64_t timeMs);
+};
+
+#endif
@@ -38,13 +38,28 @@
  ** -LICENSE-END-
  */
 #include "DeckLinkAPI.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <cstring>
 #include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
 
 // The DeckLinkAPI enables the insertion of arbitrary data into the vertical blanking of the SDI. This sample implements
 // basic encoding of caption data using the CEA 708 spec, before passing that data to the DeckLinkAPI. Other caption
 // encodings used by receiving equipment, or more advanced usage of CEA-708, are out of the scope of this sample.
+//
+// In capture mode the sample does the reverse, decoding the CEA-708 captions (and the CEA-608 captions they carry) from
+// the VANC of every input and writing the text of each caption service as it is displayed.
 #include "CEA708_Encoder.h"
+#include "CEA708_Decoder.h"
+#include "CaptionFileWriter.h"
 
 // Video mode parameters
 const BMDDisplayMode      kDisplayMode = bmdModeHD1080i50;
@@ -67,6 +82,10 @@ const uint32_t kBlueData[] = { 0x40aa298, 0x2a8a62a8, 0x298aa040, 0x2a8102a8 };
 const uint8_t kCaptionDistributionPacketDID = 0x61;
 const uint8_t kCaptionDistributionPacketSDID = 0x1;
 
+// Encoder benchmark parameters
+const int kBenchmarkChannelsPerThread = 16;
+const int kBenchmarkSeconds = 3;
+
 // Keep track of the number of scheduled frames
 uint32_t gTotalFramesScheduled = 0;
 
@@ -91,10 +110,14 @@ static void FillBlue(IDeckLinkMutableVideoFrame* theFrame)
 class CaptionAncillaryPacket: public IDeckLinkAncillaryPacket
 {
 public:
-	CaptionAncillaryPacket(const CEA708::EncodedCaptionDistributionPacket& userData)
+	// Takes ownership of the view, the CDP is not copied and its slot is released with the packet
+	CaptionAncillaryPacket(CEA708::CDPView&& userData)
+	: m_refCount(1), m_userData(std::move(userData))
+	{
+	}
+	
+	virtual ~CaptionAncillaryPacket()
 	{
-		m_refCount = 1;
-		m_userData = userData;
 	}
 	
 	// IDeckLinkAncillaryPacket
@@ -167,7 +190,7 @@ public:
 
 private:
 	int32_t m_refCount;
-	CEA708::EncodedCaptionDistributionPacket m_userData;
+	CEA708::CDPView m_userData;
 };
 
 class OutputCallback: public IDeckLinkVideoOutputCallback
@@ -192,7 +215,7 @@ public:
 		HRESULT										result = S_OK;
 		IDeckLinkVideoFrameAncillaryPackets*		frameAncillaryPackets = NULL;
 		IDeckLinkAncillaryPacket*					ancillaryPacket = NULL;
-		CEA708::EncodedCaptionDistributionPacket	packet;
+		CEA708::CDPView								packet;
 		
 		// Resend the given caption data every second.
 		unsigned fps = kTimeScale / kFrameDuration;
@@ -244,7 +267,12 @@ public:
 				ancillaryPacket = NULL;
 			}
 			
-			result = frameAncillaryPackets->AttachPacket(new CaptionAncillaryPacket(packet));
+			// The frame holds its own reference to the attached packet, which releases the CDP slot
+			// once the packet is detached when the frame is next scheduled
+			ancillaryPacket = new CaptionAncillaryPacket(std::move(packet));
+			result = frameAncillaryPackets->AttachPacket(ancillaryPacket);
+			ancillaryPacket->Release();
+			ancillaryPacket = NULL;
 			if (result != S_OK)
 			{
 				fprintf(stderr, "Could not attach packet = %08x\n", result);
@@ -317,6 +345,128 @@ public:
 	}
 };
 
+class CaptionInputCallback: public IDeckLinkInputCallback
+{
+private:
+	int32_t				m_refCount;
+	IDeckLinkInput*		m_deckLinkInput;
+	BMDVideoInputFlags	m_inputFlags;
+	CaptionFileWriter	m_captionWriter;
+	CEA708::Decoder		m_captionDecoder;
+	BMDTimeValue		m_lastFrameTime;
+	
+public:
+	CaptionInputCallback(IDeckLinkInput* deckLinkInput, BMDVideoInputFlags inputFlags, const std::string& filePrefix, const std::string& inputName, CaptionFileWriter::Format format)
+	: m_refCount(1), m_deckLinkInput(deckLinkInput), m_inputFlags(inputFlags), m_captionWriter(filePrefix, inputName, format), m_captionDecoder(m_captionWriter), m_lastFrameTime(0)
+	{
+		m_deckLinkInput->AddRef();
+	}
+	virtual ~CaptionInputCallback(void)
+	{
+		m_deckLinkInput->Release();
+	}
+	
+	HRESULT Start()
+	{
+		HRESULT result = m_deckLinkInput->SetCallback(this);
+		if (result != S_OK)
+			return result;
+		
+		result = m_deckLinkInput->EnableVideoInput(kDisplayMode, kPixelFormat, m_inputFlags);
+		if (result != S_OK)
+			return result;
+		
+		return m_deckLinkInput->StartStreams();
+	}
+	
+	void Stop()
+	{
+		m_deckLinkInput->StopStreams();
+		m_deckLinkInput->SetCallback(NULL);
+		m_deckLinkInput->DisableVideoInput();
+		m_captionWriter.close(m_lastFrameTime);
+	}
+	
+	const CEA708::DecoderStatistics& GetStatistics() const
+	{
+		return m_captionDecoder.statistics();
+	}
+	
+	HRESULT STDMETHODCALLTYPE VideoInputFormatChanged(BMDVideoInputFormatChangedEvents notificationEvents, IDeckLinkDisplayMode* newDisplayMode, BMDDetectedVideoInputFormatFlags)
+	{
+		if (!(notificationEvents & bmdVideoInputDisplayModeChanged))
+			return S_OK;
+		
+		// Restart capture in the detected mode, the captions do not depend on the pixel format
+		m_deckLinkInput->PauseStreams();
+		m_deckLinkInput->EnableVideoInput(newDisplayMode->GetDisplayMode(), kPixelFormat, m_inputFlags);
+		m_deckLinkInput->FlushStreams();
+		m_deckLinkInput->StartStreams();
+		
+		return S_OK;
+	}
+	
+	HRESULT STDMETHODCALLTYPE VideoInputFrameArrived(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkAudioInputPacket*)
+	{
+		IDeckLinkVideoFrameAncillaryPackets*	frameAncillaryPackets = NULL;
+		IDeckLinkAncillaryPacket*				ancillaryPacket = NULL;
+		const void*								cdp = NULL;
+		uint32_t								cdpSize = 0;
+		BMDTimeValue							frameDuration;
+		
+		if (videoFrame == NULL || (videoFrame->GetFlags() & bmdFrameHasNoInputSource))
+			return S_OK;
+		
+		// Caption times are in milliseconds from the start of capture
+		if (videoFrame->GetStreamTime(&m_lastFrameTime, &frameDuration, 1000) != S_OK)
+			return S_OK;
+		
+		if (videoFrame->QueryInterface(IID_IDeckLinkVideoFrameAncillaryPackets, (void**)&frameAncillaryPackets) == S_OK)
+		{
+			if (frameAncillaryPackets->GetFirstPacketByID(kCaptionDistributionPacketDID, kCaptionDistributionPacketSDID, &ancillaryPacket) == S_OK)
+			{
+				if (ancillaryPacket->GetBytes(bmdAncillaryPacketFormatUInt8, &cdp, &cdpSize) != S_OK)
+					cdp = NULL;
+			}
+		}
+		
+		// The packet data is decoded in place, and remains valid while the packet is referenced
+		m_captionDecoder.decode(static_cast<const uint8_t*>(cdp), cdpSize, m_lastFrameTime);
+		
+		if (ancillaryPacket != NULL)
+			ancillaryPacket->Release();
+		
+		if (frameAncillaryPackets != NULL)
+			frameAncillaryPackets->Release();
+		
+		return S_OK;
+	}
+	
+	// IUnknown
+	HRESULT	STDMETHODCALLTYPE QueryInterface (REFIID iid, LPVOID *ppv)
+	{
+		*ppv = NULL;
+		return E_NOINTERFACE;
+	}
+	
+	ULONG STDMETHODCALLTYPE AddRef()
+	{
+		// gcc atomic operation builtin
+		return __sync_add_and_fetch(&m_refCount, 1);
+	}
+	
+	ULONG STDMETHODCALLTYPE Release()
+	{
+		// gcc atomic operation builtin
+		int32_t newRefValue = __sync_sub_and_fetch(&m_refCount, 1);
+		
+		if (newRefValue == 0)
+			delete this;
+		
+		return newRefValue;
+	}
+};
+
 static IDeckLinkMutableVideoFrame* CreateFrame(IDeckLinkOutput* deckLinkOutput)
 {
 	HRESULT                         result;
@@ -336,6 +486,87 @@ bail:
 	return frame;
 }
 
+static double GetThreadCPUSeconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Encode a caption on every frame for a set of channels, popping and releasing each CDP as a
+// frame would.  Returns the number of CDPs encoded and the CPU time used.
+static void BenchmarkEncoder(const std::atomic<bool>& running, uint64_t& cdpCount, double& cpuSeconds)
+{
+	using namespace CEA708;
+	
+	static const char kCaptionText[] = "CEA-708 Closed Captions \xE2\x80\x94 caf\xC3\xA9 \xE2\x99\xAA";
+	
+	std::vector<std::unique_ptr<Encoder>> encoders;
+	for (int i = 0; i < kBenchmarkChannelsPerThread; i++)
+		encoders.emplace_back(new Encoder(kFrameDuration, kTimeScale));
+	
+	CDPView packet;
+	uint64_t checksum = 0;
+	double startCPUSeconds = GetThreadCPUSeconds();
+	
+	cdpCount = 0;
+	
+	while (running)
+	{
+		for (auto& encoder : encoders)
+		{
+			Encoder& cc = *encoder;
+			
+			cc << SetCurrentWindow(window_0) << SetPenLocation(0, 0);
+			cc.write(kCaptionText, sizeof(kCaptionText) - 1);
+			cc << DisplayWindows(1 << window_0);
+			cc.flush();
+			
+			while (cc.pop(&packet))
+			{
+				checksum += packet.data()[packet.size() - 1];
+				packet.release();
+				cdpCount++;
+			}
+		}
+	}
+	
+	cpuSeconds = GetThreadCPUSeconds() - startCPUSeconds;
+	
+	if (checksum == 0)
+		fprintf(stderr, "Encoder benchmark produced no data\n");
+}
+
+static int RunEncoderBenchmark(int threadCount)
+{
+	std::atomic<bool>		running(true);
+	std::vector<std::thread>	threads;
+	std::vector<uint64_t>		cdpCounts(threadCount);
+	std::vector<double>			cpuSeconds(threadCount);
+	uint64_t				totalCDPs = 0;
+	double					totalCPUSeconds = 0.0;
+	
+	printf("Encoding captions on %d channels per thread with %d threads for %d seconds...\n", kBenchmarkChannelsPerThread, threadCount, kBenchmarkSeconds);
+	
+	for (int i = 0; i < threadCount; i++)
+		threads.emplace_back(BenchmarkEncoder, std::cref(running), std::ref(cdpCounts[i]), std::ref(cpuSeconds[i]));
+	
+	sleep(kBenchmarkSeconds);
+	running = false;
+	
+	for (int i = 0; i < threadCount; i++)
+	{
+		threads[i].join();
+		printf("Thread %2d: %10llu CDPs, %.0f CDPs/sec per core\n", i, (unsigned long long)cdpCounts[i], cdpCounts[i] / cpuSeconds[i]);
+		totalCDPs += cdpCounts[i];
+		totalCPUSeconds += cpuSeconds[i];
+	}
+	
+	printf("Total:     %10llu CDPs, %.0f CDPs/sec, %.0f CDPs/sec per core\n", (unsigned long long)totalCDPs, (double)totalCDPs / kBenchmarkSeconds, totalCDPs / totalCPUSeconds);
+	
+	return 0;
+}
+
 HRESULT GetDeckLinkIterator(IDeckLinkIterator **deckLinkIterator)
 {
 	HRESULT result = S_OK;
@@ -351,13 +582,162 @@ HRESULT GetDeckLinkIterator(IDeckLinkIterator **deckLinkIterator)
 	return result;
 }
 
-int main()
+// Start decoding captions on every DeckLink device with an input
+static void StartCaptionCapture(const std::string& filePrefix, CaptionFileWriter::Format format, std::vector<CaptionInputCallback*>& inputCallbacks)
+{
+	IDeckLinkIterator*	deckLinkIterator = NULL;
+	IDeckLink*			deckLink = NULL;
+	int					deckLinkIndex = 0;
+	
+	if (GetDeckLinkIterator(&deckLinkIterator) != S_OK)
+		return;
+	
+	while (deckLinkIterator->Next(&deckLink) == S_OK)
+	{
+		IDeckLinkInput*				deckLinkInput = NULL;
+		IDeckLinkProfileAttributes*	deckLinkAttributes = NULL;
+		bool						formatDetectionSupported = false;
+		
+		if (deckLink->QueryInterface(IID_IDeckLinkProfileAttributes, (void**)&deckLinkAttributes) == S_OK)
+		{
+			if (deckLinkAttributes->GetFlag(BMDDeckLinkSupportsInputFormatDetection, &formatDetectionSupported) != S_OK)
+				formatDetectionSupported = false;
+			deckLinkAttributes->Release();
+		}
+		
+		if (deckLink->QueryInterface(IID_IDeckLinkInput, (void**)&deckLinkInput) == S_OK)
+		{
+			std::string				inputName = "Input " + std::to_string(deckLinkIndex);
+			std::string				inputFilePrefix = filePrefix.empty() ? filePrefix : filePrefix + "-" + std::to_string(deckLinkIndex);
+			BMDVideoInputFlags		inputFlags = formatDetectionSupported ? bmdVideoInputEnableFormatDetection : bmdVideoInputFlagDefault;
+			CaptionInputCallback*	inputCallback = new CaptionInputCallback(deckLinkInput, inputFlags, inputFilePrefix, inputName, format);
+			HRESULT					result = inputCallback->Start();
+			
+			if (result == S_OK)
+				inputCallbacks.push_back(inputCallback);
+			else
+			{
+				fprintf(stderr, "Could not start capture on %s - result = %08x\n", inputName.c_str(), result);
+				inputCallback->Stop();
+				inputCallback->Release();
+			}
+			
+			deckLinkInput->Release();
+		}
+		
+		deckLink->Release();
+		deckLinkIndex++;
+	}
+	
+	deckLinkIterator->Release();
+}
+
+static void StopCaptionCapture(std::vector<CaptionInputCallback*>& inputCallbacks)
+{
+	for (size_t i = 0; i < inputCallbacks.size(); i++)
+	{
+		inputCallbacks[i]->Stop();
+		
+		const CEA708::DecoderStatistics& statistics = inputCallbacks[i]->GetStatistics();
+		printf("Input %zu: %llu CDPs, %llu CDP errors, %llu CDP discontinuities, %llu repeated CDPs, %llu caption packets, %llu packet errors, %llu packet discontinuities, %llu CEA-608 parity errors\n",
+			   i, (unsigned long long)statistics.cdpCount, (unsigned long long)statistics.cdpErrors, (unsigned long long)statistics.cdpDiscontinuities, (unsigned long long)statistics.cdpRepeats,
+			   (unsigned long long)statistics.packetCount, (unsigned long long)statistics.packetErrors, (unsigned long long)statistics.packetDiscontinuities,
+			   (unsigned long long)statistics.cea608ParityErrors);
+		
+		inputCallbacks[i]->Release();
+	}
+	inputCallbacks.clear();
+}
+
+static void PrintUsage(const char* program)
+{
+	fprintf(stderr, "Usage: %s [-c [-p] [-o <prefix>] [-f srt|vtt]] [-b [-t <threads>]]\n", program);
+	fprintf(stderr, "    -c          Decode captions from every input instead of playing captions\n");
+	fprintf(stderr, "    -p          Also play captions on the first device while decoding\n");
+	fprintf(stderr, "    -o <prefix> Write each caption service to <prefix>-<input>-<service>.srt/.vtt (default: print to stdout)\n");
+	fprintf(stderr, "    -f <format> Caption file format, srt or vtt (default: srt)\n");
+	fprintf(stderr, "    -b          Benchmark the CEA-708 encoder instead of playing captions\n");
+	fprintf(stderr, "    -t <n>      Number of benchmark threads (default: one per core)\n");
+}
+
+int main(int argc, char* argv[])
 {
 	IDeckLinkIterator*      deckLinkIterator = NULL;
 	IDeckLink*              deckLink         = NULL;
 	IDeckLinkOutput*        deckLinkOutput   = NULL;
 	OutputCallback*         outputCallback   = NULL;
 	HRESULT                 result;
+	bool                    benchmark        = false;
+	int                     benchmarkThreads = std::max(1u, std::thread::hardware_concurrency());
+	bool                    capture          = false;
+	bool                    playback         = false;
+	std::string             captionFilePrefix;
+	CaptionFileWriter::Format captionFormat  = CaptionFileWriter::format_SRT;
+	std::vector<CaptionInputCallback*> inputCallbacks;
+	int                     ch;
+	
+	while ((ch = getopt(argc, argv, "bcf:o:pt:h")) != -1)
+	{
+		switch (ch)
+		{
+			case 'c':
+				capture = true;
+				break;
+			case 'p':
+				playback = true;
+				break;
+			case 'o':
+				captionFilePrefix = optarg;
+				break;
+			case 'f':
+				if (strcmp(optarg, "srt") == 0)
+					captionFormat = CaptionFileWriter::format_SRT;
+				else if (strcmp(optarg, "vtt") == 0)
+					captionFormat = CaptionFileWriter::format_WebVTT;
+				else
+				{
+					fprintf(stderr, "Invalid caption file format %s\n", optarg);
+					return 1;
+				}
+				break;
+			case 'b':
+				benchmark = true;
+				break;
+			case 't':
+				benchmarkThreads = atoi(optarg);
+				if (benchmarkThreads < 1)
+				{
+					fprintf(stderr, "Invalid number of benchmark threads\n");
+					return 1;
+				}
+				break;
+			default:
+				PrintUsage(argv[0]);
+				return 1;
+		}
+	}
+	
+	if (benchmark)
+		return RunEncoderBenchmark(benchmarkThreads);
+	
+	if (capture)
+	{
+		StartCaptionCapture(captionFilePrefix, captionFormat, inputCallbacks);
+		if (inputCallbacks.empty())
+		{
+			fprintf(stderr, "Could not start capture on any DeckLink input\n");
+			return 1;
+		}
+		
+		if (!playback)
+		{
+			printf("Decoding captions from %zu inputs... Press <RETURN> to exit\n", inputCallbacks.size());
+			getchar();
+			printf("Exiting.\n");
+			StopCaptionCapture(inputCallbacks);
+			return 0;
+		}
+	}
 	
 	// Create an IDeckLinkIterator object to enumerate all DeckLink cards in the system
 	result = GetDeckLinkIterator(&deckLinkIterator);
@@ -453,6 +833,9 @@ int main()
 	// Release resources
 bail:
 	
+	// Stop decoding captions, when capturing while playing
+	StopCaptionCapture(inputCallbacks);
+	
 	// Release the video output interface
 	if (deckLinkOutput != NULL)
 	{
@@ -0,0 +1,369 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+
+#include <algorithm>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "DeviceCapabilityCache.h"
+
+static const uint32_t kCacheFileMagic = 0x43434c44;		// "DLCC"
+static const uint32_t kCacheFileFormatVersion = 1;
+
+static_assert(sizeof(DeviceCapabilityCache::Record) == 32, "Cache file record layout");
+
+static std::string GetCacheDirectory(void)
+{
+	const char* directory = getenv("DECKLINK_CAPABILITY_CACHE_DIR");
+	if (directory && *directory)
+		return directory;
+
+	std::string cacheDirectory;
+	const char* xdgCacheHome = getenv("XDG_CACHE_HOME");
+	const char* home = getenv("HOME");
+
+	if (xdgCacheHome && *xdgCacheHome)
+		cacheDirectory = xdgCacheHome;
+	else if (home && *home)
+		cacheDirectory = std::string(home) + "/.cache";
+	else
+		return std::string();
+
+	mkdir(cacheDirectory.c_str(), 0755);
+	return cacheDirectory + "/decklink";
+}
+
+bool DeviceCapabilityCache::Key::operator<(const Key& other) const
+{
+	if (direction != other.direction)
+		return direction < other.direction;
+	if (connection != other.connection)
+		return connection < other.connection;
+	if (requestedMode != other.requestedMode)
+		return requestedMode < other.requestedMode;
+	if (pixelFormat != other.pixelFormat)
+		return pixelFormat < other.pixelFormat;
+	if (conversionMode != other.conversionMode)
+		return conversionMode < other.conversionMode;
+	return flags < other.flags;
+}
+
+DeviceCapabilityCache::DeviceCapabilityCache(IDeckLink* deckLink) :
+	m_deckLink(deckLink),
+	m_deckLinkOutput(NULL),
+	m_deckLinkInput(NULL),
+	m_apiVersion(0),
+	m_persistentID(0),
+	m_profileID(0),
+	m_mapping(NULL),
+	m_mappingSize(0),
+	m_records(NULL),
+	m_recordCount(0),
+	m_hitCount(0),
+	m_missCount(0)
+{
+	m_deckLink->AddRef();
+
+	ReadDeviceIdentity();
+	Load();
+}
+
+DeviceCapabilityCache::~DeviceCapabilityCache()
+{
+	Save();
+	Unload();
+
+	if (m_deckLinkOutput)
+		m_deckLinkOutput->Release();
+
+	if (m_deckLinkInput)
+		m_deckLinkInput->Release();
+
+	m_deckLink->Release();
+}
+
+void DeviceCapabilityCache::ReadDeviceIdentity(void)
+{
+	IDeckLinkAPIInformation*	deckLinkAPIInformation = CreateDeckLinkAPIInformationInstance();
+	IDeckLinkProfileAttributes*	deckLinkAttributes = NULL;
+	bool						identified = false;
+
+	m_path.clear();
+
+	if (deckLinkAPIInformation)
+	{
+		if (deckLinkAPIInformation->GetInt(BMDDeckLinkAPIVersion, &m_apiVersion) != S_OK)
+			m_apiVersion = 0;
+		deckLinkAPIInformation->Release();
+	}
+
+	if (m_deckLink->QueryInterface(IID_IDeckLinkProfileAttributes, (void**)&deckLinkAttributes) == S_OK)
+	{
+		// Without a persistent ID the device can't be recognised on the next start
+		identified = deckLinkAttributes->GetInt(BMDDeckLinkPersistentID, &m_persistentID) == S_OK;
+
+		if (deckLinkAttributes->GetInt(BMDDeckLinkProfileID, &m_profileID) != S_OK)
+			m_profileID = 0;
+
+		deckLinkAttributes->Release();
+	}
+
+	if (!identified)
+		return;
+
+	std::string directory = GetCacheDirectory();
+	if (directory.empty())
+		return;
+
+	if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+		return;
+
+	char fileName[64];
+	snprintf(fileName, sizeof(fileName), "/capabilities-%016llx.bin", (unsigned long long)m_persistentID);
+	m_path = directory + fileName;
+}
+
+void DeviceCapabilityCache::Load(void)
+{
+	struct stat		fileStat;
+	int				fd;
+
+	if (m_path.empty())
+		return;
+
+	fd = open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	if (fstat(fd, &fileStat) == 0 && (size_t)fileStat.st_size >= sizeof(FileHeader))
+	{
+		m_mappingSize = (size_t)fileStat.st_size;
+		m_mapping = mmap(NULL, m_mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+		if (m_mapping == MAP_FAILED)
+			m_mapping = NULL;
+	}
+
+	close(fd);
+
+	if (m_mapping == NULL)
+		return;
+
+	// A file written for another driver version or profile is ignored, and replaced by Save
+	const FileHeader* header = (const FileHeader*)m_mapping;
+	if (header->magic != kCacheFileMagic ||
+		header->formatVersion != kCacheFileFormatVersion ||
+		header->apiVersion != m_apiVersion ||
+		header->persistentID != m_persistentID ||
+		header->profileID != m_profileID ||
+		header->recordSize != sizeof(Record) ||
+		m_mappingSize != sizeof(FileHeader) + (size_t)header->recordCount * sizeof(Record))
+	{
+		Unload();
+		return;
+	}
+
+	m_records = (const Record*)(header + 1);
+	m_recordCount = header->recordCount;
+}
+
+void DeviceCapabilityCache::Unload(void)
+{
+	if (m_mapping)
+		munmap(m_mapping, m_mappingSize);
+
+	m_mapping = NULL;
+	m_mappingSize = 0;
+	m_records = NULL;
+	m_recordCount = 0;
+}
+
+HRESULT DeviceCapabilityCache::QueryDevice(const Key& key, BMDDisplayMode* actualMode, bool* supported)
+{
+	if (key.direction == kDeviceCapabilityOutput)
+	{
+		if (!m_deckLinkOutput && m_deckLink->QueryInterface(IID_IDeckLinkOutput, (void**)&m_deckLinkOutput) != S_OK)
+			return E_NOINTERFACE;
+
+		return m_deckLinkOutput->DoesSupportVideoMode((BMDVideoConnection)key.connection, (BMDDisplayMode)key.requestedMode,
+													  (BMDPixelFormat)key.pixelFormat, (BMDVideoOutputConversionMode)key.conversionMode,
+													  (BMDSupportedVideoModeFlags)key.flags, actualMode, supported);
+	}
+	else
+	{
+		if (!m_deckLinkInput && m_deckLink->QueryInterface(IID_IDeckLinkInput, (void**)&m_deckLinkInput) != S_OK)
+			return E_NOINTERFACE;
+
+		return m_deckLinkInput->DoesSupportVideoMode((BMDVideoConnection)key.connection, (BMDDisplayMode)key.requestedMode,
+													 (BMDPixelFormat)key.pixelFormat, (BMDVideoInputConversionMode)key.conversionMode,
+													 (BMDSupportedVideoModeFlags)key.flags, actualMode, supported);
+	}
+}
+
+HRESULT DeviceCapabilityCache::DoesSupportVideoMode(DeviceCapabilityDirection direction, BMDVideoConnection connection,
+													BMDDisplayMode requestedMode, BMDPixelFormat pixelFormat, uint32_t conversionMode,
+													BMDSupportedVideoModeFlags flags, BMDDisplayMode* actualMode, bool* supported)
+{
+	std::lock_guard<std::mutex>	lock(m_mutex);
+	const Record*				record = NULL;
+	Key							key = { direction, connection, requestedMode, pixelFormat, conversionMode, flags };
+
+	if (supported == NULL)
+		return E_POINTER;
+
+	const Record* end = m_records + m_recordCount;
+	const Record* found = std::lower_bound(m_records, end, key, [](const Record& r, const Key& k) { return r.key < k; });
+	if (found != end && !(key < found->key))
+		record = found;
+
+	if (record == NULL)
+	{
+		auto newRecord = m_newRecords.find(key);
+		if (newRecord != m_newRecords.end())
+			record = &newRecord->second;
+	}
+
+	if (record)
+	{
+		m_hitCount++;
+		*supported = record->supported != 0;
+		if (actualMode)
+			*actualMode = (BMDDisplayMode)record->actualMode;
+		return S_OK;
+	}
+
+	m_missCount++;
+
+	BMDDisplayMode	queriedMode = bmdModeUnknown;
+	bool			querySupported = false;
+	HRESULT			result = QueryDevice(key, &queriedMode, &querySupported);
+
+	// Failed queries are not cached, they may succeed later
+	if (result != S_OK)
+		return result;
+
+	m_newRecords[key] = { key, (uint32_t)queriedMode, querySupported ? 1u : 0u };
+
+	*supported = querySupported;
+	if (actualMode)
+		*actualMode = queriedMode;
+
+	return S_OK;
+}
+
+bool DeviceCapabilityCache::Save(void)
+{
+	std::lock_guard<std::mutex>	lock(m_mutex);
+	std::vector<Record>			records;
+	FileHeader					header;
+	bool						written;
+	int							fd;
+
+	if (m_path.empty() || m_newRecords.empty())
+		return true;
+
+	// Both sets of records are sorted, merge them into the new file
+	records.reserve(m_recordCount + m_newRecords.size());
+
+	const Record* mapped = m_records;
+	const Record* mappedEnd = m_records + m_recordCount;
+
+	for (const auto& newRecord : m_newRecords)
+	{
+		while (mapped != mappedEnd && mapped->key < newRecord.first)
+			records.push_back(*mapped++);
+
+		records.push_back(newRecord.second);
+	}
+
+	records.insert(records.end(), mapped, mappedEnd);
+
+	memset(&header, 0, sizeof(header));
+	header.magic = kCacheFileMagic;
+	header.formatVersion = kCacheFileFormatVersion;
+	header.apiVersion = m_apiVersion;
+	header.persistentID = m_persistentID;
+	header.profileID = m_profileID;
+	header.recordSize = sizeof(Record);
+	header.recordCount = (uint32_t)records.size();
+
+	// Write a temporary file and rename it, so other processes see the old or new file complete
+	std::string temporaryPath = m_path + "." + std::to_string(getpid());
+
+	fd = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return false;
+
+	written = write(fd, &header, sizeof(header)) == (ssize_t)sizeof(header) &&
+			  write(fd, records.data(), records.size() * sizeof(Record)) == (ssize_t)(records.size() * sizeof(Record));
+
+	if (close(fd) != 0)
+		written = false;
+
+	if (!written || rename(temporaryPath.c_str(), m_path.c_str()) != 0)
+	{
+		unlink(temporaryPath.c_str());
+		return false;
+	}
+
+	// Serve the merged records from the new file
+	Unload();
+	m_newRecords.clear();
+	Load();
+
+	return true;
+}
+
+void DeviceCapabilityCache::Invalidate(void)
+{
+	std::lock_guard<std::mutex>	lock(m_mutex);
+
+	Unload();
+	m_newRecords.clear();
+
+	ReadDeviceIdentity();
+	Load();
+}
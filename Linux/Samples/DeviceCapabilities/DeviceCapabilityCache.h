@@ -0,0 +1,152 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include "DeckLinkAPI.h"
+
+// Persistent cache of DoesSupportVideoMode results.  Listing the modes of a device queries the
+// driver for every combination of connection, display mode, pixel format and conversion, which
+// is slow with many devices.  The results are saved to a file per device, keyed by the device's
+// BMDDeckLinkPersistentID, and reused on the next start while the DeckLink API version and the
+// active profile of the device are unchanged.
+//
+// The file is a header followed by an array of fixed size records sorted by query, mapped
+// read-only and searched in place, so loading the cache does not parse or copy it.  Queries not
+// in the file are passed to the driver and added to the file by Save, which replaces the file
+// atomically.  Devices without a persistent ID are cached in memory only.
+//
+// Files are written to $DECKLINK_CAPABILITY_CACHE_DIR, $XDG_CACHE_HOME/decklink or
+// $HOME/.cache/decklink.  The results depend on the active profile, so call Invalidate from
+// IDeckLinkProfileCallback::ProfileActivated.
+
+enum DeviceCapabilityDirection : uint8_t
+{
+	kDeviceCapabilityOutput = 0,
+	kDeviceCapabilityInput = 1
+};
+
+class DeviceCapabilityCache
+{
+public:
+	DeviceCapabilityCache(IDeckLink* deckLink);
+	~DeviceCapabilityCache();
+
+	DeviceCapabilityCache(const DeviceCapabilityCache&) = delete;
+	DeviceCapabilityCache& operator=(const DeviceCapabilityCache&) = delete;
+
+	// As IDeckLinkOutput::DoesSupportVideoMode and IDeckLinkInput::DoesSupportVideoMode, where
+	// conversionMode is a BMDVideoOutputConversionMode or BMDVideoInputConversionMode and
+	// actualMode may be NULL
+	HRESULT				DoesSupportVideoMode(DeviceCapabilityDirection direction, BMDVideoConnection connection,
+											 BMDDisplayMode requestedMode, BMDPixelFormat pixelFormat, uint32_t conversionMode,
+											 BMDSupportedVideoModeFlags flags, BMDDisplayMode* actualMode, bool* supported);
+
+	// Write new results to the cache file, also called on destruction
+	bool				Save(void);
+
+	// Discard the results and reload the cache for the device's current profile
+	void				Invalidate(void);
+
+	bool				IsPersistent(void) const { return !m_path.empty(); }
+	uint64_t			GetHitCount(void) const { return m_hitCount; }
+	uint64_t			GetMissCount(void) const { return m_missCount; }
+
+	struct Key
+	{
+		uint32_t		direction;
+		uint32_t		connection;
+		uint32_t		requestedMode;
+		uint32_t		pixelFormat;
+		uint32_t		conversionMode;
+		uint32_t		flags;
+
+		bool operator<(const Key& other) const;
+	};
+
+	struct Record
+	{
+		Key				key;
+		uint32_t		actualMode;
+		uint32_t		supported;
+	};
+
+private:
+	struct FileHeader
+	{
+		uint32_t		magic;
+		uint32_t		formatVersion;
+		int64_t			apiVersion;
+		int64_t			persistentID;
+		int64_t			profileID;
+		uint32_t		recordSize;
+		uint32_t		recordCount;
+	};
+
+	void				ReadDeviceIdentity(void);
+	void				Load(void);
+	void				Unload(void);
+	HRESULT				QueryDevice(const Key& key, BMDDisplayMode* actualMode, bool* supported);
+
+	std::mutex					m_mutex;
+	IDeckLink*					m_deckLink;
+	IDeckLinkOutput*			m_deckLinkOutput;
+	IDeckLinkInput*				m_deckLinkInput;
+
+	int64_t						m_apiVersion;
+	int64_t						m_persistentID;
+	int64_t						m_profileID;
+	std::string					m_path;
+
+	// Records mapped from the cache file, and results queried since it was loaded
+	void*						m_mapping;
+	size_t						m_mappingSize;
+	const Record*				m_records;
+	uint32_t					m_recordCount;
+	std::map<Key, Record>		m_newRecords;
+
+	uint64_t					m_hitCount;
+	uint64_t					m_missCount;
+};
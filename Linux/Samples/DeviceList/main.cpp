@@ -43,6 +43,7 @@
 #include <map>
 #include <string>
 #include "platform.h"
+#include "DeviceCapabilityCache.h"
 
 #define kMaxHeaderLength 128
 
@@ -124,12 +125,12 @@ enum PrintFlags : uint32_t
 void	parse_arguments(int argc, char** argv, uint32_t& printFlags);
 void	print_attributes (IDeckLink* deckLink, bool showConnectorAttributes);
 void	mode_name(IDeckLinkDisplayMode *displayMode, std::string& modeName);
-void	print_output_mode(IDeckLinkOutput* deckLinkOutput, BMDVideoConnection connection, BMDVideoOutputConversionMode conversion, BMDSupportedVideoModeFlags flags, IDeckLinkDisplayMode *displayMode, const char*& header);
-void	print_output_modes_for_setup (IDeckLinkOutput* deckLinkOutput, BMDVideoConnection connection, BMDVideoOutputConversionMode conversion, BMDSupportedVideoModeFlags flags, const char* header);
-void	print_output_modes (IDeckLink* deckLink, uint32_t printFlags);
-void	print_input_mode(IDeckLinkInput* deckLinkInput, BMDVideoConnection connection, BMDVideoInputConversionMode conversion, BMDSupportedVideoModeFlags flags, IDeckLinkDisplayMode* displayMode, const char* nameSuffix, const char*& header);
-void	print_input_modes_for_setup (IDeckLinkInput* deckLinkInput, BMDVideoConnection connection, BMDVideoInputConversionMode conversion, BMDSupportedVideoModeFlags flags, const char* nameSuffix, const char* header);
-void	print_input_modes (IDeckLink* deckLink, uint32_t printFlags);
+void	print_output_mode(IDeckLinkOutput* deckLinkOutput, DeviceCapabilityCache& capabilities, BMDVideoConnection connection, BMDVideoOutputConversionMode conversion, BMDSupportedVideoModeFlags flags, IDeckLinkDisplayMode *displayMode, const char*& header);
+void	print_output_modes_for_setup (IDeckLinkOutput* deckLinkOutput, DeviceCapabilityCache& capabilities, BMDVideoConnection connection, BMDVideoOutputConversionMode conversion, BMDSupportedVideoModeFlags flags, const char* header);
+void	print_output_modes (IDeckLink* deckLink, DeviceCapabilityCache& capabilities, uint32_t printFlags);
+void	print_input_mode(IDeckLinkInput* deckLinkInput, DeviceCapabilityCache& capabilities, BMDVideoConnection connection, BMDVideoInputConversionMode conversion, BMDSupportedVideoModeFlags flags, IDeckLinkDisplayMode* displayMode, const char* nameSuffix, const char*& header);
+void	print_input_modes_for_setup (IDeckLinkInput* deckLinkInput, DeviceCapabilityCache& capabilities, BMDVideoConnection connection, BMDVideoInputConversionMode conversion, BMDSupportedVideoModeFlags flags, const char* nameSuffix, const char* header);
+void	print_input_modes (IDeckLink* deckLink, DeviceCapabilityCache& capabilities, uint32_t printFlags);
 
 
 int		main (int argc, char** argv)
@@ -220,16 +221,19 @@ int		main (int argc, char** argv)
 		
 		if (showIOinfo)
 		{
+			// Mode support is read from the capability cache when DeviceList was run before on this device and profile
+			DeviceCapabilityCache capabilities(deckLink);
+
 			if (videoIOSupport & bmdDeviceSupportsPlayback)
 			{
 				// ** List the video output display modes supported by the card
-				print_output_modes(deckLink, printFlags);
+				print_output_modes(deckLink, capabilities, printFlags);
 			}
 
 			if (videoIOSupport & bmdDeviceSupportsCapture)
 			{
 				// ** List the video input display modes supported by the card
-				print_input_modes(deckLink, printFlags);
+				print_input_modes(deckLink, capabilities, printFlags);
 			}			
 		}
 		
@@ -466,7 +470,7 @@ void mode_name(IDeckLinkDisplayMode *displayMode, std::string& modeName)
 	DeleteString(displayModeString);
 }
 
-void print_output_mode(IDeckLinkOutput* deckLinkOutput, BMDVideoConnection connection, BMDVideoOutputConversionMode conversion, BMDSupportedVideoModeFlags flags, IDeckLinkDisplayMode *displayMode, const char*& header)
+void print_output_mode(IDeckLinkOutput* deckLinkOutput, DeviceCapabilityCache& capabilities, BMDVideoConnection connection, BMDVideoOutputConversionMode conversion, BMDSupportedVideoModeFlags flags, IDeckLinkDisplayMode *displayMode, const char*& header)
 {
 	std::string				modeName;
 	int						modeWidth;
@@ -484,7 +488,7 @@ void print_output_mode(IDeckLinkOutput* deckLinkOutput, BMDVideoConnection conne
 		dlbool_t supported;
 		BMDDisplayMode retMode;
 
-		if (deckLinkOutput->DoesSupportVideoMode(connection, requestedMode, pixelFormat.first, conversion, flags, &retMode, &supported) == S_OK && supported)
+		if (capabilities.DoesSupportVideoMode(kDeviceCapabilityOutput, connection, requestedMode, pixelFormat.first, conversion, flags, &retMode, &supported) == S_OK && supported)
 		{
 			if (retMode != bmdModeUnknown)
 				actualMode = retMode;
@@ -551,7 +555,7 @@ void print_output_mode(IDeckLinkOutput* deckLinkOutput, BMDVideoConnection conne
 	}
 }
 
-void	print_output_modes_for_setup (IDeckLinkOutput* deckLinkOutput, BMDVideoConnection connection, BMDVideoOutputConversionMode conversion, BMDSupportedVideoModeFlags flags, const char* header)
+void	print_output_modes_for_setup (IDeckLinkOutput* deckLinkOutput, DeviceCapabilityCache& capabilities, BMDVideoConnection connection, BMDVideoOutputConversionMode conversion, BMDSupportedVideoModeFlags flags, const char* header)
 {
 	IDeckLinkDisplayModeIterator*	displayModeIterator = NULL;
 	IDeckLinkDisplayMode*			displayMode = NULL;
@@ -567,14 +571,14 @@ void	print_output_modes_for_setup (IDeckLinkOutput* deckLinkOutput, BMDVideoConn
 	
 	while (displayModeIterator->Next(&displayMode) == S_OK)
 	{
-		print_output_mode(deckLinkOutput, connection, conversion, flags, displayMode, header);
+		print_output_mode(deckLinkOutput, capabilities, connection, conversion, flags, displayMode, header);
 		displayMode->Release();
 	}
 	
 	displayModeIterator->Release();
 }
 
-void	print_output_modes (IDeckLink* deckLink, uint32_t printFlags)
+void	print_output_modes (IDeckLink* deckLink, DeviceCapabilityCache& capabilities, uint32_t printFlags)
 {
 	IDeckLinkOutput*					deckLinkOutput = NULL;
 	IDeckLinkProfileAttributes*			deckLinkAttributes = NULL;
@@ -643,16 +647,16 @@ void	print_output_modes (IDeckLink* deckLink, uint32_t printFlags)
 							snprintf(header, kMaxHeaderLength, "\n%s %s output:", connection.second.c_str(), links->second.c_str());
 						else
 							snprintf(header, kMaxHeaderLength, "\n%s %s %s output:", connection.second.c_str(), links->second.c_str(), conversion.second.c_str());
-						print_output_modes_for_setup(deckLinkOutput, connection.first, conversion.first, links->first, header);
+						print_output_modes_for_setup(deckLinkOutput, capabilities, connection.first, conversion.first, links->first, header);
 
 						if (multilinkSupported)
-							print_output_modes_for_setup(deckLinkOutput, connection.first, conversion.first, (BMDSupportedVideoModeFlags)(links->first | bmdSupportedVideoModeDualStream3D), header);
+							print_output_modes_for_setup(deckLinkOutput, capabilities, connection.first, conversion.first, (BMDSupportedVideoModeFlags)(links->first | bmdSupportedVideoModeDualStream3D), header);
 					}
 
 					if (keyingSupported && conversion.first == bmdNoVideoOutputConversion)
 					{
 						snprintf(header, kMaxHeaderLength, "\n%s fill and key outputs:", connection.second.c_str());
-						print_output_modes_for_setup(deckLinkOutput, connection.first, conversion.first, bmdSupportedVideoModeKeying, header);
+						print_output_modes_for_setup(deckLinkOutput, capabilities, connection.first, conversion.first, bmdSupportedVideoModeKeying, header);
 					}
 				}
 				else
@@ -662,8 +666,8 @@ void	print_output_modes (IDeckLink* deckLink, uint32_t printFlags)
 					else
 						snprintf(header, kMaxHeaderLength, "\n%s %s output:", connection.second.c_str(), conversion.second.c_str());
 
-					print_output_modes_for_setup(deckLinkOutput, connection.first, conversion.first, bmdSupportedVideoModeDefault, header);
-					print_output_modes_for_setup(deckLinkOutput, connection.first, conversion.first, bmdSupportedVideoModeDualStream3D, header);
+					print_output_modes_for_setup(deckLinkOutput, capabilities, connection.first, conversion.first, bmdSupportedVideoModeDefault, header);
+					print_output_modes_for_setup(deckLinkOutput, capabilities, connection.first, conversion.first, bmdSupportedVideoModeDualStream3D, header);
 				}
 			}
 		 }
@@ -679,7 +683,7 @@ bail:
 	printf("\n");
 }
 
-void print_input_mode(IDeckLinkInput* deckLinkInput, BMDVideoConnection connection, BMDVideoInputConversionMode conversion, BMDSupportedVideoModeFlags flags, IDeckLinkDisplayMode* displayMode, const char* nameSuffix, const char*& header)
+void print_input_mode(IDeckLinkInput* deckLinkInput, DeviceCapabilityCache& capabilities, BMDVideoConnection connection, BMDVideoInputConversionMode conversion, BMDSupportedVideoModeFlags flags, IDeckLinkDisplayMode* displayMode, const char* nameSuffix, const char*& header)
 {
 	std::string				modeName;
 	int						modeWidth;
@@ -697,7 +701,7 @@ void print_input_mode(IDeckLinkInput* deckLinkInput, BMDVideoConnection connecti
 		dlbool_t supported;
 		BMDDisplayMode retMode;
 
-		if (deckLinkInput->DoesSupportVideoMode(connection, requestedMode, pixelFromat.first, conversion, flags, &retMode, &supported) == S_OK && supported)
+		if (capabilities.DoesSupportVideoMode(kDeviceCapabilityInput, connection, requestedMode, pixelFromat.first, conversion, flags, &retMode, &supported) == S_OK && supported)
 		{
 			if (retMode != bmdModeUnknown)
 				actualMode = retMode;
@@ -755,7 +759,7 @@ void print_input_mode(IDeckLinkInput* deckLinkInput, BMDVideoConnection connecti
 	}
 }
 
-void	print_input_modes_for_setup (IDeckLinkInput* deckLinkInput, BMDVideoConnection connection, BMDVideoInputConversionMode conversion, BMDSupportedVideoModeFlags flags, const char* nameSuffix, const char* header)
+void	print_input_modes_for_setup (IDeckLinkInput* deckLinkInput, DeviceCapabilityCache& capabilities, BMDVideoConnection connection, BMDVideoInputConversionMode conversion, BMDSupportedVideoModeFlags flags, const char* nameSuffix, const char* header)
 {
 	IDeckLinkDisplayModeIterator*   displayModeIterator = NULL;
 	IDeckLinkDisplayMode*           displayMode = NULL;
@@ -771,14 +775,14 @@ void	print_input_modes_for_setup (IDeckLinkInput* deckLinkInput, BMDVideoConnect
 	
 	while (displayModeIterator->Next(&displayMode) == S_OK)
 	{
-		print_input_mode(deckLinkInput, connection, conversion, flags, displayMode, nameSuffix, header);
+		print_input_mode(deckLinkInput, capabilities, connection, conversion, flags, displayMode, nameSuffix, header);
 		displayMode->Release();
 	}
 	
 	displayModeIterator->Release();
 }
 
-void	print_input_modes (IDeckLink* deckLink, uint32_t printFlags)
+void	print_input_modes (IDeckLink* deckLink, DeviceCapabilityCache& capabilities, uint32_t printFlags)
 {
 	IDeckLinkInput*					deckLinkInput = NULL;
 	IDeckLinkProfileAttributes*		deckLinkAttributes = NULL;
@@ -825,8 +829,8 @@ void	print_input_modes (IDeckLink* deckLink, uint32_t printFlags)
 				else
 					snprintf(header, kMaxHeaderLength, "\n%s %s input:", connection.second.c_str(), conversion.second.c_str());
 
-				print_input_modes_for_setup(deckLinkInput, connection.first, conversion.first, bmdSupportedVideoModeDefault, "", header);
-				print_input_modes_for_setup(deckLinkInput, connection.first, conversion.first, bmdSupportedVideoModeDualStream3D, "3D", header);
+				print_input_modes_for_setup(deckLinkInput, capabilities, connection.first, conversion.first, bmdSupportedVideoModeDefault, "", header);
+				print_input_modes_for_setup(deckLinkInput, capabilities, connection.first, conversion.first, bmdSupportedVideoModeDualStream3D, "3D", header);
 			}
 		}
 	}
@@ -0,0 +1,523 @@
+/* -LICENSE-START-
+** Copyright (c) 2019 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "DeckLinkAPI.h"
+
+// Pooled frame allocator for SetVideoInputFrameMemoryAllocator/SetVideoOutputFrameMemoryAllocator.
+// Buffers are fixed-size slots carved from a single mapping (a slab), created on the first
+// AllocateBuffer call for a given buffer size.  Free slots are kept on a lock-free stack, so once
+// the slab exists AllocateBuffer and ReleaseBuffer never call malloc or take a lock.
+//
+// The lock-free paths count themselves in m_fastPathUsers while they use the current slab.  A
+// slab that is replaced or decommitted is retired: once the count drains, no thread can still be
+// using it without the lock, so it is unmapped at once if it has no buffers in use, otherwise
+// when its last buffer is released.
+//
+// The slab is backed by huge pages where available (falling back to transparent huge pages), can
+// be bound to a NUMA node and locked into RAM.  If the pool is exhausted, buffers are allocated
+// from the heap and counted in the statistics, so a correctly sized pool reports
+// fallbackAllocations == 0 and slabAllocations == 1 in steady state.
+
+struct PooledFrameAllocatorStatistics
+{
+	uint64_t	poolAllocations;		// Buffers handed out from a slab
+	uint64_t	fallbackAllocations;	// Buffers allocated from the heap because the pool was exhausted
+	uint64_t	slabAllocations;		// Slabs mapped, one per buffer size seen between Commit/Decommit
+	uint32_t	buffersInUse;
+	uint32_t	peakBuffersInUse;
+	uint32_t	slotSize;				// Size of each pooled buffer of the current slab, 0 if none
+	bool		hugePages;				// Current slab is backed by explicit huge pages
+	bool		memoryLocked;			// Current slab is locked into RAM
+};
+
+class PooledFrameAllocator : public IDeckLinkMemoryAllocator
+{
+public:
+	static const int kAnyNumaNode = -1;
+
+	PooledFrameAllocator(uint32_t bufferCount, bool useHugePages = true, bool lockMemory = false, int numaNode = kAnyNumaNode);
+	virtual ~PooledFrameAllocator();
+
+	// IUnknown interface
+	HRESULT	STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG	STDMETHODCALLTYPE AddRef() override;
+	ULONG	STDMETHODCALLTYPE Release() override;
+
+	// IDeckLinkMemoryAllocator interface
+	HRESULT	STDMETHODCALLTYPE AllocateBuffer(uint32_t bufferSize, void** allocatedBuffer) override;
+	HRESULT	STDMETHODCALLTYPE ReleaseBuffer(void* buffer) override;
+	HRESULT	STDMETHODCALLTYPE Commit() override;
+	HRESULT	STDMETHODCALLTYPE Decommit() override;
+
+	PooledFrameAllocatorStatistics	getStatistics() const;
+
+private:
+	static const size_t		kHugePageSize		= 2 * 1024 * 1024;
+	static const size_t		kSlotAlignment		= 4096;
+	static const uint32_t	kNoSlot				= 0xFFFFFFFF;
+
+	struct Slab
+	{
+		uint8_t*								base;
+		size_t									mappedSize;
+		uint32_t								slotSize;
+		uint32_t								slotCount;
+		bool									hugePages;
+		bool									memoryLocked;
+		bool									retired;
+		// Free-list head: high 32 bits are an ABA tag, low 32 bits are (slot index + 1), 0 if empty
+		std::atomic<uint64_t>					freeHead;
+		std::unique_ptr<std::atomic<uint32_t>[]>	nextFree;
+		std::atomic<uint32_t>					inUse;
+
+		bool		contains(const void* buffer) const { return (buffer >= base) && (buffer < base + (size_t)slotSize * slotCount); }
+		uint32_t	pop();
+		void		push(uint32_t slot);
+	};
+
+	Slab*	createSlabLocked(uint32_t bufferSize);
+	void	retireSlabLocked(Slab* slab);
+	void	destroySlabLocked(Slab* slab);
+	void	waitForFastPathLocked(void) const;
+	void	releaseToSlab(Slab* slab, void* buffer);
+	void	updatePeak(uint32_t buffersInUse);
+
+	std::atomic<ULONG>						m_refCount;
+	const uint32_t							m_bufferCount;
+	const bool								m_useHugePages;
+	const bool								m_lockMemory;
+	const int								m_numaNode;
+	//
+	std::mutex								m_mutex;			// Guards slab creation/destruction and fallback buffers
+	std::atomic<Slab*>						m_currentSlab;
+	mutable std::atomic<uint32_t>			m_fastPathUsers;	// Threads using m_currentSlab without the lock
+	std::vector<std::unique_ptr<Slab>>		m_slabs;
+	std::unordered_set<void*>				m_fallbackBuffers;
+	//
+	std::atomic<uint64_t>					m_poolAllocations;
+	std::atomic<uint64_t>					m_fallbackAllocations;
+	std::atomic<uint64_t>					m_slabAllocations;
+	std::atomic<uint32_t>					m_buffersInUse;
+	std::atomic<uint32_t>					m_peakBuffersInUse;
+};
+
+inline uint32_t PooledFrameAllocator::Slab::pop()
+{
+	uint64_t head = freeHead.load(std::memory_order_acquire);
+
+	while ((uint32_t)head != 0)
+	{
+		uint32_t slot = (uint32_t)head - 1;
+		uint64_t newHead = (((head >> 32) + 1) << 32) | nextFree[slot].load(std::memory_order_relaxed);
+
+		if (freeHead.compare_exchange_weak(head, newHead, std::memory_order_acq_rel, std::memory_order_acquire))
+			return slot;
+	}
+
+	return kNoSlot;
+}
+
+inline void PooledFrameAllocator::Slab::push(uint32_t slot)
+{
+	uint64_t head = freeHead.load(std::memory_order_relaxed);
+	uint64_t newHead;
+
+	do
+	{
+		nextFree[slot].store((uint32_t)head, std::memory_order_relaxed);
+		newHead = (((head >> 32) + 1) << 32) | (slot + 1);
+	}
+	while (!freeHead.compare_exchange_weak(head, newHead, std::memory_order_release, std::memory_order_relaxed));
+}
+
+inline PooledFrameAllocator::PooledFrameAllocator(uint32_t bufferCount, bool useHugePages, bool lockMemory, int numaNode) :
+	m_refCount(1),
+	m_bufferCount(bufferCount),
+	m_useHugePages(useHugePages),
+	m_lockMemory(lockMemory),
+	m_numaNode(numaNode),
+	m_currentSlab(nullptr),
+	m_fastPathUsers(0),
+	m_poolAllocations(0),
+	m_fallbackAllocations(0),
+	m_slabAllocations(0),
+	m_buffersInUse(0),
+	m_peakBuffersInUse(0)
+{
+}
+
+inline PooledFrameAllocator::~PooledFrameAllocator()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_currentSlab = nullptr;
+	while (!m_slabs.empty())
+		destroySlabLocked(m_slabs.back().get());
+
+	for (auto buffer : m_fallbackBuffers)
+		free(buffer);
+	m_fallbackBuffers.clear();
+}
+
+// IUnknown methods
+
+inline HRESULT PooledFrameAllocator::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	CFUUIDBytes iunknown = CFUUIDGetUUIDBytes(IUnknownUUID);
+
+	if (ppv == nullptr)
+		return E_INVALIDARG;
+
+	if ((memcmp(&iid, &iunknown, sizeof(REFIID)) == 0) || (memcmp(&iid, &IID_IDeckLinkMemoryAllocator, sizeof(REFIID)) == 0))
+	{
+		*ppv = static_cast<IDeckLinkMemoryAllocator*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = nullptr;
+	return E_NOINTERFACE;
+}
+
+inline ULONG PooledFrameAllocator::AddRef()
+{
+	return ++m_refCount;
+}
+
+inline ULONG PooledFrameAllocator::Release()
+{
+	ULONG newRefValue = --m_refCount;
+
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+// IDeckLinkMemoryAllocator methods
+
+inline HRESULT PooledFrameAllocator::AllocateBuffer(uint32_t bufferSize, void** allocatedBuffer)
+{
+	if (allocatedBuffer == nullptr)
+		return E_POINTER;
+
+	m_fastPathUsers.fetch_add(1);
+
+	Slab*		slab = m_currentSlab.load();
+	uint32_t	slot = kNoSlot;
+
+	if ((slab != nullptr) && (bufferSize <= slab->slotSize))
+		slot = slab->pop();
+
+	if (slot == kNoSlot)
+	{
+		m_fastPathUsers.fetch_sub(1);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		// First allocation or a larger buffer size, map a new slab and retire any previous one
+		slab = m_currentSlab.load();
+		if ((slab == nullptr) || (bufferSize > slab->slotSize))
+		{
+			Slab* previousSlab = slab;
+
+			slab = createSlabLocked(bufferSize);
+			m_currentSlab.store(slab);
+
+			if (previousSlab != nullptr)
+				retireSlabLocked(previousSlab);
+		}
+
+		// The slab can't be retired while the lock is held
+		if (slab != nullptr)
+			slot = slab->pop();
+
+		if (slot != kNoSlot)
+			slab->inUse.fetch_add(1, std::memory_order_relaxed);
+	}
+	else
+	{
+		slab->inUse.fetch_add(1, std::memory_order_relaxed);
+		m_fastPathUsers.fetch_sub(1);
+	}
+
+	if (slot != kNoSlot)
+	{
+		m_poolAllocations.fetch_add(1, std::memory_order_relaxed);
+		updatePeak(m_buffersInUse.fetch_add(1, std::memory_order_relaxed) + 1);
+
+		*allocatedBuffer = slab->base + (size_t)slot * slab->slotSize;
+		return S_OK;
+	}
+
+	// Pool exhausted or unavailable, fall back to the heap
+	if (posix_memalign(allocatedBuffer, kSlotAlignment, bufferSize) != 0)
+	{
+		*allocatedBuffer = nullptr;
+		return E_OUTOFMEMORY;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_fallbackBuffers.insert(*allocatedBuffer);
+	}
+
+	m_fallbackAllocations.fetch_add(1, std::memory_order_relaxed);
+	updatePeak(m_buffersInUse.fetch_add(1, std::memory_order_relaxed) + 1);
+	return S_OK;
+}
+
+inline HRESULT PooledFrameAllocator::ReleaseBuffer(void* buffer)
+{
+	m_fastPathUsers.fetch_add(1);
+
+	Slab* slab = m_currentSlab.load();
+
+	if ((slab != nullptr) && slab->contains(buffer))
+	{
+		releaseToSlab(slab, buffer);
+		m_fastPathUsers.fetch_sub(1);
+		return S_OK;
+	}
+
+	m_fastPathUsers.fetch_sub(1);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (auto& retiredSlab : m_slabs)
+	{
+		if (retiredSlab->contains(buffer))
+		{
+			slab = retiredSlab.get();
+			releaseToSlab(slab, buffer);
+
+			if (slab->retired && (slab->inUse.load(std::memory_order_acquire) == 0))
+				destroySlabLocked(slab);
+
+			return S_OK;
+		}
+	}
+
+	if (m_fallbackBuffers.erase(buffer) == 0)
+		return E_INVALIDARG;
+
+	free(buffer);
+	m_buffersInUse.fetch_sub(1, std::memory_order_relaxed);
+	return S_OK;
+}
+
+inline HRESULT PooledFrameAllocator::Commit()
+{
+	return S_OK;
+}
+
+inline HRESULT PooledFrameAllocator::Decommit()
+{
+	// Unmap idle slabs.  Slabs with buffers still held by the application are unmapped when their
+	// last buffer is released
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_currentSlab.store(nullptr);
+
+	for (size_t i = m_slabs.size(); i-- > 0; )
+		retireSlabLocked(m_slabs[i].get());
+
+	return S_OK;
+}
+
+// Other methods
+
+inline PooledFrameAllocatorStatistics PooledFrameAllocator::getStatistics() const
+{
+	PooledFrameAllocatorStatistics	statistics;
+
+	m_fastPathUsers.fetch_add(1);
+
+	Slab*							slab = m_currentSlab.load();
+
+	statistics.poolAllocations		= m_poolAllocations.load(std::memory_order_relaxed);
+	statistics.fallbackAllocations	= m_fallbackAllocations.load(std::memory_order_relaxed);
+	statistics.slabAllocations		= m_slabAllocations.load(std::memory_order_relaxed);
+	statistics.buffersInUse			= m_buffersInUse.load(std::memory_order_relaxed);
+	statistics.peakBuffersInUse		= m_peakBuffersInUse.load(std::memory_order_relaxed);
+	statistics.slotSize				= slab ? slab->slotSize : 0;
+	statistics.hugePages			= slab ? slab->hugePages : false;
+	statistics.memoryLocked			= slab ? slab->memoryLocked : false;
+
+	m_fastPathUsers.fetch_sub(1);
+
+	return statistics;
+}
+
+inline PooledFrameAllocator::Slab* PooledFrameAllocator::createSlabLocked(uint32_t bufferSize)
+{
+	std::unique_ptr<Slab>	slab(new Slab);
+	size_t					slotSize = (bufferSize + kSlotAlignment - 1) & ~(kSlotAlignment - 1);
+	size_t					slabSize = slotSize * m_bufferCount;
+	void*					address = MAP_FAILED;
+
+	if ((m_bufferCount == 0) || (slotSize > UINT32_MAX))
+		return nullptr;
+
+	slab->hugePages		= false;
+	slab->memoryLocked	= false;
+	slab->retired		= false;
+	slab->slotSize		= (uint32_t)slotSize;
+	slab->slotCount		= m_bufferCount;
+	slab->mappedSize	= (slabSize + kHugePageSize - 1) & ~(kHugePageSize - 1);
+
+	if (m_useHugePages)
+	{
+		address = mmap(nullptr, slab->mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		slab->hugePages = (address != MAP_FAILED);
+	}
+
+	if (address == MAP_FAILED)
+	{
+		// No huge pages reserved (vm.nr_hugepages), ask for transparent huge pages instead
+		address = mmap(nullptr, slab->mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (address == MAP_FAILED)
+			return nullptr;
+
+		if (m_useHugePages)
+			madvise(address, slab->mappedSize, MADV_HUGEPAGE);
+	}
+
+	slab->base = (uint8_t*)address;
+
+	if (m_numaNode >= 0 && m_numaNode < (int)(sizeof(unsigned long) * 8))
+	{
+		// Bind before the pages are first touched, so they are allocated on the requested node.
+		// mbind is called directly to avoid a dependency on libnuma
+		const int		kMemoryPolicyBind = 2;		// MPOL_BIND
+		unsigned long	nodeMask = 1UL << m_numaNode;
+
+		syscall(SYS_mbind, address, slab->mappedSize, kMemoryPolicyBind, &nodeMask, sizeof(nodeMask) * 8 + 1, 0);
+	}
+
+	if (m_lockMemory)
+		slab->memoryLocked = (mlock(address, slab->mappedSize) == 0);
+
+	// Pre-fault the slab so that no page faults are taken in the capture or playout path
+	if (!slab->memoryLocked)
+	{
+		for (size_t offset = 0; offset < slab->mappedSize; offset += kSlotAlignment)
+			slab->base[offset] = 0;
+	}
+
+	slab->nextFree.reset(new std::atomic<uint32_t>[m_bufferCount]);
+	for (uint32_t slot = 0; slot < m_bufferCount; slot++)
+		slab->nextFree[slot].store(slot + 2 <= m_bufferCount ? slot + 2 : 0, std::memory_order_relaxed);
+
+	slab->freeHead.store(1, std::memory_order_relaxed);
+	slab->inUse.store(0, std::memory_order_relaxed);
+
+	m_slabAllocations.fetch_add(1, std::memory_order_relaxed);
+	m_slabs.push_back(std::move(slab));
+
+	return m_slabs.back().get();
+}
+
+inline void PooledFrameAllocator::retireSlabLocked(Slab* slab)
+{
+	// The slab is no longer current.  Once threads that loaded it without the lock are done with
+	// it, its buffer count can only fall, so an idle slab can be unmapped now
+	slab->retired = true;
+	waitForFastPathLocked();
+
+	if (slab->inUse.load(std::memory_order_acquire) == 0)
+		destroySlabLocked(slab);
+}
+
+inline void PooledFrameAllocator::destroySlabLocked(Slab* slab)
+{
+	waitForFastPathLocked();
+
+	for (auto iter = m_slabs.begin(); iter != m_slabs.end(); ++iter)
+	{
+		if (iter->get() == slab)
+		{
+			if (slab->memoryLocked)
+				munlock(slab->base, slab->mappedSize);
+
+			munmap(slab->base, slab->mappedSize);
+			m_slabs.erase(iter);
+			return;
+		}
+	}
+}
+
+inline void PooledFrameAllocator::releaseToSlab(Slab* slab, void* buffer)
+{
+	slab->push((uint32_t)(((uint8_t*)buffer - slab->base) / slab->slotSize));
+	slab->inUse.fetch_sub(1, std::memory_order_release);
+	m_buffersInUse.fetch_sub(1, std::memory_order_relaxed);
+}
+
+inline void PooledFrameAllocator::waitForFastPathLocked(void) const
+{
+	// Fast paths only hold the count for a few instructions and never take the lock
+	while (m_fastPathUsers.load() != 0)
+		std::this_thread::yield();
+}
+
+inline void PooledFrameAllocator::updatePeak(uint32_t buffersInUse)
+{
+	uint32_t peak = m_peakBuffersInUse.load(std::memory_order_relaxed);
+
+	while ((buffersInUse > peak) && !m_peakBuffersInUse.compare_exchange_weak(peak, buffersInUse, std::memory_order_relaxed))
+	{
+	}
+}
@@ -0,0 +1,359 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "FrameID.h"
+#include "PixelPacking.h"
+
+namespace
+{
+	const uint8_t	kSyncWord			= 0xB5;
+	const uint32_t	kFrameNumberBits	= 32;
+	const uint32_t	kTimestampBits		= 48;
+	const uint32_t	kCRCBits			= 16;
+	const uint32_t	kCodeBits			= 8 + kFrameNumberBits + kTimestampBits + kCRCBits;
+	const uint32_t	kMinimumCellWidth	= 4;
+	// Minimum difference between the darkest and brightest cells, a quarter of video range
+	const uint32_t	kMinimumContrast	= (219 << 8) / 4;
+
+	struct FrameIDLayout
+	{
+		BMDPixelFormat	pixelFormat;
+		uint32_t		width;
+		uint32_t		height;
+		uint32_t		rowBytes;
+		uint32_t		cellWidth;
+		uint8_t*		bytes;
+	};
+
+	bool GetFrameIDLayout(IDeckLinkVideoFrame* frame, FrameIDLayout& layout)
+	{
+		void* bytes;
+
+		if (!frame)
+			return false;
+
+		layout.pixelFormat	= frame->GetPixelFormat();
+		layout.width		= (uint32_t)frame->GetWidth();
+		layout.height		= (uint32_t)frame->GetHeight();
+		layout.rowBytes		= (uint32_t)frame->GetRowBytes();
+
+		if (!IsPixelPackingSupported(layout.pixelFormat) || layout.height < kFrameIDLines)
+			return false;
+
+		// Cells start on even pixels so each one covers whole 4:2:2 chroma samples
+		layout.cellWidth = (layout.width / kCodeBits) & ~1u;
+		if (layout.cellWidth < kMinimumCellWidth)
+			return false;
+
+		if (frame->GetBytes(&bytes) != S_OK || !bytes)
+			return false;
+
+		layout.bytes = (uint8_t*)bytes;
+		return true;
+	}
+
+	bool IsFullRange(BMDPixelFormat pixelFormat)
+	{
+		switch (pixelFormat)
+		{
+			case bmdFormat8BitARGB:
+			case bmdFormat8BitBGRA:
+			case bmdFormat12BitRGB:
+			case bmdFormat12BitRGBLE:
+				return true;
+
+			default:
+				return false;
+		}
+	}
+
+	// CRC-16-CCITT, polynomial 0x1021, initial value 0xFFFF
+	uint16_t CalculateCRC(const uint8_t* data, uint32_t length)
+	{
+		uint16_t crc = 0xFFFF;
+
+		for (uint32_t i = 0; i < length; i++)
+		{
+			crc ^= (uint16_t)data[i] << 8;
+			for (int bit = 0; bit < 8; bit++)
+				crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+		}
+
+		return crc;
+	}
+
+	// Frame number and timestamp, big-endian, as covered by the CRC
+	const uint32_t kPayloadBytes = (kFrameNumberBits + kTimestampBits) / 8;
+
+	void GetPayload(uint32_t frameNumber, uint64_t timestamp, uint8_t payload[kPayloadBytes])
+	{
+		for (int i = 0; i < 4; i++)
+			payload[i] = (uint8_t)(frameNumber >> (24 - 8 * i));
+		for (int i = 0; i < 6; i++)
+			payload[4 + i] = (uint8_t)(timestamp >> (40 - 8 * i));
+	}
+
+	// Row buffers are kept for each thread and only grow, so codes are read and written on every
+	// frame without allocating
+	struct FrameIDRowBuffers
+	{
+		std::vector<uint16_t>	luma;
+		std::vector<uint16_t>	chroma;
+		std::vector<uint16_t>	samples;
+	};
+
+	FrameIDRowBuffers& GetRowBuffers(void)
+	{
+		thread_local FrameIDRowBuffers rowBuffers;
+		return rowBuffers;
+	}
+}
+
+uint64_t GetFrameIDTimestamp(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+	return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+bool WriteFrameID(IDeckLinkVideoFrame* frame, const FrameID& frameID)
+{
+	FrameIDLayout	layout;
+	uint8_t			payload[kPayloadBytes];
+	uint8_t			code[kCodeBits / 8];
+
+	if (!GetFrameIDLayout(frame, layout))
+		return false;
+
+	GetPayload(frameID.frameNumber, frameID.timestamp, payload);
+	uint16_t crc = CalculateCRC(payload, kPayloadBytes);
+
+	code[0] = kSyncWord;
+	memcpy(&code[1], payload, kPayloadBytes);
+	code[1 + kPayloadBytes]		= (uint8_t)(crc >> 8);
+	code[2 + kPayloadBytes]		= (uint8_t)crc;
+
+	bool		fullRange	= IsFullRange(layout.pixelFormat);
+	uint16_t	black		= fullRange ? 0 : 16 << 8;
+	uint16_t	white		= fullRange ? 0xFFFF : 235 << 8;
+	bool		yuv			= IsPixelFormatYUV(layout.pixelFormat);
+
+	// Render one row of the code, the rest of the row beyond the code is black
+	FrameIDRowBuffers&		rowBuffers	= GetRowBuffers();
+	std::vector<uint16_t>&	luma		= rowBuffers.luma;
+	std::vector<uint16_t>&	chroma		= rowBuffers.chroma;
+	uint16_t*				planes[kPixelPlaneCount];
+
+	luma.assign(layout.width, black);
+	chroma.assign(layout.width / 2, 128 << 8);
+
+	for (uint32_t bit = 0; bit < kCodeBits; bit++)
+	{
+		if (code[bit / 8] & (0x80 >> (bit % 8)))
+			std::fill_n(&luma[bit * layout.cellWidth], layout.cellWidth, white);
+	}
+
+	if (yuv)
+	{
+		planes[kPixelPlaneY]	= luma.data();
+		planes[kPixelPlaneCb]	= chroma.data();
+		planes[kPixelPlaneCr]	= chroma.data();
+	}
+	else
+	{
+		planes[kPixelPlaneR]	= luma.data();
+		planes[kPixelPlaneG]	= luma.data();
+		planes[kPixelPlaneB]	= luma.data();
+	}
+	planes[kPixelPlaneA] = nullptr;
+
+	if (!PackPixelRow(layout.pixelFormat, planes, layout.bytes, layout.width))
+		return false;
+
+	for (uint32_t y = 1; y < kFrameIDLines; y++)
+		memcpy(layout.bytes + y * layout.rowBytes, layout.bytes, GetPixelFormatRowBytes(layout.pixelFormat, layout.width));
+
+	return true;
+}
+
+bool ReadFrameID(IDeckLinkVideoFrame* frame, FrameID& frameID)
+{
+	FrameIDLayout	layout;
+	uint32_t		cellLevels[kCodeBits];
+	uint8_t			code[kCodeBits / 8];
+
+	if (!GetFrameIDLayout(frame, layout))
+		return false;
+
+	// Only the middle line of the code is decoded, it is the least likely to be affected by
+	// vertical filtering or a picture shifted by a line
+	std::vector<uint16_t>&	samples = GetRowBuffers().samples;
+	if (samples.size() < layout.width * 4)
+		samples.resize(layout.width * 4);
+
+	uint16_t*				planes[kPixelPlaneCount] = { &samples[0], &samples[layout.width], &samples[layout.width * 2], nullptr };
+	bool					yuv = IsPixelFormatYUV(layout.pixelFormat);
+
+	if (!UnpackPixelRow(layout.pixelFormat, layout.bytes + (kFrameIDLines / 2) * layout.rowBytes, planes, layout.width))
+		return false;
+
+	// Average the central half of each cell, ignoring edges softened by filtering
+	uint32_t	sampleStart		= layout.cellWidth / 4;
+	uint32_t	sampleCount		= layout.cellWidth / 2;
+	uint32_t	minimumLevel	= 0xFFFF;
+	uint32_t	maximumLevel	= 0;
+
+	for (uint32_t bit = 0; bit < kCodeBits; bit++)
+	{
+		uint32_t x		= bit * layout.cellWidth + sampleStart;
+		uint32_t total	= 0;
+
+		for (uint32_t i = 0; i < sampleCount; i++, x++)
+		{
+			if (yuv)
+				total += planes[kPixelPlaneY][x];
+			else
+				total += ((uint32_t)planes[kPixelPlaneR][x] + 2 * (uint32_t)planes[kPixelPlaneG][x] + planes[kPixelPlaneB][x]) / 4;
+		}
+
+		cellLevels[bit]	= total / sampleCount;
+		minimumLevel	= std::min(minimumLevel, cellLevels[bit]);
+		maximumLevel	= std::max(maximumLevel, cellLevels[bit]);
+	}
+
+	if (maximumLevel - minimumLevel < kMinimumContrast)
+		return false;
+
+	// Threshold halfway between black and white, so the code survives range conversion or gain
+	uint32_t threshold = (minimumLevel + maximumLevel) / 2;
+
+	memset(code, 0, sizeof(code));
+	for (uint32_t bit = 0; bit < kCodeBits; bit++)
+	{
+		if (cellLevels[bit] > threshold)
+			code[bit / 8] |= 0x80 >> (bit % 8);
+	}
+
+	if (code[0] != kSyncWord)
+		return false;
+
+	uint16_t crc = ((uint16_t)code[1 + kPayloadBytes] << 8) | code[2 + kPayloadBytes];
+	if (CalculateCRC(&code[1], kPayloadBytes) != crc)
+		return false;
+
+	frameID.frameNumber	= 0;
+	frameID.timestamp	= 0;
+	for (int i = 0; i < 4; i++)
+		frameID.frameNumber = (frameID.frameNumber << 8) | code[1 + i];
+	for (int i = 0; i < 6; i++)
+		frameID.timestamp = (frameID.timestamp << 8) | code[5 + i];
+
+	return true;
+}
+
+FrameIDTracker::FrameIDTracker()
+{
+	Reset();
+}
+
+void FrameIDTracker::Reset(void)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	memset(&m_statistics, 0, sizeof(m_statistics));
+	m_hasLastFrameNumber	= false;
+	m_lastFrameNumber		= 0;
+}
+
+int64_t FrameIDTracker::AddFrame(const FrameID* frameID, uint64_t arrivalTime)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!frameID)
+	{
+		m_statistics.framesUndecodable++;
+		return -1;
+	}
+
+	m_statistics.framesDecoded++;
+
+	if (m_hasLastFrameNumber)
+	{
+		// Signed difference, so a wrapped frame number is still seen as the next frame
+		int32_t difference = (int32_t)(frameID->frameNumber - m_lastFrameNumber);
+
+		if (difference == 0)
+			m_statistics.framesRepeated++;
+		else if (difference < 0)
+			m_statistics.framesOutOfOrder++;
+		else
+			m_statistics.framesDropped += (uint64_t)(difference - 1);
+	}
+
+	// Don't move backwards after an out-of-order frame, so the frames after it are not counted
+	// as repeated
+	if (!m_hasLastFrameNumber || (int32_t)(frameID->frameNumber - m_lastFrameNumber) > 0)
+		m_lastFrameNumber = frameID->frameNumber;
+	m_hasLastFrameNumber = true;
+
+	if (frameID->timestamp == kFrameIDNoTimestamp || arrivalTime < frameID->timestamp)
+		return -1;
+
+	uint64_t latency = arrivalTime - frameID->timestamp;
+
+	if (m_statistics.latencyCount == 0 || latency < m_statistics.minLatency)
+		m_statistics.minLatency = latency;
+	m_statistics.maxLatency		= std::max(m_statistics.maxLatency, latency);
+	m_statistics.lastLatency	= latency;
+	m_statistics.totalLatency	+= latency;
+	m_statistics.latencyCount++;
+
+	return (int64_t)latency;
+}
+
+FrameIDStatistics FrameIDTracker::GetStatistics(void)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_statistics;
+}
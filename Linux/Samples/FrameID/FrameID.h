@@ -0,0 +1,111 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <mutex>
+#include <stdint.h>
+#include "DeckLinkAPI.h"
+
+// Frame ID code.  A machine readable frame number and output timestamp embedded in the active
+// picture by the output side, so a capture of the signal can identify every frame it receives
+// and measure the delay, dropped, repeated and out-of-order frames without an external analyzer.
+//
+// The code is a row of 104 binary cells in the first kFrameIDLines lines of the picture: an
+// 8-bit sync word, the 32-bit frame number, a 48-bit timestamp and a CRC-16 of the frame number
+// and timestamp, most significant bit first.  Cells are black or white luma with neutral chroma,
+// at least 4 pixels wide and starting on even pixels, so the code survives 4:2:2 chroma
+// subsampling and conversion between YUV and RGB.  The decoder only unpacks the middle line of
+// the code, so it is cheap enough to run on every captured frame.
+//
+// Timestamps are the CLOCK_MONOTONIC_RAW time in microseconds at which the frame is expected on
+// the output, so latency can be measured by a capture process on the same host.  A timestamp of
+// kFrameIDNoTimestamp is sent when the output time is not known, eg for preroll frames.
+
+static const uint32_t	kFrameIDLines		= 8;
+static const uint64_t	kFrameIDNoTimestamp	= 0;
+
+struct FrameID
+{
+	uint32_t	frameNumber;
+	uint64_t	timestamp;		// Microseconds
+};
+
+// Current CLOCK_MONOTONIC_RAW time in microseconds
+uint64_t	GetFrameIDTimestamp(void);
+
+// Write or read the frame ID code of a frame in any pixel format supported by the pixel packing
+// library.  Return false if the pixel format is unsupported, the frame is too narrow or, when
+// reading, no valid code is found
+bool		WriteFrameID(IDeckLinkVideoFrame* frame, const FrameID& frameID);
+bool		ReadFrameID(IDeckLinkVideoFrame* frame, FrameID& frameID);
+
+struct FrameIDStatistics
+{
+	uint64_t	framesDecoded;
+	uint64_t	framesUndecodable;		// Frames without a valid frame ID code
+	uint64_t	framesDropped;			// Gaps in the frame numbers received
+	uint64_t	framesRepeated;			// Frames with the same frame number as the previous frame
+	uint64_t	framesOutOfOrder;		// Frames with an earlier frame number than the previous frame
+	uint64_t	latencyCount;
+	uint64_t	lastLatency;			// Microseconds from output timestamp to capture
+	uint64_t	minLatency;
+	uint64_t	maxLatency;
+	uint64_t	totalLatency;
+};
+
+// Tracks the sequence of frame IDs captured
+class FrameIDTracker
+{
+public:
+	FrameIDTracker();
+
+	// Add a captured frame, with the time it arrived.  frameID is NULL if the frame had no valid
+	// code.  Returns the latency of the frame in microseconds, or -1 if it has no timestamp
+	int64_t				AddFrame(const FrameID* frameID, uint64_t arrivalTime);
+	FrameIDStatistics	GetStatistics(void);
+	void				Reset(void);
+
+private:
+	std::mutex			m_mutex;
+	FrameIDStatistics	m_statistics;
+	bool				m_hasLastFrameNumber;
+	uint32_t			m_lastFrameNumber;
+};
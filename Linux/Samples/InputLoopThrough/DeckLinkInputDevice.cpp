@@ -43,11 +43,13 @@
 #include "platform.h"
 #include "DeckLinkInputDevice.h"
 #include "ReferenceTime.h"
+#include "FrameTrace.h"
 
 DeckLinkInputDevice::DeckLinkInputDevice(com_ptr<IDeckLink>& device) :
 	m_refCount(1),
 	m_deckLink(device),
 	m_deckLinkInput(IID_IDeckLinkInput, device),
+	m_frameAllocator(nullptr),
 	m_frameTimescale(1001),
 	m_seenValidSignal(false),
 	m_readyForCapture(false),
@@ -111,6 +113,8 @@ HRESULT DeckLinkInputDevice::VideoInputFrameArrived(IDeckLinkVideoInputFrame* vi
 {
 	// Get the current timestamp for the entry to callback for latency measurements.
 	BMDTimeValue referenceCount = ReferenceTime::getSteadyClockUptimeCount();
+
+	FrameTrace::setThreadName("DeckLink input callback");
 	
 	if (videoFrame)
 	{
@@ -142,6 +146,7 @@ HRESULT DeckLinkInputDevice::VideoInputFrameArrived(IDeckLinkVideoInputFrame* vi
 			if (m_videoInputFrameDroppedCallback && m_seenValidSignal && !inputFrameValid)
 			{
 				// Report any dropped frames
+				FrameTrace::instant("Video input dropped", streamTime, referenceCount);
 				m_videoInputFrameDroppedCallback(streamTime, frameDuration, m_frameTimescale);
 			}
 			else if (m_videoInputArrivedCallback)
@@ -162,6 +167,9 @@ HRESULT DeckLinkInputDevice::VideoInputFrameArrived(IDeckLinkVideoInputFrame* vi
 				loopThroughVideoFrame->setVideoStreamTime(streamTime);
 				loopThroughVideoFrame->setVideoFrameDuration(frameDuration);
 
+				FrameTrace::complete(FrameTrace::Track::VideoInputSignal, "Video input frame", streamTime, referenceFrameTime - referenceFrameDuration, referenceFrameDuration);
+				FrameTrace::instant("Video input arrived", streamTime, referenceCount);
+
 				m_videoInputArrivedCallback(std::move(loopThroughVideoFrame));
 			}
 		}
@@ -189,6 +197,8 @@ HRESULT DeckLinkInputDevice::VideoInputFrameArrived(IDeckLinkVideoInputFrame* vi
 			return E_FAIL;
 		loopThroughAudioPacket->setAudioStreamTime(packetTime);
 
+		FrameTrace::instant("Audio input arrived", packetTime, referenceCount);
+
 		m_audioInputArrivedCallback(std::move(loopThroughAudioPacket));
 	}
 
@@ -231,6 +241,10 @@ bool DeckLinkInputDevice::startCapture(BMDDisplayMode displayMode, bool enable3D
 	if (m_deckLinkInput->SetCallback(this) != S_OK)
 		return false;
 	
+	// Use the application frame allocator, if provided, for captured video frames
+	if (m_frameAllocator && (m_deckLinkInput->SetVideoInputFrameMemoryAllocator(m_frameAllocator.get()) != S_OK))
+		return false;
+
 	// Set the video input mode
 	if (m_deckLinkInput->EnableVideoInput(displayMode, pixelFormat, videoInputFlags) != S_OK)
 		return false;
@@ -74,6 +74,7 @@ public:
 	bool	startCapture(BMDDisplayMode displayMode, bool enable3D, BMDPixelFormat pixelFormat, BMDAudioSampleType audioSampleType, uint32_t audioChannelCount);
 	void	stopCapture(void);
 	void	setReadyForCapture(void);
+	void	setFrameAllocator(IDeckLinkMemoryAllocator* allocator) { m_frameAllocator = allocator; }
 
 	void	onVideoFormatChange(const VideoFormatChangedCallback& callback) { m_videoFormatChangedCallback = callback; }
 	void	onVideoInputArrived(const VideoInputArrivedCallback& callback) { m_videoInputArrivedCallback = callback; }
@@ -85,6 +86,7 @@ private:
 	//
 	com_ptr<IDeckLink>				m_deckLink;
 	com_ptr<IDeckLinkInput>			m_deckLinkInput;
+	com_ptr<IDeckLinkMemoryAllocator>	m_frameAllocator;
 	BMDTimeValue					m_frameDuration;
 	BMDTimeValue					m_lastStreamTime;
 	BMDTimeScale					m_frameTimescale;
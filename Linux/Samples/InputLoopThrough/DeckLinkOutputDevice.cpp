@@ -42,12 +42,21 @@
 
 #include "DeckLinkOutputDevice.h"
 #include "ReferenceTime.h"
+#include "FrameTrace.h"
+
+// Depth of the queues feeding the scheduling threads.  When full, the processing dispatch threads
+// block until the scheduling thread catches up, so that no frames or audio are lost.  Blocked
+// producers are released, and further samples dropped, once the scheduling thread exits.
+const size_t kOutputVideoFrameQueueCapacity		= 16;
+const size_t kOutputAudioPacketQueueCapacity	= 32;
 
 DeckLinkOutputDevice::DeckLinkOutputDevice(com_ptr<IDeckLink>& device, int videoPrerollSize) :
 	m_refCount(1),
 	m_state(PlaybackState::Idle),
 	m_deckLink(device),
 	m_deckLinkOutput(IID_IDeckLinkOutput, device),
+	m_outputVideoFrameQueue(kOutputVideoFrameQueueCapacity, SampleQueueOverflowPolicy::BlockWhenFull),
+	m_outputAudioPacketQueue(kOutputAudioPacketQueueCapacity, SampleQueueOverflowPolicy::BlockWhenFull),
 	m_videoPrerollSize(videoPrerollSize),
 	m_seenFirstVideoFrame(false),
 	m_seenFirstAudioPacket(false),
@@ -108,37 +117,66 @@ ULONG DeckLinkOutputDevice::Release(void)
 	return newRefValue;
 }
 
+static void traceFrameCompletion(const std::shared_ptr<LoopThroughVideoFrame>& videoFrame, BMDTimeValue frameCompletionTimestamp, BMDTimeValue referenceFrameDuration, BMDOutputFrameCompletionResult result)
+{
+	if (!FrameTrace::isEnabled())
+		return;
+
+	switch (result)
+	{
+		case bmdOutputFrameCompleted:
+			FrameTrace::instant("Video frame completed", videoFrame->getVideoStreamTime());
+			break;
+		case bmdOutputFrameDisplayedLate:
+			FrameTrace::instant("Video frame displayed late", videoFrame->getVideoStreamTime());
+			break;
+		case bmdOutputFrameDropped:
+			FrameTrace::instant("Video frame dropped", videoFrame->getVideoStreamTime());
+			return;
+		case bmdOutputFrameFlushed:
+		default:
+			FrameTrace::instant("Video frame flushed", videoFrame->getVideoStreamTime());
+			return;
+	}
+
+	// Frame was output, show its time on the wire, which ends at the completion timestamp
+	FrameTrace::complete(FrameTrace::Track::VideoOutputSignal, "Video output frame", videoFrame->getVideoStreamTime(),
+						 frameCompletionTimestamp - referenceFrameDuration, referenceFrameDuration);
+}
+
 // IDeckLinkVideoOutputCallback interface
 
 HRESULT	DeckLinkOutputDevice::ScheduledFrameCompleted(IDeckLinkVideoFrame* completedFrame, BMDOutputFrameCompletionResult result)
 {
-	BMDTimeValue frameCompletionTimestamp;
+	BMDTimeValue							frameCompletionTimestamp;
+	std::shared_ptr<LoopThroughVideoFrame>	loopThroughVideoFrame;
 	
-	// Get frame completion timestamp
-	if (completedFrame)
+	if (!completedFrame)
+		return S_OK;
+
+	FrameTrace::setThreadName("DeckLink output callback");
+
 	{
-		// Get the time that scheduled frame was completely transmitted by the device
-		if (m_deckLinkOutput->GetFrameCompletionReferenceTimestamp(completedFrame, ReferenceTime::kTimescale, &frameCompletionTimestamp) == S_OK)
-		{
-			std::lock_guard<std::mutex> lock(m_mutex);
+		// Look up and remove the in-flight frame.  Only the scheduled frames table is locked, so the
+		// callback does not wait on the scheduling thread while it is calling ScheduleVideoFrame
+		std::lock_guard<std::mutex> lock(m_scheduledFramesMutex);
 
-			for (auto iter = m_scheduledFramesList.rbegin(); iter != m_scheduledFramesList.rend(); iter++)
-			{
-				auto loopThroughVideoFrame = iter->get();
-				if (loopThroughVideoFrame->getVideoFramePtr() == completedFrame)
-				{
-					if (m_scheduledFrameCompletedCallback != nullptr)
-					{
-						loopThroughVideoFrame->setOutputCompletionResult(result);
-						loopThroughVideoFrame->setOutputFrameCompletedReferenceTime(frameCompletionTimestamp - loopThroughVideoFrame->getVideoFrameDuration());
-						m_scheduledFrameCompletedCallback(std::move(*iter));
-					}
-					// Erase item from reverse_iterator
-					m_scheduledFramesList.erase(std::next(iter).base());
-					break;
-				}
-			}
-		}
+		auto iter = m_scheduledFrames.find(completedFrame);
+		if (iter == m_scheduledFrames.end())
+			return S_OK;
+
+		loopThroughVideoFrame = std::move(iter->second);
+		m_scheduledFrames.erase(iter);
+	}
+
+	// Get the time that scheduled frame was completely transmitted by the device
+	if ((m_scheduledFrameCompletedCallback != nullptr) &&
+		(m_deckLinkOutput->GetFrameCompletionReferenceTimestamp(completedFrame, ReferenceTime::kTimescale, &frameCompletionTimestamp) == S_OK))
+	{
+		loopThroughVideoFrame->setOutputCompletionResult(result);
+		loopThroughVideoFrame->setOutputFrameCompletedReferenceTime(frameCompletionTimestamp - loopThroughVideoFrame->getVideoFrameDuration());
+		traceFrameCompletion(loopThroughVideoFrame, frameCompletionTimestamp, m_frameDuration * ReferenceTime::kTimescale / m_frameTimescale, result);
+		m_scheduledFrameCompletedCallback(std::move(loopThroughVideoFrame));
 	}
 
 	return S_OK;
@@ -166,12 +204,6 @@ HRESULT	DeckLinkOutputDevice::RenderAudioSamples(dlbool_t preroll)
 
 bool DeckLinkOutputDevice::startPlayback(BMDDisplayMode displayMode, bool enable3D, BMDPixelFormat pixelFormat, BMDAudioSampleType audioSampleType, uint32_t audioChannelCount, bool requireReferenceLocked)
 {
-	// Pass through RP188 timecode and VANC from input frame.  VITC timecode is forwarded with VANC
-	BMDVideoOutputFlags				outputFlags = (BMDVideoOutputFlags)(bmdVideoOutputRP188 | bmdVideoOutputVANC);
-	com_ptr<IDeckLinkDisplayMode>	deckLinkDisplayMode;
-	dlbool_t						displayModeSupported;
-	BMDSupportedVideoModeFlags		supportedVideoModeFlags = enable3D ? bmdSupportedVideoModeDualStream3D : bmdSupportedVideoModeDefault;
-
 	m_seenFirstVideoFrame = false;
 	m_seenFirstAudioPacket = false;
 	m_startPlaybackTime = 0;
@@ -181,6 +213,37 @@ bool DeckLinkOutputDevice::startPlayback(BMDDisplayMode displayMode, bool enable
 		m_state = PlaybackState::Starting;
 	}
 
+	if (!enableOutput(displayMode, enable3D, pixelFormat, audioSampleType, audioChannelCount, requireReferenceLocked))
+	{
+		// No scheduling thread will consume the queues, don't let producers block on them
+		m_outputVideoFrameQueue.cancelWaiters();
+		m_outputAudioPacketQueue.cancelWaiters();
+		return false;
+	}
+
+	m_outputVideoFrameQueue.reset();
+	m_outputAudioPacketQueue.reset();
+	
+	// Start scheduling threads
+	m_scheduleVideoFramesThread = std::thread(&DeckLinkOutputDevice::scheduleVideoFramesThread, this);
+	m_scheduleAudioPacketsThread = std::thread(&DeckLinkOutputDevice::scheduleAudioPacketsThread, this);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_state = PlaybackState::Prerolling;
+	}
+
+	return true;
+}
+
+bool DeckLinkOutputDevice::enableOutput(BMDDisplayMode displayMode, bool enable3D, BMDPixelFormat pixelFormat, BMDAudioSampleType audioSampleType, uint32_t audioChannelCount, bool requireReferenceLocked)
+{
+	// Pass through RP188 timecode and VANC from input frame.  VITC timecode is forwarded with VANC
+	BMDVideoOutputFlags				outputFlags = (BMDVideoOutputFlags)(bmdVideoOutputRP188 | bmdVideoOutputVANC);
+	com_ptr<IDeckLinkDisplayMode>	deckLinkDisplayMode;
+	dlbool_t						displayModeSupported;
+	BMDSupportedVideoModeFlags		supportedVideoModeFlags = enable3D ? bmdSupportedVideoModeDualStream3D : bmdSupportedVideoModeDefault;
+
 	if ((m_deckLinkOutput->DoesSupportVideoMode(bmdVideoConnectionUnspecified, displayMode, pixelFormat, bmdNoVideoOutputConversion, supportedVideoModeFlags, nullptr, &displayModeSupported) != S_OK) ||
 		!displayModeSupported)
 		return false;
@@ -216,22 +279,7 @@ bool DeckLinkOutputDevice::startPlayback(BMDDisplayMode displayMode, bool enable
 			return false;
 	}
 
-	if (m_deckLinkOutput->BeginAudioPreroll() != S_OK)
-		return false;
-
-	m_outputVideoFrameQueue.reset();
-	m_outputAudioPacketQueue.reset();
-	
-	// Start scheduling threads
-	m_scheduleVideoFramesThread = std::thread(&DeckLinkOutputDevice::scheduleVideoFramesThread, this);
-	m_scheduleAudioPacketsThread = std::thread(&DeckLinkOutputDevice::scheduleAudioPacketsThread, this);
-
-	{
-		std::lock_guard<std::mutex> lock(m_mutex);
-		m_state = PlaybackState::Prerolling;
-	}
-
-	return true;
+	return m_deckLinkOutput->BeginAudioPreroll() == S_OK;
 }
 
 void DeckLinkOutputDevice::stopPlayback()
@@ -285,9 +333,13 @@ void DeckLinkOutputDevice::stopPlayback()
 	
 	{
 		std::lock_guard<std::mutex> lock(m_mutex);
-		m_scheduledFramesList.clear();
 		m_state = PlaybackState::Idle;
 	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_scheduledFramesMutex);
+		m_scheduledFrames.clear();
+	}
 }
 
 void DeckLinkOutputDevice::cancelWaitForReference()
@@ -335,6 +387,8 @@ bool DeckLinkOutputDevice::isPlaybackActive()
 
 void DeckLinkOutputDevice::scheduleVideoFramesThread()
 {
+	FrameTrace::setThreadName("Video scheduling");
+
 	while (true)
 	{
 		std::shared_ptr<LoopThroughVideoFrame> outputFrame;
@@ -353,13 +407,22 @@ void DeckLinkOutputDevice::scheduleVideoFramesThread()
 			// Get the reference time when video frame was scheduled
 			outputFrame->setOutputFrameScheduledReferenceTime(ReferenceTime::getSteadyClockUptimeCount());
 
+			// Add to the in-flight table before scheduling, as the frame may complete before ScheduleVideoFrame returns
+			{
+				std::lock_guard<std::mutex> scheduledFramesLock(m_scheduledFramesMutex);
+				m_scheduledFrames[outputFrame->getVideoFramePtr()] = outputFrame;
+			}
+
+			FrameTrace::Scope trace("Schedule video frame", outputFrame->getVideoStreamTime());
+
 			if (m_deckLinkOutput->ScheduleVideoFrame(outputFrame->getVideoFramePtr(), outputFrame->getVideoStreamTime(), m_frameDuration, m_frameTimescale) != S_OK)
 			{
 				fprintf(stderr, "Unable to schedule output video frame\n");
+
+				std::lock_guard<std::mutex> scheduledFramesLock(m_scheduledFramesMutex);
+				m_scheduledFrames.erase(outputFrame->getVideoFramePtr());
 				break;
 			}
-			
-			m_scheduledFramesList.push_back(outputFrame);
 
 			checkEndOfPreroll();
 		}
@@ -369,10 +432,15 @@ void DeckLinkOutputDevice::scheduleVideoFramesThread()
 			break;
 		}
 	}
+
+	// Nothing consumes the queue once this thread exits, so release producers blocked on it being full
+	m_outputVideoFrameQueue.cancelWaiters();
 }
 
 void DeckLinkOutputDevice::scheduleAudioPacketsThread()
 {
+	FrameTrace::setThreadName("Audio scheduling");
+
 	while (true)
 	{
 		std::shared_ptr<LoopThroughAudioPacket> outputPacket;
@@ -390,6 +458,8 @@ void DeckLinkOutputDevice::scheduleAudioPacketsThread()
 			// Get the reference time when audio packet was scheduled
 			BMDTimeValue scheduleReferenceCount = ReferenceTime::getSteadyClockUptimeCount();
 
+			FrameTrace::Scope trace("Schedule audio packet", outputPacket->getAudioStreamTime());
+
 			if (m_deckLinkOutput->ScheduleAudioSamples(outputPacket->getBuffer(), (uint32_t)outputPacket->getSampleFrameCount(), outputPacket->getAudioStreamTime(), m_frameTimescale, nullptr) != S_OK)
 			{
 				fprintf(stderr, "Unable to schedule output audio packet\n");
@@ -410,6 +480,9 @@ void DeckLinkOutputDevice::scheduleAudioPacketsThread()
 			break;
 		}
 	}
+
+	// Nothing consumes the queue once this thread exits, so release producers blocked on it being full
+	m_outputAudioPacketQueue.cancelWaiters();
 }
 
 bool DeckLinkOutputDevice::waitForReferenceSignalToLock()
@@ -432,6 +505,7 @@ bool DeckLinkOutputDevice::waitForReferenceSignalToLock()
 void DeckLinkOutputDevice::checkEndOfPreroll()
 {
 	uint32_t prerollAudioSampleCount;
+	size_t scheduledFrameCount;
 	
 	// Ensure that both audio and video preroll have sufficient samples, then commence scheduled playback
 	if (m_state == PlaybackState::Prerolling)
@@ -443,7 +517,12 @@ void DeckLinkOutputDevice::checkEndOfPreroll()
 			return;
 		}
 
-		if ((prerollAudioSampleCount >= m_audioWaterLevel) && (m_scheduledFramesList.size() >= m_videoPrerollSize))
+		{
+			std::lock_guard<std::mutex> lock(m_scheduledFramesMutex);
+			scheduledFrameCount = m_scheduledFrames.size();
+		}
+
+		if ((prerollAudioSampleCount >= m_audioWaterLevel) && (scheduledFrameCount >= m_videoPrerollSize))
 		{
 			m_deckLinkOutput->EndAudioPreroll();
 			if (m_deckLinkOutput->StartScheduledPlayback(m_startPlaybackTime, m_frameTimescale, 1.0) != S_OK)
@@ -43,10 +43,10 @@
 #include <atomic>
 #include <condition_variable>
 #include <functional>
-#include <list>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <unordered_map>
 
 #include "DeckLinkAPI.h"
 #include "LoopThroughAudioPacket.h"
@@ -61,10 +61,10 @@ class DeckLinkOutputDevice : public IDeckLinkVideoOutputCallback, public IDeckLi
 
 	using ScheduledFrameCompletedCallback	= std::function<void(std::shared_ptr<LoopThroughVideoFrame>)>;
 	using ScheduledAudioPacketCallback		= std::function<void(std::shared_ptr<LoopThroughAudioPacket>)>;
-	
-	using ScheduledFramesList				= std::list<std::shared_ptr<LoopThroughVideoFrame>>;
 
 public:
+	using ScheduledFramesMap				= std::unordered_map<IDeckLinkVideoFrame*, std::shared_ptr<LoopThroughVideoFrame>>;
+
 	DeckLinkOutputDevice(com_ptr<IDeckLink>& deckLink, int videoPrerollSize);
 	virtual ~DeckLinkOutputDevice() = default;
 
@@ -90,8 +90,8 @@ public:
 	com_ptr<IDeckLinkOutput>	getDeckLinkOutput(void) const { return m_deckLinkOutput; }
 	bool						getReferenceSignalMode(BMDDisplayMode* mode);
 	bool						isPlaybackActive(void);
-	void						scheduleVideoFrame(std::shared_ptr<LoopThroughVideoFrame> videoFrame) { m_outputVideoFrameQueue.pushSample(videoFrame); }
-	void						scheduleAudioPacket(std::shared_ptr<LoopThroughAudioPacket> audioPacket) { m_outputAudioPacketQueue.pushSample(audioPacket); }
+	void						scheduleVideoFrame(std::shared_ptr<LoopThroughVideoFrame> videoFrame) { m_outputVideoFrameQueue.pushSample(std::move(videoFrame)); }
+	void						scheduleAudioPacket(std::shared_ptr<LoopThroughAudioPacket> audioPacket) { m_outputAudioPacketQueue.pushSample(std::move(audioPacket)); }
 
 	void						onScheduledFrameCompleted(const ScheduledFrameCompletedCallback& callback) { m_scheduledFrameCompletedCallback = callback; }
 	void						onAudioPacketScheduled(const ScheduledAudioPacketCallback& callback) { m_scheduledAudioPacketCallback = callback; }
@@ -105,7 +105,9 @@ private:
 	//
 	SampleQueue<std::shared_ptr<LoopThroughVideoFrame>>		m_outputVideoFrameQueue;
 	SampleQueue<std::shared_ptr<LoopThroughAudioPacket>>	m_outputAudioPacketQueue;
-	ScheduledFramesList										m_scheduledFramesList;
+	//
+	ScheduledFramesMap										m_scheduledFrames;			// In-flight frames, keyed by scheduled IDeckLinkVideoFrame
+	std::mutex												m_scheduledFramesMutex;
 	//
 	uint32_t												m_videoPrerollSize;
 	uint32_t												m_audioWaterLevel;
@@ -130,6 +132,7 @@ private:
 	// Private methods
 	void		scheduleVideoFramesThread(void);
 	void		scheduleAudioPacketsThread(void);
+	bool		enableOutput(BMDDisplayMode displayMode, bool enable3D, BMDPixelFormat pixelFormat, BMDAudioSampleType audioSampleType, uint32_t audioChannelCount, bool requireReferenceLocked);
 	bool		waitForReferenceSignalToLock();
 
 	void 		checkEndOfPreroll(void);
@@ -40,56 +40,109 @@
 
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
 #include <functional>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <vector>
 
+// Work-stealing dispatch queue.  Each worker owns a deque; dispatched functions are distributed
+// round-robin across the deques and an idle worker steals from the others, so there is no single
+// lock shared by every dispatch and every worker.  Functions may complete in any order, use
+// ReorderQueue where the output order matters.
+//
+// Workers can optionally be placed on the CPUs of one NUMA node (numaNode >= 0), and pinned one
+// per core (pinWorkers) to keep their caches warm.
 
 class DispatchQueue
 {
 	using DispatchFunction = std::function<void(void)>;
 
 public:
-	DispatchQueue(size_t numThreads);
+	static const int kAnyNumaNode = -1;
+
+	DispatchQueue(size_t numThreads, bool pinWorkers = false, int numaNode = kAnyNumaNode);
 	virtual ~DispatchQueue();
 
 	template<class F, class... Args>
 	void dispatch(F&& fn, Args&&... args);
 	
 private:
-	std::vector<std::thread>		m_workerThreads;
-	std::queue<DispatchFunction>	m_functionQueue;
-	std::condition_variable			m_condition;
-	std::mutex						m_mutex;
+	struct Worker
+	{
+		std::mutex						mutex;
+		std::deque<DispatchFunction>	functionQueue;
+		std::thread						thread;
+	};
+
+	std::vector<std::unique_ptr<Worker>>	m_workers;
+	std::atomic<size_t>						m_nextWorker;
+	std::atomic<size_t>						m_pendingCount;
+
+	// Idle workers sleep on the condition, dispatch only takes the mutex when a worker is asleep
+	std::mutex								m_sleepMutex;
+	std::condition_variable					m_sleepCondition;
+	std::atomic<size_t>						m_sleepingCount;
 
-	bool							m_cancelWorkers;
+	std::atomic<bool>						m_cancelWorkers;
 
-	void workerThread(void);
+	void workerThread(size_t workerIndex);
+	bool popFunction(size_t workerIndex, DispatchFunction& func);
+	bool stealFunction(size_t workerIndex, DispatchFunction& func);
+
+	static std::vector<int> getWorkerCPUs(int numaNode);
+	static void setThreadAffinity(std::thread& thread, const std::vector<int>& cpus);
 };
 
-DispatchQueue::DispatchQueue(size_t numThreads) :
+DispatchQueue::DispatchQueue(size_t numThreads, bool pinWorkers, int numaNode) :
+	m_nextWorker(0),
+	m_pendingCount(0),
+	m_sleepingCount(0),
 	m_cancelWorkers(false)
 {
+	std::vector<int> cpus;
+	if (pinWorkers || numaNode != kAnyNumaNode)
+		cpus = getWorkerCPUs(numaNode);
+
+	for (size_t i = 0; i < numThreads; i++)
+		m_workers.emplace_back(new Worker);
+
+	// Start workers once all deques exist, as any worker may steal from any other
 	for (size_t i = 0; i < numThreads; i++)
 	{
-		m_workerThreads.emplace_back(&DispatchQueue::workerThread, this);
+		m_workers[i]->thread = std::thread(&DispatchQueue::workerThread, this, i);
+
+		if (cpus.empty())
+			continue;
+
+		if (pinWorkers)
+			setThreadAffinity(m_workers[i]->thread, { cpus[i % cpus.size()] });
+		else
+			setThreadAffinity(m_workers[i]->thread, cpus);
 	}
 }
 
 DispatchQueue::~DispatchQueue()
 {
-	// Stop all threads once they have completed current job
+	// Stop all threads once they have completed all queued jobs
 	{
-		std::lock_guard<std::mutex> lock(m_mutex);
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
 		m_cancelWorkers = true;
 	}
-	m_condition.notify_all();
+	m_sleepCondition.notify_all();
 
-	for (auto& worker : m_workerThreads)
+	for (auto& worker : m_workers)
 	{
-		worker.join();
+		worker->thread.join();
 	}
 }
 
@@ -97,39 +150,135 @@ template<class F, class... Args>
 void DispatchQueue::dispatch(F&& fn, Args&& ...args)
 {
 	using DispatchFunctionBinding = decltype(std::bind(std::declval<F>(), std::declval<Args>()...));
+
+	Worker& worker = *m_workers[m_nextWorker.fetch_add(1, std::memory_order_relaxed) % m_workers.size()];
+
+	// Count the function before it becomes visible, so the count never drops below the queued functions.
+	// A worker going to sleep increments m_sleepingCount before checking m_pendingCount, so either it sees
+	// this function or it is counted below and woken.
+	m_pendingCount.fetch_add(1);
+	{
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.functionQueue.push_back(DispatchFunctionBinding(std::forward<F>(fn), std::forward<Args>(args)...));
+	}
+
+	if (m_sleepingCount.load() > 0)
 	{
-		std::lock_guard<std::mutex> lock(m_mutex);
-		m_functionQueue.push(DispatchFunctionBinding(std::forward<F>(fn), std::forward<Args>(args)...));
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_sleepCondition.notify_one();
 	}
-	m_condition.notify_one();
 }
 
-void DispatchQueue::workerThread()
+void DispatchQueue::workerThread(size_t workerIndex)
 {
 	while (true)
 	{
+		DispatchFunction func;
+
+		if (popFunction(workerIndex, func) || stealFunction(workerIndex, func))
 		{
-			std::unique_lock<std::mutex> lock(m_mutex);
-			m_condition.wait(lock, [&] { return !m_functionQueue.empty() || m_cancelWorkers; });
+			m_pendingCount.fetch_sub(1);
+			func();
+			continue;
 		}
 
-		while (true)
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+
+		if (m_cancelWorkers && m_pendingCount.load() == 0)
+			// Exit thread
+			break;
+
+		m_sleepingCount.fetch_add(1);
+		m_sleepCondition.wait(lock, [&] { return m_pendingCount.load() > 0 || m_cancelWorkers; });
+		m_sleepingCount.fetch_sub(1);
+	}
+}
+
+bool DispatchQueue::popFunction(size_t workerIndex, DispatchFunction& func)
+{
+	// Owner takes the oldest function so that frames are processed in arrival order where possible
+	Worker& worker = *m_workers[workerIndex];
+	std::lock_guard<std::mutex> lock(worker.mutex);
+
+	if (worker.functionQueue.empty())
+		return false;
+
+	func = std::move(worker.functionQueue.front());
+	worker.functionQueue.pop_front();
+	return true;
+}
+
+bool DispatchQueue::stealFunction(size_t workerIndex, DispatchFunction& func)
+{
+	// Thieves take from the back of a victim's deque, away from the end its owner is using
+	for (size_t i = 1; i < m_workers.size(); i++)
+	{
+		Worker& victim = *m_workers[(workerIndex + i) % m_workers.size()];
+		std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+
+		if (!lock.owns_lock() || victim.functionQueue.empty())
+			continue;
+
+		func = std::move(victim.functionQueue.back());
+		victim.functionQueue.pop_back();
+		return true;
+	}
+
+	return false;
+}
+
+std::vector<int> DispatchQueue::getWorkerCPUs(int numaNode)
+{
+	// CPUs this process may run on, restricted to the NUMA node's CPU list (eg "0-7,16-23") if given
+	std::vector<int>	cpus;
+	std::vector<bool>	nodeCPUs(CPU_SETSIZE, numaNode == kAnyNumaNode);
+	cpu_set_t			allowedCPUs;
+
+	if (numaNode != kAnyNumaNode)
+	{
+		std::ifstream	cpuListFile("/sys/devices/system/node/node" + std::to_string(numaNode) + "/cpulist");
+		std::string		range;
+
+		while (std::getline(cpuListFile, range, ','))
 		{
-			DispatchFunction func;
-			{
-				std::lock_guard<std::mutex> lock(m_mutex);
-				if (m_functionQueue.empty())
-					break;
+			int first = 0;
+			int last = 0;
+			char separator = '\0';
+			std::istringstream rangeStream(range);
 
-				func = std::move(m_functionQueue.front());
-				m_functionQueue.pop();
-			}
+			if (!(rangeStream >> first))
+				continue;
 
-			func();
+			last = (rangeStream >> separator >> last) ? last : first;
+
+			for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+				nodeCPUs[cpu] = true;
 		}
+	}
 
-		if (m_cancelWorkers)
-			// Exit thread
-			break;
+	if (sched_getaffinity(0, sizeof(allowedCPUs), &allowedCPUs) != 0)
+		return cpus;
+
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+	{
+		if (CPU_ISSET(cpu, &allowedCPUs) && nodeCPUs[cpu])
+			cpus.push_back(cpu);
 	}
+
+	if (cpus.empty())
+		fprintf(stderr, "No CPUs available on NUMA node %d, dispatch workers will not be placed\n", numaNode);
+
+	return cpus;
+}
+
+void DispatchQueue::setThreadAffinity(std::thread& thread, const std::vector<int>& cpus)
+{
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+
+	for (int cpu : cpus)
+		CPU_SET(cpu, &cpuSet);
+
+	if (pthread_setaffinity_np(thread.native_handle(), sizeof(cpuSet), &cpuSet) != 0)
+		fprintf(stderr, "Unable to set dispatch worker CPU affinity\n");
 }
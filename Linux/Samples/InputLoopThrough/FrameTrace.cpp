@@ -0,0 +1,245 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2020 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "FrameTrace.h"
+#include "ReferenceTime.h"
+
+namespace
+{
+	const long kSignalTrackThreadIdBase = 1000000;
+
+	struct TraceEvent
+	{
+		BMDTimeValue		timestamp;
+		BMDTimeValue		duration;
+		BMDTimeValue		streamTime;
+		const char*			name;
+		char				phase;
+		FrameTrace::Track	track;
+	};
+
+	struct ThreadBuffer
+	{
+		ThreadBuffer(size_t capacity, long threadId) :
+			events(capacity), written(0), threadName(nullptr), threadId(threadId)
+		{
+		}
+
+		std::vector<TraceEvent>		events;
+		std::atomic<uint64_t>		written;
+		std::atomic<const char*>	threadName;
+		long						threadId;
+	};
+
+	std::atomic<bool>							s_enabled(false);
+	std::atomic<size_t>							s_eventsPerThread(0);
+
+	// Registration of thread buffers, only taken on the first event of a thread and on export
+	std::mutex									s_threadBuffersMutex;
+	std::vector<std::shared_ptr<ThreadBuffer>>	s_threadBuffers;
+
+	thread_local ThreadBuffer*					t_threadBuffer = nullptr;
+
+	ThreadBuffer* getThreadBuffer(void)
+	{
+		if (t_threadBuffer == nullptr)
+		{
+			auto threadBuffer = std::make_shared<ThreadBuffer>(s_eventsPerThread.load(), (long)syscall(SYS_gettid));
+
+			std::lock_guard<std::mutex> lock(s_threadBuffersMutex);
+			s_threadBuffers.push_back(threadBuffer);
+			t_threadBuffer = threadBuffer.get();
+		}
+
+		return t_threadBuffer;
+	}
+
+	void recordEvent(const TraceEvent& event)
+	{
+		ThreadBuffer*	threadBuffer	= getThreadBuffer();
+		uint64_t		written			= threadBuffer->written.load(std::memory_order_relaxed);
+
+		threadBuffer->events[written % threadBuffer->events.size()] = event;
+		threadBuffer->written.store(written + 1, std::memory_order_release);
+	}
+
+	const char* getTrackName(FrameTrace::Track track)
+	{
+		switch (track)
+		{
+			case FrameTrace::Track::VideoInputSignal:	return "Video input signal";
+			case FrameTrace::Track::VideoOutputSignal:	return "Video output signal";
+			default:									return "";
+		}
+	}
+
+	void writeEvent(FILE* file, long processId, long threadId, const TraceEvent& event, bool& firstEvent)
+	{
+		fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":%ld,\"tid\":%ld,\"ts\":%" PRId64,
+				firstEvent ? "" : ",", event.name, event.phase, processId, threadId, (int64_t)event.timestamp);
+
+		if (event.phase == 'X')
+			fprintf(file, ",\"dur\":%" PRId64, (int64_t)event.duration);
+		else if (event.phase == 'i')
+			fprintf(file, ",\"s\":\"t\"");
+
+		fprintf(file, ",\"args\":{\"streamTime\":%" PRId64 "}}", (int64_t)event.streamTime);
+		firstEvent = false;
+	}
+
+	void writeThreadName(FILE* file, long processId, long threadId, const char* name, bool& firstEvent)
+	{
+		fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":\"%s\"}}",
+				firstEvent ? "" : ",", processId, threadId, name);
+		firstEvent = false;
+	}
+}
+
+void FrameTrace::enable(size_t eventsPerThread)
+{
+	// Buffers already created keep their size
+	s_eventsPerThread = std::max(eventsPerThread, (size_t)1);
+	s_enabled = true;
+}
+
+void FrameTrace::disable()
+{
+	s_enabled = false;
+}
+
+bool FrameTrace::isEnabled()
+{
+	return s_enabled.load(std::memory_order_relaxed);
+}
+
+void FrameTrace::setThreadName(const char* name)
+{
+	if (!isEnabled())
+		return;
+
+	getThreadBuffer()->threadName.store(name, std::memory_order_relaxed);
+}
+
+void FrameTrace::instant(const char* name, BMDTimeValue streamTime)
+{
+	if (!isEnabled())
+		return;
+
+	instant(name, streamTime, ReferenceTime::getSteadyClockUptimeCount());
+}
+
+void FrameTrace::instant(const char* name, BMDTimeValue streamTime, BMDTimeValue timestamp)
+{
+	if (!isEnabled())
+		return;
+
+	recordEvent({ timestamp, 0, streamTime, name, 'i', Track::Thread });
+}
+
+void FrameTrace::complete(Track track, const char* name, BMDTimeValue streamTime, BMDTimeValue startTime, BMDTimeValue duration)
+{
+	if (!isEnabled())
+		return;
+
+	recordEvent({ startTime, duration, streamTime, name, 'X', track });
+}
+
+FrameTrace::Scope::Scope(const char* name, BMDTimeValue streamTime) :
+	m_name(name),
+	m_streamTime(streamTime),
+	m_startTime(isEnabled() ? ReferenceTime::getSteadyClockUptimeCount() : 0)
+{
+}
+
+FrameTrace::Scope::~Scope()
+{
+	if (!isEnabled() || (m_startTime == 0))
+		return;
+
+	complete(Track::Thread, m_name, m_streamTime, m_startTime, ReferenceTime::getSteadyClockUptimeCount() - m_startTime);
+}
+
+bool FrameTrace::writeChromeTrace(const std::string& filename)
+{
+	std::lock_guard<std::mutex>	lock(s_threadBuffersMutex);
+	long						processId	= (long)getpid();
+	bool						firstEvent	= true;
+
+	FILE* file = fopen(filename.c_str(), "w");
+	if (!file)
+		return false;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+	writeThreadName(file, processId, kSignalTrackThreadIdBase + (long)Track::VideoInputSignal, getTrackName(Track::VideoInputSignal), firstEvent);
+	writeThreadName(file, processId, kSignalTrackThreadIdBase + (long)Track::VideoOutputSignal, getTrackName(Track::VideoOutputSignal), firstEvent);
+
+	for (auto& threadBuffer : s_threadBuffers)
+	{
+		const char*	threadName	= threadBuffer->threadName.load(std::memory_order_relaxed);
+		uint64_t	written		= threadBuffer->written.load(std::memory_order_acquire);
+		uint64_t	capacity	= threadBuffer->events.size();
+
+		if (threadName != nullptr)
+			writeThreadName(file, processId, threadBuffer->threadId, threadName, firstEvent);
+
+		// Oldest to newest of the events remaining in the ring buffer
+		for (uint64_t i = (written > capacity) ? written - capacity : 0; i < written; i++)
+		{
+			const TraceEvent&	event		= threadBuffer->events[i % capacity];
+			long				threadId	= (event.track == Track::Thread) ? threadBuffer->threadId : kSignalTrackThreadIdBase + (long)event.track;
+
+			writeEvent(file, processId, threadId, event, firstEvent);
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+
+	return fclose(file) == 0;
+}
@@ -0,0 +1,91 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2020 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#pragma once
+
+#include <string>
+#include "DeckLinkAPI.h"
+
+// Per-frame lifecycle tracing, written as a Chrome trace event JSON file that can be opened in
+// ui.perfetto.dev or chrome://tracing to see on a timeline which frame went late and why.
+//
+// Each thread records into its own ring buffer of events, created on its first event, so
+// recording takes no lock and keeps the latest events of each thread.  Events are stamped with
+// ReferenceTime::getSteadyClockUptimeCount() and carry the stream time of their frame or packet.
+// When tracing is disabled, a trace point costs one relaxed atomic load.
+//
+// Event names are stored by pointer and so must be string literals.
+
+namespace FrameTrace
+{
+	// Events are recorded on the calling thread, or on a track for the video signal at the connector
+	enum class Track { Thread = 0, VideoInputSignal, VideoOutputSignal };
+
+	void	enable(size_t eventsPerThread);
+	void	disable(void);
+	bool	isEnabled(void);
+
+	// Name the calling thread in the trace
+	void	setThreadName(const char* name);
+
+	// Instant event on the calling thread
+	void	instant(const char* name, BMDTimeValue streamTime);
+	void	instant(const char* name, BMDTimeValue streamTime, BMDTimeValue timestamp);
+
+	// Duration event with explicit start time and duration
+	void	complete(Track track, const char* name, BMDTimeValue streamTime, BMDTimeValue startTime, BMDTimeValue duration);
+
+	// Write all recorded events.  Call once recording has stopped, as the ring buffers are read
+	// without synchronising with threads still recording
+	bool	writeChromeTrace(const std::string& filename);
+
+	// Records a duration event for the lifetime of the scope
+	class Scope
+	{
+	public:
+		Scope(const char* name, BMDTimeValue streamTime);
+		~Scope();
+
+	private:
+		const char*		m_name;
+		BMDTimeValue	m_streamTime;
+		BMDTimeValue	m_startTime;
+	};
+};
@@ -60,9 +60,17 @@
 //     can set your video output preroll size, defined by constant kOutputVideoPreroll
 // * If the video processing pipeline is long, then you will need to increase the number of
 //     worker threads for concurrent processing.  The sample defines a dispatch queue, whose
-//     number of threads is defined by constant kDispatcherThreadCount
+//     number of threads is defined by constant kDispatcherThreadCount.  Processed frames are
+//     returned to stream time order before scheduling, so adding threads does not reorder output
+// * Dispatch worker threads can be restricted to the CPUs of a NUMA node, defined by constant
+//     kDispatcherNumaNode, and pinned one per core with constant kPinDispatcherThreads
+// * Captured frames are allocated from a pre-allocated pool, whose size is defined by constant
+//     kInputFramePoolSize.  The allocator summary reports any frames that had to be heap
+//     allocated because the pool was exhausted
 // * If there is large variance in the video processing latency, then it is recommended that
 //     the preroll is increased to reduce the risk of late or dropped frames on output
+// * Run InputLoopThrough -B to measure the cost of looking up each completed output frame
+//     against the number of frames in flight, without a DeckLink device
 //
 // Additional considerations:
 // * Ensure that a valid input source is provided with a display mode that is supported by
@@ -72,17 +80,24 @@
 //     deviation can be adjusted by constants kProcessingAdditionalTimeMean and
 //     kProcessingAdditionalTimeStdDev respectively
 // * The sample has 2 console output modes of operation, defined by constant kPrintRollingAverage
-//   - When set to true, a rolling average of latency is displayed to stdout with ms
-//     interval defined by constant kRollingAverageUpdateRateMs with rolling average
-//     sample could defined by constant kRollingAverageSampleCount
+//   - When set to true, rolling latency percentiles are displayed to stdout with ms
+//     interval defined by constant kRollingAverageUpdateRateMs, over the number of
+//     intervals defined by constant kRollingWindowCount
 //   - When set to false, the latency for every output frame is displayed to stdout
 //   - In both modes or operation, a full statistical summary is displayed when application
 //     completes
+// * When constant kEnableFrameTrace is set to true, every stage of each frame and audio packet
+//     is traced, from input on the wire through dispatch, processing and scheduling to output
+//     on the wire, and written on exit to kFrameTraceFilename for viewing in ui.perfetto.dev
+// * When constant kDecodeFrameID is set to true, the frame ID code embedded by TestPattern -i
+//     is decoded from every input frame, and the summary includes the latency from the
+//     TestPattern output to the input, and frames dropped, repeated or out of order upstream
 //*************************************************************************************/
 
 
 #include <chrono>
 #include <condition_variable>
+#include <cstring>
 #include <functional>
 #include <map>
 #include <memory>
@@ -93,9 +108,14 @@
 #include "DeckLinkInputDevice.h"
 #include "DeckLinkOutputDevice.h"
 #include "DispatchQueue.h"
+#include "ReorderQueue.h"
 #include "SampleQueue.h"
+#include "FrameTrace.h"
+#include "FrameID.h"
 #include "LatencyStatistics.h"
+#include "PooledFrameAllocator.h"
 #include "ReferenceTime.h"
+#include "ScheduledFramesBenchmark.h"
 #include "DeckLinkAPI.h"
 #include "com_ptr.h"
 #include "platform.h"
@@ -110,11 +130,25 @@ const int					kOutputVideoPreroll			= 1;		// number of output preroll frames
 const int					kVideoDispatcherThreadCount	= 3;		// number of threads used by video processing dispatcher
 const int					kAudioDispatcherThreadCount	= 2;		// number of threads used by audio processing dispatcher
 const int					kPrintDispatcherThreadCount	= 1;		// number of threads used by print stdout dispatcher
+const bool					kPinDispatcherThreads		= false;	// True to pin each video and audio dispatcher thread to its own core
+const int					kDispatcherNumaNode			= DispatchQueue::kAnyNumaNode;	// NUMA node for video and audio dispatcher threads
 
-const bool					kPrintRollingAverage		= true;		// If true, display latency as rolling average, if false print latency for each frame
-const int					kRollingAverageSampleCount	= 300;		// Number of samples for calculating rolling average of latency
+const uint32_t				kInputFramePoolSize			= 32;		// number of pooled capture frame buffers, frames beyond this are heap allocated
+const bool					kInputFrameHugePages		= true;		// True to back pooled capture frames with huge pages
+const bool					kLockInputFrameMemory		= false;	// True to lock pooled capture frames into RAM, subject to RLIMIT_MEMLOCK
+
+const bool					kPrintRollingAverage		= true;		// If true, display rolling latency percentiles, if false print latency for each frame
+const int					kRollingWindowCount			= 5;		// Number of print intervals covered by the rolling latency percentiles
 const long					kRollingAverageUpdateRateMs	= 2000;		// Print rolling average every 2 seconds
 
+const bool					kEnableFrameTrace			= false;	// True to record the lifecycle of every frame and packet, written on exit as a Chrome/Perfetto trace
+const char* const			kFrameTraceFilename			= "InputLoopThrough.trace.json";
+const size_t				kFrameTraceEventsPerThread	= 65536;	// Each thread keeps its latest events
+
+const double				kScheduledFramesBenchmarkSeconds	= 5.0;		// Duration of InputLoopThrough -B
+
+const bool					kDecodeFrameID				= false;	// True to decode the frame ID code of TestPattern -i from each input frame
+
 const double				kProcessingAdditionalTimeMean		= 5.0;		// Mean additional time injected into video processing thread (ms)
 const double				kProcessingAdditionalTimeStdDev		= 0.1;		// Standard deviation of time injected into video processing thread (ms)
 
@@ -180,10 +214,12 @@ private:
 
 uint32_t														g_audioChannelCount = kDefaultAudioChannelCount;
 
-LatencyStatistics												g_videoInputLatencyStatistics(kRollingAverageSampleCount);
-LatencyStatistics												g_videoProcessingLatencyStatistics(kRollingAverageSampleCount);
-LatencyStatistics												g_videoOutputLatencyStatistics(kRollingAverageSampleCount);
-LatencyStatistics												g_audioProcessingLatencyStatistics(kRollingAverageSampleCount);
+LatencyStatistics												g_videoInputLatencyStatistics(kRollingWindowCount);
+LatencyStatistics												g_videoProcessingLatencyStatistics(kRollingWindowCount);
+LatencyStatistics												g_videoOutputLatencyStatistics(kRollingWindowCount);
+LatencyStatistics												g_audioProcessingLatencyStatistics(kRollingWindowCount);
+LatencyStatistics												g_frameIDLatencyStatistics(kRollingWindowCount);
+FrameIDTracker													g_frameIDTracker;
 
 std::map<BMDOutputFrameCompletionResult, int>					g_frameCompletionResultCount;
 int 															g_outputFrameCount = 0;
@@ -226,19 +262,27 @@ void dispatch_printf(DispatchQueue& dispatchQueue, const char* format, Args... a
 	});
 }
 
-void processVideo(std::shared_ptr<LoopThroughVideoFrame>& videoFrame, com_ptr<DeckLinkOutputDevice>& deckLinkOutput)
+using VideoReorderQueue = ReorderQueue<std::shared_ptr<LoopThroughVideoFrame>>;
+
+void processVideo(std::shared_ptr<LoopThroughVideoFrame>& videoFrame, com_ptr<DeckLinkOutputDevice>& deckLinkOutput, VideoReorderQueue& videoReorderQueue)
 {
 	// Main video processing function, it is intended to invoke with DispatchQueue to allow multi-threading of incoming frames
 	// Inputs:	videoFrame - input/output video frame with stream time
 	//			deckLinkOutput - reference to IDeckLinkOutput
-	// At end of function, queue output frame for scheduling by calling deckLinkOutput->scheduleVideoFrame
+	// At end of function, return the output frame to videoReorderQueue, which queues frames for scheduling in stream order
 	//
 	// Developers are encouraged to insert their own processing test code in this function, by default we will simply forward the LoopThroughVideoFrame object.
 	// The input frame may be replaced by another IDeckLinkVideoFrame object for output by calling LoopThroughVideoFrame::setVideoFrame()
 
+	FrameTrace::setThreadName("Video processing");
+	FrameTrace::Scope trace("Process video", videoFrame->getVideoStreamTime());
+
 	// Check playback is active, if it is inactive, it is likely that the incoming display mode is not supported by output
 	if (!deckLinkOutput->isPlaybackActive())
+	{
+		videoReorderQueue.skip(videoFrame->getVideoStreamTime());
 		return;
+	}
 
 	// Simulate doing something by using a busy wait loop
 	// This is more precise than sleeping
@@ -249,7 +293,8 @@ void processVideo(std::shared_ptr<LoopThroughVideoFrame>& videoFrame, com_ptr<De
 		++i;
 
 	// At end of function, remember to queue your output frame
-	deckLinkOutput->scheduleVideoFrame(std::move(videoFrame));
+	BMDTimeValue streamTime = videoFrame->getVideoStreamTime();
+	videoReorderQueue.complete(streamTime, std::move(videoFrame));
 }
 
 
@@ -263,6 +308,9 @@ void processAudio(std::shared_ptr<LoopThroughAudioPacket>& audioPacket, com_ptr<
 	// Developers are encouraged to insert their own processing test code in this function, by default we will simply forward the LoopThroughAudioPacket object.
 	// The input audio packet may be replaced by another void* buffer for output by calling LoopThroughAudioPacket::setAudioPacket()
 
+	FrameTrace::setThreadName("Audio processing");
+	FrameTrace::Scope trace("Process audio", audioPacket->getAudioStreamTime());
+
 	// Check playback is active, if it is inactive, it is likely that the incoming display mode is not supported by output
 	if (!deckLinkOutput->isPlaybackActive())
 		return;
@@ -334,6 +382,17 @@ void printOutputCompletionResult(std::shared_ptr<LoopThroughVideoFrame> complete
 	}
 }
 
+void decodeFrameID(const std::shared_ptr<LoopThroughVideoFrame>& videoFrame)
+{
+	FrameID	frameID;
+	bool	decoded = ReadFrameID(videoFrame->getVideoFramePtr(), frameID);
+
+	// Frame ID timestamps and reference times are both CLOCK_MONOTONIC_RAW microseconds
+	int64_t latency = g_frameIDTracker.AddFrame(decoded ? &frameID : nullptr, videoFrame->getInputFrameArrivedReferenceTime());
+	if (latency >= 0)
+		g_frameIDLatencyStatistics.addSample(latency);
+}
+
 void updateCompletedFrameLatency(std::shared_ptr<LoopThroughVideoFrame> completedFrame, DispatchQueue& printDispatchQueue)
 {
 	bool frameDisplayed;
@@ -372,13 +431,26 @@ void printRollingAverage(DispatchQueue& printDispatchQueue)
 		std::unique_lock<std::mutex> lock(g_printRollingAverageNotifier.mutex);
 		if (!g_printRollingAverageNotifier.condition.wait_for(lock, printRollingAveragePeriod, [] { return g_printRollingAverageNotifier.isNotifiedLocked(); }))
 		{
-			// Timeout, print rolling average
+			// Timeout, print rolling latency percentiles and start a new window
+			LatencyHistogram inputLatency		= g_videoInputLatencyStatistics.getRollingSnapshot();
+			LatencyHistogram processingLatency	= g_videoProcessingLatencyStatistics.getRollingSnapshot();
+			LatencyHistogram outputLatency		= g_videoOutputLatencyStatistics.getRollingSnapshot();
+
+			g_videoInputLatencyStatistics.rotateWindow();
+			g_videoProcessingLatencyStatistics.rotateWindow();
+			g_videoOutputLatencyStatistics.rotateWindow();
+			g_audioProcessingLatencyStatistics.rotateWindow();
+			g_frameIDLatencyStatistics.rotateWindow();
+
 			dispatch_printf(printDispatchQueue,
-							"%d frames output; Average latency: Input = %.2f ms, Processing = %.2f ms, Output = %.2f ms\n",
+							"%d frames output; Latency p50/p99: Input = %.2f/%.2f ms, Processing = %.2f/%.2f ms, Output = %.2f/%.2f ms\n",
 							g_outputFrameCount,
-							(double)g_videoInputLatencyStatistics.getRollingAverage() / ReferenceTime::kTicksPerMilliSec,
-							(double)g_videoProcessingLatencyStatistics.getRollingAverage() / ReferenceTime::kTicksPerMilliSec,
-							(double)g_videoOutputLatencyStatistics.getRollingAverage() / ReferenceTime::kTicksPerMilliSec);
+							(double)inputLatency.getPercentile(50.0) / ReferenceTime::kTicksPerMilliSec,
+							(double)inputLatency.getPercentile(99.0) / ReferenceTime::kTicksPerMilliSec,
+							(double)processingLatency.getPercentile(50.0) / ReferenceTime::kTicksPerMilliSec,
+							(double)processingLatency.getPercentile(99.0) / ReferenceTime::kTicksPerMilliSec,
+							(double)outputLatency.getPercentile(50.0) / ReferenceTime::kTicksPerMilliSec,
+							(double)outputLatency.getPercentile(99.0) / ReferenceTime::kTicksPerMilliSec);
 		}
 		else
 		{
@@ -387,6 +459,19 @@ void printRollingAverage(DispatchQueue& printDispatchQueue)
 	}
 }
 
+void printLatencySummary(const char* latencyName, const LatencyHistogram& latency, DispatchQueue& printDispatchQueue)
+{
+	dispatch_printf(printDispatchQueue,
+					"%sp50 = %6.2f ms, p90 = %6.2f ms, p99 = %6.2f ms, p99.9 = %6.2f ms, Maximum = %6.2f ms, Mean = %6.2f ms\n",
+					latencyName,
+					(double)latency.getPercentile(50.0) / ReferenceTime::kTicksPerMilliSec,
+					(double)latency.getPercentile(90.0) / ReferenceTime::kTicksPerMilliSec,
+					(double)latency.getPercentile(99.0) / ReferenceTime::kTicksPerMilliSec,
+					(double)latency.getPercentile(99.9) / ReferenceTime::kTicksPerMilliSec,
+					(double)latency.getMaximum() / ReferenceTime::kTicksPerMilliSec,
+					(double)latency.getMean() / ReferenceTime::kTicksPerMilliSec);
+}
+
 void printOutputSummary(DispatchQueue& printDispatchQueue)
 {
 	int displayedFrames = 0;
@@ -406,40 +491,24 @@ void printOutputSummary(DispatchQueue& printDispatchQueue)
 	}
 	if (displayedFrames > 0)
 	{
-		BMDTimeValue mean;
-		BMDTimeValue stddev;
-		
-		std::tie(mean, stddev) = g_videoInputLatencyStatistics.getMeanAndStdDev();
-		dispatch_printf(printDispatchQueue,
-						"\nVideo Input Latency:\t\tMinimum = %6.2f ms, Maximum = %6.2f ms, Mean = %6.2f ms, StdDev = %.2f ms\n",
-						(double)g_videoInputLatencyStatistics.getMinimum() / ReferenceTime::kTicksPerMilliSec,
-						(double)g_videoInputLatencyStatistics.getMaximum() / ReferenceTime::kTicksPerMilliSec,
-						(double)mean / ReferenceTime::kTicksPerMilliSec,
-						(double)stddev / ReferenceTime::kTicksPerMilliSec);
-		
-		std::tie(mean, stddev) = g_videoProcessingLatencyStatistics.getMeanAndStdDev();
-		dispatch_printf(printDispatchQueue,
-						"Video Processing Latency:\tMinimum = %6.2f ms, Maximum = %6.2f ms, Mean = %6.2f ms, StdDev = %.2f ms\n",
-						(double)g_videoProcessingLatencyStatistics.getMinimum() / ReferenceTime::kTicksPerMilliSec,
-						(double)g_videoProcessingLatencyStatistics.getMaximum() / ReferenceTime::kTicksPerMilliSec,
-						(double)mean / ReferenceTime::kTicksPerMilliSec,
-						(double)stddev / ReferenceTime::kTicksPerMilliSec);
-
-		std::tie(mean, stddev) = g_videoOutputLatencyStatistics.getMeanAndStdDev();
-		dispatch_printf(printDispatchQueue,
-						"Video Output Latency:\t\tMinimum = %6.2f ms, Maximum = %6.2f ms, Mean = %6.2f ms, StdDev = %.2f ms\n",
-						(double)g_videoOutputLatencyStatistics.getMinimum() / ReferenceTime::kTicksPerMilliSec,
-						(double)g_videoOutputLatencyStatistics.getMaximum() / ReferenceTime::kTicksPerMilliSec,
-						(double)mean / ReferenceTime::kTicksPerMilliSec,
-						(double)stddev / ReferenceTime::kTicksPerMilliSec);
-		
-		std::tie(mean, stddev) = g_audioProcessingLatencyStatistics.getMeanAndStdDev();
-		dispatch_printf(printDispatchQueue,
-						"Audio Processing Latency:\tMinimum = %6.2f ms, Maximum = %6.2f ms, Mean = %6.2f ms, StdDev = %.2f ms\n",
-						(double)g_audioProcessingLatencyStatistics.getMinimum() / ReferenceTime::kTicksPerMilliSec,
-						(double)g_audioProcessingLatencyStatistics.getMaximum() / ReferenceTime::kTicksPerMilliSec,
-						(double)mean / ReferenceTime::kTicksPerMilliSec,
-						(double)stddev / ReferenceTime::kTicksPerMilliSec);	}
+		printLatencySummary("\nVideo Input Latency:\t\t", g_videoInputLatencyStatistics.getSnapshot(), printDispatchQueue);
+		printLatencySummary("Video Processing Latency:\t", g_videoProcessingLatencyStatistics.getSnapshot(), printDispatchQueue);
+		printLatencySummary("Video Output Latency:\t\t", g_videoOutputLatencyStatistics.getSnapshot(), printDispatchQueue);
+		printLatencySummary("Audio Processing Latency:\t", g_audioProcessingLatencyStatistics.getSnapshot(), printDispatchQueue);
+	}
+	if (kDecodeFrameID)
+	{
+		FrameIDStatistics frameIDStatistics = g_frameIDTracker.GetStatistics();
+
+		dispatch_printf(printDispatchQueue, "\nFrame ID decoded: %llu, not found: %llu, dropped: %llu, repeated: %llu, out of order: %llu\n",
+						(unsigned long long)frameIDStatistics.framesDecoded,
+						(unsigned long long)frameIDStatistics.framesUndecodable,
+						(unsigned long long)frameIDStatistics.framesDropped,
+						(unsigned long long)frameIDStatistics.framesRepeated,
+						(unsigned long long)frameIDStatistics.framesOutOfOrder);
+		if (frameIDStatistics.latencyCount > 0)
+			printLatencySummary("Frame ID Latency:\t\t", g_frameIDLatencyStatistics.getSnapshot(), printDispatchQueue);
+	}
 }
 
 void printReferenceStatus(com_ptr<DeckLinkOutputDevice>& deckLinkOutput, DispatchQueue& printDispatchQueue)
@@ -470,6 +539,17 @@ void printReferenceStatus(com_ptr<DeckLinkOutputDevice>& deckLinkOutput, Dispatc
 	}
 }
 
+void printFrameAllocatorSummary(const PooledFrameAllocatorStatistics& statistics, DispatchQueue& printDispatchQueue)
+{
+	dispatch_printf(printDispatchQueue,
+					"Capture Frame Allocator:\tPooled = %llu, Heap = %llu, Slabs = %llu, Peak in use = %u%s\n",
+					(unsigned long long)statistics.poolAllocations,
+					(unsigned long long)statistics.fallbackAllocations,
+					(unsigned long long)statistics.slabAllocations,
+					statistics.peakBuffersInUse,
+					statistics.fallbackAllocations > 0 ? " (increase kInputFramePoolSize)" : "");
+}
+
 HRESULT InputLoopThrough(void)
 {
 	HRESULT								result = S_OK;
@@ -478,13 +558,20 @@ HRESULT InputLoopThrough(void)
 	com_ptr<IDeckLink>					deckLink;
 	com_ptr<DeckLinkInputDevice>		deckLinkInput;
 	com_ptr<DeckLinkOutputDevice>		deckLinkOutput;
+	com_ptr<PooledFrameAllocator>		inputFrameAllocator = make_com_ptr<PooledFrameAllocator>(kInputFramePoolSize, kInputFrameHugePages, kLockInputFrameMemory, kDispatcherNumaNode);
+
+	// Reorder queue must outlive the video dispatch queue, whose workers complete frames into it
+	VideoReorderQueue					videoReorderQueue([&](std::shared_ptr<LoopThroughVideoFrame> videoFrame) { deckLinkOutput->scheduleVideoFrame(std::move(videoFrame)); });
 
-	DispatchQueue 						videoDispatchQueue(kVideoDispatcherThreadCount);
-	DispatchQueue 						audioDispatchQueue(kAudioDispatcherThreadCount);
+	DispatchQueue 						videoDispatchQueue(kVideoDispatcherThreadCount, kPinDispatcherThreads, kDispatcherNumaNode);
+	DispatchQueue 						audioDispatchQueue(kAudioDispatcherThreadCount, kPinDispatcherThreads, kDispatcherNumaNode);
 	DispatchQueue						printDispatchQueue(kPrintDispatcherThreadCount);
 	
 	std::thread							printRollingAverageThread;
 
+	if (kEnableFrameTrace)
+		FrameTrace::enable(kFrameTraceEventsPerThread);
+
 	result = GetDeckLinkIterator(deckLinkIterator.releaseAndGetAddressOf());
 	if (result != S_OK)
 		return result;
@@ -531,6 +618,7 @@ HRESULT InputLoopThrough(void)
 					try
 					{
 						deckLinkInput = make_com_ptr<DeckLinkInputDevice>(deckLink);
+						deckLinkInput->setFrameAllocator(inputFrameAllocator.get());
 					}
 					catch (const std::exception& e)
 					{
@@ -620,8 +708,20 @@ HRESULT InputLoopThrough(void)
 			g_loopThroughSessionNotifier.condition.notify_all();
 		});
 
-		deckLinkInput->onVideoInputArrived([&](std::shared_ptr<LoopThroughVideoFrame> videoFrame) { videoDispatchQueue.dispatch(processVideo, videoFrame, deckLinkOutput); });
-		deckLinkInput->onAudioInputArrived([&](std::shared_ptr<LoopThroughAudioPacket> audioPacket) { audioDispatchQueue.dispatch(processAudio, audioPacket, deckLinkOutput); });
+		deckLinkInput->onVideoInputArrived([&](std::shared_ptr<LoopThroughVideoFrame> videoFrame)
+		{
+			if (kDecodeFrameID)
+				decodeFrameID(videoFrame);
+
+			videoReorderQueue.expect(videoFrame->getVideoStreamTime());
+			FrameTrace::instant("Video dispatch", videoFrame->getVideoStreamTime());
+			videoDispatchQueue.dispatch(processVideo, videoFrame, deckLinkOutput, std::ref(videoReorderQueue));
+		});
+		deckLinkInput->onAudioInputArrived([&](std::shared_ptr<LoopThroughAudioPacket> audioPacket)
+		{
+			FrameTrace::instant("Audio dispatch", audioPacket->getAudioStreamTime());
+			audioDispatchQueue.dispatch(processAudio, audioPacket, deckLinkOutput);
+		});
 		deckLinkInput->onVideoInputFrameDropped([&](BMDTimeValue streamTime, BMDTimeValue frameDuration, BMDTimeScale) { printDroppedCaptureFrame(streamTime, frameDuration, std::ref(printDispatchQueue)); });
 
 		// Register output callbacks
@@ -678,14 +778,18 @@ HRESULT InputLoopThrough(void)
 	
 		deckLinkInput->stopCapture();
 		deckLinkOutput->stopPlayback();
+		videoReorderQueue.reset();
 
 		printOutputSummary(printDispatchQueue);
+		printFrameAllocatorSummary(inputFrameAllocator->getStatistics(), printDispatchQueue);
 
 		// Reset statistics
 		g_videoInputLatencyStatistics.reset();
 		g_videoProcessingLatencyStatistics.reset();
 		g_videoOutputLatencyStatistics.reset();
 		g_audioProcessingLatencyStatistics.reset();
+		g_frameIDLatencyStatistics.reset();
+		g_frameIDTracker.Reset();
 
 		g_frameCompletionResultCount.clear();
 		g_outputFrameCount = 0;
@@ -724,6 +828,15 @@ HRESULT InputLoopThrough(void)
 	if (userInputThread.joinable())
 		userInputThread.join();
 
+	if (kEnableFrameTrace)
+	{
+		FrameTrace::disable();
+		if (FrameTrace::writeChromeTrace(kFrameTraceFilename))
+			dispatch_printf(printDispatchQueue, "\nFrame trace written to %s\n", kFrameTraceFilename);
+		else
+			fprintf(stderr, "Unable to write frame trace to %s\n", kFrameTraceFilename);
+	}
+
 	dispatch_printf(printDispatchQueue, "\nInputLoopThrough complete\n\n");
 
 	return result;
@@ -734,6 +847,18 @@ int main(int argc, const char * argv[])
 	HRESULT		result;
 	int			exitStatus = EXIT_FAILURE;
 
+	// InputLoopThrough -B benchmarks the output completion lookup against preroll depth, without a DeckLink device
+	if ((argc == 2) && (strcmp(argv[1], "-B") == 0))
+	{
+		runScheduledFramesBenchmark(kScheduledFramesBenchmarkSeconds);
+		return EXIT_SUCCESS;
+	}
+	else if (argc > 1)
+	{
+		fprintf(stderr, "Usage: %s [-B]\n    -B  Benchmark the in-flight output frame lookup against preroll depth\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
 	result = InputLoopThrough();
 	if (result == S_OK)
 		exitStatus = EXIT_SUCCESS;;
@@ -39,89 +39,285 @@
  */
 
 #include <algorithm>
-#include <cmath>
 #include <limits>
+#include <stdexcept>
 #include "LatencyStatistics.h"
 
+static const BMDTimeValue kNoMinimum = (std::numeric_limits<BMDTimeValue>::max)();
+static const BMDTimeValue kNoMaximum = (std::numeric_limits<BMDTimeValue>::min)();
 
-LatencyStatistics::LatencyStatistics(int maxRollingSamples) :
-	m_maxRollingSamples(maxRollingSamples)
+// Bitmask of the thread shards owned by running threads, the same shard index is used by a
+// thread for every LatencyStatistics
+static std::atomic<uint32_t> s_threadShardOwners(0);
+
+class ThreadShardOwner
+{
+public:
+	ThreadShardOwner(int threadShardCount, int sharedShard) :
+		m_shard(sharedShard)
+	{
+		uint32_t owners = s_threadShardOwners.load();
+		while (true)
+		{
+			int freeShard = 0;
+			while ((freeShard < threadShardCount) && (owners & (1u << freeShard)))
+				freeShard++;
+
+			if (freeShard == threadShardCount)
+				break;
+
+			if (s_threadShardOwners.compare_exchange_weak(owners, owners | (1u << freeShard)))
+			{
+				m_shard = freeShard;
+				m_owned = true;
+				break;
+			}
+		}
+	}
+
+	~ThreadShardOwner()
+	{
+		if (m_owned)
+			s_threadShardOwners &= ~(1u << m_shard);
+	}
+
+	int getShard(void) const { return m_shard; }
+
+private:
+	int		m_shard;
+	bool	m_owned = false;
+};
+
+/* LatencyHistogram */
+
+const int			LatencyHistogram::kLinearBucketCount;
+const int			LatencyHistogram::kSubBucketBits;
+const int			LatencyHistogram::kBucketCount;
+const BMDTimeValue	LatencyHistogram::kMaximumValue;
+
+LatencyHistogram::LatencyHistogram()
 {
-	if (m_maxRollingSamples < 1)
-		throw std::invalid_argument("Unexpected value for rolling average size");
-	
 	reset();
 }
 
-void LatencyStatistics::reset()
+void LatencyHistogram::reset()
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-	
-	m_rollingSamples.clear();
-	m_rollingAggregateLatency = 0;
-	
-	m_maxLatency	= (std::numeric_limits<BMDTimeValue>::min)();
-	m_minLatency	= (std::numeric_limits<BMDTimeValue>::max)();
-	
-	m_mean			= 0;
-	m_m2			= 0;
+	m_counts.fill(0);
 	m_sampleCount	= 0;
+	m_sum			= 0;
+	m_minLatency	= kNoMinimum;
+	m_maxLatency	= kNoMaximum;
 }
 
-void LatencyStatistics::addSample(const BMDTimeValue latency)
+int LatencyHistogram::getBucketIndex(BMDTimeValue latency)
 {
-	BMDTimeValue delta;
-	BMDTimeValue delta2;
-	
-	std::lock_guard<std::mutex> lock(m_mutex);
-	
-	// Add to rolling average list
-	if (m_rollingSamples.size() >= (size_t)m_maxRollingSamples)
+	uint64_t value = (uint64_t)std::min(std::max(latency, (BMDTimeValue)0), kMaximumValue);
+	if (value < kLinearBucketCount)
+		return (int)value;
+
+	// Each power of two from 2^6 is split into 2^kSubBucketBits buckets
+	int msb = 63 - __builtin_clzll(value);
+	int shift = msb - kSubBucketBits;
+	return kLinearBucketCount + (msb - 6) * (1 << kSubBucketBits) + (int)((value >> shift) & ((1 << kSubBucketBits) - 1));
+}
+
+BMDTimeValue LatencyHistogram::getBucketLowestValue(int bucketIndex)
+{
+	if (bucketIndex < kLinearBucketCount)
+		return bucketIndex;
+
+	int msb = 6 + (bucketIndex - kLinearBucketCount) / (1 << kSubBucketBits);
+	int subBucket = (bucketIndex - kLinearBucketCount) % (1 << kSubBucketBits);
+	return ((BMDTimeValue)((1 << kSubBucketBits) + subBucket)) << (msb - kSubBucketBits);
+}
+
+BMDTimeValue LatencyHistogram::getBucketHighestValue(int bucketIndex)
+{
+	if (bucketIndex < kLinearBucketCount)
+		return bucketIndex;
+
+	int msb = 6 + (bucketIndex - kLinearBucketCount) / (1 << kSubBucketBits);
+	return getBucketLowestValue(bucketIndex) + (1LL << (msb - kSubBucketBits)) - 1;
+}
+
+void LatencyHistogram::addSample(BMDTimeValue latency)
+{
+	m_counts[getBucketIndex(latency)]++;
+	m_sampleCount++;
+	m_sum += latency;
+	m_minLatency = std::min(m_minLatency, latency);
+	m_maxLatency = std::max(m_maxLatency, latency);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+	for (int i = 0; i < kBucketCount; i++)
+		m_counts[i] += other.m_counts[i];
+
+	m_sampleCount	+= other.m_sampleCount;
+	m_sum			+= other.m_sum;
+	m_minLatency	= std::min(m_minLatency, other.m_minLatency);
+	m_maxLatency	= std::max(m_maxLatency, other.m_maxLatency);
+}
+
+BMDTimeValue LatencyHistogram::getMinimum() const
+{
+	return (m_sampleCount > 0) ? m_minLatency : 0;
+}
+
+BMDTimeValue LatencyHistogram::getMaximum() const
+{
+	return (m_sampleCount > 0) ? m_maxLatency : 0;
+}
+
+BMDTimeValue LatencyHistogram::getMean() const
+{
+	return (m_sampleCount > 0) ? m_sum / (BMDTimeValue)m_sampleCount : 0;
+}
+
+BMDTimeValue LatencyHistogram::getPercentile(double percentile) const
+{
+	if (m_sampleCount == 0)
+		return 0;
+
+	// Rank of the sample at the percentile, counting from 1
+	double		clampedPercentile	= std::min(std::max(percentile, 0.0), 100.0);
+	uint64_t	rank				= std::max((uint64_t)(clampedPercentile / 100.0 * m_sampleCount + 0.5), (uint64_t)1);
+	uint64_t	cumulativeCount		= 0;
+
+	for (int i = 0; i < kBucketCount; i++)
 	{
-		m_rollingAggregateLatency -= m_rollingSamples.front();
-		m_rollingSamples.pop_front();
+		cumulativeCount += m_counts[i];
+		if (cumulativeCount >= rank)
+			return std::min(std::max(getBucketHighestValue(i), m_minLatency), m_maxLatency);
 	}
-	
-	m_rollingAggregateLatency += latency;
-	m_rollingSamples.push_back(latency);
-	
-	// Check minimum and maximum latency
-	m_maxLatency = std::max(m_maxLatency, latency);
-	m_minLatency = std::min(m_minLatency, latency);
-	
-	// Compute new mean/variance (Welford's algorithm)
-	delta = latency - m_mean;
-	m_mean += delta / ++m_sampleCount;
-	delta2 = latency - m_mean;
-	m_m2 += delta * delta2;
+
+	return m_maxLatency;
 }
 
-BMDTimeValue LatencyStatistics::getMinimum()
+/* LatencyStatistics */
+
+const int LatencyStatistics::kThreadShardCount;
+const int LatencyStatistics::kSharedShard;
+
+int LatencyStatistics::getThreadShard()
+{
+	thread_local ThreadShardOwner threadShardOwner(kThreadShardCount, kSharedShard);
+	return threadShardOwner.getShard();
+}
+
+LatencyStatistics::LatencyStatistics(int windowCount) :
+	m_windowCount(windowCount),
+	m_currentWindow(0)
+{
+	if (m_windowCount < 1)
+		throw std::invalid_argument("Unexpected value for latency window count");
+
+	for (auto& shard : m_shards)
+		shard.windows.reset(new WindowHistogram[m_windowCount]());
+
+	reset();
+}
+
+void LatencyStatistics::reset()
 {
 	std::lock_guard<std::mutex> lock(m_mutex);
-	return m_minLatency;
+	LatencyHistogram discarded;
+
+	for (int window = 0; window < m_windowCount; window++)
+		drainWindow(window, discarded);
+
+	m_retired.reset();
+}
+
+void LatencyStatistics::addSample(const BMDTimeValue latency)
+{
+	int					shard		= getThreadShard();
+	WindowHistogram&	histogram	= m_shards[shard].windows[m_currentWindow.load(std::memory_order_relaxed)];
+	std::atomic<uint32_t>& count	= histogram.counts[LatencyHistogram::getBucketIndex(latency)];
+
+	// Increments are atomic even on an owned shard, as drainWindow() exchanges the counters from
+	// another thread.  The shard's cache lines stay with this thread, so they are uncontended
+	count.fetch_add(1, std::memory_order_relaxed);
+	histogram.sum.fetch_add(latency, std::memory_order_relaxed);
+
+	// The minimum and maximum rarely change, so only compare-exchange when they do
+	BMDTimeValue minLatency = histogram.minLatency.load(std::memory_order_relaxed);
+	while ((latency < minLatency) && !histogram.minLatency.compare_exchange_weak(minLatency, latency, std::memory_order_relaxed))
+		;
+
+	BMDTimeValue maxLatency = histogram.maxLatency.load(std::memory_order_relaxed);
+	while ((latency > maxLatency) && !histogram.maxLatency.compare_exchange_weak(maxLatency, latency, std::memory_order_relaxed))
+		;
 }
 
-BMDTimeValue LatencyStatistics::getMaximum()
+void LatencyStatistics::rotateWindow()
 {
 	std::lock_guard<std::mutex> lock(m_mutex);
-	return m_maxLatency;
+
+	// The next window is the oldest, fold it into the retired totals before recording into it.
+	// A sample recorded by a thread that read the window index before the rotation is counted
+	// in the window it was recorded to
+	int nextWindow = (m_currentWindow.load(std::memory_order_relaxed) + 1) % m_windowCount;
+	drainWindow(nextWindow, m_retired);
+	m_currentWindow.store(nextWindow, std::memory_order_relaxed);
 }
 
-std::pair<BMDTimeValue,BMDTimeValue> LatencyStatistics::getMeanAndStdDev()
+LatencyHistogram LatencyStatistics::getSnapshot()
 {
 	std::lock_guard<std::mutex> lock(m_mutex);
-	if (m_sampleCount < 2)
-		return std::make_pair((BMDTimeValue)0, (BMDTimeValue)0);
-	
-	return std::make_pair(m_mean, (BMDTimeValue)std::sqrt(m_m2 / (m_sampleCount - 1)));
+	LatencyHistogram histogram = m_retired;
+
+	readWindows(histogram);
+	return histogram;
 }
 
-BMDTimeValue LatencyStatistics::getRollingAverage()
+LatencyHistogram LatencyStatistics::getRollingSnapshot()
 {
 	std::lock_guard<std::mutex> lock(m_mutex);
-	if (m_rollingSamples.empty())
-		return (BMDTimeValue)0;
+	LatencyHistogram histogram;
 
-	return m_rollingAggregateLatency / m_rollingSamples.size();
+	readWindows(histogram);
+	return histogram;
+}
+
+void LatencyStatistics::drainWindow(int window, LatencyHistogram& histogram)
+{
+	for (auto& shard : m_shards)
+	{
+		WindowHistogram& windowHistogram = shard.windows[window];
+
+		for (int i = 0; i < LatencyHistogram::kBucketCount; i++)
+		{
+			uint32_t count = windowHistogram.counts[i].exchange(0, std::memory_order_relaxed);
+			histogram.m_counts[i] += count;
+			histogram.m_sampleCount += count;
+		}
+
+		histogram.m_sum += windowHistogram.sum.exchange(0, std::memory_order_relaxed);
+		histogram.m_minLatency = std::min(histogram.m_minLatency, windowHistogram.minLatency.exchange(kNoMinimum, std::memory_order_relaxed));
+		histogram.m_maxLatency = std::max(histogram.m_maxLatency, windowHistogram.maxLatency.exchange(kNoMaximum, std::memory_order_relaxed));
+	}
+}
+
+void LatencyStatistics::readWindows(LatencyHistogram& histogram)
+{
+	for (auto& shard : m_shards)
+	{
+		for (int window = 0; window < m_windowCount; window++)
+		{
+			WindowHistogram& windowHistogram = shard.windows[window];
+
+			for (int i = 0; i < LatencyHistogram::kBucketCount; i++)
+			{
+				uint32_t count = windowHistogram.counts[i].load(std::memory_order_relaxed);
+				histogram.m_counts[i] += count;
+				histogram.m_sampleCount += count;
+			}
+
+			histogram.m_sum += windowHistogram.sum.load(std::memory_order_relaxed);
+			histogram.m_minLatency = std::min(histogram.m_minLatency, windowHistogram.minLatency.load(std::memory_order_relaxed));
+			histogram.m_maxLatency = std::max(histogram.m_maxLatency, windowHistogram.maxLatency.load(std::memory_order_relaxed));
+		}
+	}
 }
@@ -40,38 +40,99 @@
 
 #pragma once
 
-#include <deque>
+#include <array>
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include "DeckLinkAPI.h"
 
+// Log-linear (HDR-style) histogram of latencies.  Values below 64 have their own buckets and each
+// power of two above is split into 32 buckets, so reported values are within 1/32 (3%) of the
+// recorded value, for values up to 2^36 - 1.  A LatencyHistogram is a snapshot that can be merged
+// with others and queried for percentiles; latencies are recorded with LatencyStatistics.
+class LatencyHistogram
+{
+public:
+	static const int		kLinearBucketCount	= 64;
+	static const int		kSubBucketBits		= 5;
+	static const int		kBucketCount		= 1024;
+	static const BMDTimeValue kMaximumValue		= (1LL << 36) - 1;
+
+	LatencyHistogram();
+	virtual ~LatencyHistogram() {}
+
+	void					reset(void);
+	void					addSample(BMDTimeValue latency);
+	void					merge(const LatencyHistogram& other);
+
+	uint64_t				getSampleCount(void) const { return m_sampleCount; }
+	BMDTimeValue			getMinimum(void) const;
+	BMDTimeValue			getMaximum(void) const;
+	BMDTimeValue			getMean(void) const;
+	// Highest value equivalent to the sample at the percentile (0-100), limited to the maximum
+	BMDTimeValue			getPercentile(double percentile) const;
+
+	static int				getBucketIndex(BMDTimeValue latency);
+	static BMDTimeValue		getBucketLowestValue(int bucketIndex);
+	static BMDTimeValue		getBucketHighestValue(int bucketIndex);
+
+private:
+	friend class LatencyStatistics;
+
+	std::array<uint64_t, kBucketCount>	m_counts;
+	uint64_t							m_sampleCount;
+	BMDTimeValue						m_sum;
+	BMDTimeValue						m_minLatency;
+	BMDTimeValue						m_maxLatency;
+};
+
+// Records latencies from any number of threads without locking.  Each recording thread owns a
+// shard of counters while it runs, so a sample costs a few uncontended atomic increments; threads
+// beyond the number of shards share one shard.  Samples are recorded into the current of a ring
+// of windows; rotateWindow() starts a new window, folding the oldest into the cumulative totals,
+// so getRollingSnapshot() covers the last windowCount windows and getSnapshot() all samples.  A
+// sample that races with rotateWindow() may be counted in a later window, and one that races with
+// reset() may survive it, but no sample is counted twice.
 class LatencyStatistics
 {
 public:
-	LatencyStatistics(int maxRollingSamples);
+	LatencyStatistics(int windowCount);
 	virtual ~LatencyStatistics() {}
-	
-	void									reset(void);
-	void									addSample(const BMDTimeValue latency);
-	
-	BMDTimeValue							getMinimum(void);
-	BMDTimeValue							getMaximum(void);
-	std::pair<BMDTimeValue,BMDTimeValue>	getMeanAndStdDev(void);
-	BMDTimeValue							getRollingAverage(void);
+
+	void					reset(void);
+	void					addSample(const BMDTimeValue latency);
+	void					rotateWindow(void);
+
+	LatencyHistogram		getSnapshot(void);
+	LatencyHistogram		getRollingSnapshot(void);
 
 private:
-	std::mutex					m_mutex;
-	
-	// For calculating rolling average
-	int 						m_maxRollingSamples;
-	std::deque<BMDTimeValue>	m_rollingSamples;
-	BMDTimeValue				m_rollingAggregateLatency;
-	
-	// Minimum/maximum latency
-	BMDTimeValue				m_maxLatency;
-	BMDTimeValue				m_minLatency;
-	
-	// Welford mean/variance calculations
-	BMDTimeValue				m_mean;
-	BMDTimeValue				m_m2;
-	int							m_sampleCount;
+	static const int		kThreadShardCount	= 8;
+	static const int		kSharedShard		= kThreadShardCount;
+
+	// Window counts are 32-bit, enough for the samples of any practical window length
+	struct WindowHistogram
+	{
+		std::atomic<uint32_t>		counts[LatencyHistogram::kBucketCount];
+		std::atomic<BMDTimeValue>	sum;
+		std::atomic<BMDTimeValue>	minLatency;
+		std::atomic<BMDTimeValue>	maxLatency;
+	};
+
+	struct alignas(64) Shard
+	{
+		std::unique_ptr<WindowHistogram[]>	windows;
+	};
+
+	static int				getThreadShard(void);
+	void					drainWindow(int window, LatencyHistogram& histogram);
+	void					readWindows(LatencyHistogram& histogram);
+
+	int						m_windowCount;
+	std::atomic<int>		m_currentWindow;
+	Shard					m_shards[kThreadShardCount + 1];
+
+	// Serialises rotation and snapshots, recording does not take the lock
+	std::mutex				m_mutex;
+	LatencyHistogram		m_retired;
 };
@@ -71,6 +71,7 @@ public:
 	IDeckLinkVideoFrame*			getVideoFramePtr(void) const { return m_videoFrame.get(); }
 	BMDTimeValue					getVideoStreamTime(void) const { return m_videoStreamTime; }
 	BMDTimeValue					getVideoFrameDuration(void) const { return m_videoFrameDuration; }
+	BMDTimeValue					getInputFrameArrivedReferenceTime(void) const { return m_inputFrameArrivedReferenceTime; }
 	BMDTimeValue					getInputLatency(void) const { return m_inputFrameArrivedReferenceTime - m_inputFrameStartReferenceTime; }
 	BMDTimeValue					getProcessingLatency(void) const { return m_outputFrameScheduledReferenceTime - m_inputFrameArrivedReferenceTime; }
 	BMDTimeValue					getOutputLatency(void) const { return m_outputFrameCompletedReferenceTime - m_outputFrameScheduledReferenceTime; }
@@ -0,0 +1,175 @@
+/* -LICENSE-START-
+** Copyright (c) 2019 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "DeckLinkAPI.h"
+
+// Restores stream order after parallel processing.  Stream times are registered with expect() in
+// arrival order, before the item is dispatched; processed items are handed back with complete()
+// (or skip() if processing discarded it) and are released to the output function strictly in
+// stream time order.  An item completed early is held until all earlier items are complete or skipped.
+//
+// The output function is called without the lock held, so it may block without stalling expect().
+// One completing thread at a time releases items, any others hand their items to it and return.
+
+template<typename T>
+class ReorderQueue
+{
+	using OutputFunction = std::function<void(T)>;
+
+public:
+	explicit ReorderQueue(const OutputFunction& outputFunction);
+	virtual ~ReorderQueue() = default;
+
+	void	expect(BMDTimeValue streamTime);
+	void	complete(BMDTimeValue streamTime, T&& item);
+	void	skip(BMDTimeValue streamTime);
+	// Discard all pending items, items completed afterwards for earlier stream times are dropped
+	void	reset(void);
+
+private:
+	struct Slot
+	{
+		bool	done;
+		bool	hasItem;
+		T		item;
+	};
+
+	void	releaseCompleted(std::unique_lock<std::mutex>& lock);
+
+	OutputFunction						m_outputFunction;
+	std::map<BMDTimeValue, Slot>		m_slots;
+	std::mutex							m_mutex;
+	bool								m_releasing;
+};
+
+template<typename T>
+ReorderQueue<T>::ReorderQueue(const OutputFunction& outputFunction) :
+	m_outputFunction(outputFunction),
+	m_releasing(false)
+{
+}
+
+template<typename T>
+void ReorderQueue<T>::expect(BMDTimeValue streamTime)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_slots.emplace(streamTime, Slot{ false, false, T() });
+}
+
+template<typename T>
+void ReorderQueue<T>::complete(BMDTimeValue streamTime, T&& item)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	auto iter = m_slots.find(streamTime);
+	if (iter == m_slots.end())
+		return;
+
+	iter->second.done = true;
+	iter->second.hasItem = true;
+	iter->second.item = std::move(item);
+
+	releaseCompleted(lock);
+}
+
+template<typename T>
+void ReorderQueue<T>::skip(BMDTimeValue streamTime)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	auto iter = m_slots.find(streamTime);
+	if (iter == m_slots.end())
+		return;
+
+	iter->second.done = true;
+
+	releaseCompleted(lock);
+}
+
+template<typename T>
+void ReorderQueue<T>::reset(void)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_slots.clear();
+}
+
+template<typename T>
+void ReorderQueue<T>::releaseCompleted(std::unique_lock<std::mutex>& lock)
+{
+	// The thread already releasing will pick up items completed meanwhile, keeping the output in order
+	if (m_releasing)
+		return;
+
+	m_releasing = true;
+
+	std::vector<T> items;
+
+	while (true)
+	{
+		while (!m_slots.empty() && m_slots.begin()->second.done)
+		{
+			Slot& slot = m_slots.begin()->second;
+
+			if (slot.hasItem)
+				items.push_back(std::move(slot.item));
+
+			m_slots.erase(m_slots.begin());
+		}
+
+		if (items.empty())
+			break;
+
+		lock.unlock();
+
+		for (auto& item : items)
+			m_outputFunction(std::move(item));
+		items.clear();
+
+		lock.lock();
+	}
+
+	m_releasing = false;
+}
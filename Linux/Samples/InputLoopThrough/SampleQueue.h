@@ -40,37 +40,108 @@
 
 #pragma once
 
-#include <condition_variable>
+#include <atomic>
+#include <limits.h>
+#include <linux/futex.h>
 #include <memory>
-#include <mutex>
-#include <queue>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
 
+// Bounded queue between the DeckLink callback/dispatch threads and the scheduling threads.
+// Samples are exchanged through a ring of sequenced cells without taking a lock, so any number
+// of producers and consumers may run concurrently.  Threads only enter the kernel (futex) when
+// they have to block, ie a consumer on an empty queue or a producer on a full BlockWhenFull queue.
+
+enum class SampleQueueOverflowPolicy
+{
+	DropOldest,		// Discard the oldest queued sample to make room
+	DropNewest,		// Discard the sample being pushed
+	BlockWhenFull	// Wait for the consumer to make room
+};
 
 template<typename T>
 class SampleQueue
 {
 public:
-	SampleQueue();
+	static const size_t kDefaultCapacity = 64;
+
+	SampleQueue(size_t capacity = kDefaultCapacity, SampleQueueOverflowPolicy overflowPolicy = SampleQueueOverflowPolicy::BlockWhenFull);
 	virtual ~SampleQueue();
 
-	void						pushSample(const T& sample);
-	void						pushSample(T&& sample);
+	// Returns false if the sample was discarded or the wait for room was cancelled
+	bool						pushSample(const T& sample);
+	bool						pushSample(T&& sample);
 	bool						popSample(T& sample);
 	bool						waitForSample(T& sample);
 	void						cancelWaiters(void);
+	// Discards queued samples and clears cancellation, call before starting the consumer
 	void						reset(void);
 
+	size_t						getCapacity(void) const { return m_cellMask + 1; }
+	uint64_t					getDroppedSampleCount(void) const { return m_droppedSampleCount.load(std::memory_order_relaxed); }
+
 private:
-	std::queue<T>				m_queue;
-	std::condition_variable		m_queueCondition;
-	std::mutex					m_mutex;
-	bool						m_waitCancelled;
+	static const size_t kCacheLineSize = 64;
+
+	struct Cell
+	{
+		std::atomic<size_t>		sequence;
+		T						sample;
+	};
+
+	bool						tryPush(T& sample);
+	bool						tryPop(T& sample);
+	void						notifyWaiters(std::atomic<uint32_t>& futexWord, std::atomic<uint32_t>& waiterCount);
+
+	static void					futexWait(std::atomic<uint32_t>& futexWord, uint32_t expectedValue);
+	static void					futexWake(std::atomic<uint32_t>& futexWord, int waiterCount);
+
+	std::unique_ptr<Cell[]>		m_cells;
+	size_t						m_cellMask;
+	SampleQueueOverflowPolicy	m_overflowPolicy;
+
+	// Producer and consumer indices are kept on separate cache lines to avoid false sharing
+	char						m_padding0[kCacheLineSize];
+	std::atomic<size_t>			m_enqueuePosition;
+	char						m_padding1[kCacheLineSize - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t>			m_dequeuePosition;
+	char						m_padding2[kCacheLineSize - sizeof(std::atomic<size_t>)];
+
+	// Futex words are bumped on every push/pop that may need to wake a blocked thread
+	std::atomic<uint32_t>		m_notEmptyFutex;
+	std::atomic<uint32_t>		m_notEmptyWaiters;
+	std::atomic<uint32_t>		m_notFullFutex;
+	std::atomic<uint32_t>		m_notFullWaiters;
+
+	std::atomic<bool>			m_waitCancelled;
+	std::atomic<uint64_t>		m_droppedSampleCount;
 };
 
 template<typename T>
-SampleQueue<T>::SampleQueue() :
-	m_waitCancelled(false)
+SampleQueue<T>::SampleQueue(size_t capacity, SampleQueueOverflowPolicy overflowPolicy) :
+	m_cellMask(0),
+	m_overflowPolicy(overflowPolicy),
+	m_enqueuePosition(0),
+	m_dequeuePosition(0),
+	m_notEmptyFutex(0),
+	m_notEmptyWaiters(0),
+	m_notFullFutex(0),
+	m_notFullWaiters(0),
+	m_waitCancelled(false),
+	m_droppedSampleCount(0)
 {
+	// Round capacity up to a power of two so that positions map to cells with a mask
+	size_t cellCount = 2;
+	while (cellCount < capacity)
+		cellCount <<= 1;
+
+	m_cells.reset(new Cell[cellCount]);
+	m_cellMask = cellCount - 1;
+
+	for (size_t i = 0; i < cellCount; i++)
+		m_cells[i].sequence.store(i, std::memory_order_relaxed);
 }
 
 template<typename T>
@@ -80,36 +151,57 @@ SampleQueue<T>::~SampleQueue()
 }
 
 template<typename T>
-void SampleQueue<T>::pushSample(const T& sample)
+bool SampleQueue<T>::pushSample(const T& sample)
 {
-	{
-		std::lock_guard<std::mutex> lock(m_mutex);
-		m_queue.push(sample);
-	}
-	m_queueCondition.notify_one();
+	T sampleCopy(sample);
+	return pushSample(std::move(sampleCopy));
 }
 
 template<typename T>
-void SampleQueue<T>::pushSample(T&& sample)
+bool SampleQueue<T>::pushSample(T&& sample)
 {
+	while (!tryPush(sample))
 	{
-		std::lock_guard<std::mutex> lock(m_mutex);
-		m_queue.push(std::move(sample));
+		if (m_overflowPolicy == SampleQueueOverflowPolicy::DropNewest)
+		{
+			m_droppedSampleCount.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		else if (m_overflowPolicy == SampleQueueOverflowPolicy::DropOldest)
+		{
+			T discardedSample;
+			if (tryPop(discardedSample))
+				m_droppedSampleCount.fetch_add(1, std::memory_order_relaxed);
+		}
+		else
+		{
+			// Sample the futex word before retrying, so that a pop between the retry and the wait is not missed
+			uint32_t notFullValue = m_notFullFutex.load();
+
+			if (m_waitCancelled.load())
+				return false;
+
+			if (tryPush(sample))
+				break;
+
+			m_notFullWaiters.fetch_add(1);
+			futexWait(m_notFullFutex, notFullValue);
+			m_notFullWaiters.fetch_sub(1);
+		}
 	}
-	m_queueCondition.notify_one();
+
+	notifyWaiters(m_notEmptyFutex, m_notEmptyWaiters);
+	return true;
 }
 
 template<typename T>
 bool SampleQueue<T>::popSample(T& sample)
 {
 	// Non-blocking queue pop
-	std::lock_guard<std::mutex> lock(m_mutex); 
-	if (m_queue.empty())
+	if (!tryPop(sample))
 		return false;
 
-	sample = std::move(m_queue.front());
-	m_queue.pop();
-
+	notifyWaiters(m_notFullFutex, m_notFullWaiters);
 	return true;
 }
 
@@ -117,35 +209,133 @@ template<typename T>
 bool SampleQueue<T>::waitForSample(T& sample)
 {
 	// Blocking wait for sample
-	std::unique_lock<std::mutex> lock(m_mutex);
-	m_queueCondition.wait(lock, [&] { return !m_queue.empty() || m_waitCancelled; });
+	while (true)
+	{
+		uint32_t notEmptyValue = m_notEmptyFutex.load();
+
+		if (m_waitCancelled.load())
+			return false;
+
+		if (popSample(sample))
+			return true;
+
+		m_notEmptyWaiters.fetch_add(1);
+		futexWait(m_notEmptyFutex, notEmptyValue);
+		m_notEmptyWaiters.fetch_sub(1);
+	}
+}
+
+template<typename T>
+void SampleQueue<T>::cancelWaiters()
+{
+	// signal cancel flag to terminate wait condition
+	m_waitCancelled.store(true);
+
+	m_notEmptyFutex.fetch_add(1);
+	futexWake(m_notEmptyFutex, INT_MAX);
+	m_notFullFutex.fetch_add(1);
+	futexWake(m_notFullFutex, INT_MAX);
+}
 
-	if (m_waitCancelled)
-		return false;	
-	else if (!m_queue.empty())
+template<typename T>
+void SampleQueue<T>::reset(void)
+{
+	T discardedSample;
+	while (tryPop(discardedSample))
+		;
+
+	m_droppedSampleCount.store(0);
+	m_waitCancelled.store(false);
+}
+
+template<typename T>
+bool SampleQueue<T>::tryPush(T& sample)
+{
+	size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+	Cell* cell;
+
+	while (true)
 	{
-		sample = std::move(m_queue.front());
-		m_queue.pop();
+		cell = &m_cells[position & m_cellMask];
+		size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+		if (difference == 0)
+		{
+			// Cell is free for this position, claim it
+			if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (difference < 0)
+		{
+			// Cell still holds the sample from the previous lap, queue is full
+			return false;
+		}
+		else
+		{
+			position = m_enqueuePosition.load(std::memory_order_relaxed);
+		}
 	}
+
+	cell->sample = std::move(sample);
+	cell->sequence.store(position + 1, std::memory_order_release);
 	return true;
 }
 
 template<typename T>
-void SampleQueue<T>::cancelWaiters()
+bool SampleQueue<T>::tryPop(T& sample)
 {
+	size_t position = m_dequeuePosition.load(std::memory_order_relaxed);
+	Cell* cell;
+
+	while (true)
 	{
-		// signal cancel flag to terminate wait condition
-		std::lock_guard<std::mutex> lock(m_mutex);
-		m_waitCancelled = true;
+		cell = &m_cells[position & m_cellMask];
+		size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+
+		if (difference == 0)
+		{
+			if (m_dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (difference < 0)
+		{
+			// Cell has not been written for this position, queue is empty
+			return false;
+		}
+		else
+		{
+			position = m_dequeuePosition.load(std::memory_order_relaxed);
+		}
 	}
-	m_queueCondition.notify_all();
+
+	sample = std::move(cell->sample);
+	// Release any resources still referenced by the cell before it is handed back to producers
+	cell->sample = T();
+	cell->sequence.store(position + m_cellMask + 1, std::memory_order_release);
+	return true;
 }
 
 template<typename T>
-void SampleQueue<T>::reset(void)
+void SampleQueue<T>::notifyWaiters(std::atomic<uint32_t>& futexWord, std::atomic<uint32_t>& waiterCount)
+{
+	// The futex word is always bumped so that a thread about to wait sees the change, but the
+	// system call is only made when a thread is known to be waiting
+	futexWord.fetch_add(1);
+	if (waiterCount.load() > 0)
+		futexWake(futexWord, INT_MAX);
+}
+
+template<typename T>
+void SampleQueue<T>::futexWait(std::atomic<uint32_t>& futexWord, uint32_t expectedValue)
+{
+	// Returns immediately if the word has changed since expectedValue was read
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&futexWord), FUTEX_WAIT_PRIVATE, expectedValue, nullptr, nullptr, 0);
+}
+
+template<typename T>
+void SampleQueue<T>::futexWake(std::atomic<uint32_t>& futexWord, int waiterCount)
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-	while (!m_queue.empty())
-		m_queue.pop();
-	m_waitCancelled = false;
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&futexWord), FUTEX_WAKE_PRIVATE, waiterCount, nullptr, nullptr, 0);
 }
@@ -0,0 +1,213 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2020 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <vector>
+
+#include "ScheduledFramesBenchmark.h"
+#include "DeckLinkOutputDevice.h"
+#include "LoopThroughVideoFrame.h"
+#include "com_ptr.h"
+
+namespace
+{
+	const uint32_t	kBenchmarkPrerollDepths[]	= { 1, 4, 16, 64, 256 };
+	const uint32_t	kBenchmarkBatchSize			= 4096;	// Completions between clock reads
+
+	// Frame with no image, which only provides a distinct IDeckLinkVideoFrame pointer for the table
+	class BenchmarkVideoFrame : public IDeckLinkVideoFrame
+	{
+	public:
+		BenchmarkVideoFrame() : m_refCount(1) { }
+		virtual ~BenchmarkVideoFrame() = default;
+
+		// IUnknown interface
+		HRESULT		STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override { *ppv = nullptr; return E_NOINTERFACE; }
+		ULONG		STDMETHODCALLTYPE AddRef() override { return ++m_refCount; }
+		ULONG		STDMETHODCALLTYPE Release() override
+		{
+			ULONG newRefValue = --m_refCount;
+			if (newRefValue == 0)
+				delete this;
+			return newRefValue;
+		}
+
+		// IDeckLinkVideoFrame interface
+		long			STDMETHODCALLTYPE GetWidth() override { return 0; }
+		long			STDMETHODCALLTYPE GetHeight() override { return 0; }
+		long			STDMETHODCALLTYPE GetRowBytes() override { return 0; }
+		BMDPixelFormat	STDMETHODCALLTYPE GetPixelFormat() override { return bmdFormat10BitYUV; }
+		BMDFrameFlags	STDMETHODCALLTYPE GetFlags() override { return bmdFrameFlagDefault; }
+		HRESULT			STDMETHODCALLTYPE GetBytes(void** buffer) override { *buffer = nullptr; return E_FAIL; }
+		HRESULT			STDMETHODCALLTYPE GetTimecode(BMDTimecodeFormat format, IDeckLinkTimecode** timecode) override { *timecode = nullptr; return S_FALSE; }
+		HRESULT			STDMETHODCALLTYPE GetAncillaryData(IDeckLinkVideoFrameAncillary** ancillary) override { *ancillary = nullptr; return S_FALSE; }
+
+	private:
+		std::atomic<ULONG>	m_refCount;
+	};
+
+	// In-flight frames as a list, scanned from the newest frame on completion
+	class ListScheduledFrames
+	{
+	public:
+		void schedule(std::shared_ptr<LoopThroughVideoFrame> frame)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_frames.push_back(std::move(frame));
+		}
+
+		std::shared_ptr<LoopThroughVideoFrame> complete(IDeckLinkVideoFrame* completedFrame)
+		{
+			std::shared_ptr<LoopThroughVideoFrame> frame;
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			for (auto iter = m_frames.rbegin(); iter != m_frames.rend(); iter++)
+			{
+				if ((*iter)->getVideoFramePtr() == completedFrame)
+				{
+					frame = std::move(*iter);
+					m_frames.erase(std::next(iter).base());
+					break;
+				}
+			}
+			return frame;
+		}
+
+	private:
+		std::mutex										m_mutex;
+		std::list<std::shared_ptr<LoopThroughVideoFrame>>	m_frames;
+	};
+
+	// In-flight frames indexed by frame, as in DeckLinkOutputDevice
+	class IndexedScheduledFrames
+	{
+	public:
+		void schedule(std::shared_ptr<LoopThroughVideoFrame> frame)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_frames[frame->getVideoFramePtr()] = std::move(frame);
+		}
+
+		std::shared_ptr<LoopThroughVideoFrame> complete(IDeckLinkVideoFrame* completedFrame)
+		{
+			std::shared_ptr<LoopThroughVideoFrame> frame;
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			auto iter = m_frames.find(completedFrame);
+			if (iter != m_frames.end())
+			{
+				frame = std::move(iter->second);
+				m_frames.erase(iter);
+			}
+			return frame;
+		}
+
+	private:
+		std::mutex										m_mutex;
+		DeckLinkOutputDevice::ScheduledFramesMap		m_frames;
+	};
+
+	// Returns the mean time in nanoseconds to complete the oldest frame and schedule it again
+	template<typename ScheduledFrames>
+	double measureCompletions(const std::vector<std::shared_ptr<LoopThroughVideoFrame>>& frames, double seconds)
+	{
+		ScheduledFrames	scheduledFrames;
+		uint64_t		completions = 0;
+		size_t			oldest = 0;
+
+		for (auto& frame : frames)
+			scheduledFrames.schedule(frame);
+
+		auto startTime = std::chrono::steady_clock::now();
+		auto endTime = startTime + std::chrono::duration<double>(seconds);
+		auto now = startTime;
+
+		do
+		{
+			for (uint32_t i = 0; i < kBenchmarkBatchSize; i++)
+			{
+				// Frames complete in the order they were scheduled
+				auto completedFrame = scheduledFrames.complete(frames[oldest]->getVideoFramePtr());
+				if (!completedFrame)
+				{
+					fprintf(stderr, "Completed frame was not found in the in-flight table\n");
+					return 0.0;
+				}
+
+				scheduledFrames.schedule(std::move(completedFrame));
+				oldest = (oldest + 1) % frames.size();
+			}
+			completions += kBenchmarkBatchSize;
+			now = std::chrono::steady_clock::now();
+		}
+		while (now < endTime);
+
+		return std::chrono::duration<double, std::nano>(now - startTime).count() / completions;
+	}
+}
+
+void runScheduledFramesBenchmark(double seconds)
+{
+	size_t	depthCount = sizeof(kBenchmarkPrerollDepths) / sizeof(kBenchmarkPrerollDepths[0]);
+	double	secondsPerMeasurement = seconds / (2 * depthCount);
+
+	fprintf(stderr, "Benchmarking in-flight frame lookup on completion for %.0f s\n", seconds);
+	fprintf(stderr, "%-10s %14s %14s\n", "In flight", "List (ns)", "Indexed (ns)");
+
+	for (size_t i = 0; i < depthCount; i++)
+	{
+		std::vector<std::shared_ptr<LoopThroughVideoFrame>> frames;
+
+		for (uint32_t j = 0; j < kBenchmarkPrerollDepths[i]; j++)
+		{
+			com_ptr<IDeckLinkVideoFrame> videoFrame(make_com_ptr<BenchmarkVideoFrame>().get());
+			frames.push_back(std::make_shared<LoopThroughVideoFrame>(videoFrame));
+		}
+
+		double listNanoseconds = measureCompletions<ListScheduledFrames>(frames, secondsPerMeasurement);
+		double indexedNanoseconds = measureCompletions<IndexedScheduledFrames>(frames, secondsPerMeasurement);
+
+		fprintf(stderr, "%-10u %14.1f %14.1f\n", kBenchmarkPrerollDepths[i], listNanoseconds, indexedNanoseconds);
+	}
+}
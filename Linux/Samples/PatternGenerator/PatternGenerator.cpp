@@ -0,0 +1,545 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include "PatternGenerator.h"
+
+// Rows per stripe, stripes are claimed by the render threads in turn
+static const uint32_t kStripeRows = 16;
+
+// Sine table of 2^kSineTableBits entries, indexed by the top bits of a 32-bit phase, where 2^32 is one cycle
+static const uint32_t kSineTableBits = 10;
+
+// Motion per frame: bars scroll a 256th of the width, zone plate and sweep advance a 32nd of a cycle
+static const uint32_t kBarsStepDivisor = 256;
+static const uint32_t kPhaseStep = 1U << 27;
+
+// 75% colour bars: white, yellow, cyan, green, magenta, red, blue, black
+static const double kBarColours[8][3] =
+{
+	{ 0.75, 0.75, 0.75 }, { 0.75, 0.75, 0.0 }, { 0.0, 0.75, 0.75 }, { 0.0, 0.75, 0.0 },
+	{ 0.75, 0.0, 0.75 }, { 0.75, 0.0, 0.0 }, { 0.0, 0.0, 0.75 }, { 0.0, 0.0, 0.0 }
+};
+
+static inline uint32_t HashPixel(uint32_t x, uint32_t y, uint32_t frameNumber)
+{
+	uint32_t hash = (x * 0x9E3779B1U) ^ (y * 0x85EBCA77U) ^ (frameNumber * 0xC2B2AE3DU);
+
+	hash ^= hash >> 15;
+	hash *= 0x2C1B3C6DU;
+	hash ^= hash >> 12;
+	hash *= 0x297A2D39U;
+	hash ^= hash >> 15;
+	return hash;
+}
+
+PatternGenerator::PatternGenerator(IDeckLinkOutput* deckLinkOutput, long width, long height, BMDPixelFormat pixelFormat, MovingPattern pattern, uint32_t threadCount, uint32_t frameCount) :
+	m_deckLinkOutput(deckLinkOutput),
+	m_width(width),
+	m_height(height),
+	m_pixelFormat(pixelFormat),
+	m_pattern(pattern),
+	m_threadCount(threadCount ? threadCount : std::max(std::thread::hardware_concurrency(), 1U)),
+	m_frameCount(std::max(frameCount, 2U)),
+	m_yuv(IsPixelFormatYUV(pixelFormat)),
+	m_running(false),
+	m_statistics(),
+	m_jobBytes(nullptr),
+	m_jobRowBytes(0),
+	m_jobFrameNumber(0),
+	m_jobStripeCount(0),
+	m_jobNextStripe(0),
+	m_jobGeneration(0),
+	m_workersFinished(0),
+	m_terminateWorkers(false)
+{
+	m_deckLinkOutput->AddRef();
+	m_statistics.threadCount = m_threadCount;
+
+	InitializeLevels();
+
+	for (int i = 0; i < kPixelPlaneCount; i++)
+		m_renderRowBuffers.planes[i].resize(m_width);
+
+	// The render thread takes part in rendering, so start one less worker
+	for (uint32_t i = 1; i < m_threadCount; i++)
+		m_workerThreads.push_back(std::thread(&PatternGenerator::WorkerThread, this));
+}
+
+PatternGenerator::~PatternGenerator()
+{
+	Stop();
+
+	{
+		std::lock_guard<std::mutex> lock(m_workerMutex);
+		m_terminateWorkers = true;
+	}
+	m_workerCondition.notify_all();
+
+	for (std::thread& workerThread : m_workerThreads)
+		workerThread.join();
+
+	m_deckLinkOutput->Release();
+}
+
+const char* PatternGenerator::GetPatternName(MovingPattern pattern)
+{
+	switch (pattern)
+	{
+		case kMovingPatternBars:		return "Moving colour bars";
+		case kMovingPatternZonePlate:	return "Zone plate";
+		case kMovingPatternNoise:		return "Noise";
+		case kMovingPatternSweep:		return "Frequency sweep";
+		default:						return "Static colour bars";
+	}
+}
+
+void PatternGenerator::InitializeLevels(void)
+{
+	// Video range black and white are 16 and 235 at 8 bits (64 and 940 at 10 bits), RGB formats
+	// with 8-bit or 12-bit components are full range
+	bool	fullRange;
+	double	kr, kb, kg;
+
+	switch (m_pixelFormat)
+	{
+		case bmdFormat8BitARGB:
+		case bmdFormat8BitBGRA:
+		case bmdFormat12BitRGB:
+		case bmdFormat12BitRGBLE:
+			fullRange = true;
+			break;
+
+		default:
+			fullRange = false;
+			break;
+	}
+
+	m_black			= fullRange ? 0 : 16 << 8;
+	m_white			= fullRange ? 0xFFFF : 235 << 8;
+	m_chromaCenter	= 128 << 8;
+
+	// Rec.601 for SD, Rec.709 for HD and above
+	if (m_width <= 720)
+	{
+		kr = 0.299;
+		kb = 0.114;
+	}
+	else
+	{
+		kr = 0.2126;
+		kb = 0.0722;
+	}
+	kg = 1.0 - kr - kb;
+
+	for (int bar = 0; bar < 8; bar++)
+	{
+		const double* rgb = kBarColours[bar];
+
+		if (m_yuv)
+		{
+			double y	= kr * rgb[0] + kg * rgb[1] + kb * rgb[2];
+			double cb	= (rgb[2] - y) / (2.0 * (1.0 - kb));
+			double cr	= (rgb[0] - y) / (2.0 * (1.0 - kr));
+
+			m_bars[bar][kPixelPlaneY]	= (uint16_t)lround(m_black + y * (m_white - m_black));
+			m_bars[bar][kPixelPlaneCb]	= (uint16_t)lround(m_chromaCenter + cb * (224 << 8));
+			m_bars[bar][kPixelPlaneCr]	= (uint16_t)lround(m_chromaCenter + cr * (224 << 8));
+		}
+		else
+		{
+			for (int i = 0; i < 3; i++)
+				m_bars[bar][i] = (uint16_t)lround(m_black + rgb[i] * (m_white - m_black));
+		}
+	}
+
+	m_sineTable.resize(1 << kSineTableBits);
+	for (size_t i = 0; i < m_sineTable.size(); i++)
+	{
+		double level = 0.5 + 0.5 * sin(2.0 * M_PI * (double)i / (double)m_sineTable.size());
+		m_sineTable[i] = (uint16_t)lround(m_black + level * (m_white - m_black));
+	}
+}
+
+HRESULT PatternGenerator::Start(void)
+{
+	long rowBytes = GetPixelFormatRowBytes(m_pixelFormat, (uint32_t)m_width);
+
+	if (!IsPixelPackingSupported(m_pixelFormat))
+	{
+		fprintf(stderr, "Moving patterns are not supported in the selected pixel format\n");
+		return E_INVALIDARG;
+	}
+
+	// Allocate the frame pool from the output, so frames do not need to be copied to be scheduled
+	for (uint32_t i = 0; i < m_frameCount; i++)
+	{
+		IDeckLinkMutableVideoFrame* frame = NULL;
+
+		if (m_deckLinkOutput->CreateVideoFrame(m_width, m_height, rowBytes, m_pixelFormat, bmdFrameFlagDefault, &frame) != S_OK)
+		{
+			fprintf(stderr, "Failed to create video frame for moving pattern\n");
+			Stop();
+			return E_OUTOFMEMORY;
+		}
+
+		m_frames.push_back(frame);
+		m_freeFrames.push_back(frame);
+	}
+
+	m_statistics = PatternGeneratorStatistics();
+	m_statistics.threadCount = m_threadCount;
+	m_running = true;
+	m_renderThread = std::thread(&PatternGenerator::RenderThread, this);
+
+	return S_OK;
+}
+
+void PatternGenerator::Stop(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_frameMutex);
+		m_running = false;
+	}
+	m_frameCondition.notify_all();
+
+	if (m_renderThread.joinable())
+		m_renderThread.join();
+
+	m_freeFrames.clear();
+	m_renderedFrames.clear();
+
+	for (IDeckLinkMutableVideoFrame* frame : m_frames)
+		frame->Release();
+	m_frames.clear();
+}
+
+HRESULT PatternGenerator::GetNextFrame(IDeckLinkVideoFrame** frame, int64_t microsecondsUntilDisplay)
+{
+	std::unique_lock<std::mutex> lock(m_frameMutex);
+
+	if (m_renderedFrames.empty() && m_running)
+	{
+		auto waitStartTime = std::chrono::steady_clock::now();
+
+		m_frameCondition.wait(lock, [&]{ return !m_renderedFrames.empty() || !m_running; });
+
+		// Waiting only misses the output when the frame is rendered after its display time, no frame
+		// is returned when the generator is stopping
+		int64_t waitTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - waitStartTime).count();
+		if (!m_renderedFrames.empty() && (waitTime > microsecondsUntilDisplay))
+			m_statistics.lateFrames++;
+	}
+
+	if (m_renderedFrames.empty())
+		return E_FAIL;
+
+	*frame = m_renderedFrames.front();
+	m_renderedFrames.pop_front();
+	return S_OK;
+}
+
+void PatternGenerator::ReleaseFrame(IDeckLinkVideoFrame* frame)
+{
+	std::lock_guard<std::mutex> lock(m_frameMutex);
+
+	for (IDeckLinkMutableVideoFrame* poolFrame : m_frames)
+	{
+		if ((IDeckLinkVideoFrame*)poolFrame == frame)
+		{
+			m_freeFrames.push_back(poolFrame);
+			m_frameCondition.notify_all();
+			break;
+		}
+	}
+}
+
+PatternGeneratorStatistics PatternGenerator::GetStatistics(void)
+{
+	std::lock_guard<std::mutex> lock(m_frameMutex);
+	return m_statistics;
+}
+
+void PatternGenerator::RenderThread(void)
+{
+	uint32_t frameNumber = 0;
+
+	while (true)
+	{
+		IDeckLinkMutableVideoFrame* frame;
+
+		{
+			std::unique_lock<std::mutex> lock(m_frameMutex);
+			m_frameCondition.wait(lock, [&]{ return !m_freeFrames.empty() || !m_running; });
+			if (!m_running)
+				break;
+
+			frame = m_freeFrames.front();
+			m_freeFrames.pop_front();
+		}
+
+		auto startTime = std::chrono::steady_clock::now();
+		RenderFrame(frame, frameNumber++);
+		uint64_t renderTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+		{
+			std::lock_guard<std::mutex> lock(m_frameMutex);
+			m_renderedFrames.push_back(frame);
+			m_statistics.framesRendered++;
+			m_statistics.lastRenderMicroseconds = renderTime;
+			m_statistics.maxRenderMicroseconds = std::max(m_statistics.maxRenderMicroseconds, renderTime);
+			m_statistics.totalRenderMicroseconds += renderTime;
+		}
+		m_frameCondition.notify_all();
+	}
+}
+
+void PatternGenerator::RenderFrame(IDeckLinkMutableVideoFrame* frame, uint32_t frameNumber)
+{
+	void* bytes;
+
+	frame->GetBytes(&bytes);
+
+	{
+		std::lock_guard<std::mutex> lock(m_workerMutex);
+		m_jobBytes			= (uint8_t*)bytes;
+		m_jobRowBytes		= frame->GetRowBytes();
+		m_jobFrameNumber	= frameNumber;
+		m_jobStripeCount	= (uint32_t)((m_height + kStripeRows - 1) / kStripeRows);
+		m_jobNextStripe		= 0;
+		m_workersFinished	= 0;
+		m_jobGeneration++;
+	}
+	m_workerCondition.notify_all();
+
+	RenderStripes(m_renderRowBuffers);
+
+	std::unique_lock<std::mutex> lock(m_workerMutex);
+	m_jobCompleteCondition.wait(lock, [&]{ return m_workersFinished == m_workerThreads.size(); });
+}
+
+void PatternGenerator::WorkerThread(void)
+{
+	RowBuffers	buffers;
+	uint64_t	lastGeneration = 0;
+
+	for (int i = 0; i < kPixelPlaneCount; i++)
+		buffers.planes[i].resize(m_width);
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_workerMutex);
+			m_workerCondition.wait(lock, [&]{ return m_terminateWorkers || m_jobGeneration != lastGeneration; });
+			if (m_terminateWorkers)
+				break;
+
+			lastGeneration = m_jobGeneration;
+		}
+
+		RenderStripes(buffers);
+
+		{
+			std::lock_guard<std::mutex> lock(m_workerMutex);
+			m_workersFinished++;
+		}
+		m_jobCompleteCondition.notify_all();
+	}
+}
+
+void PatternGenerator::RenderStripes(RowBuffers& buffers)
+{
+	uint16_t* const planes[kPixelPlaneCount] = 
+	{
+		buffers.planes[0].data(), buffers.planes[1].data(), buffers.planes[2].data(), NULL
+	};
+	uint32_t stripe;
+
+	while ((stripe = m_jobNextStripe++) < m_jobStripeCount)
+	{
+		uint32_t lastRow = std::min((stripe + 1) * kStripeRows, (uint32_t)m_height);
+
+		for (uint32_t y = stripe * kStripeRows; y < lastRow; y++)
+		{
+			RenderRow(y, m_jobFrameNumber, planes);
+			PackPixelRow(m_pixelFormat, planes, m_jobBytes + y * m_jobRowBytes, (uint32_t)m_width);
+		}
+	}
+}
+
+void PatternGenerator::RenderRow(uint32_t y, uint32_t frameNumber, uint16_t* const planes[kPixelPlaneCount])
+{
+	switch (m_pattern)
+	{
+		case kMovingPatternZonePlate:
+			RenderZonePlateRow(y, frameNumber, planes);
+			break;
+
+		case kMovingPatternNoise:
+			RenderNoiseRow(y, frameNumber, planes);
+			break;
+
+		case kMovingPatternSweep:
+			RenderSweepRow(y, frameNumber, planes);
+			break;
+
+		case kMovingPatternBars:
+		default:
+			RenderBarsRow(y, frameNumber, planes);
+			break;
+	}
+}
+
+void PatternGenerator::RenderBarsRow(uint32_t y, uint32_t frameNumber, uint16_t* const planes[kPixelPlaneCount])
+{
+	// Bars scroll to the left, wrapping around
+	uint32_t width	= (uint32_t)m_width;
+	uint32_t offset	= (uint32_t)(((uint64_t)frameNumber * width / kBarsStepDivisor) % width);
+
+	if (m_yuv)
+	{
+		for (uint32_t x = 0; x < width; x++)
+			planes[kPixelPlaneY][x] = m_bars[((x + offset) % width) * 8 / width][kPixelPlaneY];
+
+		// Chroma is sampled at even luma positions
+		for (uint32_t x = 0; x < width / 2; x++)
+		{
+			const uint16_t* bar = m_bars[((2 * x + offset) % width) * 8 / width];
+			planes[kPixelPlaneCb][x] = bar[kPixelPlaneCb];
+			planes[kPixelPlaneCr][x] = bar[kPixelPlaneCr];
+		}
+	}
+	else
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			const uint16_t* bar = m_bars[((x + offset) % width) * 8 / width];
+			planes[kPixelPlaneR][x] = bar[kPixelPlaneR];
+			planes[kPixelPlaneG][x] = bar[kPixelPlaneG];
+			planes[kPixelPlaneB][x] = bar[kPixelPlaneB];
+		}
+	}
+}
+
+void PatternGenerator::RenderZonePlateRow(uint32_t y, uint32_t frameNumber, uint16_t* const planes[kPixelPlaneCount])
+{
+	// Phase is k.r^2, so the frequency increases linearly from the centre to reach half the
+	// sample rate at the corners.  The rings move outwards as the phase advances
+	int32_t		centreX		= (int32_t)m_width / 2;
+	int32_t		dy			= (int32_t)y - (int32_t)m_height / 2;
+	double		maxRadius	= sqrt((double)m_width * m_width + (double)m_height * m_height) / 2.0;
+	uint32_t	k			= (uint32_t)(1073741824.0 / maxRadius);
+	uint32_t	rowPhase	= (uint32_t)(dy * dy) * k - frameNumber * kPhaseStep;
+	uint16_t*	luma		= planes[0];
+
+	for (int32_t x = 0; x < (int32_t)m_width; x++)
+	{
+		int32_t dx = x - centreX;
+		luma[x] = m_sineTable[((uint32_t)(dx * dx) * k + rowPhase) >> (32 - kSineTableBits)];
+	}
+
+	ExpandGreyRow(planes);
+}
+
+void PatternGenerator::RenderNoiseRow(uint32_t y, uint32_t frameNumber, uint16_t* const planes[kPixelPlaneCount])
+{
+	// Uniform noise over the legal range of each component, different for every frame
+	uint32_t	width		= (uint32_t)m_width;
+	uint32_t	range		= (uint32_t)(m_white - m_black);
+	uint32_t	chromaRange	= 224 << 8;
+	uint32_t	chromaLow	= m_chromaCenter - chromaRange / 2;
+
+	if (m_yuv)
+	{
+		for (uint32_t x = 0; x < width; x++)
+			planes[kPixelPlaneY][x] = (uint16_t)(m_black + (((HashPixel(x, y, frameNumber) >> 16) * range) >> 16));
+
+		for (uint32_t x = 0; x < width / 2; x++)
+		{
+			uint32_t hash = HashPixel(x, y, ~frameNumber);
+			planes[kPixelPlaneCb][x] = (uint16_t)(chromaLow + (((hash & 0xFFFF) * chromaRange) >> 16));
+			planes[kPixelPlaneCr][x] = (uint16_t)(chromaLow + (((hash >> 16) * chromaRange) >> 16));
+		}
+	}
+	else
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			uint32_t hash = HashPixel(x, y, frameNumber);
+			planes[kPixelPlaneR][x] = (uint16_t)(m_black + (((hash & 0x7FF) * range) >> 11));
+			planes[kPixelPlaneG][x] = (uint16_t)(m_black + ((((hash >> 11) & 0x7FF) * range) >> 11));
+			planes[kPixelPlaneB][x] = (uint16_t)(m_black + (((hash >> 22) * range) >> 10));
+		}
+	}
+}
+
+void PatternGenerator::RenderSweepRow(uint32_t y, uint32_t frameNumber, uint16_t* const planes[kPixelPlaneCount])
+{
+	// Horizontal frequency sweep from DC at the left to half the sample rate at the right, the
+	// phase of x^2 / 4w cycles gives a frequency of x / 2w cycles per pixel.  The sweep drifts
+	// to the right as the phase advances
+	uint64_t	width		= (uint64_t)m_width;
+	uint32_t	phase		= 0U - frameNumber * kPhaseStep;
+	uint16_t*	luma		= planes[0];
+
+	for (uint64_t x = 0; x < width; x++)
+		luma[x] = m_sineTable[((uint32_t)(((x * x) << 30) / width) + phase) >> (32 - kSineTableBits)];
+
+	ExpandGreyRow(planes);
+}
+
+void PatternGenerator::ExpandGreyRow(uint16_t* const planes[kPixelPlaneCount])
+{
+	// Grey patterns are rendered into the first plane, set the colour difference planes to
+	// neutral for YUV, or copy the level to G and B for RGB
+	if (m_yuv)
+	{
+		std::fill(planes[kPixelPlaneCb], planes[kPixelPlaneCb] + m_width / 2, m_chromaCenter);
+		std::fill(planes[kPixelPlaneCr], planes[kPixelPlaneCr] + m_width / 2, m_chromaCenter);
+	}
+	else
+	{
+		std::copy(planes[kPixelPlaneR], planes[kPixelPlaneR] + m_width, planes[kPixelPlaneG]);
+		std::copy(planes[kPixelPlaneR], planes[kPixelPlaneR] + m_width, planes[kPixelPlaneB]);
+	}
+}
@@ -0,0 +1,165 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef PATTERN_GENERATOR_H
+#define PATTERN_GENERATOR_H
+
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "DeckLinkAPI.h"
+#include "PixelPacking.h"
+
+// Passed to GetNextFrame when the display time of the frame is not known, eg while prerolling
+static const int64_t kPatternGeneratorNoDeadline = INT64_MAX;
+
+enum MovingPattern
+{
+	kMovingPatternNone		= 0,
+	kMovingPatternBars,
+	kMovingPatternZonePlate,
+	kMovingPatternNoise,
+	kMovingPatternSweep
+};
+
+struct PatternGeneratorStatistics
+{
+	uint64_t	framesRendered;
+	uint64_t	lateFrames;					// Frames that were rendered after their display time
+	uint64_t	lastRenderMicroseconds;
+	uint64_t	maxRenderMicroseconds;
+	uint64_t	totalRenderMicroseconds;
+	uint32_t	threadCount;
+};
+
+// Renders a new frame of a moving pattern for every frame period, in any pixel format supported by
+// the pixel packing library.  Frames are allocated once from the output into a pool and recycled
+// when the output releases them.  A render thread keeps the free frames of the pool rendered ahead,
+// splitting each frame into stripes of rows that are rendered by a pool of threads, with the
+// render thread taking part.  Rows are rendered as 16-bit planes and packed by the SIMD kernels of
+// the pixel packing library.
+class PatternGenerator
+{
+public:
+	// A thread count of 0 uses one thread per CPU
+	PatternGenerator(IDeckLinkOutput* deckLinkOutput, long width, long height, BMDPixelFormat pixelFormat, MovingPattern pattern, uint32_t threadCount, uint32_t frameCount);
+	virtual ~PatternGenerator();
+
+	HRESULT						Start(void);
+	void						Stop(void);
+
+	// Returns the next rendered frame, waiting for it if rendering has fallen behind.  The frame
+	// is counted as late if it is rendered after its display time, microsecondsUntilDisplay from
+	// the call.  The frame is owned by the generator until it is returned with ReleaseFrame
+	HRESULT						GetNextFrame(IDeckLinkVideoFrame** frame, int64_t microsecondsUntilDisplay);
+	void						ReleaseFrame(IDeckLinkVideoFrame* frame);
+
+	uint32_t					GetFrameCount(void) const	{ return m_frameCount; };
+	PatternGeneratorStatistics	GetStatistics(void);
+
+	static const char*			GetPatternName(MovingPattern pattern);
+
+private:
+	// Per-thread row of 16-bit planes
+	struct RowBuffers
+	{
+		std::vector<uint16_t>	planes[kPixelPlaneCount];
+	};
+
+	IDeckLinkOutput*			m_deckLinkOutput;
+	long						m_width;
+	long						m_height;
+	BMDPixelFormat				m_pixelFormat;
+	MovingPattern				m_pattern;
+	uint32_t					m_threadCount;
+	uint32_t					m_frameCount;
+	bool						m_yuv;
+
+	// Sample values of the pixel format, in 16-bit MSB-aligned samples
+	uint16_t					m_black;
+	uint16_t					m_white;
+	uint16_t					m_chromaCenter;
+	uint16_t					m_bars[8][3];
+	std::vector<uint16_t>		m_sineTable;
+
+	// Frame pool
+	std::vector<IDeckLinkMutableVideoFrame*>	m_frames;
+	std::deque<IDeckLinkMutableVideoFrame*>		m_freeFrames;
+	std::deque<IDeckLinkMutableVideoFrame*>		m_renderedFrames;
+	std::mutex					m_frameMutex;
+	std::condition_variable		m_frameCondition;
+	std::thread					m_renderThread;
+	bool						m_running;
+	PatternGeneratorStatistics	m_statistics;
+
+	// Stripe rendering of the current frame
+	std::vector<std::thread>	m_workerThreads;
+	std::mutex					m_workerMutex;
+	std::condition_variable		m_workerCondition;
+	std::condition_variable		m_jobCompleteCondition;
+	uint8_t*					m_jobBytes;
+	long						m_jobRowBytes;
+	uint32_t					m_jobFrameNumber;
+	uint32_t					m_jobStripeCount;
+	std::atomic<uint32_t>		m_jobNextStripe;
+	uint64_t					m_jobGeneration;
+	uint32_t					m_workersFinished;
+	bool						m_terminateWorkers;
+	RowBuffers					m_renderRowBuffers;
+
+	void		InitializeLevels(void);
+	void		RenderThread(void);
+	void		WorkerThread(void);
+	void		RenderFrame(IDeckLinkMutableVideoFrame* frame, uint32_t frameNumber);
+	void		RenderStripes(RowBuffers& buffers);
+	void		RenderRow(uint32_t y, uint32_t frameNumber, uint16_t* const planes[kPixelPlaneCount]);
+	void		RenderBarsRow(uint32_t y, uint32_t frameNumber, uint16_t* const planes[kPixelPlaneCount]);
+	void		RenderZonePlateRow(uint32_t y, uint32_t frameNumber, uint16_t* const planes[kPixelPlaneCount]);
+	void		RenderNoiseRow(uint32_t y, uint32_t frameNumber, uint16_t* const planes[kPixelPlaneCount]);
+	void		RenderSweepRow(uint32_t y, uint32_t frameNumber, uint16_t* const planes[kPixelPlaneCount]);
+	void		ExpandGreyRow(uint16_t* const planes[kPixelPlaneCount]);
+};
+
+#endif
@@ -0,0 +1,576 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "FrameConverter.h"
+
+// Rows per stripe, stripes are claimed by the conversion threads in turn
+static const uint32_t kStripeRows = 16;
+
+// Levels of a pixel format, in 16-bit MSB-aligned sample values
+struct PixelFormatLevels
+{
+	bool		yuv;
+	bool		alpha;
+	uint32_t	bitDepth;
+	bool		fullRange;
+};
+
+static bool GetPixelFormatLevels(BMDPixelFormat pixelFormat, PixelFormatLevels& levels)
+{
+	switch (pixelFormat)
+	{
+		case bmdFormat8BitYUV:		levels = { true, false, 8, false };		return true;
+		case bmdFormat10BitYUV:		levels = { true, false, 10, false };	return true;
+		case bmdFormat8BitARGB:
+		case bmdFormat8BitBGRA:		levels = { false, true, 8, true };		return true;
+		case bmdFormat10BitRGB:
+		case bmdFormat10BitRGBX:
+		case bmdFormat10BitRGBXLE:	levels = { false, false, 10, false };	return true;
+		case bmdFormat12BitRGB:
+		case bmdFormat12BitRGBLE:	levels = { false, false, 12, true };	return true;
+		default:															return false;
+	}
+}
+
+// Offset and scale of each component from its sample value to the normalised range of 0..1 for
+// Y and RGB, and -0.5..0.5 for Cb and Cr
+static void GetComponentScaling(const PixelFormatLevels& levels, double offset[3], double scale[3])
+{
+	// Video range black and white are 16 and 235 at 8 bits (64 and 940 at 10 bits), chroma
+	// excursion is 224 (896 at 10 bits) either side of 128 (512 at 10 bits)
+	const double videoBlack = 16.0 * 256.0;
+	const double videoWhite = 235.0 * 256.0;
+	const double chromaCenter = 128.0 * 256.0;
+	const double chromaExcursion = 224.0 * 256.0;
+	const double fullWhite = (double)(((1 << levels.bitDepth) - 1) << (16 - levels.bitDepth));
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (levels.yuv && i != kPixelPlaneY)
+		{
+			offset[i] = chromaCenter;
+			scale[i] = 1.0 / chromaExcursion;
+		}
+		else if (levels.fullRange)
+		{
+			offset[i] = 0.0;
+			scale[i] = 1.0 / fullWhite;
+		}
+		else
+		{
+			offset[i] = videoBlack;
+			scale[i] = 1.0 / (videoWhite - videoBlack);
+		}
+	}
+}
+
+static void GetLumaCoefficients(BMDColorspace colorspace, double& kr, double& kb)
+{
+	switch (colorspace)
+	{
+		case bmdColorspaceRec601:	kr = 0.299;		kb = 0.114;		break;
+		case bmdColorspaceRec2020:	kr = 0.2627;	kb = 0.0593;	break;
+		case bmdColorspaceRec709:
+		default:					kr = 0.2126;	kb = 0.0722;	break;
+	}
+}
+
+// Build the matrix from source to destination sample values, combining the normalised colour
+// conversion with the level scaling of each pixel format and rounding for the packing truncation
+static void BuildConversionMatrix(const PixelFormatLevels& src, const PixelFormatLevels& dst, BMDColorspace colorspace, float matrix[3][4])
+{
+	double	color[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+	double	srcOffset[3], srcScale[3];
+	double	dstOffset[3], dstScale[3];
+	double	kr, kb, kg;
+
+	GetLumaCoefficients(colorspace, kr, kb);
+	kg = 1.0 - kr - kb;
+
+	if (src.yuv && !dst.yuv)
+	{
+		double yuvToRgb[3][3] = {
+			{ 1.0,	0.0,								2.0 * (1.0 - kr) },
+			{ 1.0,	-2.0 * kb * (1.0 - kb) / kg,		-2.0 * kr * (1.0 - kr) / kg },
+			{ 1.0,	2.0 * (1.0 - kb),					0.0 },
+		};
+		memcpy(color, yuvToRgb, sizeof(color));
+	}
+	else if (!src.yuv && dst.yuv)
+	{
+		double rgbToYuv[3][3] = {
+			{ kr,						kg,							kb },
+			{ -kr / (2.0 * (1.0 - kb)),	-kg / (2.0 * (1.0 - kb)),	0.5 },
+			{ 0.5,						-kg / (2.0 * (1.0 - kr)),	-kb / (2.0 * (1.0 - kr)) },
+		};
+		memcpy(color, rgbToYuv, sizeof(color));
+	}
+
+	GetComponentScaling(src, srcOffset, srcScale);
+	GetComponentScaling(dst, dstOffset, dstScale);
+
+	for (int i = 0; i < 3; i++)
+	{
+		double offset = dstOffset[i] + (double)(1 << (15 - dst.bitDepth));
+
+		for (int j = 0; j < 3; j++)
+		{
+			double coefficient = color[i][j] * srcScale[j] / dstScale[i];
+			matrix[i][j] = (float)coefficient;
+			offset -= coefficient * srcOffset[j];
+		}
+
+		matrix[i][3] = (float)offset;
+	}
+}
+
+static inline uint16_t ClampSample(float value)
+{
+	return (uint16_t)std::min(std::max(value, 0.0f), 65535.0f);
+}
+
+// Apply the conversion matrix to a row of 4:4:4 planes
+static void MatrixRowScalar(const uint16_t* const src[3], uint16_t* const dst[3], const float matrix[3][4], uint32_t x, uint32_t width)
+{
+	for (; x < width; x++)
+	{
+		float c0 = src[0][x];
+		float c1 = src[1][x];
+		float c2 = src[2][x];
+
+		for (int i = 0; i < 3; i++)
+			dst[i][x] = ClampSample(matrix[i][0] * c0 + matrix[i][1] * c1 + matrix[i][2] * c2 + matrix[i][3]);
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+// 8 pixels per iteration, the samples are built without optimisation flags so the matrix is
+// vectorised explicitly
+__attribute__((target("avx2")))
+static void MatrixRowAVX2(const uint16_t* const src[3], uint16_t* const dst[3], const float matrix[3][4], uint32_t width)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 maximum = _mm256_set1_ps(65535.0f);
+	uint32_t x = 0;
+
+	for (; x + 8 <= width; x += 8)
+	{
+		__m256 c[3];
+		for (int j = 0; j < 3; j++)
+			c[j] = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src[j] + x))));
+
+		for (int i = 0; i < 3; i++)
+		{
+			__m256 value = _mm256_set1_ps(matrix[i][3]);
+			for (int j = 0; j < 3; j++)
+				value = _mm256_add_ps(value, _mm256_mul_ps(_mm256_set1_ps(matrix[i][j]), c[j]));
+
+			__m256i samples = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(value, zero), maximum));
+			__m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(samples), _mm256_extracti128_si256(samples, 1));
+			_mm_storeu_si128((__m128i*)(dst[i] + x), packed);
+		}
+	}
+
+	MatrixRowScalar(src, dst, matrix, x, width);
+}
+
+static void MatrixRow(const uint16_t* const src[3], uint16_t* const dst[3], const float matrix[3][4], uint32_t width)
+{
+	// Follows the pixel packing implementation, so forcing the scalar reference applies here too
+	if (GetPixelPackingImplementation() == PixelPackingImplementation::AVX2)
+		MatrixRowAVX2(src, dst, matrix, width);
+	else
+		MatrixRowScalar(src, dst, matrix, 0, width);
+}
+
+#else
+
+static void MatrixRow(const uint16_t* const src[3], uint16_t* const dst[3], const float matrix[3][4], uint32_t width)
+{
+	MatrixRowScalar(src, dst, matrix, 0, width);
+}
+
+#endif
+
+// Co-sited 4:2:2 chroma to 4:4:4, interpolating the odd samples
+static void UpsampleChroma(const uint16_t* src, uint16_t* dst, uint32_t width)
+{
+	uint32_t chromaWidth = width / 2;
+
+	for (uint32_t i = 0; i < chromaWidth; i++)
+	{
+		uint32_t next = (i + 1 < chromaWidth) ? src[i + 1] : src[i];
+		dst[2 * i] = src[i];
+		dst[2 * i + 1] = (uint16_t)((src[i] + next + 1) / 2);
+	}
+}
+
+// 4:4:4 chroma to co-sited 4:2:2 with a [1 2 1] filter
+static void DownsampleChroma(const uint16_t* src, uint16_t* dst, uint32_t width)
+{
+	uint32_t chromaWidth = width / 2;
+
+	for (uint32_t i = 0; i < chromaWidth; i++)
+	{
+		uint32_t previous = (i > 0) ? src[2 * i - 1] : src[0];
+		dst[i] = (uint16_t)((previous + 2 * src[2 * i] + src[2 * i + 1] + 2) / 4);
+	}
+}
+
+FrameConverter::FrameConverter(uint32_t threadCount) :
+	m_refCount(1),
+	m_colorspace(kFrameConverterAutoColorspace),
+	m_jobGeneration(0),
+	m_workersFinished(0),
+	m_terminate(false),
+	m_statistics()
+{
+	if (threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	m_statistics.threadCount = threadCount;
+
+	// The calling thread converts stripes too
+	for (uint32_t i = 1; i < threadCount; i++)
+		m_workerThreads.emplace_back(&FrameConverter::WorkerThread, this);
+}
+
+FrameConverter::~FrameConverter()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_workerMutex);
+		m_terminate = true;
+	}
+	m_workerCondition.notify_all();
+
+	for (auto& thread : m_workerThreads)
+		thread.join();
+}
+
+void FrameConverter::SetColorspace(BMDColorspace colorspace)
+{
+	m_colorspace = colorspace;
+}
+
+FrameConverterStatistics FrameConverter::GetStatistics()
+{
+	std::lock_guard<std::mutex> lock(m_statisticsMutex);
+	return m_statistics;
+}
+
+BMDColorspace FrameConverter::GetFrameColorspace(IDeckLinkVideoFrame* frame)
+{
+	IDeckLinkVideoFrameMetadataExtensions*	metadataExtensions = NULL;
+	BMDColorspace							colorspace = m_colorspace;
+	int64_t									frameColorspace;
+
+	if (colorspace != kFrameConverterAutoColorspace)
+		return colorspace;
+
+	if (frame->QueryInterface(IID_IDeckLinkVideoFrameMetadataExtensions, (void**)&metadataExtensions) == S_OK)
+	{
+		if (metadataExtensions->GetInt(bmdDeckLinkFrameMetadataColorspace, &frameColorspace) == S_OK)
+			colorspace = (BMDColorspace)frameColorspace;
+
+		metadataExtensions->Release();
+	}
+
+	if ((colorspace != bmdColorspaceRec601) && (colorspace != bmdColorspaceRec709) && (colorspace != bmdColorspaceRec2020))
+		colorspace = (frame->GetHeight() < 720) ? bmdColorspaceRec601 : bmdColorspaceRec709;
+
+	return colorspace;
+}
+
+HRESULT FrameConverter::ConvertFrame(IDeckLinkVideoFrame* srcFrame, IDeckLinkVideoFrame* dstFrame)
+{
+	PixelFormatLevels	srcLevels;
+	PixelFormatLevels	dstLevels;
+	void*				srcBytes;
+	void*				dstBytes;
+	BMDColorspace		colorspace;
+
+	if ((srcFrame == NULL) || (dstFrame == NULL))
+		return E_INVALIDARG;
+
+	if ((srcFrame->GetWidth() != dstFrame->GetWidth()) || (srcFrame->GetHeight() != dstFrame->GetHeight()))
+		return E_INVALIDARG;
+
+	if (!GetPixelFormatLevels(srcFrame->GetPixelFormat(), srcLevels) || !GetPixelFormatLevels(dstFrame->GetPixelFormat(), dstLevels))
+		return E_INVALIDARG;
+
+	uint32_t width = (uint32_t)srcFrame->GetWidth();
+	uint32_t height = (uint32_t)srcFrame->GetHeight();
+
+	if ((srcFrame->GetRowBytes() < (long)GetPixelFormatRowBytes(srcFrame->GetPixelFormat(), width)) ||
+		(dstFrame->GetRowBytes() < (long)GetPixelFormatRowBytes(dstFrame->GetPixelFormat(), width)) ||
+		((srcLevels.yuv || dstLevels.yuv) && (width % 2) != 0))
+		return E_INVALIDARG;
+
+	if ((srcFrame->GetBytes(&srcBytes) != S_OK) || (dstFrame->GetBytes(&dstBytes) != S_OK))
+		return E_FAIL;
+
+	std::lock_guard<std::mutex> conversionLock(m_conversionMutex);
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	colorspace = GetFrameColorspace(srcFrame);
+
+	{
+		std::unique_lock<std::mutex> lock(m_workerMutex);
+
+		if (srcFrame->GetPixelFormat() == dstFrame->GetPixelFormat())
+			m_job.type = ConversionType::Copy;
+		else if (srcLevels.yuv && dstLevels.yuv)
+			m_job.type = ConversionType::YUVToYUV;
+		else
+			m_job.type = ConversionType::Generic;
+
+		m_job.srcPixelFormat	= srcFrame->GetPixelFormat();
+		m_job.dstPixelFormat	= dstFrame->GetPixelFormat();
+		m_job.srcBytes			= (const uint8_t*)srcBytes;
+		m_job.dstBytes			= (uint8_t*)dstBytes;
+		m_job.srcRowBytes		= srcFrame->GetRowBytes();
+		m_job.dstRowBytes		= dstFrame->GetRowBytes();
+		m_job.width				= width;
+		m_job.height			= height;
+		m_job.copyAlpha			= srcLevels.alpha && dstLevels.alpha;
+		m_job.stripeCount		= (height + kStripeRows - 1) / kStripeRows;
+		m_job.nextStripe		= 0;
+		BuildConversionMatrix(srcLevels, dstLevels, colorspace, m_job.matrix);
+
+		m_workersFinished = 0;
+		m_jobGeneration++;
+	}
+	m_workerCondition.notify_all();
+
+	ConvertStripes(m_callerRowBuffers);
+
+	{
+		// The job must stay valid until every worker has finished with it
+		std::unique_lock<std::mutex> lock(m_workerMutex);
+		m_jobCompleteCondition.wait(lock, [&]{ return m_workersFinished == m_workerThreads.size(); });
+	}
+
+	uint64_t conversionTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+	{
+		std::lock_guard<std::mutex> lock(m_statisticsMutex);
+
+		if ((m_statistics.conversionCount == 0) || (conversionTime < m_statistics.minConversionMicroseconds))
+			m_statistics.minConversionMicroseconds = conversionTime;
+		if (conversionTime > m_statistics.maxConversionMicroseconds)
+			m_statistics.maxConversionMicroseconds = conversionTime;
+
+		m_statistics.conversionCount++;
+		m_statistics.lastConversionMicroseconds = conversionTime;
+		m_statistics.totalConversionMicroseconds += conversionTime;
+		m_statistics.lastColorspace = colorspace;
+	}
+
+	return S_OK;
+}
+
+void FrameConverter::WorkerThread()
+{
+	RowBuffers	buffers;
+	uint64_t	generation = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_workerMutex);
+			m_workerCondition.wait(lock, [&]{ return m_terminate || (m_jobGeneration != generation); });
+
+			if (m_terminate)
+				break;
+
+			generation = m_jobGeneration;
+		}
+
+		ConvertStripes(buffers);
+
+		{
+			std::lock_guard<std::mutex> lock(m_workerMutex);
+			m_workersFinished++;
+		}
+		m_jobCompleteCondition.notify_one();
+	}
+}
+
+void FrameConverter::ConvertStripes(RowBuffers& buffers)
+{
+	uint32_t bufferWidth = m_job.width + 16;
+
+	for (int i = 0; i < kPixelPlaneCount; i++)
+	{
+		if (buffers.src[i].size() < bufferWidth)
+		{
+			buffers.src[i].resize(bufferWidth);
+			buffers.dst[i].resize(bufferWidth);
+		}
+	}
+	for (int i = 0; i < 2; i++)
+	{
+		if (buffers.chroma[i].size() < bufferWidth)
+			buffers.chroma[i].resize(bufferWidth);
+	}
+
+	while (true)
+	{
+		uint32_t stripe = m_job.nextStripe.fetch_add(1);
+		if (stripe >= m_job.stripeCount)
+			break;
+
+		uint32_t endRow = std::min((stripe + 1) * kStripeRows, m_job.height);
+
+		for (uint32_t row = stripe * kStripeRows; row < endRow; row++)
+			ConvertRow(m_job.srcBytes + (uint64_t)row * m_job.srcRowBytes, m_job.dstBytes + (uint64_t)row * m_job.dstRowBytes, buffers);
+	}
+}
+
+void FrameConverter::ConvertRow(const uint8_t* srcRow, uint8_t* dstRow, RowBuffers& buffers)
+{
+	const uint32_t	width = m_job.width;
+	const float		(*matrix)[4] = m_job.matrix;
+
+	if (m_job.type == ConversionType::Copy)
+	{
+		memcpy(dstRow, srcRow, std::min(m_job.srcRowBytes, m_job.dstRowBytes));
+		return;
+	}
+
+	uint16_t* srcPlanes[kPixelPlaneCount] = { buffers.src[0].data(), buffers.src[1].data(), buffers.src[2].data(), m_job.copyAlpha ? buffers.src[3].data() : nullptr };
+	const uint16_t* dstPlanes[kPixelPlaneCount] = { buffers.dst[0].data(), buffers.dst[1].data(), buffers.dst[2].data(), srcPlanes[kPixelPlaneA] };
+
+	UnpackPixelRow(m_job.srcPixelFormat, srcRow, srcPlanes, width);
+
+	if (m_job.type == ConversionType::YUVToYUV)
+	{
+		// Only the bit depth changes, convert each plane at its own width
+		for (int i = 0; i < 3; i++)
+		{
+			uint32_t	planeWidth = (i == kPixelPlaneY) ? width : width / 2;
+			uint16_t*	dst = buffers.dst[i].data();
+
+			for (uint32_t x = 0; x < planeWidth; x++)
+				dst[x] = ClampSample(matrix[i][i] * srcPlanes[i][x] + matrix[i][3]);
+		}
+	}
+	else
+	{
+		const uint16_t*	src[3] = { srcPlanes[0], srcPlanes[1], srcPlanes[2] };
+		uint16_t*		dst[3] = { buffers.dst[0].data(), buffers.dst[1].data(), buffers.dst[2].data() };
+		bool			dstYUV = IsPixelFormatYUV(m_job.dstPixelFormat);
+
+		if (IsPixelFormatYUV(m_job.srcPixelFormat))
+		{
+			UpsampleChroma(srcPlanes[kPixelPlaneCb], buffers.chroma[0].data(), width);
+			UpsampleChroma(srcPlanes[kPixelPlaneCr], buffers.chroma[1].data(), width);
+			src[kPixelPlaneCb] = buffers.chroma[0].data();
+			src[kPixelPlaneCr] = buffers.chroma[1].data();
+		}
+
+		if (dstYUV)
+		{
+			// Convert chroma at full width, then filter to the destination planes
+			dst[kPixelPlaneCb] = buffers.chroma[0].data();
+			dst[kPixelPlaneCr] = buffers.chroma[1].data();
+		}
+
+		MatrixRow(src, dst, matrix, width);
+
+		if (dstYUV)
+		{
+			DownsampleChroma(dst[kPixelPlaneCb], buffers.dst[kPixelPlaneCb].data(), width);
+			DownsampleChroma(dst[kPixelPlaneCr], buffers.dst[kPixelPlaneCr].data(), width);
+		}
+	}
+
+	PackPixelRow(m_job.dstPixelFormat, dstPlanes, dstRow, width);
+}
+
+HRESULT	FrameConverter::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	CFUUIDBytes		iunknown;
+	HRESULT			result = E_NOINTERFACE;
+
+	if (ppv == NULL)
+		return E_INVALIDARG;
+
+	// Initialise the return result
+	*ppv = NULL;
+
+	// Obtain the IUnknown interface and compare it the provided REFIID
+	iunknown = CFUUIDGetUUIDBytes(IUnknownUUID);
+	if (memcmp(&iid, &iunknown, sizeof(REFIID)) == 0)
+	{
+		*ppv = this;
+		AddRef();
+		result = S_OK;
+	}
+	else if (memcmp(&iid, &IID_IDeckLinkVideoConversion, sizeof(REFIID)) == 0)
+	{
+		*ppv = (IDeckLinkVideoConversion*)this;
+		AddRef();
+		result = S_OK;
+	}
+
+	return result;
+}
+
+ULONG FrameConverter::AddRef(void)
+{
+	return ++m_refCount;
+}
+
+ULONG FrameConverter::Release(void)
+{
+	ULONG newRefValue = --m_refCount;
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
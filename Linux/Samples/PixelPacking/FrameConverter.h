@@ -0,0 +1,145 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "DeckLinkAPI.h"
+#include "PixelPacking.h"
+
+// CPU frame conversion engine, implementing the IDeckLinkVideoConversion::ConvertFrame contract
+// for all pairs of 2vuy, v210, r210, R10b, R10l, R12B, R12L, BGRA and ARGB frames of the same
+// dimensions.  Frames are converted in stripes of rows by a pool of threads, with the calling
+// thread taking part, so conversion scales with cores and does not depend on the DeckLink driver.
+//
+// Rows are unpacked to 16-bit planes, converted between YUV and RGB with the selected BT.601,
+// BT.709 or BT.2020 matrix and between video and full range levels as required by the pixel
+// formats, then packed.  4:2:2 chroma is interpolated to 4:4:4 when converting to RGB and
+// filtered [1 2 1] when converting from RGB.
+
+static const BMDColorspace kFrameConverterAutoColorspace = 0;
+
+struct FrameConverterStatistics
+{
+	uint64_t		conversionCount;
+	uint64_t		lastConversionMicroseconds;
+	uint64_t		minConversionMicroseconds;
+	uint64_t		maxConversionMicroseconds;
+	uint64_t		totalConversionMicroseconds;
+	BMDColorspace	lastColorspace;
+	uint32_t		threadCount;
+};
+
+class FrameConverter : public IDeckLinkVideoConversion
+{
+public:
+	// A thread count of 0 uses one thread per CPU
+	FrameConverter(uint32_t threadCount = 0);
+	virtual ~FrameConverter();
+
+	// Matrix for YUV frames.  The default of kFrameConverterAutoColorspace uses the colorspace metadata
+	// of the source frame if present, otherwise Rec.601 for SD and Rec.709 for HD and above
+	void						SetColorspace(BMDColorspace colorspace);
+	FrameConverterStatistics	GetStatistics(void);
+
+	// IDeckLinkVideoConversion interface
+	virtual HRESULT		STDMETHODCALLTYPE	ConvertFrame(IDeckLinkVideoFrame* srcFrame, IDeckLinkVideoFrame* dstFrame);
+
+	// IUnknown interface
+	virtual HRESULT		STDMETHODCALLTYPE	QueryInterface(REFIID iid, LPVOID *ppv);
+	virtual ULONG		STDMETHODCALLTYPE	AddRef();
+	virtual ULONG		STDMETHODCALLTYPE	Release();
+
+private:
+	enum class ConversionType { Copy, YUVToYUV, Generic };
+
+	// Per-thread row buffers of 16-bit planes
+	struct RowBuffers
+	{
+		std::vector<uint16_t>	src[kPixelPlaneCount];
+		std::vector<uint16_t>	dst[kPixelPlaneCount];
+		std::vector<uint16_t>	chroma[2];
+	};
+
+	struct ConversionJob
+	{
+		ConversionType			type;
+		BMDPixelFormat			srcPixelFormat;
+		BMDPixelFormat			dstPixelFormat;
+		const uint8_t*			srcBytes;
+		uint8_t*				dstBytes;
+		long					srcRowBytes;
+		long					dstRowBytes;
+		uint32_t				width;
+		uint32_t				height;
+		bool					copyAlpha;
+		float					matrix[3][4];		// dst = matrix * src + offset, in 16-bit sample values
+		uint32_t				stripeCount;
+		std::atomic<uint32_t>	nextStripe;
+	};
+
+	std::atomic<ULONG>			m_refCount;
+	std::atomic<BMDColorspace>	m_colorspace;
+
+	// Serialises calls to ConvertFrame
+	std::mutex					m_conversionMutex;
+
+	std::vector<std::thread>	m_workerThreads;
+	std::mutex					m_workerMutex;
+	std::condition_variable		m_workerCondition;
+	std::condition_variable		m_jobCompleteCondition;
+	ConversionJob				m_job;
+	uint64_t					m_jobGeneration;
+	uint32_t					m_workersFinished;
+	bool						m_terminate;
+	RowBuffers					m_callerRowBuffers;
+
+	std::mutex					m_statisticsMutex;
+	FrameConverterStatistics	m_statistics;
+
+	BMDColorspace	GetFrameColorspace(IDeckLinkVideoFrame* frame);
+	void			WorkerThread(void);
+	void			ConvertStripes(RowBuffers& buffers);
+	void			ConvertRow(const uint8_t* srcRow, uint8_t* dstRow, RowBuffers& buffers);
+};
@@ -0,0 +1,460 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <atomic>
+#include <cstring>
+
+#include "PixelPacking.h"
+#include "PixelPackingKernels.h"
+
+// Scalar reference kernels.  Packed words are assembled as host integers, which assumes a
+// little-endian host as on all platforms supported by the DeckLink SDK.
+
+static inline uint32_t To8Bit(uint16_t sample)		{ return sample >> 8; }
+static inline uint32_t To10Bit(uint16_t sample)		{ return sample >> 6; }
+static inline uint32_t To12Bit(uint16_t sample)		{ return sample >> 4; }
+static inline uint16_t From8Bit(uint32_t value)		{ return (uint16_t)((value & 0xFF) << 8); }
+static inline uint16_t From10Bit(uint32_t value)	{ return (uint16_t)((value & 0x3FF) << 6); }
+static inline uint16_t From12Bit(uint32_t value)	{ return (uint16_t)((value & 0xFFF) << 4); }
+
+static inline uint32_t LoadWord(const uint8_t* bytes, bool bigEndian)
+{
+	uint32_t word;
+	memcpy(&word, bytes, sizeof(word));
+	return bigEndian ? __builtin_bswap32(word) : word;
+}
+
+static inline void StoreWord(uint8_t* bytes, uint32_t word, bool bigEndian)
+{
+	if (bigEndian)
+		word = __builtin_bswap32(word);
+	memcpy(bytes, &word, sizeof(word));
+}
+
+// 2vuy - Cb0 Y0 Cr0 Y1, 8 bits each
+
+static void Pack2vuyRowScalar(const uint16_t* const planes[kPixelPlaneCount], void* row, uint32_t width)
+{
+	uint8_t* bytes = (uint8_t*)row;
+
+	for (uint32_t x = 0; x < width; x += 2)
+	{
+		*bytes++ = (uint8_t)To8Bit(planes[kPixelPlaneCb][x / 2]);
+		*bytes++ = (uint8_t)To8Bit(planes[kPixelPlaneY][x]);
+		*bytes++ = (uint8_t)To8Bit(planes[kPixelPlaneCr][x / 2]);
+		*bytes++ = (uint8_t)To8Bit(planes[kPixelPlaneY][x + 1]);
+	}
+}
+
+static void Unpack2vuyRowScalar(const void* row, uint16_t* const planes[kPixelPlaneCount], uint32_t width)
+{
+	const uint8_t* bytes = (const uint8_t*)row;
+
+	for (uint32_t x = 0; x < width; x += 2)
+	{
+		planes[kPixelPlaneCb][x / 2]	= From8Bit(*bytes++);
+		planes[kPixelPlaneY][x]			= From8Bit(*bytes++);
+		planes[kPixelPlaneCr][x / 2]	= From8Bit(*bytes++);
+		planes[kPixelPlaneY][x + 1]		= From8Bit(*bytes++);
+	}
+}
+
+// v210 - 6 pixels in 4 little-endian words, 10 bits per sample:
+//   Cb0 Y0 Cr0 | Y1 Cb1 Y2 | Cr1 Y3 Cb2 | Y4 Cr2 Y5
+
+static void PackV210RowScalar(const uint16_t* const planes[kPixelPlaneCount], void* row, uint32_t width)
+{
+	const uint16_t*	y = planes[kPixelPlaneY];
+	const uint16_t*	cb = planes[kPixelPlaneCb];
+	const uint16_t*	cr = planes[kPixelPlaneCr];
+	uint8_t*		bytes = (uint8_t*)row;
+
+	for (uint32_t x = 0; x < width; x += 6, y += 6, cb += 3, cr += 3, bytes += 16)
+	{
+		uint32_t s[12];	// Samples of the group in packing order
+
+		if (x + 6 <= width)
+		{
+			s[0] = To10Bit(cb[0]);	s[1] = To10Bit(y[0]);	s[2] = To10Bit(cr[0]);
+			s[3] = To10Bit(y[1]);	s[4] = To10Bit(cb[1]);	s[5] = To10Bit(y[2]);
+			s[6] = To10Bit(cr[1]);	s[7] = To10Bit(y[3]);	s[8] = To10Bit(cb[2]);
+			s[9] = To10Bit(y[4]);	s[10] = To10Bit(cr[2]);	s[11] = To10Bit(y[5]);
+		}
+		else
+		{
+			// Partial group at the end of the row, zero-fill missing samples
+			uint32_t pixels = width - x;
+
+			s[0] = To10Bit(cb[0]);						s[1] = To10Bit(y[0]);						s[2] = To10Bit(cr[0]);
+			s[3] = To10Bit(y[1]);						s[4] = pixels > 2 ? To10Bit(cb[1]) : 0;		s[5] = pixels > 2 ? To10Bit(y[2]) : 0;
+			s[6] = pixels > 2 ? To10Bit(cr[1]) : 0;		s[7] = pixels > 3 ? To10Bit(y[3]) : 0;		s[8] = pixels > 4 ? To10Bit(cb[2]) : 0;
+			s[9] = pixels > 4 ? To10Bit(y[4]) : 0;		s[10] = pixels > 4 ? To10Bit(cr[2]) : 0;	s[11] = pixels > 5 ? To10Bit(y[5]) : 0;
+		}
+
+		for (int i = 0; i < 4; i++)
+			StoreWord(bytes + i * 4, s[i * 3] | (s[i * 3 + 1] << 10) | (s[i * 3 + 2] << 20), false);
+	}
+}
+
+static void UnpackV210RowScalar(const void* row, uint16_t* const planes[kPixelPlaneCount], uint32_t width)
+{
+	uint16_t*		y = planes[kPixelPlaneY];
+	uint16_t*		cb = planes[kPixelPlaneCb];
+	uint16_t*		cr = planes[kPixelPlaneCr];
+	const uint8_t*	bytes = (const uint8_t*)row;
+
+	for (uint32_t x = 0; x < width; x += 6, y += 6, cb += 3, cr += 3, bytes += 16)
+	{
+		uint32_t s[12];
+		uint32_t pixels = (width - x < 6) ? width - x : 6;
+
+		for (int i = 0; i < 4; i++)
+		{
+			uint32_t word = LoadWord(bytes + i * 4, false);
+			s[i * 3]		= word;
+			s[i * 3 + 1]	= word >> 10;
+			s[i * 3 + 2]	= word >> 20;
+		}
+
+		cb[0] = From10Bit(s[0]);	y[0] = From10Bit(s[1]);		cr[0] = From10Bit(s[2]);
+		y[1] = From10Bit(s[3]);
+		if (pixels > 2)
+		{
+			cb[1] = From10Bit(s[4]);	y[2] = From10Bit(s[5]);		cr[1] = From10Bit(s[6]);
+			y[3] = From10Bit(s[7]);
+		}
+		if (pixels > 4)
+		{
+			cb[2] = From10Bit(s[8]);	y[4] = From10Bit(s[9]);		cr[2] = From10Bit(s[10]);
+			y[5] = From10Bit(s[11]);
+		}
+	}
+}
+
+// 10-bit RGB, one word per pixel:
+//   r210 - big-endian,    x:2 R:10 G:10 B:10
+//   R10b - big-endian,    R:10 G:10 B:10 x:2
+//   R10l - little-endian, R:10 G:10 B:10 x:2
+
+template<bool BigEndian, int Shift>
+static void PackRGB10RowScalar(const uint16_t* const planes[kPixelPlaneCount], void* row, uint32_t width)
+{
+	uint8_t* bytes = (uint8_t*)row;
+
+	for (uint32_t x = 0; x < width; x++, bytes += 4)
+	{
+		uint32_t word = (To10Bit(planes[kPixelPlaneR][x]) << 20) | (To10Bit(planes[kPixelPlaneG][x]) << 10) | To10Bit(planes[kPixelPlaneB][x]);
+		StoreWord(bytes, word << Shift, BigEndian);
+	}
+}
+
+template<bool BigEndian, int Shift>
+static void UnpackRGB10RowScalar(const void* row, uint16_t* const planes[kPixelPlaneCount], uint32_t width)
+{
+	const uint8_t* bytes = (const uint8_t*)row;
+
+	for (uint32_t x = 0; x < width; x++, bytes += 4)
+	{
+		uint32_t word = LoadWord(bytes, BigEndian) >> Shift;
+		planes[kPixelPlaneR][x] = From10Bit(word >> 20);
+		planes[kPixelPlaneG][x] = From10Bit(word >> 10);
+		planes[kPixelPlaneB][x] = From10Bit(word);
+	}
+}
+
+// 12-bit RGB - 8 pixels in 9 words, as a stream of 12-bit R G B samples filling each word from
+// its least significant bit.  R12L words are little-endian, R12B words are big-endian
+
+template<bool BigEndian>
+static void PackRGB12RowScalar(const uint16_t* const planes[kPixelPlaneCount], void* row, uint32_t width)
+{
+	uint8_t* bytes = (uint8_t*)row;
+
+	for (uint32_t x = 0; x < width; x += 8)
+	{
+		uint64_t	bits = 0;
+		int			bitCount = 0;
+
+		for (uint32_t i = x; i < x + 8; i++)
+		{
+			for (int plane = kPixelPlaneR; plane <= kPixelPlaneB; plane++)
+			{
+				bits |= (uint64_t)(i < width ? To12Bit(planes[plane][i]) : 0) << bitCount;
+				bitCount += 12;
+
+				if (bitCount >= 32)
+				{
+					StoreWord(bytes, (uint32_t)bits, BigEndian);
+					bytes += 4;
+					bits >>= 32;
+					bitCount -= 32;
+				}
+			}
+		}
+	}
+}
+
+template<bool BigEndian>
+static void UnpackRGB12RowScalar(const void* row, uint16_t* const planes[kPixelPlaneCount], uint32_t width)
+{
+	const uint8_t* bytes = (const uint8_t*)row;
+
+	for (uint32_t x = 0; x < width; x += 8)
+	{
+		uint64_t	bits = 0;
+		int			bitCount = 0;
+
+		for (uint32_t i = x; i < x + 8; i++)
+		{
+			for (int plane = kPixelPlaneR; plane <= kPixelPlaneB; plane++)
+			{
+				if (bitCount < 12)
+				{
+					bits |= (uint64_t)LoadWord(bytes, BigEndian) << bitCount;
+					bytes += 4;
+					bitCount += 32;
+				}
+
+				if (i < width)
+					planes[plane][i] = From12Bit((uint32_t)bits);
+				bits >>= 12;
+				bitCount -= 12;
+			}
+		}
+	}
+}
+
+// 8-bit RGB with alpha, one byte per component in the order given
+
+template<int A, int R, int G, int B>
+static void PackRGBA8RowScalar(const uint16_t* const planes[kPixelPlaneCount], void* row, uint32_t width)
+{
+	uint8_t* bytes = (uint8_t*)row;
+
+	for (uint32_t x = 0; x < width; x++, bytes += 4)
+	{
+		bytes[A] = planes[kPixelPlaneA] ? (uint8_t)To8Bit(planes[kPixelPlaneA][x]) : 0xFF;
+		bytes[R] = (uint8_t)To8Bit(planes[kPixelPlaneR][x]);
+		bytes[G] = (uint8_t)To8Bit(planes[kPixelPlaneG][x]);
+		bytes[B] = (uint8_t)To8Bit(planes[kPixelPlaneB][x]);
+	}
+}
+
+template<int A, int R, int G, int B>
+static void UnpackRGBA8RowScalar(const void* row, uint16_t* const planes[kPixelPlaneCount], uint32_t width)
+{
+	const uint8_t* bytes = (const uint8_t*)row;
+
+	for (uint32_t x = 0; x < width; x++, bytes += 4)
+	{
+		if (planes[kPixelPlaneA])
+			planes[kPixelPlaneA][x] = From8Bit(bytes[A]);
+		planes[kPixelPlaneR][x] = From8Bit(bytes[R]);
+		planes[kPixelPlaneG][x] = From8Bit(bytes[G]);
+		planes[kPixelPlaneB][x] = From8Bit(bytes[B]);
+	}
+}
+
+bool GetScalarPixelPackingKernels(BMDPixelFormat pixelFormat, PixelPackingKernels& kernels)
+{
+	switch (pixelFormat)
+	{
+		case bmdFormat8BitYUV:
+			kernels = { Pack2vuyRowScalar, Unpack2vuyRowScalar };
+			return true;
+
+		case bmdFormat10BitYUV:
+			kernels = { PackV210RowScalar, UnpackV210RowScalar };
+			return true;
+
+		case bmdFormat10BitRGB:
+			kernels = { PackRGB10RowScalar<true, 0>, UnpackRGB10RowScalar<true, 0> };
+			return true;
+
+		case bmdFormat10BitRGBX:
+			kernels = { PackRGB10RowScalar<true, 2>, UnpackRGB10RowScalar<true, 2> };
+			return true;
+
+		case bmdFormat10BitRGBXLE:
+			kernels = { PackRGB10RowScalar<false, 2>, UnpackRGB10RowScalar<false, 2> };
+			return true;
+
+		case bmdFormat12BitRGB:
+			kernels = { PackRGB12RowScalar<true>, UnpackRGB12RowScalar<true> };
+			return true;
+
+		case bmdFormat12BitRGBLE:
+			kernels = { PackRGB12RowScalar<false>, UnpackRGB12RowScalar<false> };
+			return true;
+
+		case bmdFormat8BitBGRA:
+			kernels = { PackRGBA8RowScalar<3, 2, 1, 0>, UnpackRGBA8RowScalar<3, 2, 1, 0> };
+			return true;
+
+		case bmdFormat8BitARGB:
+			kernels = { PackRGBA8RowScalar<0, 1, 2, 3>, UnpackRGBA8RowScalar<0, 1, 2, 3> };
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+// Implementation selection
+
+static PixelPackingImplementation GetSupportedImplementation(PixelPackingImplementation requested)
+{
+	if (requested == PixelPackingImplementation::AVX2 && !IsAVX2Supported())
+		requested = PixelPackingImplementation::SSE41;
+
+	if (requested == PixelPackingImplementation::SSE41 && !IsSSE41Supported())
+		requested = PixelPackingImplementation::Scalar;
+
+	return requested;
+}
+
+static std::atomic<PixelPackingImplementation>& SelectedImplementation(void)
+{
+	static std::atomic<PixelPackingImplementation> implementation(GetSupportedImplementation(PixelPackingImplementation::AVX2));
+	return implementation;
+}
+
+static bool GetKernels(BMDPixelFormat pixelFormat, PixelPackingKernels& kernels)
+{
+	switch (SelectedImplementation().load(std::memory_order_relaxed))
+	{
+		case PixelPackingImplementation::AVX2:
+			if (GetAVX2PixelPackingKernels(pixelFormat, kernels))
+				return true;
+			// Fall through for pixel formats without an AVX2 kernel
+		case PixelPackingImplementation::SSE41:
+			if (GetSSE41PixelPackingKernels(pixelFormat, kernels))
+				return true;
+			// Fall through for pixel formats without an SSE4.1 kernel
+		case PixelPackingImplementation::Scalar:
+		default:
+			return GetScalarPixelPackingKernels(pixelFormat, kernels);
+	}
+}
+
+PixelPackingImplementation GetPixelPackingImplementation()
+{
+	return SelectedImplementation().load(std::memory_order_relaxed);
+}
+
+PixelPackingImplementation SetPixelPackingImplementation(PixelPackingImplementation implementation)
+{
+	implementation = GetSupportedImplementation(implementation);
+	SelectedImplementation().store(implementation, std::memory_order_relaxed);
+	return implementation;
+}
+
+const char* GetPixelPackingImplementationName(PixelPackingImplementation implementation)
+{
+	switch (implementation)
+	{
+		case PixelPackingImplementation::AVX2:		return "AVX2";
+		case PixelPackingImplementation::SSE41:		return "SSE4.1";
+		case PixelPackingImplementation::Scalar:
+		default:									return "Scalar";
+	}
+}
+
+// Public interface
+
+bool IsPixelPackingSupported(BMDPixelFormat pixelFormat)
+{
+	PixelPackingKernels kernels;
+	return GetScalarPixelPackingKernels(pixelFormat, kernels);
+}
+
+bool IsPixelFormatYUV(BMDPixelFormat pixelFormat)
+{
+	return (pixelFormat == bmdFormat8BitYUV) || (pixelFormat == bmdFormat10BitYUV);
+}
+
+uint32_t GetPixelFormatRowBytes(BMDPixelFormat pixelFormat, uint32_t width)
+{
+	// Refer to DeckLink SDK Manual - 2.7.4 Pixel Formats
+	switch (pixelFormat)
+	{
+		case bmdFormat8BitYUV:
+			return width * 2;
+
+		case bmdFormat10BitYUV:
+			return ((width + 47) / 48) * 128;
+
+		case bmdFormat10BitRGB:
+		case bmdFormat10BitRGBX:
+		case bmdFormat10BitRGBXLE:
+			return ((width + 63) / 64) * 256;
+
+		case bmdFormat12BitRGB:
+		case bmdFormat12BitRGBLE:
+			return ((width + 7) / 8) * 36;
+
+		case bmdFormat8BitARGB:
+		case bmdFormat8BitBGRA:
+		default:
+			return width * 4;
+	}
+}
+
+bool PackPixelRow(BMDPixelFormat pixelFormat, const uint16_t* const planes[kPixelPlaneCount], void* row, uint32_t width)
+{
+	PixelPackingKernels kernels;
+
+	if ((IsPixelFormatYUV(pixelFormat) && (width % 2) != 0) || !GetKernels(pixelFormat, kernels))
+		return false;
+
+	kernels.pack(planes, row, width);
+	return true;
+}
+
+bool UnpackPixelRow(BMDPixelFormat pixelFormat, const void* row, uint16_t* const planes[kPixelPlaneCount], uint32_t width)
+{
+	PixelPackingKernels kernels;
+
+	if ((IsPixelFormatYUV(pixelFormat) && (width % 2) != 0) || !GetKernels(pixelFormat, kernels))
+		return false;
+
+	kernels.unpack(row, planes, width);
+	return true;
+}
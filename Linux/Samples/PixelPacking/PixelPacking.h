@@ -0,0 +1,89 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include "DeckLinkAPI.h"
+
+// Pixel packing library.  Converts rows between planar 16-bit samples and the packed DeckLink
+// pixel formats 2vuy, v210, r210, R12B, R12L, R10l, R10b, BGRA and ARGB, refer to DeckLink SDK
+// Manual - 2.7.4 Pixel Formats for the packing structures.
+//
+// Planar samples are MSB-aligned in 16 bits, so a 10-bit value v is stored as v << 6.  Packing
+// truncates to the bit depth of the pixel format and unpacking zero-fills the low bits, so an
+// unpack followed by a pack reproduces the packed row exactly.  No range or colour conversion
+// is done.
+//
+// YUV formats (2vuy, v210) use planes Y, Cb and Cr, with width / 2 chroma samples (4:2:2), the
+// width must be even.  RGB formats use planes R, G and B; the A plane is only used by BGRA and
+// ARGB, and may be NULL, in which case packing writes opaque alpha and unpacking skips it.
+//
+// Rows are converted by SSE4.1 or AVX2 kernels when the CPU supports them, selected at runtime,
+// otherwise by the scalar reference kernels.  Packing writes whole pixel groups (6 pixels for
+// v210, 8 pixels for 12-bit RGB), zero-filling samples beyond the width, and never writes past
+// GetPixelFormatRowBytes(pixelFormat, width).
+
+enum PixelPlane
+{
+	kPixelPlaneY		= 0,
+	kPixelPlaneCb		= 1,
+	kPixelPlaneCr		= 2,
+	kPixelPlaneR		= 0,
+	kPixelPlaneG		= 1,
+	kPixelPlaneB		= 2,
+	kPixelPlaneA		= 3,
+	kPixelPlaneCount	= 4
+};
+
+enum class PixelPackingImplementation { Scalar = 0, SSE41, AVX2 };
+
+bool			IsPixelPackingSupported(BMDPixelFormat pixelFormat);
+bool			IsPixelFormatYUV(BMDPixelFormat pixelFormat);
+uint32_t		GetPixelFormatRowBytes(BMDPixelFormat pixelFormat, uint32_t width);
+
+bool			PackPixelRow(BMDPixelFormat pixelFormat, const uint16_t* const planes[kPixelPlaneCount], void* row, uint32_t width);
+bool			UnpackPixelRow(BMDPixelFormat pixelFormat, const void* row, uint16_t* const planes[kPixelPlaneCount], uint32_t width);
+
+// The implementation is detected on first use.  Setting it, eg to compare against the scalar
+// reference, is limited to what the CPU supports and returns the implementation selected
+PixelPackingImplementation	GetPixelPackingImplementation(void);
+PixelPackingImplementation	SetPixelPackingImplementation(PixelPackingImplementation implementation);
+const char*					GetPixelPackingImplementationName(PixelPackingImplementation implementation);
@@ -0,0 +1,325 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <time.h>
+#include <vector>
+
+#include "PixelPacking.h"
+#include "PixelPackingBenchmark.h"
+#include "PixelPackingKernels.h"
+
+namespace
+{
+	struct PixelFormatName
+	{
+		BMDPixelFormat	pixelFormat;
+		const char*		name;
+	};
+
+	const PixelFormatName kPixelFormats[] =
+	{
+		{ bmdFormat8BitYUV,			"2vuy" },
+		{ bmdFormat10BitYUV,		"v210" },
+		{ bmdFormat10BitRGB,		"r210" },
+		{ bmdFormat10BitRGBX,		"R10b" },
+		{ bmdFormat10BitRGBXLE,		"R10l" },
+		{ bmdFormat12BitRGB,		"R12B" },
+		{ bmdFormat12BitRGBLE,		"R12L" },
+		{ bmdFormat8BitBGRA,		"BGRA" },
+		{ bmdFormat8BitARGB,		"ARGB" },
+	};
+
+	const PixelPackingImplementation kImplementations[] =
+	{
+		PixelPackingImplementation::Scalar,
+		PixelPackingImplementation::SSE41,
+		PixelPackingImplementation::AVX2,
+	};
+
+	// Even widths around the SIMD block sizes (6, 8, 12, 16, 24, 32 and 64 pixels), and frame widths
+	const uint32_t kTestWidths[] = { 2, 4, 6, 8, 10, 12, 14, 16, 18, 22, 24, 26, 30, 32, 34, 46, 48, 50, 62, 64, 66, 94, 96, 98, 126, 128, 130, 720, 1280, 1920, 2048, 3840, 4096 };
+
+	// Guard bytes after each packed row, to catch writes past the row
+	const uint32_t	kGuardSize = 64;
+	const uint8_t	kGuardByte = 0xA5;
+
+	// Padding after the packed rows, so that the guard bytes and any whole-block reads stay in the buffer
+	const uint32_t	kRowPadding = 64;
+
+	class PlaneBuffers
+	{
+	public:
+		PlaneBuffers(BMDPixelFormat pixelFormat, uint32_t width, uint32_t height) :
+			m_yuv(IsPixelFormatYUV(pixelFormat)),
+			m_width(width)
+		{
+			for (int i = 0; i < kPixelPlaneCount; i++)
+			{
+				bool used = m_yuv ? (i != kPixelPlaneA) : true;
+				m_planes[i].resize(used ? (size_t)GetPlaneWidth(i) * height : 0);
+			}
+		}
+
+		uint32_t GetPlaneWidth(int plane) const
+		{
+			return (m_yuv && (plane == kPixelPlaneCb || plane == kPixelPlaneCr)) ? m_width / 2 : m_width;
+		}
+
+		void GetRow(uint32_t y, uint16_t* rowPlanes[kPixelPlaneCount])
+		{
+			for (int i = 0; i < kPixelPlaneCount; i++)
+				rowPlanes[i] = m_planes[i].empty() ? nullptr : &m_planes[i][(size_t)GetPlaneWidth(i) * y];
+		}
+
+		void Fill(std::mt19937& random)
+		{
+			for (auto& plane : m_planes)
+			{
+				for (auto& sample : plane)
+					sample = (uint16_t)random();
+			}
+		}
+
+		// Returns the first differing sample as plane and index, or false if the planes match
+		bool Compare(const PlaneBuffers& other, int& plane, uint32_t& index) const
+		{
+			for (plane = 0; plane < kPixelPlaneCount; plane++)
+			{
+				for (index = 0; index < m_planes[plane].size(); index++)
+				{
+					if (m_planes[plane][index] != other.m_planes[plane][index])
+						return true;
+				}
+			}
+			return false;
+		}
+
+	private:
+		bool					m_yuv;
+		uint32_t				m_width;
+		std::vector<uint16_t>	m_planes[kPixelPlaneCount];
+	};
+
+	double GetMonotonicSeconds(void)
+	{
+		struct timespec now;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return now.tv_sec + now.tv_nsec / 1e9;
+	}
+
+	bool IsImplementationSupported(PixelPackingImplementation implementation)
+	{
+		PixelPackingImplementation previous = GetPixelPackingImplementation();
+		bool supported = (SetPixelPackingImplementation(implementation) == implementation);
+
+		SetPixelPackingImplementation(previous);
+		return supported;
+	}
+
+	bool TestPixelFormat(const PixelFormatName& format, PixelPackingImplementation implementation, uint32_t width, std::mt19937& random)
+	{
+		PixelPackingKernels		reference;
+		uint32_t				rowBytes = GetPixelFormatRowBytes(format.pixelFormat, width);
+		std::vector<uint8_t>	referenceRow(rowBytes + kRowPadding, kGuardByte);
+		std::vector<uint8_t>	row(rowBytes + kRowPadding, kGuardByte);
+		PlaneBuffers			sourcePlanes(format.pixelFormat, width, 1);
+		PlaneBuffers			referencePlanes(format.pixelFormat, width, 1);
+		PlaneBuffers			planes(format.pixelFormat, width, 1);
+		uint16_t*				rowPlanes[kPixelPlaneCount];
+		int						plane;
+		uint32_t				index;
+
+		GetScalarPixelPackingKernels(format.pixelFormat, reference);
+
+		// Pack random samples, any bits below the format's depth are truncated by both.  Both rows
+		// start filled with guard bytes, as padding at the end of a row is not written
+		sourcePlanes.Fill(random);
+		sourcePlanes.GetRow(0, rowPlanes);
+		reference.pack(rowPlanes, referenceRow.data(), width);
+		PackPixelRow(format.pixelFormat, rowPlanes, row.data(), width);
+
+		for (index = 0; index < rowBytes; index++)
+		{
+			if (row[index] != referenceRow[index])
+			{
+				fprintf(stderr, "%s %s width %u: pack differs from the scalar reference at byte %u (%02x, expected %02x)\n",
+					format.name, GetPixelPackingImplementationName(implementation), width, index, row[index], referenceRow[index]);
+				return false;
+			}
+		}
+
+		for (index = rowBytes; index < rowBytes + kGuardSize && index < row.size(); index++)
+		{
+			if (row[index] != kGuardByte || referenceRow[index] != kGuardByte)
+			{
+				fprintf(stderr, "%s %s width %u: pack wrote past the end of the row at byte %u\n",
+					format.name, GetPixelPackingImplementationName(implementation), width, index);
+				return false;
+			}
+		}
+
+		// Unpack the reference row
+		referencePlanes.GetRow(0, rowPlanes);
+		reference.unpack(referenceRow.data(), rowPlanes, width);
+		planes.GetRow(0, rowPlanes);
+		UnpackPixelRow(format.pixelFormat, referenceRow.data(), rowPlanes, width);
+
+		if (planes.Compare(referencePlanes, plane, index))
+		{
+			fprintf(stderr, "%s %s width %u: unpack differs from the scalar reference in plane %d at sample %u\n",
+				format.name, GetPixelPackingImplementationName(implementation), width, plane, index);
+			return false;
+		}
+
+		return true;
+	}
+
+	double MeasureThroughput(BMDPixelFormat pixelFormat, bool pack, uint32_t width, uint32_t height, double seconds, PlaneBuffers& planes, std::vector<uint8_t>& frame)
+	{
+		uint32_t	rowBytes = GetPixelFormatRowBytes(pixelFormat, width);
+		uint16_t*	rowPlanes[kPixelPlaneCount];
+		uint64_t	pixels = 0;
+		double		startTime = GetMonotonicSeconds();
+		double		elapsed;
+
+		do
+		{
+			for (uint32_t y = 0; y < height; y++)
+			{
+				planes.GetRow(y, rowPlanes);
+
+				if (pack)
+					PackPixelRow(pixelFormat, rowPlanes, &frame[(size_t)rowBytes * y], width);
+				else
+					UnpackPixelRow(pixelFormat, &frame[(size_t)rowBytes * y], rowPlanes, width);
+			}
+
+			pixels += (uint64_t)width * height;
+			elapsed = GetMonotonicSeconds() - startTime;
+		}
+		while (elapsed < seconds);
+
+		return pixels / elapsed / 1e9;
+	}
+}
+
+bool RunPixelPackingSelfTest(void)
+{
+	PixelPackingImplementation	selected = GetPixelPackingImplementation();
+	std::mt19937				random(1);
+	uint32_t					testCount = 0;
+	uint32_t					failureCount = 0;
+
+	for (PixelPackingImplementation implementation : kImplementations)
+	{
+		if (!IsImplementationSupported(implementation))
+		{
+			printf("%-8s not supported by this CPU, skipped\n", GetPixelPackingImplementationName(implementation));
+			continue;
+		}
+
+		SetPixelPackingImplementation(implementation);
+
+		for (const PixelFormatName& format : kPixelFormats)
+		{
+			for (uint32_t width : kTestWidths)
+			{
+				testCount++;
+
+				// Only the first failure of each format is reported
+				if (!TestPixelFormat(format, implementation, width, random))
+				{
+					failureCount++;
+					break;
+				}
+			}
+		}
+	}
+
+	SetPixelPackingImplementation(selected);
+
+	printf("Pixel packing self-test: %u rows tested against the scalar reference, %u failed\n", testCount, failureCount);
+	return failureCount == 0;
+}
+
+void RunPixelPackingBenchmark(uint32_t width, uint32_t height, double seconds)
+{
+	PixelPackingImplementation	selected = GetPixelPackingImplementation();
+	std::mt19937				random(1);
+
+	printf("Pixel packing throughput, %ux%u frames, Gpixels/s (selected implementation is %s)\n\n", width, height, GetPixelPackingImplementationName(selected));
+	printf("%-8s", "Format");
+	for (PixelPackingImplementation implementation : kImplementations)
+	{
+		if (IsImplementationSupported(implementation))
+			printf("  %6s pack  %6s unpack", GetPixelPackingImplementationName(implementation), GetPixelPackingImplementationName(implementation));
+	}
+	printf("\n");
+
+	for (const PixelFormatName& format : kPixelFormats)
+	{
+		PlaneBuffers			planes(format.pixelFormat, width, height);
+		std::vector<uint8_t>	frame((size_t)GetPixelFormatRowBytes(format.pixelFormat, width) * height + kRowPadding);
+
+		planes.Fill(random);
+		printf("%-8s", format.name);
+
+		for (PixelPackingImplementation implementation : kImplementations)
+		{
+			if (!IsImplementationSupported(implementation))
+				continue;
+
+			SetPixelPackingImplementation(implementation);
+
+			double packRate		= MeasureThroughput(format.pixelFormat, true, width, height, seconds, planes, frame);
+			double unpackRate	= MeasureThroughput(format.pixelFormat, false, width, height, seconds, planes, frame);
+
+			printf("  %11.2f  %13.2f", packRate, unpackRate);
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+
+	SetPixelPackingImplementation(selected);
+}
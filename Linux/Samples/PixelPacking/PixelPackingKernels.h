@@ -0,0 +1,77 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include "PixelPacking.h"
+
+// Internal interface between PixelPacking.cpp and the SIMD kernels
+
+typedef void (*PackRowFunction)(const uint16_t* const planes[kPixelPlaneCount], void* row, uint32_t width);
+typedef void (*UnpackRowFunction)(const void* row, uint16_t* const planes[kPixelPlaneCount], uint32_t width);
+
+struct PixelPackingKernels
+{
+	PackRowFunction		pack;
+	UnpackRowFunction	unpack;
+};
+
+// Scalar reference kernels, also used by the SIMD kernels for the end of a row
+bool	GetScalarPixelPackingKernels(BMDPixelFormat pixelFormat, PixelPackingKernels& kernels);
+
+// SIMD kernels, return false if there is no kernel for the pixel format or the CPU architecture
+bool	GetSSE41PixelPackingKernels(BMDPixelFormat pixelFormat, PixelPackingKernels& kernels);
+bool	GetAVX2PixelPackingKernels(BMDPixelFormat pixelFormat, PixelPackingKernels& kernels);
+bool	IsSSE41Supported(void);
+bool	IsAVX2Supported(void);
+
+// Offset planes to the sample of pixel x, for converting the remainder of a row
+template<typename T>
+inline void OffsetPixelPlanes(BMDPixelFormat pixelFormat, T* const planes[kPixelPlaneCount], uint32_t x, T* offsetPlanes[kPixelPlaneCount])
+{
+	bool yuv = IsPixelFormatYUV(pixelFormat);
+
+	for (int i = 0; i < kPixelPlaneCount; i++)
+	{
+		uint32_t planeOffset = (yuv && (i == kPixelPlaneCb || i == kPixelPlaneCr)) ? x / 2 : x;
+		offsetPlanes[i] = planes[i] ? planes[i] + planeOffset : nullptr;
+	}
+}
@@ -0,0 +1,636 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include "PixelPackingKernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+// SSE4.1 and AVX2 kernels.  Each file-level function is compiled for its instruction set with a
+// target attribute, so the sample builds without architecture flags and the kernels are only
+// selected when the CPU supports them.  Each kernel converts the groups of pixels that fit within
+// the row and finishes the row with the scalar reference kernel.
+
+#define SSE41_KERNEL	__attribute__((target("sse4.1")))
+#define AVX2_KERNEL		__attribute__((target("avx2")))
+
+// Byte offset of pixel x, which must be at the start of a packing group
+static inline uint32_t GetPackedPixelOffset(BMDPixelFormat pixelFormat, uint32_t x)
+{
+	switch (pixelFormat)
+	{
+		case bmdFormat8BitYUV:		return x * 2;
+		case bmdFormat10BitYUV:		return (x / 6) * 16;
+		default:					return x * 4;
+	}
+}
+
+template<BMDPixelFormat PixelFormat>
+static inline void PackRowRemainder(const uint16_t* const planes[kPixelPlaneCount], void* row, uint32_t x, uint32_t width)
+{
+	PixelPackingKernels	scalar;
+	const uint16_t*		offsetPlanes[kPixelPlaneCount];
+
+	if (x >= width || !GetScalarPixelPackingKernels(PixelFormat, scalar))
+		return;
+
+	OffsetPixelPlanes(PixelFormat, planes, x, offsetPlanes);
+	scalar.pack(offsetPlanes, (uint8_t*)row + GetPackedPixelOffset(PixelFormat, x), width - x);
+}
+
+template<BMDPixelFormat PixelFormat>
+static inline void UnpackRowRemainder(const void* row, uint16_t* const planes[kPixelPlaneCount], uint32_t x, uint32_t width)
+{
+	PixelPackingKernels	scalar;
+	uint16_t*			offsetPlanes[kPixelPlaneCount];
+
+	if (x >= width || !GetScalarPixelPackingKernels(PixelFormat, scalar))
+		return;
+
+	OffsetPixelPlanes(PixelFormat, planes, x, offsetPlanes);
+	scalar.unpack((const uint8_t*)row + GetPackedPixelOffset(PixelFormat, x), offsetPlanes, width - x);
+}
+
+template<bool BigEndian, int Shift>
+struct RGB10Format;
+template<> struct RGB10Format<true, 0>	{ static const BMDPixelFormat value = bmdFormat10BitRGB; };
+template<> struct RGB10Format<true, 2>	{ static const BMDPixelFormat value = bmdFormat10BitRGBX; };
+template<> struct RGB10Format<false, 2>	{ static const BMDPixelFormat value = bmdFormat10BitRGBXLE; };
+
+template<int A, int R, int G, int B>
+struct RGBA8Format;
+template<> struct RGBA8Format<3, 2, 1, 0>	{ static const BMDPixelFormat value = bmdFormat8BitBGRA; };
+template<> struct RGBA8Format<0, 1, 2, 3>	{ static const BMDPixelFormat value = bmdFormat8BitARGB; };
+
+#define BYTE_SWAP_32_MASK	3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+#define Z					-128		// pshufb index that zeroes the destination byte
+
+//
+// SSE4.1
+//
+
+// 10-bit RGB, 8 pixels per iteration
+template<bool BigEndian, int Shift>
+SSE41_KERNEL static void PackRGB10RowSSE41(const uint16_t* const planes[kPixelPlaneCount], void* row, uint32_t width)
+{
+	const __m128i	byteSwap = _mm_setr_epi8(BYTE_SWAP_32_MASK);
+	uint8_t*		bytes = (uint8_t*)row;
+	uint32_t		x = 0;
+
+	for (; x + 8 <= width; x += 8, bytes += 32)
+	{
+		__m128i r = _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(planes[kPixelPlaneR] + x)), 6);
+		__m128i g = _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(planes[kPixelPlaneG] + x)), 6);
+		__m128i b = _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(planes[kPixelPlaneB] + x)), 6);
+
+		for (int half = 0; half < 2; half++)
+		{
+			__m128i word = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(_mm_cvtepu16_epi32(r), 20), _mm_slli_epi32(_mm_cvtepu16_epi32(g), 10)), _mm_cvtepu16_epi32(b));
+
+			if (Shift)
+				word = _mm_slli_epi32(word, Shift);
+			if (BigEndian)
+				word = _mm_shuffle_epi8(word, byteSwap);
+
+			_mm_storeu_si128((__m128i*)(bytes + half * 16), word);
+
+			r = _mm_srli_si128(r, 8);
+			g = _mm_srli_si128(g, 8);
+			b = _mm_srli_si128(b, 8);
+		}
+	}
+
+	PackRowRemainder<RGB10Format<BigEndian, Shift>::value>(planes, row, x, width);
+}
+
+template<bool BigEndian, int Shift>
+SSE41_KERNEL static void UnpackRGB10RowSSE41(const void* row, uint16_t* const planes[kPixelPlaneCount], uint32_t width)
+{
+	const __m128i	byteSwap = _mm_setr_epi8(BYTE_SWAP_32_MASK);
+	const __m128i	mask = _mm_set1_epi32(0x3FF);
+	const uint8_t*	bytes = (const uint8_t*)row;
+	uint32_t		x = 0;
+
+	for (; x + 8 <= width; x += 8, bytes += 32)
+	{
+		__m128i word0 = _mm_loadu_si128((const __m128i*)bytes);
+		__m128i word1 = _mm_loadu_si128((const __m128i*)(bytes + 16));
+
+		if (BigEndian)
+		{
+			word0 = _mm_shuffle_epi8(word0, byteSwap);
+			word1 = _mm_shuffle_epi8(word1, byteSwap);
+		}
+		if (Shift)
+		{
+			word0 = _mm_srli_epi32(word0, Shift);
+			word1 = _mm_srli_epi32(word1, Shift);
+		}
+
+		__m128i r = _mm_packus_epi32(_mm_and_si128(_mm_srli_epi32(word0, 20), mask), _mm_and_si128(_mm_srli_epi32(word1, 20), mask));
+		__m128i g = _mm_packus_epi32(_mm_and_si128(_mm_srli_epi32(word0, 10), mask), _mm_and_si128(_mm_srli_epi32(word1, 10), mask));
+		__m128i b = _mm_packus_epi32(_mm_and_si128(word0, mask), _mm_and_si128(word1, mask));
+
+		_mm_storeu_si128((__m128i*)(planes[kPixelPlaneR] + x), _mm_slli_epi16(r, 6));
+		_mm_storeu_si128((__m128i*)(planes[kPixelPlaneG] + x), _mm_slli_epi16(g, 6));
+		_mm_storeu_si128((__m128i*)(planes[kPixelPlaneB] + x), _mm_slli_epi16(b, 6));
+	}
+
+	UnpackRowRemainder<RGB10Format<BigEndian, Shift>::value>(row, planes, x, width);
+}
+
+// 8-bit RGB with alpha, 16 pixels per iteration
+SSE41_KERNEL static inline __m128i LoadPlane8(const uint16_t* plane)
+{
+	return _mm_packus_epi16(_mm_srli_epi16(_mm_loadu_si128((const __m128i*)plane), 8), _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(plane + 8)), 8));
+}
+
+SSE41_KERNEL static inline void StorePlane8(uint16_t* plane, __m128i bytes)
+{
+	// Interleaving with zero bytes places each sample in the upper byte of its 16-bit word
+	_mm_storeu_si128((__m128i*)plane, _mm_unpacklo_epi8(_mm_setzero_si128(), bytes));
+	_mm_storeu_si128((__m128i*)(plane + 8), _mm_unpackhi_epi8(_mm_setzero_si128(), bytes));
+}
+
+template<int A, int R, int G, int B>
+SSE41_KERNEL static void PackRGBA8RowSSE41(const uint16_t* const planes[kPixelPlaneCount], void* row, uint32_t width)
+{
+	uint8_t*	bytes = (uint8_t*)row;
+	uint32_t	x = 0;
+
+	for (; x + 16 <= width; x += 16, bytes += 64)
+	{
+		__m128i component[4];
+
+		component[A] = planes[kPixelPlaneA] ? LoadPlane8(planes[kPixelPlaneA] + x) : _mm_set1_epi8((char)0xFF);
+		component[R] = LoadPlane8(planes[kPixelPlaneR] + x);
+		component[G] = LoadPlane8(planes[kPixelPlaneG] + x);
+		component[B] = LoadPlane8(planes[kPixelPlaneB] + x);
+
+		__m128i lo01 = _mm_unpacklo_epi8(component[0], component[1]);
+		__m128i hi01 = _mm_unpackhi_epi8(component[0], component[1]);
+		__m128i lo23 = _mm_unpacklo_epi8(component[2], component[3]);
+		__m128i hi23 = _mm_unpackhi_epi8(component[2], component[3]);
+
+		_mm_storeu_si128((__m128i*)bytes, _mm_unpacklo_epi16(lo01, lo23));
+		_mm_storeu_si128((__m128i*)(bytes + 16), _mm_unpackhi_epi16(lo01, lo23));
+		_mm_storeu_si128((__m128i*)(bytes + 32), _mm_unpacklo_epi16(hi01, hi23));
+		_mm_storeu_si128((__m128i*)(bytes + 48), _mm_unpackhi_epi16(hi01, hi23));
+	}
+
+	PackRowRemainder<RGBA8Format<A, R, G, B>::value>(planes, row, x, width);
+}
+
+template<int A, int R, int G, int B>
+SSE41_KERNEL static void UnpackRGBA8RowSSE41(const void* row, uint16_t* const planes[kPixelPlaneCount], uint32_t width)
+{
+	// Gather each component of 4 pixels into a 32-bit element
+	const __m128i	transpose = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+	const uint8_t*	bytes = (const uint8_t*)row;
+	uint32_t		x = 0;
+
+	for (; x + 16 <= width; x += 16, bytes += 64)
+	{
+		__m128i v0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)bytes), transpose);
+		__m128i v1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(bytes + 16)), transpose);
+		__m128i v2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(bytes + 32)), transpose);
+		__m128i v3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(bytes + 48)), transpose);
+
+		__m128i t0 = _mm_unpacklo_epi32(v0, v1);
+		__m128i t1 = _mm_unpackhi_epi32(v0, v1);
+		__m128i t2 = _mm_unpacklo_epi32(v2, v3);
+		__m128i t3 = _mm_unpackhi_epi32(v2, v3);
+
+		__m128i component[4];
+		component[0] = _mm_unpacklo_epi64(t0, t2);
+		component[1] = _mm_unpackhi_epi64(t0, t2);
+		component[2] = _mm_unpacklo_epi64(t1, t3);
+		component[3] = _mm_unpackhi_epi64(t1, t3);
+
+		if (planes[kPixelPlaneA])
+			StorePlane8(planes[kPixelPlaneA] + x, component[A]);
+		StorePlane8(planes[kPixelPlaneR] + x, component[R]);
+		StorePlane8(planes[kPixelPlaneG] + x, component[G]);
+		StorePlane8(planes[kPixelPlaneB] + x, component[B]);
+	}
+
+	UnpackRowRemainder<RGBA8Format<A, R, G, B>::value>(row, planes, x, width);
+}
+
+// 2vuy, 16 pixels per iteration
+SSE41_KERNEL static void Pack2vuyRowSSE41(const uint16_t* const planes[kPixelPlaneCount], void* row, uint32_t width)
+{
+	uint8_t*	bytes = (uint8_t*)row;
+	uint32_t	x = 0;
+
+	for (; x + 16 <= width; x += 16, bytes += 32)
+	{
+		__m128i y = LoadPlane8(planes[kPixelPlaneY] + x);
+		__m128i cb = _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(planes[kPixelPlaneCb] + x / 2)), 8);
+		__m128i cr = _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(planes[kPixelPlaneCr] + x / 2)), 8);
+
+		// Cb and Cr bytes are in the lower and upper 8 bytes, interleave to Cb0 Cr0 Cb1 Cr1 ...
+		__m128i chroma = _mm_packus_epi16(cb, cr);
+		__m128i cbcr = _mm_unpacklo_epi8(chroma, _mm_srli_si128(chroma, 8));
+
+		_mm_storeu_si128((__m128i*)bytes, _mm_unpacklo_epi8(cbcr, y));
+		_mm_storeu_si128((__m128i*)(bytes + 16), _mm_unpackhi_epi8(cbcr, y));
+	}
+
+	PackRowRemainder<bmdFormat8BitYUV>(planes, row, x, width);
+}
+
+SSE41_KERNEL static void Unpack2vuyRowSSE41(const void* row, uint16_t* const planes[kPixelPlaneCount], uint32_t width)
+{
+	// Y bytes to the lower 8 bytes, followed by 4 Cb bytes and 4 Cr bytes
+	const __m128i	deinterleave = _mm_setr_epi8(1, 3, 5, 7, 9, 11, 13, 15, 0, 4, 8, 12, 2, 6, 10, 14);
+	const uint8_t*	bytes = (const uint8_t*)row;
+	uint32_t		x = 0;
+
+	for (; x + 16 <= width; x += 16, bytes += 32)
+	{
+		__m128i v0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)bytes), deinterleave);
+		__m128i v1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(bytes + 16)), deinterleave);
+
+		__m128i y = _mm_unpacklo_epi64(v0, v1);
+		__m128i chroma = _mm_shuffle_epi32(_mm_unpackhi_epi64(v0, v1), _MM_SHUFFLE(3, 1, 2, 0));
+
+		StorePlane8(planes[kPixelPlaneY] + x, y);
+		_mm_storeu_si128((__m128i*)(planes[kPixelPlaneCb] + x / 2), _mm_unpacklo_epi8(_mm_setzero_si128(), chroma));
+		_mm_storeu_si128((__m128i*)(planes[kPixelPlaneCr] + x / 2), _mm_unpackhi_epi8(_mm_setzero_si128(), chroma));
+	}
+
+	UnpackRowRemainder<bmdFormat8BitYUV>(row, planes, x, width);
+}
+
+// v210, one group of 6 pixels per iteration.  The words of a group are built from three vectors
+// holding the samples for bits 0-9, 10-19 and 20-29 of each word:
+//   bits 0-9    Cb0 Y1  Cr1 Y4
+//   bits 10-19  Y0  Cb1 Y3  Cr2
+//   bits 20-29  Cr0 Y2  Cb2 Y5
+// each gathered with one shuffle of the luma samples and one of the chroma samples Cb0-3 Cr0-3.
+
+#define V210_LUMA_LOW		Z, Z, Z, Z, 2, 3, Z, Z, Z, Z, Z, Z, 8, 9, Z, Z
+#define V210_CHROMA_LOW		0, 1, Z, Z, Z, Z, Z, Z, 10, 11, Z, Z, Z, Z, Z, Z
+#define V210_LUMA_MID		0, 1, Z, Z, Z, Z, Z, Z, 6, 7, Z, Z, Z, Z, Z, Z
+#define V210_CHROMA_MID		Z, Z, Z, Z, 2, 3, Z, Z, Z, Z, Z, Z, 12, 13, Z, Z
+#define V210_LUMA_HIGH		Z, Z, Z, Z, 4, 5, Z, Z, Z, Z, Z, Z, 10, 11, Z, Z
+#define V210_CHROMA_HIGH	8, 9, Z, Z, Z, Z, Z, Z, 4, 5, Z, Z, Z, Z, Z, Z
+
+// Unpacking gathers the 10-bit fields a (bits 0-9), b (bits 10-19) and c (bits 20-29) of the
+// 4 words into 16-bit luma Y0-5 and chroma Cb0-2, Cr0-2 in elements 0-2 and 4-6
+#define V210_LUMA_FROM_A	Z, Z, 4, 5, Z, Z, Z, Z, 12, 13, Z, Z, Z, Z, Z, Z
+#define V210_LUMA_FROM_B	0, 1, Z, Z, Z, Z, 8, 9, Z, Z, Z, Z, Z, Z, Z, Z
+#define V210_LUMA_FROM_C	Z, Z, Z, Z, 4, 5, Z, Z, Z, Z, 12, 13, Z, Z, Z, Z
+#define V210_CHROMA_FROM_A	0, 1, Z, Z, Z, Z, Z, Z, Z, Z, 8, 9, Z, Z, Z, Z
+#define V210_CHROMA_FROM_B	Z, Z, 4, 5, Z, Z, Z, Z, Z, Z, Z, Z, 12, 13, Z, Z
+#define V210_CHROMA_FROM_C	Z, Z, Z, Z, 8, 9, Z, Z, 0, 1, Z, Z, Z, Z, Z, Z
+
+SSE41_KERNEL static void PackV210RowSSE41(const uint16_t* const planes[kPixelPlaneCount], void* row, uint32_t width)
+{
+	const __m128i	lumaLow = _mm_setr_epi8(V210_LUMA_LOW);
+	const __m128i	chromaLow = _mm_setr_epi8(V210_CHROMA_LOW);
+	const __m128i	lumaMid = _mm_setr_epi8(V210_LUMA_MID);
+	const __m128i	chromaMid = _mm_setr_epi8(V210_CHROMA_MID);
+	const __m128i	lumaHigh = _mm_setr_epi8(V210_LUMA_HIGH);
+	const __m128i	chromaHigh = _mm_setr_epi8(V210_CHROMA_HIGH);
+	uint8_t*		bytes = (uint8_t*)row;
+	uint32_t		x = 0;
+
+	// Each group loads 8 luma and 4 of each chroma samples
+	for (; x + 8 <= width; x += 6, bytes += 16)
+	{
+		__m128i y = _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(planes[kPixelPlaneY] + x)), 6);
+		__m128i c = _mm_srli_epi16(_mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)(planes[kPixelPlaneCb] + x / 2)),
+													   _mm_loadl_epi64((const __m128i*)(planes[kPixelPlaneCr] + x / 2))), 6);
+
+		__m128i low = _mm_or_si128(_mm_shuffle_epi8(y, lumaLow), _mm_shuffle_epi8(c, chromaLow));
+		__m128i mid = _mm_or_si128(_mm_shuffle_epi8(y, lumaMid), _mm_shuffle_epi8(c, chromaMid));
+		__m128i high = _mm_or_si128(_mm_shuffle_epi8(y, lumaHigh), _mm_shuffle_epi8(c, chromaHigh));
+
+		_mm_storeu_si128((__m128i*)bytes, _mm_or_si128(_mm_or_si128(low, _mm_slli_epi32(mid, 10)), _mm_slli_epi32(high, 20)));
+	}
+
+	PackRowRemainder<bmdFormat10BitYUV>(planes, row, x, width);
+}
+
+SSE41_KERNEL static void UnpackV210RowSSE41(const void* row, uint16_t* const planes[kPixelPlaneCount], uint32_t width)
+{
+	const __m128i	mask = _mm_set1_epi32(0x3FF);
+	const __m128i	lumaFromA = _mm_setr_epi8(V210_LUMA_FROM_A);
+	const __m128i	lumaFromB = _mm_setr_epi8(V210_LUMA_FROM_B);
+	const __m128i	lumaFromC = _mm_setr_epi8(V210_LUMA_FROM_C);
+	const __m128i	chromaFromA = _mm_setr_epi8(V210_CHROMA_FROM_A);
+	const __m128i	chromaFromB = _mm_setr_epi8(V210_CHROMA_FROM_B);
+	const __m128i	chromaFromC = _mm_setr_epi8(V210_CHROMA_FROM_C);
+	const uint8_t*	bytes = (const uint8_t*)row;
+	uint32_t		x = 0;
+
+	// Each group stores 8 luma and 4 of each chroma samples, the extra samples are overwritten
+	// by the next group or the remainder of the row
+	for (; x + 8 <= width; x += 6, bytes += 16)
+	{
+		__m128i words = _mm_loadu_si128((const __m128i*)bytes);
+		__m128i a = _mm_and_si128(words, mask);
+		__m128i b = _mm_and_si128(_mm_srli_epi32(words, 10), mask);
+		__m128i c = _mm_and_si128(_mm_srli_epi32(words, 20), mask);
+
+		__m128i y = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, lumaFromA), _mm_shuffle_epi8(b, lumaFromB)), _mm_shuffle_epi8(c, lumaFromC));
+		__m128i chroma = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, chromaFromA), _mm_shuffle_epi8(b, chromaFromB)), _mm_shuffle_epi8(c, chromaFromC));
+		y = _mm_slli_epi16(y, 6);
+		chroma = _mm_slli_epi16(chroma, 6);
+
+		_mm_storeu_si128((__m128i*)(planes[kPixelPlaneY] + x), y);
+		_mm_storel_epi64((__m128i*)(planes[kPixelPlaneCb] + x / 2), chroma);
+		_mm_storel_epi64((__m128i*)(planes[kPixelPlaneCr] + x / 2), _mm_srli_si128(chroma, 8));
+	}
+
+	UnpackRowRemainder<bmdFormat10BitYUV>(row, planes, x, width);
+}
+
+//
+// AVX2
+//
+
+// 10-bit RGB, 16 pixels per iteration
+template<bool BigEndian, int Shift>
+AVX2_KERNEL static void PackRGB10RowAVX2(const uint16_t* const planes[kPixelPlaneCount], void* row, uint32_t width)
+{
+	const __m256i	byteSwap = _mm256_setr_epi8(BYTE_SWAP_32_MASK, BYTE_SWAP_32_MASK);
+	uint8_t*		bytes = (uint8_t*)row;
+	uint32_t		x = 0;
+
+	for (; x + 16 <= width; x += 16, bytes += 64)
+	{
+		__m256i r = _mm256_srli_epi16(_mm256_loadu_si256((const __m256i*)(planes[kPixelPlaneR] + x)), 6);
+		__m256i g = _mm256_srli_epi16(_mm256_loadu_si256((const __m256i*)(planes[kPixelPlaneG] + x)), 6);
+		__m256i b = _mm256_srli_epi16(_mm256_loadu_si256((const __m256i*)(planes[kPixelPlaneB] + x)), 6);
+
+		for (int half = 0; half < 2; half++)
+		{
+			__m256i r32 = _mm256_cvtepu16_epi32(half ? _mm256_extracti128_si256(r, 1) : _mm256_castsi256_si128(r));
+			__m256i g32 = _mm256_cvtepu16_epi32(half ? _mm256_extracti128_si256(g, 1) : _mm256_castsi256_si128(g));
+			__m256i b32 = _mm256_cvtepu16_epi32(half ? _mm256_extracti128_si256(b, 1) : _mm256_castsi256_si128(b));
+			__m256i word = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(r32, 20), _mm256_slli_epi32(g32, 10)), b32);
+
+			if (Shift)
+				word = _mm256_slli_epi32(word, Shift);
+			if (BigEndian)
+				word = _mm256_shuffle_epi8(word, byteSwap);
+
+			_mm256_storeu_si256((__m256i*)(bytes + half * 32), word);
+		}
+	}
+
+	PackRowRemainder<RGB10Format<BigEndian, Shift>::value>(planes, row, x, width);
+}
+
+template<bool BigEndian, int Shift>
+AVX2_KERNEL static void UnpackRGB10RowAVX2(const void* row, uint16_t* const planes[kPixelPlaneCount], uint32_t width)
+{
+	const __m256i	byteSwap = _mm256_setr_epi8(BYTE_SWAP_32_MASK, BYTE_SWAP_32_MASK);
+	const __m256i	mask = _mm256_set1_epi32(0x3FF);
+	const uint8_t*	bytes = (const uint8_t*)row;
+	uint32_t		x = 0;
+
+	for (; x + 16 <= width; x += 16, bytes += 64)
+	{
+		__m256i word0 = _mm256_loadu_si256((const __m256i*)bytes);
+		__m256i word1 = _mm256_loadu_si256((const __m256i*)(bytes + 32));
+
+		if (BigEndian)
+		{
+			word0 = _mm256_shuffle_epi8(word0, byteSwap);
+			word1 = _mm256_shuffle_epi8(word1, byteSwap);
+		}
+		if (Shift)
+		{
+			word0 = _mm256_srli_epi32(word0, Shift);
+			word1 = _mm256_srli_epi32(word1, Shift);
+		}
+
+		// Packing is within 128-bit lanes, reorder the 64-bit quarters back to pixel order
+		__m256i r = _mm256_packus_epi32(_mm256_and_si256(_mm256_srli_epi32(word0, 20), mask), _mm256_and_si256(_mm256_srli_epi32(word1, 20), mask));
+		__m256i g = _mm256_packus_epi32(_mm256_and_si256(_mm256_srli_epi32(word0, 10), mask), _mm256_and_si256(_mm256_srli_epi32(word1, 10), mask));
+		__m256i b = _mm256_packus_epi32(_mm256_and_si256(word0, mask), _mm256_and_si256(word1, mask));
+
+		_mm256_storeu_si256((__m256i*)(planes[kPixelPlaneR] + x), _mm256_slli_epi16(_mm256_permute4x64_epi64(r, _MM_SHUFFLE(3, 1, 2, 0)), 6));
+		_mm256_storeu_si256((__m256i*)(planes[kPixelPlaneG] + x), _mm256_slli_epi16(_mm256_permute4x64_epi64(g, _MM_SHUFFLE(3, 1, 2, 0)), 6));
+		_mm256_storeu_si256((__m256i*)(planes[kPixelPlaneB] + x), _mm256_slli_epi16(_mm256_permute4x64_epi64(b, _MM_SHUFFLE(3, 1, 2, 0)), 6));
+	}
+
+	UnpackRowRemainder<RGB10Format<BigEndian, Shift>::value>(row, planes, x, width);
+}
+
+// v210, two groups of 6 pixels per iteration, one in each 128-bit lane
+AVX2_KERNEL static void PackV210RowAVX2(const uint16_t* const planes[kPixelPlaneCount], void* row, uint32_t width)
+{
+	const __m256i	lumaLow = _mm256_setr_epi8(V210_LUMA_LOW, V210_LUMA_LOW);
+	const __m256i	chromaLow = _mm256_setr_epi8(V210_CHROMA_LOW, V210_CHROMA_LOW);
+	const __m256i	lumaMid = _mm256_setr_epi8(V210_LUMA_MID, V210_LUMA_MID);
+	const __m256i	chromaMid = _mm256_setr_epi8(V210_CHROMA_MID, V210_CHROMA_MID);
+	const __m256i	lumaHigh = _mm256_setr_epi8(V210_LUMA_HIGH, V210_LUMA_HIGH);
+	const __m256i	chromaHigh = _mm256_setr_epi8(V210_CHROMA_HIGH, V210_CHROMA_HIGH);
+	uint8_t*		bytes = (uint8_t*)row;
+	uint32_t		x = 0;
+
+	for (; x + 14 <= width; x += 12, bytes += 32)
+	{
+		const uint16_t* luma = planes[kPixelPlaneY] + x;
+		const uint16_t* cb = planes[kPixelPlaneCb] + x / 2;
+		const uint16_t* cr = planes[kPixelPlaneCr] + x / 2;
+
+		__m256i y = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)luma)), _mm_loadu_si128((const __m128i*)(luma + 6)), 1);
+		__m128i c0 = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)cb), _mm_loadl_epi64((const __m128i*)cr));
+		__m128i c1 = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)(cb + 3)), _mm_loadl_epi64((const __m128i*)(cr + 3)));
+		__m256i c = _mm256_inserti128_si256(_mm256_castsi128_si256(c0), c1, 1);
+
+		y = _mm256_srli_epi16(y, 6);
+		c = _mm256_srli_epi16(c, 6);
+
+		__m256i low = _mm256_or_si256(_mm256_shuffle_epi8(y, lumaLow), _mm256_shuffle_epi8(c, chromaLow));
+		__m256i mid = _mm256_or_si256(_mm256_shuffle_epi8(y, lumaMid), _mm256_shuffle_epi8(c, chromaMid));
+		__m256i high = _mm256_or_si256(_mm256_shuffle_epi8(y, lumaHigh), _mm256_shuffle_epi8(c, chromaHigh));
+
+		_mm256_storeu_si256((__m256i*)bytes, _mm256_or_si256(_mm256_or_si256(low, _mm256_slli_epi32(mid, 10)), _mm256_slli_epi32(high, 20)));
+	}
+
+	PackRowRemainder<bmdFormat10BitYUV>(planes, row, x, width);
+}
+
+AVX2_KERNEL static void UnpackV210RowAVX2(const void* row, uint16_t* const planes[kPixelPlaneCount], uint32_t width)
+{
+	const __m256i	mask = _mm256_set1_epi32(0x3FF);
+	const __m256i	lumaFromA = _mm256_setr_epi8(V210_LUMA_FROM_A, V210_LUMA_FROM_A);
+	const __m256i	lumaFromB = _mm256_setr_epi8(V210_LUMA_FROM_B, V210_LUMA_FROM_B);
+	const __m256i	lumaFromC = _mm256_setr_epi8(V210_LUMA_FROM_C, V210_LUMA_FROM_C);
+	const __m256i	chromaFromA = _mm256_setr_epi8(V210_CHROMA_FROM_A, V210_CHROMA_FROM_A);
+	const __m256i	chromaFromB = _mm256_setr_epi8(V210_CHROMA_FROM_B, V210_CHROMA_FROM_B);
+	const __m256i	chromaFromC = _mm256_setr_epi8(V210_CHROMA_FROM_C, V210_CHROMA_FROM_C);
+	const uint8_t*	bytes = (const uint8_t*)row;
+	uint32_t		x = 0;
+
+	for (; x + 14 <= width; x += 12, bytes += 32)
+	{
+		__m256i words = _mm256_loadu_si256((const __m256i*)bytes);
+		__m256i a = _mm256_and_si256(words, mask);
+		__m256i b = _mm256_and_si256(_mm256_srli_epi32(words, 10), mask);
+		__m256i c = _mm256_and_si256(_mm256_srli_epi32(words, 20), mask);
+
+		__m256i y = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a, lumaFromA), _mm256_shuffle_epi8(b, lumaFromB)), _mm256_shuffle_epi8(c, lumaFromC));
+		__m256i chroma = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a, chromaFromA), _mm256_shuffle_epi8(b, chromaFromB)), _mm256_shuffle_epi8(c, chromaFromC));
+		y = _mm256_slli_epi16(y, 6);
+		chroma = _mm256_slli_epi16(chroma, 6);
+
+		__m128i chroma0 = _mm256_castsi256_si128(chroma);
+		__m128i chroma1 = _mm256_extracti128_si256(chroma, 1);
+
+		// Store the first group before the second, which overwrites its extra samples
+		_mm_storeu_si128((__m128i*)(planes[kPixelPlaneY] + x), _mm256_castsi256_si128(y));
+		_mm_storeu_si128((__m128i*)(planes[kPixelPlaneY] + x + 6), _mm256_extracti128_si256(y, 1));
+		_mm_storel_epi64((__m128i*)(planes[kPixelPlaneCb] + x / 2), chroma0);
+		_mm_storel_epi64((__m128i*)(planes[kPixelPlaneCb] + x / 2 + 3), chroma1);
+		_mm_storel_epi64((__m128i*)(planes[kPixelPlaneCr] + x / 2), _mm_srli_si128(chroma0, 8));
+		_mm_storel_epi64((__m128i*)(planes[kPixelPlaneCr] + x / 2 + 3), _mm_srli_si128(chroma1, 8));
+	}
+
+	UnpackRowRemainder<bmdFormat10BitYUV>(row, planes, x, width);
+}
+
+#undef Z
+
+bool IsSSE41Supported()
+{
+	return __builtin_cpu_supports("sse4.1");
+}
+
+bool IsAVX2Supported()
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+bool GetSSE41PixelPackingKernels(BMDPixelFormat pixelFormat, PixelPackingKernels& kernels)
+{
+	switch (pixelFormat)
+	{
+		case bmdFormat8BitYUV:
+			kernels = { Pack2vuyRowSSE41, Unpack2vuyRowSSE41 };
+			return true;
+
+		case bmdFormat10BitYUV:
+			kernels = { PackV210RowSSE41, UnpackV210RowSSE41 };
+			return true;
+
+		case bmdFormat10BitRGB:
+			kernels = { PackRGB10RowSSE41<true, 0>, UnpackRGB10RowSSE41<true, 0> };
+			return true;
+
+		case bmdFormat10BitRGBX:
+			kernels = { PackRGB10RowSSE41<true, 2>, UnpackRGB10RowSSE41<true, 2> };
+			return true;
+
+		case bmdFormat10BitRGBXLE:
+			kernels = { PackRGB10RowSSE41<false, 2>, UnpackRGB10RowSSE41<false, 2> };
+			return true;
+
+		case bmdFormat8BitBGRA:
+			kernels = { PackRGBA8RowSSE41<3, 2, 1, 0>, UnpackRGBA8RowSSE41<3, 2, 1, 0> };
+			return true;
+
+		case bmdFormat8BitARGB:
+			kernels = { PackRGBA8RowSSE41<0, 1, 2, 3>, UnpackRGBA8RowSSE41<0, 1, 2, 3> };
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+bool GetAVX2PixelPackingKernels(BMDPixelFormat pixelFormat, PixelPackingKernels& kernels)
+{
+	switch (pixelFormat)
+	{
+		case bmdFormat10BitYUV:
+			kernels = { PackV210RowAVX2, UnpackV210RowAVX2 };
+			return true;
+
+		case bmdFormat10BitRGB:
+			kernels = { PackRGB10RowAVX2<true, 0>, UnpackRGB10RowAVX2<true, 0> };
+			return true;
+
+		case bmdFormat10BitRGBX:
+			kernels = { PackRGB10RowAVX2<true, 2>, UnpackRGB10RowAVX2<true, 2> };
+			return true;
+
+		case bmdFormat10BitRGBXLE:
+			kernels = { PackRGB10RowAVX2<false, 2>, UnpackRGB10RowAVX2<false, 2> };
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+#else
+
+// No SIMD kernels for other architectures, the scalar reference kernels are used
+
+bool IsSSE41Supported()
+{
+	return false;
+}
+
+bool IsAVX2Supported()
+{
+	return false;
+}
+
+bool GetSSE41PixelPackingKernels(BMDPixelFormat, PixelPackingKernels&)
+{
+	return false;
+}
+
+bool GetAVX2PixelPackingKernels(BMDPixelFormat, PixelPackingKernels&)
+{
+	return false;
+}
+
+#endif
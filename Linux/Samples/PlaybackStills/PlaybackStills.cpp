@@ -39,12 +39,15 @@
 */
 
 #include <stdio.h>
+#include <algorithm>
 #include <thread>
 #include <chrono>
 #include <mutex>
 #include <condition_variable>
 #include "platform.h"
 #include "ImageLoader.h"
+#include "StillCache.h"
+#include "FrameConverter.h"
 #include "DeckLinkAPI.h"
 
 static const BMDPixelFormat kConvertedPixelFormat = bmdFormat10BitYUV;
@@ -53,84 +56,30 @@ std::mutex					g_playbackMutex;
 std::condition_variable		g_playbackStopCondition;
 bool						g_keyPressed = false;
 
-void PlaybackStills(IDeckLinkOutput* deckLinkOutput, IDeckLinkVideoFrame* playbackFrame, std::vector<std::string>& pngFiles, long updateIntervalms, bool loopPlayback, bool convertOutput)
+void PlaybackStills(IDeckLinkOutput* deckLinkOutput, StillCache* stillCache, uint32_t stillCount, long updateIntervalms, bool loopPlayback)
 {
 	std::chrono::milliseconds	timerPeriod(updateIntervalms);
-	int							playbackStillsCount	= 0;
+	uint32_t					playbackStillsCount	= 0;
 	bool						playbackRunning		= true;
 	HRESULT						result				= S_OK;
-	IDeckLinkVideoConversion*	frameConverter		= NULL;
-	IDeckLinkMutableVideoFrame*	convertedVideoFrame	= NULL;
-	
-	if (convertOutput)
-	{
-		int outputBytesPerRow;
-
-		result = GetDeckLinkFrameConverter(&frameConverter);
-		if (result != S_OK)
-		{
-			fprintf(stderr, "Unable to get Video Conversion interface\n");
-			goto bail;
-		}
-
-		// Refer to DeckLink SDK Manual - 2.7.4 Pixel Formats
-		switch (kConvertedPixelFormat)
-		{
-			case bmdFormat8BitYUV:
-				outputBytesPerRow = playbackFrame->GetWidth() * 2;
-				break;
-
-			case bmdFormat10BitYUV:
-				outputBytesPerRow = ((playbackFrame->GetWidth() + 47) / 48) * 128;
-				break;
-
-			default:
-				fprintf(stderr, "Unexpected output pixel format\n");
-				goto bail;
-		}
-
-		if (deckLinkOutput->CreateVideoFrame(playbackFrame->GetWidth(), playbackFrame->GetHeight(), outputBytesPerRow,
-			kConvertedPixelFormat, playbackFrame->GetFlags(), &convertedVideoFrame) != S_OK)
-		{
-			fprintf(stderr, "Could not create video frame to convert into\n");
-			playbackRunning = false;
-		}
-	}
+	IDeckLinkVideoFrame*		stillFrame			= NULL;
 	
 	while (playbackRunning)
 	{
-		result = ImageLoader::ConvertPNGToDeckLinkVideoFrame(pngFiles[playbackStillsCount], playbackFrame);
+		// Still is decoded and converted to the output pixel format ahead of time by the still cache
+		result = stillCache->GetStill(playbackStillsCount, &stillFrame);
 		if (result != S_OK)
 		{
-			fprintf(stderr, "Error reading PNG file: %s\n", pngFiles[playbackStillsCount].c_str());
 			playbackRunning = false;
+			continue;
 		}
-		
-		if (convertOutput)
-		{
-			// Pixel format conversion required to output frame
-			if (frameConverter->ConvertFrame(playbackFrame, convertedVideoFrame) != S_OK)
-			{
-				playbackRunning = false;
-				continue;
-			}
 
-			result = deckLinkOutput->DisplayVideoFrameSync(convertedVideoFrame);
-			if (result != S_OK)
-			{
-				fprintf(stderr, "Unable to display video output\n");
-				playbackRunning = false;
-			}
-		}
-		else
+		result = deckLinkOutput->DisplayVideoFrameSync(stillFrame);
+		stillFrame->Release();
+		if (result != S_OK)
 		{
-			// Output frame without format conversion
-			result = deckLinkOutput->DisplayVideoFrameSync(playbackFrame);
-			if (result != S_OK)
-			{
-				fprintf(stderr, "Unable to display video output\n");
-				playbackRunning = false;
-			}
+			fprintf(stderr, "Unable to display video output\n");
+			playbackRunning = false;
 		}
 		
 		std::unique_lock<std::mutex> lock(g_playbackMutex);
@@ -142,7 +91,7 @@ void PlaybackStills(IDeckLinkOutput* deckLinkOutput, IDeckLinkVideoFrame* playba
 		else
 		{
 			// Timeout
-			if (++playbackStillsCount >= (int)pngFiles.size())
+			if (++playbackStillsCount >= stillCount)
 			{
 				if (loopPlayback)
 					playbackStillsCount = 0;
@@ -151,14 +100,6 @@ void PlaybackStills(IDeckLinkOutput* deckLinkOutput, IDeckLinkVideoFrame* playba
 			}
 		}
 	}
-
-bail:
-	if (convertedVideoFrame != NULL)
-		convertedVideoFrame->Release();
-
-	if (frameConverter != NULL)
-		frameConverter->Release();
-
 }
 
 void DisplayUsage(const IDeckLinkOutput* selectedDeckLinkOutput, const std::vector<std::string>& deviceNames,
@@ -231,11 +172,16 @@ void DisplayUsage(const IDeckLinkOutput* selectedDeckLinkOutput, const std::vect
 	fprintf(stderr,
 		"    -i <interval>\n        Playback frame interval rate (default is 1 - every frame)\n"
 		"    -l\n        Loop playback\n"
+		"    -a <stills>\n        Number of stills to decode ahead of playback (default is %u)\n"
+		"    -r\n        Do not read or write raw still cache files in <imagedirectory>/%s\n"
+		"    -c\n        Convert stills with the DeckLink API video conversion instead of the CPU converter\n"
 		"    <imagedirectory>\n"
 		"\n"
 		"Playback PNG image stills from a specified directory. eg:\n"
 		"\n"
-		"    ./PlaybackStills -d 0 -m 2 -i 60 -l ~/Pictures/\n"
+		"    ./PlaybackStills -d 0 -m 2 -i 60 -l ~/Pictures/\n",
+		kStillCacheDefaultDecodeAheadCount,
+		kStillCacheDirectoryName
 		);
 }
 
@@ -249,6 +195,9 @@ int main(int argc, char* argv[])
 	bool						loopPlayback		= false;
 	int							updateInterval		= 1;
 	bool						convertOutputFormat = false;
+	bool						useCacheFiles		= true;
+	bool						useDeckLinkConversion = false;
+	uint32_t					decodeAheadCount	= kStillCacheDefaultDecodeAheadCount;
 	std::string					playbackDirectory;
 
 	HRESULT						result;
@@ -260,7 +209,9 @@ int main(int argc, char* argv[])
 	IDeckLinkIterator*			deckLinkIterator		= NULL;
 	IDeckLink*					deckLink				= NULL;
 	IDeckLinkOutput*			selectedDeckLinkOutput	= NULL;
-	IDeckLinkMutableVideoFrame*	playbackFrame			= NULL;
+	IDeckLinkVideoConversion*	frameConverter			= NULL;
+	StillCache*					stillCache				= NULL;
+	StillCacheStatistics		stillCacheStatistics;
 
 	BMDDisplayMode				selectedDisplayMode		= bmdModeNTSC;
 	std::string					selectedDisplayModeName;
@@ -291,6 +242,15 @@ int main(int argc, char* argv[])
 		else if (strcmp(argv[i], "-l") == 0)
 			loopPlayback = true;
 
+		else if (strcmp(argv[i], "-a") == 0)
+			decodeAheadCount = (uint32_t)std::max(atoi(argv[++i]), 1);
+
+		else if (strcmp(argv[i], "-r") == 0)
+			useCacheFiles = false;
+
+		else if (strcmp(argv[i], "-c") == 0)
+			useDeckLinkConversion = true;
+
 		else if ((strcmp(argv[i], "?") == 0) || (strcmp(argv[i], "-h") == 0))
 			displayHelp = true;
 
@@ -456,19 +416,33 @@ int main(int argc, char* argv[])
 		goto bail;
 	}
 	
-	// Create video frame for playback, as we are outputting frame synchronously, 
-	// then we can reuse without waiting on callback 
-	result = selectedDeckLinkOutput->CreateVideoFrame((int32_t)displayModes[displayModeIndex]->GetWidth(),
-													  (int32_t)displayModes[displayModeIndex]->GetHeight(),
-													  (int32_t)displayModes[displayModeIndex]->GetWidth() * 4,
-													  ImageLoader::kImageLoaderPixelFormat,
-													  bmdFrameFlagDefault,
-													  &playbackFrame);
-	if (result != S_OK)
+	// Create frame conversion instance when the device cannot output the PNG pixel format, 
+	// either the CPU converter or the DeckLink API conversion
+	if (convertOutputFormat)
 	{
-		fprintf(stderr, "Unable to create video frame\n");
-		goto bail;
+		if (useDeckLinkConversion)
+		{
+			result = GetDeckLinkFrameConverter(&frameConverter);
+			if (result != S_OK)
+			{
+				fprintf(stderr, "Unable to get Video Conversion interface\n");
+				goto bail;
+			}
+		}
+		else
+			frameConverter = new FrameConverter();
 	}
+
+	// Stills are decoded and converted by the still cache threads, as we are outputting frames
+	// synchronously the playback thread only has to display them
+	stillCache = new StillCache(pngFiles,
+								displayModes[displayModeIndex]->GetWidth(),
+								displayModes[displayModeIndex]->GetHeight(),
+								convertOutputFormat ? kConvertedPixelFormat : ImageLoader::kImageLoaderPixelFormat,
+								frameConverter,
+								loopPlayback,
+								decodeAheadCount,
+								useCacheFiles ? playbackDirectory + '/' + kStillCacheDirectoryName : std::string());
 	
 	// OK to start playback - print configuration
 	fprintf(stderr, "Output with the following configuration:\n"
@@ -477,20 +451,24 @@ int main(int argc, char* argv[])
 		" - Playback update interval: %d\n"
 		" - Loop Playback: %s\n"
 		" - Playback directory: %s\n"
-		" - Number of images to playback: %d\n",
+		" - Number of images to playback: %d\n"
+		" - Decode ahead: %u stills\n"
+		" - Still cache files: %s\n",
 		deckLinkDeviceNames[deckLinkIndex].c_str(),
 		selectedDisplayModeName.c_str(),
 		updateInterval,
 		loopPlayback ? "YES" : "NO",
 		playbackDirectory.c_str(),
-		(int)pngFiles.size()
+		(int)pngFiles.size(),
+		decodeAheadCount,
+		useCacheFiles ? "YES" : "NO"
 		);
 	fprintf(stderr, "Starting Playback, press <RETURN> to exit\n");
 
 	// Start thread for message processing
 	playbackStillsThread = std::thread([&]{
-		PlaybackStills(selectedDeckLinkOutput, (IDeckLinkVideoFrame*)playbackFrame, pngFiles,
-						updateInterval * 1000 * (long)frameDuration / (long)frameTimescale, loopPlayback, convertOutputFormat);
+		PlaybackStills(selectedDeckLinkOutput, stillCache, (uint32_t)pngFiles.size(),
+						updateInterval * 1000 * (long)frameDuration / (long)frameTimescale, loopPlayback);
 	});
 	
 	// Wait on return press, then notify playback thread to finalize
@@ -507,6 +485,15 @@ int main(int argc, char* argv[])
 	if (result != S_OK)
 		goto bail;
 
+	stillCacheStatistics = stillCache->GetStatistics();
+	fprintf(stderr, "Stills decoded: %llu (mean %.1f ms, max %.1f ms), mapped from cache: %llu, cache files written: %llu, late: %llu\n",
+		(unsigned long long)stillCacheStatistics.decodedCount,
+		stillCacheStatistics.decodedCount ? (double)stillCacheStatistics.totalDecodeMicroseconds / stillCacheStatistics.decodedCount / 1000.0 : 0.0,
+		(double)stillCacheStatistics.maxDecodeMicroseconds / 1000.0,
+		(unsigned long long)stillCacheStatistics.mappedCount,
+		(unsigned long long)stillCacheStatistics.cacheFileWriteCount,
+		(unsigned long long)stillCacheStatistics.lateCount);
+
 	exitStatus = 0;
 
 bail:
@@ -516,10 +503,16 @@ bail:
 		displayModes.pop_back();
 	}
 	
-	if (playbackFrame != NULL)
+	if (stillCache != NULL)
 	{
-		playbackFrame->Release();
-		playbackFrame = NULL;
+		delete stillCache;
+		stillCache = NULL;
+	}
+
+	if (frameConverter != NULL)
+	{
+		frameConverter->Release();
+		frameConverter = NULL;
 	}
 
 	if (selectedDeckLinkOutput != NULL)
@@ -0,0 +1,456 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "platform.h"
+#include "ImageLoader.h"
+#include "PixelPacking.h"
+#include "StillCache.h"
+
+// Raw cache file layout: header followed by the pixels of the still at a page aligned offset,
+// so the mapped pixels are as aligned as an allocated frame
+static const uint32_t	kStillCacheFileMagic		= 'BMsc';
+static const uint32_t	kStillCacheFileVersion		= 1;
+static const size_t		kStillCacheFilePixelOffset	= 4096;
+
+struct StillCacheFileHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	width;
+	uint32_t	height;
+	uint32_t	rowBytes;
+	uint32_t	pixelFormat;
+	uint64_t	sourceFileSize;
+	int64_t		sourceModifiedTime;		// nanoseconds
+};
+
+static bool GetSourceFileInfo(const std::string& filename, uint64_t& fileSize, int64_t& modifiedTime)
+{
+	struct stat fileStat;
+
+	if (stat(filename.c_str(), &fileStat) != 0)
+		return false;
+
+	fileSize		= (uint64_t)fileStat.st_size;
+	modifiedTime	= (int64_t)fileStat.st_mtim.tv_sec * 1000000000 + fileStat.st_mtim.tv_nsec;
+	return true;
+}
+
+static bool WriteAll(int fd, const void* data, size_t size, off_t offset)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+
+	while (size > 0)
+	{
+		ssize_t written = pwrite(fd, bytes, size, offset);
+		if (written <= 0)
+			return false;
+
+		bytes	+= written;
+		size	-= written;
+		offset	+= written;
+	}
+	return true;
+}
+
+StillCache::StillCache(const std::vector<std::string>& pngFiles, long width, long height, BMDPixelFormat pixelFormat,
+						IDeckLinkVideoConversion* frameConverter, bool loopPlayback, uint32_t decodeAheadCount, const std::string& cacheDirectory) :
+	m_pngFiles(pngFiles),
+	m_width(width),
+	m_height(height),
+	m_pixelFormat(pixelFormat),
+	m_frameConverter(frameConverter),
+	m_loopPlayback(loopPlayback),
+	m_decodeAheadCount(std::max(decodeAheadCount, 1U)),
+	m_cacheDirectory(cacheDirectory),
+	m_terminate(false),
+	m_statistics()
+{
+	uint32_t decoderThreadCount = std::max(std::min(m_decodeAheadCount, std::thread::hardware_concurrency()), 1U);
+
+	if (m_frameConverter != nullptr)
+		m_frameConverter->AddRef();
+
+	if (!m_cacheDirectory.empty() && (mkdir(m_cacheDirectory.c_str(), 0755) != 0) && !IsPathDirectory(m_cacheDirectory))
+	{
+		fprintf(stderr, "Unable to create still cache directory %s, stills will not be cached\n", m_cacheDirectory.c_str());
+		m_cacheDirectory.clear();
+	}
+
+	for (uint32_t i = 0; i < decoderThreadCount; i++)
+		m_decoderThreads.push_back(std::thread(&StillCache::DecoderThread, this));
+
+	// Start decoding the first stills before playback starts
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_pngFiles.empty())
+		UpdateDecodeWindow(0);
+}
+
+StillCache::~StillCache()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_terminate = true;
+	}
+	m_queueCondition.notify_all();
+
+	for (std::thread& decoderThread : m_decoderThreads)
+		decoderThread.join();
+
+	for (auto& entry : m_entries)
+	{
+		if (entry.second.frame != nullptr)
+			entry.second.frame->Release();
+	}
+	m_entries.clear();
+
+	if (m_frameConverter != nullptr)
+		m_frameConverter->Release();
+}
+
+HRESULT StillCache::GetStill(uint32_t index, IDeckLinkVideoFrame** stillFrame)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if ((index >= m_pngFiles.size()) || (stillFrame == nullptr))
+		return E_INVALIDARG;
+
+	UpdateDecodeWindow(index);
+
+	if (m_entries[index].state != EntryState::Ready)
+	{
+		m_statistics.lateCount++;
+		m_readyCondition.wait(lock, [&]{ return m_entries[index].state == EntryState::Ready; });
+	}
+
+	CacheEntry& entry = m_entries[index];
+	if (entry.result != S_OK)
+		return entry.result;
+
+	entry.frame->AddRef();
+	*stillFrame = entry.frame;
+	return S_OK;
+}
+
+StillCacheStatistics StillCache::GetStatistics(void)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_statistics;
+}
+
+void StillCache::UpdateDecodeWindow(uint32_t index)
+{
+	// Called with m_mutex held.  The window is the still at index and the decode-ahead stills
+	// that follow it, wrapping to the start of the directory when looping
+	uint32_t				stillCount = (uint32_t)m_pngFiles.size();
+	std::vector<uint32_t>	window;
+
+	for (uint32_t i = 0; (i <= m_decodeAheadCount) && (i < stillCount); i++)
+	{
+		uint32_t windowIndex = index + i;
+		if (windowIndex >= stillCount)
+		{
+			if (!m_loopPlayback)
+				break;
+			windowIndex -= stillCount;
+		}
+		window.push_back(windowIndex);
+	}
+
+	// Release stills outside of the window, a still being loaded is released on a later call
+	for (auto iter = m_entries.begin(); iter != m_entries.end(); )
+	{
+		if ((iter->second.state == EntryState::Loading) || (std::find(window.begin(), window.end(), iter->first) != window.end()))
+		{
+			++iter;
+			continue;
+		}
+
+		if (iter->second.state == EntryState::Queued)
+			m_decodeQueue.erase(std::remove(m_decodeQueue.begin(), m_decodeQueue.end(), iter->first), m_decodeQueue.end());
+
+		if (iter->second.frame != nullptr)
+			iter->second.frame->Release();
+
+		iter = m_entries.erase(iter);
+	}
+
+	// Queue the stills that are not yet cached, with the still at index first
+	for (size_t i = 0; i < window.size(); i++)
+	{
+		auto iter = m_entries.find(window[i]);
+
+		if (iter == m_entries.end())
+		{
+			m_entries[window[i]] = { EntryState::Queued, S_OK, nullptr };
+			if (i == 0)
+				m_decodeQueue.push_front(window[i]);
+			else
+				m_decodeQueue.push_back(window[i]);
+		}
+		else if ((i == 0) && (iter->second.state == EntryState::Queued))
+		{
+			m_decodeQueue.erase(std::remove(m_decodeQueue.begin(), m_decodeQueue.end(), window[i]), m_decodeQueue.end());
+			m_decodeQueue.push_front(window[i]);
+		}
+	}
+
+	if (!m_decodeQueue.empty())
+		m_queueCondition.notify_all();
+}
+
+void StillCache::DecoderThread(void)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		m_queueCondition.wait(lock, [&]{ return m_terminate || !m_decodeQueue.empty(); });
+		if (m_terminate)
+			break;
+
+		uint32_t index = m_decodeQueue.front();
+		m_decodeQueue.pop_front();
+		m_entries[index].state = EntryState::Loading;
+
+		lock.unlock();
+
+		CachedVideoFrame*	stillFrame	= nullptr;
+		bool				mapped		= false;
+		bool				written		= false;
+		auto				startTime	= std::chrono::steady_clock::now();
+		HRESULT				result		= LoadStill(index, &stillFrame, mapped, written);
+		uint64_t			loadTime	= std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+		lock.lock();
+
+		CacheEntry& entry = m_entries[index];
+		entry.state		= EntryState::Ready;
+		entry.result	= result;
+		entry.frame		= stillFrame;
+
+		if (mapped)
+		{
+			m_statistics.mappedCount++;
+		}
+		else if (result == S_OK)
+		{
+			m_statistics.decodedCount++;
+			m_statistics.totalDecodeMicroseconds += loadTime;
+			m_statistics.maxDecodeMicroseconds = std::max(m_statistics.maxDecodeMicroseconds, loadTime);
+		}
+
+		if (written)
+			m_statistics.cacheFileWriteCount++;
+
+		m_readyCondition.notify_all();
+	}
+}
+
+HRESULT StillCache::LoadStill(uint32_t index, CachedVideoFrame** stillFrame, bool& mapped, bool& written)
+{
+	const std::string& pngFilename = m_pngFiles[index];
+	HRESULT result;
+
+	if (!m_cacheDirectory.empty() && (MapCacheFile(pngFilename, stillFrame) == S_OK))
+	{
+		mapped = true;
+		return S_OK;
+	}
+
+	result = DecodeStill(pngFilename, stillFrame);
+	if (result != S_OK)
+		return result;
+
+	if (!m_cacheDirectory.empty())
+		written = (WriteCacheFile(pngFilename, *stillFrame) == S_OK);
+
+	return S_OK;
+}
+
+HRESULT StillCache::DecodeStill(const std::string& pngFilename, CachedVideoFrame** stillFrame)
+{
+	CachedVideoFrame*	imageFrame		= new CachedVideoFrame(m_width, m_height, ImageLoader::kImageLoaderPixelFormat, bmdFrameFlagDefault);
+	CachedVideoFrame*	convertedFrame	= nullptr;
+	HRESULT				result;
+
+	result = ImageLoader::ConvertPNGToDeckLinkVideoFrame(pngFilename, imageFrame);
+	if (result != S_OK)
+	{
+		fprintf(stderr, "Error reading PNG file: %s\n", pngFilename.c_str());
+		imageFrame->Release();
+		return result;
+	}
+
+	if (m_pixelFormat == ImageLoader::kImageLoaderPixelFormat)
+	{
+		*stillFrame = imageFrame;
+		return S_OK;
+	}
+
+	// Pixel format conversion required to output frame
+	convertedFrame = new CachedVideoFrame(m_width, m_height, m_pixelFormat, bmdFrameFlagDefault);
+	{
+		std::lock_guard<std::mutex> lock(m_conversionMutex);
+		result = (m_frameConverter != nullptr) ? m_frameConverter->ConvertFrame(imageFrame, convertedFrame) : E_FAIL;
+	}
+	imageFrame->Release();
+
+	if (result != S_OK)
+	{
+		fprintf(stderr, "Unable to convert still %s to output pixel format\n", pngFilename.c_str());
+		convertedFrame->Release();
+		return result;
+	}
+
+	*stillFrame = convertedFrame;
+	return S_OK;
+}
+
+std::string StillCache::GetCacheFilename(const std::string& pngFilename)
+{
+	// eg <cachedirectory>/image.png.1920x1080.v210
+	size_t		nameOffset	= pngFilename.find_last_of('/');
+	std::string	name		= (nameOffset == std::string::npos) ? pngFilename : pngFilename.substr(nameOffset + 1);
+	char		suffix[64];
+
+	snprintf(suffix, sizeof(suffix), ".%ldx%ld.%c%c%c%c", m_width, m_height,
+			 (char)(m_pixelFormat >> 24), (char)(m_pixelFormat >> 16), (char)(m_pixelFormat >> 8), (char)m_pixelFormat);
+
+	return m_cacheDirectory + '/' + name + suffix;
+}
+
+HRESULT StillCache::MapCacheFile(const std::string& pngFilename, CachedVideoFrame** stillFrame)
+{
+	std::string				cacheFilename	= GetCacheFilename(pngFilename);
+	uint64_t				sourceFileSize;
+	int64_t					sourceModifiedTime;
+	StillCacheFileHeader	header;
+	struct stat				cacheFileStat;
+	size_t					pixelBytes;
+	void*					mapping;
+	int						fd;
+
+	if (!GetSourceFileInfo(pngFilename, sourceFileSize, sourceModifiedTime))
+		return E_FAIL;
+
+	fd = open(cacheFilename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return E_FAIL;
+
+	// Reject files written for a different frame or an older version of the PNG.  The row bytes must be those
+	// of the output frame, a shorter row would let the output read past the end of the mapping.  A rejected
+	// file is replaced when the still is decoded again
+	if ((fstat(fd, &cacheFileStat) != 0) || 
+		(pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) ||
+		(header.magic != kStillCacheFileMagic) || (header.version != kStillCacheFileVersion) ||
+		(header.width != (uint32_t)m_width) || (header.height != (uint32_t)m_height) || (header.pixelFormat != m_pixelFormat) ||
+		(header.rowBytes != GetPixelFormatRowBytes(m_pixelFormat, (uint32_t)m_width)) ||
+		(header.sourceFileSize != sourceFileSize) || (header.sourceModifiedTime != sourceModifiedTime))
+	{
+		close(fd);
+		return E_FAIL;
+	}
+
+	pixelBytes = (size_t)header.rowBytes * header.height;
+	if ((size_t)cacheFileStat.st_size < kStillCacheFilePixelOffset + pixelBytes)
+	{
+		close(fd);
+		return E_FAIL;
+	}
+
+	// Populate the mapping on the decoder thread, so displaying the still does not fault in pages
+	mapping = mmap(nullptr, kStillCacheFilePixelOffset + pixelBytes, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+	close(fd);
+
+	if (mapping == MAP_FAILED)
+		return E_FAIL;
+
+	*stillFrame = new CachedVideoFrame(m_width, m_height, header.rowBytes, m_pixelFormat, bmdFrameFlagDefault,
+										mapping, kStillCacheFilePixelOffset + pixelBytes, kStillCacheFilePixelOffset);
+	return S_OK;
+}
+
+HRESULT StillCache::WriteCacheFile(const std::string& pngFilename, CachedVideoFrame* stillFrame)
+{
+	std::string				cacheFilename	= GetCacheFilename(pngFilename);
+	std::string				tempFilename	= cacheFilename + ".XXXXXX";
+	StillCacheFileHeader	header			= {};
+	void*					pixels;
+	bool					success;
+	int						fd;
+
+	if (!GetSourceFileInfo(pngFilename, header.sourceFileSize, header.sourceModifiedTime))
+		return E_FAIL;
+
+	header.magic		= kStillCacheFileMagic;
+	header.version		= kStillCacheFileVersion;
+	header.width		= (uint32_t)stillFrame->GetWidth();
+	header.height		= (uint32_t)stillFrame->GetHeight();
+	header.rowBytes		= (uint32_t)stillFrame->GetRowBytes();
+	header.pixelFormat	= stillFrame->GetPixelFormat();
+	stillFrame->GetBytes(&pixels);
+
+	// Write to a temporary file and rename, so a partially written file is never mapped
+	fd = mkstemp(&tempFilename[0]);
+	if (fd < 0)
+		return E_FAIL;
+
+	success = WriteAll(fd, &header, sizeof(header), 0) && 
+				WriteAll(fd, pixels, (size_t)header.rowBytes * header.height, kStillCacheFilePixelOffset);
+	fchmod(fd, 0644);
+	close(fd);
+
+	if (!success || (rename(tempFilename.c_str(), cacheFilename.c_str()) != 0))
+	{
+		fprintf(stderr, "Unable to write still cache file %s\n", cacheFilename.c_str());
+		unlink(tempFilename.c_str());
+		return E_FAIL;
+	}
+
+	return S_OK;
+}
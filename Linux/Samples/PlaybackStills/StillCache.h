@@ -0,0 +1,126 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "DeckLinkAPI.h"
+#include "CachedVideoFrame.h"
+
+// Decode-ahead cache of stills for playback.  A pool of decoder threads keeps the still being
+// displayed and the stills that follow it decoded and converted to the output pixel format, so a
+// large PNG does not delay playback and a looped directory that fits in the decode-ahead window is
+// decoded once.
+//
+// When a cache directory is given, each converted still is also written there as a raw file in the
+// output pixel format, named after the PNG, the frame size and the pixel format.  On later runs the
+// raw file is mapped instead of decoding the PNG, provided the size and modification time of the
+// PNG are unchanged.
+
+static const uint32_t		kStillCacheDefaultDecodeAheadCount	= 4;
+static const char* const	kStillCacheDirectoryName			= ".stillcache";
+
+struct StillCacheStatistics
+{
+	uint64_t	decodedCount;				// Stills decoded from PNG and converted
+	uint64_t	mappedCount;				// Stills mapped from raw cache files
+	uint64_t	cacheFileWriteCount;		// Raw cache files written
+	uint64_t	lateCount;					// Stills that were not ready when requested for display
+	uint64_t	totalDecodeMicroseconds;
+	uint64_t	maxDecodeMicroseconds;
+};
+
+class StillCache
+{
+public:
+	StillCache(const std::vector<std::string>& pngFiles, long width, long height, BMDPixelFormat pixelFormat, 
+				IDeckLinkVideoConversion* frameConverter, bool loopPlayback, uint32_t decodeAheadCount, const std::string& cacheDirectory);
+	virtual ~StillCache();
+
+	// Returns a reference to the still at index, waiting for it to be decoded if necessary, and
+	// queues the stills that follow it for decoding
+	HRESULT					GetStill(uint32_t index, IDeckLinkVideoFrame** stillFrame);
+	StillCacheStatistics	GetStatistics(void);
+
+private:
+	enum class EntryState { Queued, Loading, Ready };
+
+	struct CacheEntry
+	{
+		EntryState			state;
+		HRESULT				result;
+		CachedVideoFrame*	frame;
+	};
+
+	std::vector<std::string>	m_pngFiles;
+	long						m_width;
+	long						m_height;
+	BMDPixelFormat				m_pixelFormat;
+	IDeckLinkVideoConversion*	m_frameConverter;
+	bool						m_loopPlayback;
+	uint32_t					m_decodeAheadCount;
+	std::string					m_cacheDirectory;
+
+	std::vector<std::thread>	m_decoderThreads;
+	std::mutex					m_mutex;
+	std::condition_variable		m_queueCondition;
+	std::condition_variable		m_readyCondition;
+	std::map<uint32_t, CacheEntry>	m_entries;
+	std::deque<uint32_t>		m_decodeQueue;
+	bool						m_terminate;
+	StillCacheStatistics		m_statistics;
+
+	// Serialises calls to the frame converter, which is shared by the decoder threads
+	std::mutex					m_conversionMutex;
+
+	void		DecoderThread(void);
+	void		UpdateDecodeWindow(uint32_t index);
+	HRESULT		LoadStill(uint32_t index, CachedVideoFrame** stillFrame, bool& mapped, bool& written);
+	HRESULT		DecodeStill(const std::string& pngFilename, CachedVideoFrame** stillFrame);
+	std::string	GetCacheFilename(const std::string& pngFilename);
+	HRESULT		MapCacheFile(const std::string& pngFilename, CachedVideoFrame** stillFrame);
+	HRESULT		WriteCacheFile(const std::string& pngFilename, CachedVideoFrame* stillFrame);
+};
@@ -0,0 +1,380 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "ST2110.h"
+
+namespace
+{
+	const uint32_t	kV210BlockSamples		= 12;		// 6 pixels in four 32-bit words
+	const uint32_t	kV210BlockPgroups		= 3;
+	const uint32_t	kPgroupSamples			= 4;
+	const int		kMulticastTTL			= 16;
+	const int		kSocketBufferSize		= 32 * 1024 * 1024;
+
+	// Samples of a v210 row are numbered in the order Cb Y0 Cr Y1 ..., three to each 32-bit word
+	inline uint32_t GetV210Sample(const uint32_t* words, uint32_t sample)
+	{
+		return (words[sample / 3] >> (10 * (sample % 3))) & 0x3FF;
+	}
+
+	inline void SetV210Sample(uint32_t* words, uint32_t sample, uint32_t value)
+	{
+		uint32_t shift = 10 * (sample % 3);
+		words[sample / 3] = (words[sample / 3] & ~(0x3FFu << shift)) | (value << shift);
+	}
+
+	inline void WritePgroup(uint8_t* pgroup, uint32_t s0, uint32_t s1, uint32_t s2, uint32_t s3)
+	{
+		pgroup[0] = (uint8_t)(s0 >> 2);
+		pgroup[1] = (uint8_t)(s0 << 6 | s1 >> 4);
+		pgroup[2] = (uint8_t)(s1 << 4 | s2 >> 6);
+		pgroup[3] = (uint8_t)(s2 << 2 | s3 >> 8);
+		pgroup[4] = (uint8_t)s3;
+	}
+
+	inline void ReadPgroup(const uint8_t* pgroup, uint32_t samples[kPgroupSamples])
+	{
+		samples[0] = (uint32_t)pgroup[0] << 2 | pgroup[1] >> 6;
+		samples[1] = (uint32_t)(pgroup[1] & 0x3F) << 4 | pgroup[2] >> 4;
+		samples[2] = (uint32_t)(pgroup[2] & 0x0F) << 6 | pgroup[3] >> 2;
+		samples[3] = (uint32_t)(pgroup[3] & 0x03) << 8 | pgroup[4];
+	}
+
+	inline void PackV210Block(const uint32_t* words, uint8_t* pgroups)
+	{
+		uint32_t w0 = words[0], w1 = words[1], w2 = words[2], w3 = words[3];
+
+		WritePgroup(pgroups,      w0 & 0x3FF,         (w0 >> 10) & 0x3FF, (w0 >> 20) & 0x3FF, w1 & 0x3FF);
+		WritePgroup(pgroups + 5,  (w1 >> 10) & 0x3FF, (w1 >> 20) & 0x3FF, w2 & 0x3FF,         (w2 >> 10) & 0x3FF);
+		WritePgroup(pgroups + 10, (w2 >> 20) & 0x3FF, w3 & 0x3FF,         (w3 >> 10) & 0x3FF, (w3 >> 20) & 0x3FF);
+	}
+
+	inline void UnpackV210Block(const uint8_t* pgroups, uint32_t* words)
+	{
+		uint32_t s[kV210BlockSamples];
+
+		ReadPgroup(pgroups, s);
+		ReadPgroup(pgroups + 5, s + 4);
+		ReadPgroup(pgroups + 10, s + 8);
+
+		words[0] = s[0] | s[1] << 10 | s[2] << 20;
+		words[1] = s[3] | s[4] << 10 | s[5] << 20;
+		words[2] = s[6] | s[7] << 10 | s[8] << 20;
+		words[3] = s[9] | s[10] << 10 | s[11] << 20;
+	}
+
+	bool ResolveAddress(const char* address, uint16_t port, sockaddr_in& socketAddress)
+	{
+		addrinfo	hints;
+		addrinfo*	result = NULL;
+
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family		= AF_INET;
+		hints.ai_socktype	= SOCK_DGRAM;
+
+		if (getaddrinfo(address, NULL, &hints, &result) != 0 || result == NULL)
+			return false;
+
+		socketAddress			= *(sockaddr_in*)result->ai_addr;
+		socketAddress.sin_port	= htons(port);
+		freeaddrinfo(result);
+		return true;
+	}
+}
+
+bool GetST2110VideoLayout(uint32_t width, uint32_t height, bool interlaced, bool lowerFieldFirst, ST2110VideoLayout& layout)
+{
+	uint32_t	rowPgroups = width / kST2110PgroupPixels;
+	uint32_t	rowsPerField;
+
+	layout.fieldCount		= interlaced ? 2 : 1;
+	layout.firstFieldRow	= (interlaced && lowerFieldFirst) ? 1 : 0;
+
+	// Line numbers and pixel offsets are 15 bits in the sample row data header
+	if (width == 0 || (width % kST2110PgroupPixels) != 0 || width > 0x8000 || height == 0 || (height % layout.fieldCount) != 0 || height > 0x8000)
+		return false;
+
+	// The largest whole fraction of a row that fits in a packet, so all packets are the same size
+	layout.pgroupsPerPacket = std::min(rowPgroups, kST2110MaxVideoPayload / kST2110PgroupBytes);
+	while (rowPgroups % layout.pgroupsPerPacket != 0)
+		layout.pgroupsPerPacket--;
+
+	rowsPerField			= height / layout.fieldCount;
+	layout.width			= width;
+	layout.height			= height;
+	layout.packetsPerRow	= rowPgroups / layout.pgroupsPerPacket;
+	layout.packetCount		= layout.packetsPerRow * height;
+	layout.payloadSize		= layout.pgroupsPerPacket * kST2110PgroupBytes;
+	layout.packetSize		= kST2110VideoHeaderSize + layout.payloadSize;
+	layout.packets.resize(layout.packetCount);
+
+	ST2110VideoPacket* packet = layout.packets.data();
+
+	for (uint32_t field = 0; field < layout.fieldCount; field++)
+	{
+		for (uint32_t line = 0; line < rowsPerField; line++)
+		{
+			uint32_t row = interlaced ? line * 2 + (field == 0 ? layout.firstFieldRow : 1 - layout.firstFieldRow) : line;
+			uint16_t fieldLine = (uint16_t)(field << 15 | line);
+
+			for (uint32_t i = 0; i < layout.packetsPerRow; i++, packet++)
+			{
+				uint16_t offset = (uint16_t)(i * layout.pgroupsPerPacket * kST2110PgroupPixels);
+
+				packet->row				= row;
+				packet->firstPixel		= offset;
+				packet->field			= (uint8_t)field;
+				packet->lastOfField		= (line == rowsPerField - 1) && (i == layout.packetsPerRow - 1);
+				packet->rowHeader[0]	= (uint8_t)(layout.payloadSize >> 8);
+				packet->rowHeader[1]	= (uint8_t)layout.payloadSize;
+				packet->rowHeader[2]	= (uint8_t)(fieldLine >> 8);
+				packet->rowHeader[3]	= (uint8_t)fieldLine;
+				packet->rowHeader[4]	= (uint8_t)(offset >> 8);
+				packet->rowHeader[5]	= (uint8_t)offset;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool GetST2110AudioLayout(uint32_t channelCount, uint32_t sampleDepth, ST2110AudioLayout& layout)
+{
+	if (channelCount == 0 || (sampleDepth != 16 && sampleDepth != 32))
+		return false;
+
+	layout.channelCount				= channelCount;
+	layout.sampleDepth				= sampleDepth;
+	layout.payloadSampleBytes		= (sampleDepth == 16) ? 2 : 3;
+
+	// 1 ms packets, or 125 us when 1 ms of every channel doesn't fit in a packet
+	layout.sampleFramesPerPacket	= kST2110AudioClockRate / 1000;
+	if (channelCount * layout.payloadSampleBytes * layout.sampleFramesPerPacket > kST2110MaxAudioPayload)
+		layout.sampleFramesPerPacket = kST2110AudioClockRate / 8000;
+
+	layout.payloadSize				= channelCount * layout.payloadSampleBytes * layout.sampleFramesPerPacket;
+	layout.packetSize				= kRTPHeaderSize + layout.payloadSize;
+	layout.packetNanoseconds		= layout.sampleFramesPerPacket * 1000000000ULL / kST2110AudioClockRate;
+
+	return layout.payloadSize <= kST2110MaxAudioPayload;
+}
+
+void PackST2110Pgroups(const void* v210Row, uint32_t firstPixel, uint32_t pixelCount, uint8_t* pgroups)
+{
+	const uint32_t*	words		= (const uint32_t*)v210Row;
+	uint32_t		sample		= firstPixel * 2;
+	uint32_t		endSample	= (firstPixel + pixelCount) * 2;
+
+	// Pgroups up to the first whole v210 block, then whole blocks, then the remainder
+	for (; sample < endSample && (sample % kV210BlockSamples) != 0; sample += kPgroupSamples, pgroups += kST2110PgroupBytes)
+		WritePgroup(pgroups, GetV210Sample(words, sample), GetV210Sample(words, sample + 1), GetV210Sample(words, sample + 2), GetV210Sample(words, sample + 3));
+
+	for (; endSample - sample >= kV210BlockSamples; sample += kV210BlockSamples, pgroups += kV210BlockPgroups * kST2110PgroupBytes)
+		PackV210Block(words + sample / 3, pgroups);
+
+	for (; sample < endSample; sample += kPgroupSamples, pgroups += kST2110PgroupBytes)
+		WritePgroup(pgroups, GetV210Sample(words, sample), GetV210Sample(words, sample + 1), GetV210Sample(words, sample + 2), GetV210Sample(words, sample + 3));
+}
+
+void UnpackST2110Pgroups(const uint8_t* pgroups, uint32_t firstPixel, uint32_t pixelCount, void* v210Row)
+{
+	uint32_t*	words		= (uint32_t*)v210Row;
+	uint32_t	sample		= firstPixel * 2;
+	uint32_t	endSample	= (firstPixel + pixelCount) * 2;
+	uint32_t	samples[kPgroupSamples];
+
+	// Partial blocks are shared with the neighbouring segments, so only their own samples are written
+	for (; sample < endSample && (sample % kV210BlockSamples) != 0; sample += kPgroupSamples, pgroups += kST2110PgroupBytes)
+	{
+		ReadPgroup(pgroups, samples);
+		for (uint32_t i = 0; i < kPgroupSamples; i++)
+			SetV210Sample(words, sample + i, samples[i]);
+	}
+
+	for (; endSample - sample >= kV210BlockSamples; sample += kV210BlockSamples, pgroups += kV210BlockPgroups * kST2110PgroupBytes)
+		UnpackV210Block(pgroups, words + sample / 3);
+
+	for (; sample < endSample; sample += kPgroupSamples, pgroups += kST2110PgroupBytes)
+	{
+		ReadPgroup(pgroups, samples);
+		for (uint32_t i = 0; i < kPgroupSamples; i++)
+			SetV210Sample(words, sample + i, samples[i]);
+	}
+}
+
+void PackST2110Audio(const ST2110AudioLayout& layout, const void* samples, uint32_t sampleFrameCount, uint8_t* payload)
+{
+	uint32_t sampleCount = sampleFrameCount * layout.channelCount;
+
+	if (layout.sampleDepth == 16)
+	{
+		const int16_t* in = (const int16_t*)samples;
+
+		for (uint32_t i = 0; i < sampleCount; i++, payload += 2)
+		{
+			payload[0] = (uint8_t)((uint16_t)in[i] >> 8);
+			payload[1] = (uint8_t)in[i];
+		}
+	}
+	else
+	{
+		// L24 keeps the most significant 24 bits of each 32-bit sample
+		const int32_t* in = (const int32_t*)samples;
+
+		for (uint32_t i = 0; i < sampleCount; i++, payload += 3)
+		{
+			payload[0] = (uint8_t)((uint32_t)in[i] >> 24);
+			payload[1] = (uint8_t)((uint32_t)in[i] >> 16);
+			payload[2] = (uint8_t)((uint32_t)in[i] >> 8);
+		}
+	}
+}
+
+void UnpackST2110Audio(const ST2110AudioLayout& layout, const uint8_t* payload, uint32_t sampleFrameCount, void* samples)
+{
+	uint32_t sampleCount = sampleFrameCount * layout.channelCount;
+
+	if (layout.sampleDepth == 16)
+	{
+		int16_t* out = (int16_t*)samples;
+
+		for (uint32_t i = 0; i < sampleCount; i++, payload += 2)
+			out[i] = (int16_t)ReadBigEndian16(payload);
+	}
+	else
+	{
+		int32_t* out = (int32_t*)samples;
+
+		for (uint32_t i = 0; i < sampleCount; i++, payload += 3)
+			out[i] = (int32_t)((uint32_t)payload[0] << 24 | (uint32_t)payload[1] << 16 | (uint32_t)payload[2] << 8);
+	}
+}
+
+int OpenST2110SendSocket(const char* address, uint16_t port, int dscp)
+{
+	sockaddr_in	destination;
+	int			tos			= dscp << 2;
+	int			bufferSize	= kSocketBufferSize;
+	int			fd;
+
+	if (!ResolveAddress(address, port, destination))
+		return -1;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd == -1)
+		return -1;
+
+	// Best effort, the network may ignore the traffic class and the buffer size is capped by wmem_max
+	setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+	if (setsockopt(fd, SOL_SOCKET, SO_SNDBUFFORCE, &bufferSize, sizeof(bufferSize)) != 0)
+		setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+
+	if (IN_MULTICAST(ntohl(destination.sin_addr.s_addr)))
+	{
+		int ttl = kMulticastTTL;
+		setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+	}
+
+	if (connect(fd, (sockaddr*)&destination, sizeof(destination)) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int OpenST2110ReceiveSocket(const char* bindAddress, uint16_t port)
+{
+	sockaddr_in	local;
+	int			reuse		= 1;
+	int			bufferSize	= kSocketBufferSize;
+	bool		multicast	= false;
+	int			fd;
+
+	memset(&local, 0, sizeof(local));
+	local.sin_family		= AF_INET;
+	local.sin_addr.s_addr	= htonl(INADDR_ANY);
+	local.sin_port			= htons(port);
+
+	if (bindAddress != NULL)
+	{
+		if (!ResolveAddress(bindAddress, port, local))
+			return -1;
+		multicast = IN_MULTICAST(ntohl(local.sin_addr.s_addr));
+	}
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd == -1)
+		return -1;
+
+	// A frame of 1080p is over 5 MB of packets, the receive buffer must hold bursts of it
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &bufferSize, sizeof(bufferSize)) != 0)
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+
+	if (bind(fd, (sockaddr*)&local, sizeof(local)) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	if (multicast)
+	{
+		ip_mreq request;
+
+		request.imr_multiaddr			= local.sin_addr;
+		request.imr_interface.s_addr	= htonl(INADDR_ANY);
+		if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &request, sizeof(request)) != 0)
+		{
+			close(fd);
+			return -1;
+		}
+	}
+
+	return fd;
+}
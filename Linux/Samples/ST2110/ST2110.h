@@ -0,0 +1,154 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// SMPTE ST 2110 essence packing, shared by the ST 2110 sender and receiver.
+//
+// Video is ST 2110-20 (RFC 4175) YCbCr 4:2:2 10-bit, whose pixel groups (pgroups) of 2 pixels in
+// 5 bytes carry the samples Cb Y0 Cr Y1 big-endian.  These are the same samples in the same
+// order as v210 (bmdFormat10BitYUV), which packs 6 pixels in four little-endian 32-bit words, so
+// rows are converted without unpacking to planes.
+//
+// Every video packet carries one segment of a single line and all packets of a frame are the
+// same size, so a frame can be sent with UDP generic segmentation offload.  Packets are sized to
+// the largest whole fraction of a line that fits in kST2110MaxVideoPayload.  Interlaced frames are
+// sent as two fields, each with its own RTP timestamp and marker bit.
+//
+// Audio is ST 2110-30 (AES67) L16 or L24 PCM, converted from 16 or 32-bit DeckLink samples, with
+// a packet time of 1 ms or, when that would not fit in kST2110MaxAudioPayload, 125 us.
+
+static const uint8_t	kST2110VideoPayloadType		= 96;
+static const uint8_t	kST2110AudioPayloadType		= 97;
+static const uint32_t	kST2110VideoClockRate		= 90000;
+static const uint32_t	kST2110AudioClockRate		= 48000;
+
+static const uint32_t	kRTPHeaderSize				= 12;
+static const uint32_t	kST2110VideoHeaderSize		= kRTPHeaderSize + 8;	// Extended sequence number and one sample row data header
+static const uint32_t	kST2110MaxVideoPayload		= 1200;
+static const uint32_t	kST2110MaxAudioPayload		= 1440;
+static const uint32_t	kST2110PgroupBytes			= 5;
+static const uint32_t	kST2110PgroupPixels			= 2;
+
+// Differentiated services code points recommended by ST 2110-10
+static const int		kST2110VideoDSCP			= 34;		// AF41
+static const int		kST2110AudioDSCP			= 46;		// EF
+
+struct ST2110VideoPacket
+{
+	uint32_t	row;						// Row of the frame the segment is in
+	uint32_t	firstPixel;
+	uint8_t		field;						// 0 for progressive frames and the first field
+	bool		lastOfField;				// Packet has the RTP marker bit
+	uint8_t		rowHeader[6];				// Sample row data header, in network byte order
+};
+
+struct ST2110VideoLayout
+{
+	uint32_t	width;
+	uint32_t	height;
+	uint32_t	fieldCount;					// 2 for interlaced frames
+	uint32_t	firstFieldRow;				// 1 if the first field is the lower field
+	uint32_t	pgroupsPerPacket;
+	uint32_t	packetsPerRow;
+	uint32_t	packetCount;				// Packets per frame
+	uint32_t	payloadSize;				// Bytes of pgroups per packet
+	uint32_t	packetSize;					// RTP packet size, including headers
+	std::vector<ST2110VideoPacket>	packets;
+};
+
+struct ST2110AudioLayout
+{
+	uint32_t	channelCount;
+	uint32_t	sampleDepth;				// DeckLink sample depth, 16 or 32 bits
+	uint32_t	payloadSampleBytes;			// 2 for L16, 3 for L24
+	uint32_t	sampleFramesPerPacket;
+	uint32_t	payloadSize;
+	uint32_t	packetSize;
+	uint64_t	packetNanoseconds;
+};
+
+// Build the packet layout of a frame, returns false if the frame size can't be sent
+bool	GetST2110VideoLayout(uint32_t width, uint32_t height, bool interlaced, bool lowerFieldFirst, ST2110VideoLayout& layout);
+bool	GetST2110AudioLayout(uint32_t channelCount, uint32_t sampleDepth, ST2110AudioLayout& layout);
+
+// Convert pixelCount pixels from firstPixel of a v210 row to pgroups, and back.  Both must be even
+void	PackST2110Pgroups(const void* v210Row, uint32_t firstPixel, uint32_t pixelCount, uint8_t* pgroups);
+void	UnpackST2110Pgroups(const uint8_t* pgroups, uint32_t firstPixel, uint32_t pixelCount, void* v210Row);
+
+// Convert interleaved DeckLink audio samples to big-endian L16 or L24, and back
+void	PackST2110Audio(const ST2110AudioLayout& layout, const void* samples, uint32_t sampleFrameCount, uint8_t* payload);
+void	UnpackST2110Audio(const ST2110AudioLayout& layout, const uint8_t* payload, uint32_t sampleFrameCount, void* samples);
+
+// RTP fixed header, without CSRCs or extensions
+inline void WriteRTPHeader(uint8_t* packet, uint8_t payloadType, bool marker, uint16_t sequenceNumber, uint32_t timestamp, uint32_t ssrc)
+{
+	packet[0]	= 0x80;
+	packet[1]	= (marker ? 0x80 : 0) | payloadType;
+	packet[2]	= (uint8_t)(sequenceNumber >> 8);
+	packet[3]	= (uint8_t)sequenceNumber;
+	packet[4]	= (uint8_t)(timestamp >> 24);
+	packet[5]	= (uint8_t)(timestamp >> 16);
+	packet[6]	= (uint8_t)(timestamp >> 8);
+	packet[7]	= (uint8_t)timestamp;
+	packet[8]	= (uint8_t)(ssrc >> 24);
+	packet[9]	= (uint8_t)(ssrc >> 16);
+	packet[10]	= (uint8_t)(ssrc >> 8);
+	packet[11]	= (uint8_t)ssrc;
+}
+
+inline uint16_t ReadBigEndian16(const uint8_t* bytes)
+{
+	return (uint16_t)(bytes[0] << 8 | bytes[1]);
+}
+
+inline uint32_t ReadBigEndian32(const uint8_t* bytes)
+{
+	return (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 8 | bytes[3];
+}
+
+// Open a UDP socket connected to address:port for sending, or bound to port for receiving and
+// joining the group if bindAddress is multicast (NULL receives on any address).  Return -1 on
+// failure
+int		OpenST2110SendSocket(const char* address, uint16_t port, int dscp);
+int		OpenST2110ReceiveSocket(const char* bindAddress, uint16_t port);
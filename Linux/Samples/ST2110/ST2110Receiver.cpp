@@ -0,0 +1,497 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "ST2110Receiver.h"
+
+namespace
+{
+	const uint32_t	kControlBytes	= CMSG_SPACE(sizeof(int));
+
+	double GetThreadCPUSeconds(void)
+	{
+		struct timespec cpuTime;
+
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuTime);
+		return cpuTime.tv_sec + cpuTime.tv_nsec / 1e9;
+	}
+
+	// Size of the RTP header including CSRCs and any extension, and the payload length without
+	// padding.  Returns false if the packet is not RTP
+	bool ParseRTPHeader(const uint8_t* packet, uint32_t& length, uint8_t payloadType, uint32_t& headerSize)
+	{
+		if (length < kRTPHeaderSize || (packet[0] >> 6) != 2 || (packet[1] & 0x7F) != payloadType)
+			return false;
+
+		headerSize = kRTPHeaderSize + 4 * (packet[0] & 0x0F);
+
+		if (packet[0] & 0x10)
+		{
+			if (length < headerSize + 4)
+				return false;
+			headerSize += 4 + 4 * ReadBigEndian16(packet + headerSize + 2);
+		}
+
+		if (packet[0] & 0x20)
+		{
+			if (packet[length - 1] > length)
+				return false;
+			length -= packet[length - 1];
+		}
+
+		return headerSize <= length;
+	}
+}
+
+ST2110Receiver::ST2110Receiver() :
+	m_videoSocket(-1),
+	m_audioSocket(-1),
+	m_callback(NULL),
+	m_width(0),
+	m_height(0),
+	m_rowBytes(0),
+	m_fieldCount(1),
+	m_firstFieldRow(0),
+	m_haveVideoSequence(false),
+	m_lastVideoSequence(0),
+	m_haveAudioSequence(false),
+	m_lastAudioSequence(0),
+	m_frameActive(false),
+	m_frameBytes(NULL),
+	m_frameContext(NULL),
+	m_frameTimestamp(0),
+	m_fieldTimestamp(0),
+	m_frameField(0),
+	m_framePackets(0),
+	m_framePacketLost(false),
+	m_closing(false)
+{
+	memset(&m_audioLayout, 0, sizeof(m_audioLayout));
+	memset(&m_statistics, 0, sizeof(m_statistics));
+	memset(&m_publishedStatistics, 0, sizeof(m_publishedStatistics));
+}
+
+ST2110Receiver::~ST2110Receiver()
+{
+	Close();
+}
+
+bool ST2110Receiver::Open(const char* bindAddress, uint16_t videoPort, uint16_t audioPort, uint32_t width, uint32_t height, uint32_t rowBytes, bool interlaced, bool lowerFieldFirst, uint32_t audioChannelCount, uint32_t audioSampleDepth, ST2110ReceiverCallback* callback)
+{
+	int receiveOffload = 1;
+
+	if (IsOpen() || callback == NULL || width == 0 || height == 0)
+		return false;
+
+	if (audioPort != 0 && !GetST2110AudioLayout(audioChannelCount, audioSampleDepth, m_audioLayout))
+		return false;
+
+	m_videoSocket = OpenST2110ReceiveSocket(bindAddress, videoPort);
+	if (m_videoSocket == -1)
+		return false;
+
+	if (audioPort != 0)
+	{
+		m_audioSocket = OpenST2110ReceiveSocket(bindAddress, audioPort);
+		if (m_audioSocket == -1)
+		{
+			close(m_videoSocket);
+			m_videoSocket = -1;
+			return false;
+		}
+	}
+
+	memset(&m_statistics, 0, sizeof(m_statistics));
+	m_statistics.receiveOffload = (setsockopt(m_videoSocket, SOL_UDP, UDP_GRO, &receiveOffload, sizeof(receiveOffload)) == 0);
+	m_publishedStatistics = m_statistics;
+
+	m_callback			= callback;
+	m_width				= width;
+	m_height			= height;
+	m_rowBytes			= rowBytes;
+	m_fieldCount		= interlaced ? 2 : 1;
+	m_firstFieldRow		= (interlaced && lowerFieldFirst) ? 1 : 0;
+	m_haveVideoSequence	= false;
+	m_haveAudioSequence	= false;
+	m_frameActive		= false;
+	m_frameBytes		= NULL;
+	m_closing			= false;
+
+	m_messageBuffers.resize(kReceiveBatchMessages * kMaxMessageBytes);
+	m_controlBuffers.resize(kReceiveBatchMessages * kControlBytes);
+	m_audioSamples.resize(kMaxMessageBytes / 2);
+
+	m_receiverThread = std::thread(&ST2110Receiver::ReceiverThread, this);
+	return true;
+}
+
+void ST2110Receiver::Close(void)
+{
+	if (!IsOpen())
+		return;
+
+	m_closing = true;
+	m_receiverThread.join();
+
+	close(m_videoSocket);
+	m_videoSocket = -1;
+
+	if (m_audioSocket != -1)
+	{
+		close(m_audioSocket);
+		m_audioSocket = -1;
+	}
+}
+
+void ST2110Receiver::GetStatistics(ST2110ReceiverStatistics& statistics)
+{
+	std::lock_guard<std::mutex> lock(m_statisticsMutex);
+	statistics = m_publishedStatistics;
+}
+
+void ST2110Receiver::ReceiverThread(void)
+{
+	struct pollfd	fds[2];
+	nfds_t			fdCount = (m_audioSocket != -1) ? 2 : 1;
+
+	fds[0].fd		= m_videoSocket;
+	fds[0].events	= POLLIN;
+	fds[1].fd		= m_audioSocket;
+	fds[1].events	= POLLIN;
+
+	while (!m_closing)
+	{
+		if (poll(fds, fdCount, kPollMilliseconds) > 0)
+		{
+			if (fds[0].revents & POLLIN)
+				ReceiveVideo();
+			if (fdCount > 1 && (fds[1].revents & POLLIN))
+				ReceiveAudio();
+		}
+
+		m_statistics.cpuSeconds = GetThreadCPUSeconds();
+
+		std::lock_guard<std::mutex> lock(m_statisticsMutex);
+		m_publishedStatistics = m_statistics;
+	}
+
+	// Give back the buffer of a frame in progress
+	if (m_frameActive)
+		FinishFrame(false);
+
+	std::lock_guard<std::mutex> lock(m_statisticsMutex);
+	m_publishedStatistics = m_statistics;
+}
+
+void ST2110Receiver::ReceiveVideo(void)
+{
+	struct mmsghdr	messages[kReceiveBatchMessages];
+	struct iovec	iovecs[kReceiveBatchMessages];
+	int				messageCount;
+
+	memset(messages, 0, sizeof(messages));
+
+	for (uint32_t i = 0; i < kReceiveBatchMessages; i++)
+	{
+		iovecs[i].iov_base					= &m_messageBuffers[i * kMaxMessageBytes];
+		iovecs[i].iov_len					= kMaxMessageBytes;
+		messages[i].msg_hdr.msg_iov			= &iovecs[i];
+		messages[i].msg_hdr.msg_iovlen		= 1;
+		messages[i].msg_hdr.msg_control		= &m_controlBuffers[i * kControlBytes];
+	}
+
+	do
+	{
+		for (uint32_t i = 0; i < kReceiveBatchMessages; i++)
+			messages[i].msg_hdr.msg_controllen = kControlBytes;
+
+		messageCount = recvmmsg(m_videoSocket, messages, kReceiveBatchMessages, MSG_DONTWAIT, NULL);
+		if (messageCount <= 0)
+			break;
+
+		m_statistics.receiveCalls++;
+
+		for (int i = 0; i < messageCount; i++)
+		{
+			const uint8_t*	message		= (const uint8_t*)iovecs[i].iov_base;
+			uint32_t		length		= messages[i].msg_len;
+			uint32_t		segmentSize	= length;
+
+			// With receive offload, a message holds consecutive same-size datagrams from one sender
+			for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&messages[i].msg_hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(&messages[i].msg_hdr, cmsg))
+			{
+				if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+					memcpy(&segmentSize, CMSG_DATA(cmsg), sizeof(int));
+			}
+
+			if (segmentSize == 0)
+				continue;
+
+			for (uint32_t offset = 0; offset < length; offset += segmentSize)
+				HandleVideoPacket(message + offset, std::min(segmentSize, length - offset));
+		}
+	}
+	while (messageCount == (int)kReceiveBatchMessages && !m_closing);
+}
+
+void ST2110Receiver::ReceiveAudio(void)
+{
+	struct mmsghdr	messages[kReceiveBatchMessages];
+	struct iovec	iovecs[kReceiveBatchMessages];
+	int				messageCount;
+
+	memset(messages, 0, sizeof(messages));
+
+	for (uint32_t i = 0; i < kReceiveBatchMessages; i++)
+	{
+		iovecs[i].iov_base				= &m_messageBuffers[i * kMaxMessageBytes];
+		iovecs[i].iov_len				= kMaxMessageBytes;
+		messages[i].msg_hdr.msg_iov		= &iovecs[i];
+		messages[i].msg_hdr.msg_iovlen	= 1;
+	}
+
+	do
+	{
+		messageCount = recvmmsg(m_audioSocket, messages, kReceiveBatchMessages, MSG_DONTWAIT, NULL);
+		if (messageCount <= 0)
+			break;
+
+		m_statistics.receiveCalls++;
+
+		for (int i = 0; i < messageCount; i++)
+			HandleAudioPacket((const uint8_t*)iovecs[i].iov_base, messages[i].msg_len);
+	}
+	while (messageCount == (int)kReceiveBatchMessages && !m_closing);
+}
+
+void ST2110Receiver::HandleVideoPacket(const uint8_t* packet, uint32_t length)
+{
+	uint32_t		headerSize;
+	uint32_t		sequence;
+	uint32_t		timestamp;
+	uint32_t		field;
+	int32_t			gap		= 0;
+	bool			marker;
+	const uint8_t*	rowHeader;
+	const uint8_t*	rowHeadersEnd;
+	const uint8_t*	payload;
+	const uint8_t*	end;
+
+	if (!ParseRTPHeader(packet, length, kST2110VideoPayloadType, headerSize) || length < headerSize + 2 + 6)
+	{
+		m_statistics.packetsInvalid++;
+		return;
+	}
+
+	m_statistics.videoPackets++;
+	m_statistics.bytesReceived += length;
+
+	marker		= (packet[1] & 0x80) != 0;
+	timestamp	= ReadBigEndian32(packet + 4);
+	sequence	= (uint32_t)ReadBigEndian16(packet + headerSize) << 16 | ReadBigEndian16(packet + 2);
+	rowHeader	= packet + headerSize + 2;
+	field		= rowHeader[2] >> 7;
+
+	if (m_haveVideoSequence)
+	{
+		gap = (int32_t)(sequence - m_lastVideoSequence - 1);
+		if (gap < 0)
+		{
+			// Late or duplicated, only used if its frame is still being received
+			m_statistics.packetsOutOfOrder++;
+			if (!m_frameActive || timestamp != m_fieldTimestamp)
+				return;
+		}
+		else
+		{
+			m_statistics.videoPacketsLost += gap;
+			m_lastVideoSequence = sequence;
+		}
+	}
+	else
+	{
+		m_haveVideoSequence = true;
+		m_lastVideoSequence = sequence;
+	}
+
+	if (!m_frameActive)
+	{
+		StartFrame(timestamp, field);
+	}
+	else if (timestamp != m_fieldTimestamp)
+	{
+		if (m_fieldCount == 2 && field == 1 && m_frameField == 0)
+		{
+			m_fieldTimestamp	= timestamp;
+			m_frameField		= 1;
+		}
+		else
+		{
+			// The marker of the previous frame was lost
+			FinishFrame(false);
+			StartFrame(timestamp, field);
+		}
+	}
+
+	// Packets missing before this one belong to this frame, or the previous frame's marker was
+	// lost and it has already been finished incomplete
+	if (gap > 0)
+		m_framePacketLost = true;
+
+	m_framePackets++;
+
+	// The row data headers are followed by their segments, the continuation bit of the offset
+	// is set on all headers but the last
+	end				= packet + length;
+	rowHeadersEnd	= rowHeader;
+	do
+	{
+		rowHeadersEnd += 6;
+	}
+	while ((rowHeadersEnd[-2] & 0x80) && rowHeadersEnd + 6 <= end);
+	payload = rowHeadersEnd;
+
+	if (m_frameBytes != NULL)
+	{
+		for (; rowHeader < rowHeadersEnd; rowHeader += 6)
+		{
+			uint32_t	segmentLength	= ReadBigEndian16(rowHeader);
+			uint32_t	segmentField	= rowHeader[2] >> 7;
+			uint32_t	line			= ReadBigEndian16(rowHeader + 2) & 0x7FFF;
+			uint32_t	offset			= ReadBigEndian16(rowHeader + 4) & 0x7FFF;
+			uint32_t	pixels			= segmentLength / kST2110PgroupBytes * kST2110PgroupPixels;
+			uint32_t	row				= (m_fieldCount == 1) ? line : line * 2 + (segmentField == 0 ? m_firstFieldRow : 1 - m_firstFieldRow);
+
+			if (segmentLength % kST2110PgroupBytes != 0 || payload + segmentLength > end || row >= m_height || offset + pixels > m_width)
+			{
+				m_statistics.packetsInvalid++;
+				break;
+			}
+
+			UnpackST2110Pgroups(payload, offset, pixels, m_frameBytes + row * m_rowBytes);
+			payload += segmentLength;
+		}
+	}
+
+	if (marker && (m_fieldCount == 1 || field == 1))
+		FinishFrame(true);
+}
+
+void ST2110Receiver::HandleAudioPacket(const uint8_t* packet, uint32_t length)
+{
+	uint32_t	headerSize;
+	uint16_t	sequence;
+	uint32_t	bytesPerSampleFrame = m_audioLayout.channelCount * m_audioLayout.payloadSampleBytes;
+	uint32_t	sampleFrameCount;
+
+	if (!ParseRTPHeader(packet, length, kST2110AudioPayloadType, headerSize) || length == headerSize)
+	{
+		m_statistics.packetsInvalid++;
+		return;
+	}
+
+	m_statistics.audioPackets++;
+	m_statistics.bytesReceived += length;
+
+	sequence = ReadBigEndian16(packet + 2);
+	if (m_haveAudioSequence)
+	{
+		uint16_t gap = (uint16_t)(sequence - m_lastAudioSequence - 1);
+
+		if (gap >= 0x8000)
+		{
+			// Too late to be played in order
+			m_statistics.packetsOutOfOrder++;
+			return;
+		}
+
+		m_statistics.audioPacketsLost += gap;
+	}
+	m_haveAudioSequence	= true;
+	m_lastAudioSequence	= sequence;
+
+	sampleFrameCount = (length - headerSize) / bytesPerSampleFrame;
+	UnpackST2110Audio(m_audioLayout, packet + headerSize, sampleFrameCount, m_audioSamples.data());
+	m_callback->AudioReceived(m_audioSamples.data(), sampleFrameCount, ReadBigEndian32(packet + 4));
+}
+
+void ST2110Receiver::StartFrame(uint32_t timestamp, uint32_t field)
+{
+	m_frameActive		= true;
+	m_frameTimestamp	= timestamp;
+	m_fieldTimestamp	= timestamp;
+	m_frameField		= field;
+	m_framePackets		= 0;
+	m_framePacketLost	= false;
+
+	m_frameBytes = (uint8_t*)m_callback->AcquireFrameBuffer(&m_frameContext);
+	if (m_frameBytes == NULL)
+		m_statistics.framesDropped++;
+}
+
+void ST2110Receiver::FinishFrame(bool markerReceived)
+{
+	if (m_frameBytes != NULL)
+	{
+		ST2110ReceivedFrame frame;
+
+		frame.videoTimestamp	= m_frameTimestamp;
+		frame.packetCount		= m_framePackets;
+		frame.complete			= markerReceived && !m_framePacketLost;
+
+		m_statistics.framesReceived++;
+		if (!frame.complete)
+			m_statistics.framesIncomplete++;
+
+		m_callback->FrameReceived(m_frameContext, frame);
+	}
+
+	m_frameActive	= false;
+	m_frameBytes	= NULL;
+	m_frameContext	= NULL;
+}
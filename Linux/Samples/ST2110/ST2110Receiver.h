@@ -0,0 +1,157 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+#include "ST2110.h"
+
+// Receives ST 2110-20 video into v210 frame buffers and ST 2110-30 audio into DeckLink samples,
+// sent by ST2110Sender or any sender of the same formats, from a dedicated thread.
+//
+// Packets are received in batches with recvmmsg, with UDP generic receive offload so a batch of
+// segments from one sender arrives as one message.  Each segment is converted straight into the
+// frame buffer the callback provides, at the line and offset in its header, so packets may
+// arrive in any order within a frame.  A frame is complete when the marker of its last field is
+// received with no sequence number missing since the previous frame.  A frame whose marker was
+// lost is delivered, incomplete, when the next frame starts.
+
+struct ST2110ReceivedFrame
+{
+	uint32_t	videoTimestamp;				// RTP timestamp of the first field
+	uint32_t	packetCount;
+	bool		complete;
+};
+
+struct ST2110ReceiverStatistics
+{
+	uint64_t	framesReceived;
+	uint64_t	framesIncomplete;
+	uint64_t	framesDropped;				// No frame buffer was available
+	uint64_t	videoPackets;
+	uint64_t	videoPacketsLost;
+	uint64_t	audioPackets;
+	uint64_t	audioPacketsLost;
+	uint64_t	packetsOutOfOrder;
+	uint64_t	packetsInvalid;				// Not RTP, wrong payload type or outside the frame
+	uint64_t	bytesReceived;				// RTP packet bytes
+	uint64_t	receiveCalls;
+	double		cpuSeconds;					// CPU time of the receive thread
+	bool		receiveOffload;
+};
+
+class ST2110ReceiverCallback
+{
+public:
+	virtual ~ST2110ReceiverCallback() {}
+
+	// Return a v210 buffer for the next frame and a context passed back with it, or NULL to drop
+	// the frame.  Rows the frame's packets don't cover are left as they are
+	virtual void*	AcquireFrameBuffer(void** context) = 0;
+	virtual void	FrameReceived(void* context, const ST2110ReceivedFrame& frame) = 0;
+	virtual void	AudioReceived(const void* samples, uint32_t sampleFrameCount, uint32_t timestamp) = 0;
+};
+
+class ST2110Receiver
+{
+public:
+	ST2110Receiver();
+	virtual ~ST2110Receiver();
+
+	// Audio is received on audioPort, or not at all if it is 0
+	bool	Open(const char* bindAddress, uint16_t videoPort, uint16_t audioPort, uint32_t width, uint32_t height, uint32_t rowBytes, bool interlaced, bool lowerFieldFirst, uint32_t audioChannelCount, uint32_t audioSampleDepth, ST2110ReceiverCallback* callback);
+	void	Close(void);
+	bool	IsOpen(void) const { return m_videoSocket != -1; }
+
+	void	GetStatistics(ST2110ReceiverStatistics& statistics);
+
+private:
+	static const uint32_t	kReceiveBatchMessages	= 32;
+	static const uint32_t	kMaxMessageBytes		= 65536;
+	static const int		kPollMilliseconds		= 100;
+
+	void	ReceiverThread(void);
+	void	ReceiveVideo(void);
+	void	ReceiveAudio(void);
+	void	HandleVideoPacket(const uint8_t* packet, uint32_t length);
+	void	HandleAudioPacket(const uint8_t* packet, uint32_t length);
+	void	StartFrame(uint32_t timestamp, uint32_t field);
+	void	FinishFrame(bool markerReceived);
+
+	int						m_videoSocket;
+	int						m_audioSocket;
+	ST2110ReceiverCallback*	m_callback;
+	uint32_t				m_width;
+	uint32_t				m_height;
+	uint32_t				m_rowBytes;
+	uint32_t				m_fieldCount;
+	uint32_t				m_firstFieldRow;
+	ST2110AudioLayout		m_audioLayout;
+	//
+	std::vector<uint8_t>	m_messageBuffers;
+	std::vector<uint8_t>	m_controlBuffers;
+	std::vector<int32_t>	m_audioSamples;
+	//
+	bool					m_haveVideoSequence;
+	uint32_t				m_lastVideoSequence;
+	bool					m_haveAudioSequence;
+	uint16_t				m_lastAudioSequence;
+	//
+	bool					m_frameActive;
+	uint8_t*				m_frameBytes;				// NULL if the frame is being dropped
+	void*					m_frameContext;
+	uint32_t				m_frameTimestamp;
+	uint32_t				m_fieldTimestamp;
+	uint32_t				m_frameField;
+	uint32_t				m_framePackets;
+	bool					m_framePacketLost;
+	//
+	std::thread				m_receiverThread;
+	std::atomic<bool>		m_closing;
+	//
+	// Statistics are updated by the receive thread and published once per batch
+	ST2110ReceiverStatistics	m_statistics;
+	std::mutex				m_statisticsMutex;
+	ST2110ReceiverStatistics	m_publishedStatistics;
+};
@@ -0,0 +1,553 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <random>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "ST2110Sender.h"
+
+namespace
+{
+	// Largest UDP payload of an IPv4 datagram, the limit of a segmentation offload message
+	const uint32_t	kMaxSegmentedMessageBytes	= 65507;
+
+	uint64_t GetMonotonicNanoseconds(void)
+	{
+		struct timespec now;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+	}
+
+	void SleepUntil(uint64_t nanoseconds)
+	{
+		struct timespec wakeTime;
+
+		wakeTime.tv_sec		= nanoseconds / 1000000000ULL;
+		wakeTime.tv_nsec	= nanoseconds % 1000000000ULL;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeTime, NULL) == EINTR)
+			;
+	}
+
+	double GetThreadCPUSeconds(void)
+	{
+		struct timespec cpuTime;
+
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuTime);
+		return cpuTime.tv_sec + cpuTime.tv_nsec / 1e9;
+	}
+}
+
+const uint32_t	ST2110Sender::kMaxBatchPackets;
+const uint32_t	ST2110Sender::kMaxSegmentsPerMessage;
+const uint64_t	ST2110Sender::kMinPacingInterval;
+
+ST2110Sender::ST2110Sender() :
+	m_videoSocket(-1),
+	m_audioSocket(-1),
+	m_paced(false),
+	m_ssrc(0),
+	m_segmentsPerMessage(1),
+	m_videoSequence(0),
+	m_audioPendingFrames(0),
+	m_audioPendingTimestamp(0),
+	m_audioPacketCount(0),
+	m_audioPacketsSent(0),
+	m_audioStartTime(0),
+	m_audioSequence(0),
+	m_queueHead(0),
+	m_queuedFrames(0),
+	m_closing(false)
+{
+	m_videoLayout.width		= 0;
+	m_videoLayout.height	= 0;
+	memset(&m_audioLayout, 0, sizeof(m_audioLayout));
+	memset(&m_statistics, 0, sizeof(m_statistics));
+}
+
+ST2110Sender::~ST2110Sender()
+{
+	Close();
+}
+
+bool ST2110Sender::Open(const char* address, uint16_t videoPort, uint16_t audioPort, uint32_t audioChannelCount, uint32_t audioSampleDepth, uint32_t queueDepth, bool paced)
+{
+	std::random_device	random;
+
+	if (IsOpen() || queueDepth == 0)
+		return false;
+
+	if (audioPort != 0 && !GetST2110AudioLayout(audioChannelCount, audioSampleDepth, m_audioLayout))
+		return false;
+
+	m_videoSocket = OpenST2110SendSocket(address, videoPort, kST2110VideoDSCP);
+	if (m_videoSocket == -1)
+		return false;
+
+	if (audioPort != 0)
+	{
+		m_audioSocket = OpenST2110SendSocket(address, audioPort, kST2110AudioDSCP);
+		if (m_audioSocket == -1)
+		{
+			close(m_videoSocket);
+			m_videoSocket = -1;
+			return false;
+		}
+	}
+
+	// RFC 3550 random SSRC and initial sequence numbers
+	m_ssrc					= random();
+	m_videoSequence			= random();
+	m_audioSequence			= (uint16_t)random();
+	m_paced					= paced;
+	m_videoLayout.width		= 0;
+	m_audioPendingFrames	= 0;
+
+	m_queue.resize(queueDepth);
+	m_queueHead		= 0;
+	m_queuedFrames	= 0;
+	m_closing		= false;
+
+	memset(&m_statistics, 0, sizeof(m_statistics));
+	m_statistics.queueDepth = queueDepth;
+
+	m_senderThread = std::thread(&ST2110Sender::SenderThread, this);
+	return true;
+}
+
+void ST2110Sender::Close(void)
+{
+	if (!IsOpen())
+		return;
+
+	// Queued frames are sent before the thread exits
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_closing = true;
+	}
+	m_queueCondition.notify_one();
+	m_senderThread.join();
+
+	close(m_videoSocket);
+	m_videoSocket = -1;
+
+	if (m_audioSocket != -1)
+	{
+		close(m_audioSocket);
+		m_audioSocket = -1;
+	}
+}
+
+bool ST2110Sender::SendFrame(const ST2110SenderFrame& frame)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_closing || m_queuedFrames == m_queue.size())
+	{
+		m_statistics.framesDropped++;
+		return false;
+	}
+
+	if (frame.videoOwner)
+		frame.videoOwner->AddRef();
+	if (frame.audioOwner)
+		frame.audioOwner->AddRef();
+
+	m_queue[(m_queueHead + m_queuedFrames) % m_queue.size()] = frame;
+	m_queuedFrames++;
+	m_statistics.peakQueuedFrames = std::max(m_statistics.peakQueuedFrames, m_queuedFrames);
+
+	m_queueCondition.notify_one();
+	return true;
+}
+
+uint32_t ST2110Sender::GetQueuedFrames(void)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_queuedFrames;
+}
+
+void ST2110Sender::GetStatistics(ST2110SenderStatistics& statistics)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	statistics = m_statistics;
+}
+
+void ST2110Sender::SenderThread(void)
+{
+	while (true)
+	{
+		ST2110SenderFrame frame;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			m_queueCondition.wait(lock, [this] { return m_queuedFrames > 0 || m_closing; });
+			if (m_queuedFrames == 0)
+				break;
+
+			frame = m_queue[m_queueHead];
+		}
+
+		// The frame keeps its place in the queue until it is sent, so the queue depth bounds
+		// the frames held from the driver
+		SendQueuedFrame(frame);
+		ReleaseFrame(frame);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_queueHead = (m_queueHead + 1) % m_queue.size();
+			m_queuedFrames--;
+			m_statistics.cpuSeconds = GetThreadCPUSeconds();
+		}
+	}
+}
+
+void ST2110Sender::SendQueuedFrame(const ST2110SenderFrame& frame)
+{
+	uint64_t	startTime;
+	uint64_t	packetInterval	= 0;
+	uint32_t	batchPackets	= kMaxBatchPackets;
+	uint32_t	packetCount;
+
+	if (!SetVideoLayout(frame))
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_statistics.framesUnsupported++;
+		return;
+	}
+
+	m_audioPacketCount	= 0;
+	m_audioPacketsSent	= 0;
+	if (m_audioSocket != -1 && frame.audioBytes != NULL)
+		PacketizeAudio(frame);
+
+	packetCount		= m_videoLayout.packetCount;
+	startTime		= GetMonotonicNanoseconds();
+	m_audioStartTime = startTime;
+
+	if (m_paced)
+	{
+		packetInterval	= frame.frameNanoseconds / packetCount;
+		batchPackets	= (uint32_t)std::min<uint64_t>(kMaxBatchPackets, packetInterval ? (kMinPacingInterval + packetInterval - 1) / packetInterval : kMaxBatchPackets);
+	}
+
+	for (uint32_t firstPacket = 0; firstPacket < packetCount; firstPacket += batchPackets)
+	{
+		uint32_t count = std::min(batchPackets, packetCount - firstPacket);
+
+		if (m_paced)
+		{
+			uint64_t dueTime	= startTime + firstPacket * packetInterval;
+			uint64_t now		= GetMonotonicNanoseconds();
+
+			SendAudioPackets(dueTime);
+
+			if (now < dueTime)
+			{
+				SleepUntil(dueTime);
+			}
+			else if (now - dueTime > batchPackets * packetInterval)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_statistics.lateBatches++;
+			}
+		}
+
+		// Converted just before sending, so the packets are still in cache
+		PacketizeVideo(frame, firstPacket, count);
+		SendVideoPackets(0, count);
+	}
+
+	// Any audio due after the last video batch
+	if (m_paced)
+	{
+		while (m_audioPacketsSent < m_audioPacketCount)
+		{
+			uint64_t dueTime = startTime + m_audioPacketsSent * m_audioLayout.packetNanoseconds;
+
+			SleepUntil(dueTime);
+			SendAudioPackets(dueTime);
+		}
+	}
+	else
+	{
+		SendAudioPackets(UINT64_MAX);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_statistics.framesSent++;
+}
+
+bool ST2110Sender::SetVideoLayout(const ST2110SenderFrame& frame)
+{
+	int segmentSize;
+
+	if (m_videoLayout.width == frame.width && m_videoLayout.height == frame.height &&
+		m_videoLayout.fieldCount == (frame.interlaced ? 2u : 1u) && m_videoLayout.firstFieldRow == ((frame.interlaced && frame.lowerFieldFirst) ? 1u : 0u))
+		return true;
+
+	if (!GetST2110VideoLayout(frame.width, frame.height, frame.interlaced, frame.lowerFieldFirst, m_videoLayout))
+	{
+		m_videoLayout.width = 0;
+		return false;
+	}
+
+	// Packets are all the same size, so a batch can be segmented by the kernel
+	segmentSize				= m_videoLayout.packetSize;
+	m_segmentsPerMessage	= std::min(kMaxSegmentsPerMessage, kMaxSegmentedMessageBytes / m_videoLayout.packetSize);
+	if (m_segmentsPerMessage < 2 || setsockopt(m_videoSocket, SOL_UDP, UDP_SEGMENT, &segmentSize, sizeof(segmentSize)) != 0)
+		m_segmentsPerMessage = 1;
+
+	m_videoPackets.resize(kMaxBatchPackets * m_videoLayout.packetSize);
+
+	// The payload type and SSRC never change, the rest is written per packet
+	memset(m_videoHeaderTemplate, 0, sizeof(m_videoHeaderTemplate));
+	WriteRTPHeader(m_videoHeaderTemplate, kST2110VideoPayloadType, false, 0, 0, m_ssrc);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_statistics.segmentationOffload = (m_segmentsPerMessage > 1);
+	return true;
+}
+
+void ST2110Sender::PacketizeAudio(const ST2110SenderFrame& frame)
+{
+	uint32_t	bytesPerSampleFrame = m_audioLayout.channelCount * m_audioLayout.payloadSampleBytes;
+	uint32_t	pendingFrames;
+	uint8_t*	packet;
+
+	// A partial packet left from a discontinuous packet is discarded
+	if (m_audioPendingFrames > 0 && frame.audioTimestamp != m_audioPendingTimestamp + m_audioPendingFrames)
+		m_audioPendingFrames = 0;
+
+	if (m_audioPendingFrames == 0)
+		m_audioPendingTimestamp = frame.audioTimestamp;
+
+	pendingFrames = m_audioPendingFrames + frame.audioSampleFrameCount;
+	if (m_audioPending.size() < pendingFrames * bytesPerSampleFrame)
+		m_audioPending.resize(pendingFrames * bytesPerSampleFrame);
+
+	PackST2110Audio(m_audioLayout, frame.audioBytes, frame.audioSampleFrameCount, &m_audioPending[m_audioPendingFrames * bytesPerSampleFrame]);
+
+	m_audioPacketCount = pendingFrames / m_audioLayout.sampleFramesPerPacket;
+	if (m_audioPackets.size() < m_audioPacketCount * m_audioLayout.packetSize)
+		m_audioPackets.resize(m_audioPacketCount * m_audioLayout.packetSize);
+
+	packet = m_audioPackets.data();
+	for (uint32_t i = 0; i < m_audioPacketCount; i++, packet += m_audioLayout.packetSize)
+	{
+		WriteRTPHeader(packet, kST2110AudioPayloadType, false, m_audioSequence++, m_audioPendingTimestamp + i * m_audioLayout.sampleFramesPerPacket, m_ssrc);
+		memcpy(packet + kRTPHeaderSize, &m_audioPending[i * m_audioLayout.payloadSize], m_audioLayout.payloadSize);
+	}
+
+	// Keep the remainder for the next frame's first packet
+	uint32_t packetizedFrames = m_audioPacketCount * m_audioLayout.sampleFramesPerPacket;
+
+	m_audioPendingFrames = pendingFrames - packetizedFrames;
+	m_audioPendingTimestamp += packetizedFrames;
+	memmove(m_audioPending.data(), &m_audioPending[packetizedFrames * bytesPerSampleFrame], m_audioPendingFrames * bytesPerSampleFrame);
+}
+
+void ST2110Sender::PacketizeVideo(const ST2110SenderFrame& frame, uint32_t firstPacket, uint32_t packetCount)
+{
+	const uint8_t*	videoBytes				= (const uint8_t*)frame.videoBytes;
+	uint32_t		fieldTimestampOffset	= (uint32_t)(frame.frameNanoseconds * kST2110VideoClockRate / 2000000000ULL);
+	uint32_t		pixelsPerPacket			= m_videoLayout.pgroupsPerPacket * kST2110PgroupPixels;
+	uint8_t*		packet					= m_videoPackets.data();
+
+	for (uint32_t i = firstPacket; i < firstPacket + packetCount; i++, packet += m_videoLayout.packetSize)
+	{
+		const ST2110VideoPacket&	info		= m_videoLayout.packets[i];
+		uint32_t					sequence	= m_videoSequence++;
+		uint32_t					timestamp	= frame.videoTimestamp + info.field * fieldTimestampOffset;
+
+		memcpy(packet, m_videoHeaderTemplate, kST2110VideoHeaderSize);
+		if (info.lastOfField)
+			packet[1] |= 0x80;
+
+		packet[2]	= (uint8_t)(sequence >> 8);
+		packet[3]	= (uint8_t)sequence;
+		packet[4]	= (uint8_t)(timestamp >> 24);
+		packet[5]	= (uint8_t)(timestamp >> 16);
+		packet[6]	= (uint8_t)(timestamp >> 8);
+		packet[7]	= (uint8_t)timestamp;
+		packet[12]	= (uint8_t)(sequence >> 24);
+		packet[13]	= (uint8_t)(sequence >> 16);
+		memcpy(packet + kRTPHeaderSize + 2, info.rowHeader, sizeof(info.rowHeader));
+
+		PackST2110Pgroups(videoBytes + info.row * frame.rowBytes, info.firstPixel, pixelsPerPacket, packet + kST2110VideoHeaderSize);
+	}
+}
+
+void ST2110Sender::SendVideoPackets(uint32_t firstPacket, uint32_t endPacket)
+{
+	struct mmsghdr	messages[kMaxBatchPackets];
+	struct iovec	iovecs[kMaxBatchPackets];
+	uint32_t		segmentsPerMessage	= m_segmentsPerMessage;
+	uint32_t		messageCount		= 0;
+	uint32_t		messagesSent		= 0;
+	uint32_t		packetsSent;
+	uint64_t		sendCalls			= 0;
+	uint64_t		sendErrors			= 0;
+
+	memset(messages, 0, sizeof(messages));
+
+	for (uint32_t packet = firstPacket; packet < endPacket; packet += segmentsPerMessage, messageCount++)
+	{
+		iovecs[messageCount].iov_base	= &m_videoPackets[packet * m_videoLayout.packetSize];
+		iovecs[messageCount].iov_len	= std::min(segmentsPerMessage, endPacket - packet) * m_videoLayout.packetSize;
+		messages[messageCount].msg_hdr.msg_iov		= &iovecs[messageCount];
+		messages[messageCount].msg_hdr.msg_iovlen	= 1;
+	}
+
+	while (messagesSent < messageCount)
+	{
+		int result = sendmmsg(m_videoSocket, messages + messagesSent, messageCount - messagesSent, 0);
+
+		sendCalls++;
+		if (result >= 0)
+		{
+			messagesSent += result;
+			continue;
+		}
+
+		if (errno == EINTR)
+			continue;
+
+		// The route can't segment the messages, send the remaining packets one per message
+		if (segmentsPerMessage > 1 && (errno == EIO || errno == EINVAL || errno == EMSGSIZE))
+		{
+			int noSegmentation = 0;
+
+			setsockopt(m_videoSocket, SOL_UDP, UDP_SEGMENT, &noSegmentation, sizeof(noSegmentation));
+			m_segmentsPerMessage = 1;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_statistics.segmentationOffload = false;
+			}
+
+			SendVideoPackets(firstPacket + messagesSent * segmentsPerMessage, endPacket);
+			endPacket = firstPacket + messagesSent * segmentsPerMessage;
+			break;
+		}
+
+		sendErrors++;
+		break;
+	}
+
+	packetsSent = std::min(endPacket, firstPacket + messagesSent * segmentsPerMessage) - firstPacket;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_statistics.videoPackets	+= packetsSent;
+	m_statistics.bytesSent		+= (uint64_t)packetsSent * m_videoLayout.packetSize;
+	m_statistics.sendCalls		+= sendCalls;
+	m_statistics.sendErrors		+= sendErrors;
+}
+
+void ST2110Sender::SendAudioPackets(uint64_t dueTime)
+{
+	struct mmsghdr	messages[kMaxBatchPackets];
+	struct iovec	iovecs[kMaxBatchPackets];
+	uint64_t		packetsSent	= 0;
+	uint64_t		sendCalls	= 0;
+	uint64_t		sendErrors	= 0;
+
+	memset(messages, 0, sizeof(messages));
+
+	while (m_audioPacketsSent < m_audioPacketCount && m_audioStartTime + m_audioPacketsSent * m_audioLayout.packetNanoseconds <= dueTime)
+	{
+		uint32_t messageCount = 0;
+
+		for (uint32_t packet = m_audioPacketsSent; packet < m_audioPacketCount && messageCount < kMaxBatchPackets; packet++, messageCount++)
+		{
+			if (m_audioStartTime + packet * m_audioLayout.packetNanoseconds > dueTime)
+				break;
+
+			iovecs[messageCount].iov_base	= &m_audioPackets[packet * m_audioLayout.packetSize];
+			iovecs[messageCount].iov_len	= m_audioLayout.packetSize;
+			messages[messageCount].msg_hdr.msg_iov		= &iovecs[messageCount];
+			messages[messageCount].msg_hdr.msg_iovlen	= 1;
+		}
+
+		for (uint32_t sent = 0; sent < messageCount; )
+		{
+			int result = sendmmsg(m_audioSocket, messages + sent, messageCount - sent, 0);
+
+			sendCalls++;
+			if (result >= 0)
+			{
+				sent		+= result;
+				packetsSent	+= result;
+			}
+			else if (errno != EINTR)
+			{
+				sendErrors++;
+				break;
+			}
+		}
+
+		// Packets that failed to send are not retried, audio is sent at its packet time or not at all
+		m_audioPacketsSent += messageCount;
+	}
+
+	if (sendCalls == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_statistics.audioPackets	+= packetsSent;
+	m_statistics.bytesSent		+= packetsSent * m_audioLayout.packetSize;
+	m_statistics.sendCalls		+= sendCalls;
+	m_statistics.sendErrors		+= sendErrors;
+}
+
+void ST2110Sender::ReleaseFrame(const ST2110SenderFrame& frame)
+{
+	if (frame.videoOwner)
+		frame.videoOwner->Release();
+	if (frame.audioOwner)
+		frame.audioOwner->Release();
+}
@@ -0,0 +1,160 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+#include "DeckLinkAPI.h"
+#include "ST2110.h"
+
+// Sends v210 video frames as ST 2110-20 and their audio as ST 2110-30 from a dedicated thread.
+// SendFrame holds a reference on the frame's owners until its packets are sent, so frames are
+// not copied before they are queued, and rows are converted straight into the packet buffers.
+//
+// Packets are sent in batches with sendmmsg.  Where the kernel supports UDP generic segmentation
+// offload each message carries up to kMaxSegmentsPerMessage video packets, otherwise one.  The
+// headers of each packet position in the frame are precomputed when the frame size changes, so
+// only the sequence number, timestamp and marker are written per packet.
+//
+// Paced, the video packets of a frame are spread evenly over the frame duration, the linear
+// timing model of ST 2110-21, in batches at least kMinPacingInterval apart as the thread sleeps
+// between them.  Audio packets are sent at their packet times between the video batches.
+// Unpaced, packets are sent as fast as possible, for benchmarking.
+
+struct ST2110SenderFrame
+{
+	IUnknown*		videoOwner;					// Referenced until the frame is sent, may be NULL
+	const void*		videoBytes;
+	uint32_t		width;
+	uint32_t		height;
+	uint32_t		rowBytes;
+	bool			interlaced;
+	bool			lowerFieldFirst;
+	uint32_t		videoTimestamp;				// 90 kHz RTP timestamp of the first field
+	uint64_t		frameNanoseconds;			// Frame duration
+	IUnknown*		audioOwner;					// Referenced until the frame is sent, may be NULL
+	const void*		audioBytes;					// NULL if the frame has no audio
+	uint32_t		audioSampleFrameCount;
+	uint32_t		audioTimestamp;				// 48 kHz RTP timestamp of the first sample frame
+};
+
+struct ST2110SenderStatistics
+{
+	uint64_t	framesSent;
+	uint64_t	framesDropped;					// The queue was full
+	uint64_t	framesUnsupported;				// The frame size can't be sent as ST 2110-20
+	uint64_t	videoPackets;
+	uint64_t	audioPackets;
+	uint64_t	bytesSent;						// RTP packet bytes
+	uint64_t	sendCalls;
+	uint64_t	sendErrors;
+	uint64_t	lateBatches;					// Paced batches sent more than a batch interval late
+	double		cpuSeconds;						// CPU time of the send thread
+	uint32_t	queueDepth;
+	uint32_t	peakQueuedFrames;
+	bool		segmentationOffload;
+};
+
+class ST2110Sender
+{
+public:
+	ST2110Sender();
+	virtual ~ST2110Sender();
+
+	// Audio is sent to audioPort, or not at all if it is 0
+	bool	Open(const char* address, uint16_t videoPort, uint16_t audioPort, uint32_t audioChannelCount, uint32_t audioSampleDepth, uint32_t queueDepth, bool paced);
+	void	Close(void);
+	bool	IsOpen(void) const { return m_videoSocket != -1; }
+
+	// Queue a frame to send.  Returns false if the queue is full and the frame was dropped
+	bool		SendFrame(const ST2110SenderFrame& frame);
+	uint32_t	GetQueuedFrames(void);
+
+	void	GetStatistics(ST2110SenderStatistics& statistics);
+
+private:
+	static const uint32_t	kMaxBatchPackets		= 256;
+	static const uint32_t	kMaxSegmentsPerMessage	= 64;
+	static const uint64_t	kMinPacingInterval		= 50000;		// Nanoseconds
+
+	void	SenderThread(void);
+	void	SendQueuedFrame(const ST2110SenderFrame& frame);
+	bool	SetVideoLayout(const ST2110SenderFrame& frame);
+	void	PacketizeAudio(const ST2110SenderFrame& frame);
+	void	PacketizeVideo(const ST2110SenderFrame& frame, uint32_t firstPacket, uint32_t packetCount);
+	void	SendVideoPackets(uint32_t firstPacket, uint32_t endPacket);
+	void	SendAudioPackets(uint64_t dueTime);
+	void	ReleaseFrame(const ST2110SenderFrame& frame);
+
+	int						m_videoSocket;
+	int						m_audioSocket;
+	bool					m_paced;
+	uint32_t				m_ssrc;
+	//
+	ST2110VideoLayout		m_videoLayout;
+	uint8_t					m_videoHeaderTemplate[kST2110VideoHeaderSize];
+	std::vector<uint8_t>	m_videoPackets;
+	uint32_t				m_segmentsPerMessage;			// 1 without segmentation offload
+	uint32_t				m_videoSequence;				// Extended sequence number
+	//
+	ST2110AudioLayout		m_audioLayout;
+	std::vector<uint8_t>	m_audioPending;					// Payload samples not yet filling a packet
+	uint32_t				m_audioPendingFrames;
+	uint32_t				m_audioPendingTimestamp;
+	std::vector<uint8_t>	m_audioPackets;
+	uint32_t				m_audioPacketCount;
+	uint32_t				m_audioPacketsSent;
+	uint64_t				m_audioStartTime;
+	uint16_t				m_audioSequence;
+	//
+	std::thread				m_senderThread;
+	std::mutex				m_mutex;
+	std::condition_variable	m_queueCondition;
+	std::vector<ST2110SenderFrame>	m_queue;
+	uint32_t				m_queueHead;
+	uint32_t				m_queuedFrames;
+	bool					m_closing;
+	//
+	ST2110SenderStatistics	m_statistics;
+};
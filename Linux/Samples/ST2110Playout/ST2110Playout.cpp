@@ -0,0 +1,858 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+// ST2110Playout receives ST 2110-20 video and ST 2110-30 audio, as sent by Capture -r, and plays
+// it out on a DeckLink device.  With -B it benchmarks the ST 2110 sender and receiver against
+// each other over loopback UDP, without a DeckLink device.
+
+#include <atomic>
+#include <csignal>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "DeckLinkAPI.h"
+#include "ST2110Receiver.h"
+#include "ST2110Sender.h"
+
+static const uint16_t	kDefaultVideoPort		= 5004;
+static const uint32_t	kPlayoutFrameCount		= 8;
+static const uint32_t	kPrerollFrames			= 3;
+static const uint32_t	kBenchmarkQueueDepth	= 2;
+static const uint32_t	kBenchmarkBufferCount	= 4;
+static const uint32_t	kBenchmarkFrameRate		= 60;
+
+static std::atomic<bool>	g_do_exit(false);
+
+static void sigfunc(int signum)
+{
+	if (signum == SIGINT || signum == SIGTERM)
+		g_do_exit = true;
+}
+
+static double GetMonotonicSeconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Rows of v210 are padded to a multiple of 48 pixels, 128 bytes
+static uint32_t GetV210RowBytes(uint32_t width)
+{
+	return ((width + 47) / 48) * 128;
+}
+
+struct PlayoutStatistics
+{
+	uint64_t	framesScheduled;
+	uint64_t	framesIncomplete;			// Received with packets missing, not played
+	uint64_t	framesLate;
+	uint64_t	framesDropped;
+	uint64_t	rescheduled;				// Frames arrived too late to play and were rescheduled
+	uint64_t	audioSampleFrames;
+	uint64_t	audioSampleFramesDropped;
+};
+
+// Receives frames into a pool of DeckLink frames and schedules them for playback in the order
+// they arrive.  The output clock is not locked to the sender, frames are rescheduled when they
+// arrive too late to be played
+class PlayoutDelegate : public IDeckLinkVideoOutputCallback, public ST2110ReceiverCallback
+{
+public:
+	PlayoutDelegate(IDeckLinkOutput* deckLinkOutput, BMDTimeValue frameDuration, BMDTimeScale timeScale, bool audioEnabled);
+
+	bool	CreateFrames(uint32_t width, uint32_t height, uint32_t rowBytes);
+	void	GetStatistics(PlayoutStatistics& statistics);
+
+	// ST2110ReceiverCallback interface
+	void*	AcquireFrameBuffer(void** context) override;
+	void	FrameReceived(void* context, const ST2110ReceivedFrame& frame) override;
+	void	AudioReceived(const void* samples, uint32_t sampleFrameCount, uint32_t timestamp) override;
+
+	// IDeckLinkVideoOutputCallback interface
+	HRESULT	STDMETHODCALLTYPE ScheduledFrameCompleted(IDeckLinkVideoFrame* completedFrame, BMDOutputFrameCompletionResult result) override;
+	HRESULT	STDMETHODCALLTYPE ScheduledPlaybackHasStopped() override;
+
+	// IUnknown interface
+	HRESULT	STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG	STDMETHODCALLTYPE AddRef() override;
+	ULONG	STDMETHODCALLTYPE Release() override;
+
+private:
+	virtual ~PlayoutDelegate();
+
+	void	ReturnFrame(IDeckLinkMutableVideoFrame* frame);
+
+	std::atomic<ULONG>		m_refCount;
+	IDeckLinkOutput*		m_deckLinkOutput;
+	BMDTimeValue			m_frameDuration;
+	BMDTimeScale			m_timeScale;
+	bool					m_audioEnabled;
+	//
+	// Scheduling is only done from the receive thread
+	BMDTimeValue			m_nextStreamTime;
+	bool					m_playbackStarted;
+	//
+	// Frames are returned from the DeckLink callback thread
+	std::mutex				m_mutex;
+	std::vector<IDeckLinkMutableVideoFrame*>	m_frames;
+	std::vector<IDeckLinkMutableVideoFrame*>	m_freeFrames;
+	PlayoutStatistics		m_statistics;
+};
+
+PlayoutDelegate::PlayoutDelegate(IDeckLinkOutput* deckLinkOutput, BMDTimeValue frameDuration, BMDTimeScale timeScale, bool audioEnabled) :
+	m_refCount(1),
+	m_deckLinkOutput(deckLinkOutput),
+	m_frameDuration(frameDuration),
+	m_timeScale(timeScale),
+	m_audioEnabled(audioEnabled),
+	m_nextStreamTime(0),
+	m_playbackStarted(false)
+{
+	memset(&m_statistics, 0, sizeof(m_statistics));
+}
+
+PlayoutDelegate::~PlayoutDelegate()
+{
+	for (IDeckLinkMutableVideoFrame* frame : m_frames)
+		frame->Release();
+}
+
+bool PlayoutDelegate::CreateFrames(uint32_t width, uint32_t height, uint32_t rowBytes)
+{
+	for (uint32_t i = 0; i < kPlayoutFrameCount; i++)
+	{
+		IDeckLinkMutableVideoFrame* frame;
+
+		if (m_deckLinkOutput->CreateVideoFrame(width, height, rowBytes, bmdFormat10BitYUV, bmdFrameFlagDefault, &frame) != S_OK)
+			return false;
+
+		m_frames.push_back(frame);
+		m_freeFrames.push_back(frame);
+	}
+
+	return true;
+}
+
+void PlayoutDelegate::GetStatistics(PlayoutStatistics& statistics)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	statistics = m_statistics;
+}
+
+void PlayoutDelegate::ReturnFrame(IDeckLinkMutableVideoFrame* frame)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_freeFrames.push_back(frame);
+}
+
+void* PlayoutDelegate::AcquireFrameBuffer(void** context)
+{
+	IDeckLinkMutableVideoFrame*	frame;
+	void*						bytes;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (m_freeFrames.empty())
+			return NULL;
+
+		frame = m_freeFrames.back();
+		m_freeFrames.pop_back();
+	}
+
+	if (frame->GetBytes(&bytes) != S_OK)
+	{
+		ReturnFrame(frame);
+		return NULL;
+	}
+
+	*context = frame;
+	return bytes;
+}
+
+void PlayoutDelegate::FrameReceived(void* context, const ST2110ReceivedFrame& receivedFrame)
+{
+	IDeckLinkMutableVideoFrame*	frame = (IDeckLinkMutableVideoFrame*)context;
+	BMDTimeValue				streamTime;
+	double						playbackSpeed;
+
+	// Rows of a frame with packets missing would show the frame received before, so the output
+	// repeats the last complete frame instead
+	if (!receivedFrame.complete)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_statistics.framesIncomplete++;
+		m_freeFrames.push_back(frame);
+		return;
+	}
+
+	if (m_playbackStarted &&
+		m_deckLinkOutput->GetScheduledStreamTime(m_timeScale, &streamTime, &playbackSpeed) == S_OK &&
+		m_nextStreamTime < streamTime + m_frameDuration)
+	{
+		// Frames stopped arriving for longer than the preroll, start again from the current time
+		m_nextStreamTime = (streamTime / m_frameDuration + kPrerollFrames) * m_frameDuration;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_statistics.rescheduled++;
+	}
+
+	if (m_deckLinkOutput->ScheduleVideoFrame(frame, m_nextStreamTime, m_frameDuration, m_timeScale) != S_OK)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_statistics.framesDropped++;
+		m_freeFrames.push_back(frame);
+		return;
+	}
+
+	m_nextStreamTime += m_frameDuration;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_statistics.framesScheduled++;
+	}
+
+	if (!m_playbackStarted && m_nextStreamTime >= (BMDTimeValue)kPrerollFrames * m_frameDuration)
+	{
+		if (m_deckLinkOutput->StartScheduledPlayback(0, m_timeScale, 1.0) == S_OK)
+			m_playbackStarted = true;
+		else
+			fprintf(stderr, "Could not start scheduled playback\n");
+	}
+}
+
+void PlayoutDelegate::AudioReceived(const void* samples, uint32_t sampleFrameCount, uint32_t timestamp)
+{
+	uint32_t sampleFramesWritten = 0;
+
+	if (!m_audioEnabled)
+		return;
+
+	// The audio stream is continuous, samples are played in the order they arrive
+	if (m_deckLinkOutput->ScheduleAudioSamples((void*)samples, sampleFrameCount, 0, 0, &sampleFramesWritten) != S_OK)
+		sampleFramesWritten = 0;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_statistics.audioSampleFrames += sampleFramesWritten;
+	m_statistics.audioSampleFramesDropped += sampleFrameCount - sampleFramesWritten;
+}
+
+HRESULT PlayoutDelegate::ScheduledFrameCompleted(IDeckLinkVideoFrame* completedFrame, BMDOutputFrameCompletionResult result)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (result == bmdOutputFrameDisplayedLate)
+		m_statistics.framesLate++;
+	else if (result == bmdOutputFrameDropped)
+		m_statistics.framesDropped++;
+
+	m_freeFrames.push_back((IDeckLinkMutableVideoFrame*)completedFrame);
+	return S_OK;
+}
+
+HRESULT PlayoutDelegate::ScheduledPlaybackHasStopped()
+{
+	return S_OK;
+}
+
+HRESULT PlayoutDelegate::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	static const REFIID iunknown = IID_IUnknown;
+
+	if (ppv == NULL)
+		return E_POINTER;
+
+	if (memcmp(&iid, &iunknown, sizeof(REFIID)) == 0 || memcmp(&iid, &IID_IDeckLinkVideoOutputCallback, sizeof(REFIID)) == 0)
+	{
+		*ppv = static_cast<IDeckLinkVideoOutputCallback*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = NULL;
+	return E_NOINTERFACE;
+}
+
+ULONG PlayoutDelegate::AddRef()
+{
+	return ++m_refCount;
+}
+
+ULONG PlayoutDelegate::Release()
+{
+	ULONG newRefValue = --m_refCount;
+
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+// Verifies the frames received in a benchmark against the two frames the benchmark alternates
+// between, so a frame with stale rows from the buffer's previous use does not match
+class BenchmarkReceiver : public ST2110ReceiverCallback
+{
+public:
+	BenchmarkReceiver(const std::vector<uint8_t>* sourceFrames, uint32_t frameTimestampInterval) :
+		m_sourceFrames(sourceFrames),
+		m_frameTimestampInterval(frameTimestampInterval),
+		m_framesVerified(0),
+		m_framesMismatched(0),
+		m_audioSampleFrames(0)
+	{
+		m_buffers.reserve(kBenchmarkBufferCount);
+		for (uint32_t i = 0; i < kBenchmarkBufferCount; i++)
+		{
+			m_buffers.push_back(std::vector<uint8_t>(sourceFrames[0].size()));
+			m_freeBuffers.push_back(&m_buffers.back());
+		}
+	}
+
+	void* AcquireFrameBuffer(void** context) override
+	{
+		if (m_freeBuffers.empty())
+			return NULL;
+
+		std::vector<uint8_t>* buffer = m_freeBuffers.back();
+		m_freeBuffers.pop_back();
+
+		*context = buffer;
+		return buffer->data();
+	}
+
+	void FrameReceived(void* context, const ST2110ReceivedFrame& frame) override
+	{
+		std::vector<uint8_t>*	buffer	= (std::vector<uint8_t>*)context;
+		const std::vector<uint8_t>&	source	= m_sourceFrames[(frame.videoTimestamp / m_frameTimestampInterval) % 2];
+
+		if (frame.complete)
+		{
+			if (memcmp(buffer->data(), source.data(), source.size()) == 0)
+				m_framesVerified++;
+			else
+				m_framesMismatched++;
+		}
+
+		m_freeBuffers.push_back(buffer);
+	}
+
+	void AudioReceived(const void* samples, uint32_t sampleFrameCount, uint32_t timestamp) override
+	{
+		m_audioSampleFrames += sampleFrameCount;
+	}
+
+	// Only read once the receiver is closed
+	uint64_t	GetFramesVerified(void) const { return m_framesVerified; }
+	uint64_t	GetFramesMismatched(void) const { return m_framesMismatched; }
+	uint64_t	GetAudioSampleFrames(void) const { return m_audioSampleFrames; }
+
+private:
+	const std::vector<uint8_t>*			m_sourceFrames;
+	uint32_t							m_frameTimestampInterval;
+	std::vector<std::vector<uint8_t>>	m_buffers;
+	std::vector<std::vector<uint8_t>*>	m_freeBuffers;
+	uint64_t							m_framesVerified;
+	uint64_t							m_framesMismatched;
+	uint64_t							m_audioSampleFrames;
+};
+
+static int RunBenchmark(uint32_t width, uint32_t height, double seconds, uint16_t videoPort, uint32_t audioChannelCount, uint32_t audioSampleDepth)
+{
+	uint32_t					rowBytes				= GetV210RowBytes(width);
+	uint32_t					frameTimestampInterval	= kST2110VideoClockRate / kBenchmarkFrameRate;
+	uint32_t					audioSampleFrameCount	= kST2110AudioClockRate / kBenchmarkFrameRate;
+	std::vector<uint8_t>		sourceFrames[2];
+	std::vector<uint8_t>		audioSamples(audioSampleFrameCount * audioChannelCount * (audioSampleDepth / 8));
+	ST2110VideoLayout			layout;
+	ST2110Sender				sender;
+	ST2110Receiver				receiver;
+	BenchmarkReceiver*			benchmarkReceiver;
+	ST2110SenderStatistics		senderStatistics;
+	ST2110ReceiverStatistics	receiverStatistics;
+	ST2110SenderFrame			frame;
+	double						startTime;
+	double						elapsedSeconds;
+	uint32_t					frameCount				= 0;
+	int							exitStatus;
+
+	if (!GetST2110VideoLayout(width, height, false, false, layout))
+	{
+		fprintf(stderr, "Frames of %ux%u can't be sent as ST 2110-20\n", width, height);
+		return 1;
+	}
+
+	// Two different frames of 10-bit samples, leaving the padding at the end of each row zero
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		sourceFrames[i].assign((size_t)rowBytes * height, 0);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			uint32_t* words = (uint32_t*)&sourceFrames[i][(size_t)y * rowBytes];
+
+			for (uint32_t sample = 0; sample < width * 2; sample++)
+				words[sample / 3] |= ((sample * 7 + y * 13 + i * 512) & 0x3FF) << (10 * (sample % 3));
+		}
+	}
+
+	for (size_t i = 0; i < audioSamples.size(); i++)
+		audioSamples[i] = (uint8_t)i;
+
+	benchmarkReceiver = new BenchmarkReceiver(sourceFrames, frameTimestampInterval);
+
+	if (!receiver.Open(NULL, videoPort, videoPort + 2, width, height, rowBytes, false, false, audioChannelCount, audioSampleDepth, benchmarkReceiver))
+	{
+		fprintf(stderr, "Could not receive on UDP port %u\n", videoPort);
+		delete benchmarkReceiver;
+		return 1;
+	}
+
+	if (!sender.Open("127.0.0.1", videoPort, videoPort + 2, audioChannelCount, audioSampleDepth, kBenchmarkQueueDepth, false))
+	{
+		fprintf(stderr, "Could not send to UDP port %u\n", videoPort);
+		receiver.Close();
+		delete benchmarkReceiver;
+		return 1;
+	}
+
+	memset(&frame, 0, sizeof(frame));
+	frame.width					= width;
+	frame.height				= height;
+	frame.rowBytes				= rowBytes;
+	frame.frameNanoseconds		= 1000000000ULL / kBenchmarkFrameRate;
+	frame.audioBytes			= audioSamples.data();
+	frame.audioSampleFrameCount	= audioSampleFrameCount;
+
+	fprintf(stderr, "Benchmarking %ux%u v210 over loopback UDP for %.0f s: %u packets of %u bytes per frame\n",
+		width, height, seconds, layout.packetCount, layout.packetSize);
+
+	signal(SIGINT, sigfunc);
+	signal(SIGTERM, sigfunc);
+
+	// Frames are sent unpaced, as fast as the sender converts and sends them
+	startTime = GetMonotonicSeconds();
+	while (!g_do_exit && GetMonotonicSeconds() - startTime < seconds)
+	{
+		if (sender.GetQueuedFrames() >= kBenchmarkQueueDepth)
+		{
+			usleep(100);
+			continue;
+		}
+
+		frame.videoBytes		= sourceFrames[frameCount % 2].data();
+		frame.videoTimestamp	= frameCount * frameTimestampInterval;
+		frame.audioTimestamp	= frameCount * audioSampleFrameCount;
+		sender.SendFrame(frame);
+		frameCount++;
+	}
+
+	sender.Close();
+	elapsedSeconds = GetMonotonicSeconds() - startTime;
+
+	// Let the receiver drain its socket buffers
+	usleep(200000);
+	receiver.Close();
+
+	sender.GetStatistics(senderStatistics);
+	receiver.GetStatistics(receiverStatistics);
+
+	fprintf(stderr, "Sender:   %llu frames, %llu video and %llu audio packets in %llu sendmmsg calls, segmentation offload %s\n",
+		(unsigned long long)senderStatistics.framesSent,
+		(unsigned long long)senderStatistics.videoPackets,
+		(unsigned long long)senderStatistics.audioPackets,
+		(unsigned long long)senderStatistics.sendCalls,
+		senderStatistics.segmentationOffload ? "on" : "off");
+	fprintf(stderr, "          %.2f Gbit/s, %.2f Gbit/s per core (%.2f s CPU), %.0f frames/s\n",
+		senderStatistics.bytesSent * 8 / elapsedSeconds / 1e9,
+		senderStatistics.cpuSeconds > 0 ? senderStatistics.bytesSent * 8 / senderStatistics.cpuSeconds / 1e9 : 0.0,
+		senderStatistics.cpuSeconds,
+		senderStatistics.framesSent / elapsedSeconds);
+	fprintf(stderr, "Receiver: %llu frames (%llu incomplete, %llu verified, %llu mismatched), %llu audio sample frames, receive offload %s\n",
+		(unsigned long long)receiverStatistics.framesReceived,
+		(unsigned long long)receiverStatistics.framesIncomplete,
+		(unsigned long long)benchmarkReceiver->GetFramesVerified(),
+		(unsigned long long)benchmarkReceiver->GetFramesMismatched(),
+		(unsigned long long)benchmarkReceiver->GetAudioSampleFrames(),
+		receiverStatistics.receiveOffload ? "on" : "off");
+	fprintf(stderr, "          %llu video packets in %llu recvmmsg calls, %llu lost, %llu out of order, %llu invalid\n",
+		(unsigned long long)receiverStatistics.videoPackets,
+		(unsigned long long)receiverStatistics.receiveCalls,
+		(unsigned long long)receiverStatistics.videoPacketsLost,
+		(unsigned long long)receiverStatistics.packetsOutOfOrder,
+		(unsigned long long)receiverStatistics.packetsInvalid);
+	fprintf(stderr, "          %.2f Gbit/s, %.2f Gbit/s per core (%.2f s CPU)\n",
+		receiverStatistics.bytesReceived * 8 / elapsedSeconds / 1e9,
+		receiverStatistics.cpuSeconds > 0 ? receiverStatistics.bytesReceived * 8 / receiverStatistics.cpuSeconds / 1e9 : 0.0,
+		receiverStatistics.cpuSeconds);
+
+	exitStatus = (benchmarkReceiver->GetFramesMismatched() == 0) ? 0 : 1;
+	delete benchmarkReceiver;
+	return exitStatus;
+}
+
+static void DisplayUsage(IDeckLinkOutput* deckLinkOutput, int status)
+{
+	IDeckLinkIterator*				deckLinkIterator	= CreateDeckLinkIteratorInstance();
+	IDeckLinkDisplayModeIterator*	displayModeIterator	= NULL;
+	IDeckLink*						deckLink;
+	IDeckLinkDisplayMode*			displayMode;
+	const char*						name;
+	int								index				= 0;
+
+	fprintf(stderr,
+		"Usage: ST2110Playout -d <device id> -m <mode id> [OPTIONS]\n"
+		"       ST2110Playout -B <width>x<height> [OPTIONS]\n"
+		"\n"
+		"    -d <device id>:\n");
+
+	while (deckLinkIterator != NULL && deckLinkIterator->Next(&deckLink) == S_OK)
+	{
+		if (deckLink->GetDisplayName(&name) == S_OK)
+		{
+			fprintf(stderr, "        %2d: %s\n", index, name);
+			free((void*)name);
+		}
+		deckLink->Release();
+		index++;
+	}
+
+	if (index == 0)
+		fprintf(stderr, "        No DeckLink devices found\n");
+
+	fprintf(stderr, "    -m <mode id>:\n");
+
+	if (deckLinkOutput != NULL && deckLinkOutput->GetDisplayModeIterator(&displayModeIterator) == S_OK)
+	{
+		for (index = 0; displayModeIterator->Next(&displayMode) == S_OK; index++)
+		{
+			BMDTimeValue	frameDuration;
+			BMDTimeScale	timeScale;
+
+			displayMode->GetFrameRate(&frameDuration, &timeScale);
+			if (displayMode->GetName(&name) == S_OK)
+			{
+				fprintf(stderr, "        %2d: %-20s %4li x %4li %.2f FPS\n", index, name, displayMode->GetWidth(), displayMode->GetHeight(), (double)timeScale / frameDuration);
+				free((void*)name);
+			}
+			displayMode->Release();
+		}
+		displayModeIterator->Release();
+	}
+	else
+	{
+		fprintf(stderr, "        Select a device to list its modes\n");
+	}
+
+	fprintf(stderr,
+		"    -a <address>         Receive from a multicast group (default is any address)\n"
+		"    -p <port>            Video UDP port, audio is received on port + 2 (default is %u)\n"
+		"    -c <channels>        Audio channels (2, 8 or 16 - default is 2)\n"
+		"    -s <depth>           Audio sample depth (16 or 32 - default is 16)\n"
+		"    -n                   No audio\n"
+		"    -B <width>x<height>  Benchmark the sender and receiver over loopback UDP, without a DeckLink device\n"
+		"    -t <seconds>         Benchmark duration (default is 5)\n"
+		"\n"
+		"Audio options must match those given to Capture -r.  Playout is not locked to the sender's\n"
+		"clock, frames are repeated or rescheduled when the clocks drift apart\n",
+		kDefaultVideoPort);
+
+	if (deckLinkIterator != NULL)
+		deckLinkIterator->Release();
+
+	exit(status);
+}
+
+int main(int argc, char *argv[])
+{
+	int							deckLinkIndex		= -1;
+	int							displayModeIndex	= -1;
+	const char*					address				= NULL;
+	uint16_t					videoPort			= kDefaultVideoPort;
+	uint32_t					audioChannelCount	= 2;
+	uint32_t					audioSampleDepth	= 16;
+	bool						audioEnabled		= true;
+	uint32_t					benchmarkWidth		= 0;
+	uint32_t					benchmarkHeight		= 0;
+	double						benchmarkSeconds	= 5.0;
+	int							exitStatus			= 1;
+	int							ch;
+
+	IDeckLinkIterator*			deckLinkIterator	= NULL;
+	IDeckLink*					deckLink			= NULL;
+	IDeckLinkOutput*			deckLinkOutput		= NULL;
+	IDeckLinkDisplayModeIterator*	displayModeIterator	= NULL;
+	IDeckLinkDisplayMode*		displayMode			= NULL;
+	const char*					displayModeName		= NULL;
+	BMDTimeValue				frameDuration;
+	BMDTimeScale				timeScale;
+	bool						supported;
+	bool						interlaced;
+	uint32_t					width;
+	uint32_t					height;
+	uint32_t					rowBytes;
+	PlayoutDelegate*			delegate			= NULL;
+	ST2110Receiver				receiver;
+	ST2110ReceiverStatistics	statistics;
+	ST2110ReceiverStatistics	lastStatistics;
+	PlayoutStatistics			playoutStatistics;
+
+	while ((ch = getopt(argc, argv, "d:m:a:p:c:s:nB:t:h?")) != -1)
+	{
+		switch (ch)
+		{
+			case 'd':
+				deckLinkIndex = atoi(optarg);
+				break;
+
+			case 'm':
+				displayModeIndex = atoi(optarg);
+				break;
+
+			case 'a':
+				address = optarg;
+				break;
+
+			case 'p':
+				videoPort = (uint16_t)atoi(optarg);
+				break;
+
+			case 'c':
+				audioChannelCount = atoi(optarg);
+				break;
+
+			case 's':
+				audioSampleDepth = atoi(optarg);
+				break;
+
+			case 'n':
+				audioEnabled = false;
+				break;
+
+			case 'B':
+				if (sscanf(optarg, "%ux%u", &benchmarkWidth, &benchmarkHeight) != 2)
+					DisplayUsage(NULL, 1);
+				break;
+
+			case 't':
+				benchmarkSeconds = atof(optarg);
+				break;
+
+			case '?':
+			case 'h':
+				DisplayUsage(NULL, 0);
+		}
+	}
+
+	if ((audioChannelCount != 2 && audioChannelCount != 8 && audioChannelCount != 16) || (audioSampleDepth != 16 && audioSampleDepth != 32))
+		DisplayUsage(NULL, 1);
+
+	if (benchmarkWidth > 0)
+		return RunBenchmark(benchmarkWidth, benchmarkHeight, benchmarkSeconds, videoPort, audioChannelCount, audioSampleDepth);
+
+	// Get the DeckLink output and display mode
+	deckLinkIterator = CreateDeckLinkIteratorInstance();
+	if (deckLinkIterator == NULL)
+	{
+		fprintf(stderr, "A DeckLink iterator could not be created.  The DeckLink drivers may not be installed.\n");
+		goto bail;
+	}
+
+	for (int i = 0; deckLinkIndex >= 0 && deckLinkIterator->Next(&deckLink) == S_OK; i++)
+	{
+		if (i == deckLinkIndex)
+			break;
+
+		deckLink->Release();
+		deckLink = NULL;
+	}
+
+	if (deckLink == NULL || deckLink->QueryInterface(IID_IDeckLinkOutput, (void**)&deckLinkOutput) != S_OK)
+	{
+		fprintf(stderr, "You must select a DeckLink device with an output\n");
+		DisplayUsage(NULL, 1);
+	}
+
+	if (deckLinkOutput->GetDisplayModeIterator(&displayModeIterator) != S_OK)
+		goto bail;
+
+	for (int i = 0; displayModeIndex >= 0 && displayModeIterator->Next(&displayMode) == S_OK; i++)
+	{
+		if (i == displayModeIndex)
+			break;
+
+		displayMode->Release();
+		displayMode = NULL;
+	}
+
+	if (displayMode == NULL)
+	{
+		fprintf(stderr, "You must select a display mode\n");
+		DisplayUsage(deckLinkOutput, 1);
+	}
+
+	if (deckLinkOutput->DoesSupportVideoMode(bmdVideoConnectionUnspecified, displayMode->GetDisplayMode(), bmdFormat10BitYUV, bmdNoVideoOutputConversion, bmdSupportedVideoModeDefault, NULL, &supported) != S_OK || !supported)
+	{
+		fprintf(stderr, "The display mode is not supported with 10 bit YUV\n");
+		goto bail;
+	}
+
+	displayMode->GetFrameRate(&frameDuration, &timeScale);
+	displayMode->GetName(&displayModeName);
+	width		= (uint32_t)displayMode->GetWidth();
+	height		= (uint32_t)displayMode->GetHeight();
+	interlaced	= (displayMode->GetFieldDominance() == bmdLowerFieldFirst || displayMode->GetFieldDominance() == bmdUpperFieldFirst);
+
+	rowBytes	= GetV210RowBytes(width);
+
+	// Configure playout
+	delegate = new PlayoutDelegate(deckLinkOutput, frameDuration, timeScale, audioEnabled);
+
+	if (deckLinkOutput->SetScheduledFrameCompletionCallback(delegate) != S_OK ||
+		deckLinkOutput->EnableVideoOutput(displayMode->GetDisplayMode(), bmdVideoOutputFlagDefault) != S_OK)
+	{
+		fprintf(stderr, "Could not enable video output\n");
+		goto bail;
+	}
+
+	if (audioEnabled && deckLinkOutput->EnableAudioOutput(bmdAudioSampleRate48kHz, audioSampleDepth, audioChannelCount, bmdAudioOutputStreamContinuous) != S_OK)
+	{
+		fprintf(stderr, "Could not enable audio output\n");
+		goto bail;
+	}
+
+	if (!delegate->CreateFrames(width, height, rowBytes))
+	{
+		fprintf(stderr, "Could not create output frames\n");
+		goto bail;
+	}
+
+	if (!receiver.Open(address, videoPort, audioEnabled ? videoPort + 2 : 0, width, height, rowBytes, interlaced,
+		displayMode->GetFieldDominance() == bmdLowerFieldFirst, audioChannelCount, audioSampleDepth, delegate))
+	{
+		fprintf(stderr, "Could not receive on UDP port %u\n", videoPort);
+		goto bail;
+	}
+
+	fprintf(stderr, "Playing out ST 2110 from %s port %u in %s%s\n",
+		address ? address : "any address", videoPort, displayModeName ? displayModeName : "", audioEnabled ? "" : ", no audio");
+
+	signal(SIGINT, sigfunc);
+	signal(SIGTERM, sigfunc);
+
+	exitStatus = 0;
+	memset(&lastStatistics, 0, sizeof(lastStatistics));
+
+	while (!g_do_exit)
+	{
+		for (int i = 0; i < 10 && !g_do_exit; i++)
+			usleep(100000);
+
+		receiver.GetStatistics(statistics);
+		fprintf(stderr, "%llu frames received (%llu incomplete, %llu dropped), %llu packets lost, %.1f Mbit/s\n",
+			(unsigned long long)(statistics.framesReceived - lastStatistics.framesReceived),
+			(unsigned long long)(statistics.framesIncomplete - lastStatistics.framesIncomplete),
+			(unsigned long long)(statistics.framesDropped - lastStatistics.framesDropped),
+			(unsigned long long)(statistics.videoPacketsLost + statistics.audioPacketsLost - lastStatistics.videoPacketsLost - lastStatistics.audioPacketsLost),
+			(statistics.bytesReceived - lastStatistics.bytesReceived) * 8 / 1e6);
+		lastStatistics = statistics;
+	}
+
+	receiver.Close();
+	deckLinkOutput->StopScheduledPlayback(0, NULL, 0);
+
+	receiver.GetStatistics(statistics);
+	delegate->GetStatistics(playoutStatistics);
+
+	fprintf(stderr, "Received: %llu frames (%llu incomplete, %llu dropped), %llu video and %llu audio packets (%llu and %llu lost, %llu out of order, %llu invalid)\n",
+		(unsigned long long)statistics.framesReceived,
+		(unsigned long long)statistics.framesIncomplete,
+		(unsigned long long)statistics.framesDropped,
+		(unsigned long long)statistics.videoPackets,
+		(unsigned long long)statistics.audioPackets,
+		(unsigned long long)statistics.videoPacketsLost,
+		(unsigned long long)statistics.audioPacketsLost,
+		(unsigned long long)statistics.packetsOutOfOrder,
+		(unsigned long long)statistics.packetsInvalid);
+	fprintf(stderr, "Played:   %llu frames scheduled, %llu late, %llu dropped, %llu rescheduled, %llu audio sample frames (%llu dropped)\n",
+		(unsigned long long)playoutStatistics.framesScheduled,
+		(unsigned long long)playoutStatistics.framesLate,
+		(unsigned long long)playoutStatistics.framesDropped,
+		(unsigned long long)playoutStatistics.rescheduled,
+		(unsigned long long)playoutStatistics.audioSampleFrames,
+		(unsigned long long)playoutStatistics.audioSampleFramesDropped);
+
+bail:
+	receiver.Close();
+
+	if (deckLinkOutput != NULL)
+	{
+		deckLinkOutput->SetScheduledFrameCompletionCallback(NULL);
+		deckLinkOutput->DisableAudioOutput();
+		deckLinkOutput->DisableVideoOutput();
+	}
+
+	if (delegate != NULL)
+		delegate->Release();
+
+	if (displayModeName != NULL)
+		free((void*)displayModeName);
+
+	if (displayMode != NULL)
+		displayMode->Release();
+
+	if (displayModeIterator != NULL)
+		displayModeIterator->Release();
+
+	if (deckLinkOutput != NULL)
+		deckLinkOutput->Release();
+
+	if (deckLink != NULL)
+		deckLink->Release();
+
+	if (deckLinkIterator != NULL)
+		deckLinkIterator->Release();
+
+	return exitStatus;
+}
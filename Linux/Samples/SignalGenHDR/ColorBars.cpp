@@ -47,6 +47,7 @@
 #include <utility>
 #include <vector>
 #include "ColorBars.h"
+#include "PixelPacking.h"
 
 struct Color12BitRGB
 {
@@ -236,22 +237,29 @@ static const uint32_t kHD1080Height	= 1080;
 
 void FillBT2111ColorBars(com_ptr<IDeckLinkMutableVideoFrame>& colorBarsFrame, EOTFColorRange range)
 {
-	uint32_t*	nextWord;
-	uint32_t	width;
-	uint32_t	height;
-	uint32_t	rowBytes;
+	uint8_t*		nextLine;
+	uint32_t		width;
+	uint32_t		height;
+	uint32_t		rowBytes;
+	BMDPixelFormat	pixelFormat;
 	std::vector<Color12BitRGB> colorBarsLine;
+	std::vector<uint16_t> linePlanes[3];
 
-	colorBarsFrame->GetBytes((void**)&nextWord);
+	colorBarsFrame->GetBytes((void**)&nextLine);
 	width = colorBarsFrame->GetWidth();
 	height = colorBarsFrame->GetHeight();
 	rowBytes = colorBarsFrame->GetRowBytes();
 
+	// Write out data in full-range 12-bit RGB or video-range r210
+	pixelFormat = (range == EOTFColorRange::PQFullRange) ? bmdFormat12BitRGBLE : bmdFormat10BitRGB;
+
 	colorBarsLine.reserve(width);
+	for (auto& plane : linePlanes)
+		plane.resize(width);
 
 	for (auto& iter : kColorBarPatternsNarrow)
 	{
-		uint32_t* refLine = nextWord;
+		uint8_t* refLine = nextLine;
 
 		// Scale pattern for UHD frame height
 		uint32_t patternHeight = std::get<kColorBarsPatternHeight>(iter) * (height / kHD1080Height);
@@ -267,45 +275,24 @@ void FillBT2111ColorBars(com_ptr<IDeckLinkMutableVideoFrame>& colorBarsFrame, EO
 		for (uint32_t i = 0; i < padWidth; i++)
 			colorBarsLine.push_back(k40pcGrey[(int)range]);
 
-		for (uint32_t j = 0; j < patternHeight; j++)
+		// Convert line to MSB-aligned 16-bit planes for the pixel packing library
+		for (uint32_t i = 0; i < width; i++)
 		{
-			uint8_t* lineStart = (uint8_t*)nextWord;
+			linePlanes[kPixelPlaneR][i] = (uint16_t)((colorBarsLine[i].Red & 0xFFF) << 4);
+			linePlanes[kPixelPlaneG][i] = (uint16_t)((colorBarsLine[i].Green & 0xFFF) << 4);
+			linePlanes[kPixelPlaneB][i] = (uint16_t)((colorBarsLine[i].Blue & 0xFFF) << 4);
+		}
+
+		const uint16_t* planes[kPixelPlaneCount] = { linePlanes[kPixelPlaneR].data(), linePlanes[kPixelPlaneG].data(), linePlanes[kPixelPlaneB].data(), nullptr };
 
+		for (uint32_t j = 0; j < patternHeight; j++)
+		{
 			if (j == 0)
-			{
-				if (range == EOTFColorRange::PQFullRange)
-				{
-					// Write out data in full-range 12-bit RGB
-					for (uint32_t i = 0; i < width; i += 8)
-					{
-						// Refer to DeckLink SDK Manual, section 2.7.4 for packing structure
-						*nextWord++ = ((colorBarsLine[i].Blue & 0x0FF) << 24) | ((colorBarsLine[i].Green & 0xFFF) << 12) | (colorBarsLine[i].Red & 0xFFF);
-						*nextWord++ = ((colorBarsLine[i + 1].Blue & 0x00F) << 28) | ((colorBarsLine[i + 1].Green & 0xFFF) << 16) | ((colorBarsLine[i + 1].Red & 0xFFF) << 4) | ((colorBarsLine[i].Blue & 0xF00) >> 8);
-						*nextWord++ = ((colorBarsLine[i + 2].Green & 0xFFF) << 20) | ((colorBarsLine[i + 2].Red & 0xFFF) << 8) | ((colorBarsLine[i + 1].Blue & 0xFF0) >> 4);
-						*nextWord++ = ((colorBarsLine[i + 3].Green & 0x0FF) << 24) | ((colorBarsLine[i + 3].Red & 0xFFF) << 12) | (colorBarsLine[i + 2].Blue & 0xFFF);
-						*nextWord++ = ((colorBarsLine[i + 4].Green & 0x00F) << 28) | ((colorBarsLine[i + 4].Red & 0xFFF) << 16) | ((colorBarsLine[i + 3].Blue & 0xFFF) << 4) | ((colorBarsLine[i + 3].Green & 0xF00) >> 8);
-						*nextWord++ = ((colorBarsLine[i + 5].Red & 0xFFF) << 20) | ((colorBarsLine[i + 4].Blue & 0xFFF) << 8) | ((colorBarsLine[i + 4].Green & 0xFF0) >> 4);
-						*nextWord++ = ((colorBarsLine[i + 6].Red & 0x0FF) << 24) | ((colorBarsLine[i + 5].Blue & 0xFFF) << 12) | (colorBarsLine[i + 5].Green & 0xFFF);
-						*nextWord++ = ((colorBarsLine[i + 7].Red & 0x00F) << 28) | ((colorBarsLine[i + 6].Blue & 0xFFF) << 16) | ((colorBarsLine[i + 6].Green & 0xFFF) << 4) | ((colorBarsLine[i + 6].Red & 0xF00) >> 8);
-						*nextWord++ = ((colorBarsLine[i + 7].Blue & 0xFFF) << 20) | ((colorBarsLine[i + 7].Green & 0xFFF) << 8) | ((colorBarsLine[i + 7].Red & 0xFF0) >> 4);
-					}
-				}
-				else
-				{
-					// Write out data with video-range r210
-					for (uint32_t i = 0; i < width; i++)
-					{
-						// Refer to DeckLink SDK Manual, section 2.7.4 for packing structure
-						*nextWord++ = ((colorBarsLine[i].Blue & 0x3FC) << 22) | ((colorBarsLine[i].Green & 0x0FC) << 16) | ((colorBarsLine[i].Blue & 0xC00) << 6)
-										| ((colorBarsLine[i].Red & 0x03C) << 10) | (colorBarsLine[i].Green & 0xF00) | ((colorBarsLine[i].Red & 0xFC0) >> 6);
-					}
-				}
-			}
+				PackPixelRow(pixelFormat, planes, nextLine, width);
 			else
-			{
-				std::memcpy(nextWord, refLine, rowBytes);
-			}
-			nextWord = (uint32_t*)(lineStart + rowBytes);
+				std::memcpy(nextLine, refLine, rowBytes);
+
+			nextLine += rowBytes;
 		}
 
 		colorBarsLine.clear();
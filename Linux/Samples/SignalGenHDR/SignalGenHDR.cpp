@@ -46,6 +46,7 @@
 
 #include "ColorBars.h"
 #include "HDRVideoFrame.h"
+#include "PixelPacking.h"
 #include "SignalGenHDR.h"
 #include "ui_SignalGenHDR.h"
 
@@ -69,33 +70,6 @@ static const std::vector<std::pair<EOTF, QString>> kSupportedEOTF = {
 	std::make_pair(EOTF::HLG,	QString("HLG")),
 };
 
-static int GetBytesPerRow(BMDPixelFormat pixelFormat, ULONG frameWidth)
-{
-	int bytesPerRow;
-
-	// Refer to DeckLink SDK Manual - 2.7.4 Pixel Formats
-	switch (pixelFormat)
-	{
-	case bmdFormat12BitRGBLE:
-		bytesPerRow = (frameWidth * 36) / 8;
-		break;
-
-	case bmdFormat10BitYUV:
-		bytesPerRow = ((frameWidth + 47) / 48) * 128;
-		break;
-
-	case bmdFormat10BitRGB:
-		bytesPerRow = ((frameWidth + 63) / 64) * 256;
-		break;
-
-	default:
-		bytesPerRow = frameWidth * 4;
-		break;
-	}
-
-	return bytesPerRow;
-}
-
 SignalGenHDR::SignalGenHDR(QWidget *parent) :
 	QDialog(parent),
 	ui(new Ui::SignalGenHDR),
@@ -635,7 +609,7 @@ com_ptr<HDRVideoFrame> SignalGenHDR::CreateColorbarsFrame()
 	frameWidth = m_selectedDisplayMode->GetWidth();
 	frameHeight = m_selectedDisplayMode->GetHeight();
 
-	displayFrameBytesPerRow = GetBytesPerRow(m_selectedPixelFormat, frameWidth);
+	displayFrameBytesPerRow = GetPixelFormatRowBytes(m_selectedPixelFormat, frameWidth);
 
 	if (m_selectedHDRParameters.EOTF == static_cast<int64_t>(EOTF::HLG))
 		colorRange = EOTFColorRange::HLGVideoRange;
@@ -657,7 +631,7 @@ com_ptr<HDRVideoFrame> SignalGenHDR::CreateColorbarsFrame()
 	}
 	else
 	{
-		referenceFrameBytesPerRow = GetBytesPerRow(referencePixelFormat, frameWidth);
+		referenceFrameBytesPerRow = GetPixelFormatRowBytes(referencePixelFormat, frameWidth);
 
 		// If the pixel formats are different create and fill reference frame
 		hr = m_selectedDeckLinkOutput->CreateVideoFrame(frameWidth, frameHeight, referenceFrameBytesPerRow, referencePixelFormat, bmdFrameFlagDefault, referenceFrame.releaseAndGetAddressOf());
@@ -11,7 +11,7 @@ QT       += core gui widgets
 
 TARGET = SignalGenHDR
 TEMPLATE = app
-INCLUDEPATH = ../../include
+INCLUDEPATH = ../../include ../PixelPacking
 LIBS += -ldl
 
 # The following define makes your compiler emit warnings if you use
@@ -33,6 +33,8 @@ SOURCES += \
         DeckLinkDeviceDiscovery.cpp \
         DeckLinkOpenGLWidget.cpp \
         HDRVideoFrame.cpp \
+        ../PixelPacking/PixelPacking.cpp \
+        ../PixelPacking/PixelPackingX86.cpp \
         ../../include/DeckLinkAPIDispatch.cpp
 
 HEADERS += \
@@ -41,6 +43,8 @@ HEADERS += \
         DeckLinkDeviceDiscovery.h \
         DeckLinkOpenGLWidget.h \
         HDRVideoFrame.h \
+        ../PixelPacking/PixelPacking.h \
+        ../PixelPacking/PixelPackingKernels.h \
     com_ptr.h
 
 FORMS += \
@@ -47,7 +47,8 @@ DeckLinkOutputDevice::DeckLinkOutputDevice(QObject* owner, com_ptr<IDeckLink>& d
 	m_deckLink(deckLink),
 	m_deckLinkOutput(IID_IDeckLinkOutput, deckLink),
 	m_deckLinkConfiguration(IID_IDeckLinkConfiguration, deckLink),
-	m_deckLinkProfileManager(IID_IDeckLinkProfileManager, deckLink)  // nullptr if deckLink has only 1 profile
+	m_deckLinkProfileManager(IID_IDeckLinkProfileManager, deckLink),  // nullptr if deckLink has only 1 profile
+	m_capabilities(new DeviceCapabilityCache(deckLink.get()))
 {
 	const char* deviceNameCStr = nullptr;
 
@@ -115,10 +116,10 @@ ULONG DeckLinkOutputDevice::Release(void)
 
 /// IDeckLinkVideoOutputCallback methods
 
-HRESULT	DeckLinkOutputDevice::ScheduledFrameCompleted(IDeckLinkVideoFrame* /* completedFrame */, BMDOutputFrameCompletionResult /* result */)
+HRESULT	DeckLinkOutputDevice::ScheduledFrameCompleted(IDeckLinkVideoFrame* completedFrame, BMDOutputFrameCompletionResult /* result */)
 {
 	if (m_scheduledFrameCompletedCallback)
-		m_scheduledFrameCompletedCallback();
+		m_scheduledFrameCompletedCallback(completedFrame);
 	
 	return S_OK;
 }
@@ -161,7 +162,7 @@ void DeckLinkOutputDevice::queryDisplayModes(DisplayModeQueryFunc func)
 	while (displayModeIterator->Next(displayMode.releaseAndGetAddressOf()) == S_OK)
 	{
 		bool supported;
-		if ((m_deckLinkOutput->DoesSupportVideoMode(bmdVideoConnectionUnspecified, displayMode->GetDisplayMode(),
+		if ((m_capabilities->DoesSupportVideoMode(kDeviceCapabilityOutput, bmdVideoConnectionUnspecified, displayMode->GetDisplayMode(),
 													bmdFormatUnspecified, bmdNoVideoOutputConversion, 
 													bmdSupportedVideoModeDefault, nullptr, &supported) == S_OK) && supported)
 		{
@@ -42,16 +42,18 @@
 
 #include <atomic>
 #include <functional>
+#include <memory>
 
 #include <QObject>
 #include <QString>
 
 #include "com_ptr.h"
 #include "DeckLinkAPI.h"
+#include "DeviceCapabilityCache.h"
 
 class DeckLinkOutputDevice : public IDeckLinkVideoOutputCallback, public IDeckLinkAudioOutputCallback
 {
-	using ScheduledFrameCompletedFunc	= std::function<void(void)>;
+	using ScheduledFrameCompletedFunc	= std::function<void(IDeckLinkVideoFrame*)>;
 	using RenderAudioSamplesFunc		= std::function<void(void)>;
 	using ScheduledPlaybackStoppedFunc	= std::function<void(void)>; 
 	using DisplayModeQueryFunc			= std::function<void(com_ptr<IDeckLinkDisplayMode>&)>;
@@ -78,6 +80,7 @@ public:
 	com_ptr<IDeckLink>					getDeckLinkInstance() const { return m_deckLink; }
 	com_ptr<IDeckLinkConfiguration>		getDeviceConfiguration() const { return m_deckLinkConfiguration; }
 	com_ptr<IDeckLinkProfileManager>	getProfileManager() const { return m_deckLinkProfileManager; }
+	DeviceCapabilityCache&				getCapabilities() const { return *m_capabilities; }
 
 	void	queryDisplayModes(DisplayModeQueryFunc func);
 	void	onScheduledFrameCompleted(const ScheduledFrameCompletedFunc& callback) { m_scheduledFrameCompletedCallback = callback; }
@@ -92,6 +95,7 @@ private:
 	com_ptr<IDeckLinkOutput>			m_deckLinkOutput;
 	com_ptr<IDeckLinkConfiguration>		m_deckLinkConfiguration;
 	com_ptr<IDeckLinkProfileManager>	m_deckLinkProfileManager;
+	std::unique_ptr<DeviceCapabilityCache>	m_capabilities;
 	QString								m_deviceName;
 
 	ScheduledFrameCompletedFunc			m_scheduledFrameCompletedCallback;
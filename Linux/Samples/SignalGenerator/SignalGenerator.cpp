@@ -44,6 +44,9 @@
 #include "DeckLinkDeviceDiscovery.h"
 #include "DeckLinkOpenGLWidget.h"
 #include "ProfileCallback.h"
+#include "PixelPacking.h"
+#include "FrameConverter.h"
+#include "AudioIdent.h"
 
 #include <map>
 #include <math.h>
@@ -77,6 +80,29 @@ static const std::map<BMDPixelFormat, std::pair<QString, bool>> kPixelFormats =
 	std::make_pair(bmdFormat10BitRGB,	std::make_pair(QString("10-bit RGB"), true)),
 };
 
+// Audio idents, with a different signal on each channel so routing errors can be identified on capture
+static const std::map<AudioIdent, QString> kAudioIdents =
+{
+	std::make_pair(kAudioIdentTone,			QString("1 kHz tone")),
+	std::make_pair(kAudioIdentChannelTones,	QString("Channel tones")),
+	std::make_pair(kAudioIdentChannelBeeps,	QString("Channel beeps")),
+	std::make_pair(kAudioIdentPinkNoise,	QString("Pink noise")),
+	std::make_pair(kAudioIdentSweep,		QString("Sweep")),
+};
+
+// Output signals that are rendered every frame by the pattern generator
+static const std::map<OutputSignal, MovingPattern> kMovingPatterns =
+{
+	std::make_pair(kOutputSignalMovingBars,	kMovingPatternBars),
+	std::make_pair(kOutputSignalZonePlate,	kMovingPatternZonePlate),
+	std::make_pair(kOutputSignalNoise,		kMovingPatternNoise),
+	std::make_pair(kOutputSignalSweep,		kMovingPatternSweep),
+};
+
+// The pattern generator renders ahead into a small pool, so only part of it is prerolled
+static const uint32_t kMovingPatternFrameCount		= 8;
+static const uint32_t kMovingPatternPrerollFrames	= kMovingPatternFrameCount / 2;
+
 SignalGenerator::SignalGenerator() : QDialog(),
 	running(false),
 	selectedDisplayMode(bmdModeUnknown),
@@ -98,10 +124,19 @@ SignalGenerator::SignalGenerator() : QDialog(),
 
 	ui->outputSignalPopup->addItem("Pip", QVariant::fromValue((int)kOutputSignalPip));
 	ui->outputSignalPopup->addItem("Dropout", QVariant::fromValue((int)kOutputSignalDrop));
+	for (auto& movingPattern : kMovingPatterns)
+		ui->outputSignalPopup->addItem(PatternGenerator::GetPatternName(movingPattern.second), QVariant::fromValue((int)movingPattern.first));
 	
 	ui->audioSampleDepthPopup->addItem("16", QVariant::fromValue(16));
 	ui->audioSampleDepthPopup->addItem("32", QVariant::fromValue(32));
 
+	for (auto& audioIdent : kAudioIdents)
+	{
+		ui->audioIdentPopup->addItem(audioIdent.second, QVariant::fromValue((int)audioIdent.first));
+		if (audioIdent.first == kAudioIdentChannelTones)
+			ui->audioIdentPopup->setCurrentIndex(ui->audioIdentPopup->count() - 1);
+	}
+
 	connect(ui->startButton, &QPushButton::clicked, this, &SignalGenerator::toggleStart);
 	connect(ui->videoFormatPopup, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &SignalGenerator::videoFormatChanged);
 	connect(ui->outputDevicePopup, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &SignalGenerator::outputDeviceChanged);
@@ -217,7 +252,7 @@ void SignalGenerator::refreshPixelFormatMenu(void)
 
 		std::tie(pixelFormatString, std::ignore) = pixelFormat.second;
 
-		HRESULT hr = selectedDevice->getDeviceOutput()->DoesSupportVideoMode(bmdVideoConnectionUnspecified, selectedDisplayMode, 
+		HRESULT hr = selectedDevice->getCapabilities().DoesSupportVideoMode(kDeviceCapabilityOutput, bmdVideoConnectionUnspecified, selectedDisplayMode, 
 								pixelFormat.first, bmdNoVideoOutputConversion, bmdSupportedVideoModeDefault, nullptr, &supported);
 		if (hr != S_OK || ! supported)
 			continue;
@@ -345,6 +380,9 @@ void SignalGenerator::haltStreams(void)
 
 void SignalGenerator::updateProfile(com_ptr<IDeckLinkProfile>& /* newProfile */)
 {
+	// Supported modes depend on the profile, discard the cached results for the previous profile
+	selectedDevice->getCapabilities().Invalidate();
+
 	// Update the video mode popup menu based on new profile
 	refreshDisplayModeMenu();
 
@@ -360,16 +398,15 @@ com_ptr<IDeckLinkMutableVideoFrame> SignalGenerator::CreateOutputFrame(FillFrame
 	HRESULT									hr;
 	int										bytesPerRow;
 	int										referenceBytesPerRow;
-	com_ptr<IDeckLinkVideoConversion>		frameConverter;
+	com_ptr<FrameConverter>					frameConverter;
 
-	bytesPerRow = GetRowBytes(selectedPixelFormat, frameWidth);
-	referenceBytesPerRow = GetRowBytes(bmdFormat8BitYUV, frameWidth);
+	bytesPerRow = GetPixelFormatRowBytes(selectedPixelFormat, frameWidth);
+	referenceBytesPerRow = GetPixelFormatRowBytes(bmdFormat8BitYUV, frameWidth);
 
 	deckLinkOutput = selectedDevice->getDeviceOutput();
 
-	frameConverter = CreateVideoConversionInstance();
-	if (!frameConverter)
-		goto bail;
+	// Convert with the CPU frame converter, which does not depend on the DeckLink driver
+	frameConverter = make_com_ptr<FrameConverter>();
 
 	hr = deckLinkOutput->CreateVideoFrame(frameWidth, frameHeight, referenceBytesPerRow, bmdFormat8BitYUV, bmdFrameFlagDefault, referenceFrame.releaseAndGetAddressOf());
 	if (hr != S_OK)
@@ -412,7 +449,7 @@ void SignalGenerator::startRunning()
 		goto bail;
 
 	// When a scheduled video frame is complete, schedule next frame
-	selectedDevice->onScheduledFrameCompleted(std::bind(&SignalGenerator::scheduleNextFrame, this, false));
+	selectedDevice->onScheduledFrameCompleted(std::bind(&SignalGenerator::scheduledFrameCompleted, this, std::placeholders::_1));
 
 	// Provide further audio samples to the DeckLink API until our preferred buffer waterlevel is reached
 	selectedDevice->onRenderAudioSamples(std::bind(&SignalGenerator::writeNextAudioSamples, this));
@@ -440,6 +477,9 @@ void SignalGenerator::startRunning()
 	v = ui->audioSampleDepthPopup->itemData(ui->audioSampleDepthPopup->currentIndex());
 	audioSampleDepth = v.value<int>();
 	audioSampleRate = bmdAudioSampleRate48kHz;
+
+	v = ui->audioIdentPopup->itemData(ui->audioIdentPopup->currentIndex());
+	audioIdentGenerator.reset(new AudioIdentGenerator((AudioIdent)v.value<int>(), audioChannelCount, audioSampleDepth));
 	
 	// Get the IDeckLinkDisplayMode object associated with the selected display mode
 	if (deckLinkOutput->GetDisplayMode(selectedDisplayMode, displayMode.releaseAndGetAddressOf()) != S_OK)
@@ -504,23 +544,37 @@ void SignalGenerator::startRunning()
 	if (deckLinkOutput->EnableAudioOutput(bmdAudioSampleRate48kHz, audioSampleDepth, audioChannelCount, bmdAudioOutputStreamTimestamped) != S_OK)
 		goto bail;
 	
-	// Generate one second of audio tone
+	// Allocate one second of audio, the ident is generated into it as each second is scheduled
 	audioSamplesPerFrame = ((audioSampleRate * frameDuration) / frameTimescale);
 	audioBufferSampleLength = (framesPerSecond * audioSampleRate * frameDuration) / frameTimescale;
 	audioBuffer = malloc(audioBufferSampleLength * audioChannelCount * (audioSampleDepth / 8));
 	if (audioBuffer == nullptr)
 		goto bail;
-	FillSine(audioBuffer, audioBufferSampleLength, audioChannelCount, audioSampleDepth);
-	
-	// Generate a frame of black
-	videoFrameBlack = CreateOutputFrame(FillBlack);
-	
-	// Generate a frame of colour bars
-	videoFrameBars = CreateOutputFrame(FillColorBars);
 	
-	// Begin video preroll by scheduling a second of frames in hardware
-	for (unsigned int i = 0; i < framesPerSecond; i++)
-		scheduleNextFrame(true);
+	if (kMovingPatterns.count(outputSignal) > 0)
+	{
+		// Render a new frame of the moving pattern for every frame period, with one render thread per CPU
+		patternGenerator.reset(new PatternGenerator(deckLinkOutput.get(), frameWidth, frameHeight, selectedPixelFormat,
+													kMovingPatterns.at(outputSignal), 0, kMovingPatternFrameCount));
+		if (patternGenerator->Start() != S_OK)
+			goto bail;
+
+		// Begin video preroll with the frames that the generator has rendered ahead
+		for (unsigned int i = 0; i < kMovingPatternPrerollFrames; i++)
+			scheduleNextFrame(true);
+	}
+	else
+	{
+		// Generate a frame of black
+		videoFrameBlack = CreateOutputFrame(FillBlack);
+		
+		// Generate a frame of colour bars
+		videoFrameBars = CreateOutputFrame(FillColorBars);
+		
+		// Begin video preroll by scheduling a second of frames in hardware
+		for (unsigned int i = 0; i < framesPerSecond; i++)
+			scheduleNextFrame(true);
+	}
 	
 	// Begin audio preroll.  This will begin calling our audio callback, which will start the DeckLink output stream.
 	totalAudioSecondsScheduled = 0;
@@ -566,10 +620,23 @@ void SignalGenerator::stopRunning()
 
 	deckLinkOutput->DisableAudioOutput();
 	deckLinkOutput->DisableVideoOutput();
+
+	if (patternGenerator)
+	{
+		PatternGeneratorStatistics statistics = patternGenerator->GetStatistics();
+
+		fprintf(stderr, "Rendered %llu frames with %u threads, render time max %.2f ms, %llu frames were late\n",
+			(unsigned long long)statistics.framesRendered, statistics.threadCount,
+			statistics.maxRenderMicroseconds / 1000.0, (unsigned long long)statistics.lateFrames);
+	}
+	patternGenerator.reset();
+	videoFrameBlack = nullptr;
+	videoFrameBars = nullptr;
 	
 	if (audioBuffer != nullptr)
 		free(audioBuffer);
 	audioBuffer = nullptr;
+	audioIdentGenerator.reset();
 	
 	selectedDevice->onScheduledFrameCompleted(nullptr);
 	selectedDevice->onRenderAudioSamples(nullptr);
@@ -591,6 +658,7 @@ void SignalGenerator::scheduleNextFrame(bool prerolling)
 	bool									setVITC1Timecode = false;
 	bool									setVITC2Timecode = false;
 	unsigned long							totalFramesScheduled = timeCode->frameCount();
+	IDeckLinkVideoFrame*					patternFrame = nullptr;
 
 	deckLinkOutput = selectedDevice->getDeviceOutput();
 
@@ -601,7 +669,28 @@ void SignalGenerator::scheduleNextFrame(bool prerolling)
 			return;
 	}
 	
-	if (outputSignal == kOutputSignalPip)
+	if (patternGenerator)
+	{
+		BMDTimeValue	streamTime;
+		double			playbackSpeed;
+		int64_t			microsecondsUntilDisplay = kPatternGeneratorNoDeadline;
+
+		// The display time is only known once scheduled playback has started, so preroll frames are never late
+		if ((deckLinkOutput->GetScheduledStreamTime(frameTimescale, &streamTime, &playbackSpeed) == S_OK) && (playbackSpeed > 0.0))
+			microsecondsUntilDisplay = (int64_t)((totalFramesScheduled * frameDuration) - streamTime) * 1000000 / frameTimescale;
+
+		// The rendered frame is returned to the generator's pool when it is completed
+		if (patternGenerator->GetNextFrame(&patternFrame, microsecondsUntilDisplay) != S_OK)
+			return;
+
+		currentFrame = com_ptr<IDeckLinkMutableVideoFrame>(IID_IDeckLinkMutableVideoFrame, com_ptr<IDeckLinkVideoFrame>(patternFrame));
+		if (!currentFrame)
+		{
+			result = E_NOINTERFACE;
+			goto bail;
+		}
+	}
+	else if (outputSignal == kOutputSignalPip)
 	{
 		if ((totalFramesScheduled % framesPerSecond) == 0)
 			currentFrame = videoFrameBars;
@@ -633,7 +722,7 @@ void SignalGenerator::scheduleNextFrame(bool prerolling)
 		if (result != S_OK)
 		{
 			fprintf(stderr, "Could not set VITC timecode on frame - result = %08x\n", result);
-			return;
+			goto bail;
 		}
 	}
 	else
@@ -651,7 +740,7 @@ void SignalGenerator::scheduleNextFrame(bool prerolling)
 			if (result != S_OK)
 			{
 				fprintf(stderr, "Could not set HFRTC timecode on frame - result = %08x\n", result);
-				return;
+				goto bail;
 			}
 		}
 
@@ -659,7 +748,7 @@ void SignalGenerator::scheduleNextFrame(bool prerolling)
 		if (result != S_OK)
 		{
 			fprintf(stderr, "Could not get output display mode - result = %08x\n", result);
-			return;			
+			goto bail;
 		}
 
 		if (outputDisplayMode->GetFieldDominance() != bmdProgressiveFrame)
@@ -696,7 +785,7 @@ void SignalGenerator::scheduleNextFrame(bool prerolling)
 			if (result != S_OK)
 			{
 				fprintf(stderr, "Could not set VITC1 timecode on interlaced frame - result = %08x\n", result);
-				return;
+				goto bail;
 			}
 		}
 
@@ -712,7 +801,7 @@ void SignalGenerator::scheduleNextFrame(bool prerolling)
 			if (result != S_OK)
 			{
 				fprintf(stderr, "Could not set VITC1 timecode on interlaced frame - result = %08x\n", result);
-				return;
+				goto bail;
 			}
 		}
 	}
@@ -723,15 +812,33 @@ void SignalGenerator::scheduleNextFrame(bool prerolling)
 	if (result != S_OK)
 	{
 		fprintf(stderr, "Could not schedule video output frame - result = %08x\n", result);
-		return;
+		goto bail;
 	}
 
 	timeCode->update();
+
+bail:
+	// A frame of the moving pattern that was not scheduled goes straight back to the pool
+	if ((result != S_OK) && (patternFrame != nullptr))
+		patternGenerator->ReleaseFrame(patternFrame);
+}
+
+void SignalGenerator::scheduledFrameCompleted(IDeckLinkVideoFrame* completedFrame)
+{
+	// Return the frame of the moving pattern to the pool to be rendered again
+	if (patternGenerator)
+		patternGenerator->ReleaseFrame(completedFrame);
+
+	scheduleNextFrame(false);
 }
 
 void SignalGenerator::writeNextAudioSamples()
 {
 	// Write one second of audio to the DeckLink API.
+
+	// Generate the next second of the ident, so idents longer than a second (beeps and sweep) continue
+	// across seconds rather than restarting
+	audioIdentGenerator->Generate(audioBuffer, audioBufferSampleLength);
 	
 	if (outputSignal == kOutputSignalPip)
 	{
@@ -739,12 +846,18 @@ void SignalGenerator::writeNextAudioSamples()
 		if (selectedDevice->getDeviceOutput()->ScheduleAudioSamples(audioBuffer, audioSamplesPerFrame, (totalAudioSecondsScheduled * audioBufferSampleLength), audioSampleRate, nullptr) != S_OK)
 			return;
 	}
-	else
+	else if (outputSignal == kOutputSignalDrop)
 	{
 		// Schedule one-second (minus one frame) of audio tone
 		if (selectedDevice->getDeviceOutput()->ScheduleAudioSamples(audioBuffer, (audioBufferSampleLength - audioSamplesPerFrame), (totalAudioSecondsScheduled * audioBufferSampleLength) + audioSamplesPerFrame, audioSampleRate, nullptr) != S_OK)
 			return;
 	}
+	else
+	{
+		// Schedule one-second of continuous audio under a moving pattern
+		if (selectedDevice->getDeviceOutput()->ScheduleAudioSamples(audioBuffer, audioBufferSampleLength, (totalAudioSecondsScheduled * audioBufferSampleLength), audioSampleRate, nullptr) != S_OK)
+			return;
+	}
 	
 	totalAudioSecondsScheduled += 1;
 }
@@ -792,67 +905,6 @@ void SignalGenerator::videoFormatChanged(int videoFormatIndex)
 
 /*****************************************/
 
-int		GetRowBytes(BMDPixelFormat pixelFormat, uint32_t frameWidth)
-{
-	int bytesPerRow;
-
-	// Refer to DeckLink SDK Manual - 2.7.4 Pixel Formats
-	switch (pixelFormat)
-	{
-	case bmdFormat8BitYUV:
-		bytesPerRow = frameWidth * 2;
-		break;
-
-	case bmdFormat10BitYUV:
-		bytesPerRow = ((frameWidth + 47) / 48) * 128;
-		break;
-
-	case bmdFormat10BitRGB:
-		bytesPerRow = ((frameWidth + 63) / 64) * 256;
-		break;
-
-	case bmdFormat8BitARGB:
-	case bmdFormat8BitBGRA:
-	default:
-		bytesPerRow = frameWidth * 4;
-		break;
-	}
-
-	return bytesPerRow;
-}
-
-void	FillSine (void* audioBuffer, uint32_t samplesToWrite, uint32_t channels, uint32_t sampleDepth)
-{
-	if (sampleDepth == 16)
-	{
-		int16_t*		nextBuffer;
-		
-		nextBuffer = (int16_t*)audioBuffer;
-		for (uint32_t i = 0; i < samplesToWrite; i++)
-		{
-			int16_t		sample;
-			
-			sample = (int16_t)(24576.0 * sin((i * 2.0 * M_PI) / 48.0));
-			for (uint32_t ch = 0; ch < channels; ch++)
-				*(nextBuffer++) = sample;
-		}
-	}
-	else if (sampleDepth == 32)
-	{
-		int32_t*		nextBuffer;
-		
-		nextBuffer = (int32_t*)audioBuffer;
-		for (uint32_t i = 0; i < samplesToWrite; i++)
-		{
-			int32_t		sample;
-			
-			sample = (int32_t)(1610612736.0 * sin((i * 2.0 * M_PI) / 48.0));
-			for (uint32_t ch = 0; ch < channels; ch++)
-				*(nextBuffer++) = sample;
-		}
-	}
-}
-
 void	FillColorBars (com_ptr<IDeckLinkMutableVideoFrame>& theFrame)
 {
 	uint32_t*		nextWord;
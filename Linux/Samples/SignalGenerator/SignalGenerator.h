@@ -52,9 +52,11 @@
 #include <mutex>
 
 #include "com_ptr.h"
+#include "AudioIdent.h"
 #include "DeckLinkOpenGLWidget.h"
 #include "DeckLinkOutputDevice.h"
 #include "DeckLinkDeviceDiscovery.h"
+#include "PatternGenerator.h"
 #include "ProfileCallback.h"
 
 #include "ui_SignalGenerator.h"
@@ -110,8 +112,13 @@ private:
 
 enum OutputSignal
 {
-	kOutputSignalPip		= 0,
-	kOutputSignalDrop		= 1
+	kOutputSignalPip			= 0,
+	kOutputSignalDrop			= 1,
+	// Moving patterns render a new frame for every frame period
+	kOutputSignalMovingBars		= 2,
+	kOutputSignalZonePlate		= 3,
+	kOutputSignalNoise			= 4,
+	kOutputSignalSweep			= 5
 };
 
 class SignalGenerator : public QDialog
@@ -141,6 +148,7 @@ public:
 	uint32_t								dropFrames;
 	com_ptr<IDeckLinkMutableVideoFrame>		videoFrameBlack;
 	com_ptr<IDeckLinkMutableVideoFrame>		videoFrameBars;
+	std::unique_ptr<PatternGenerator>		patternGenerator;
 	uint32_t								totalFramesScheduled;
 	//
 	OutputSignal							outputSignal;
@@ -150,6 +158,7 @@ public:
 	uint32_t								audioChannelCount;
 	BMDAudioSampleRate						audioSampleRate;
 	uint32_t								audioSampleDepth;
+	std::unique_ptr<AudioIdentGenerator>	audioIdentGenerator;
 	uint32_t								totalAudioSecondsScheduled;
 	//
 	std::mutex								mutex;
@@ -164,6 +173,7 @@ public:
 	void setup();
 
 	void scheduleNextFrame(bool prerolling);
+	void scheduledFrameCompleted(IDeckLinkVideoFrame* completedFrame);
 	void writeNextAudioSamples();
 	void enableInterface(bool);
 
@@ -194,8 +204,6 @@ private:
 	com_ptr<IDeckLinkMutableVideoFrame> CreateOutputFrame(FillFrameFunction fillFrame);
 };
 
-int		GetRowBytes(BMDPixelFormat pixelFormat, uint32_t frameWidth);
-void	FillSine (void* audioBuffer, uint32_t samplesToWrite, uint32_t channels, uint32_t sampleDepth);
 void	FillColorBars (com_ptr<IDeckLinkMutableVideoFrame>& theFrame);
 void	FillBlack (com_ptr<IDeckLinkMutableVideoFrame>& theFrame);
 void	ScheduleNextVideoFrame (void);
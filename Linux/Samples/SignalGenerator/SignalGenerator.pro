@@ -6,7 +6,7 @@ QT       += core gui widgets
 TARGET = SignalGenerator
 TEMPLATE = app
 CONFIG += c++11
-INCLUDEPATH = ../../include
+INCLUDEPATH = ../../include ../PixelPacking ../AudioIdent ../DeviceCapabilities ../PatternGenerator
 LIBS += -ldl
 
 # The following define makes your compiler emit warnings if you use
@@ -26,7 +26,13 @@ HEADERS 	=	SignalGenerator.h \
 				DeckLinkDeviceDiscovery.h \
 				DeckLinkOutputDevice.h \
 				DeckLinkOpenGLWidget.h \
-				ProfileCallback.h
+				ProfileCallback.h \
+				../PixelPacking/FrameConverter.h \
+				../PixelPacking/PixelPacking.h \
+				../PixelPacking/PixelPackingKernels.h \
+				../AudioIdent/AudioIdent.h \
+				../PatternGenerator/PatternGenerator.h \
+				../DeviceCapabilities/DeviceCapabilityCache.h
 
 SOURCES 	= 	main.cpp \
 				../../include/DeckLinkAPIDispatch.cpp \
@@ -34,7 +40,13 @@ SOURCES 	= 	main.cpp \
 				DeckLinkOutputDevice.cpp \
 				DeckLinkOpenGLWidget.cpp \
 				SignalGenerator.cpp \
-				ProfileCallback.cpp
+				ProfileCallback.cpp \
+				../PixelPacking/FrameConverter.cpp \
+				../PixelPacking/PixelPacking.cpp \
+				../PixelPacking/PixelPackingX86.cpp \
+				../AudioIdent/AudioIdent.cpp \
+				../PatternGenerator/PatternGenerator.cpp \
+				../DeviceCapabilities/DeviceCapabilityCache.cpp
 
 FORMS 		= 	SignalGenerator.ui
 
@@ -50,9 +50,15 @@ BMDConfig::BMDConfig() :
 	m_displayModeIndex(-1),
 	m_audioChannels(2),
 	m_audioSampleDepth(16),
+	m_audioSampleBits(16),
+	m_audioIdent(kAudioIdentTone),
 	m_outputFlags(bmdVideoOutputFlagDefault),
 	m_pixelFormat(bmdFormat8BitYUV),
 	m_output444(false),
+	m_movingPattern(kMovingPatternNone),
+	m_renderThreads(0),
+	m_frameID(false),
+	m_pixelPackingBenchmark(false),
 	m_deckLinkName(),
 	m_displayModeName()
 {
@@ -72,7 +78,7 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 	int		ch;
 	bool	displayHelp = false;
 
-	while ((ch = getopt(argc, argv, "d:?h3c:s:f:a:m:n:p:t:")) != -1)
+	while ((ch = getopt(argc, argv, "d:?h3c:s:f:a:m:n:p:t:g:j:iA:B")) != -1)
 	{
 		switch (ch)
 		{
@@ -88,18 +94,30 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 				m_audioChannels = atoi(optarg);
 				if (m_audioChannels != 2 &&
 					m_audioChannels != 8 &&
-					m_audioChannels != 16)
+					m_audioChannels != 16 &&
+					m_audioChannels != 32 &&
+					m_audioChannels != 64)
 				{
-					fprintf(stderr, "Invalid argument: Audio Channels must be either 2, 8 or 16\n");
+					fprintf(stderr, "Invalid argument: Audio Channels must be either 2, 8, 16, 32 or 64\n");
 					return false;
 				}
 				break;
 
 			case 's':
-				m_audioSampleDepth = atoi(optarg);
-				if (m_audioSampleDepth != 16 && m_audioSampleDepth != 32)
+				// 24-bit samples are sent MSB-aligned in 32-bit samples
+				m_audioSampleBits = atoi(optarg);
+				if (m_audioSampleBits != 16 && m_audioSampleBits != 24 && m_audioSampleBits != 32)
 				{
-					fprintf(stderr, "Invalid argument: Audio Sample Depth must be either 16 bits or 32 bits\n");
+					fprintf(stderr, "Invalid argument: Audio Sample Depth must be either 16, 24 or 32 bits\n");
+					return false;
+				}
+				m_audioSampleDepth = (m_audioSampleBits == 16) ? 16 : 32;
+				break;
+
+			case 'A':
+				if (!AudioIdentGenerator::GetIdentFromName(optarg, m_audioIdent))
+				{
+					fprintf(stderr, "Invalid argument: Audio ident must be one of tone, channels, beeps, pink or sweep\n");
 					return false;
 				}
 				break;
@@ -110,6 +128,12 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 					case 0: m_pixelFormat = bmdFormat8BitYUV;  m_output444 = false; break;
 					case 1: m_pixelFormat = bmdFormat10BitYUV; m_output444 = false; break;
 					case 2: m_pixelFormat = bmdFormat10BitRGB; m_output444 = true;  break;
+					case 3: m_pixelFormat = bmdFormat8BitBGRA; m_output444 = true;  break;
+					case 4: m_pixelFormat = bmdFormat8BitARGB; m_output444 = true;  break;
+					case 5: m_pixelFormat = bmdFormat10BitRGBX; m_output444 = true;  break;
+					case 6: m_pixelFormat = bmdFormat10BitRGBXLE; m_output444 = true;  break;
+					case 7: m_pixelFormat = bmdFormat12BitRGB; m_output444 = true;  break;
+					case 8: m_pixelFormat = bmdFormat12BitRGBLE; m_output444 = true;  break;
 					default:
 						fprintf(stderr, "Invalid argument: Pixel format %d is not valid", atoi(optarg));
 						return false;
@@ -120,12 +144,41 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 				m_outputFlags |= bmdVideoOutputDualStream3D;
 				break;
 
+			case 'g':
+				if (!GetMovingPatternFromName(optarg, m_movingPattern))
+				{
+					fprintf(stderr, "Invalid argument: Pattern must be one of bars, zoneplate, noise or sweep\n");
+					return false;
+				}
+				break;
+
+			case 'j':
+				m_renderThreads = atoi(optarg);
+				if (m_renderThreads < 0)
+				{
+					fprintf(stderr, "Invalid argument: Render threads must be 0 or more\n");
+					return false;
+				}
+				break;
+
+			case 'i':
+				m_frameID = true;
+				break;
+
+			case 'B':
+				m_pixelPackingBenchmark = true;
+				break;
+
 			case '?':
 			case 'h':
 				displayHelp = true;
 		}
 	}
 
+	// The pixel packing self-test and benchmark don't use a device
+	if (m_pixelPackingBenchmark && !displayHelp)
+		return true;
+
 	if (m_deckLinkIndex < 0)
 	{
 		fprintf(stderr, "You must select a device\n");
@@ -141,6 +194,16 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 	if (displayHelp)
 		DisplayUsage(0);
 
+	// The frame ID is different for every frame, so it needs a pattern rendered every frame
+	if (m_frameID && (m_movingPattern == kMovingPatternNone))
+		m_movingPattern = kMovingPatternBars;
+
+	if ((m_movingPattern != kMovingPatternNone) && (m_outputFlags & bmdVideoOutputDualStream3D))
+	{
+		fprintf(stderr, "Moving patterns are not supported with 3D playback\n");
+		return false;
+	}
+
 	// Get device and display mode names
 	IDeckLink *deckLink = GetDeckLink(m_deckLinkIndex);
 	if (deckLink != NULL)
@@ -248,6 +311,7 @@ void BMDConfig::DisplayUsage(int status)
 
 	fprintf(stderr,
 		"Usage: TestPattern -d <device id> -m <mode id> [OPTIONS]\n"
+		"       TestPattern -B\n"
 		"\n"
 		"    -d <device id>:\n"
 	);
@@ -340,13 +404,36 @@ bail:
 		"         0:  8 bit YUV (4:2:2) (default)\n"
 		"         1:  10 bit YUV (4:2:2)\n"
 		"         2:  10 bit RGB (4:4:4)\n"
-		"    -c <channels>        Audio Channels (2, 8 or 16 - default is 2)\n"
-		"    -s <depth>           Audio Sample Depth (16 or 32 - default is 16)\n"
+		"         3:  8 bit BGRA (4:4:4)\n"
+		"         4:  8 bit ARGB (4:4:4)\n"
+		"         5:  10 bit RGBX (4:4:4)\n"
+		"         6:  10 bit RGBX little-endian (4:4:4)\n"
+		"         7:  12 bit RGB (4:4:4)\n"
+		"         8:  12 bit RGB little-endian (4:4:4)\n"
+		"    -g <pattern>         Render a new frame every frame period with a moving pattern\n"
+		"                         (bars, zoneplate, noise or sweep - default is static colour bars)\n"
+		"    -j <threads>         Moving pattern render threads (default is 0 - one per CPU)\n"
+		"    -i                   Embed a frame ID code (frame number and output time) at the top of\n"
+		"                         each frame, for Capture -i to measure latency and dropped frames\n"
+		"                         (implies -g bars if no pattern is selected)\n"
+		"    -c <channels>        Audio Channels (2, 8, 16, 32 or 64 - default is 2)\n"
+		"    -s <depth>           Audio Sample Depth (16, 24 or 32 - default is 16)\n"
+		"    -A <ident>           Audio ident, different on each channel to identify routing errors\n"
+		"                         tone:     1 kHz on every channel (default)\n"
+		"                         channels: 500 Hz + 250 Hz per channel\n"
+		"                         beeps:    1 kHz, channel n beeps n times\n"
+		"                         pink:     Uncorrelated pink noise\n"
+		"                         sweep:    20 Hz to 20 kHz sweep, offset on each channel\n"
 		"    -3                   Playback Stereoscopic 3D (Requires 3D Hardware support)\n"
+		"    -B                   Test the pixel packing kernels against the scalar reference and benchmark\n"
+		"                         them in Gpixels/s, without a DeckLink device\n"
 		"\n"
 		"Output a test pattern eg:\n"
 		"\n"
 		"    TestPattern -d 0 -m 2 \n"
+		"    TestPattern -d 0 -m 2 -p 1 -g zoneplate\n"
+		"    TestPattern -d 0 -m 2 -p 1 -i\n"
+		"    TestPattern -B\n"
 	);
 
 	if (deckLinkIterator != NULL)
@@ -370,14 +457,19 @@ void BMDConfig::DisplayConfiguration()
 		" - Playback device: %s\n"
 		" - Video mode: %s %s\n"
 		" - Pixel format: %s\n"
+		" - Pattern: %s%s\n"
 		" - Audio channels: %u\n"
-		" - Audio sample depth: %u bit \n",
+		" - Audio sample depth: %u bit \n"
+		" - Audio ident: %s\n",
 		m_deckLinkName,
 		m_displayModeName,
 		(m_outputFlags & bmdVideoOutputDualStream3D) ? "3D" : "",
 		GetPixelFormatName(m_pixelFormat),
+		PatternGenerator::GetPatternName(m_movingPattern),
+		m_frameID ? " with frame ID" : "",
 		m_audioChannels,
-		m_audioSampleDepth
+		m_audioSampleBits,
+		AudioIdentGenerator::GetIdentName(m_audioIdent)
 	);
 }
 
@@ -391,7 +483,35 @@ const char* BMDConfig::GetPixelFormatName(BMDPixelFormat pixelFormat)
 			return "10 bit YUV (4:2:2)";
 		case bmdFormat10BitRGB:
 			return "10 bit RGB (4:4:4)";
+		case bmdFormat8BitBGRA:
+			return "8 bit BGRA (4:4:4)";
+		case bmdFormat8BitARGB:
+			return "8 bit ARGB (4:4:4)";
+		case bmdFormat10BitRGBX:
+			return "10 bit RGBX (4:4:4)";
+		case bmdFormat10BitRGBXLE:
+			return "10 bit RGBX little-endian (4:4:4)";
+		case bmdFormat12BitRGB:
+			return "12 bit RGB (4:4:4)";
+		case bmdFormat12BitRGBLE:
+			return "12 bit RGB little-endian (4:4:4)";
 	}
 	return "unknown";
 }
 
+bool BMDConfig::GetMovingPatternFromName(const char* name, MovingPattern& pattern)
+{
+	if (strcmp(name, "bars") == 0)
+		pattern = kMovingPatternBars;
+	else if (strcmp(name, "zoneplate") == 0)
+		pattern = kMovingPatternZonePlate;
+	else if (strcmp(name, "noise") == 0)
+		pattern = kMovingPatternNoise;
+	else if (strcmp(name, "sweep") == 0)
+		pattern = kMovingPatternSweep;
+	else
+		return false;
+
+	return true;
+}
+
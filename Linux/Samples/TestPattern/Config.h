@@ -42,6 +42,8 @@
 #define BMD_CONFIG_H
 
 #include "DeckLinkAPI.h"
+#include "PatternGenerator.h"
+#include "AudioIdent.h"
 
 class BMDConfig
 {
@@ -57,12 +59,19 @@ public:
 	int						m_displayModeIndex;
 
 	int						m_audioChannels;
-	int						m_audioSampleDepth;
+	int						m_audioSampleDepth;		// Sample size of the DeckLink API, 16 or 32
+	int						m_audioSampleBits;		// Bits generated, 16, 24 or 32
+	AudioIdent				m_audioIdent;
 
 	BMDVideoOutputFlags		m_outputFlags;
 	BMDPixelFormat			m_pixelFormat;
 	bool					m_output444;
 
+	MovingPattern			m_movingPattern;
+	int						m_renderThreads;
+	bool					m_frameID;
+	bool					m_pixelPackingBenchmark;
+
 	const char*				m_videoOutputFile;
 	const char*				m_audioOutputFile;
 
@@ -71,6 +80,7 @@ private:
 	char*					m_displayModeName;
 
 	static const char* GetPixelFormatName(BMDPixelFormat pixelFormat);
+	static bool GetMovingPatternFromName(const char* name, MovingPattern& pattern);
 
 	IDeckLink* GetDeckLink(int idx);
 	IDeckLinkDisplayMode* GetDeckLinkDisplayMode(IDeckLink* deckLink, int idx);
@@ -38,6 +38,7 @@
 ** -LICENSE-END-
 */
 
+#include <algorithm>
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
@@ -54,6 +55,9 @@
 
 #include "TestPattern.h"
 #include "VideoFrame3D.h"
+#include "PixelPacking.h"
+#include "PixelPackingBenchmark.h"
+#include "DeviceCapabilityCache.h"
 
 pthread_mutex_t			sleepMutex;
 pthread_cond_t			sleepCond;
@@ -61,6 +65,20 @@ bool					do_exit = false;
 
 const unsigned long		kAudioWaterlevel = 48000;
 
+// Moving patterns are rendered into a pool of frames, half of which are prerolled, leaving the
+// other half for the generator to render ahead
+const uint32_t			kMovingPatternFrameCount = 8;
+const uint32_t			kMovingPatternPrerollFrames = kMovingPatternFrameCount / 2;
+
+// Output frames are allocated from a pool large enough for the moving pattern frames, or the
+// black and (stereoscopic) colour bar frames, plus the reference frame used for conversion
+const uint32_t			kOutputFramePoolSize = kMovingPatternFrameCount + 4;
+
+// TestPattern -B measures each pixel format and implementation on HD frames for this long
+const uint32_t			kPixelPackingBenchmarkWidth = 1920;
+const uint32_t			kPixelPackingBenchmarkHeight = 1080;
+const double			kPixelPackingBenchmarkSeconds = 0.25;
+
 void sigfunc(int signum)
 {
 	if (signum == SIGINT || signum == SIGTERM) {
@@ -88,6 +106,18 @@ int main(int argc, char *argv[])
 		goto bail;
 	}
 
+	if (config.m_pixelPackingBenchmark)
+	{
+		if (!RunPixelPackingSelfTest())
+			goto bail;
+
+		printf("\n");
+		RunPixelPackingBenchmark(kPixelPackingBenchmarkWidth, kPixelPackingBenchmarkHeight, kPixelPackingBenchmarkSeconds);
+
+		exitStatus = 0;
+		goto bail;
+	}
+
 	generator = new TestPattern(&config);
 
 	if (!generator->Run())
@@ -119,7 +149,10 @@ TestPattern::TestPattern(BMDConfig *config) :
 	m_displayMode(),
 	m_videoFrameBlack(),
 	m_videoFrameBars(),
+	m_patternGenerator(),
+	m_frameAllocator(),
 	m_outputSignal(kOutputSignalDrop),
+	m_audioIdentGenerator(),
 	m_audioBuffer(),
 	m_audioSampleRate(bmdAudioSampleRate48kHz)
 {
@@ -205,6 +238,25 @@ bool TestPattern::Run()
 		goto bail;
 	}
 
+	// Check the pixel format is supported in the display mode, answered by the capability cache
+	// without querying the driver if it was checked on a previous run
+	{
+		DeviceCapabilityCache		capabilities(m_deckLink);
+		BMDSupportedVideoModeFlags	supportedVideoModeFlags = bmdSupportedVideoModeDefault;
+		bool						supported = false;
+
+		if (m_config->m_outputFlags & bmdVideoOutputDualStream3D)
+			supportedVideoModeFlags = bmdSupportedVideoModeDualStream3D;
+
+		result = capabilities.DoesSupportVideoMode(kDeviceCapabilityOutput, bmdVideoConnectionUnspecified, m_displayMode->GetDisplayMode(),
+												   m_config->m_pixelFormat, bmdNoVideoOutputConversion, supportedVideoModeFlags, NULL, &supported);
+		if (result != S_OK || !supported)
+		{
+			fprintf(stderr, "The display mode %s is not supported with the selected pixel format\n", displayModeName);
+			goto bail;
+		}
+	}
+
 	m_config->DisplayConfiguration();
 
 	// Provide this class as a delegate to the audio and video output interfaces
@@ -257,7 +309,7 @@ bail:
 void TestPattern::StartRunning()
 {
 	HRESULT					result;
-	unsigned long			audioSamplesPerFrame;
+	unsigned long			prerollFrames;
 	IDeckLinkVideoFrame*	rightFrame;
 	VideoFrame3D*			frame3D;
 
@@ -277,6 +329,15 @@ void TestPattern::StartRunning()
 		goto bail;
 	}
 
+	// Allocate output frames from a pool, this must be set before the video output is enabled
+	m_frameAllocator = new PooledFrameAllocator(kOutputFramePoolSize);
+	result = m_deckLinkOutput->SetVideoOutputFrameMemoryAllocator(m_frameAllocator);
+	if (result != S_OK)
+	{
+		fprintf(stderr, "Failed to set video output frame allocator\n");
+		goto bail;
+	}
+
 	// Set the video output mode
 	result = m_deckLinkOutput->EnableVideoOutput(m_displayMode->GetDisplayMode(), m_config->m_outputFlags);
 	if (result != S_OK)
@@ -293,9 +354,10 @@ void TestPattern::StartRunning()
 		goto bail;
 	}
 
-	// Generate one second of audio
-	m_audioBufferSampleLength = (unsigned long)((m_framesPerSecond * m_audioSampleRate * m_frameDuration) / m_frameTimescale);
-	m_audioBuffer = valloc(m_audioBufferSampleLength * m_config->m_audioChannels * (m_config->m_audioSampleDepth / 8));
+	// Audio is generated as it is scheduled, in a cycle of one second of frames matching the video
+	m_audioCycleLength = (unsigned long)((m_framesPerSecond * m_audioSampleRate * m_frameDuration) / m_frameTimescale);
+	m_audioSamplesPerFrame = (unsigned long)((m_audioSampleRate * m_frameDuration) / m_frameTimescale);
+	m_audioBuffer = valloc(kAudioWaterlevel * m_config->m_audioChannels * (m_config->m_audioSampleDepth / 8));
 
 	if (m_audioBuffer == NULL)
 	{
@@ -303,52 +365,62 @@ void TestPattern::StartRunning()
 		goto bail;
 	}
 
-	// Zero the buffer (interpreted as audio silence)
-	memset(m_audioBuffer, 0x0, (m_audioBufferSampleLength * m_config->m_audioChannels * m_config->m_audioSampleDepth / 8));
-	audioSamplesPerFrame = (unsigned long)((m_audioSampleRate * m_frameDuration) / m_frameTimescale);
-
-	if (m_outputSignal == kOutputSignalPip)
-		FillSine(m_audioBuffer, audioSamplesPerFrame, m_config->m_audioChannels, m_config->m_audioSampleDepth);
-	else
-		FillSine((void*)((unsigned long)m_audioBuffer + (audioSamplesPerFrame * m_config->m_audioChannels * m_config->m_audioSampleDepth / 8)), (m_audioBufferSampleLength - audioSamplesPerFrame), m_config->m_audioChannels, m_config->m_audioSampleDepth);
-
-	// Generate a frame of black
-	if (CreateFrame(&m_videoFrameBlack, FillBlack) != S_OK)
-		goto bail;
+	m_audioIdentGenerator = new AudioIdentGenerator(m_config->m_audioIdent, m_config->m_audioChannels, m_config->m_audioSampleBits);
 
-	if (m_config->m_outputFlags & bmdVideoOutputDualStream3D)
+	if (m_config->m_movingPattern != kMovingPatternNone)
 	{
-		frame3D = new VideoFrame3D(m_videoFrameBlack);
-		m_videoFrameBlack->Release();
-		m_videoFrameBlack = frame3D;
-		frame3D = NULL;
+		// Render a new frame of the moving pattern for every frame period
+		m_patternGenerator = new PatternGenerator(m_deckLinkOutput, m_frameWidth, m_frameHeight, m_config->m_pixelFormat,
+													m_config->m_movingPattern, m_config->m_renderThreads, kMovingPatternFrameCount);
+		if (m_patternGenerator->Start() != S_OK)
+			goto bail;
+
+		prerollFrames = kMovingPatternPrerollFrames;
 	}
+	else
+	{
+		// Generate a frame of black
+		if (CreateFrame(&m_videoFrameBlack, FillBlack) != S_OK)
+			goto bail;
 
-	// Generate a frame of colour bars
-	if (CreateFrame(&m_videoFrameBars, FillForwardColourBars) != S_OK)
-		goto bail;
+		if (m_config->m_outputFlags & bmdVideoOutputDualStream3D)
+		{
+			frame3D = new VideoFrame3D(m_videoFrameBlack);
+			m_videoFrameBlack->Release();
+			m_videoFrameBlack = frame3D;
+			frame3D = NULL;
+		}
 
-	if (m_config->m_outputFlags & bmdVideoOutputDualStream3D)
-	{
-		if (CreateFrame(&rightFrame, FillReverseColourBars) != S_OK)
+		// Generate a frame of colour bars
+		if (CreateFrame(&m_videoFrameBars, FillForwardColourBars) != S_OK)
 			goto bail;
 
-		frame3D = new VideoFrame3D(m_videoFrameBars, rightFrame);
-		m_videoFrameBars->Release();
-		rightFrame->Release();
-		m_videoFrameBars = frame3D;
-		frame3D = NULL;
+		if (m_config->m_outputFlags & bmdVideoOutputDualStream3D)
+		{
+			if (CreateFrame(&rightFrame, FillReverseColourBars) != S_OK)
+				goto bail;
+
+			frame3D = new VideoFrame3D(m_videoFrameBars, rightFrame);
+			m_videoFrameBars->Release();
+			rightFrame->Release();
+			m_videoFrameBars = frame3D;
+			frame3D = NULL;
+		}
+
+		prerollFrames = m_framesPerSecond;
 	}
 
-	// Begin video preroll by scheduling a second of frames in hardware
+	// Begin video preroll by scheduling a second of frames in hardware, or the prerolled frames of the moving pattern pool
 	m_totalFramesScheduled = 0;
 	m_totalFramesDropped = 0;
 	m_totalFramesCompleted = 0;
-	for (unsigned i = 0; i < m_framesPerSecond; i++)
+	for (unsigned i = 0; i < prerollFrames; i++)
 		ScheduleNextFrame(true);
 
 	// Begin audio preroll.  This will begin calling our audio callback, which will start the DeckLink output stream.
-	m_audioBufferOffset = 0;
+	m_audioIdentGenerator->Reset();
+	m_audioPendingSamples = 0;
+	m_audioCyclePosition = 0;
 	if (m_deckLinkOutput->BeginAudioPreroll() != S_OK)
 	{
 		fprintf(stderr, "Failed to begin audio preroll\n");
@@ -381,6 +453,13 @@ void TestPattern::StopRunning()
 	m_deckLinkOutput->DisableAudioOutput();
 	m_deckLinkOutput->DisableVideoOutput();
 
+	if (m_patternGenerator != NULL)
+	{
+		PrintPatternStatistics();
+		delete m_patternGenerator;
+	}
+	m_patternGenerator = NULL;
+
 	if (m_videoFrameBlack != NULL)
 		m_videoFrameBlack->Release();
 	m_videoFrameBlack = NULL;
@@ -389,9 +468,43 @@ void TestPattern::StopRunning()
 		m_videoFrameBars->Release();
 	m_videoFrameBars = NULL;
 
+	if (m_frameAllocator != NULL)
+	{
+		PrintAllocatorStatistics();
+		m_frameAllocator->Release();
+	}
+	m_frameAllocator = NULL;
+
 	if (m_audioBuffer != NULL)
 		free(m_audioBuffer);
 	m_audioBuffer = NULL;
+
+	if (m_audioIdentGenerator != NULL)
+		delete m_audioIdentGenerator;
+	m_audioIdentGenerator = NULL;
+}
+
+int64_t TestPattern::GetMicrosecondsUntilDisplay(BMDTimeValue displayTime)
+{
+	BMDTimeValue	streamTime;
+	double			playbackSpeed;
+
+	// The output time is only known once scheduled playback has started, preroll frames have no display time
+	if ((m_deckLinkOutput->GetScheduledStreamTime(m_frameTimescale, &streamTime, &playbackSpeed) != S_OK) || (playbackSpeed <= 0.0))
+		return kPatternGeneratorNoDeadline;
+
+	// Negative if the frame is already late
+	return (int64_t)(displayTime - streamTime) * 1000000 / m_frameTimescale;
+}
+
+uint64_t TestPattern::GetFrameOutputTimestamp(BMDTimeValue displayTime)
+{
+	int64_t timeUntilDisplay = GetMicrosecondsUntilDisplay(displayTime);
+
+	if (timeUntilDisplay == kPatternGeneratorNoDeadline)
+		return kFrameIDNoTimestamp;
+
+	return (uint64_t)((int64_t)GetFrameIDTimestamp() + timeUntilDisplay);
 }
 
 void TestPattern::ScheduleNextFrame(bool prerolling)
@@ -403,7 +516,27 @@ void TestPattern::ScheduleNextFrame(bool prerolling)
 		if (m_running == false)
 			return;
 	}
-	if (m_outputSignal == kOutputSignalPip)
+	if (m_patternGenerator != NULL)
+	{
+		IDeckLinkVideoFrame* patternFrame;
+
+		// Schedule the next rendered frame of the moving pattern, it is returned to the pool on completion
+		if (m_patternGenerator->GetNextFrame(&patternFrame, GetMicrosecondsUntilDisplay(m_totalFramesScheduled * m_frameDuration)) != S_OK)
+			return;
+
+		if (m_config->m_frameID)
+		{
+			FrameID frameID = { (uint32_t)m_totalFramesScheduled, GetFrameOutputTimestamp(m_totalFramesScheduled * m_frameDuration) };
+			WriteFrameID(patternFrame, frameID);
+		}
+
+		if (m_deckLinkOutput->ScheduleVideoFrame(patternFrame, (m_totalFramesScheduled * m_frameDuration), m_frameDuration, m_frameTimescale) != S_OK)
+		{
+			m_patternGenerator->ReleaseFrame(patternFrame);
+			return;
+		}
+	}
+	else if (m_outputSignal == kOutputSignalPip)
 	{
 		if ((m_totalFramesScheduled % m_framesPerSecond) == 0)
 		{
@@ -444,27 +577,67 @@ void TestPattern::WriteNextAudioSamples()
 	// Try to maintain the number of audio samples buffered in the API at a specified waterlevel
 	if ((m_deckLinkOutput->GetBufferedAudioSampleFrameCount(&bufferedSamples) == S_OK) && (bufferedSamples < kAudioWaterlevel))
 	{
-		unsigned int		samplesToEndOfBuffer;
+		unsigned long		sampleFrameBytes = m_config->m_audioChannels * m_config->m_audioSampleDepth / 8;
 		unsigned int		samplesToWrite;
 		unsigned int		samplesWritten;
 
-		samplesToEndOfBuffer = (m_audioBufferSampleLength - m_audioBufferOffset);
+		// Samples not accepted by the last call are still at the start of the buffer
 		samplesToWrite = (kAudioWaterlevel - bufferedSamples);
-		if (samplesToWrite > samplesToEndOfBuffer)
-			samplesToWrite = samplesToEndOfBuffer;
+		if (samplesToWrite > m_audioPendingSamples)
+		{
+			GenerateAudioSamples((uint8_t*)m_audioBuffer + m_audioPendingSamples * sampleFrameBytes, samplesToWrite - m_audioPendingSamples);
+			m_audioPendingSamples = samplesToWrite;
+		}
 
-		if (m_deckLinkOutput->ScheduleAudioSamples((void*)((unsigned long)m_audioBuffer + (m_audioBufferOffset * m_config->m_audioChannels * m_config->m_audioSampleDepth / 8)), samplesToWrite, 0, 0, &samplesWritten) == S_OK)
+		if (m_deckLinkOutput->ScheduleAudioSamples(m_audioBuffer, m_audioPendingSamples, 0, 0, &samplesWritten) == S_OK)
 		{
-			m_audioBufferOffset = ((m_audioBufferOffset + samplesWritten) % m_audioBufferSampleLength);
+			m_audioPendingSamples -= samplesWritten;
+			memmove(m_audioBuffer, (uint8_t*)m_audioBuffer + samplesWritten * sampleFrameBytes, m_audioPendingSamples * sampleFrameBytes);
 		}
 	}
 }
 
+void TestPattern::GenerateAudioSamples(void* buffer, unsigned long sampleFrameCount)
+{
+	unsigned long		sampleFrameBytes = m_config->m_audioChannels * m_config->m_audioSampleDepth / 8;
+	uint8_t*			samples = (uint8_t*)buffer;
+
+	while (sampleFrameCount > 0)
+	{
+		unsigned long	count = std::min(sampleFrameCount, m_audioCycleLength - m_audioCyclePosition);
+		unsigned long	end = m_audioCyclePosition + count;
+		unsigned long	toneStart;
+		unsigned long	toneEnd;
+
+		// Each pip starts the ident from the beginning, so every burst is the same and starts at zero
+		if (m_outputSignal == kOutputSignalPip && m_audioCyclePosition == 0)
+			m_audioIdentGenerator->Reset();
+
+		m_audioIdentGenerator->Generate(samples, count);
+
+		// Silence outside the tone, which is the first frame of the cycle for pip, or the rest of the cycle for drop
+		toneStart	= (m_outputSignal == kOutputSignalPip) ? 0 : m_audioSamplesPerFrame;
+		toneEnd		= (m_outputSignal == kOutputSignalPip) ? m_audioSamplesPerFrame : m_audioCycleLength;
+
+		if (m_audioCyclePosition < toneStart)
+			memset(samples, 0, (std::min(end, toneStart) - m_audioCyclePosition) * sampleFrameBytes);
+		if (end > toneEnd)
+		{
+			unsigned long silenceStart = std::max(m_audioCyclePosition, toneEnd);
+			memset(samples + (silenceStart - m_audioCyclePosition) * sampleFrameBytes, 0, (end - silenceStart) * sampleFrameBytes);
+		}
+
+		m_audioCyclePosition	= end % m_audioCycleLength;
+		samples					+= count * sampleFrameBytes;
+		sampleFrameCount		-= count;
+	}
+}
+
 HRESULT TestPattern::CreateFrame(IDeckLinkVideoFrame** frame, void (*fillFunc)(IDeckLinkVideoFrame*))
 {
 	HRESULT						result;
-	int							bytesPerRow = GetRowBytes(m_config->m_pixelFormat, m_frameWidth);
-	int							referenceBytesPerRow = GetRowBytes(bmdFormat8BitYUV, m_frameWidth);
+	int							bytesPerRow = GetPixelFormatRowBytes(m_config->m_pixelFormat, m_frameWidth);
+	int							referenceBytesPerRow = GetPixelFormatRowBytes(bmdFormat8BitYUV, m_frameWidth);
 	IDeckLinkMutableVideoFrame*	newFrame = NULL;
 	IDeckLinkMutableVideoFrame*	referenceFrame = NULL;
 	IDeckLinkVideoConversion*	frameConverter = NULL;
@@ -495,6 +668,12 @@ HRESULT TestPattern::CreateFrame(IDeckLinkVideoFrame** frame, void (*fillFunc)(I
 		fillFunc(referenceFrame);
 
 		frameConverter = CreateVideoConversionInstance();
+		if (frameConverter == NULL)
+		{
+			fprintf(stderr, "Failed to create video conversion instance\n");
+			result = E_FAIL;
+			goto bail;
+		}
 
 		result = frameConverter->ConvertFrame(referenceFrame, newFrame);
 		if (result != S_OK)
@@ -522,8 +701,46 @@ bail:
 
 void TestPattern::PrintStatusLine()
 {
-	printf("\rscheduled %-16lu completed %-16lu dropped %-16lu\r",
-		m_totalFramesScheduled, m_totalFramesCompleted, m_totalFramesDropped);
+	if (m_patternGenerator != NULL)
+	{
+		PatternGeneratorStatistics statistics = m_patternGenerator->GetStatistics();
+
+		printf("\rscheduled %-10lu completed %-10lu dropped %-10lu late %-8llu render %6.2f ms\r",
+			m_totalFramesScheduled, m_totalFramesCompleted, m_totalFramesDropped,
+			(unsigned long long)statistics.lateFrames, statistics.lastRenderMicroseconds / 1000.0);
+	}
+	else
+	{
+		printf("\rscheduled %-16lu completed %-16lu dropped %-16lu\r",
+			m_totalFramesScheduled, m_totalFramesCompleted, m_totalFramesDropped);
+	}
+}
+
+void TestPattern::PrintPatternStatistics()
+{
+	PatternGeneratorStatistics	statistics = m_patternGenerator->GetStatistics();
+	double						framePeriodMilliseconds = 1000.0 * m_frameDuration / m_frameTimescale;
+	double						meanRenderMilliseconds = statistics.framesRendered ? statistics.totalRenderMicroseconds / 1000.0 / statistics.framesRendered : 0.0;
+
+	fprintf(stderr, "\nRendered %llu frames with %u threads, render time mean %.2f ms, max %.2f ms, frame period %.2f ms\n",
+		(unsigned long long)statistics.framesRendered, statistics.threadCount,
+		meanRenderMilliseconds, statistics.maxRenderMicroseconds / 1000.0, framePeriodMilliseconds);
+
+	if (statistics.lateFrames > 0)
+		fprintf(stderr, "Pattern generation did not keep up with the frame rate, %llu frames were late\n",
+			(unsigned long long)statistics.lateFrames);
+	else
+		fprintf(stderr, "Pattern generation kept up with the frame rate\n");
+}
+
+void TestPattern::PrintAllocatorStatistics()
+{
+	PooledFrameAllocatorStatistics	statistics = m_frameAllocator->getStatistics();
+
+	fprintf(stderr, "Output frame allocator: pooled %llu, heap %llu, slabs %llu, peak in use %u%s\n",
+		(unsigned long long)statistics.poolAllocations, (unsigned long long)statistics.fallbackAllocations,
+		(unsigned long long)statistics.slabAllocations, statistics.peakBuffersInUse,
+		statistics.fallbackAllocations > 0 ? " (increase kOutputFramePoolSize)" : "");
 }
 
 /************************* DeckLink API Delegate Methods *****************************/
@@ -552,7 +769,15 @@ ULONG TestPattern::Release()
 
 HRESULT TestPattern::ScheduledFrameCompleted(IDeckLinkVideoFrame* completedFrame, BMDOutputFrameCompletionResult result)
 {
+	if ((result == bmdOutputFrameDisplayedLate) || (result == bmdOutputFrameDropped))
+		++m_totalFramesDropped;
+
 	++m_totalFramesCompleted;
+
+	// Return the frame of the moving pattern to the pool to be rendered again
+	if (m_patternGenerator != NULL)
+		m_patternGenerator->ReleaseFrame(completedFrame);
+
 	PrintStatusLine();
 
 	// When a video frame has been released by the API, schedule another video frame to be output
@@ -585,38 +810,6 @@ HRESULT TestPattern::RenderAudioSamples(bool preroll)
 
 /*****************************************/
 
-void FillSine(void* audioBuffer, unsigned long samplesToWrite, unsigned long channels, unsigned long sampleDepth)
-{
-	if (sampleDepth == 16)
-	{
-		short*		nextBuffer;
-
-		nextBuffer = (short*)audioBuffer;
-		for (unsigned i = 0; i < samplesToWrite; i++)
-		{
-			short		sample;
-
-			sample = (short)(24576.0 * sin((i * 2.0 * M_PI) / 48.0));
-			for (unsigned ch = 0; ch < channels; ch++)
-				*(nextBuffer++) = sample;
-		}
-	}
-	else if (sampleDepth == 32)
-	{
-		int*		nextBuffer;
-
-		nextBuffer = (int*)audioBuffer;
-		for (unsigned i = 0; i < samplesToWrite; i++)
-		{
-			int		sample;
-
-			sample = (int)(1610612736.0 * sin((i * 2.0 * M_PI) / 48.0));
-			for (unsigned ch = 0; ch < channels; ch++)
-				*(nextBuffer++) = sample;
-		}
-	}
-}
-
 void FillColourBars(IDeckLinkVideoFrame* theFrame, bool reverse)
 {
 	unsigned int*	nextWord;
@@ -666,33 +859,3 @@ void FillBlack(IDeckLinkVideoFrame* theFrame)
 	while (wordsRemaining-- > 0)
 		*(nextWord++) = 0x10801080;
 }
-
-int GetRowBytes(BMDPixelFormat pixelFormat, int frameWidth)
-{
-	int bytesPerRow;
-
-	// Refer to DeckLink SDK Manual - 2.7.4 Pixel Formats
-	switch (pixelFormat)
-	{
-	case bmdFormat8BitYUV:
-		bytesPerRow = frameWidth * 2;
-		break;
-
-	case bmdFormat10BitYUV:
-		bytesPerRow = ((frameWidth + 47) / 48) * 128;
-		break;
-
-	case bmdFormat10BitRGB:
-		bytesPerRow = ((frameWidth + 63) / 64) * 256;
-		break;
-
-	case bmdFormat8BitARGB:
-	case bmdFormat8BitBGRA:
-	default:
-		bytesPerRow = frameWidth * 4;
-		break;
-	}
-
-	return bytesPerRow;
-}
-
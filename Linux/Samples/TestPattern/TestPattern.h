@@ -43,6 +43,9 @@
 
 #include "DeckLinkAPI.h"
 #include "Config.h"
+#include "FrameID.h"
+#include "PatternGenerator.h"
+#include "PooledFrameAllocator.h"
 
 enum OutputSignal
 {
@@ -69,14 +72,19 @@ private:
 	unsigned long			m_framesPerSecond;
 	IDeckLinkVideoFrame*	m_videoFrameBlack;
 	IDeckLinkVideoFrame*	m_videoFrameBars;
+	PatternGenerator*		m_patternGenerator;
+	PooledFrameAllocator*	m_frameAllocator;
 	unsigned long			m_totalFramesScheduled;
 	unsigned long			m_totalFramesDropped;
 	unsigned long			m_totalFramesCompleted;
 
 	OutputSignal			m_outputSignal;
+	AudioIdentGenerator*	m_audioIdentGenerator;
 	void*					m_audioBuffer;
-	unsigned long			m_audioBufferSampleLength;
-	unsigned long			m_audioBufferOffset;
+	unsigned long			m_audioPendingSamples;		// Generated but not yet scheduled, at the start of m_audioBuffer
+	unsigned long			m_audioCycleLength;			// The tone is on for one frame, or off for one frame, of each cycle
+	unsigned long			m_audioCyclePosition;
+	unsigned long			m_audioSamplesPerFrame;
 	BMDAudioSampleRate		m_audioSampleRate;
 
 	std::mutex				m_mutex;
@@ -88,9 +96,14 @@ private:
 	void			StartRunning();
 	void			StopRunning();
 	void			ScheduleNextFrame(bool prerolling);
+	int64_t			GetMicrosecondsUntilDisplay(BMDTimeValue displayTime);
+	uint64_t		GetFrameOutputTimestamp(BMDTimeValue displayTime);
 	void			WriteNextAudioSamples();
+	void			GenerateAudioSamples(void* buffer, unsigned long sampleFrameCount);
 
 	void			PrintStatusLine();
+	void			PrintPatternStatistics();
+	void			PrintAllocatorStatistics();
 
 public:
 	TestPattern(BMDConfig *config);
@@ -110,7 +123,6 @@ public:
 	HRESULT CreateFrame(IDeckLinkVideoFrame** theFrame, void (*fillFunc)(IDeckLinkVideoFrame*));
 };
 
-void FillSine(void* audioBuffer, unsigned long samplesToWrite, unsigned long channels, unsigned long sampleDepth);
 void FillColourBars(IDeckLinkVideoFrame* theFrame, bool reverse);
 static inline void FillForwardColourBars(IDeckLinkVideoFrame* theFrame)
 {
@@ -121,4 +133,3 @@ static inline void FillReverseColourBars(IDeckLinkVideoFrame* theFrame)
 	FillColourBars(theFrame, true);
 }
 void FillBlack(IDeckLinkVideoFrame* theFrame);
-int GetRowBytes(BMDPixelFormat pixelFormat, int frameWidth);
@@ -0,0 +1,100 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+#include "DeckLinkAPI.h"
+
+// The hardware reference clock of the virtual devices is CLOCK_MONOTONIC_RAW, the same clock
+// sampled by ReferenceTime::getSteadyClockUptimeCount() in the samples, so that hardware
+// timestamps and application timestamps can be compared directly.
+namespace VirtualClock
+{
+	static const int64_t kNanosecondsPerSecond = 1000000000;
+
+	inline int64_t now()
+	{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+		return (int64_t)ts.tv_sec * kNanosecondsPerSecond + ts.tv_nsec;
+	}
+
+	// Convert a nanosecond value to another timescale without overflowing for large uptimes
+	inline BMDTimeValue toTimescale(int64_t nanoseconds, BMDTimeScale timeScale)
+	{
+		return (nanoseconds / kNanosecondsPerSecond) * timeScale + ((nanoseconds % kNanosecondsPerSecond) * timeScale) / kNanosecondsPerSecond;
+	}
+
+	inline int64_t fromTimescale(BMDTimeValue time, BMDTimeScale timeScale)
+	{
+		return (time / timeScale) * kNanosecondsPerSecond + ((time % timeScale) * kNanosecondsPerSecond) / timeScale;
+	}
+
+	// All virtual devices share a frame grid anchored at zero on the reference clock, so devices
+	// running the same display mode are genlocked to each other, as they would be with a common reference.
+	inline int64_t frameTime(int64_t frameIndex, BMDTimeValue frameDuration, BMDTimeScale timeScale)
+	{
+		return fromTimescale(frameIndex * frameDuration, timeScale);
+	}
+
+	// Index of the first frame boundary at or after the given time
+	inline int64_t nextFrameIndex(int64_t time, BMDTimeValue frameDuration, BMDTimeScale timeScale)
+	{
+		int64_t index = toTimescale(time, timeScale) / frameDuration;
+		while (frameTime(index, frameDuration, timeScale) < time)
+			index++;
+		return index;
+	}
+
+	// Index of the last frame boundary at or before the given time
+	inline int64_t currentFrameIndex(int64_t time, BMDTimeValue frameDuration, BMDTimeScale timeScale)
+	{
+		int64_t index = nextFrameIndex(time, frameDuration, timeScale);
+		return (frameTime(index, frameDuration, timeScale) == time) ? index : index - 1;
+	}
+
+	// Number of audio sample frames at 48kHz from time zero to the given frame boundary
+	inline int64_t audioSampleIndex(int64_t frameIndex, BMDTimeValue frameDuration, BMDTimeScale timeScale)
+	{
+		return (frameIndex * frameDuration * bmdAudioSampleRate48kHz) / timeScale;
+	}
+}
@@ -0,0 +1,284 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+// Note to developers:
+//   This library implements the entry points of libDeckLinkAPI.so with virtual devices that
+//   stream on the system monotonic clock, so the samples can be run and profiled without
+//   DeckLink hardware.  Build with make and run a sample with the library on its search path:
+//     LD_LIBRARY_PATH=/path/to/VirtualDeckLink ./InputLoopThrough
+//   The devices are configured with the DECKLINK_VIRTUAL_* environment variables described in
+//   VirtualDeckLinkConfig.h.  Video conversion is provided by the CPU frame converter of the
+//   PixelPacking library, screen preview helpers are not provided.
+
+#include <string.h>
+#include <atomic>
+#include "DeckLinkAPI.h"
+#include "DeckLinkAPIVersion.h"
+#include "FrameConverter.h"
+#include "VirtualDeckLinkDevice.h"
+#include "VirtualVideoFrame.h"
+#include "com_ptr.h"
+#include "platform.h"
+
+#define VIRTUAL_DECKLINK_EXPORT extern "C" __attribute__((visibility("default")))
+
+namespace
+{
+	class VirtualDeckLinkIterator : public IDeckLinkIterator
+	{
+	public:
+		VirtualDeckLinkIterator() : m_refCount(1), m_nextDeviceIndex(0) { }
+		virtual ~VirtualDeckLinkIterator() = default;
+
+		HRESULT QueryInterface(REFIID iid, LPVOID *ppv) override
+		{
+			if (ppv == nullptr)
+				return E_INVALIDARG;
+
+			if (iid == IID_IUnknown || iid == IID_IDeckLinkIterator)
+			{
+				*ppv = static_cast<IDeckLinkIterator*>(this);
+				AddRef();
+				return S_OK;
+			}
+
+			*ppv = nullptr;
+			return E_NOINTERFACE;
+		}
+
+		ULONG AddRef() override
+		{
+			return ++m_refCount;
+		}
+
+		ULONG Release() override
+		{
+			ULONG newRefValue = --m_refCount;
+			if (newRefValue == 0)
+				delete this;
+
+			return newRefValue;
+		}
+
+		HRESULT Next(IDeckLink** deckLinkInstance) override
+		{
+			if (deckLinkInstance == nullptr)
+				return E_POINTER;
+
+			const std::vector<VirtualDeckLinkDevice*>& devices = getVirtualDeckLinkDevices();
+			if (m_nextDeviceIndex >= devices.size())
+			{
+				*deckLinkInstance = nullptr;
+				return S_FALSE;
+			}
+
+			*deckLinkInstance = devices[m_nextDeviceIndex++];
+			(*deckLinkInstance)->AddRef();
+			return S_OK;
+		}
+
+	private:
+		std::atomic<ULONG>	m_refCount;
+		size_t				m_nextDeviceIndex;
+	};
+
+	class VirtualDeckLinkDiscovery : public IDeckLinkDiscovery
+	{
+	public:
+		VirtualDeckLinkDiscovery() : m_refCount(1) { }
+		virtual ~VirtualDeckLinkDiscovery() = default;
+
+		HRESULT QueryInterface(REFIID iid, LPVOID *ppv) override
+		{
+			if (ppv == nullptr)
+				return E_INVALIDARG;
+
+			if (iid == IID_IUnknown || iid == IID_IDeckLinkDiscovery)
+			{
+				*ppv = static_cast<IDeckLinkDiscovery*>(this);
+				AddRef();
+				return S_OK;
+			}
+
+			*ppv = nullptr;
+			return E_NOINTERFACE;
+		}
+
+		ULONG AddRef() override
+		{
+			return ++m_refCount;
+		}
+
+		ULONG Release() override
+		{
+			ULONG newRefValue = --m_refCount;
+			if (newRefValue == 0)
+				delete this;
+
+			return newRefValue;
+		}
+
+		HRESULT InstallDeviceNotifications(IDeckLinkDeviceNotificationCallback* deviceNotificationCallback) override
+		{
+			if (deviceNotificationCallback == nullptr)
+				return E_INVALIDARG;
+
+			if (m_callback)
+				return E_FAIL;
+
+			m_callback = deviceNotificationCallback;
+
+			// Virtual devices are never hot-plugged, all arrivals are reported before returning
+			for (VirtualDeckLinkDevice* device : getVirtualDeckLinkDevices())
+				m_callback->DeckLinkDeviceArrived(device);
+
+			return S_OK;
+		}
+
+		HRESULT UninstallDeviceNotifications() override
+		{
+			m_callback = nullptr;
+			return S_OK;
+		}
+
+	private:
+		std::atomic<ULONG>								m_refCount;
+		com_ptr<IDeckLinkDeviceNotificationCallback>	m_callback;
+	};
+
+	class VirtualDeckLinkAPIInformation : public IDeckLinkAPIInformation
+	{
+	public:
+		VirtualDeckLinkAPIInformation() : m_refCount(1) { }
+		virtual ~VirtualDeckLinkAPIInformation() = default;
+
+		HRESULT QueryInterface(REFIID iid, LPVOID *ppv) override
+		{
+			if (ppv == nullptr)
+				return E_INVALIDARG;
+
+			if (iid == IID_IUnknown || iid == IID_IDeckLinkAPIInformation)
+			{
+				*ppv = static_cast<IDeckLinkAPIInformation*>(this);
+				AddRef();
+				return S_OK;
+			}
+
+			*ppv = nullptr;
+			return E_NOINTERFACE;
+		}
+
+		ULONG AddRef() override
+		{
+			return ++m_refCount;
+		}
+
+		ULONG Release() override
+		{
+			ULONG newRefValue = --m_refCount;
+			if (newRefValue == 0)
+				delete this;
+
+			return newRefValue;
+		}
+
+		HRESULT GetFlag(BMDDeckLinkAPIInformationID cfgID, bool* value) override
+		{
+			return E_INVALIDARG;
+		}
+
+		HRESULT GetInt(BMDDeckLinkAPIInformationID cfgID, int64_t* value) override
+		{
+			if (value == nullptr)
+				return E_POINTER;
+
+			if (cfgID != BMDDeckLinkAPIVersion)
+				return E_INVALIDARG;
+
+			*value = BLACKMAGIC_DECKLINK_API_VERSION;
+			return S_OK;
+		}
+
+		HRESULT GetFloat(BMDDeckLinkAPIInformationID cfgID, double* value) override
+		{
+			return E_INVALIDARG;
+		}
+
+		HRESULT GetString(BMDDeckLinkAPIInformationID cfgID, const char** value) override
+		{
+			if (value == nullptr)
+				return E_POINTER;
+
+			if (cfgID != BMDDeckLinkAPIVersion)
+				return E_INVALIDARG;
+
+			*value = strdup(BLACKMAGIC_DECKLINK_API_VERSION_STRING);
+			return S_OK;
+		}
+
+	private:
+		std::atomic<ULONG>	m_refCount;
+	};
+}
+
+VIRTUAL_DECKLINK_EXPORT IDeckLinkIterator* CreateDeckLinkIteratorInstance_0004(void)
+{
+	return new VirtualDeckLinkIterator();
+}
+
+VIRTUAL_DECKLINK_EXPORT IDeckLinkDiscovery* CreateDeckLinkDiscoveryInstance_0003(void)
+{
+	return new VirtualDeckLinkDiscovery();
+}
+
+VIRTUAL_DECKLINK_EXPORT IDeckLinkAPIInformation* CreateDeckLinkAPIInformationInstance_0001(void)
+{
+	return new VirtualDeckLinkAPIInformation();
+}
+
+VIRTUAL_DECKLINK_EXPORT IDeckLinkVideoConversion* CreateVideoConversionInstance_0001(void)
+{
+	return new FrameConverter();
+}
+
+VIRTUAL_DECKLINK_EXPORT IDeckLinkVideoFrameAncillaryPackets* CreateVideoFrameAncillaryPacketsInstance_0001(void)
+{
+	return new VirtualAncillaryPackets();
+}
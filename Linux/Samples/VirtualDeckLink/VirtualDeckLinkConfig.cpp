@@ -0,0 +1,112 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <stdlib.h>
+#include <cmath>
+#include <string.h>
+#include <algorithm>
+#include "VirtualDeckLinkConfig.h"
+
+namespace
+{
+	const uint32_t kDefaultDeviceCount = 2;
+	const uint32_t kMaxDeviceCount = 16;
+
+	template<typename T>
+	T getEnvironmentValue(const char* name, T defaultValue)
+	{
+		const char* value = getenv(name);
+		if (value == nullptr || *value == '\0')
+			return defaultValue;
+
+		return (T)strtod(value, nullptr);
+	}
+
+	BMDDisplayMode getEnvironmentDisplayMode(const char* name)
+	{
+		const char* value = getenv(name);
+		if (value == nullptr || strlen(value) != 4)
+			return bmdModeUnknown;
+
+		return (BMDDisplayMode)(((uint32_t)value[0] << 24) | ((uint32_t)value[1] << 16) | ((uint32_t)value[2] << 8) | (uint32_t)value[3]);
+	}
+
+	VirtualDeckLinkConfig readConfig()
+	{
+		VirtualDeckLinkConfig config;
+
+		config.deviceCount			= std::min(getEnvironmentValue<uint32_t>("DECKLINK_VIRTUAL_DEVICE_COUNT", kDefaultDeviceCount), kMaxDeviceCount);
+		config.inputSignalMode		= getEnvironmentDisplayMode("DECKLINK_VIRTUAL_INPUT_MODE");
+		config.jitterMicroseconds	= std::max(getEnvironmentValue<double>("DECKLINK_VIRTUAL_JITTER_US", 0.0), 0.0);
+		config.dropRate				= std::min(std::max(getEnvironmentValue<double>("DECKLINK_VIRTUAL_DROP_RATE", 0.0), 0.0), 1.0);
+		config.loopback				= getEnvironmentValue<int>("DECKLINK_VIRTUAL_LOOPBACK", 0) != 0;
+		config.seed					= getEnvironmentValue<uint32_t>("DECKLINK_VIRTUAL_SEED", 1);
+
+		return config;
+	}
+}
+
+const VirtualDeckLinkConfig& VirtualDeckLinkConfig::get()
+{
+	static const VirtualDeckLinkConfig config = readConfig();
+	return config;
+}
+
+VirtualFaultInjector::VirtualFaultInjector(uint32_t streamIndex) :
+	m_generator(VirtualDeckLinkConfig::get().seed + streamIndex),
+	m_jitterDistribution(0.0, std::max(VirtualDeckLinkConfig::get().jitterMicroseconds, 1.0)),
+	m_dropDistribution(VirtualDeckLinkConfig::get().dropRate),
+	m_jitterEnabled(VirtualDeckLinkConfig::get().jitterMicroseconds > 0.0)
+{
+}
+
+int64_t VirtualFaultInjector::nextJitter()
+{
+	if (!m_jitterEnabled)
+		return 0;
+
+	// Callbacks can only be late, never early, so fold the distribution
+	return (int64_t)(std::abs(m_jitterDistribution(m_generator)) * 1000.0);
+}
+
+bool VirtualFaultInjector::shouldDrop()
+{
+	return m_dropDistribution(m_generator);
+}
@@ -0,0 +1,83 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <random>
+#include "DeckLinkAPI.h"
+
+// The virtual devices are configured from the environment when the library is loaded:
+//   DECKLINK_VIRTUAL_DEVICE_COUNT   Number of devices enumerated by the iterator (default 2)
+//   DECKLINK_VIRTUAL_INPUT_MODE     Display mode of the signal present on the inputs, as a four character code
+//                                   (eg "Hp59").  When unset, the input signal follows the enabled display mode
+//   DECKLINK_VIRTUAL_JITTER_US      Standard deviation of callback delivery jitter, in microseconds (default 0)
+//   DECKLINK_VIRTUAL_DROP_RATE      Probability in [0,1] that a captured or played frame is dropped (default 0)
+//   DECKLINK_VIRTUAL_LOOPBACK       When 1, each device's output is looped back to its own input (default 0)
+//   DECKLINK_VIRTUAL_SEED           Seed for the jitter and drop generators, for reproducible runs (default 1)
+struct VirtualDeckLinkConfig
+{
+	uint32_t		deviceCount;
+	BMDDisplayMode	inputSignalMode;
+	double			jitterMicroseconds;
+	double			dropRate;
+	bool			loopback;
+	uint32_t		seed;
+
+	static const VirtualDeckLinkConfig& get();
+};
+
+// Each stream owns a fault injector so that jitter and drop decisions are reproducible
+// per stream regardless of thread interleaving
+class VirtualFaultInjector
+{
+public:
+	explicit VirtualFaultInjector(uint32_t streamIndex);
+
+	// Delay in nanoseconds to add to the nominal callback time
+	int64_t		nextJitter();
+	bool		shouldDrop();
+
+private:
+	std::mt19937						m_generator;
+	std::normal_distribution<double>	m_jitterDistribution;
+	std::bernoulli_distribution			m_dropDistribution;
+	bool								m_jitterEnabled;
+};
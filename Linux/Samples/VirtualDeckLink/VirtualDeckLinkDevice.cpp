@@ -0,0 +1,622 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <string.h>
+#include "VirtualDeckLinkConfig.h"
+#include "VirtualDeckLinkDevice.h"
+#include "VirtualDeckLinkInput.h"
+#include "VirtualDeckLinkOutput.h"
+#include "platform.h"
+
+namespace
+{
+	// Loopback frames not yet consumed by the input are discarded beyond this depth
+	const size_t kMaxLoopbackFrames = 4;
+
+	// Persistent IDs of virtual devices are distinguishable from those of installed hardware
+	const int64_t kPersistentIDBase = 0x56440000;
+
+	const int64_t kDeviceTemperature = 45;
+	const int64_t kPCIExpressLinkWidth = 4;
+	const int64_t kPCIExpressLinkSpeed = 2;
+}
+
+void VirtualLoopback::push(VirtualLoopbackFrame&& frame)
+{
+	// Applications recycle their frames once they complete, replacing the ancillary packets, so the
+	// packets are captured as they were when the frame was output
+	com_ptr<IDeckLinkVideoFrameAncillaryPackets> ancillaryPackets(IID_IDeckLinkVideoFrameAncillaryPackets, frame.videoFrame);
+	if (ancillaryPackets)
+	{
+		com_ptr<IDeckLinkAncillaryPacketIterator>	iterator;
+		com_ptr<IDeckLinkAncillaryPacket>			packet;
+
+		if (ancillaryPackets->GetPacketIterator(iterator.releaseAndGetAddressOf()) == S_OK)
+		{
+			while (iterator->Next(packet.releaseAndGetAddressOf()) == S_OK)
+				frame.ancillaryPackets.push_back(packet);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_frames.push_back(std::move(frame));
+	while (m_frames.size() > kMaxLoopbackFrames)
+		m_frames.pop_front();
+}
+
+bool VirtualLoopback::pop(VirtualLoopbackFrame& frame)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_frames.empty())
+		return false;
+
+	frame = std::move(m_frames.front());
+	m_frames.pop_front();
+	return true;
+}
+
+void VirtualLoopback::clear()
+{
+	std::deque<VirtualLoopbackFrame> frames;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		frames.swap(m_frames);
+	}
+}
+
+VirtualDeckLinkDevice::VirtualDeckLinkDevice(uint32_t deviceIndex) :
+	m_refCount(1),
+	m_deviceIndex(deviceIndex),
+	m_modelName("DeckLink Virtual"),
+	m_displayName("DeckLink Virtual (" + std::to_string(deviceIndex + 1) + ")")
+{
+	m_input.reset(new VirtualDeckLinkInput(*this));
+	m_output.reset(new VirtualDeckLinkOutput(*this));
+	m_attributes.reset(new VirtualDeckLinkAttributes(*this));
+	m_status.reset(new VirtualDeckLinkStatus(*this));
+	m_configuration.reset(new VirtualDeckLinkConfiguration(*this));
+	m_notification.reset(new VirtualDeckLinkNotification(*this));
+}
+
+VirtualDeckLinkDevice::~VirtualDeckLinkDevice()
+{
+}
+
+HRESULT VirtualDeckLinkDevice::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (ppv == nullptr)
+		return E_INVALIDARG;
+
+	if (iid == IID_IUnknown || iid == IID_IDeckLink)
+		*ppv = static_cast<IDeckLink*>(this);
+	else if (iid == IID_IDeckLinkInput)
+		*ppv = static_cast<IDeckLinkInput*>(m_input.get());
+	else if (iid == IID_IDeckLinkOutput)
+		*ppv = static_cast<IDeckLinkOutput*>(m_output.get());
+	else if (iid == IID_IDeckLinkProfileAttributes)
+		*ppv = static_cast<IDeckLinkProfileAttributes*>(m_attributes.get());
+	else if (iid == IID_IDeckLinkStatus)
+		*ppv = static_cast<IDeckLinkStatus*>(m_status.get());
+	else if (iid == IID_IDeckLinkConfiguration)
+		*ppv = static_cast<IDeckLinkConfiguration*>(m_configuration.get());
+	else if (iid == IID_IDeckLinkNotification)
+		*ppv = static_cast<IDeckLinkNotification*>(m_notification.get());
+	else
+	{
+		*ppv = nullptr;
+		return E_NOINTERFACE;
+	}
+
+	AddRef();
+	return S_OK;
+}
+
+ULONG VirtualDeckLinkDevice::AddRef()
+{
+	return ++m_refCount;
+}
+
+ULONG VirtualDeckLinkDevice::Release()
+{
+	// The device registry holds a reference for the lifetime of the process
+	return --m_refCount;
+}
+
+HRESULT VirtualDeckLinkDevice::GetModelName(const char** modelName)
+{
+	if (modelName == nullptr)
+		return E_POINTER;
+
+	*modelName = strdup(m_modelName.c_str());
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkDevice::GetDisplayName(const char** displayName)
+{
+	if (displayName == nullptr)
+		return E_POINTER;
+
+	*displayName = strdup(m_displayName.c_str());
+	return S_OK;
+}
+
+int64_t VirtualDeckLinkDevice::getPersistentID() const
+{
+	return kPersistentIDBase | m_deviceIndex;
+}
+
+// IDeckLinkProfileAttributes
+
+HRESULT VirtualDeckLinkAttributes::GetFlag(BMDDeckLinkAttributeID cfgID, bool* value)
+{
+	if (value == nullptr)
+		return E_POINTER;
+
+	switch (cfgID)
+	{
+		case BMDDeckLinkSupportsInputFormatDetection:
+		case BMDDeckLinkHasReferenceInput:
+		case BMDDeckLinkSupportsSynchronizeToCaptureGroup:
+		case BMDDeckLinkSupportsSynchronizeToPlaybackGroup:
+			*value = true;
+			return S_OK;
+
+		case BMDDeckLinkSupportsInternalKeying:
+		case BMDDeckLinkSupportsExternalKeying:
+		case BMDDeckLinkHasSerialPort:
+		case BMDDeckLinkHasAnalogVideoOutputGain:
+		case BMDDeckLinkCanOnlyAdjustOverallVideoOutputGain:
+		case BMDDeckLinkHasVideoInputAntiAliasingFilter:
+		case BMDDeckLinkHasBypass:
+		case BMDDeckLinkSupportsClockTimingAdjustment:
+		case BMDDeckLinkSupportsFullFrameReferenceInputTimingOffset:
+		case BMDDeckLinkSupportsSMPTELevelAOutput:
+		case BMDDeckLinkSupportsAutoSwitchingPPsFOnInput:
+		case BMDDeckLinkSupportsDualLinkSDI:
+		case BMDDeckLinkSupportsQuadLinkSDI:
+		case BMDDeckLinkSupportsIdleOutput:
+		case BMDDeckLinkVANCRequires10BitYUVVideoFrames:
+		case BMDDeckLinkHasLTCTimecodeInput:
+		case BMDDeckLinkSupportsHDRMetadata:
+		case BMDDeckLinkSupportsColorspaceMetadata:
+		case BMDDeckLinkSupportsHDMITimecode:
+		case BMDDeckLinkSupportsHighFrameRateTimecode:
+			*value = false;
+			return S_OK;
+
+		default:
+			return E_INVALIDARG;
+	}
+}
+
+HRESULT VirtualDeckLinkAttributes::GetInt(BMDDeckLinkAttributeID cfgID, int64_t* value)
+{
+	if (value == nullptr)
+		return E_POINTER;
+
+	switch (cfgID)
+	{
+		case BMDDeckLinkMaximumAudioChannels:
+			*value = 16;
+			break;
+
+		case BMDDeckLinkMaximumAnalogAudioInputChannels:
+		case BMDDeckLinkMaximumAnalogAudioOutputChannels:
+		case BMDDeckLinkAudioInputRCAChannelCount:
+		case BMDDeckLinkAudioInputXLRChannelCount:
+		case BMDDeckLinkAudioOutputRCAChannelCount:
+		case BMDDeckLinkAudioOutputXLRChannelCount:
+		case BMDDeckLinkDeckControlConnections:
+		case BMDDeckLinkSubDeviceIndex:
+			*value = 0;
+			break;
+
+		case BMDDeckLinkNumberOfSubDevices:
+			*value = 1;
+			break;
+
+		case BMDDeckLinkPersistentID:
+		case BMDDeckLinkDeviceGroupID:
+		case BMDDeckLinkTopologicalID:
+			*value = m_device.getPersistentID();
+			break;
+
+		case BMDDeckLinkVideoInputConnections:
+		case BMDDeckLinkVideoOutputConnections:
+			*value = bmdVideoConnectionSDI;
+			break;
+
+		case BMDDeckLinkAudioInputConnections:
+		case BMDDeckLinkAudioOutputConnections:
+			*value = bmdAudioConnectionEmbedded;
+			break;
+
+		case BMDDeckLinkVideoIOSupport:
+			*value = bmdDeviceSupportsCapture | bmdDeviceSupportsPlayback;
+			break;
+
+		case BMDDeckLinkDeviceInterface:
+			*value = bmdDeviceInterfacePCI;
+			break;
+
+		case BMDDeckLinkProfileID:
+			*value = bmdProfileOneSubDeviceFullDuplex;
+			break;
+
+		case BMDDeckLinkDuplex:
+			*value = bmdDuplexFull;
+			break;
+
+		case BMDDeckLinkMinimumPrerollFrames:
+			*value = 2;
+			break;
+
+		case BMDDeckLinkSupportedDynamicRange:
+			*value = bmdDynamicRangeSDR;
+			break;
+
+		default:
+			return E_INVALIDARG;
+	}
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkAttributes::GetFloat(BMDDeckLinkAttributeID cfgID, double* value)
+{
+	if (value == nullptr)
+		return E_POINTER;
+
+	// No analog video or microphone inputs
+	return E_INVALIDARG;
+}
+
+HRESULT VirtualDeckLinkAttributes::GetString(BMDDeckLinkAttributeID cfgID, const char** value)
+{
+	if (value == nullptr)
+		return E_POINTER;
+
+	switch (cfgID)
+	{
+		case BMDDeckLinkVendorName:
+			*value = strdup("Blackmagic Design");
+			break;
+
+		case BMDDeckLinkDisplayName:
+			*value = strdup(m_device.getDisplayName().c_str());
+			break;
+
+		case BMDDeckLinkModelName:
+			*value = strdup(m_device.getModelName().c_str());
+			break;
+
+		case BMDDeckLinkDeviceHandle:
+			*value = strdup(("virtual:" + std::to_string(m_device.getDeviceIndex())).c_str());
+			break;
+
+		default:
+			return E_INVALIDARG;
+	}
+
+	return S_OK;
+}
+
+// IDeckLinkStatus
+
+HRESULT VirtualDeckLinkStatus::GetFlag(BMDDeckLinkStatusID statusID, bool* value)
+{
+	if (value == nullptr)
+		return E_POINTER;
+
+	switch (statusID)
+	{
+		case bmdDeckLinkStatusVideoInputSignalLocked:
+			*value = (m_device.getInput().getSignalDisplayMode() != nullptr);
+			break;
+
+		case bmdDeckLinkStatusReferenceSignalLocked:
+			*value = true;
+			break;
+
+		default:
+			return E_INVALIDARG;
+	}
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkStatus::GetInt(BMDDeckLinkStatusID statusID, int64_t* value)
+{
+	BMDDisplayMode			displayMode;
+	BMDPixelFormat			pixelFormat;
+	BMDVideoInputFlags		inputFlags;
+	BMDVideoOutputFlags		outputFlags;
+
+	if (value == nullptr)
+		return E_POINTER;
+
+	switch (statusID)
+	{
+		case bmdDeckLinkStatusDetectedVideoInputMode:
+		case bmdDeckLinkStatusDetectedVideoInputFormatFlags:
+		case bmdDeckLinkStatusDetectedVideoInputFieldDominance:
+		{
+			const VirtualDisplayModeDescription* signalMode = m_device.getInput().getSignalDisplayMode();
+			if (signalMode == nullptr)
+				return E_FAIL;
+
+			if (statusID == bmdDeckLinkStatusDetectedVideoInputMode)
+				*value = signalMode->displayMode;
+			else if (statusID == bmdDeckLinkStatusDetectedVideoInputFormatFlags)
+				*value = bmdDetectedVideoInputYCbCr422 | bmdDetectedVideoInput10BitDepth;
+			else
+				*value = signalMode->fieldDominance;
+			break;
+		}
+
+		case bmdDeckLinkStatusCurrentVideoInputMode:
+		case bmdDeckLinkStatusCurrentVideoInputPixelFormat:
+		case bmdDeckLinkStatusCurrentVideoInputFlags:
+			if (!m_device.getInput().getVideoInputStatus(&displayMode, &pixelFormat, &inputFlags))
+				return E_FAIL;
+
+			if (statusID == bmdDeckLinkStatusCurrentVideoInputMode)
+				*value = displayMode;
+			else if (statusID == bmdDeckLinkStatusCurrentVideoInputPixelFormat)
+				*value = pixelFormat;
+			else
+				*value = inputFlags;
+			break;
+
+		case bmdDeckLinkStatusCurrentVideoOutputMode:
+		case bmdDeckLinkStatusCurrentVideoOutputFlags:
+		case bmdDeckLinkStatusLastVideoOutputPixelFormat:
+			if (!m_device.getOutput().getVideoOutputStatus(&displayMode, &outputFlags, &pixelFormat))
+				return E_FAIL;
+
+			if (statusID == bmdDeckLinkStatusCurrentVideoOutputMode)
+				*value = displayMode;
+			else if (statusID == bmdDeckLinkStatusCurrentVideoOutputFlags)
+				*value = outputFlags;
+			else
+				*value = pixelFormat;
+			break;
+
+		case bmdDeckLinkStatusBusy:
+			*value = 0;
+			if (m_device.getInput().getVideoInputStatus(&displayMode, &pixelFormat, &inputFlags))
+				*value |= bmdDeviceCaptureBusy;
+			if (m_device.getOutput().getVideoOutputStatus(&displayMode, &outputFlags, &pixelFormat))
+				*value |= bmdDevicePlaybackBusy;
+			break;
+
+		case bmdDeckLinkStatusPCIExpressLinkWidth:
+			*value = kPCIExpressLinkWidth;
+			break;
+
+		case bmdDeckLinkStatusPCIExpressLinkSpeed:
+			*value = kPCIExpressLinkSpeed;
+			break;
+
+		case bmdDeckLinkStatusDeviceTemperature:
+			*value = kDeviceTemperature;
+			break;
+
+		default:
+			return E_NOTIMPL;
+	}
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkStatus::GetFloat(BMDDeckLinkStatusID statusID, double* value)
+{
+	return E_NOTIMPL;
+}
+
+HRESULT VirtualDeckLinkStatus::GetString(BMDDeckLinkStatusID statusID, const char** value)
+{
+	return E_NOTIMPL;
+}
+
+HRESULT VirtualDeckLinkStatus::GetBytes(BMDDeckLinkStatusID statusID, void* buffer, uint32_t* bufferSize)
+{
+	return E_NOTIMPL;
+}
+
+// IDeckLinkConfiguration
+
+HRESULT VirtualDeckLinkConfiguration::SetFlag(BMDDeckLinkConfigurationID cfgID, bool value)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_flags[cfgID] = value;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkConfiguration::GetFlag(BMDDeckLinkConfigurationID cfgID, bool* value)
+{
+	if (value == nullptr)
+		return E_POINTER;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto iter = m_flags.find(cfgID);
+	*value = (iter != m_flags.end()) ? iter->second : false;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkConfiguration::SetInt(BMDDeckLinkConfigurationID cfgID, int64_t value)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_ints[cfgID] = value;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkConfiguration::GetInt(BMDDeckLinkConfigurationID cfgID, int64_t* value)
+{
+	if (value == nullptr)
+		return E_POINTER;
+
+	*value = getInt(cfgID);
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkConfiguration::SetFloat(BMDDeckLinkConfigurationID cfgID, double value)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_floats[cfgID] = value;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkConfiguration::GetFloat(BMDDeckLinkConfigurationID cfgID, double* value)
+{
+	if (value == nullptr)
+		return E_POINTER;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto iter = m_floats.find(cfgID);
+	*value = (iter != m_floats.end()) ? iter->second : 0.0;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkConfiguration::SetString(BMDDeckLinkConfigurationID cfgID, const char* value)
+{
+	if (value == nullptr)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_strings[cfgID] = value;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkConfiguration::GetString(BMDDeckLinkConfigurationID cfgID, const char** value)
+{
+	if (value == nullptr)
+		return E_POINTER;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto iter = m_strings.find(cfgID);
+	*value = strdup((iter != m_strings.end()) ? iter->second.c_str() : "");
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkConfiguration::WriteConfigurationToPreferences()
+{
+	// There is no persistent store for virtual devices
+	m_device.getNotification().notify(bmdPreferencesChanged, 0, 0);
+	return S_OK;
+}
+
+int64_t VirtualDeckLinkConfiguration::getInt(BMDDeckLinkConfigurationID cfgID)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto iter = m_ints.find(cfgID);
+	return (iter != m_ints.end()) ? iter->second : 0;
+}
+
+// IDeckLinkNotification
+
+HRESULT VirtualDeckLinkNotification::Subscribe(BMDNotifications topic, IDeckLinkNotificationCallback* theCallback)
+{
+	if (theCallback == nullptr)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (auto& subscriber : m_subscribers)
+	{
+		if (subscriber.first == topic && subscriber.second.get() == theCallback)
+			return E_FAIL;
+	}
+
+	m_subscribers.emplace_back(topic, com_ptr<IDeckLinkNotificationCallback>(theCallback));
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkNotification::Unsubscribe(BMDNotifications topic, IDeckLinkNotificationCallback* theCallback)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (auto iter = m_subscribers.begin(); iter != m_subscribers.end(); ++iter)
+	{
+		if (iter->first == topic && iter->second.get() == theCallback)
+		{
+			m_subscribers.erase(iter);
+			return S_OK;
+		}
+	}
+
+	return E_FAIL;
+}
+
+void VirtualDeckLinkNotification::notify(BMDNotifications topic, uint64_t param1, uint64_t param2)
+{
+	std::vector<com_ptr<IDeckLinkNotificationCallback>> callbacks;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto& subscriber : m_subscribers)
+		{
+			if (subscriber.first == topic)
+				callbacks.push_back(subscriber.second);
+		}
+	}
+
+	// Callbacks are made without the lock held, so that they may unsubscribe
+	for (auto& callback : callbacks)
+		callback->Notify(topic, param1, param2);
+}
+
+const std::vector<VirtualDeckLinkDevice*>& getVirtualDeckLinkDevices()
+{
+	static const std::vector<VirtualDeckLinkDevice*> devices = []
+	{
+		std::vector<VirtualDeckLinkDevice*> result;
+
+		for (uint32_t i = 0; i < VirtualDeckLinkConfig::get().deviceCount; i++)
+			result.push_back(new VirtualDeckLinkDevice(i));
+
+		return result;
+	}();
+
+	return devices;
+}
@@ -0,0 +1,227 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "DeckLinkAPI.h"
+#include "com_ptr.h"
+
+class VirtualDeckLinkInput;
+class VirtualDeckLinkOutput;
+class VirtualDeckLinkAttributes;
+class VirtualDeckLinkStatus;
+class VirtualDeckLinkConfiguration;
+class VirtualDeckLinkNotification;
+
+// A played out frame with its ancillary packets and the audio played during its frame
+// period, handed from a device's output to its own input when DECKLINK_VIRTUAL_LOOPBACK is set
+struct VirtualLoopbackFrame
+{
+	com_ptr<IDeckLinkVideoFrame>					videoFrame;
+	std::vector<com_ptr<IDeckLinkAncillaryPacket>>	ancillaryPackets;
+	std::vector<uint8_t>							audioSamples;
+	BMDAudioSampleType								audioSampleType;
+	uint32_t										audioChannelCount;
+};
+
+class VirtualLoopback
+{
+public:
+	void	push(VirtualLoopbackFrame&& frame);
+	bool	pop(VirtualLoopbackFrame& frame);
+	void	clear();
+
+private:
+	std::mutex							m_mutex;
+	std::deque<VirtualLoopbackFrame>	m_frames;
+};
+
+class VirtualDeckLinkDevice : public IDeckLink
+{
+public:
+	explicit VirtualDeckLinkDevice(uint32_t deviceIndex);
+	virtual ~VirtualDeckLinkDevice();
+
+	// IUnknown interface
+	HRESULT					QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG					AddRef() override;
+	ULONG					Release() override;
+
+	// IDeckLink interface
+	HRESULT					GetModelName(const char** modelName) override;
+	HRESULT					GetDisplayName(const char** displayName) override;
+
+	uint32_t				getDeviceIndex() const { return m_deviceIndex; }
+	int64_t					getPersistentID() const;
+	const std::string&		getModelName() const { return m_modelName; }
+	const std::string&		getDisplayName() const { return m_displayName; }
+
+	VirtualLoopback&		getLoopback() { return m_loopback; }
+	VirtualDeckLinkInput&	getInput() { return *m_input; }
+	VirtualDeckLinkOutput&	getOutput() { return *m_output; }
+	VirtualDeckLinkConfiguration&	getConfiguration() { return *m_configuration; }
+	VirtualDeckLinkNotification&	getNotification() { return *m_notification; }
+
+private:
+	std::atomic<ULONG>								m_refCount;
+	uint32_t										m_deviceIndex;
+	std::string										m_modelName;
+	std::string										m_displayName;
+	VirtualLoopback									m_loopback;
+	std::unique_ptr<VirtualDeckLinkInput>			m_input;
+	std::unique_ptr<VirtualDeckLinkOutput>			m_output;
+	std::unique_ptr<VirtualDeckLinkAttributes>		m_attributes;
+	std::unique_ptr<VirtualDeckLinkStatus>			m_status;
+	std::unique_ptr<VirtualDeckLinkConfiguration>	m_configuration;
+	std::unique_ptr<VirtualDeckLinkNotification>	m_notification;
+};
+
+// The interfaces below are aggregated by VirtualDeckLinkDevice: they share its reference count
+// and QueryInterface, so any of them can be used to obtain the others, as with the hardware driver.
+
+class VirtualDeckLinkAttributes : public IDeckLinkProfileAttributes
+{
+public:
+	explicit VirtualDeckLinkAttributes(VirtualDeckLinkDevice& device) : m_device(device) { }
+	virtual ~VirtualDeckLinkAttributes() = default;
+
+	// IUnknown interface
+	HRESULT		QueryInterface(REFIID iid, LPVOID *ppv) override { return m_device.QueryInterface(iid, ppv); }
+	ULONG		AddRef() override { return m_device.AddRef(); }
+	ULONG		Release() override { return m_device.Release(); }
+
+	// IDeckLinkProfileAttributes interface
+	HRESULT		GetFlag(BMDDeckLinkAttributeID cfgID, bool* value) override;
+	HRESULT		GetInt(BMDDeckLinkAttributeID cfgID, int64_t* value) override;
+	HRESULT		GetFloat(BMDDeckLinkAttributeID cfgID, double* value) override;
+	HRESULT		GetString(BMDDeckLinkAttributeID cfgID, const char** value) override;
+
+private:
+	VirtualDeckLinkDevice&	m_device;
+};
+
+class VirtualDeckLinkStatus : public IDeckLinkStatus
+{
+public:
+	explicit VirtualDeckLinkStatus(VirtualDeckLinkDevice& device) : m_device(device) { }
+	virtual ~VirtualDeckLinkStatus() = default;
+
+	// IUnknown interface
+	HRESULT		QueryInterface(REFIID iid, LPVOID *ppv) override { return m_device.QueryInterface(iid, ppv); }
+	ULONG		AddRef() override { return m_device.AddRef(); }
+	ULONG		Release() override { return m_device.Release(); }
+
+	// IDeckLinkStatus interface
+	HRESULT		GetFlag(BMDDeckLinkStatusID statusID, bool* value) override;
+	HRESULT		GetInt(BMDDeckLinkStatusID statusID, int64_t* value) override;
+	HRESULT		GetFloat(BMDDeckLinkStatusID statusID, double* value) override;
+	HRESULT		GetString(BMDDeckLinkStatusID statusID, const char** value) override;
+	HRESULT		GetBytes(BMDDeckLinkStatusID statusID, void* buffer, uint32_t* bufferSize) override;
+
+private:
+	VirtualDeckLinkDevice&	m_device;
+};
+
+class VirtualDeckLinkConfiguration : public IDeckLinkConfiguration
+{
+public:
+	explicit VirtualDeckLinkConfiguration(VirtualDeckLinkDevice& device) : m_device(device) { }
+	virtual ~VirtualDeckLinkConfiguration() = default;
+
+	// IUnknown interface
+	HRESULT		QueryInterface(REFIID iid, LPVOID *ppv) override { return m_device.QueryInterface(iid, ppv); }
+	ULONG		AddRef() override { return m_device.AddRef(); }
+	ULONG		Release() override { return m_device.Release(); }
+
+	// IDeckLinkConfiguration interface.  Settings are held in memory only; unset values read as zero
+	HRESULT		SetFlag(BMDDeckLinkConfigurationID cfgID, bool value) override;
+	HRESULT		GetFlag(BMDDeckLinkConfigurationID cfgID, bool* value) override;
+	HRESULT		SetInt(BMDDeckLinkConfigurationID cfgID, int64_t value) override;
+	HRESULT		GetInt(BMDDeckLinkConfigurationID cfgID, int64_t* value) override;
+	HRESULT		SetFloat(BMDDeckLinkConfigurationID cfgID, double value) override;
+	HRESULT		GetFloat(BMDDeckLinkConfigurationID cfgID, double* value) override;
+	HRESULT		SetString(BMDDeckLinkConfigurationID cfgID, const char* value) override;
+	HRESULT		GetString(BMDDeckLinkConfigurationID cfgID, const char** value) override;
+	HRESULT		WriteConfigurationToPreferences() override;
+
+	int64_t		getInt(BMDDeckLinkConfigurationID cfgID);
+
+private:
+	VirtualDeckLinkDevice&							m_device;
+	std::mutex										m_mutex;
+	std::map<BMDDeckLinkConfigurationID, bool>		m_flags;
+	std::map<BMDDeckLinkConfigurationID, int64_t>	m_ints;
+	std::map<BMDDeckLinkConfigurationID, double>	m_floats;
+	std::map<BMDDeckLinkConfigurationID, std::string>	m_strings;
+};
+
+class VirtualDeckLinkNotification : public IDeckLinkNotification
+{
+public:
+	explicit VirtualDeckLinkNotification(VirtualDeckLinkDevice& device) : m_device(device) { }
+	virtual ~VirtualDeckLinkNotification() = default;
+
+	// IUnknown interface
+	HRESULT		QueryInterface(REFIID iid, LPVOID *ppv) override { return m_device.QueryInterface(iid, ppv); }
+	ULONG		AddRef() override { return m_device.AddRef(); }
+	ULONG		Release() override { return m_device.Release(); }
+
+	// IDeckLinkNotification interface.  The status of a virtual device does not change, so only
+	// bmdPreferencesChanged is ever notified, when the configuration is written to preferences
+	HRESULT		Subscribe(BMDNotifications topic, IDeckLinkNotificationCallback* theCallback) override;
+	HRESULT		Unsubscribe(BMDNotifications topic, IDeckLinkNotificationCallback* theCallback) override;
+
+	void		notify(BMDNotifications topic, uint64_t param1, uint64_t param2);
+
+private:
+	VirtualDeckLinkDevice&	m_device;
+	std::mutex				m_mutex;
+	std::vector<std::pair<BMDNotifications, com_ptr<IDeckLinkNotificationCallback>>>	m_subscribers;
+};
+
+// Devices are created on first use and exist for the lifetime of the process, as installed hardware would
+const std::vector<VirtualDeckLinkDevice*>& getVirtualDeckLinkDevices();
@@ -0,0 +1,704 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include "VirtualClock.h"
+#include "VirtualDeckLinkDevice.h"
+#include "VirtualDeckLinkInput.h"
+
+namespace
+{
+	// Frame buffers the application may hold before captured frames are dropped
+	const uint32_t kMaxInputFramesInFlight = 16;
+
+	// Completed frames queued for delivery while a callback is still in progress, beyond which the oldest are lost
+	const int64_t kMaxQueuedInputFrames = 2;
+
+	const BMDTimecodeFormat kLoopbackTimecodeFormats[] =
+	{
+		bmdTimecodeRP188VITC1,
+		bmdTimecodeRP188VITC2,
+		bmdTimecodeRP188LTC,
+		bmdTimecodeRP188HighFrameRate,
+		bmdTimecodeVITC,
+		bmdTimecodeVITCField2,
+	};
+}
+
+VirtualDeckLinkInput::VirtualDeckLinkInput(VirtualDeckLinkDevice& device) :
+	m_device(device),
+	m_captureThreadGeneration(0),
+	m_callbackInProgress(false),
+	m_streamGeneration(0),
+	m_audioAllocator(make_com_ptr<VirtualMemoryAllocator>()),
+	m_videoEnabled(false),
+	m_displayMode(nullptr),
+	m_pixelFormat(bmdFormatUnspecified),
+	m_inputFlags(bmdVideoInputFlagDefault),
+	m_formatChangeReported(false),
+	m_audioEnabled(false),
+	m_audioSampleType(bmdAudioSampleType16bitInteger),
+	m_audioChannelCount(0),
+	m_streamState(StreamState::Stopped),
+	m_framesInFlight(std::make_shared<std::atomic<uint32_t>>(0)),
+	m_faultInjector(device.getDeviceIndex() * 2)
+{
+}
+
+VirtualDeckLinkInput::~VirtualDeckLinkInput()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	stopCaptureThread(lock);
+}
+
+HRESULT VirtualDeckLinkInput::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	return m_device.QueryInterface(iid, ppv);
+}
+
+ULONG VirtualDeckLinkInput::AddRef()
+{
+	return m_device.AddRef();
+}
+
+ULONG VirtualDeckLinkInput::Release()
+{
+	return m_device.Release();
+}
+
+HRESULT VirtualDeckLinkInput::DoesSupportVideoMode(BMDVideoConnection connection, BMDDisplayMode requestedMode, BMDPixelFormat requestedPixelFormat, BMDVideoInputConversionMode conversionMode, BMDSupportedVideoModeFlags flags, BMDDisplayMode* actualMode, bool* supported)
+{
+	if (supported == nullptr)
+		return E_POINTER;
+
+	*supported = (findVirtualDisplayMode(requestedMode) != nullptr) &&
+				 ((connection == bmdVideoConnectionUnspecified) || (connection & bmdVideoConnectionSDI)) &&
+				 ((requestedPixelFormat == bmdFormatUnspecified) || isVirtualPixelFormatSupported(requestedPixelFormat)) &&
+				 (conversionMode == bmdNoVideoInputConversion);
+
+	if (actualMode != nullptr)
+		*actualMode = *supported ? requestedMode : bmdModeUnknown;
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::GetDisplayMode(BMDDisplayMode displayMode, IDeckLinkDisplayMode** resultDisplayMode)
+{
+	if (resultDisplayMode == nullptr)
+		return E_POINTER;
+
+	const VirtualDisplayModeDescription* description = findVirtualDisplayMode(displayMode);
+	if (description == nullptr)
+	{
+		*resultDisplayMode = nullptr;
+		return E_INVALIDARG;
+	}
+
+	*resultDisplayMode = new VirtualDisplayMode(*description);
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::GetDisplayModeIterator(IDeckLinkDisplayModeIterator** iterator)
+{
+	if (iterator == nullptr)
+		return E_POINTER;
+
+	*iterator = new VirtualDisplayModeIterator();
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::SetScreenPreviewCallback(IDeckLinkScreenPreviewCallback* previewCallback)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_previewCallback = previewCallback;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::EnableVideoInput(BMDDisplayMode displayMode, BMDPixelFormat pixelFormat, BMDVideoInputFlags flags)
+{
+	const VirtualDisplayModeDescription* description = findVirtualDisplayMode(displayMode);
+
+	if (description == nullptr || !isVirtualPixelFormatSupported(pixelFormat))
+		return E_INVALIDARG;
+
+	// Stereoscopic capture is not simulated
+	if (flags & bmdVideoInputDualStream3D)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_videoEnabled)
+	{
+		if (!m_frameAllocator)
+			m_frameAllocator = make_com_ptr<VirtualMemoryAllocator>().get();
+
+		if (m_frameAllocator->Commit() != S_OK)
+			return E_FAIL;
+	}
+
+	m_videoEnabled			= true;
+	m_displayMode			= description;
+	m_pixelFormat			= pixelFormat;
+	m_inputFlags			= flags;
+	m_formatChangeReported	= false;
+	m_streamGeneration++;
+
+	if (!m_captureThread.joinable())
+	{
+		uint64_t threadGeneration = ++m_captureThreadGeneration;
+		m_captureThread = std::thread(&VirtualDeckLinkInput::captureThread, this, threadGeneration);
+	}
+
+	m_condition.notify_all();
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::DisableVideoInput()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (!m_videoEnabled)
+		return S_OK;
+
+	m_videoEnabled	= false;
+	m_streamState	= StreamState::Stopped;
+
+	waitForCallbackComplete(lock);
+	stopCaptureThread(lock);
+
+	m_frameAllocator->Decommit();
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::GetAvailableVideoFrameCount(uint32_t* availableFrameCount)
+{
+	if (availableFrameCount == nullptr)
+		return E_POINTER;
+
+	// Frames are delivered by callback as soon as they are captured
+	*availableFrameCount = 0;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::SetVideoInputFrameMemoryAllocator(IDeckLinkMemoryAllocator* theAllocator)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_videoEnabled)
+		return E_ACCESSDENIED;
+
+	m_frameAllocator = theAllocator;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::EnableAudioInput(BMDAudioSampleRate sampleRate, BMDAudioSampleType sampleType, uint32_t channelCount)
+{
+	if (sampleRate != bmdAudioSampleRate48kHz)
+		return E_INVALIDARG;
+
+	if (sampleType != bmdAudioSampleType16bitInteger && sampleType != bmdAudioSampleType32bitInteger)
+		return E_INVALIDARG;
+
+	if (channelCount != 2 && channelCount != 8 && channelCount != 16)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_audioEnabled		= true;
+	m_audioSampleType	= sampleType;
+	m_audioChannelCount	= channelCount;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::DisableAudioInput()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_audioEnabled = false;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::GetAvailableAudioSampleFrameCount(uint32_t* availableSampleFrameCount)
+{
+	if (availableSampleFrameCount == nullptr)
+		return E_POINTER;
+
+	*availableSampleFrameCount = 0;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::StartStreams()
+{
+	int64_t captureGroup;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (!m_videoEnabled || m_streamState == StreamState::Running)
+			return E_ACCESSDENIED;
+
+		startStreams();
+		captureGroup = getCaptureGroup();
+	}
+
+	// Starting one input of a capture group starts the others
+	if (captureGroup != 0)
+	{
+		for (VirtualDeckLinkDevice* device : getVirtualDeckLinkDevices())
+		{
+			if (device != &m_device)
+				device->getInput().startGroupStreams(captureGroup);
+		}
+	}
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::StopStreams()
+{
+	int64_t captureGroup;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		if (m_streamState == StreamState::Stopped)
+			return E_ACCESSDENIED;
+
+		m_streamState = StreamState::Stopped;
+		m_condition.notify_all();
+
+		waitForCallbackComplete(lock);
+		captureGroup = getCaptureGroup();
+	}
+
+	// Stopping one input of a capture group stops the others
+	if (captureGroup != 0)
+	{
+		for (VirtualDeckLinkDevice* device : getVirtualDeckLinkDevices())
+		{
+			if (device != &m_device)
+				device->getInput().stopGroupStreams(captureGroup);
+		}
+	}
+
+	return S_OK;
+}
+
+void VirtualDeckLinkInput::startGroupStreams(int64_t captureGroup)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_videoEnabled && m_streamState != StreamState::Running && getCaptureGroup() == captureGroup)
+		startStreams();
+}
+
+void VirtualDeckLinkInput::stopGroupStreams(int64_t captureGroup)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (m_streamState == StreamState::Stopped || getCaptureGroup() != captureGroup)
+		return;
+
+	m_streamState = StreamState::Stopped;
+	m_condition.notify_all();
+
+	waitForCallbackComplete(lock);
+}
+
+void VirtualDeckLinkInput::startStreams()
+{
+	// Resuming from pause continues the stream clock, otherwise stream time restarts from zero
+	if (m_streamState == StreamState::Stopped)
+		m_streamGeneration++;
+
+	m_streamState = StreamState::Running;
+	m_condition.notify_all();
+}
+
+int64_t VirtualDeckLinkInput::getCaptureGroup()
+{
+	if (!(m_inputFlags & bmdVideoInputSynchronizeToCaptureGroup))
+		return 0;
+
+	return m_device.getConfiguration().getInt(bmdDeckLinkConfigCaptureGroup);
+}
+
+HRESULT VirtualDeckLinkInput::PauseStreams()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (m_streamState != StreamState::Running)
+		return E_ACCESSDENIED;
+
+	m_streamState = StreamState::Paused;
+	m_condition.notify_all();
+
+	waitForCallbackComplete(lock);
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::FlushStreams()
+{
+	// No frames are buffered ahead of the callback, so there is nothing to discard
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::SetCallback(IDeckLinkInputCallback* theCallback)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_callback = theCallback;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::GetHardwareReferenceClock(BMDTimeScale desiredTimeScale, BMDTimeValue* hardwareTime, BMDTimeValue* timeInFrame, BMDTimeValue* ticksPerFrame)
+{
+	if (hardwareTime == nullptr || timeInFrame == nullptr || ticksPerFrame == nullptr)
+		return E_POINTER;
+
+	if (desiredTimeScale <= 0)
+		return E_INVALIDARG;
+
+	int64_t now = VirtualClock::now();
+	*hardwareTime = VirtualClock::toTimescale(now, desiredTimeScale);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_videoEnabled)
+	{
+		*timeInFrame	= 0;
+		*ticksPerFrame	= 0;
+		return S_OK;
+	}
+
+	int64_t frameStart = VirtualClock::frameTime(VirtualClock::currentFrameIndex(now, m_displayMode->frameDuration, m_displayMode->timeScale), m_displayMode->frameDuration, m_displayMode->timeScale);
+
+	*timeInFrame	= VirtualClock::toTimescale(now - frameStart, desiredTimeScale);
+	*ticksPerFrame	= m_displayMode->frameDuration * desiredTimeScale / m_displayMode->timeScale;
+	return S_OK;
+}
+
+bool VirtualDeckLinkInput::getVideoInputStatus(BMDDisplayMode* displayMode, BMDPixelFormat* pixelFormat, BMDVideoInputFlags* flags)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_videoEnabled)
+		return false;
+
+	*displayMode	= m_displayMode->displayMode;
+	*pixelFormat	= m_pixelFormat;
+	*flags			= m_inputFlags;
+	return true;
+}
+
+const VirtualDisplayModeDescription* VirtualDeckLinkInput::getSignalDisplayMode()
+{
+	const VirtualDisplayModeDescription* signalMode = findVirtualDisplayMode(VirtualDeckLinkConfig::get().inputSignalMode);
+
+	if (signalMode != nullptr)
+		return signalMode;
+
+	// Without a configured input signal, the source follows the format that the input is enabled with
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_videoEnabled ? m_displayMode : nullptr;
+}
+
+void VirtualDeckLinkInput::captureThread(uint64_t threadGeneration)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	const VirtualDisplayModeDescription* configuredSignalMode = findVirtualDisplayMode(VirtualDeckLinkConfig::get().inputSignalMode);
+
+	uint64_t	streamGeneration	= m_streamGeneration - 1;
+	int64_t		frameIndex			= 0;
+	int64_t		streamStartIndex	= 0;
+	int64_t		deliveryTime		= 0;
+	bool		deliveryScheduled	= false;
+
+	m_captureThreadID = std::this_thread::get_id();
+
+	while (threadGeneration == m_captureThreadGeneration)
+	{
+		if (!m_videoEnabled || m_streamState != StreamState::Running)
+		{
+			deliveryScheduled = false;
+			m_condition.wait(lock);
+			continue;
+		}
+
+		const VirtualDisplayModeDescription* displayMode = m_displayMode;
+
+		if (streamGeneration != m_streamGeneration)
+		{
+			streamGeneration	= m_streamGeneration;
+			frameIndex			= VirtualClock::nextFrameIndex(VirtualClock::now(), displayMode->frameDuration, displayMode->timeScale);
+			deliveryScheduled	= false;
+
+			// Inputs in a capture group share stream time derived from the common reference, so that
+			// frames captured at the same instant on different devices have equal stream times
+			if ((m_inputFlags & bmdVideoInputSynchronizeToCaptureGroup) && m_device.getConfiguration().getInt(bmdDeckLinkConfigCaptureGroup) != 0)
+				streamStartIndex = 0;
+			else
+				streamStartIndex = frameIndex;
+		}
+
+		if (!deliveryScheduled)
+		{
+			deliveryTime		= VirtualClock::frameTime(frameIndex, displayMode->frameDuration, displayMode->timeScale) + m_faultInjector.nextJitter();
+			deliveryScheduled	= true;
+		}
+
+		int64_t now = VirtualClock::now();
+		if (now < deliveryTime)
+		{
+			m_condition.wait_for(lock, std::chrono::nanoseconds(deliveryTime - now));
+			continue;
+		}
+
+		// If the callback held the thread for too long, frames captured in the meantime are lost
+		// and the application sees a gap in stream time, as it would with hardware
+		int64_t latestFrameIndex = VirtualClock::currentFrameIndex(now, displayMode->frameDuration, displayMode->timeScale);
+		if (latestFrameIndex - frameIndex > kMaxQueuedInputFrames)
+			frameIndex = latestFrameIndex;
+
+		CaptureRequest request;
+		request.frameIndex			= frameIndex;
+		request.streamStartIndex	= streamStartIndex;
+		request.displayMode			= displayMode;
+		request.signalMode			= configuredSignalMode ? configuredSignalMode : displayMode;
+		request.pixelFormat			= m_pixelFormat;
+		request.reportFormatChange	= (request.signalMode != displayMode) && (m_inputFlags & bmdVideoInputEnableFormatDetection) && !m_formatChangeReported;
+		request.audioEnabled		= m_audioEnabled;
+		request.audioSampleType		= m_audioSampleType;
+		request.audioChannelCount	= m_audioChannelCount;
+		request.callback			= m_callback;
+		request.previewCallback		= m_previewCallback;
+		request.frameAllocator		= m_frameAllocator;
+
+		if (request.reportFormatChange)
+			m_formatChangeReported = true;
+
+		frameIndex++;
+		deliveryScheduled = false;
+
+		m_callbackInProgress = true;
+		lock.unlock();
+
+		captureFrame(request);
+
+		// Release the application's references outside of the lock
+		request.callback = nullptr;
+		request.previewCallback = nullptr;
+		request.frameAllocator = nullptr;
+
+		lock.lock();
+		m_callbackInProgress = false;
+		m_condition.notify_all();
+	}
+}
+
+void VirtualDeckLinkInput::captureFrame(CaptureRequest& request)
+{
+	const VirtualDisplayModeDescription*	displayMode	= request.displayMode;
+	VirtualLoopbackFrame					loopbackFrame;
+	bool									hasLoopbackFrame = false;
+
+	if (VirtualDeckLinkConfig::get().loopback)
+		hasLoopbackFrame = m_device.getLoopback().pop(loopbackFrame);
+
+	if (!request.callback)
+		return;
+
+	if (request.reportFormatChange)
+	{
+		// The detected signal is always 10-bit 4:2:2, the application is expected to restart its streams with
+		// the new mode; until then frames continue in the enabled mode, marked as having no input source
+		com_ptr<VirtualDisplayMode> newDisplayMode = make_com_ptr<VirtualDisplayMode>(*request.signalMode);
+		request.callback->VideoInputFormatChanged(bmdVideoInputDisplayModeChanged, newDisplayMode.get(), bmdDetectedVideoInputYCbCr422 | bmdDetectedVideoInput10BitDepth);
+		return;
+	}
+
+	if (m_faultInjector.shouldDrop())
+		return;
+
+	if (*m_framesInFlight >= kMaxInputFramesInFlight)
+		return;
+
+	long	width		= displayMode->width;
+	long	height		= displayMode->height;
+	long	rowBytes	= getVirtualRowBytes(request.pixelFormat, width);
+	void*	buffer		= nullptr;
+
+	if (request.frameAllocator->AllocateBuffer((uint32_t)(rowBytes * height), &buffer) != S_OK || buffer == nullptr)
+		return;
+
+	++(*m_framesInFlight);
+
+	BMDFrameFlags	frameFlags	= (request.signalMode == displayMode) ? bmdFrameFlagDefault : bmdFrameHasNoInputSource;
+	bool			videoCopied	= false;
+
+	if (hasLoopbackFrame && loopbackFrame.videoFrame && frameFlags == bmdFrameFlagDefault)
+	{
+		IDeckLinkVideoFrame*	sourceFrame = loopbackFrame.videoFrame.get();
+		void*					sourceBytes = nullptr;
+
+		if (sourceFrame->GetWidth() == width && sourceFrame->GetHeight() == height && sourceFrame->GetPixelFormat() == request.pixelFormat &&
+			sourceFrame->GetBytes(&sourceBytes) == S_OK && sourceBytes != nullptr)
+		{
+			long copyBytes = std::min(rowBytes, sourceFrame->GetRowBytes());
+			for (long y = 0; y < height; y++)
+				memcpy((uint8_t*)buffer + y * rowBytes, (uint8_t*)sourceBytes + y * sourceFrame->GetRowBytes(), copyBytes);
+			videoCopied = true;
+		}
+	}
+
+	if (!videoCopied)
+		fillVirtualFrameBlack(buffer, rowBytes, height, request.pixelFormat);
+
+	BMDTimeValue streamTime = (request.frameIndex - request.streamStartIndex) * displayMode->frameDuration;
+
+	com_ptr<VirtualVideoInputFrame> videoFrame = make_com_ptr<VirtualVideoInputFrame>(width, height, rowBytes, request.pixelFormat, frameFlags, request.frameAllocator, buffer,
+																					   streamTime, displayMode->frameDuration, displayMode->timeScale,
+																					   VirtualClock::frameTime(request.frameIndex, displayMode->frameDuration, displayMode->timeScale),
+																					   m_framesInFlight);
+
+	if (frameFlags == bmdFrameFlagDefault)
+	{
+		bool timecodeCopied = false;
+
+		if (videoCopied)
+		{
+			// Timecode and ancillary packets travel with the looped back picture
+			for (BMDTimecodeFormat format : kLoopbackTimecodeFormats)
+			{
+				com_ptr<IDeckLinkTimecode> timecode;
+				if (loopbackFrame.videoFrame->GetTimecode(format, timecode.releaseAndGetAddressOf()) == S_OK && timecode)
+				{
+					videoFrame->setTimecode(format, timecode);
+					timecodeCopied = true;
+				}
+			}
+
+			if (!loopbackFrame.ancillaryPackets.empty())
+				videoFrame->attachAncillaryPackets(loopbackFrame.ancillaryPackets);
+		}
+
+		if (!timecodeCopied)
+		{
+			// Generated source timecode, counted from the reference clock epoch
+			com_ptr<IDeckLinkTimecode> timecode(VirtualTimecode::fromFrameIndex(request.frameIndex - 1, displayMode->frameDuration, displayMode->timeScale));
+			timecode->Release();
+
+			videoFrame->setTimecode(bmdTimecodeRP188VITC1, timecode);
+			videoFrame->setTimecode(bmdTimecodeRP188LTC, timecode);
+			videoFrame->setTimecode(bmdTimecodeVITC, timecode);
+		}
+	}
+
+	com_ptr<VirtualAudioInputPacket> audioPacket;
+
+	if (request.audioEnabled)
+	{
+		// The audio packet holds the samples received during the frame period, with the 48kHz cadence across frames
+		int64_t		firstSample			= VirtualClock::audioSampleIndex(request.frameIndex - 1, displayMode->frameDuration, displayMode->timeScale);
+		int64_t		endSample			= VirtualClock::audioSampleIndex(request.frameIndex, displayMode->frameDuration, displayMode->timeScale);
+		int64_t		streamFirstSample	= VirtualClock::audioSampleIndex(request.streamStartIndex - 1, displayMode->frameDuration, displayMode->timeScale);
+		long		sampleFrameCount	= (long)(endSample - firstSample);
+		uint32_t	bufferSize			= (uint32_t)(sampleFrameCount * request.audioChannelCount * (request.audioSampleType / 8));
+		void*		audioBuffer			= nullptr;
+
+		if (m_audioAllocator->AllocateBuffer(bufferSize, &audioBuffer) == S_OK)
+		{
+			uint32_t copyBytes = 0;
+
+			if (hasLoopbackFrame && loopbackFrame.audioSampleType == request.audioSampleType && loopbackFrame.audioChannelCount == request.audioChannelCount)
+			{
+				copyBytes = std::min(bufferSize, (uint32_t)loopbackFrame.audioSamples.size());
+				memcpy(audioBuffer, loopbackFrame.audioSamples.data(), copyBytes);
+			}
+
+			memset((uint8_t*)audioBuffer + copyBytes, 0, bufferSize - copyBytes);
+
+			audioPacket = make_com_ptr<VirtualAudioInputPacket>(com_ptr<IDeckLinkMemoryAllocator>(m_audioAllocator.get()), audioBuffer, sampleFrameCount, firstSample - streamFirstSample);
+		}
+	}
+
+	if (request.previewCallback)
+		request.previewCallback->DrawFrame(videoFrame.get());
+
+	request.callback->VideoInputFrameArrived(videoFrame.get(), audioPacket.get());
+}
+
+bool VirtualDeckLinkInput::isCaptureThread() const
+{
+	return std::this_thread::get_id() == m_captureThreadID;
+}
+
+void VirtualDeckLinkInput::waitForCallbackComplete(std::unique_lock<std::mutex>& lock)
+{
+	// When called from within the callback, as when restarting streams on a format change, there is nothing to wait for
+	if (isCaptureThread())
+		return;
+
+	m_condition.wait(lock, [this] { return !m_callbackInProgress; });
+}
+
+void VirtualDeckLinkInput::stopCaptureThread(std::unique_lock<std::mutex>& lock)
+{
+	if (!m_captureThread.joinable())
+		return;
+
+	m_captureThreadGeneration++;
+	m_condition.notify_all();
+
+	if (isCaptureThread())
+	{
+		// Disabled from within the callback, the thread exits when the callback returns
+		m_captureThread.detach();
+		return;
+	}
+
+	std::thread captureThread = std::move(m_captureThread);
+
+	lock.unlock();
+	captureThread.join();
+	lock.lock();
+}
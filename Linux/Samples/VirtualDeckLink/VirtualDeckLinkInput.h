@@ -0,0 +1,154 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "DeckLinkAPI.h"
+#include "VirtualDeckLinkConfig.h"
+#include "VirtualDisplayMode.h"
+#include "VirtualVideoFrame.h"
+#include "com_ptr.h"
+
+class VirtualDeckLinkDevice;
+
+class VirtualDeckLinkInput : public IDeckLinkInput
+{
+public:
+	explicit VirtualDeckLinkInput(VirtualDeckLinkDevice& device);
+	virtual ~VirtualDeckLinkInput();
+
+	// IUnknown interface, aggregated by the device
+	HRESULT		QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG		AddRef() override;
+	ULONG		Release() override;
+
+	// IDeckLinkInput interface
+	HRESULT		DoesSupportVideoMode(BMDVideoConnection connection, BMDDisplayMode requestedMode, BMDPixelFormat requestedPixelFormat, BMDVideoInputConversionMode conversionMode, BMDSupportedVideoModeFlags flags, BMDDisplayMode* actualMode, bool* supported) override;
+	HRESULT		GetDisplayMode(BMDDisplayMode displayMode, IDeckLinkDisplayMode** resultDisplayMode) override;
+	HRESULT		GetDisplayModeIterator(IDeckLinkDisplayModeIterator** iterator) override;
+	HRESULT		SetScreenPreviewCallback(IDeckLinkScreenPreviewCallback* previewCallback) override;
+
+	HRESULT		EnableVideoInput(BMDDisplayMode displayMode, BMDPixelFormat pixelFormat, BMDVideoInputFlags flags) override;
+	HRESULT		DisableVideoInput() override;
+	HRESULT		GetAvailableVideoFrameCount(uint32_t* availableFrameCount) override;
+	HRESULT		SetVideoInputFrameMemoryAllocator(IDeckLinkMemoryAllocator* theAllocator) override;
+
+	HRESULT		EnableAudioInput(BMDAudioSampleRate sampleRate, BMDAudioSampleType sampleType, uint32_t channelCount) override;
+	HRESULT		DisableAudioInput() override;
+	HRESULT		GetAvailableAudioSampleFrameCount(uint32_t* availableSampleFrameCount) override;
+
+	HRESULT		StartStreams() override;
+	HRESULT		StopStreams() override;
+	HRESULT		PauseStreams() override;
+	HRESULT		FlushStreams() override;
+	HRESULT		SetCallback(IDeckLinkInputCallback* theCallback) override;
+
+	HRESULT		GetHardwareReferenceClock(BMDTimeScale desiredTimeScale, BMDTimeValue* hardwareTime, BMDTimeValue* timeInFrame, BMDTimeValue* ticksPerFrame) override;
+
+	// Input state reported through IDeckLinkStatus
+	bool		getVideoInputStatus(BMDDisplayMode* displayMode, BMDPixelFormat* pixelFormat, BMDVideoInputFlags* flags);
+	const VirtualDisplayModeDescription*	getSignalDisplayMode();
+
+	// Start or stop this input when another input of its capture group is started or stopped
+	void		startGroupStreams(int64_t captureGroup);
+	void		stopGroupStreams(int64_t captureGroup);
+
+private:
+	enum class StreamState { Stopped, Running, Paused };
+
+	// Parameters of one frame period, sampled under the lock and delivered without it
+	struct CaptureRequest
+	{
+		int64_t									frameIndex;
+		int64_t									streamStartIndex;
+		const VirtualDisplayModeDescription*	displayMode;
+		const VirtualDisplayModeDescription*	signalMode;
+		BMDPixelFormat							pixelFormat;
+		bool									reportFormatChange;
+		bool									audioEnabled;
+		BMDAudioSampleType						audioSampleType;
+		uint32_t								audioChannelCount;
+		com_ptr<IDeckLinkInputCallback>			callback;
+		com_ptr<IDeckLinkScreenPreviewCallback>	previewCallback;
+		com_ptr<IDeckLinkMemoryAllocator>		frameAllocator;
+	};
+
+	void		startStreams();
+	int64_t		getCaptureGroup();
+	void		captureThread(uint64_t threadGeneration);
+	void		captureFrame(CaptureRequest& request);
+	bool		isCaptureThread() const;
+	void		waitForCallbackComplete(std::unique_lock<std::mutex>& lock);
+	void		stopCaptureThread(std::unique_lock<std::mutex>& lock);
+
+	VirtualDeckLinkDevice&						m_device;
+
+	std::mutex									m_mutex;
+	std::condition_variable						m_condition;
+	std::thread									m_captureThread;
+	std::thread::id								m_captureThreadID;
+	uint64_t									m_captureThreadGeneration;
+	bool										m_callbackInProgress;
+	uint64_t									m_streamGeneration;
+
+	com_ptr<IDeckLinkInputCallback>				m_callback;
+	com_ptr<IDeckLinkScreenPreviewCallback>		m_previewCallback;
+	com_ptr<IDeckLinkMemoryAllocator>			m_frameAllocator;
+	com_ptr<VirtualMemoryAllocator>				m_audioAllocator;
+
+	bool										m_videoEnabled;
+	const VirtualDisplayModeDescription*		m_displayMode;
+	BMDPixelFormat								m_pixelFormat;
+	BMDVideoInputFlags							m_inputFlags;
+	bool										m_formatChangeReported;
+
+	bool										m_audioEnabled;
+	BMDAudioSampleType							m_audioSampleType;
+	uint32_t									m_audioChannelCount;
+
+	StreamState									m_streamState;
+	std::shared_ptr<std::atomic<uint32_t>>		m_framesInFlight;
+	VirtualFaultInjector						m_faultInjector;
+};
@@ -0,0 +1,934 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <limits.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include "VirtualClock.h"
+#include "VirtualDeckLinkDevice.h"
+#include "VirtualDeckLinkOutput.h"
+
+namespace
+{
+	// Audio sample frames that can be buffered for scheduled playback
+	const uint32_t kMaxBufferedAudioSampleFrames = 2 * bmdAudioSampleRate48kHz;
+
+	const int64_t kStopImmediately = LLONG_MIN;
+}
+
+VirtualDeckLinkOutput::VirtualDeckLinkOutput(VirtualDeckLinkDevice& device) :
+	m_device(device),
+	m_playbackThreadGeneration(0),
+	m_videoEnabled(false),
+	m_displayMode(nullptr),
+	m_outputFlags(bmdVideoOutputFlagDefault),
+	m_lastPixelFormat(bmdFormatUnspecified),
+	m_audioEnabled(false),
+	m_audioSampleType(bmdAudioSampleType16bitInteger),
+	m_audioChannelCount(0),
+	m_audioPreroll(false),
+	m_bufferedAudioSampleFrames(0),
+	m_audioBufferReadOffset(0),
+	m_frameOnAirResult(bmdOutputFrameCompleted),
+	m_frameOnAirEnd(0),
+	m_playbackRunning(false),
+	m_stopPending(false),
+	m_stopFrameIndex(0),
+	m_playbackStartFrameIndex(0),
+	m_playbackStartPeriod(0),
+	m_playbackSpeed(0.0),
+	m_completionTimestamps(),
+	m_completionTimestampIndex(0),
+	m_faultInjector(device.getDeviceIndex() * 2 + 1)
+{
+}
+
+VirtualDeckLinkOutput::~VirtualDeckLinkOutput()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	stopPlaybackThread(lock);
+}
+
+HRESULT VirtualDeckLinkOutput::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	return m_device.QueryInterface(iid, ppv);
+}
+
+ULONG VirtualDeckLinkOutput::AddRef()
+{
+	return m_device.AddRef();
+}
+
+ULONG VirtualDeckLinkOutput::Release()
+{
+	return m_device.Release();
+}
+
+HRESULT VirtualDeckLinkOutput::DoesSupportVideoMode(BMDVideoConnection connection, BMDDisplayMode requestedMode, BMDPixelFormat requestedPixelFormat, BMDVideoOutputConversionMode conversionMode, BMDSupportedVideoModeFlags flags, BMDDisplayMode* actualMode, bool* supported)
+{
+	if (supported == nullptr)
+		return E_POINTER;
+
+	*supported = (findVirtualDisplayMode(requestedMode) != nullptr) &&
+				 ((connection == bmdVideoConnectionUnspecified) || (connection & bmdVideoConnectionSDI)) &&
+				 ((requestedPixelFormat == bmdFormatUnspecified) || isVirtualPixelFormatSupported(requestedPixelFormat)) &&
+				 (conversionMode == bmdNoVideoOutputConversion);
+
+	if (actualMode != nullptr)
+		*actualMode = *supported ? requestedMode : bmdModeUnknown;
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::GetDisplayMode(BMDDisplayMode displayMode, IDeckLinkDisplayMode** resultDisplayMode)
+{
+	if (resultDisplayMode == nullptr)
+		return E_POINTER;
+
+	const VirtualDisplayModeDescription* description = findVirtualDisplayMode(displayMode);
+	if (description == nullptr)
+	{
+		*resultDisplayMode = nullptr;
+		return E_INVALIDARG;
+	}
+
+	*resultDisplayMode = new VirtualDisplayMode(*description);
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::GetDisplayModeIterator(IDeckLinkDisplayModeIterator** iterator)
+{
+	if (iterator == nullptr)
+		return E_POINTER;
+
+	*iterator = new VirtualDisplayModeIterator();
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::SetScreenPreviewCallback(IDeckLinkScreenPreviewCallback* previewCallback)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_previewCallback = previewCallback;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::EnableVideoOutput(BMDDisplayMode displayMode, BMDVideoOutputFlags flags)
+{
+	const VirtualDisplayModeDescription* description = findVirtualDisplayMode(displayMode);
+
+	if (description == nullptr)
+		return E_INVALIDARG;
+
+	// Stereoscopic playback is not simulated
+	if (flags & bmdVideoOutputDualStream3D)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_videoEnabled)
+		return E_ACCESSDENIED;
+
+	if (!m_frameAllocator)
+		m_frameAllocator = make_com_ptr<VirtualMemoryAllocator>().get();
+
+	if (m_frameAllocator->Commit() != S_OK)
+		return E_FAIL;
+
+	m_videoEnabled	= true;
+	m_displayMode	= description;
+	m_outputFlags	= flags;
+
+	uint64_t threadGeneration = ++m_playbackThreadGeneration;
+	m_playbackThread = std::thread(&VirtualDeckLinkOutput::playbackThread, this, threadGeneration);
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::DisableVideoOutput()
+{
+	std::multimap<int64_t, ScheduledFrame>	scheduledFrames;
+	com_ptr<IDeckLinkVideoFrame>			frameOnAir;
+	com_ptr<IDeckLinkVideoFrame>			lastDisplayedFrame;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		if (!m_videoEnabled)
+			return S_OK;
+
+		m_videoEnabled		= false;
+		m_playbackRunning	= false;
+		m_stopPending		= false;
+
+		stopPlaybackThread(lock);
+
+		// Outstanding frames are released without completion callbacks
+		scheduledFrames.swap(m_scheduledFrames);
+		frameOnAir			= std::move(m_frameOnAir);
+		lastDisplayedFrame	= std::move(m_lastDisplayedFrame);
+
+		m_frameAllocator->Decommit();
+	}
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::SetVideoOutputFrameMemoryAllocator(IDeckLinkMemoryAllocator* theAllocator)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_videoEnabled)
+		return E_ACCESSDENIED;
+
+	m_frameAllocator = theAllocator;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::CreateVideoFrame(int32_t width, int32_t height, int32_t rowBytes, BMDPixelFormat pixelFormat, BMDFrameFlags flags, IDeckLinkMutableVideoFrame** outFrame)
+{
+	com_ptr<IDeckLinkMemoryAllocator>	allocator;
+	void*								buffer = nullptr;
+
+	if (outFrame == nullptr)
+		return E_POINTER;
+
+	*outFrame = nullptr;
+
+	if (width <= 0 || height <= 0 || !isVirtualPixelFormatSupported(pixelFormat) || rowBytes < getVirtualRowBytes(pixelFormat, width))
+		return E_INVALIDARG;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (!m_frameAllocator)
+			m_frameAllocator = make_com_ptr<VirtualMemoryAllocator>().get();
+
+		allocator = m_frameAllocator;
+	}
+
+	if (allocator->AllocateBuffer((uint32_t)rowBytes * (uint32_t)height, &buffer) != S_OK || buffer == nullptr)
+		return E_OUTOFMEMORY;
+
+	*outFrame = new VirtualMutableVideoFrame(width, height, rowBytes, pixelFormat, flags, allocator, buffer);
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::CreateAncillaryData(BMDPixelFormat pixelFormat, IDeckLinkVideoFrameAncillary** outBuffer)
+{
+	// Only IDeckLinkVideoFrameAncillaryPackets is provided for ancillary data
+	if (outBuffer != nullptr)
+		*outBuffer = nullptr;
+
+	return E_NOTIMPL;
+}
+
+HRESULT VirtualDeckLinkOutput::DisplayVideoFrameSync(IDeckLinkVideoFrame* theFrame)
+{
+	com_ptr<IDeckLinkScreenPreviewCallback> previewCallback;
+
+	if (theFrame == nullptr)
+		return E_INVALIDARG;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (!m_videoEnabled || m_playbackRunning)
+			return E_ACCESSDENIED;
+
+		m_lastPixelFormat = theFrame->GetPixelFormat();
+		previewCallback = m_previewCallback;
+	}
+
+	if (previewCallback)
+		previewCallback->DrawFrame(theFrame);
+
+	if (VirtualDeckLinkConfig::get().loopback)
+	{
+		VirtualLoopbackFrame loopbackFrame;
+		loopbackFrame.videoFrame			= com_ptr<IDeckLinkVideoFrame>(theFrame);
+		loopbackFrame.audioSampleType		= bmdAudioSampleType16bitInteger;
+		loopbackFrame.audioChannelCount		= 0;
+		m_device.getLoopback().push(std::move(loopbackFrame));
+	}
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::ScheduleVideoFrame(IDeckLinkVideoFrame* theFrame, BMDTimeValue displayTime, BMDTimeValue displayDuration, BMDTimeScale timeScale)
+{
+	if (theFrame == nullptr || timeScale <= 0)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_videoEnabled)
+		return E_ACCESSDENIED;
+
+	ScheduledFrame scheduledFrame;
+	scheduledFrame.frame			= com_ptr<IDeckLinkVideoFrame>(theFrame);
+	scheduledFrame.durationFrames	= std::max<int64_t>(toFrameIndex(displayDuration, timeScale), 1);
+
+	m_scheduledFrames.emplace(toFrameIndex(displayTime, timeScale), std::move(scheduledFrame));
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::SetScheduledFrameCompletionCallback(IDeckLinkVideoOutputCallback* theCallback)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_videoCallback = theCallback;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::GetBufferedVideoFrameCount(uint32_t* bufferedFrameCount)
+{
+	if (bufferedFrameCount == nullptr)
+		return E_POINTER;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	*bufferedFrameCount = (uint32_t)m_scheduledFrames.size();
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::EnableAudioOutput(BMDAudioSampleRate sampleRate, BMDAudioSampleType sampleType, uint32_t channelCount, BMDAudioOutputStreamType streamType)
+{
+	if (sampleRate != bmdAudioSampleRate48kHz)
+		return E_INVALIDARG;
+
+	if (sampleType != bmdAudioSampleType16bitInteger && sampleType != bmdAudioSampleType32bitInteger)
+		return E_INVALIDARG;
+
+	if (channelCount != 2 && channelCount != 8 && channelCount != 16)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_audioEnabled)
+		return E_ACCESSDENIED;
+
+	m_audioEnabled				= true;
+	m_audioSampleType			= sampleType;
+	m_audioChannelCount			= channelCount;
+	m_audioPreroll				= false;
+	m_bufferedAudioSampleFrames	= 0;
+	m_audioBufferReadOffset		= 0;
+
+	// Sample data is only retained when it is looped back to the input, otherwise only the buffer level is tracked
+	if (VirtualDeckLinkConfig::get().loopback)
+		m_audioBuffer.assign(kMaxBufferedAudioSampleFrames * getAudioSampleFrameSize(), 0);
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::DisableAudioOutput()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_audioEnabled				= false;
+	m_audioPreroll				= false;
+	m_bufferedAudioSampleFrames	= 0;
+	m_audioBufferReadOffset		= 0;
+	std::vector<uint8_t>().swap(m_audioBuffer);
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::WriteAudioSamplesSync(void* buffer, uint32_t sampleFrameCount, uint32_t* sampleFramesWritten)
+{
+	if (buffer == nullptr || sampleFramesWritten == nullptr)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_audioEnabled || m_playbackRunning)
+		return E_ACCESSDENIED;
+
+	// Samples written synchronously are played immediately
+	*sampleFramesWritten = sampleFrameCount;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::BeginAudioPreroll()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_audioEnabled)
+		return E_ACCESSDENIED;
+
+	m_audioPreroll = true;
+	m_condition.notify_all();
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::EndAudioPreroll()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_audioPreroll = false;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::ScheduleAudioSamples(void* buffer, uint32_t sampleFrameCount, BMDTimeValue streamTime, BMDTimeScale timeScale, uint32_t* sampleFramesWritten)
+{
+	if (buffer == nullptr)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_audioEnabled)
+		return E_ACCESSDENIED;
+
+	// Samples are played contiguously in the order they are scheduled; stream times are not used to place them
+	uint32_t samplesToWrite = std::min(sampleFrameCount, kMaxBufferedAudioSampleFrames - m_bufferedAudioSampleFrames);
+
+	if (!m_audioBuffer.empty())
+	{
+		size_t	sampleFrameSize	= getAudioSampleFrameSize();
+		size_t	bytesToWrite	= samplesToWrite * sampleFrameSize;
+		size_t	writeOffset		= (m_audioBufferReadOffset + m_bufferedAudioSampleFrames * sampleFrameSize) % m_audioBuffer.size();
+		size_t	firstChunk		= std::min(bytesToWrite, m_audioBuffer.size() - writeOffset);
+
+		memcpy(&m_audioBuffer[writeOffset], buffer, firstChunk);
+		memcpy(&m_audioBuffer[0], (uint8_t*)buffer + firstChunk, bytesToWrite - firstChunk);
+	}
+
+	m_bufferedAudioSampleFrames += samplesToWrite;
+
+	if (sampleFramesWritten != nullptr)
+		*sampleFramesWritten = samplesToWrite;
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::GetBufferedAudioSampleFrameCount(uint32_t* bufferedSampleFrameCount)
+{
+	if (bufferedSampleFrameCount == nullptr)
+		return E_POINTER;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	*bufferedSampleFrameCount = m_bufferedAudioSampleFrames;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::FlushBufferedAudioSamples()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_bufferedAudioSampleFrames	= 0;
+	m_audioBufferReadOffset		= 0;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::SetAudioCallback(IDeckLinkAudioOutputCallback* theCallback)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_audioCallback = theCallback;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::StartScheduledPlayback(BMDTimeValue playbackStartTime, BMDTimeScale timeScale, double playbackSpeed)
+{
+	int64_t startTime = VirtualClock::now();
+	int64_t playbackGroup;
+
+	if (timeScale <= 0)
+		return E_INVALIDARG;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (!m_videoEnabled || m_playbackRunning)
+			return E_ACCESSDENIED;
+
+		startPlayback(startTime, playbackStartTime, timeScale, playbackSpeed);
+		playbackGroup = getPlaybackGroup();
+	}
+
+	// Starting one output of a playback group starts the others, at the same reference time
+	if (playbackGroup != 0)
+	{
+		for (VirtualDeckLinkDevice* device : getVirtualDeckLinkDevices())
+		{
+			if (device != &m_device)
+				device->getOutput().startGroupPlayback(playbackGroup, startTime, playbackStartTime, timeScale, playbackSpeed);
+		}
+	}
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::StopScheduledPlayback(BMDTimeValue stopPlaybackAtTime, BMDTimeValue* actualStopTime, BMDTimeScale timeScale)
+{
+	int64_t playbackGroup;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (!m_playbackRunning)
+			return E_ACCESSDENIED;
+
+		stopPlaybackAt(stopPlaybackAtTime, actualStopTime, timeScale);
+		playbackGroup = getPlaybackGroup();
+	}
+
+	// Stopping one output of a playback group stops the others
+	if (playbackGroup != 0)
+	{
+		for (VirtualDeckLinkDevice* device : getVirtualDeckLinkDevices())
+		{
+			if (device != &m_device)
+				device->getOutput().stopGroupPlayback(playbackGroup, stopPlaybackAtTime, timeScale);
+		}
+	}
+
+	return S_OK;
+}
+
+void VirtualDeckLinkOutput::startGroupPlayback(int64_t playbackGroup, int64_t startTime, BMDTimeValue playbackStartTime, BMDTimeScale timeScale, double playbackSpeed)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_videoEnabled && !m_playbackRunning && getPlaybackGroup() == playbackGroup)
+		startPlayback(startTime, playbackStartTime, timeScale, playbackSpeed);
+}
+
+void VirtualDeckLinkOutput::stopGroupPlayback(int64_t playbackGroup, BMDTimeValue stopPlaybackAtTime, BMDTimeScale timeScale)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_playbackRunning && getPlaybackGroup() == playbackGroup)
+		stopPlaybackAt(stopPlaybackAtTime, nullptr, timeScale);
+}
+
+void VirtualDeckLinkOutput::startPlayback(int64_t startTime, BMDTimeValue playbackStartTime, BMDTimeScale timeScale, double playbackSpeed)
+{
+	// Playback starts on the next frame boundary of the reference.  Frames are always
+	// displayed at normal rate, the requested speed is only reported back.
+	m_playbackStartFrameIndex	= toFrameIndex(playbackStartTime, timeScale);
+	m_playbackStartPeriod		= VirtualClock::nextFrameIndex(startTime, m_displayMode->frameDuration, m_displayMode->timeScale);
+	m_playbackSpeed				= playbackSpeed;
+	m_playbackRunning			= true;
+	m_stopPending				= false;
+	m_audioPreroll				= false;
+
+	m_condition.notify_all();
+}
+
+void VirtualDeckLinkOutput::stopPlaybackAt(BMDTimeValue stopPlaybackAtTime, BMDTimeValue* actualStopTime, BMDTimeScale timeScale)
+{
+	// A zero timescale stops playback immediately, otherwise at the given stream time.  In both cases
+	// ScheduledPlaybackHasStopped is called once the remaining frames have been completed or flushed.
+	if (timeScale == 0)
+	{
+		m_stopFrameIndex = kStopImmediately;
+	}
+	else
+	{
+		int64_t stopFrameIndex = toFrameIndex(stopPlaybackAtTime, timeScale);
+		m_stopFrameIndex = m_stopPending ? std::min(m_stopFrameIndex, stopFrameIndex) : stopFrameIndex;
+	}
+
+	m_stopPending = true;
+
+	if (actualStopTime != nullptr)
+	{
+		if (timeScale == 0)
+			*actualStopTime = 0;
+		else
+			*actualStopTime = m_stopFrameIndex * m_displayMode->frameDuration * timeScale / m_displayMode->timeScale;
+	}
+
+	m_condition.notify_all();
+}
+
+int64_t VirtualDeckLinkOutput::getPlaybackGroup()
+{
+	if (!(m_outputFlags & bmdVideoOutputSynchronizeToPlaybackGroup))
+		return 0;
+
+	return m_device.getConfiguration().getInt(bmdDeckLinkConfigPlaybackGroup);
+}
+
+HRESULT VirtualDeckLinkOutput::IsScheduledPlaybackRunning(bool* active)
+{
+	if (active == nullptr)
+		return E_POINTER;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	*active = m_playbackRunning;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::GetScheduledStreamTime(BMDTimeScale desiredTimeScale, BMDTimeValue* streamTime, double* playbackSpeed)
+{
+	if (streamTime == nullptr || playbackSpeed == nullptr)
+		return E_POINTER;
+
+	if (desiredTimeScale <= 0)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_playbackRunning)
+	{
+		*streamTime		= 0;
+		*playbackSpeed	= 0.0;
+		return S_OK;
+	}
+
+	int64_t elapsed = VirtualClock::now() - VirtualClock::frameTime(m_playbackStartPeriod, m_displayMode->frameDuration, m_displayMode->timeScale);
+
+	*streamTime		= m_playbackStartFrameIndex * m_displayMode->frameDuration * desiredTimeScale / m_displayMode->timeScale +
+					  VirtualClock::toTimescale(std::max<int64_t>(elapsed, 0), desiredTimeScale);
+	*playbackSpeed	= m_playbackSpeed;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::GetReferenceStatus(BMDReferenceStatus* referenceStatus)
+{
+	if (referenceStatus == nullptr)
+		return E_POINTER;
+
+	// All virtual devices are locked to the common reference clock
+	*referenceStatus = bmdReferenceLocked;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::GetHardwareReferenceClock(BMDTimeScale desiredTimeScale, BMDTimeValue* hardwareTime, BMDTimeValue* timeInFrame, BMDTimeValue* ticksPerFrame)
+{
+	if (hardwareTime == nullptr || timeInFrame == nullptr || ticksPerFrame == nullptr)
+		return E_POINTER;
+
+	if (desiredTimeScale <= 0)
+		return E_INVALIDARG;
+
+	int64_t now = VirtualClock::now();
+	*hardwareTime = VirtualClock::toTimescale(now, desiredTimeScale);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_videoEnabled)
+	{
+		*timeInFrame	= 0;
+		*ticksPerFrame	= 0;
+		return S_OK;
+	}
+
+	int64_t frameStart = VirtualClock::frameTime(VirtualClock::currentFrameIndex(now, m_displayMode->frameDuration, m_displayMode->timeScale), m_displayMode->frameDuration, m_displayMode->timeScale);
+
+	*timeInFrame	= VirtualClock::toTimescale(now - frameStart, desiredTimeScale);
+	*ticksPerFrame	= m_displayMode->frameDuration * desiredTimeScale / m_displayMode->timeScale;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::GetFrameCompletionReferenceTimestamp(IDeckLinkVideoFrame* theFrame, BMDTimeScale desiredTimeScale, BMDTimeValue* frameCompletionTimestamp)
+{
+	if (theFrame == nullptr || frameCompletionTimestamp == nullptr)
+		return E_INVALIDARG;
+
+	if (desiredTimeScale <= 0)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// Search the recent completions, newest first, as the same frame object may be scheduled repeatedly
+	for (size_t i = 1; i <= m_completionTimestamps.size(); i++)
+	{
+		const CompletionTimestamp& entry = m_completionTimestamps[(m_completionTimestampIndex + m_completionTimestamps.size() - i) % m_completionTimestamps.size()];
+
+		if (entry.frame == theFrame)
+		{
+			*frameCompletionTimestamp = VirtualClock::toTimescale(entry.time, desiredTimeScale);
+			return S_OK;
+		}
+	}
+
+	return E_FAIL;
+}
+
+bool VirtualDeckLinkOutput::getVideoOutputStatus(BMDDisplayMode* displayMode, BMDVideoOutputFlags* flags, BMDPixelFormat* lastPixelFormat)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_videoEnabled)
+		return false;
+
+	*displayMode		= m_displayMode->displayMode;
+	*flags				= m_outputFlags;
+	*lastPixelFormat	= m_lastPixelFormat;
+	return true;
+}
+
+void VirtualDeckLinkOutput::playbackThread(uint64_t threadGeneration)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	const VirtualDisplayModeDescription*	displayMode		= m_displayMode;
+	int64_t									periodIndex		= VirtualClock::nextFrameIndex(VirtualClock::now(), displayMode->frameDuration, displayMode->timeScale);
+	int64_t									deliveryTime	= VirtualClock::frameTime(periodIndex, displayMode->frameDuration, displayMode->timeScale) + m_faultInjector.nextJitter();
+
+	m_playbackThreadID = std::this_thread::get_id();
+
+	while (threadGeneration == m_playbackThreadGeneration)
+	{
+		FramePeriod period;
+
+		if (m_stopPending && m_stopFrameIndex == kStopImmediately)
+		{
+			stopPlayback(VirtualClock::now(), period);
+		}
+		else
+		{
+			int64_t now = VirtualClock::now();
+			if (now < deliveryTime)
+			{
+				m_condition.wait_for(lock, std::chrono::nanoseconds(deliveryTime - now));
+				continue;
+			}
+
+			// Frame periods missed while callbacks were running are skipped, frames scheduled for them are dropped
+			periodIndex = std::max(periodIndex, VirtualClock::currentFrameIndex(now, displayMode->frameDuration, displayMode->timeScale));
+
+			processFramePeriod(periodIndex, period);
+
+			periodIndex++;
+			deliveryTime = VirtualClock::frameTime(periodIndex, displayMode->frameDuration, displayMode->timeScale) + m_faultInjector.nextJitter();
+		}
+
+		period.videoCallback	= m_videoCallback;
+		period.audioCallback	= m_audioCallback;
+		period.previewCallback	= m_previewCallback;
+
+		lock.unlock();
+		deliverFramePeriod(period);
+		lock.lock();
+	}
+}
+
+void VirtualDeckLinkOutput::processFramePeriod(int64_t periodIndex, FramePeriod& period)
+{
+	const VirtualDisplayModeDescription* displayMode = m_displayMode;
+	int64_t periodStart = VirtualClock::frameTime(periodIndex, displayMode->frameDuration, displayMode->timeScale);
+
+	period.playbackStopped	= false;
+	period.renderAudio		= m_audioEnabled && m_audioCallback && (m_audioPreroll || m_playbackRunning);
+	period.audioPreroll		= m_audioPreroll && !m_playbackRunning;
+
+	if (!m_playbackRunning || periodIndex < m_playbackStartPeriod)
+		return;
+
+	// Stream frame index displayed during this frame period
+	int64_t frameIndex = m_playbackStartFrameIndex + (periodIndex - m_playbackStartPeriod);
+
+	if (m_stopPending && frameIndex >= m_stopFrameIndex)
+	{
+		stopPlayback(periodStart, period);
+		return;
+	}
+
+	// Of the frames due by now, the latest is displayed and any earlier ones are dropped
+	auto due = m_scheduledFrames.upper_bound(frameIndex);
+	if (due != m_scheduledFrames.begin())
+	{
+		auto displayed = std::prev(due);
+
+		for (auto iter = m_scheduledFrames.begin(); iter != displayed; ++iter)
+			completeFrame(iter->second.frame, bmdOutputFrameDropped, periodStart, period);
+
+		// The frame on air until now completes at the start of this frame period
+		if (m_frameOnAir)
+			completeFrame(m_frameOnAir, m_frameOnAirResult, periodStart, period);
+
+		ScheduledFrame scheduledFrame = std::move(displayed->second);
+		bool late = displayed->first < frameIndex;
+
+		m_scheduledFrames.erase(m_scheduledFrames.begin(), due);
+		m_frameOnAir = nullptr;
+
+		if (m_faultInjector.shouldDrop())
+		{
+			completeFrame(scheduledFrame.frame, bmdOutputFrameDropped, periodStart, period);
+		}
+		else
+		{
+			m_frameOnAir			= scheduledFrame.frame;
+			m_frameOnAirResult		= late ? bmdOutputFrameDisplayedLate : bmdOutputFrameCompleted;
+			m_frameOnAirEnd			= frameIndex + scheduledFrame.durationFrames;
+			m_lastDisplayedFrame	= scheduledFrame.frame;
+			m_lastPixelFormat		= scheduledFrame.frame->GetPixelFormat();
+		}
+	}
+	else if (m_frameOnAir && frameIndex >= m_frameOnAirEnd)
+	{
+		// Nothing new to display, the last frame is repeated
+		completeFrame(m_frameOnAir, m_frameOnAirResult, periodStart, period);
+		m_frameOnAir = nullptr;
+	}
+
+	period.displayedFrame = m_lastDisplayedFrame;
+	consumeAudio(periodIndex, period);
+}
+
+void VirtualDeckLinkOutput::stopPlayback(int64_t completionTime, FramePeriod& period)
+{
+	if (m_frameOnAir)
+		completeFrame(m_frameOnAir, m_frameOnAirResult, completionTime, period);
+
+	for (auto& scheduledFrame : m_scheduledFrames)
+		completeFrame(scheduledFrame.second.frame, bmdOutputFrameFlushed, completionTime, period);
+
+	m_scheduledFrames.clear();
+	m_frameOnAir				= nullptr;
+	m_lastDisplayedFrame		= nullptr;
+	m_playbackRunning			= false;
+	m_stopPending				= false;
+	m_bufferedAudioSampleFrames	= 0;
+	m_audioBufferReadOffset		= 0;
+
+	period.playbackStopped		= true;
+	period.renderAudio			= false;
+}
+
+void VirtualDeckLinkOutput::completeFrame(const com_ptr<IDeckLinkVideoFrame>& frame, BMDOutputFrameCompletionResult result, int64_t completionTime, FramePeriod& period)
+{
+	m_completionTimestamps[m_completionTimestampIndex] = { frame.get(), completionTime };
+	m_completionTimestampIndex = (m_completionTimestampIndex + 1) % m_completionTimestamps.size();
+
+	period.completedFrames.push_back({ frame, result });
+}
+
+void VirtualDeckLinkOutput::consumeAudio(int64_t periodIndex, FramePeriod& period)
+{
+	if (!m_audioEnabled)
+		return;
+
+	const VirtualDisplayModeDescription* displayMode = m_displayMode;
+
+	uint32_t samplesInPeriod	= (uint32_t)(VirtualClock::audioSampleIndex(periodIndex + 1, displayMode->frameDuration, displayMode->timeScale) -
+											 VirtualClock::audioSampleIndex(periodIndex, displayMode->frameDuration, displayMode->timeScale));
+	uint32_t samplesPlayed		= std::min(samplesInPeriod, m_bufferedAudioSampleFrames);
+
+	if (!m_audioBuffer.empty())
+	{
+		size_t sampleFrameSize	= getAudioSampleFrameSize();
+		size_t bytesPlayed		= samplesPlayed * sampleFrameSize;
+		size_t firstChunk		= std::min(bytesPlayed, m_audioBuffer.size() - m_audioBufferReadOffset);
+
+		// Underruns are heard as silence
+		period.audioSamples.assign(samplesInPeriod * sampleFrameSize, 0);
+		memcpy(period.audioSamples.data(), &m_audioBuffer[m_audioBufferReadOffset], firstChunk);
+		memcpy(period.audioSamples.data() + firstChunk, &m_audioBuffer[0], bytesPlayed - firstChunk);
+
+		m_audioBufferReadOffset = (m_audioBufferReadOffset + bytesPlayed) % m_audioBuffer.size();
+	}
+
+	period.audioSampleType		= m_audioSampleType;
+	period.audioChannelCount	= m_audioChannelCount;
+	m_bufferedAudioSampleFrames -= samplesPlayed;
+}
+
+void VirtualDeckLinkOutput::deliverFramePeriod(FramePeriod& period)
+{
+	// The displayed frame is looped back before the completion callbacks, which may reschedule and modify it
+	if (period.displayedFrame && VirtualDeckLinkConfig::get().loopback)
+	{
+		VirtualLoopbackFrame loopbackFrame;
+		loopbackFrame.videoFrame		= period.displayedFrame;
+		loopbackFrame.audioSamples		= std::move(period.audioSamples);
+		loopbackFrame.audioSampleType	= period.audioSampleType;
+		loopbackFrame.audioChannelCount	= period.audioChannelCount;
+		m_device.getLoopback().push(std::move(loopbackFrame));
+	}
+
+	if (period.videoCallback)
+	{
+		for (auto& completedFrame : period.completedFrames)
+			period.videoCallback->ScheduledFrameCompleted(completedFrame.frame.get(), completedFrame.result);
+
+		if (period.playbackStopped)
+			period.videoCallback->ScheduledPlaybackHasStopped();
+	}
+
+	if (period.displayedFrame && period.previewCallback)
+		period.previewCallback->DrawFrame(period.displayedFrame.get());
+
+	if (period.renderAudio && period.audioCallback)
+		period.audioCallback->RenderAudioSamples(period.audioPreroll);
+
+	// Release references to application objects before the lock is retaken
+	period.completedFrames.clear();
+	period.displayedFrame	= nullptr;
+	period.videoCallback	= nullptr;
+	period.audioCallback	= nullptr;
+	period.previewCallback	= nullptr;
+}
+
+void VirtualDeckLinkOutput::stopPlaybackThread(std::unique_lock<std::mutex>& lock)
+{
+	if (!m_playbackThread.joinable())
+		return;
+
+	m_playbackThreadGeneration++;
+	m_condition.notify_all();
+
+	if (std::this_thread::get_id() == m_playbackThreadID)
+	{
+		// Disabled from within a callback, the thread exits when the callback returns
+		m_playbackThread.detach();
+		return;
+	}
+
+	std::thread playbackThread = std::move(m_playbackThread);
+
+	lock.unlock();
+	playbackThread.join();
+	lock.lock();
+}
+
+int64_t VirtualDeckLinkOutput::toFrameIndex(BMDTimeValue time, BMDTimeScale timeScale) const
+{
+	BMDTimeValue frameDuration = m_displayMode->frameDuration * timeScale;
+	return (time * m_displayMode->timeScale + frameDuration / 2) / frameDuration;
+}
+
+uint32_t VirtualDeckLinkOutput::getAudioSampleFrameSize() const
+{
+	return m_audioChannelCount * (m_audioSampleType / 8);
+}
@@ -0,0 +1,200 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "DeckLinkAPI.h"
+#include "VirtualDeckLinkConfig.h"
+#include "VirtualDisplayMode.h"
+#include "VirtualVideoFrame.h"
+#include "com_ptr.h"
+
+class VirtualDeckLinkDevice;
+
+class VirtualDeckLinkOutput : public IDeckLinkOutput
+{
+public:
+	explicit VirtualDeckLinkOutput(VirtualDeckLinkDevice& device);
+	virtual ~VirtualDeckLinkOutput();
+
+	// IUnknown interface, aggregated by the device
+	HRESULT		QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG		AddRef() override;
+	ULONG		Release() override;
+
+	// IDeckLinkOutput interface
+	HRESULT		DoesSupportVideoMode(BMDVideoConnection connection, BMDDisplayMode requestedMode, BMDPixelFormat requestedPixelFormat, BMDVideoOutputConversionMode conversionMode, BMDSupportedVideoModeFlags flags, BMDDisplayMode* actualMode, bool* supported) override;
+	HRESULT		GetDisplayMode(BMDDisplayMode displayMode, IDeckLinkDisplayMode** resultDisplayMode) override;
+	HRESULT		GetDisplayModeIterator(IDeckLinkDisplayModeIterator** iterator) override;
+	HRESULT		SetScreenPreviewCallback(IDeckLinkScreenPreviewCallback* previewCallback) override;
+
+	HRESULT		EnableVideoOutput(BMDDisplayMode displayMode, BMDVideoOutputFlags flags) override;
+	HRESULT		DisableVideoOutput() override;
+	HRESULT		SetVideoOutputFrameMemoryAllocator(IDeckLinkMemoryAllocator* theAllocator) override;
+	HRESULT		CreateVideoFrame(int32_t width, int32_t height, int32_t rowBytes, BMDPixelFormat pixelFormat, BMDFrameFlags flags, IDeckLinkMutableVideoFrame** outFrame) override;
+	HRESULT		CreateAncillaryData(BMDPixelFormat pixelFormat, IDeckLinkVideoFrameAncillary** outBuffer) override;
+	HRESULT		DisplayVideoFrameSync(IDeckLinkVideoFrame* theFrame) override;
+	HRESULT		ScheduleVideoFrame(IDeckLinkVideoFrame* theFrame, BMDTimeValue displayTime, BMDTimeValue displayDuration, BMDTimeScale timeScale) override;
+	HRESULT		SetScheduledFrameCompletionCallback(IDeckLinkVideoOutputCallback* theCallback) override;
+	HRESULT		GetBufferedVideoFrameCount(uint32_t* bufferedFrameCount) override;
+
+	HRESULT		EnableAudioOutput(BMDAudioSampleRate sampleRate, BMDAudioSampleType sampleType, uint32_t channelCount, BMDAudioOutputStreamType streamType) override;
+	HRESULT		DisableAudioOutput() override;
+	HRESULT		WriteAudioSamplesSync(void* buffer, uint32_t sampleFrameCount, uint32_t* sampleFramesWritten) override;
+	HRESULT		BeginAudioPreroll() override;
+	HRESULT		EndAudioPreroll() override;
+	HRESULT		ScheduleAudioSamples(void* buffer, uint32_t sampleFrameCount, BMDTimeValue streamTime, BMDTimeScale timeScale, uint32_t* sampleFramesWritten) override;
+	HRESULT		GetBufferedAudioSampleFrameCount(uint32_t* bufferedSampleFrameCount) override;
+	HRESULT		FlushBufferedAudioSamples() override;
+	HRESULT		SetAudioCallback(IDeckLinkAudioOutputCallback* theCallback) override;
+
+	HRESULT		StartScheduledPlayback(BMDTimeValue playbackStartTime, BMDTimeScale timeScale, double playbackSpeed) override;
+	HRESULT		StopScheduledPlayback(BMDTimeValue stopPlaybackAtTime, BMDTimeValue* actualStopTime, BMDTimeScale timeScale) override;
+	HRESULT		IsScheduledPlaybackRunning(bool* active) override;
+	HRESULT		GetScheduledStreamTime(BMDTimeScale desiredTimeScale, BMDTimeValue* streamTime, double* playbackSpeed) override;
+	HRESULT		GetReferenceStatus(BMDReferenceStatus* referenceStatus) override;
+
+	HRESULT		GetHardwareReferenceClock(BMDTimeScale desiredTimeScale, BMDTimeValue* hardwareTime, BMDTimeValue* timeInFrame, BMDTimeValue* ticksPerFrame) override;
+	HRESULT		GetFrameCompletionReferenceTimestamp(IDeckLinkVideoFrame* theFrame, BMDTimeScale desiredTimeScale, BMDTimeValue* frameCompletionTimestamp) override;
+
+	// Output state reported through IDeckLinkStatus
+	bool		getVideoOutputStatus(BMDDisplayMode* displayMode, BMDVideoOutputFlags* flags, BMDPixelFormat* lastPixelFormat);
+
+	// Start or stop this output when another output of its playback group is started or stopped
+	void		startGroupPlayback(int64_t playbackGroup, int64_t startTime, BMDTimeValue playbackStartTime, BMDTimeScale timeScale, double playbackSpeed);
+	void		stopGroupPlayback(int64_t playbackGroup, BMDTimeValue stopPlaybackAtTime, BMDTimeScale timeScale);
+
+private:
+	struct ScheduledFrame
+	{
+		com_ptr<IDeckLinkVideoFrame>	frame;
+		int64_t							durationFrames;
+	};
+
+	struct CompletedFrame
+	{
+		com_ptr<IDeckLinkVideoFrame>		frame;
+		BMDOutputFrameCompletionResult		result;
+	};
+
+	struct CompletionTimestamp
+	{
+		IDeckLinkVideoFrame*	frame;
+		int64_t					time;
+	};
+
+	// Work for one frame period, collected under the lock and performed without it
+	struct FramePeriod
+	{
+		std::vector<CompletedFrame>				completedFrames;
+		com_ptr<IDeckLinkVideoFrame>			displayedFrame;
+		std::vector<uint8_t>					audioSamples;
+		BMDAudioSampleType						audioSampleType;
+		uint32_t								audioChannelCount;
+		bool									playbackStopped;
+		bool									renderAudio;
+		bool									audioPreroll;
+		com_ptr<IDeckLinkVideoOutputCallback>	videoCallback;
+		com_ptr<IDeckLinkAudioOutputCallback>	audioCallback;
+		com_ptr<IDeckLinkScreenPreviewCallback>	previewCallback;
+	};
+
+	void		startPlayback(int64_t startTime, BMDTimeValue playbackStartTime, BMDTimeScale timeScale, double playbackSpeed);
+	void		stopPlaybackAt(BMDTimeValue stopPlaybackAtTime, BMDTimeValue* actualStopTime, BMDTimeScale timeScale);
+	int64_t		getPlaybackGroup();
+	void		playbackThread(uint64_t threadGeneration);
+	void		processFramePeriod(int64_t frameIndex, FramePeriod& period);
+	void		stopPlayback(int64_t completionTime, FramePeriod& period);
+	void		completeFrame(const com_ptr<IDeckLinkVideoFrame>& frame, BMDOutputFrameCompletionResult result, int64_t completionTime, FramePeriod& period);
+	void		consumeAudio(int64_t frameIndex, FramePeriod& period);
+	void		deliverFramePeriod(FramePeriod& period);
+	void		stopPlaybackThread(std::unique_lock<std::mutex>& lock);
+	int64_t		toFrameIndex(BMDTimeValue time, BMDTimeScale timeScale) const;
+	uint32_t	getAudioSampleFrameSize() const;
+
+	VirtualDeckLinkDevice&						m_device;
+
+	std::mutex									m_mutex;
+	std::condition_variable						m_condition;
+	std::thread									m_playbackThread;
+	std::thread::id								m_playbackThreadID;
+	uint64_t									m_playbackThreadGeneration;
+
+	com_ptr<IDeckLinkVideoOutputCallback>		m_videoCallback;
+	com_ptr<IDeckLinkAudioOutputCallback>		m_audioCallback;
+	com_ptr<IDeckLinkScreenPreviewCallback>		m_previewCallback;
+	com_ptr<IDeckLinkMemoryAllocator>			m_frameAllocator;
+
+	bool										m_videoEnabled;
+	const VirtualDisplayModeDescription*		m_displayMode;
+	BMDVideoOutputFlags							m_outputFlags;
+	BMDPixelFormat								m_lastPixelFormat;
+
+	bool										m_audioEnabled;
+	BMDAudioSampleType							m_audioSampleType;
+	uint32_t									m_audioChannelCount;
+	bool										m_audioPreroll;
+	uint32_t									m_bufferedAudioSampleFrames;
+	std::vector<uint8_t>						m_audioBuffer;
+	size_t										m_audioBufferReadOffset;
+
+	std::multimap<int64_t, ScheduledFrame>		m_scheduledFrames;
+	com_ptr<IDeckLinkVideoFrame>				m_frameOnAir;
+	BMDOutputFrameCompletionResult				m_frameOnAirResult;
+	int64_t										m_frameOnAirEnd;
+	com_ptr<IDeckLinkVideoFrame>				m_lastDisplayedFrame;
+
+	bool										m_playbackRunning;
+	bool										m_stopPending;
+	int64_t										m_stopFrameIndex;
+	int64_t										m_playbackStartFrameIndex;
+	int64_t										m_playbackStartPeriod;
+	double										m_playbackSpeed;
+
+	std::array<CompletionTimestamp, 64>			m_completionTimestamps;
+	size_t										m_completionTimestampIndex;
+	VirtualFaultInjector						m_faultInjector;
+};
@@ -0,0 +1,352 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "VirtualDisplayMode.h"
+#include "platform.h"
+
+namespace
+{
+	const BMDDisplayModeFlags kSDFlags	= bmdDisplayModeColorspaceRec601;
+	const BMDDisplayModeFlags kHDFlags	= bmdDisplayModeColorspaceRec709;
+	const BMDDisplayModeFlags kUHDFlags	= bmdDisplayModeColorspaceRec709 | bmdDisplayModeColorspaceRec2020;
+
+	const std::vector<VirtualDisplayModeDescription> kDisplayModes =
+	{
+		{ bmdModeNTSC,				"NTSC",			720,	486,	1001,	30000,	bmdLowerFieldFirst,		kSDFlags },
+		{ bmdModeNTSC2398,			"NTSC 23.98",	720,	486,	1001,	24000,	bmdLowerFieldFirst,		kSDFlags },
+		{ bmdModePAL,				"PAL",			720,	576,	1000,	25000,	bmdUpperFieldFirst,		kSDFlags },
+		{ bmdModeNTSCp,				"NTSC p",		720,	486,	1001,	60000,	bmdProgressiveFrame,	kSDFlags },
+		{ bmdModePALp,				"PAL p",		720,	576,	1000,	50000,	bmdProgressiveFrame,	kSDFlags },
+
+		{ bmdModeHD720p50,			"720p50",		1280,	720,	1000,	50000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdModeHD720p5994,		"720p59.94",	1280,	720,	1001,	60000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdModeHD720p60,			"720p60",		1280,	720,	1000,	60000,	bmdProgressiveFrame,	kHDFlags },
+
+		{ bmdModeHD1080p2398,		"1080p23.98",	1920,	1080,	1001,	24000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdModeHD1080p24,			"1080p24",		1920,	1080,	1000,	24000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdModeHD1080p25,			"1080p25",		1920,	1080,	1000,	25000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdModeHD1080p2997,		"1080p29.97",	1920,	1080,	1001,	30000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdModeHD1080p30,			"1080p30",		1920,	1080,	1000,	30000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdModeHD1080p4795,		"1080p47.95",	1920,	1080,	1001,	48000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdModeHD1080p48,			"1080p48",		1920,	1080,	1000,	48000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdModeHD1080i50,			"1080i50",		1920,	1080,	1000,	25000,	bmdUpperFieldFirst,		kHDFlags },
+		{ bmdModeHD1080i5994,		"1080i59.94",	1920,	1080,	1001,	30000,	bmdUpperFieldFirst,		kHDFlags },
+		{ bmdModeHD1080i6000,		"1080i60",		1920,	1080,	1000,	30000,	bmdUpperFieldFirst,		kHDFlags },
+		{ bmdModeHD1080p50,			"1080p50",		1920,	1080,	1000,	50000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdModeHD1080p5994,		"1080p59.94",	1920,	1080,	1001,	60000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdModeHD1080p6000,		"1080p60",		1920,	1080,	1000,	60000,	bmdProgressiveFrame,	kHDFlags },
+
+		{ bmdMode2k2398,			"2K 23.98",		2048,	1556,	1001,	24000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdMode2k24,				"2K 24",		2048,	1556,	1000,	24000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdMode2k25,				"2K 25",		2048,	1556,	1000,	25000,	bmdProgressiveFrame,	kHDFlags },
+
+		{ bmdMode2kDCI2398,			"2K DCI 23.98",	2048,	1080,	1001,	24000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdMode2kDCI24,			"2K DCI 24",	2048,	1080,	1000,	24000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdMode2kDCI25,			"2K DCI 25",	2048,	1080,	1000,	25000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdMode2kDCI2997,			"2K DCI 29.97",	2048,	1080,	1001,	30000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdMode2kDCI30,			"2K DCI 30",	2048,	1080,	1000,	30000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdMode2kDCI50,			"2K DCI 50",	2048,	1080,	1000,	50000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdMode2kDCI5994,			"2K DCI 59.94",	2048,	1080,	1001,	60000,	bmdProgressiveFrame,	kHDFlags },
+		{ bmdMode2kDCI60,			"2K DCI 60",	2048,	1080,	1000,	60000,	bmdProgressiveFrame,	kHDFlags },
+
+		{ bmdMode4K2160p2398,		"2160p23.98",	3840,	2160,	1001,	24000,	bmdProgressiveFrame,	kUHDFlags },
+		{ bmdMode4K2160p24,			"2160p24",		3840,	2160,	1000,	24000,	bmdProgressiveFrame,	kUHDFlags },
+		{ bmdMode4K2160p25,			"2160p25",		3840,	2160,	1000,	25000,	bmdProgressiveFrame,	kUHDFlags },
+		{ bmdMode4K2160p2997,		"2160p29.97",	3840,	2160,	1001,	30000,	bmdProgressiveFrame,	kUHDFlags },
+		{ bmdMode4K2160p30,			"2160p30",		3840,	2160,	1000,	30000,	bmdProgressiveFrame,	kUHDFlags },
+		{ bmdMode4K2160p50,			"2160p50",		3840,	2160,	1000,	50000,	bmdProgressiveFrame,	kUHDFlags },
+		{ bmdMode4K2160p5994,		"2160p59.94",	3840,	2160,	1001,	60000,	bmdProgressiveFrame,	kUHDFlags },
+		{ bmdMode4K2160p60,			"2160p60",		3840,	2160,	1000,	60000,	bmdProgressiveFrame,	kUHDFlags },
+
+		{ bmdMode4kDCI2398,			"4K DCI 23.98",	4096,	2160,	1001,	24000,	bmdProgressiveFrame,	kUHDFlags },
+		{ bmdMode4kDCI24,			"4K DCI 24",	4096,	2160,	1000,	24000,	bmdProgressiveFrame,	kUHDFlags },
+		{ bmdMode4kDCI25,			"4K DCI 25",	4096,	2160,	1000,	25000,	bmdProgressiveFrame,	kUHDFlags },
+		{ bmdMode4kDCI2997,			"4K DCI 29.97",	4096,	2160,	1001,	30000,	bmdProgressiveFrame,	kUHDFlags },
+		{ bmdMode4kDCI30,			"4K DCI 30",	4096,	2160,	1000,	30000,	bmdProgressiveFrame,	kUHDFlags },
+		{ bmdMode4kDCI50,			"4K DCI 50",	4096,	2160,	1000,	50000,	bmdProgressiveFrame,	kUHDFlags },
+		{ bmdMode4kDCI5994,			"4K DCI 59.94",	4096,	2160,	1001,	60000,	bmdProgressiveFrame,	kUHDFlags },
+		{ bmdMode4kDCI60,			"4K DCI 60",	4096,	2160,	1000,	60000,	bmdProgressiveFrame,	kUHDFlags },
+	};
+
+	const std::vector<BMDPixelFormat> kPixelFormats =
+	{
+		bmdFormat8BitYUV,
+		bmdFormat10BitYUV,
+		bmdFormat8BitARGB,
+		bmdFormat8BitBGRA,
+		bmdFormat10BitRGB,
+		bmdFormat12BitRGB,
+		bmdFormat12BitRGBLE,
+		bmdFormat10BitRGBXLE,
+		bmdFormat10BitRGBX,
+	};
+}
+
+const std::vector<VirtualDisplayModeDescription>& getVirtualDisplayModes()
+{
+	return kDisplayModes;
+}
+
+const VirtualDisplayModeDescription* findVirtualDisplayMode(BMDDisplayMode displayMode)
+{
+	for (auto& description : kDisplayModes)
+	{
+		if (description.displayMode == displayMode)
+			return &description;
+	}
+
+	return nullptr;
+}
+
+bool isVirtualPixelFormatSupported(BMDPixelFormat pixelFormat)
+{
+	for (auto format : kPixelFormats)
+	{
+		if (format == pixelFormat)
+			return true;
+	}
+
+	return false;
+}
+
+long getVirtualRowBytes(BMDPixelFormat pixelFormat, long frameWidth)
+{
+	switch (pixelFormat)
+	{
+		case bmdFormat8BitYUV:
+			return frameWidth * 2;
+
+		case bmdFormat10BitYUV:
+			return ((frameWidth + 47) / 48) * 128;
+
+		case bmdFormat10BitRGB:
+		case bmdFormat10BitRGBXLE:
+		case bmdFormat10BitRGBX:
+			return ((frameWidth + 63) / 64) * 256;
+
+		case bmdFormat12BitRGB:
+		case bmdFormat12BitRGBLE:
+			return ((frameWidth + 7) / 8) * 36;
+
+		case bmdFormat8BitARGB:
+		case bmdFormat8BitBGRA:
+		default:
+			return frameWidth * 4;
+	}
+}
+
+void fillVirtualFrameBlack(void* buffer, long rowBytes, long height, BMDPixelFormat pixelFormat)
+{
+	uint32_t	pattern[2];
+	uint8_t*	row = (uint8_t*)buffer;
+
+	switch (pixelFormat)
+	{
+		case bmdFormat8BitYUV:
+			// Cb Y Cr Y with video levels
+			pattern[0] = pattern[1] = 0x10801080;
+			break;
+
+		case bmdFormat10BitYUV:
+			// v210 words alternate between Cb Y Cr and Y Cb Y triplets
+			pattern[0] = 0x20010200;
+			pattern[1] = 0x04080040;
+			break;
+
+		case bmdFormat8BitARGB:
+			pattern[0] = pattern[1] = 0x000000FF;
+			break;
+
+		case bmdFormat8BitBGRA:
+			pattern[0] = pattern[1] = 0xFF000000;
+			break;
+
+		default:
+			memset(buffer, 0, rowBytes * height);
+			return;
+	}
+
+	uint32_t* firstRow = (uint32_t*)row;
+	for (long i = 0; i < rowBytes / 4; i++)
+		firstRow[i] = pattern[i & 1];
+
+	for (long y = 1; y < height; y++)
+		memcpy(row + y * rowBytes, row, rowBytes);
+}
+
+// VirtualDisplayMode
+
+VirtualDisplayMode::VirtualDisplayMode(const VirtualDisplayModeDescription& description) :
+	m_refCount(1),
+	m_description(description)
+{
+}
+
+HRESULT VirtualDisplayMode::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (ppv == nullptr)
+		return E_INVALIDARG;
+
+	if (iid == IID_IUnknown || iid == IID_IDeckLinkDisplayMode)
+	{
+		*ppv = static_cast<IDeckLinkDisplayMode*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = nullptr;
+	return E_NOINTERFACE;
+}
+
+ULONG VirtualDisplayMode::AddRef()
+{
+	return ++m_refCount;
+}
+
+ULONG VirtualDisplayMode::Release()
+{
+	ULONG newRefValue = --m_refCount;
+
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+HRESULT VirtualDisplayMode::GetName(const char** name)
+{
+	if (name == nullptr)
+		return E_POINTER;
+
+	// As with the hardware driver, the caller owns the returned string
+	*name = strdup(m_description.name);
+	return S_OK;
+}
+
+BMDDisplayMode VirtualDisplayMode::GetDisplayMode()
+{
+	return m_description.displayMode;
+}
+
+long VirtualDisplayMode::GetWidth()
+{
+	return m_description.width;
+}
+
+long VirtualDisplayMode::GetHeight()
+{
+	return m_description.height;
+}
+
+HRESULT VirtualDisplayMode::GetFrameRate(BMDTimeValue* frameDuration, BMDTimeScale* timeScale)
+{
+	if (frameDuration == nullptr || timeScale == nullptr)
+		return E_POINTER;
+
+	*frameDuration = m_description.frameDuration;
+	*timeScale = m_description.timeScale;
+	return S_OK;
+}
+
+BMDFieldDominance VirtualDisplayMode::GetFieldDominance()
+{
+	return m_description.fieldDominance;
+}
+
+BMDDisplayModeFlags VirtualDisplayMode::GetFlags()
+{
+	return m_description.flags;
+}
+
+// VirtualDisplayModeIterator
+
+VirtualDisplayModeIterator::VirtualDisplayModeIterator() :
+	m_refCount(1),
+	m_index(0)
+{
+}
+
+HRESULT VirtualDisplayModeIterator::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (ppv == nullptr)
+		return E_INVALIDARG;
+
+	if (iid == IID_IUnknown || iid == IID_IDeckLinkDisplayModeIterator)
+	{
+		*ppv = static_cast<IDeckLinkDisplayModeIterator*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = nullptr;
+	return E_NOINTERFACE;
+}
+
+ULONG VirtualDisplayModeIterator::AddRef()
+{
+	return ++m_refCount;
+}
+
+ULONG VirtualDisplayModeIterator::Release()
+{
+	ULONG newRefValue = --m_refCount;
+
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+HRESULT VirtualDisplayModeIterator::Next(IDeckLinkDisplayMode** deckLinkDisplayMode)
+{
+	if (deckLinkDisplayMode == nullptr)
+		return E_POINTER;
+
+	if (m_index >= kDisplayModes.size())
+	{
+		*deckLinkDisplayMode = nullptr;
+		return S_FALSE;
+	}
+
+	*deckLinkDisplayMode = new VirtualDisplayMode(kDisplayModes[m_index++]);
+	return S_OK;
+}
@@ -0,0 +1,657 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "VirtualClock.h"
+#include "VirtualVideoFrame.h"
+
+namespace
+{
+	const size_t	kBufferAlignment	= 4096;
+	const int64_t	kAudioSampleRate	= 48000;
+
+	inline uint32_t toBCD(uint8_t value)
+	{
+		return ((value / 10) << 4) | (value % 10);
+	}
+
+	class VirtualAncillaryPacketIterator : public IDeckLinkAncillaryPacketIterator
+	{
+	public:
+		explicit VirtualAncillaryPacketIterator(std::vector<com_ptr<IDeckLinkAncillaryPacket>>&& packets) :
+			m_refCount(1),
+			m_packets(std::move(packets)),
+			m_index(0)
+		{ }
+		virtual ~VirtualAncillaryPacketIterator() = default;
+
+		HRESULT QueryInterface(REFIID iid, LPVOID *ppv) override
+		{
+			if (ppv == nullptr)
+				return E_INVALIDARG;
+
+			if (iid == IID_IUnknown || iid == IID_IDeckLinkAncillaryPacketIterator)
+			{
+				*ppv = static_cast<IDeckLinkAncillaryPacketIterator*>(this);
+				AddRef();
+				return S_OK;
+			}
+
+			*ppv = nullptr;
+			return E_NOINTERFACE;
+		}
+
+		ULONG AddRef() override
+		{
+			return ++m_refCount;
+		}
+
+		ULONG Release() override
+		{
+			ULONG newRefValue = --m_refCount;
+			if (newRefValue == 0)
+				delete this;
+			return newRefValue;
+		}
+
+		HRESULT Next(IDeckLinkAncillaryPacket** packet) override
+		{
+			if (packet == nullptr)
+				return E_POINTER;
+
+			if (m_index >= m_packets.size())
+			{
+				*packet = nullptr;
+				return S_FALSE;
+			}
+
+			*packet = m_packets[m_index++].get();
+			(*packet)->AddRef();
+			return S_OK;
+		}
+
+	private:
+		std::atomic<ULONG>								m_refCount;
+		std::vector<com_ptr<IDeckLinkAncillaryPacket>>	m_packets;
+		size_t											m_index;
+	};
+}
+
+// VirtualMemoryAllocator
+
+VirtualMemoryAllocator::VirtualMemoryAllocator() :
+	m_refCount(1)
+{
+}
+
+VirtualMemoryAllocator::~VirtualMemoryAllocator()
+{
+	// Buffers still held by frames at this point would be leaked by the application, only free the pooled ones
+	for (void* buffer : m_freeBuffers)
+		free(buffer);
+}
+
+HRESULT VirtualMemoryAllocator::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (ppv == nullptr)
+		return E_INVALIDARG;
+
+	if (iid == IID_IUnknown || iid == IID_IDeckLinkMemoryAllocator)
+	{
+		*ppv = static_cast<IDeckLinkMemoryAllocator*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = nullptr;
+	return E_NOINTERFACE;
+}
+
+ULONG VirtualMemoryAllocator::AddRef()
+{
+	return ++m_refCount;
+}
+
+ULONG VirtualMemoryAllocator::Release()
+{
+	ULONG newRefValue = --m_refCount;
+
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+HRESULT VirtualMemoryAllocator::AllocateBuffer(uint32_t bufferSize, void** allocatedBuffer)
+{
+	if (allocatedBuffer == nullptr)
+		return E_POINTER;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto iter = std::find_if(m_freeBuffers.begin(), m_freeBuffers.end(),
+								 [&](void* buffer) { return m_bufferSizes[buffer] == bufferSize; });
+		if (iter != m_freeBuffers.end())
+		{
+			*allocatedBuffer = *iter;
+			m_freeBuffers.erase(iter);
+			return S_OK;
+		}
+	}
+
+	void* buffer = nullptr;
+	if (posix_memalign(&buffer, kBufferAlignment, bufferSize) != 0)
+	{
+		*allocatedBuffer = nullptr;
+		return E_OUTOFMEMORY;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bufferSizes[buffer] = bufferSize;
+	}
+
+	*allocatedBuffer = buffer;
+	return S_OK;
+}
+
+HRESULT VirtualMemoryAllocator::ReleaseBuffer(void* buffer)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_bufferSizes.find(buffer) == m_bufferSizes.end())
+		return E_INVALIDARG;
+
+	m_freeBuffers.push_back(buffer);
+	return S_OK;
+}
+
+HRESULT VirtualMemoryAllocator::Commit()
+{
+	return S_OK;
+}
+
+HRESULT VirtualMemoryAllocator::Decommit()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (void* buffer : m_freeBuffers)
+	{
+		m_bufferSizes.erase(buffer);
+		free(buffer);
+	}
+
+	m_freeBuffers.clear();
+	return S_OK;
+}
+
+// VirtualTimecode
+
+VirtualTimecode::VirtualTimecode(uint8_t hours, uint8_t minutes, uint8_t seconds, uint8_t frames, BMDTimecodeFlags flags) :
+	m_refCount(1),
+	m_hours(hours),
+	m_minutes(minutes),
+	m_seconds(seconds),
+	m_frames(frames),
+	m_flags(flags),
+	m_userBits(0)
+{
+}
+
+VirtualTimecode* VirtualTimecode::fromFrameIndex(int64_t frameIndex, BMDTimeValue frameDuration, BMDTimeScale timeScale)
+{
+	BMDTimecodeFlags	flags		= bmdTimecodeFlagDefault;
+	int64_t				frameRate	= (timeScale + frameDuration - 1) / frameDuration;
+	bool				dropFrame	= (timeScale % frameDuration) != 0;
+
+	// Above 30 fps, RP188 counts frame pairs and marks the second frame of each pair with the field mark flag
+	if (frameRate > 30)
+	{
+		if (frameIndex & 1)
+			flags |= bmdTimecodeFieldMark;
+		frameIndex /= 2;
+		frameRate /= 2;
+	}
+
+	if (dropFrame && frameRate == 30)
+	{
+		// SMPTE 12M drop frame: skip frame numbers 0 and 1 of every minute, except every tenth minute
+		const int64_t kFramesPerTenMinutes	= 17982;
+		const int64_t kFramesPerMinute		= 1798;
+
+		int64_t tenMinutes	= frameIndex / kFramesPerTenMinutes;
+		int64_t remainder	= frameIndex % kFramesPerTenMinutes;
+
+		frameIndex += 18 * tenMinutes;
+		if (remainder > 2)
+			frameIndex += 2 * ((remainder - 2) / kFramesPerMinute);
+
+		flags |= bmdTimecodeIsDropFrame;
+	}
+
+	uint8_t frames	= (uint8_t)(frameIndex % frameRate);
+	uint8_t seconds	= (uint8_t)((frameIndex / frameRate) % 60);
+	uint8_t minutes	= (uint8_t)((frameIndex / (frameRate * 60)) % 60);
+	uint8_t hours	= (uint8_t)((frameIndex / (frameRate * 3600)) % 24);
+
+	return new VirtualTimecode(hours, minutes, seconds, frames, flags);
+}
+
+HRESULT VirtualTimecode::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (ppv == nullptr)
+		return E_INVALIDARG;
+
+	if (iid == IID_IUnknown || iid == IID_IDeckLinkTimecode)
+	{
+		*ppv = static_cast<IDeckLinkTimecode*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = nullptr;
+	return E_NOINTERFACE;
+}
+
+ULONG VirtualTimecode::AddRef()
+{
+	return ++m_refCount;
+}
+
+ULONG VirtualTimecode::Release()
+{
+	ULONG newRefValue = --m_refCount;
+
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+BMDTimecodeBCD VirtualTimecode::GetBCD()
+{
+	return (toBCD(m_hours) << 24) | (toBCD(m_minutes) << 16) | (toBCD(m_seconds) << 8) | toBCD(m_frames);
+}
+
+HRESULT VirtualTimecode::GetComponents(uint8_t* hours, uint8_t* minutes, uint8_t* seconds, uint8_t* frames)
+{
+	if (hours == nullptr || minutes == nullptr || seconds == nullptr || frames == nullptr)
+		return E_POINTER;
+
+	*hours		= m_hours;
+	*minutes	= m_minutes;
+	*seconds	= m_seconds;
+	*frames		= m_frames;
+	return S_OK;
+}
+
+HRESULT VirtualTimecode::GetString(const char** timecode)
+{
+	char	timecodeString[16];
+	char	separator = (m_flags & bmdTimecodeIsDropFrame) ? ';' : ':';
+
+	if (timecode == nullptr)
+		return E_POINTER;
+
+	snprintf(timecodeString, sizeof(timecodeString), "%02u:%02u:%02u%c%02u", m_hours, m_minutes, m_seconds, separator, m_frames);
+
+	// As with the hardware driver, the caller owns the returned string
+	*timecode = strdup(timecodeString);
+	return S_OK;
+}
+
+BMDTimecodeFlags VirtualTimecode::GetFlags()
+{
+	return m_flags;
+}
+
+HRESULT VirtualTimecode::GetTimecodeUserBits(BMDTimecodeUserBits* userBits)
+{
+	if (userBits == nullptr)
+		return E_POINTER;
+
+	*userBits = m_userBits;
+	return S_OK;
+}
+
+// VirtualAncillaryPackets
+
+VirtualAncillaryPackets::VirtualAncillaryPackets() :
+	m_refCount(1)
+{
+}
+
+HRESULT VirtualAncillaryPackets::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (ppv == nullptr)
+		return E_INVALIDARG;
+
+	if (iid == IID_IUnknown || iid == IID_IDeckLinkVideoFrameAncillaryPackets)
+	{
+		*ppv = static_cast<IDeckLinkVideoFrameAncillaryPackets*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = nullptr;
+	return E_NOINTERFACE;
+}
+
+ULONG VirtualAncillaryPackets::AddRef()
+{
+	return ++m_refCount;
+}
+
+ULONG VirtualAncillaryPackets::Release()
+{
+	ULONG newRefValue = --m_refCount;
+
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+HRESULT VirtualAncillaryPackets::GetPacketIterator(IDeckLinkAncillaryPacketIterator** iterator)
+{
+	if (iterator == nullptr)
+		return E_POINTER;
+
+	*iterator = new VirtualAncillaryPacketIterator(getPackets());
+	return S_OK;
+}
+
+HRESULT VirtualAncillaryPackets::GetFirstPacketByID(uint8_t DID, uint8_t SDID, IDeckLinkAncillaryPacket** packet)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (packet == nullptr)
+		return E_POINTER;
+
+	for (auto& attachedPacket : m_packets)
+	{
+		if (attachedPacket->GetDID() == DID && attachedPacket->GetSDID() == SDID)
+		{
+			*packet = attachedPacket.get();
+			(*packet)->AddRef();
+			return S_OK;
+		}
+	}
+
+	*packet = nullptr;
+	return S_FALSE;
+}
+
+HRESULT VirtualAncillaryPackets::AttachPacket(IDeckLinkAncillaryPacket* packet)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (packet == nullptr)
+		return E_INVALIDARG;
+
+	// A packet may only be attached once, and only one packet per DID/SDID pair and line
+	for (auto& attachedPacket : m_packets)
+	{
+		if (attachedPacket.get() == packet)
+			return E_INVALIDARG;
+
+		if (attachedPacket->GetDID() == packet->GetDID() && attachedPacket->GetSDID() == packet->GetSDID() &&
+			attachedPacket->GetLineNumber() == packet->GetLineNumber() && packet->GetLineNumber() != 0)
+			return E_INVALIDARG;
+	}
+
+	m_packets.emplace_back(packet);
+	return S_OK;
+}
+
+HRESULT VirtualAncillaryPackets::DetachPacket(IDeckLinkAncillaryPacket* packet)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto iter = std::find_if(m_packets.begin(), m_packets.end(),
+							 [&](const com_ptr<IDeckLinkAncillaryPacket>& attachedPacket) { return attachedPacket.get() == packet; });
+	if (iter == m_packets.end())
+		return E_INVALIDARG;
+
+	m_packets.erase(iter);
+	return S_OK;
+}
+
+HRESULT VirtualAncillaryPackets::DetachAllPackets()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_packets.clear();
+	return S_OK;
+}
+
+std::vector<com_ptr<IDeckLinkAncillaryPacket>> VirtualAncillaryPackets::getPackets()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_packets;
+}
+
+// VirtualMutableVideoFrame
+
+HRESULT VirtualMutableVideoFrame::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	return queryFrameInterface(iid, IID_IDeckLinkMutableVideoFrame, ppv);
+}
+
+HRESULT VirtualMutableVideoFrame::SetFlags(BMDFrameFlags newFlags)
+{
+	m_flags = newFlags;
+	return S_OK;
+}
+
+HRESULT VirtualMutableVideoFrame::SetTimecode(BMDTimecodeFormat format, IDeckLinkTimecode* timecode)
+{
+	if (timecode == nullptr)
+		return E_INVALIDARG;
+
+	setTimecode(format, com_ptr<IDeckLinkTimecode>(timecode));
+	return S_OK;
+}
+
+HRESULT VirtualMutableVideoFrame::SetTimecodeFromComponents(BMDTimecodeFormat format, uint8_t hours, uint8_t minutes, uint8_t seconds, uint8_t frames, BMDTimecodeFlags flags)
+{
+	setTimecode(format, com_ptr<IDeckLinkTimecode>(make_com_ptr<VirtualTimecode>(hours, minutes, seconds, frames, flags).get()));
+	return S_OK;
+}
+
+HRESULT VirtualMutableVideoFrame::SetAncillaryData(IDeckLinkVideoFrameAncillary* ancillary)
+{
+	// Only IDeckLinkVideoFrameAncillaryPackets is provided for ancillary data
+	return E_NOTIMPL;
+}
+
+HRESULT VirtualMutableVideoFrame::SetTimecodeUserBits(BMDTimecodeFormat format, BMDTimecodeUserBits userBits)
+{
+	for (auto& entry : m_timecodes)
+	{
+		uint8_t hours, minutes, seconds, frames;
+
+		if (entry.first != format)
+			continue;
+
+		// The attached timecode may be application owned, so replace it with a copy carrying the user bits
+		if (entry.second->GetComponents(&hours, &minutes, &seconds, &frames) != S_OK)
+			return E_FAIL;
+
+		com_ptr<VirtualTimecode> timecode = make_com_ptr<VirtualTimecode>(hours, minutes, seconds, frames, entry.second->GetFlags());
+		timecode->setUserBits(userBits);
+		entry.second = com_ptr<IDeckLinkTimecode>(timecode.get());
+		return S_OK;
+	}
+
+	return E_FAIL;
+}
+
+// VirtualVideoInputFrame
+
+VirtualVideoInputFrame::VirtualVideoInputFrame(long width, long height, long rowBytes, BMDPixelFormat pixelFormat, BMDFrameFlags flags, com_ptr<IDeckLinkMemoryAllocator> allocator, void* buffer,
+											   BMDTimeValue streamTime, BMDTimeValue frameDuration, BMDTimeScale timeScale, int64_t hardwareTimestamp, std::shared_ptr<std::atomic<uint32_t>> framesInFlight) :
+	VirtualVideoFrameBase(width, height, rowBytes, pixelFormat, flags, std::move(allocator), buffer),
+	m_streamTime(streamTime),
+	m_frameDuration(frameDuration),
+	m_timeScale(timeScale),
+	m_hardwareTimestamp(hardwareTimestamp),
+	m_framesInFlight(std::move(framesInFlight))
+{
+}
+
+VirtualVideoInputFrame::~VirtualVideoInputFrame()
+{
+	if (m_framesInFlight)
+		--(*m_framesInFlight);
+}
+
+HRESULT VirtualVideoInputFrame::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	return queryFrameInterface(iid, IID_IDeckLinkVideoInputFrame, ppv);
+}
+
+HRESULT VirtualVideoInputFrame::GetStreamTime(BMDTimeValue* frameTime, BMDTimeValue* frameDuration, BMDTimeScale timeScale)
+{
+	// The frame duration is optional, as it is with the hardware driver
+	if (frameTime == nullptr)
+		return E_POINTER;
+
+	if (timeScale <= 0)
+		return E_INVALIDARG;
+
+	*frameTime = m_streamTime * timeScale / m_timeScale;
+	if (frameDuration != nullptr)
+		*frameDuration = m_frameDuration * timeScale / m_timeScale;
+	return S_OK;
+}
+
+HRESULT VirtualVideoInputFrame::GetHardwareReferenceTimestamp(BMDTimeScale timeScale, BMDTimeValue* frameTime, BMDTimeValue* frameDuration)
+{
+	if (frameTime == nullptr)
+		return E_POINTER;
+
+	if (timeScale <= 0)
+		return E_INVALIDARG;
+
+	// The hardware timestamp marks the end of frame capture, when the frame is complete in memory
+	*frameTime = VirtualClock::toTimescale(m_hardwareTimestamp, timeScale);
+	if (frameDuration != nullptr)
+		*frameDuration = m_frameDuration * timeScale / m_timeScale;
+	return S_OK;
+}
+
+// VirtualAudioInputPacket
+
+VirtualAudioInputPacket::VirtualAudioInputPacket(com_ptr<IDeckLinkMemoryAllocator> allocator, void* buffer, long sampleFrameCount, int64_t packetSampleTime) :
+	m_refCount(1),
+	m_allocator(std::move(allocator)),
+	m_buffer(buffer),
+	m_sampleFrameCount(sampleFrameCount),
+	m_packetSampleTime(packetSampleTime)
+{
+}
+
+VirtualAudioInputPacket::~VirtualAudioInputPacket()
+{
+	if (m_allocator && m_buffer)
+		m_allocator->ReleaseBuffer(m_buffer);
+}
+
+HRESULT VirtualAudioInputPacket::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (ppv == nullptr)
+		return E_INVALIDARG;
+
+	if (iid == IID_IUnknown || iid == IID_IDeckLinkAudioInputPacket)
+	{
+		*ppv = static_cast<IDeckLinkAudioInputPacket*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = nullptr;
+	return E_NOINTERFACE;
+}
+
+ULONG VirtualAudioInputPacket::AddRef()
+{
+	return ++m_refCount;
+}
+
+ULONG VirtualAudioInputPacket::Release()
+{
+	ULONG newRefValue = --m_refCount;
+
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+long VirtualAudioInputPacket::GetSampleFrameCount()
+{
+	return m_sampleFrameCount;
+}
+
+HRESULT VirtualAudioInputPacket::GetBytes(void** buffer)
+{
+	if (buffer == nullptr)
+		return E_POINTER;
+
+	*buffer = m_buffer;
+	return S_OK;
+}
+
+HRESULT VirtualAudioInputPacket::GetPacketTime(BMDTimeValue* packetTime, BMDTimeScale timeScale)
+{
+	if (packetTime == nullptr)
+		return E_POINTER;
+
+	if (timeScale <= 0)
+		return E_INVALIDARG;
+
+	*packetTime = m_packetSampleTime * timeScale / kAudioSampleRate;
+	return S_OK;
+}
@@ -0,0 +1,378 @@
+/* -LICENSE-START-
+** Copyright (c) 2020 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "DeckLinkAPI.h"
+#include "com_ptr.h"
+#include "platform.h"
+
+// Default frame and audio buffer allocator.  Buffers are page aligned, as they would be for DMA,
+// and released buffers are kept for reuse until Decommit so that steady state streaming does not allocate.
+class VirtualMemoryAllocator : public IDeckLinkMemoryAllocator
+{
+public:
+	VirtualMemoryAllocator();
+	virtual ~VirtualMemoryAllocator();
+
+	// IUnknown interface
+	HRESULT		QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG		AddRef() override;
+	ULONG		Release() override;
+
+	// IDeckLinkMemoryAllocator interface
+	HRESULT		AllocateBuffer(uint32_t bufferSize, void** allocatedBuffer) override;
+	HRESULT		ReleaseBuffer(void* buffer) override;
+	HRESULT		Commit() override;
+	HRESULT		Decommit() override;
+
+private:
+	std::atomic<ULONG>					m_refCount;
+	std::mutex							m_mutex;
+	std::unordered_map<void*, uint32_t>	m_bufferSizes;
+	std::vector<void*>					m_freeBuffers;
+};
+
+class VirtualTimecode : public IDeckLinkTimecode
+{
+public:
+	VirtualTimecode(uint8_t hours, uint8_t minutes, uint8_t seconds, uint8_t frames, BMDTimecodeFlags flags);
+	virtual ~VirtualTimecode() = default;
+
+	// Generate the timecode of a frame counted from midnight at the given frame rate
+	static VirtualTimecode*	fromFrameIndex(int64_t frameIndex, BMDTimeValue frameDuration, BMDTimeScale timeScale);
+
+	// IUnknown interface
+	HRESULT				QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG				AddRef() override;
+	ULONG				Release() override;
+
+	// IDeckLinkTimecode interface
+	BMDTimecodeBCD		GetBCD() override;
+	HRESULT				GetComponents(uint8_t* hours, uint8_t* minutes, uint8_t* seconds, uint8_t* frames) override;
+	HRESULT				GetString(const char** timecode) override;
+	BMDTimecodeFlags	GetFlags() override;
+	HRESULT				GetTimecodeUserBits(BMDTimecodeUserBits* userBits) override;
+
+	void				setUserBits(BMDTimecodeUserBits userBits) { m_userBits = userBits; }
+
+private:
+	std::atomic<ULONG>	m_refCount;
+	uint8_t				m_hours;
+	uint8_t				m_minutes;
+	uint8_t				m_seconds;
+	uint8_t				m_frames;
+	BMDTimecodeFlags	m_flags;
+	BMDTimecodeUserBits	m_userBits;
+};
+
+class VirtualAncillaryPackets : public IDeckLinkVideoFrameAncillaryPackets
+{
+public:
+	VirtualAncillaryPackets();
+	virtual ~VirtualAncillaryPackets() = default;
+
+	// IUnknown interface
+	HRESULT		QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG		AddRef() override;
+	ULONG		Release() override;
+
+	// IDeckLinkVideoFrameAncillaryPackets interface
+	HRESULT		GetPacketIterator(IDeckLinkAncillaryPacketIterator** iterator) override;
+	HRESULT		GetFirstPacketByID(uint8_t DID, uint8_t SDID, IDeckLinkAncillaryPacket** packet) override;
+	HRESULT		AttachPacket(IDeckLinkAncillaryPacket* packet) override;
+	HRESULT		DetachPacket(IDeckLinkAncillaryPacket* packet) override;
+	HRESULT		DetachAllPackets() override;
+
+	std::vector<com_ptr<IDeckLinkAncillaryPacket>>	getPackets();
+
+private:
+	std::atomic<ULONG>								m_refCount;
+	std::mutex										m_mutex;
+	std::vector<com_ptr<IDeckLinkAncillaryPacket>>	m_packets;
+};
+
+// Common implementation of IDeckLinkVideoFrame for the output frames created by the application
+// and the input frames delivered to it.  The frame buffer is returned to its allocator on destruction.
+template<typename Interface>
+class VirtualVideoFrameBase : public Interface
+{
+public:
+	VirtualVideoFrameBase(long width, long height, long rowBytes, BMDPixelFormat pixelFormat, BMDFrameFlags flags, com_ptr<IDeckLinkMemoryAllocator> allocator, void* buffer);
+	virtual ~VirtualVideoFrameBase();
+
+	// IUnknown interface
+	ULONG				AddRef() override;
+	ULONG				Release() override;
+
+	// IDeckLinkVideoFrame interface
+	long				GetWidth() override { return m_width; }
+	long				GetHeight() override { return m_height; }
+	long				GetRowBytes() override { return m_rowBytes; }
+	BMDPixelFormat		GetPixelFormat() override { return m_pixelFormat; }
+	BMDFrameFlags		GetFlags() override { return m_flags; }
+	HRESULT				GetBytes(void** buffer) override;
+	HRESULT				GetTimecode(BMDTimecodeFormat format, IDeckLinkTimecode** timecode) override;
+	HRESULT				GetAncillaryData(IDeckLinkVideoFrameAncillary** ancillary) override;
+
+	void				setTimecode(BMDTimecodeFormat format, com_ptr<IDeckLinkTimecode> timecode);
+	void				attachAncillaryPackets(const std::vector<com_ptr<IDeckLinkAncillaryPacket>>& packets);
+
+protected:
+	HRESULT				queryFrameInterface(REFIID iid, REFIID frameIID, LPVOID *ppv);
+
+	std::atomic<ULONG>									m_refCount;
+	long												m_width;
+	long												m_height;
+	long												m_rowBytes;
+	BMDPixelFormat										m_pixelFormat;
+	BMDFrameFlags										m_flags;
+	com_ptr<IDeckLinkMemoryAllocator>					m_allocator;
+	void*												m_buffer;
+	std::vector<std::pair<BMDTimecodeFormat, com_ptr<IDeckLinkTimecode>>>	m_timecodes;
+	std::mutex											m_ancillaryMutex;
+	com_ptr<VirtualAncillaryPackets>					m_ancillaryPackets;
+};
+
+class VirtualMutableVideoFrame : public VirtualVideoFrameBase<IDeckLinkMutableVideoFrame>
+{
+public:
+	using VirtualVideoFrameBase::VirtualVideoFrameBase;
+	virtual ~VirtualMutableVideoFrame() = default;
+
+	// IUnknown interface
+	HRESULT		QueryInterface(REFIID iid, LPVOID *ppv) override;
+
+	// IDeckLinkMutableVideoFrame interface
+	HRESULT		SetFlags(BMDFrameFlags newFlags) override;
+	HRESULT		SetTimecode(BMDTimecodeFormat format, IDeckLinkTimecode* timecode) override;
+	HRESULT		SetTimecodeFromComponents(BMDTimecodeFormat format, uint8_t hours, uint8_t minutes, uint8_t seconds, uint8_t frames, BMDTimecodeFlags flags) override;
+	HRESULT		SetAncillaryData(IDeckLinkVideoFrameAncillary* ancillary) override;
+	HRESULT		SetTimecodeUserBits(BMDTimecodeFormat format, BMDTimecodeUserBits userBits) override;
+};
+
+class VirtualVideoInputFrame : public VirtualVideoFrameBase<IDeckLinkVideoInputFrame>
+{
+public:
+	VirtualVideoInputFrame(long width, long height, long rowBytes, BMDPixelFormat pixelFormat, BMDFrameFlags flags, com_ptr<IDeckLinkMemoryAllocator> allocator, void* buffer,
+						   BMDTimeValue streamTime, BMDTimeValue frameDuration, BMDTimeScale timeScale, int64_t hardwareTimestamp, std::shared_ptr<std::atomic<uint32_t>> framesInFlight);
+	virtual ~VirtualVideoInputFrame();
+
+	// IUnknown interface
+	HRESULT		QueryInterface(REFIID iid, LPVOID *ppv) override;
+
+	// IDeckLinkVideoInputFrame interface
+	HRESULT		GetStreamTime(BMDTimeValue* frameTime, BMDTimeValue* frameDuration, BMDTimeScale timeScale) override;
+	HRESULT		GetHardwareReferenceTimestamp(BMDTimeScale timeScale, BMDTimeValue* frameTime, BMDTimeValue* frameDuration) override;
+
+private:
+	BMDTimeValue							m_streamTime;
+	BMDTimeValue							m_frameDuration;
+	BMDTimeScale							m_timeScale;
+	int64_t									m_hardwareTimestamp;
+	std::shared_ptr<std::atomic<uint32_t>>	m_framesInFlight;
+};
+
+class VirtualAudioInputPacket : public IDeckLinkAudioInputPacket
+{
+public:
+	VirtualAudioInputPacket(com_ptr<IDeckLinkMemoryAllocator> allocator, void* buffer, long sampleFrameCount, int64_t packetSampleTime);
+	virtual ~VirtualAudioInputPacket();
+
+	// IUnknown interface
+	HRESULT		QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG		AddRef() override;
+	ULONG		Release() override;
+
+	// IDeckLinkAudioInputPacket interface
+	long		GetSampleFrameCount() override;
+	HRESULT		GetBytes(void** buffer) override;
+	HRESULT		GetPacketTime(BMDTimeValue* packetTime, BMDTimeScale timeScale) override;
+
+private:
+	std::atomic<ULONG>					m_refCount;
+	com_ptr<IDeckLinkMemoryAllocator>	m_allocator;
+	void*								m_buffer;
+	long								m_sampleFrameCount;
+	int64_t								m_packetSampleTime;
+};
+
+// Template implementation
+
+template<typename Interface>
+VirtualVideoFrameBase<Interface>::VirtualVideoFrameBase(long width, long height, long rowBytes, BMDPixelFormat pixelFormat, BMDFrameFlags flags, com_ptr<IDeckLinkMemoryAllocator> allocator, void* buffer) :
+	m_refCount(1),
+	m_width(width),
+	m_height(height),
+	m_rowBytes(rowBytes),
+	m_pixelFormat(pixelFormat),
+	m_flags(flags),
+	m_allocator(std::move(allocator)),
+	m_buffer(buffer)
+{
+}
+
+template<typename Interface>
+VirtualVideoFrameBase<Interface>::~VirtualVideoFrameBase()
+{
+	if (m_allocator && m_buffer)
+		m_allocator->ReleaseBuffer(m_buffer);
+}
+
+template<typename Interface>
+ULONG VirtualVideoFrameBase<Interface>::AddRef()
+{
+	return ++m_refCount;
+}
+
+template<typename Interface>
+ULONG VirtualVideoFrameBase<Interface>::Release()
+{
+	ULONG newRefValue = --m_refCount;
+
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+template<typename Interface>
+HRESULT VirtualVideoFrameBase<Interface>::GetBytes(void** buffer)
+{
+	if (buffer == nullptr)
+		return E_POINTER;
+
+	*buffer = m_buffer;
+	return S_OK;
+}
+
+template<typename Interface>
+HRESULT VirtualVideoFrameBase<Interface>::GetTimecode(BMDTimecodeFormat format, IDeckLinkTimecode** timecode)
+{
+	if (timecode == nullptr)
+		return E_POINTER;
+
+	*timecode = nullptr;
+
+	for (auto& entry : m_timecodes)
+	{
+		bool isRP188 = (entry.first == bmdTimecodeRP188VITC1) || (entry.first == bmdTimecodeRP188VITC2) ||
+					   (entry.first == bmdTimecodeRP188LTC) || (entry.first == bmdTimecodeRP188HighFrameRate);
+
+		if (entry.first == format || (format == bmdTimecodeRP188Any && isRP188))
+		{
+			*timecode = entry.second.get();
+			(*timecode)->AddRef();
+			return S_OK;
+		}
+	}
+
+	return S_FALSE;
+}
+
+template<typename Interface>
+HRESULT VirtualVideoFrameBase<Interface>::GetAncillaryData(IDeckLinkVideoFrameAncillary** ancillary)
+{
+	// Only IDeckLinkVideoFrameAncillaryPackets is provided for ancillary data
+	if (ancillary != nullptr)
+		*ancillary = nullptr;
+
+	return E_NOTIMPL;
+}
+
+template<typename Interface>
+void VirtualVideoFrameBase<Interface>::setTimecode(BMDTimecodeFormat format, com_ptr<IDeckLinkTimecode> timecode)
+{
+	for (auto& entry : m_timecodes)
+	{
+		if (entry.first == format)
+		{
+			entry.second = std::move(timecode);
+			return;
+		}
+	}
+
+	m_timecodes.emplace_back(format, std::move(timecode));
+}
+
+template<typename Interface>
+void VirtualVideoFrameBase<Interface>::attachAncillaryPackets(const std::vector<com_ptr<IDeckLinkAncillaryPacket>>& packets)
+{
+	std::lock_guard<std::mutex> lock(m_ancillaryMutex);
+
+	if (!m_ancillaryPackets)
+		m_ancillaryPackets = make_com_ptr<VirtualAncillaryPackets>();
+
+	for (auto& packet : packets)
+		m_ancillaryPackets->AttachPacket(packet.get());
+}
+
+template<typename Interface>
+HRESULT VirtualVideoFrameBase<Interface>::queryFrameInterface(REFIID iid, REFIID frameIID, LPVOID *ppv)
+{
+	if (ppv == nullptr)
+		return E_INVALIDARG;
+
+	if (iid == IID_IUnknown || iid == IID_IDeckLinkVideoFrame || iid == frameIID)
+	{
+		*ppv = static_cast<Interface*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	if (iid == IID_IDeckLinkVideoFrameAncillaryPackets)
+	{
+		std::lock_guard<std::mutex> lock(m_ancillaryMutex);
+
+		if (!m_ancillaryPackets)
+			m_ancillaryPackets = make_com_ptr<VirtualAncillaryPackets>();
+
+		return m_ancillaryPackets->QueryInterface(iid, ppv);
+	}
+
+	*ppv = nullptr;
+	return E_NOINTERFACE;
+}